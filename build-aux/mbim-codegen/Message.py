@@ -91,6 +91,78 @@ def validate_fields(fields):
         else:
             raise ValueError('Cannot handle field type \'%s\'' % field['format'])
 
+"""
+Compute the offsets of the fields which are found at a fixed location in the
+information buffer, i.e. those only preceded by fixed-size fields
+"""
+def compute_static_offsets(fields):
+    offsets = {}
+    offset = 0
+    for field in fields:
+        if 'available-if' in field:
+            break
+        offsets[field['name']] = offset
+        if field['format'] in ['guint32', 'ipv4', 'ref-ipv4', 'ref-ipv6', 'struct-array', 'ipv4-array', 'ipv6-array']:
+            offset += 4
+        elif field['format'] in ['guint64', 'ref-byte-array', 'string']:
+            offset += 8
+        elif field['format'] in ['uuid', 'ipv6']:
+            offset += 16
+        elif field['format'] == 'byte-array':
+            offset += int(field['array-size'])
+        else:
+            break
+    return offsets
+
+
+"""
+List the leading fields which can be loaded directly from the information
+buffer after a single length check
+"""
+def fixed_prefix_fields(fields):
+    offsets = compute_static_offsets(fields)
+    prefix = []
+    for field in fields:
+        if field['name'] not in offsets or field['format'] not in ['guint32', 'guint64', 'uuid']:
+            break
+        prefix.append(field)
+    return prefix
+
+
+"""
+Compute the size of the fixed prefix
+"""
+def fixed_prefix_size(fields):
+    prefix = fixed_prefix_fields(fields)
+    if prefix == []:
+        return 0
+    last = prefix[-1]
+    return compute_static_offsets(fields)[last['name']] + { 'guint32' : 4, 'guint64' : 8, 'uuid' : 16 }[last['format']]
+
+
+"""
+List the fields for which lazy accessors are generated
+"""
+def accessor_fields(fields):
+    offsets = compute_static_offsets(fields)
+    return [field for field in fields
+            if field['name'] in offsets and
+               field['format'] in ['guint32', 'guint64', 'uuid', 'ipv4', 'ref-ipv4', 'ipv6', 'ref-ipv6', 'byte-array', 'ref-byte-array']]
+
+
+"""
+List the struct array fields for which iterators are generated, i.e. those
+whose array and size fields are both found at a fixed location
+"""
+def iterator_fields(fields):
+    offsets = compute_static_offsets(fields)
+    formats = { field['name'] : field['format'] for field in fields }
+    return [field for field in fields
+            if field['format'] in ['struct-array', 'ref-struct-array'] and
+               field['name'] in offsets and
+               field['array-size-field'] in offsets and
+               formats[field['array-size-field']] == 'guint32']
+
 
 """
 The Message class takes care of all message handling
@@ -127,8 +199,12 @@ class Message:
             if self.set_since is None:
                 raise ValueError('Message ' + self.name + ' (set) requires a "since" tag specifying the major version where it was introduced')
             validate_fields(self.set)
+            # Set requests are usually only built, not parsed; a parser is
+            # generated only for those messages explicitly asking for it
+            self.has_set_parser = dictionary['set-parser'] if 'set-parser' in dictionary else False
         else:
             self.has_set = False
+            self.has_set_parser = False
             self.set = []
 
 
@@ -185,18 +261,22 @@ class Message:
             utils.add_separator(hfile, 'Message (Set)', self.fullname);
             utils.add_separator(cfile, 'Message (Set)', self.fullname);
             self._emit_message_creator(hfile, cfile, 'set', self.set, self.set_since)
+            if self.has_set_parser:
+                self._emit_message_parser(hfile, cfile, 'set', self.set, self.set_since)
             self._emit_message_printable(cfile, 'set', self.set)
 
         if self.has_response:
             utils.add_separator(hfile, 'Message (Response)', self.fullname);
             utils.add_separator(cfile, 'Message (Response)', self.fullname);
             self._emit_message_parser(hfile, cfile, 'response', self.response, self.response_since)
+            self._emit_message_accessors(hfile, cfile, 'response', self.response, self.response_since)
             self._emit_message_printable(cfile, 'response', self.response)
 
         if self.has_notification:
             utils.add_separator(hfile, 'Message (Notification)', self.fullname);
             utils.add_separator(cfile, 'Message (Notification)', self.fullname);
             self._emit_message_parser(hfile, cfile, 'notification', self.notification, self.notification_since)
+            self._emit_message_accessors(hfile, cfile, 'notification', self.notification, self.notification_since)
             self._emit_message_printable(cfile, 'notification', self.notification)
 
 
@@ -376,12 +456,90 @@ class Message:
         template += (
             '    GError **error)\n'
             '{\n'
-            '    MbimMessageCommandBuilder *builder;\n'
+            '    MbimMessageCommandBuilder *builder;\n')
+
+        if fields:
+            translations['fixed_size'] = 'fixed_size'
+            translations['variable_size'] = 'variable_size'
+            template += (
+                '    guint32 fixed_size = 0;\n'
+                '    guint32 variable_size = 0;\n'
+                '\n'
+                '    /* Compute the exact size of the message in advance, so that it\n'
+                '     * is allocated once and the contents written in place */\n')
+        else:
+            translations['fixed_size'] = '0'
+            translations['variable_size'] = '0'
+
+        for field in fields:
+            translations['field'] = utils.build_underscore_name_from_camelcase(field['name'])
+            translations['array_size_field'] = utils.build_underscore_name_from_camelcase(field['array-size-field']) if 'array-size-field' in field else ''
+            translations['struct'] = field['struct-type'] if 'struct-type' in field else ''
+            translations['struct_underscore'] = utils.build_underscore_name_from_camelcase (translations['struct'])
+            translations['array_size'] = field['array-size'] if 'array-size' in field else ''
+            translations['pad_array'] = field['pad-array'] if 'pad-array' in field else 'TRUE'
+
+            inner_template = ''
+            if 'available-if' in field:
+                condition = field['available-if']
+                translations['condition_field'] = utils.build_underscore_name_from_camelcase(condition['field'])
+                translations['condition_operation'] = condition['operation']
+                translations['condition_value'] = condition['value']
+                inner_template += (
+                    '    if (${condition_field} ${condition_operation} ${condition_value})\n')
+
+            if field['format'] == 'byte-array':
+                inner_template += ('        _mbim_struct_builder_size_byte_array (FALSE, FALSE, ${pad_array}, ${array_size}, &fixed_size, &variable_size);\n')
+            elif field['format'] == 'unsized-byte-array':
+                inner_template += ('        _mbim_struct_builder_size_byte_array (FALSE, FALSE, ${pad_array}, ${field}_size, &fixed_size, &variable_size);\n')
+            elif field['format'] == 'ref-byte-array':
+                inner_template += ('        _mbim_struct_builder_size_byte_array (TRUE, TRUE, ${pad_array}, ${field}_size, &fixed_size, &variable_size);\n')
+            elif field['format'] == 'ref-byte-array-no-offset':
+                inner_template += ('        _mbim_struct_builder_size_byte_array (FALSE, TRUE, ${pad_array}, ${field}_size, &fixed_size, &variable_size);\n')
+            elif field['format'] == 'uuid':
+                inner_template += ('        fixed_size += sizeof (MbimUuid);\n')
+            elif field['format'] == 'guint32':
+                inner_template += ('        fixed_size += sizeof (guint32);\n')
+            elif field['format'] == 'guint64':
+                inner_template += ('        fixed_size += sizeof (guint64);\n')
+            elif field['format'] == 'string':
+                inner_template += ('        _mbim_struct_builder_size_string (${field}, &fixed_size, &variable_size);\n')
+            elif field['format'] == 'string-array':
+                inner_template += ('        _mbim_struct_builder_size_string_array (${field}, ${array_size_field}, &fixed_size, &variable_size);\n')
+            elif field['format'] == 'struct':
+                inner_template += ('        _mbim_struct_builder_size_${struct_underscore}_struct (${field}, &fixed_size, &variable_size);\n')
+            elif field['format'] == 'struct-array':
+                inner_template += ('        _mbim_struct_builder_size_${struct_underscore}_struct_array (${field}, ${array_size_field}, FALSE, &fixed_size, &variable_size);\n')
+            elif field['format'] == 'ref-struct-array':
+                inner_template += ('        _mbim_struct_builder_size_${struct_underscore}_struct_array (${field}, ${array_size_field}, TRUE, &fixed_size, &variable_size);\n')
+            elif field['format'] == 'ipv4':
+                inner_template += ('        _mbim_struct_builder_size_ipv4 (${field}, FALSE, &fixed_size, &variable_size);\n')
+            elif field['format'] == 'ref-ipv4':
+                inner_template += ('        _mbim_struct_builder_size_ipv4 (${field}, TRUE, &fixed_size, &variable_size);\n')
+            elif field['format'] == 'ipv4-array':
+                inner_template += ('        _mbim_struct_builder_size_ipv4_array (${array_size_field}, &fixed_size, &variable_size);\n')
+            elif field['format'] == 'ipv6':
+                inner_template += ('        _mbim_struct_builder_size_ipv6 (${field}, FALSE, &fixed_size, &variable_size);\n')
+            elif field['format'] == 'ref-ipv6':
+                inner_template += ('        _mbim_struct_builder_size_ipv6 (${field}, TRUE, &fixed_size, &variable_size);\n')
+            elif field['format'] == 'ipv6-array':
+                inner_template += ('        _mbim_struct_builder_size_ipv6_array (${array_size_field}, &fixed_size, &variable_size);\n')
+            else:
+                raise ValueError('Cannot handle field type \'%s\'' % field['format'])
+
+            if 'available-if' not in field:
+                inner_template = inner_template[4:]
+
+            template += (string.Template(inner_template).substitute(translations))
+
+        template += (
             '\n'
-            '    builder = _mbim_message_command_builder_new (0,\n'
-            '                                                 MBIM_SERVICE_${service_underscore_upper},\n'
-            '                                                 ${cid_enum_name},\n'
-            '                                                 MBIM_MESSAGE_COMMAND_TYPE_${message_type_upper});\n')
+            '    builder = _mbim_message_command_builder_new_sized (0,\n'
+            '                                                       MBIM_SERVICE_${service_underscore_upper},\n'
+            '                                                       ${cid_enum_name},\n'
+            '                                                       MBIM_MESSAGE_COMMAND_TYPE_${message_type_upper},\n'
+            '                                                       ${fixed_size},\n'
+            '                                                       ${variable_size});\n')
 
         for field in fields:
             translations['field'] = utils.build_underscore_name_from_camelcase(field['name'])
@@ -627,10 +785,19 @@ class Message:
             '    GError **error)\n'
             '{\n')
 
+        prefix = fixed_prefix_fields(fields)
+        offsets = compute_static_offsets(fields)
+        translations['prefix_size'] = fixed_prefix_size(fields)
+
         if fields != []:
             template += (
-                '    gboolean success = FALSE;\n'
-                '    guint32 offset = 0;\n')
+                '    gboolean success = FALSE;\n')
+        if prefix != []:
+            template += (
+                '    const guint8 *fixed;\n')
+        if len(prefix) < len(fields):
+            template += (
+                '    guint32 offset = ${prefix_size};\n')
 
         count_allocated_variables = 0
         for field in fields:
@@ -685,6 +852,28 @@ class Message:
                     '                     \"Message does not have information buffer\");\n'
                     '        return FALSE;\n'
                     '    }\n')
+        elif message_type == 'set':
+            template += (
+                '\n'
+                '    if (mbim_message_get_message_type (message) != MBIM_MESSAGE_TYPE_COMMAND ||\n'
+                '        mbim_message_command_get_command_type (message) != MBIM_MESSAGE_COMMAND_TYPE_SET) {\n'
+                '        g_set_error (error,\n'
+                '                     MBIM_CORE_ERROR,\n'
+                '                     MBIM_CORE_ERROR_INVALID_MESSAGE,\n'
+                '                     \"Message is not a set request\");\n'
+                '        return FALSE;\n'
+                '    }\n')
+
+            if fields != []:
+                template += (
+                    '\n'
+                    '    if (!mbim_message_command_get_raw_information_buffer (message, NULL)) {\n'
+                    '        g_set_error (error,\n'
+                    '                     MBIM_CORE_ERROR,\n'
+                    '                     MBIM_CORE_ERROR_INVALID_MESSAGE,\n'
+                    '                     \"Message does not have information buffer\");\n'
+                    '        return FALSE;\n'
+                    '    }\n')
         elif message_type == 'notification':
             template += (
                 '\n'
@@ -709,7 +898,44 @@ class Message:
         else:
             raise ValueError('Unexpected message type \'%s\'' % message_type)
 
-        for field in fields:
+        if prefix != []:
+            template += (
+                '\n'
+                '    /* Validate the fixed-size fields at once */\n'
+                '    fixed = _mbim_message_read_fixed_prefix (message, ${prefix_size}, error);\n'
+                '    if (!fixed)\n'
+                '        goto out;\n')
+
+        for field in prefix:
+            translations['field'] = utils.build_underscore_name_from_camelcase(field['name'])
+            translations['field_name'] = field['name']
+            translations['public'] = field['public-format'] if 'public-format' in field else field['format']
+            translations['offset'] = offsets[field['name']]
+
+            inner_template = (
+                '\n'
+                '    /* Read the \'${field_name}\' variable */\n')
+            if 'always-read' in field:
+                inner_template += (
+                    '    _${field} = GUINT32_FROM_LE (G_STRUCT_MEMBER (guint32, fixed, ${offset}));\n'
+                    '    if (out_${field} != NULL)\n'
+                    '        *out_${field} = _${field};\n')
+            elif field['format'] == 'guint32':
+                inner_template += (
+                    '    if (out_${field} != NULL)\n'
+                    '        *out_${field} = (${public}) GUINT32_FROM_LE (G_STRUCT_MEMBER (guint32, fixed, ${offset}));\n')
+            elif field['format'] == 'guint64':
+                inner_template += (
+                    '    if (out_${field} != NULL)\n'
+                    '        *out_${field} = (${public}) GUINT64_FROM_LE (G_STRUCT_MEMBER (guint64, fixed, ${offset}));\n')
+            elif field['format'] == 'uuid':
+                inner_template += (
+                    '    if (out_${field} != NULL)\n'
+                    '        *out_${field} = (const MbimUuid *) G_STRUCT_MEMBER_P (fixed, ${offset});\n')
+
+            template += (string.Template(inner_template).substitute(translations))
+
+        for field in fields[len(prefix):]:
             translations['field'] = utils.build_underscore_name_from_camelcase(field['name'])
             translations['field_format_underscore'] = utils.build_underscore_name_from_camelcase(field['format'])
             translations['field_name'] = field['name']
@@ -856,7 +1082,7 @@ class Message:
                     '        ${struct_type} *tmp;\n'
                     '        guint32 bytes_read = 0;\n'
                     '\n'
-                    '        tmp = _mbim_message_read_${struct_name}_struct (message, offset, &bytes_read, error);\n'
+                    '        tmp = _mbim_message_read_${struct_name}_struct (message, offset, NULL, &bytes_read, error);\n'
                     '        if (!tmp)\n'
                     '            goto out;\n'
                     '        if (out_${field} != NULL)\n'
@@ -953,7 +1179,9 @@ class Message:
                 elif field['format'] == 'struct':
                     inner_template = ('        ${struct_underscore}_free (_${field});\n')
                 elif field['format'] == 'struct-array' or field['format'] == 'ref-struct-array':
-                    inner_template = ('        ${struct_underscore}_array_free (_${field});\n')
+                    # arrays parsed into the thread default arena are owned by it
+                    inner_template = ('        if (!_mbim_arena_get_thread_default ())\n'
+                                      '            ${struct_underscore}_array_free (_${field});\n')
                 template += (string.Template(inner_template).substitute(translations))
             template += (
                 '    }\n')
@@ -972,357 +1200,307 @@ class Message:
 
 
     """
-    Emit message printable
+    Emit lazy field accessors, reading a single field in place
     """
-    def _emit_message_printable(self, cfile, message_type, fields):
-        translations = { 'message'                  : self.name,
-                         'underscore'               : utils.build_underscore_name(self.name),
-                         'service'                  : self.service,
-                         'underscore'               : utils.build_underscore_name (self.fullname),
-                         'message_type'             : message_type,
-                         'message_type_upper'       : message_type.upper(),
-                         'service_underscore_upper' : utils.build_underscore_name (self.service).upper() }
-        template = (
-            '\n'
-            'static gchar *\n'
-            '${underscore}_${message_type}_get_printable (\n'
-            '    const MbimMessage *message,\n'
-            '    const gchar *line_prefix,\n'
-            '    GError **error)\n'
-            '{\n'
-            '    GString *str;\n')
-
-        if fields != []:
-            template += (
-                '    GError *inner_error = NULL;\n'
-                '    guint32 offset = 0;\n')
+    def _emit_message_accessors(self, hfile, cfile, message_type, fields, since):
+        translations = { 'message'            : self.name,
+                         'service'            : self.service,
+                         'since'              : since if utils.version_compare('1.26', since) > 0 else '1.26',
+                         'underscore'         : utils.build_underscore_name (self.fullname),
+                         'message_type'       : message_type,
+                         'message_type_enum'  : 'MBIM_MESSAGE_TYPE_COMMAND_DONE' if message_type == 'response' else 'MBIM_MESSAGE_TYPE_INDICATE_STATUS' }
+
+        offsets = compute_static_offsets(fields)
+        for field in accessor_fields(fields):
+            translations['field'] = utils.build_underscore_name_from_camelcase(field['name'])
+            translations['name'] = field['name']
+            translations['public'] = field['public-format'] if 'public-format' in field else field['format']
+            translations['array_size'] = field['array-size'] if 'array-size' in field else ''
+            translations['offset'] = offsets[field['name']]
 
-        for field in fields:
-            if 'always-read' in field:
-                translations['field'] = utils.build_underscore_name_from_camelcase(field['name'])
-                inner_template = ('    guint32 _${field};\n')
-                template += (string.Template(inner_template).substitute(translations))
+            if field['format'] == 'byte-array':
+                doc_template = (' * @out_${field}: (out)(optional)(transfer none)(element-type guint8)(array fixed-size=${array_size}): return location for an array of ${array_size} #guint8 values. Do not free the returned value, it is owned by @message.\n')
+                args_template = ('    const guint8 **out_${field},\n')
+            elif field['format'] == 'ref-byte-array':
+                doc_template = (' * @out_${field}_size: (out)(optional): return location for the size of the ${field} array.\n'
+                                ' * @out_${field}: (out)(optional)(transfer none)(element-type guint8)(array length=out_${field}_size): return location for an array of #guint8 values. Do not free the returned value, it is owned by @message.\n')
+                args_template = ('    guint32 *out_${field}_size,\n'
+                                 '    const guint8 **out_${field},\n')
+            elif field['format'] == 'uuid':
+                doc_template = (' * @out_${field}: (out)(optional)(transfer none): return location for a #MbimUuid, or %NULL. Do not free the returned value, it is owned by @message.\n')
+                args_template = ('    const MbimUuid **out_${field},\n')
+            elif field['format'] == 'guint32' or field['format'] == 'guint64':
+                doc_template = (' * @out_${field}: (out)(optional)(transfer none): return location for a #${public}, or %NULL.\n')
+                args_template = ('    ${public} *out_${field},\n')
+            elif field['format'] == 'ipv4' or field['format'] == 'ref-ipv4':
+                doc_template = (' * @out_${field}: (out)(optional)(transfer none): return location for a #MbimIPv4, or %NULL. Do not free the returned value, it is owned by @message.\n')
+                args_template = ('    const MbimIPv4 **out_${field},\n')
+            elif field['format'] == 'ipv6' or field['format'] == 'ref-ipv6':
+                doc_template = (' * @out_${field}: (out)(optional)(transfer none): return location for a #MbimIPv6, or %NULL. Do not free the returned value, it is owned by @message.\n')
+                args_template = ('    const MbimIPv6 **out_${field},\n')
+            else:
+                raise ValueError('Cannot emit accessor for field type \'%s\'' % field['format'])
 
-        if message_type == 'response':
-            template += (
+            template = (
                 '\n'
-                '    if (!mbim_message_response_get_result (message, MBIM_MESSAGE_TYPE_COMMAND_DONE, NULL))\n'
-                '        return NULL;\n')
+                '/**\n'
+                ' * ${underscore}_${message_type}_get_${field}:\n'
+                ' * @message: the #MbimMessage.\n' +
+                doc_template +
+                ' * @error: return location for error or %NULL.\n'
+                ' *\n'
+                ' * Reads the \'${name}\' field of the \'${message}\' ${message_type} command in the \'${service}\' service,\n'
+                ' * without parsing or allocating any of the other fields in the message.\n'
+                ' *\n'
+                ' * Returns: %TRUE if the field was correctly read, %FALSE if @error is set.\n'
+                ' *\n'
+                ' * Since: ${since}\n'
+                ' */\n'
+                'gboolean ${underscore}_${message_type}_get_${field} (\n'
+                '    const MbimMessage *message,\n' +
+                args_template +
+                '    GError **error);\n')
+            hfile.write(string.Template(template).substitute(translations))
 
-        template += (
-            '\n'
-            '    str = g_string_new ("");\n')
+            template = (
+                '\n'
+                'gboolean\n'
+                '${underscore}_${message_type}_get_${field} (\n'
+                '    const MbimMessage *message,\n' +
+                args_template +
+                '    GError **error)\n'
+                '{\n')
 
-        for field in fields:
-            translations['field']                   = utils.build_underscore_name_from_camelcase(field['name'])
-            translations['field_format']            = field['format']
-            translations['field_format_underscore'] = utils.build_underscore_name_from_camelcase(field['format'])
-            translations['public']                  = field['public-format'] if 'public-format' in field else field['format']
-            translations['public_underscore']       = utils.build_underscore_name_from_camelcase(field['public-format']) if 'public-format' in field else ''
-            translations['public_underscore_upper'] = utils.build_underscore_name_from_camelcase(field['public-format']).upper() if 'public-format' in field else ''
-            translations['field_name']              = field['name']
-            translations['array_size_field']        = utils.build_underscore_name_from_camelcase(field['array-size-field']) if 'array-size-field' in field else ''
-            translations['struct_name']             = utils.build_underscore_name_from_camelcase(field['struct-type']) if 'struct-type' in field else ''
-            translations['struct_type']             = field['struct-type'] if 'struct-type' in field else ''
-            translations['array_size']              = field['array-size'] if 'array-size' in field else ''
+            if field['format'] == 'byte-array':
+                template += (
+                    '    const guint8 *tmp;\n')
+            elif field['format'] == 'ref-byte-array':
+                template += (
+                    '    const guint8 *tmp;\n'
+                    '    guint32 tmpsize;\n')
+            elif field['format'] == 'uuid':
+                template += (
+                    '    const MbimUuid *tmp;\n')
+            elif field['format'] == 'guint32':
+                template += (
+                    '    guint32 tmp;\n')
+            elif field['format'] == 'guint64':
+                template += (
+                    '    guint64 tmp;\n')
+            elif field['format'] == 'ipv4' or field['format'] == 'ref-ipv4':
+                template += (
+                    '    const MbimIPv4 *tmp;\n')
+            elif field['format'] == 'ipv6' or field['format'] == 'ref-ipv6':
+                template += (
+                    '    const MbimIPv6 *tmp;\n')
 
-            inner_template = (
+            template += (
                 '\n'
-                '    g_string_append_printf (str, "%s  ${field_name} = ", line_prefix);\n')
+                '    if (!_mbim_message_check_information_buffer (message, ${message_type_enum}, error))\n'
+                '        return FALSE;\n'
+                '\n')
 
-            if 'available-if' in field:
-                condition = field['available-if']
-                translations['condition_field'] = utils.build_underscore_name_from_camelcase(condition['field'])
-                translations['condition_operation'] = condition['operation']
-                translations['condition_value'] = condition['value']
-                inner_template += (
-                    '    if (_${condition_field} ${condition_operation} ${condition_value}) {\n')
-            else:
-                inner_template += (
-                    '    {\n')
+            if field['format'] == 'byte-array':
+                template += (
+                    '    if (!_mbim_message_read_byte_array (message, 0, ${offset}, FALSE, FALSE, ${array_size}, &tmp, NULL, error))\n'
+                    '        return FALSE;\n'
+                    '    if (out_${field} != NULL)\n'
+                    '        *out_${field} = tmp;\n')
+            elif field['format'] == 'ref-byte-array':
+                template += (
+                    '    if (!_mbim_message_read_byte_array (message, 0, ${offset}, TRUE, TRUE, 0, &tmp, &tmpsize, error))\n'
+                    '        return FALSE;\n'
+                    '    if (out_${field} != NULL)\n'
+                    '        *out_${field} = tmp;\n'
+                    '    if (out_${field}_size != NULL)\n'
+                    '        *out_${field}_size = tmpsize;\n')
+            elif field['format'] == 'uuid':
+                template += (
+                    '    if (!_mbim_message_read_uuid (message, ${offset}, &tmp, error))\n'
+                    '        return FALSE;\n'
+                    '    if (out_${field} != NULL)\n'
+                    '        *out_${field} = tmp;\n')
+            elif field['format'] == 'guint32' or field['format'] == 'guint64':
+                translations['read_format'] = field['format']
+                template += (
+                    '    if (!_mbim_message_read_${read_format} (message, ${offset}, &tmp, error))\n'
+                    '        return FALSE;\n'
+                    '    if (out_${field} != NULL)\n'
+                    '        *out_${field} = (${public})tmp;\n')
+            elif field['format'] == 'ipv4' or field['format'] == 'ref-ipv4':
+                translations['ref'] = 'TRUE' if field['format'] == 'ref-ipv4' else 'FALSE'
+                template += (
+                    '    if (!_mbim_message_read_ipv4 (message, ${offset}, ${ref}, &tmp, error))\n'
+                    '        return FALSE;\n'
+                    '    if (out_${field} != NULL)\n'
+                    '        *out_${field} = tmp;\n')
+            elif field['format'] == 'ipv6' or field['format'] == 'ref-ipv6':
+                translations['ref'] = 'TRUE' if field['format'] == 'ref-ipv6' else 'FALSE'
+                template += (
+                    '    if (!_mbim_message_read_ipv6 (message, ${offset}, ${ref}, &tmp, error))\n'
+                    '        return FALSE;\n'
+                    '    if (out_${field} != NULL)\n'
+                    '        *out_${field} = tmp;\n')
 
-            if 'always-read' in field:
-                inner_template += (
-                    '        if (!_mbim_message_read_guint32 (message, offset, &_${field}, &inner_error))\n'
-                    '            goto out;\n'
-                    '        offset += 4;\n'
-                    '        g_string_append_printf (str, "\'%" G_GUINT32_FORMAT "\'", _${field});\n')
+            template += (
+                '    return TRUE;\n'
+                '}\n')
+            cfile.write(string.Template(template).substitute(translations))
 
-            elif field['format'] == 'byte-array' or \
-                 field['format'] == 'unsized-byte-array' or \
-                 field['format'] == 'ref-byte-array' or \
-                 field['format'] == 'ref-byte-array-no-offset':
-                inner_template += (
-                    '        guint i;\n'
-                    '        const guint8 *tmp;\n'
-                    '        guint32 tmpsize;\n'
-                    '\n')
-                if field['format'] == 'byte-array':
-                    inner_template += (
-                        '        if (!_mbim_message_read_byte_array (message, 0, offset, FALSE, FALSE, ${array_size}, &tmp, NULL, &inner_error))\n'
-                        '            goto out;\n'
-                        '        tmpsize = ${array_size};\n'
-                        '        offset += ${array_size};\n')
-                elif field['format'] == 'unsized-byte-array':
-                    inner_template += (
-                        '        if (!_mbim_message_read_byte_array (message, 0, offset, FALSE, FALSE, 0, &tmp, &tmpsize, &inner_error))\n'
-                        '            goto out;\n'
-                        '        offset += tmpsize;\n')
+        for field in iterator_fields(fields):
+            translations['field'] = utils.build_underscore_name_from_camelcase(field['name'])
+            translations['name'] = field['name']
+            translations['struct'] = field['struct-type']
+            translations['struct_name'] = utils.build_underscore_name_from_camelcase(field['struct-type'])
+            translations['offset'] = offsets[field['name']]
+            translations['array_size_offset'] = offsets[field['array-size-field']]
+            translations['refs'] = 'TRUE' if field['format'] == 'ref-struct-array' else 'FALSE'
 
-                elif field['format'] == 'ref-byte-array':
-                    inner_template += (
-                        '        if (!_mbim_message_read_byte_array (message, 0, offset, TRUE, TRUE, 0, &tmp, &tmpsize, &inner_error))\n'
-                        '            goto out;\n'
-                        '        offset += 8;\n')
+            template = (
+                '\n'
+                '/**\n'
+                ' * ${underscore}_${message_type}_iter_${field}:\n'
+                ' * @message: the #MbimMessage.\n'
+                ' * @iter: (out caller-allocates): a #MbimStructArrayIter to initialize.\n'
+                ' * @error: return location for error or %NULL.\n'
+                ' *\n'
+                ' * Initializes @iter to walk in place the #${struct} elements of the \'${name}\' field\n'
+                ' * of the \'${message}\' ${message_type} command in the \'${service}\' service, without\n'
+                ' * parsing or allocating them.\n'
+                ' *\n'
+                ' * Returns: %TRUE if @iter was initialized, %FALSE if @error is set.\n'
+                ' *\n'
+                ' * Since: ${since}\n'
+                ' */\n'
+                'gboolean ${underscore}_${message_type}_iter_${field} (\n'
+                '    const MbimMessage *message,\n'
+                '    MbimStructArrayIter *iter,\n'
+                '    GError **error);\n')
+            hfile.write(string.Template(template).substitute(translations))
 
-                elif field['format'] == 'ref-byte-array-no-offset':
-                    inner_template += (
-                        '        if (!_mbim_message_read_byte_array (message, 0, offset, FALSE, TRUE, 0, &tmp, &tmpsize, &inner_error))\n'
-                        '            goto out;\n'
-                        '        offset += 4;\n')
+            template = (
+                '\n'
+                'gboolean\n'
+                '${underscore}_${message_type}_iter_${field} (\n'
+                '    const MbimMessage *message,\n'
+                '    MbimStructArrayIter *iter,\n'
+                '    GError **error)\n'
+                '{\n'
+                '    guint32 array_size;\n'
+                '\n'
+                '    g_return_val_if_fail (iter != NULL, FALSE);\n'
+                '\n'
+                '    if (!_mbim_message_check_information_buffer (message, ${message_type_enum}, error))\n'
+                '        return FALSE;\n'
+                '\n'
+                '    if (!_mbim_message_read_guint32 (message, ${array_size_offset}, &array_size, error))\n'
+                '        return FALSE;\n'
+                '    return _${struct_name}_struct_array_iter_init (iter, message, array_size, ${offset}, ${refs}, error);\n'
+                '}\n')
+            cfile.write(string.Template(template).substitute(translations))
 
-                inner_template += (
-                    '        g_string_append (str, "\'");\n'
-                    '        for (i = 0; i  < tmpsize; i++)\n'
-                    '            g_string_append_printf (str, "%02x%s", tmp[i], (i == (tmpsize - 1)) ? "" : ":" );\n'
-                    '        g_string_append (str, "\'");\n')
 
-            elif field['format'] == 'uuid':
-                inner_template += (
-                    '        const MbimUuid   *tmp;\n'
-                    '        g_autofree gchar *tmpstr = NULL;\n'
-                    '\n'
-                    '        if (!_mbim_message_read_uuid (message, offset, &tmp, &inner_error))\n'
-                    '            goto out;\n'
-                    '        offset += 16;\n'
-                    '        tmpstr = mbim_uuid_get_printable (tmp);\n'
-                    '        g_string_append_printf (str, "\'%s\'", tmpstr);\n')
+    """
+    Emit message printable
+    """
+    def _emit_message_printable(self, cfile, message_type, fields):
+        translations = { 'underscore'    : utils.build_underscore_name (self.fullname),
+                         'message_type'  : message_type }
 
-            elif field['format'] == 'guint32' or \
-                 field['format'] == 'guint64':
-                inner_template += (
-                    '        ${field_format} tmp;\n'
-                    '\n')
-                if field['format'] == 'guint32' :
-                    inner_template += (
-                        '        if (!_mbim_message_read_guint32 (message, offset, &tmp, &inner_error))\n'
-                        '            goto out;\n'
-                        '        offset += 4;\n')
-                elif field['format'] == 'guint64' :
-                    inner_template += (
-                        '        if (!_mbim_message_read_guint64 (message, offset, &tmp, &inner_error))\n'
-                        '            goto out;\n'
-                        '        offset += 8;\n')
+        # Fields are referred by their index in the table
+        indices = {}
+        for i, field in enumerate(fields):
+            indices[field['name']] = i
 
-                if 'public-format' in field:
+        if fields != []:
+            template = (
+                '\n'
+                'static const MbimFieldDescriptor ${underscore}_${message_type}_fields[] = {\n')
+            for field in fields:
+                translations['field_name']       = field['name']
+                translations['field_format']     = utils.build_underscore_name(field['format']).upper()
+                translations['array_size_field'] = indices[field['array-size-field']] if 'array-size-field' in field else -1
+                translations['array_size']       = field['array-size'] if 'array-size' in field else '0'
+                translations['struct_name']      = utils.build_underscore_name_from_camelcase(field['struct-type']) if 'struct-type' in field else ''
+
+                if field['format'] not in ['guint32', 'guint64', 'uuid', 'string', 'string-array',
+                                           'byte-array', 'unsized-byte-array', 'ref-byte-array', 'ref-byte-array-no-offset',
+                                           'struct', 'struct-array', 'ref-struct-array',
+                                           'ipv4', 'ref-ipv4', 'ipv4-array', 'ipv6', 'ref-ipv6', 'ipv6-array']:
+                    raise ValueError('Field format \'%s\' not printable' % field['format'])
+
+                if 'available-if' in field:
+                    condition = field['available-if']
+                    if condition['operation'] != '==':
+                        raise ValueError('Condition operation \'%s\' not printable' % condition['operation'])
+                    translations['condition_field'] = indices[condition['field']]
+                    translations['condition_value'] = condition['value']
+                else:
+                    translations['condition_field'] = -1
+                    translations['condition_value'] = '0'
+
+                inner_template = (
+                    '    { "${field_name}", MBIM_FIELD_FORMAT_${field_format}, ${array_size_field}, ${condition_field}, ${condition_value}, ${array_size},\n')
+
+                # Fields always read are printed as plain numbers
+                if 'public-format' in field and 'always-read' not in field:
+                    translations['public']                  = field['public-format']
+                    translations['public_underscore']       = utils.build_underscore_name_from_camelcase(field['public-format'])
+                    translations['public_underscore_upper'] = utils.build_underscore_name_from_camelcase(field['public-format']).upper()
                     inner_template += (
                         '#if defined __${public_underscore_upper}_IS_ENUM__\n'
-                        '        g_string_append_printf (str, "\'%s\'", ${public_underscore}_get_string ((${public})tmp));\n'
+                        '      (MbimFieldEnumGetStringFunc) ${public_underscore}_get_string, NULL,\n'
                         '#elif defined __${public_underscore_upper}_IS_FLAGS__\n'
-                        '        {\n'
-                        '            g_autofree gchar *tmpstr = NULL;\n'
-                        '\n'
-                        '            tmpstr = ${public_underscore}_build_string_from_mask ((${public})tmp);\n'
-                        '            g_string_append_printf (str, "\'%s\'", tmpstr);\n'
-                        '        }\n'
+                        '      NULL, (MbimFieldFlagsBuildStringFunc) ${public_underscore}_build_string_from_mask,\n'
                         '#else\n'
                         '# error neither enum nor flags\n'
-                        '#endif\n'
-                        '\n')
-                elif field['format'] == 'guint32':
-                    inner_template += (
-                        '        g_string_append_printf (str, "\'%" G_GUINT32_FORMAT "\'", tmp);\n')
-                elif field['format'] == 'guint64':
-                    inner_template += (
-                        '        g_string_append_printf (str, "\'%" G_GUINT64_FORMAT "\'", tmp);\n')
-
-            elif field['format'] == 'string':
-                inner_template += (
-                    '        g_autofree gchar *tmp = NULL;\n'
-                    '\n'
-                    '        if (!_mbim_message_read_string (message, 0, offset, &tmp, &inner_error))\n'
-                    '            goto out;\n'
-                    '        offset += 8;\n'
-                    '        g_string_append_printf (str, "\'%s\'", tmp);\n')
-
-            elif field['format'] == 'string-array':
-                inner_template += (
-                    '        g_auto(GStrv) tmp = NULL;\n'
-                    '        guint i;\n'
-                    '\n'
-                    '        if (!_mbim_message_read_string_array (message, _${array_size_field}, 0, offset, &tmp, &inner_error))\n'
-                    '            goto out;\n'
-                    '        offset += (8 * _${array_size_field});\n'
-                    '\n'
-                    '        g_string_append (str, "\'");\n'
-                    '        for (i = 0; i < _${array_size_field}; i++) {\n'
-                    '            g_string_append (str, tmp[i]);\n'
-                    '            if (i < (_${array_size_field} - 1))\n'
-                    '                g_string_append (str, ", ");\n'
-                    '        }\n'
-                    '        g_string_append (str, "\'");\n')
-
-            elif field['format'] == 'struct':
-                inner_template += (
-                    '        g_autoptr(${struct_type}) tmp = NULL;\n'
-                    '        g_autofree gchar *new_line_prefix = NULL;\n'
-                    '        g_autofree gchar *struct_str = NULL;\n'
-                    '        guint32 bytes_read = 0;\n'
-                    '\n'
-                    '        tmp = _mbim_message_read_${struct_name}_struct (message, offset, &bytes_read, &inner_error);\n'
-                    '        if (!tmp)\n'
-                    '            goto out;\n'
-                    '        offset += bytes_read;\n'
-                    '        g_string_append (str, "{\\n");\n'
-                    '        new_line_prefix = g_strdup_printf ("%s    ", line_prefix);\n'
-                    '        struct_str = _mbim_message_print_${struct_name}_struct (tmp, new_line_prefix);\n'
-                    '        g_string_append (str, struct_str);\n'
-                    '        g_string_append_printf (str, "%s  }\\n", line_prefix);\n')
-
-            elif field['format'] == 'struct-array' or field['format'] == 'ref-struct-array':
-                inner_template += (
-                    '        g_autoptr(${struct_type}Array) tmp = NULL;\n'
-                    '        g_autofree gchar *new_line_prefix = NULL;\n'
-                    '        guint i;\n'
-                    '\n')
-
-                if field['format'] == 'struct-array':
-                    inner_template += (
-                    '        if (!_mbim_message_read_${struct_name}_struct_array (message, _${array_size_field}, offset, FALSE, &tmp, &inner_error))\n'
-                    '            goto out;\n'
-                    '        offset += 4;\n')
-                elif field['format'] == 'ref-struct-array':
-                    inner_template += (
-                    '        if (!_mbim_message_read_${struct_name}_struct_array (message, _${array_size_field}, offset, TRUE, &tmp, &inner_error))\n'
-                    '            goto out;\n'
-                    '        offset += (8 * _${array_size_field});\n')
-
-                inner_template += (
-                    '        new_line_prefix = g_strdup_printf ("%s        ", line_prefix);\n'
-                    '        g_string_append (str, "\'{\\n");\n'
-                    '        for (i = 0; i < _${array_size_field}; i++) {\n'
-                    '            g_autofree gchar *struct_str = NULL;\n'
-                    '\n'
-                    '            g_string_append_printf (str, "%s    [%u] = {\\n", line_prefix, i);\n'
-                    '            struct_str = _mbim_message_print_${struct_name}_struct (tmp[i], new_line_prefix);\n'
-                    '            g_string_append (str, struct_str);\n'
-                    '            g_string_append_printf (str, "%s    },\\n", line_prefix);\n'
-                    '        }\n'
-                    '        g_string_append_printf (str, "%s  }\'", line_prefix);\n')
-
-            elif field['format'] == 'ipv4' or \
-                 field['format'] == 'ref-ipv4' or \
-                 field['format'] == 'ipv4-array' or \
-                 field['format'] == 'ipv6' or \
-                 field['format'] == 'ref-ipv6' or \
-                 field['format'] == 'ipv6-array':
-                if field['format'] == 'ipv4' or \
-                   field['format'] == 'ref-ipv4':
-                    inner_template += (
-                        '        const MbimIPv4 *tmp;\n')
-                elif field['format'] == 'ipv4-array':
-                    inner_template += (
-                        '        g_autofree MbimIPv4 *tmp = NULL;\n')
-                elif field['format'] == 'ipv6' or \
-                     field['format'] == 'ref-ipv6':
-                    inner_template += (
-                        '        const MbimIPv6 *tmp;\n')
-                elif field['format'] == 'ipv6-array':
-                    inner_template += (
-                        '        g_autofree MbimIPv6 *tmp = NULL;\n')
-
-                inner_template += (
-                    '        guint array_size;\n'
-                    '        guint i;\n'
-                    '\n')
-
-                if field['format'] == 'ipv4':
-                    inner_template += (
-                        '        array_size = 1;\n'
-                        '        if (!_mbim_message_read_ipv4 (message, offset, FALSE, &tmp, &inner_error))\n'
-                        '            goto out;\n'
-                        '        offset += 4;\n')
-                elif field['format'] == 'ref-ipv4':
-                    inner_template += (
-                        '        array_size = 1;\n'
-                        '        if (!_mbim_message_read_ipv4 (message, offset, TRUE, &tmp, &inner_error))\n'
-                        '            goto out;\n'
-                        '        offset += 4;\n')
-                elif field['format'] == 'ipv4-array':
-                    inner_template += (
-                        '        array_size = _${array_size_field};\n'
-                        '        if (!_mbim_message_read_ipv4_array (message, _${array_size_field}, offset, &tmp, &inner_error))\n'
-                        '            goto out;\n'
-                        '        offset += 4;\n')
-                elif field['format'] == 'ipv6':
-                    inner_template += (
-                        '        array_size = 1;\n'
-                        '        if (!_mbim_message_read_ipv6 (message, offset, FALSE, &tmp, &inner_error))\n'
-                        '            goto out;\n'
-                        '        offset += 16;\n')
-                elif field['format'] == 'ref-ipv6':
-                    inner_template += (
-                        '        array_size = 1;\n'
-                        '        if (!_mbim_message_read_ipv6 (message, offset, TRUE, &tmp, &inner_error))\n'
-                        '            goto out;\n'
-                        '        offset += 4;\n')
-                elif field['format'] == 'ipv6-array':
+                        '#endif\n')
+                else:
                     inner_template += (
-                        '        array_size = _${array_size_field};\n'
-                        '        if (!_mbim_message_read_ipv6_array (message, _${array_size_field}, offset, &tmp, &inner_error))\n'
-                        '            goto out;\n'
-                        '        offset += 4;\n')
+                        '      NULL, NULL,\n')
 
-                inner_template += (
-                    '        g_string_append (str, "\'");\n'
-                    '        if (tmp) {\n'
-                    '            for (i = 0; i < array_size; i++) {\n'
-                    '                g_autoptr(GInetAddress)  addr = NULL;\n'
-                    '                g_autofree gchar        *tmpstr = NULL;\n'
-                    '\n')
-
-                if field['format'] == 'ipv4' or \
-                   field['format'] == 'ref-ipv4' or \
-                   field['format'] == 'ipv4-array':
+                if 'struct-type' in field:
                     inner_template += (
-                        '                addr = g_inet_address_new_from_bytes ((guint8 *)&(tmp[i].addr), G_SOCKET_FAMILY_IPV4);\n')
-                elif field['format'] == 'ipv6' or \
-                     field['format'] == 'ref-ipv6' or \
-                     field['format'] == 'ipv6-array':
+                        '      &${struct_name}_struct_descriptor },\n')
+                else:
                     inner_template += (
-                        '                addr = g_inet_address_new_from_bytes ((guint8 *)&(tmp[i].addr), G_SOCKET_FAMILY_IPV6);\n')
+                        '      NULL },\n')
 
-                inner_template += (
-                    '                tmpstr = g_inet_address_to_string (addr);\n'
-                    '                g_string_append_printf (str, "%s", tmpstr);\n'
-                    '                if (i < (array_size - 1))\n'
-                    '                    g_string_append (str, ", ");\n'
-                    '            }\n'
-                    '        }\n'
-                    '        g_string_append (str, "\'");\n')
+                template += string.Template(inner_template).substitute(translations)
 
-            else:
-                raise ValueError('Field format \'%s\' not printable' % field['format'])
+            template += (
+                '};\n')
+            cfile.write(string.Template(template).substitute(translations))
 
-            inner_template += (
-                '    }\n'
-                '    g_string_append (str, "\\n");\n')
+        template = (
+            '\n'
+            'static gboolean\n'
+            '${underscore}_${message_type}_get_printable (\n'
+            '    const MbimMessage *message,\n'
+            '    GString *str,\n'
+            '    const gchar *line_prefix,\n'
+            '    GError **error)\n'
+            '{\n')
 
-            template += (string.Template(inner_template).substitute(translations))
+        if message_type == 'response':
+            template += (
+                '    if (!mbim_message_response_get_result (message, MBIM_MESSAGE_TYPE_COMMAND_DONE, NULL))\n'
+                '        return FALSE;\n'
+                '\n')
 
         if fields != []:
             template += (
-                '\n'
-                ' out:\n'
-                '    if (inner_error) {\n'
-                '        g_string_append_printf (str, "n/a: %s", inner_error->message);\n'
-                '        g_clear_error (&inner_error);\n'
-                '    }\n')
-
-        template += (
-            '\n'
-            '    return g_string_free (str, FALSE);\n'
-            '}\n')
+                '    return _mbim_message_print_fields (message,\n'
+                '                                       ${underscore}_${message_type}_fields,\n'
+                '                                       G_N_ELEMENTS (${underscore}_${message_type}_fields),\n'
+                '                                       str,\n'
+                '                                       line_prefix,\n'
+                '                                       error);\n'
+                '}\n')
+        else:
+            template += (
+                '    return TRUE;\n'
+                '}\n')
         cfile.write(string.Template(template).substitute(translations))
 
 
@@ -1347,13 +1525,37 @@ class Message:
             template = (
                 '${underscore}_set_new\n')
             sfile.write(string.Template(template).substitute(translations))
+            if self.has_set_parser:
+                template = (
+                    '${underscore}_set_parse\n')
+                sfile.write(string.Template(template).substitute(translations))
 
         if self.has_response:
             template = (
                 '${underscore}_response_parse\n')
             sfile.write(string.Template(template).substitute(translations))
+            for field in accessor_fields(self.response):
+                translations['field'] = utils.build_underscore_name_from_camelcase(field['name'])
+                template = (
+                    '${underscore}_response_get_${field}\n')
+                sfile.write(string.Template(template).substitute(translations))
+            for field in iterator_fields(self.response):
+                translations['field'] = utils.build_underscore_name_from_camelcase(field['name'])
+                template = (
+                    '${underscore}_response_iter_${field}\n')
+                sfile.write(string.Template(template).substitute(translations))
 
         if self.has_notification:
             template = (
                 '${underscore}_notification_parse\n')
             sfile.write(string.Template(template).substitute(translations))
+            for field in accessor_fields(self.notification):
+                translations['field'] = utils.build_underscore_name_from_camelcase(field['name'])
+                template = (
+                    '${underscore}_notification_get_${field}\n')
+                sfile.write(string.Template(template).substitute(translations))
+            for field in iterator_fields(self.notification):
+                translations['field'] = utils.build_underscore_name_from_camelcase(field['name'])
+                template = (
+                    '${underscore}_notification_iter_${field}\n')
+                sfile.write(string.Template(template).substitute(translations))
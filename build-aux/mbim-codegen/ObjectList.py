@@ -103,9 +103,10 @@ class ObjectList:
             '#if defined (LIBMBIM_GLIB_COMPILATION)\n'
             '\n'
             'G_GNUC_INTERNAL\n'
-            'gchar *\n'
+            'gboolean\n'
             '__mbim_message_${service_underscore}_get_printable_fields (\n'
             '    const MbimMessage *message,\n'
+            '    GString *str,\n'
             '    const gchar *line_prefix,\n'
             '    GError **error);\n'
             '\n'
@@ -115,10 +116,10 @@ class ObjectList:
         template = (
             '\n'
             'typedef struct {\n'
-            '  gchar * (* query_cb)        (const MbimMessage *message, const gchar *line_prefix, GError **error);\n'
-            '  gchar * (* set_cb)          (const MbimMessage *message, const gchar *line_prefix, GError **error);\n'
-            '  gchar * (* response_cb)     (const MbimMessage *message, const gchar *line_prefix, GError **error);\n'
-            '  gchar * (* notification_cb) (const MbimMessage *message, const gchar *line_prefix, GError **error);\n'
+            '  gboolean (* query_cb)        (const MbimMessage *message, GString *str, const gchar *line_prefix, GError **error);\n'
+            '  gboolean (* set_cb)          (const MbimMessage *message, GString *str, const gchar *line_prefix, GError **error);\n'
+            '  gboolean (* response_cb)     (const MbimMessage *message, GString *str, const gchar *line_prefix, GError **error);\n'
+            '  gboolean (* notification_cb) (const MbimMessage *message, GString *str, const gchar *line_prefix, GError **error);\n'
             '} GetPrintableCallbacks;\n'
             '\n'
             'static const GetPrintableCallbacks get_printable_callbacks[] = {\n')
@@ -147,9 +148,10 @@ class ObjectList:
         template += (
             '};\n'
             '\n'
-            'gchar *\n'
+            'gboolean\n'
             '__mbim_message_${service_underscore}_get_printable_fields (\n'
             '    const MbimMessage *message,\n'
+            '    GString *str,\n'
             '    const gchar *line_prefix,\n'
             '    GError **error)\n'
             '{\n'
@@ -162,11 +164,11 @@ class ObjectList:
             '                switch (mbim_message_command_get_command_type (message)) {\n'
             '                    case MBIM_MESSAGE_COMMAND_TYPE_QUERY:\n'
             '                        if (get_printable_callbacks[cid].query_cb)\n'
-            '                            return get_printable_callbacks[cid].query_cb (message, line_prefix, error);\n'
+            '                            return get_printable_callbacks[cid].query_cb (message, str, line_prefix, error);\n'
             '                        break;\n'
             '                    case MBIM_MESSAGE_COMMAND_TYPE_SET:\n'
             '                        if (get_printable_callbacks[cid].set_cb)\n'
-            '                            return get_printable_callbacks[cid].set_cb (message, line_prefix, error);\n'
+            '                            return get_printable_callbacks[cid].set_cb (message, str, line_prefix, error);\n'
             '                        break;\n'
             '                    case MBIM_MESSAGE_COMMAND_TYPE_UNKNOWN:\n'
             '                    default:\n'
@@ -174,7 +176,7 @@ class ObjectList:
             '                                     MBIM_CORE_ERROR,\n'
             '                                     MBIM_CORE_ERROR_INVALID_MESSAGE,\n'
             '                                     \"Invalid command type\");\n'
-            '                        return NULL;\n'
+            '                        return FALSE;\n'
             '                }\n'
             '            }\n'
             '            break;\n'
@@ -184,7 +186,7 @@ class ObjectList:
             '            cid = mbim_message_command_done_get_cid (message);\n'
             '            if (cid < G_N_ELEMENTS (get_printable_callbacks)) {\n'
             '                if (get_printable_callbacks[cid].response_cb)\n'
-            '                    return get_printable_callbacks[cid].response_cb (message, line_prefix, error);\n'
+            '                    return get_printable_callbacks[cid].response_cb (message, str, line_prefix, error);\n'
             '            }\n'
             '            break;\n'
             '\n'
@@ -192,7 +194,7 @@ class ObjectList:
             '            cid = mbim_message_indicate_status_get_cid (message);\n'
             '            if (cid < G_N_ELEMENTS (get_printable_callbacks)) {\n'
             '                if (get_printable_callbacks[cid].notification_cb)\n'
-            '                    return get_printable_callbacks[cid].notification_cb (message, line_prefix, error);\n'
+            '                    return get_printable_callbacks[cid].notification_cb (message, str, line_prefix, error);\n'
             '            }\n'
             '            break;\n'
             '\n'
@@ -208,14 +210,14 @@ class ObjectList:
             '                         MBIM_CORE_ERROR,\n'
             '                         MBIM_CORE_ERROR_INVALID_MESSAGE,\n'
             '                         \"No contents expected in this message type\");\n'
-            '            return NULL;\n'
+            '            return FALSE;\n'
             '    }\n'
             '\n'
             '    g_set_error (error,\n'
             '                 MBIM_CORE_ERROR,\n'
             '                 MBIM_CORE_ERROR_INVALID_MESSAGE,\n'
             '                 \"Unknown contents\");\n'
-            '    return NULL;\n'
+            '    return FALSE;\n'
             '}\n')
 
         cfile.write(string.Template(template).substitute(translations))
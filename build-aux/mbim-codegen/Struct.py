@@ -20,6 +20,36 @@
 import string
 import utils
 
+"""
+Compute the offsets of the struct fields which are found at a fixed location
+from the start of the struct, i.e. those only preceded by fixed-size fields
+"""
+def compute_static_offsets(contents):
+    offsets = {}
+    offset = 0
+    for field in contents:
+        offsets[field['name']] = offset
+        if field['format'] in ['guint32', 'ipv4']:
+            offset += 4
+        elif field['format'] in ['guint64', 'string']:
+            offset += 8
+        elif field['format'] in ['uuid', 'ipv6']:
+            offset += 16
+        else:
+            break
+    return offsets
+
+
+"""
+List the struct fields for which iterator accessors are generated
+"""
+def iter_accessor_fields(contents):
+    offsets = compute_static_offsets(contents)
+    return [field for field in contents
+            if field['name'] in offsets and
+               field['format'] in ['guint32', 'guint64', 'uuid', 'ipv4', 'ipv6']]
+
+
 """
 The Struct class takes care of emitting the struct type
 """
@@ -300,22 +330,20 @@ class Struct:
 
         template = (
             '\n'
-            'static gchar *\n'
+            'static void\n'
             '_mbim_message_print_${name_underscore}_struct (\n'
             '    const ${name} *self,\n'
-            '    const gchar *line_prefix)\n'
-            '{\n'
-            '    GString *str;\n'
-            '\n'
-            '    str = g_string_new ("");\n'
-            '\n')
+            '    GString *str,\n'
+            '    const gchar *line_prefix,\n'
+            '    const gchar *indent)\n'
+            '{\n')
 
         for field in self.contents:
             translations['field_name'] = field['name']
             translations['field_name_underscore'] = utils.build_underscore_name_from_camelcase(field['name'])
 
             inner_template = (
-                '    g_string_append_printf (str, "%s  ${field_name} = ", line_prefix);\n'
+                '    g_string_append_printf (str, "%s%s  ${field_name} = ", line_prefix, indent);\n'
                 '    {\n')
 
             if field['format'] == 'uuid':
@@ -328,6 +356,7 @@ class Struct:
 
             elif field['format'] in ['byte-array', 'ref-byte-array', 'ref-byte-array-no-offset', 'unsized-byte-array']:
                 inner_template += (
+                    '        static const gchar hex_digits[] = "0123456789abcdef";\n'
                     '        guint i;\n'
                     '        guint array_size;\n'
                     '\n')
@@ -345,10 +374,14 @@ class Struct:
                         '        array_size = self->${field_name_underscore}_size;\n')
 
                 inner_template += (
-                    '        g_string_append (str, "\'");\n'
-                    '        for (i = 0; i < array_size; i++)\n'
-                    '            g_string_append_printf (str, "%02x%s", self->${field_name_underscore}[i], (i == (array_size - 1)) ? "" : ":" );\n'
-                    '        g_string_append (str, "\'");\n')
+                    '        g_string_append_c (str, \'\\\'\');\n'
+                    '        for (i = 0; i < array_size; i++) {\n'
+                    '            if (i > 0)\n'
+                    '                g_string_append_c (str, \':\');\n'
+                    '            g_string_append_c (str, hex_digits[self->${field_name_underscore}[i] >> 4]);\n'
+                    '            g_string_append_c (str, hex_digits[self->${field_name_underscore}[i] & 0x0F]);\n'
+                    '        }\n'
+                    '        g_string_append_c (str, \'\\\'\');\n')
 
             elif field['format'] == 'guint32':
                 inner_template += (
@@ -413,7 +446,6 @@ class Struct:
             template += (string.Template(inner_template).substitute(translations))
 
         template += (
-            '    return g_string_free (str, FALSE);\n'
             '}\n')
         cfile.write(string.Template(template).substitute(translations))
 
@@ -431,6 +463,7 @@ class Struct:
             '_mbim_message_read_${name_underscore}_struct (\n'
             '    const MbimMessage *self,\n'
             '    guint32 relative_offset,\n'
+            '    MbimArena *arena,\n'
             '    guint32 *bytes_read,\n'
             '    GError **error)\n'
             '{\n'
@@ -440,7 +473,7 @@ class Struct:
             '\n'
             '    g_assert (self != NULL);\n'
             '\n'
-            '    out = g_new0 (${name}, 1);\n')
+            '    out = _mbim_arena_alloc0 (arena, sizeof (${name}));\n')
 
         for field in self.contents:
             translations['field_name_underscore'] = utils.build_underscore_name_from_camelcase(field['name'])
@@ -468,8 +501,7 @@ class Struct:
                         '\n'
                         '        if (!_mbim_message_read_byte_array (self, relative_offset, offset, ${has_offset}, FALSE, out->${array_size_field_name_underscore}, &tmp, NULL, error))\n'
                         '            goto out;\n'
-                        '        out->${field_name_underscore} = g_malloc (out->${array_size_field_name_underscore});\n'
-                        '        memcpy (out->${field_name_underscore}, tmp, out->${array_size_field_name_underscore});\n'
+                        '        out->${field_name_underscore} = _mbim_arena_memdup (arena, tmp, out->${array_size_field_name_underscore});\n'
                         '        offset += 4;\n'
                         '    }\n')
                 else:
@@ -480,8 +512,7 @@ class Struct:
                         '\n'
                         '        if (!_mbim_message_read_byte_array (self, relative_offset, offset, ${has_offset}, TRUE, 0, &tmp, &(out->${field_name_underscore}_size), error))\n'
                         '            goto out;\n'
-                        '        out->${field_name_underscore} = g_malloc (out->${field_name_underscore}_size);\n'
-                        '        memcpy (out->${field_name_underscore}, tmp, out->${field_name_underscore}_size);\n'
+                        '        out->${field_name_underscore} = _mbim_arena_memdup (arena, tmp, out->${field_name_underscore}_size);\n'
                         '        offset += 8;\n'
                         '    }\n')
             elif field['format'] == 'unsized-byte-array':
@@ -492,8 +523,7 @@ class Struct:
                     '\n'
                     '        if (!_mbim_message_read_byte_array (self, relative_offset, offset, FALSE, FALSE, 0, &tmp, &(out->${field_name_underscore}_size), error))\n'
                     '            goto out;\n'
-                    '        out->${field_name_underscore} = g_malloc (out->${field_name_underscore}_size);\n'
-                    '        memcpy (out->${field_name_underscore}, tmp, out->${field_name_underscore}_size);\n'
+                    '        out->${field_name_underscore} = _mbim_arena_memdup (arena, tmp, out->${field_name_underscore}_size);\n'
                     '        /* no offset update expected, this should be the last field */\n'
                     '    }\n')
             elif field['format'] == 'byte-array':
@@ -518,7 +548,7 @@ class Struct:
                 translations['array_size_field_name_underscore'] = utils.build_underscore_name_from_camelcase(field['array-size-field'])
                 inner_template += (
                     '\n'
-                    '    if (!_mbim_message_read_guint32_array (self, out->${array_size_field_name_underscore}, offset, &out->${field_name_underscore}, error))\n'
+                    '    if (!_mbim_message_read_guint32_array_full (self, out->${array_size_field_name_underscore}, offset, arena, &out->${field_name_underscore}, error))\n'
                     '        goto out;\n'
                     '    offset += (4 * out->${array_size_field_name_underscore});\n')
             elif field['format'] == 'guint64':
@@ -530,14 +560,14 @@ class Struct:
             elif field['format'] == 'string':
                 inner_template += (
                     '\n'
-                    '    if (!_mbim_message_read_string (self, relative_offset, offset, &out->${field_name_underscore}, error))\n'
+                    '    if (!_mbim_message_read_string_full (self, relative_offset, offset, arena, &out->${field_name_underscore}, error))\n'
                     '        goto out;\n'
                     '    offset += 8;\n')
             elif field['format'] == 'string-array':
                 translations['array_size_field_name_underscore'] = utils.build_underscore_name_from_camelcase(field['array-size-field'])
                 inner_template += (
                     '\n'
-                    '    if (!_mbim_message_read_string_array (self, out->${array_size_field_name_underscore}, relative_offset, offset, &out->${field_name_underscore}, error))\n'
+                    '    if (!_mbim_message_read_string_array_full (self, out->${array_size_field_name_underscore}, relative_offset, offset, arena, &out->${field_name_underscore}, error))\n'
                     '        goto out;\n'
                     '    offset += (8 * out->${array_size_field_name_underscore});\n')
             elif field['format'] == 'ipv4':
@@ -599,19 +629,22 @@ class Struct:
             '            *bytes_read = (offset - relative_offset);\n'
             '        return out;\n'
             '    }\n'
-            '\n')
+            '\n'
+            '    /* Contents allocated in the arena are released along with it */\n'
+            '    if (!arena) {\n')
 
         for field in self.contents:
             translations['field_name_underscore'] = utils.build_underscore_name_from_camelcase(field['name'])
             inner_template = ''
             if field['format'] in ['ref-byte-array', 'ref-byte-array-no-offset', 'unsized-byte-array', 'byte-array', 'string']:
-                inner_template = ('    g_free (out->${field_name_underscore});\n')
+                inner_template = ('        g_free (out->${field_name_underscore});\n')
             elif field['format'] == 'string-array':
-                inner_template = ('    g_strfreev (out->${field_name_underscore});\n')
+                inner_template = ('        g_strfreev (out->${field_name_underscore});\n')
             template += string.Template(inner_template).substitute(translations)
 
         template += (
-            '    g_free (out);\n'
+            '        g_free (out);\n'
+            '    }\n'
             '    return NULL;\n'
             '}\n')
         cfile.write(string.Template(template).substitute(translations))
@@ -629,6 +662,7 @@ class Struct:
                 '    GError **error)\n'
                 '{\n'
                 '    GError *inner_error = NULL;\n'
+                '    MbimArena *arena;\n'
                 '    ${name}Array *out;\n'
                 '    guint32 i;\n'
                 '    guint32 offset;\n'
@@ -638,19 +672,23 @@ class Struct:
                 '        return TRUE;\n'
                 '    }\n'
                 '\n'
-                '    out = g_new0 (${name} *, array_size + 1);\n'
+                '    /* Each element takes at least its fixed size, or its offset/size pair */\n'
+                '    if (!_mbim_message_struct_array_prepare (self, array_size, refs ? 8 : ${struct_size}, sizeof (${name}), &arena, error))\n'
+                '        return FALSE;\n'
+                '\n'
+                '    out = _mbim_arena_alloc0_n (arena, (gsize) array_size + 1, sizeof (${name} *));\n'
                 '\n'
                 '    if (!refs) {\n'
                 '        _mbim_message_read_guint32 (self, relative_offset_array_start, &offset, &inner_error);\n'
                 '        for (i = 0; !inner_error && (i < array_size); i++, offset += ${struct_size})\n'
-                '            out[i] = _mbim_message_read_${name_underscore}_struct (self, offset, NULL, &inner_error);\n'
+                '            out[i] = _mbim_message_read_${name_underscore}_struct (self, offset, arena, NULL, &inner_error);\n'
                 '    } else {\n'
                 '        offset = relative_offset_array_start;\n'
                 '        for (i = 0; !inner_error && (i < array_size); i++, offset += 8) {\n'
                 '            guint32 tmp_offset;\n'
                 '\n'
                 '            if (_mbim_message_read_guint32 (self, offset, &tmp_offset, &inner_error))\n'
-                '                out[i] = _mbim_message_read_${name_underscore}_struct (self, tmp_offset, NULL, &inner_error);\n'
+                '                out[i] = _mbim_message_read_${name_underscore}_struct (self, tmp_offset, arena, NULL, &inner_error);\n'
                 '        }\n'
                 '    }\n'
                 '\n'
@@ -659,13 +697,48 @@ class Struct:
                 '        return TRUE;\n'
                 '    }\n'
                 '\n'
-                '    ${name_underscore}_array_free (out);\n'
+                '    /* Whatever was allocated in the arena is released along with it */\n'
+                '    if (!arena)\n'
+                '        ${name_underscore}_array_free (out);\n'
                 '    g_propagate_error (error, inner_error);\n'
                 '    return FALSE;\n'
                 '}\n')
             cfile.write(string.Template(template).substitute(translations))
 
 
+    """
+    Emit the type's descriptor, used when printing messages
+    """
+    def _emit_descriptor(self, cfile):
+        if not self.single_member and not self.array_member:
+            return
+
+        translations = { 'name_underscore' : utils.build_underscore_name_from_camelcase(self.name) }
+
+        template = (
+            '\n'
+            'static const MbimStructDescriptor ${name_underscore}_struct_descriptor = {\n'
+            '    (MbimStructReadFunc) _mbim_message_read_${name_underscore}_struct,\n')
+        if self.array_member:
+            template += (
+                '    (MbimStructArrayReadFunc) _mbim_message_read_${name_underscore}_struct_array,\n')
+        else:
+            template += (
+                '    NULL,\n')
+        template += (
+            '    (MbimStructPrintFunc) _mbim_message_print_${name_underscore}_struct,\n'
+            '    (GDestroyNotify) _${name_underscore}_free,\n')
+        if self.array_member:
+            template += (
+                '    (GDestroyNotify) ${name_underscore}_array_free,\n')
+        else:
+            template += (
+                '    NULL,\n')
+        template += (
+            '};\n')
+        cfile.write(string.Template(template).substitute(translations))
+
+
     """
     Emit the type's append methods
     """
@@ -674,16 +747,29 @@ class Struct:
                          'name_underscore' : utils.build_underscore_name_from_camelcase(self.name),
                          'struct_size'     : self.size }
 
-        template = (
+        size_template = (
             '\n'
-            'static GByteArray *\n'
-            '_${name_underscore}_struct_new (const ${name} *value)\n'
+            'static void\n'
+            '_${name_underscore}_struct_size (\n'
+            '    gconstpointer _value,\n'
+            '    guint32 *fixed_size,\n'
+            '    guint32 *variable_size)\n'
             '{\n'
-            '    MbimStructBuilder *builder;\n'
+            '    const ${name} *value = (const ${name} *)_value;\n'
             '\n'
             '    g_assert (value != NULL);\n'
+            '\n')
+        write_template = (
             '\n'
-            '    builder = _mbim_struct_builder_new ();\n')
+            'static void\n'
+            '_${name_underscore}_struct_write (\n'
+            '    MbimStructBuilder *builder,\n'
+            '    gconstpointer _value)\n'
+            '{\n'
+            '    const ${name} *value = (const ${name} *)_value;\n'
+            '\n'
+            '    g_assert (value != NULL);\n'
+            '\n')
 
         for field in self.contents:
             translations['field'] = utils.build_underscore_name_from_camelcase(field['name'])
@@ -692,58 +778,77 @@ class Struct:
             translations['pad_array'] = field['pad-array'] if 'pad-array' in field else 'TRUE'
 
             if field['format'] == 'uuid':
+                inner_size_template = ('    *fixed_size += sizeof (MbimUuid);\n')
                 inner_template = ('    _mbim_struct_builder_append_uuid (builder, &(value->${field}));\n')
             elif field['format'] == 'byte-array':
+                inner_size_template = ('    _mbim_struct_builder_size_byte_array (FALSE, FALSE, ${pad_array}, ${array_size}, fixed_size, variable_size);\n')
                 inner_template = ('    _mbim_struct_builder_append_byte_array (builder, FALSE, FALSE, ${pad_array}, value->${field}, ${array_size});\n')
             elif field['format'] == 'unsized-byte-array':
+                inner_size_template = ('    _mbim_struct_builder_size_byte_array (FALSE, FALSE, ${pad_array}, value->${field}_size, fixed_size, variable_size);\n')
                 inner_template = ('    _mbim_struct_builder_append_byte_array (builder, FALSE, FALSE, ${pad_array}, value->${field}, value->${field}_size);\n')
             elif field['format'] in ['ref-byte-array', 'ref-byte-array-no-offset']:
                 translations['has_offset'] = 'TRUE' if field['format'] == 'ref-byte-array' else 'FALSE'
                 if 'array-size-field' in field:
+                    inner_size_template = ('    _mbim_struct_builder_size_byte_array (${has_offset}, FALSE, ${pad_array}, value->${array_size_field}, fixed_size, variable_size);\n')
                     inner_template = ('    _mbim_struct_builder_append_byte_array (builder, ${has_offset}, FALSE, ${pad_array}, value->${field}, value->${array_size_field});\n')
                 else:
+                    inner_size_template = ('    _mbim_struct_builder_size_byte_array (${has_offset}, TRUE, ${pad_array}, value->${field}_size, fixed_size, variable_size);\n')
                     inner_template = ('    _mbim_struct_builder_append_byte_array (builder, ${has_offset}, TRUE, ${pad_array}, value->${field}, value->${field}_size);\n')
             elif field['format'] == 'guint32':
+                inner_size_template = ('    *fixed_size += sizeof (guint32);\n')
                 inner_template = ('    _mbim_struct_builder_append_guint32 (builder, value->${field});\n')
             elif field['format'] == 'guint32-array':
+                inner_size_template = ('    *fixed_size += sizeof (guint32) * value->${array_size_field};\n')
                 inner_template = ('    _mbim_struct_builder_append_guint32_array (builder, value->${field}, value->${array_size_field});\n')
             elif field['format'] == 'guint64':
+                inner_size_template = ('    *fixed_size += sizeof (guint64);\n')
                 inner_template = ('    _mbim_struct_builder_append_guint64 (builder, value->${field});\n')
             elif field['format'] == 'string':
+                inner_size_template = ('    _mbim_struct_builder_size_string (value->${field}, fixed_size, variable_size);\n')
                 inner_template = ('    _mbim_struct_builder_append_string (builder, value->${field});\n')
             elif field['format'] == 'string-array':
+                inner_size_template = ('    _mbim_struct_builder_size_string_array ((const gchar *const *)value->${field}, value->${array_size_field}, fixed_size, variable_size);\n')
                 inner_template = ('    _mbim_struct_builder_append_string_array (builder, value->${field}, value->${array_size_field});\n')
             elif field['format'] == 'ipv4':
+                inner_size_template = ('    _mbim_struct_builder_size_ipv4 (&value->${field}, FALSE, fixed_size, variable_size);\n')
                 inner_template = ('    _mbim_struct_builder_append_ipv4 (builder, &value->${field}, FALSE);\n')
             elif field['format'] == 'ref-ipv4':
+                inner_size_template = ('    _mbim_struct_builder_size_ipv4 (&value->${field}, TRUE, fixed_size, variable_size);\n')
                 inner_template = ('    _mbim_struct_builder_append_ipv4 (builder, &value->${field}, TRUE);\n')
             elif field['format'] == 'ipv6':
+                inner_size_template = ('    _mbim_struct_builder_size_ipv6 (&value->${field}, FALSE, fixed_size, variable_size);\n')
                 inner_template = ('    _mbim_struct_builder_append_ipv6 (builder, &value->${field}, FALSE);\n')
             elif field['format'] == 'ref-ipv6':
+                inner_size_template = ('    _mbim_struct_builder_size_ipv6 (&value->${field}, TRUE, fixed_size, variable_size);\n')
                 inner_template = ('    _mbim_struct_builder_append_ipv6 (builder, &value->${field}, TRUE);\n')
             else:
                 raise ValueError('Cannot handle format \'%s\' in struct' % field['format'])
 
-            template += string.Template(inner_template).substitute(translations)
+            size_template += string.Template(inner_size_template).substitute(translations)
+            write_template += string.Template(inner_template).substitute(translations)
 
-        template += (
-            '\n'
-            '    return _mbim_struct_builder_complete (builder);\n'
-            '}\n')
-        cfile.write(string.Template(template).substitute(translations))
+        size_template += '}\n'
+        write_template += '}\n'
+        cfile.write(string.Template(size_template).substitute(translations))
+        cfile.write(string.Template(write_template).substitute(translations))
 
         template = (
+            '\n'
+            'static void\n'
+            '_mbim_struct_builder_size_${name_underscore}_struct (\n'
+            '    const ${name} *value,\n'
+            '    guint32 *fixed_size,\n'
+            '    guint32 *variable_size)\n'
+            '{\n'
+            '    _mbim_struct_builder_size_struct (_${name_underscore}_struct_size, value, fixed_size, variable_size);\n'
+            '}\n'
             '\n'
             'static void\n'
             '_mbim_struct_builder_append_${name_underscore}_struct (\n'
             '    MbimStructBuilder *builder,\n'
             '    const ${name} *value)\n'
             '{\n'
-            '    GByteArray *raw;\n'
-            '\n'
-            '    raw = _${name_underscore}_struct_new (value);\n'
-            '    g_byte_array_append (builder->fixed_buffer, raw->data, raw->len);\n'
-            '    g_byte_array_unref (raw);\n'
+            '    _mbim_struct_builder_append_struct (builder, _${name_underscore}_struct_size, _${name_underscore}_struct_write, value);\n'
             '}\n'
             '\n'
             'static void\n'
@@ -756,6 +861,17 @@ class Struct:
         cfile.write(string.Template(template).substitute(translations))
 
         template = (
+            '\n'
+            'static void\n'
+            '_mbim_struct_builder_size_${name_underscore}_struct_array (\n'
+            '    const ${name} *const *values,\n'
+            '    guint32 n_values,\n'
+            '    gboolean refs,\n'
+            '    guint32 *fixed_size,\n'
+            '    guint32 *variable_size)\n'
+            '{\n'
+            '    _mbim_struct_builder_size_struct_array (_${name_underscore}_struct_size, (const gconstpointer *)values, n_values, refs, fixed_size, variable_size);\n'
+            '}\n'
             '\n'
             'static void\n'
             '_mbim_struct_builder_append_${name_underscore}_struct_array (\n'
@@ -764,73 +880,8 @@ class Struct:
             '    guint32 n_values,\n'
             '    gboolean refs)\n'
             '{\n'
-            '    guint32 offset;\n'
-            '    guint32 i;\n'
-            '    GByteArray *raw_all = NULL;\n'
-            '\n'
-            '    if (!refs) {\n'
-            '        for (i = 0; i < n_values; i++) {\n'
-            '            GByteArray *raw;\n'
-            '\n'
-            '            raw = _${name_underscore}_struct_new (values[i]);\n'
-            '            if (!raw_all)\n'
-            '                raw_all = raw;\n'
-            '            else {\n'
-            '                g_byte_array_append (raw_all, raw->data, raw->len);\n'
-            '                g_byte_array_unref (raw);\n'
-            '            }\n'
-            '        }\n'
-            '\n'
-            '        if (!raw_all) {\n'
-            '            offset = 0;\n'
-            '            g_byte_array_append (builder->fixed_buffer, (guint8 *)&offset, sizeof (offset));\n'
-            '        } else {\n'
-            '            guint32 offset_offset;\n'
-            '\n'
-            '            /* Offset of the offset */\n'
-            '            offset_offset = builder->fixed_buffer->len;\n'
-            '            /* Length *not* in LE yet */\n'
-            '            offset = builder->variable_buffer->len;\n'
-            '            /* Add the offset value */\n'
-            '            g_byte_array_append (builder->fixed_buffer, (guint8 *)&offset, sizeof (offset));\n'
-            '            /* Configure the value to get updated */\n'
-            '            g_array_append_val (builder->offsets, offset_offset);\n'
-            '            /* Add the final array itself */\n'
-            '            g_byte_array_append (builder->variable_buffer, raw_all->data, raw_all->len);\n'
-            '            g_byte_array_unref (raw_all);\n'
-            '        }\n'
-            '    } else {\n'
-            '        for (i = 0; i < n_values; i++) {\n'
-            '            guint32 length;\n'
-            '            guint32 offset_offset;\n'
-            '            GByteArray *raw;\n'
-            '\n'
-            '            raw = _${name_underscore}_struct_new (values[i]);\n'
-            '            g_assert (raw->len > 0);\n'
-            '\n'
-            '            /* Offset of the offset */\n'
-            '            offset_offset = builder->fixed_buffer->len;\n'
-            '\n'
-            '            /* Length *not* in LE yet */\n'
-            '            offset = builder->variable_buffer->len;\n'
-            '            /* Add the offset value */\n'
-            '            g_byte_array_append (builder->fixed_buffer, (guint8 *)&offset, sizeof (offset));\n'
-            '            /* Configure the value to get updated */\n'
-            '            g_array_append_val (builder->offsets, offset_offset);\n'
-            '\n'
-            '            /* Add the length value */\n'
-            '            length = GUINT32_TO_LE (raw->len);\n'
-            '            g_byte_array_append (builder->fixed_buffer, (guint8 *)&length, sizeof (length));\n'
-            '\n'
-            '            /* And finally, the bytearray itself to the variable buffer */\n'
-            '            g_byte_array_append (builder->variable_buffer, (const guint8 *)raw->data, (guint)raw->len);\n'
-            '            g_byte_array_unref (raw);\n'
-            '        }\n'
-            '    }\n'
-            '}\n')
-        cfile.write(string.Template(template).substitute(translations))
-
-        template = (
+            '    _mbim_struct_builder_append_struct_array (builder, _${name_underscore}_struct_size, _${name_underscore}_struct_write, (const gconstpointer *)values, n_values, refs);\n'
+            '}\n'
             '\n'
             'static void\n'
             '_mbim_message_command_builder_append_${name_underscore}_struct_array (\n'
@@ -844,6 +895,123 @@ class Struct:
         cfile.write(string.Template(template).substitute(translations))
 
 
+    """
+    Emit the iterator support, to read the fields of the elements of a struct
+    array in place
+    """
+    def _emit_iter(self, hfile, cfile):
+        if not self.array_member:
+            return
+
+        translations = { 'name'            : self.name,
+                         'since'           : self.since if utils.version_compare('1.26', self.since) > 0 else '1.26',
+                         'name_underscore' : utils.build_underscore_name_from_camelcase(self.name),
+                         'struct_size'     : self.size }
+
+        template = (
+            '\n'
+            'static gboolean\n'
+            '_${name_underscore}_struct_array_iter_init (\n'
+            '    MbimStructArrayIter *iter,\n'
+            '    const MbimMessage *self,\n'
+            '    guint32 array_size,\n'
+            '    guint32 relative_offset_array_start,\n'
+            '    gboolean refs,\n'
+            '    GError **error)\n'
+            '{\n'
+            '    return _mbim_struct_array_iter_init (iter, self, &${name_underscore}_struct_descriptor, array_size, relative_offset_array_start, refs, ${struct_size}, error);\n'
+            '}\n')
+        cfile.write(string.Template(template).substitute(translations))
+
+        offsets = compute_static_offsets(self.contents)
+        for field in iter_accessor_fields(self.contents):
+            translations['field'] = utils.build_underscore_name_from_camelcase(field['name'])
+            translations['field_name'] = field['name']
+            translations['offset'] = offsets[field['name']]
+
+            if field['format'] == 'guint32' or field['format'] == 'guint64':
+                translations['format'] = field['format']
+                doc_template = (' * @out_${field}: (out)(optional)(transfer none): return location for a #${format}, or %NULL.\n')
+                args_template = ('    ${format} *out_${field},\n')
+                read_template = (
+                    '    ${format} tmp;\n'
+                    '\n'
+                    '    if (!_mbim_struct_array_iter_get_element (iter, &${name_underscore}_struct_descriptor, &message, &offset))\n'
+                    '        return FALSE;\n'
+                    '    if (!_mbim_message_read_${format} (message, offset + ${offset}, &tmp, error))\n'
+                    '        return FALSE;\n')
+            elif field['format'] == 'uuid':
+                doc_template = (' * @out_${field}: (out)(optional)(transfer none): return location for a #MbimUuid, or %NULL. Do not free the returned value, it is owned by the message.\n')
+                args_template = ('    const MbimUuid **out_${field},\n')
+                read_template = (
+                    '    const MbimUuid *tmp;\n'
+                    '\n'
+                    '    if (!_mbim_struct_array_iter_get_element (iter, &${name_underscore}_struct_descriptor, &message, &offset))\n'
+                    '        return FALSE;\n'
+                    '    if (!_mbim_message_read_uuid (message, offset + ${offset}, &tmp, error))\n'
+                    '        return FALSE;\n')
+            elif field['format'] == 'ipv4':
+                doc_template = (' * @out_${field}: (out)(optional)(transfer none): return location for a #MbimIPv4, or %NULL. Do not free the returned value, it is owned by the message.\n')
+                args_template = ('    const MbimIPv4 **out_${field},\n')
+                read_template = (
+                    '    const MbimIPv4 *tmp;\n'
+                    '\n'
+                    '    if (!_mbim_struct_array_iter_get_element (iter, &${name_underscore}_struct_descriptor, &message, &offset))\n'
+                    '        return FALSE;\n'
+                    '    if (!_mbim_message_read_ipv4 (message, offset + ${offset}, FALSE, &tmp, error))\n'
+                    '        return FALSE;\n')
+            elif field['format'] == 'ipv6':
+                doc_template = (' * @out_${field}: (out)(optional)(transfer none): return location for a #MbimIPv6, or %NULL. Do not free the returned value, it is owned by the message.\n')
+                args_template = ('    const MbimIPv6 **out_${field},\n')
+                read_template = (
+                    '    const MbimIPv6 *tmp;\n'
+                    '\n'
+                    '    if (!_mbim_struct_array_iter_get_element (iter, &${name_underscore}_struct_descriptor, &message, &offset))\n'
+                    '        return FALSE;\n'
+                    '    if (!_mbim_message_read_ipv6 (message, offset + ${offset}, FALSE, &tmp, error))\n'
+                    '        return FALSE;\n')
+            else:
+                raise ValueError('Cannot emit iterator accessor for field type \'%s\'' % field['format'])
+
+            template = (
+                '\n'
+                '/**\n'
+                ' * ${name_underscore}_iter_get_${field}:\n'
+                ' * @iter: a #MbimStructArrayIter walking an array of #${name} elements.\n' +
+                doc_template +
+                ' * @error: return location for error or %NULL.\n'
+                ' *\n'
+                ' * Reads the \'${field_name}\' field of the #${name} element @iter points to,\n'
+                ' * without parsing or allocating any of the other fields in the element.\n'
+                ' *\n'
+                ' * Returns: %TRUE if the field was correctly read, %FALSE if @error is set.\n'
+                ' *\n'
+                ' * Since: ${since}\n'
+                ' */\n'
+                'gboolean ${name_underscore}_iter_get_${field} (\n'
+                '    const MbimStructArrayIter *iter,\n' +
+                args_template +
+                '    GError **error);\n')
+            hfile.write(string.Template(template).substitute(translations))
+
+            template = (
+                '\n'
+                'gboolean\n'
+                '${name_underscore}_iter_get_${field} (\n'
+                '    const MbimStructArrayIter *iter,\n' +
+                args_template +
+                '    GError **error)\n'
+                '{\n'
+                '    const MbimMessage *message;\n'
+                '    guint32 offset;\n' +
+                read_template +
+                '    if (out_${field} != NULL)\n'
+                '        *out_${field} = tmp;\n'
+                '    return TRUE;\n'
+                '}\n')
+            cfile.write(string.Template(template).substitute(translations))
+
+
     """
     Emit the struct handling implementation
     """
@@ -859,6 +1027,10 @@ class Struct:
         self._emit_read(cfile)
         # Emit type's print
         self._emit_print(cfile)
+        # Emit type's descriptor
+        self._emit_descriptor(cfile)
+        # Emit type's iterator support
+        self._emit_iter(hfile, cfile)
         # Emit type's append
         self._emit_append(cfile)
 
@@ -881,4 +1053,7 @@ class Struct:
         if self.array_member == True:
             template += (
                 '${name_underscore}_array_free\n')
+            for field in iter_accessor_fields(self.contents):
+                template += (
+                    '${name_underscore}_iter_get_' + utils.build_underscore_name_from_camelcase(field['name']) + '\n')
         sfile.write(string.Template(template).substitute(translations))
@@ -20,42 +20,64 @@
  */
 
 #include <config.h>
-#include <stdio.h>
 
 #include "mbim-common.h"
 
 /*****************************************************************************/
 
+static const gchar hex_digits[] = "0123456789ABCDEF";
+
+/* Writes 3N-1 chars, no NUL */
+static void
+str_hex_fill (gchar        *out,
+              const guint8 *data,
+              gsize         size,
+              gchar         delimiter)
+{
+    gsize i;
+
+    for (i = 0; i < size; i++) {
+        if (i > 0)
+            *(out++) = delimiter;
+        *(out++) = hex_digits[data[i] >> 4];
+        *(out++) = hex_digits[data[i] & 0x0F];
+    }
+}
+
 gchar *
 mbim_common_str_hex (gconstpointer mem,
                      gsize size,
                      gchar delimiter)
 {
-    const guint8 *data = mem;
-    gsize i;
-    gsize j;
-    gsize new_str_length;
     gchar *new_str;
 
-    /* Get new string length. If input string has N bytes, we need:
+    if (!mem || !size)
+        return NULL;
+
+    /* If input string has N bytes, we need:
      * - 1 byte for last NUL char
      * - 2N bytes for hexadecimal char representation of each byte...
      * - N-1 bytes for the separator ':'
      * So... a total of (1+2N+N-1) = 3N bytes are needed... */
-    new_str_length =  3 * size;
-
-    /* Allocate memory for new array and initialize contents to NUL */
-    new_str = g_malloc0 (new_str_length);
-
-    /* Print hexadecimal representation of each byte... */
-    for (i = 0, j = 0; i < size; i++, j += 3) {
-        /* Print character in output string... */
-        snprintf (&new_str[j], 3, "%02X", data[i]);
-        /* And if needed, add separator */
-        if (i != (size - 1) )
-            new_str[j + 2] = delimiter;
-    }
-
-    /* Set output string */
+    new_str = g_malloc (3 * size);
+    str_hex_fill (new_str, mem, size, delimiter);
+    new_str[(3 * size) - 1] = '\0';
     return new_str;
 }
+
+void
+mbim_common_str_hex_append (GString       *str,
+                            gconstpointer  mem,
+                            gsize          size,
+                            gchar          delimiter)
+{
+    gsize start;
+
+    if (!mem || !size)
+        return;
+
+    /* Grow the string once, and fill in the new contents in place */
+    start = str->len;
+    g_string_set_size (str, start + (3 * size) - 1);
+    str_hex_fill (&str->str[start], mem, size, delimiter);
+}
@@ -28,4 +28,9 @@ gchar *mbim_common_str_hex (gconstpointer mem,
                             gsize         size,
                             gchar         delimiter);
 
+void   mbim_common_str_hex_append (GString       *str,
+                                   gconstpointer  mem,
+                                   gsize          size,
+                                   gchar          delimiter);
+
 #endif /* _COMMON_MBIM_COMMON_H_ */
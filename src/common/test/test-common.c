@@ -14,6 +14,7 @@
  */
 
 #include <config.h>
+#include <string.h>
 
 #include "mbim-common.h"
 
@@ -42,13 +43,35 @@ test_common_str_hex (void)
     g_free (str);
 }
 
+static void
+test_common_str_hex_append (void)
+{
+    static const guint8 buffer [] = { 0x00, 0xDE, 0xAD, 0xC0, 0xDE };
+    GString *str;
+
+    str = g_string_new ("prefix ");
+
+    mbim_common_str_hex_append (str, buffer, 0, ':');
+    g_assert_cmpstr (str->str, ==, "prefix ");
+
+    mbim_common_str_hex_append (str, buffer, 1, ':');
+    g_assert_cmpstr (str->str, ==, "prefix 00");
+
+    mbim_common_str_hex_append (str, buffer, 5, ':');
+    g_assert_cmpstr (str->str, ==, "prefix 0000:DE:AD:C0:DE");
+    g_assert_cmpuint (str->len, ==, strlen (str->str));
+
+    g_string_free (str, TRUE);
+}
+
 /*****************************************************************************/
 
 int main (int argc, char **argv)
 {
     g_test_init (&argc, &argv, NULL);
 
-    g_test_add_func ("/common/str_hex", test_common_str_hex);
+    g_test_add_func ("/common/str_hex",        test_common_str_hex);
+    g_test_add_func ("/common/str_hex_append", test_common_str_hex_append);
 
     return g_test_run ();
 }
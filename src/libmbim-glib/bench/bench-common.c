@@ -0,0 +1,190 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details:
+ *
+ * Copyright (C) 2026 agent <agent@local>
+ */
+
+#include <config.h>
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "mbim-message.h"
+#include "mbim-message-private.h"
+#include "mbim-uuid.h"
+#include "mbim-cid.h"
+
+#include "bench-common.h"
+
+#define DEFAULT_MIN_TIME_MS 500
+
+/*****************************************************************************/
+/* Benchmark runner */
+
+static gint    min_time_ms = DEFAULT_MIN_TIME_MS;
+static gchar  *filter;
+
+static GOptionEntry bench_entries[] = {
+    { "min-time", 't', 0, G_OPTION_ARG_INT, &min_time_ms,
+      "Minimum run time of each benchmark, in milliseconds (default: " G_STRINGIFY (DEFAULT_MIN_TIME_MS) ")",
+      "[MS]"
+    },
+    { "filter", 'f', 0, G_OPTION_ARG_STRING, &filter,
+      "Only run the benchmarks whose name contains the given string",
+      "[STRING]"
+    },
+    { NULL }
+};
+
+void
+bench_init (gint    *argc,
+            gchar ***argv)
+{
+    g_autoptr(GOptionContext) context = NULL;
+    g_autoptr(GError)         error = NULL;
+
+    context = g_option_context_new ("- libmbim-glib benchmarks");
+    g_option_context_add_main_entries (context, bench_entries, NULL);
+    if (!g_option_context_parse (context, argc, argv, &error)) {
+        g_printerr ("error: %s\n", error->message);
+        exit (EXIT_FAILURE);
+    }
+
+    if (min_time_ms <= 0)
+        min_time_ms = DEFAULT_MIN_TIME_MS;
+}
+
+gboolean
+bench_enabled (const gchar *name)
+{
+    return (!filter || strstr (name, filter));
+}
+
+gint64
+bench_get_min_time (void)
+{
+    return (gint64) min_time_ms * 1000;
+}
+
+void
+bench_report (const gchar *name,
+              guint64      iterations,
+              gint64       elapsed_us,
+              guint64      bytes,
+              const gchar *extra_fields)
+{
+    gdouble seconds;
+
+    /* Avoid divisions by zero in very coarse clocks */
+    if (elapsed_us <= 0)
+        elapsed_us = 1;
+    seconds = elapsed_us / (gdouble) G_USEC_PER_SEC;
+
+    g_print ("{\"benchmark\":\"%s\","
+             "\"iterations\":%" G_GUINT64_FORMAT ","
+             "\"elapsed_us\":%" G_GINT64_FORMAT ","
+             "\"ns_per_op\":%.1f,"
+             "\"ops_per_sec\":%.1f",
+             name,
+             iterations,
+             elapsed_us,
+             iterations ? ((elapsed_us * 1000.0) / iterations) : 0.0,
+             iterations / seconds);
+    if (bytes)
+        g_print (",\"bytes_per_sec\":%.1f", bytes / seconds);
+    if (extra_fields)
+        g_print (",%s", extra_fields);
+    g_print ("}\n");
+}
+
+void
+bench_skip (const gchar *name,
+            const gchar *reason)
+{
+    GString     *escaped;
+    const gchar *p;
+
+    escaped = g_string_new (NULL);
+    for (p = reason; *p; p++) {
+        if (*p == '"' || *p == '\\')
+            g_string_append_printf (escaped, "\\%c", *p);
+        else if ((guchar) *p < 0x20)
+            g_string_append_printf (escaped, "\\u%04x", (guchar) *p);
+        else
+            g_string_append_c (escaped, *p);
+    }
+
+    g_print ("{\"benchmark\":\"%s\",\"skipped\":\"%s\"}\n", name, escaped->str);
+    g_string_free (escaped, TRUE);
+}
+
+void
+bench_run (const gchar *name,
+           guint64      bytes_per_op,
+           BenchFunc    func,
+           gpointer     user_data)
+{
+    guint64 iterations = 1;
+    gint64  min_time;
+    gint64  elapsed;
+
+    if (!bench_enabled (name))
+        return;
+
+    /* Warm up */
+    func (user_data);
+
+    min_time = bench_get_min_time ();
+    while (TRUE) {
+        gint64  start;
+        guint64 i;
+
+        start = g_get_monotonic_time ();
+        for (i = 0; i < iterations; i++)
+            func (user_data);
+        elapsed = g_get_monotonic_time () - start;
+
+        if (elapsed >= min_time)
+            break;
+
+        /* Estimate how many iterations are needed to reach the minimum run
+         * time, with some margin, and never less than twice the last run */
+        if (elapsed <= 0)
+            iterations *= 10;
+        else
+            iterations = MAX (iterations * 2, (iterations * min_time * 11 / 10) / elapsed);
+    }
+
+    bench_report (name, iterations, elapsed, bytes_per_op * iterations, NULL);
+}
+
+/*****************************************************************************/
+
+MbimMessage *
+bench_indication_new (guint32 transaction_id,
+                      guint32 payload_length)
+{
+    MbimMessage                    *indication;
+    struct indicate_status_message *indicate_status;
+
+    indication = (MbimMessage *) _mbim_message_allocate (MBIM_MESSAGE_TYPE_INDICATE_STATUS,
+                                                         transaction_id,
+                                                         sizeof (struct indicate_status_message) + payload_length);
+    indicate_status = &(((struct full_message *)(indication->data))->message.indicate_status);
+    indicate_status->fragment_header.total   = GUINT32_TO_LE (1);
+    indicate_status->fragment_header.current = 0;
+    memcpy (indicate_status->service_id, MBIM_UUID_BASIC_CONNECT, sizeof (MbimUuid));
+    indicate_status->command_id    = GUINT32_TO_LE (MBIM_CID_BASIC_CONNECT_SIGNAL_STATE);
+    indicate_status->buffer_length = GUINT32_TO_LE (payload_length);
+    memset (indicate_status->buffer, 0, payload_length);
+    return indication;
+}
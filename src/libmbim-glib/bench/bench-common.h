@@ -0,0 +1,70 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details:
+ *
+ * Copyright (C) 2026 agent <agent@local>
+ */
+
+#ifndef _LIBMBIM_GLIB_BENCH_COMMON_H_
+#define _LIBMBIM_GLIB_BENCH_COMMON_H_
+
+#include <glib.h>
+
+#include "mbim-message.h"
+
+G_BEGIN_DECLS
+
+/*****************************************************************************/
+/* Benchmark runner
+ *
+ * Every result is printed to stdout as a single line JSON object (JSON Lines),
+ * so that the output of several runs can be easily collected and compared:
+ *
+ *   {"benchmark":"message/parse/device-caps","iterations":1048576,
+ *    "elapsed_ns":301234567,"ns_per_op":287.3,"ops_per_sec":3480000.1,
+ *    "bytes_per_sec":723840000.0}
+ *
+ * Skipped benchmarks are reported with a "skipped" reason instead. */
+
+typedef void (* BenchFunc) (gpointer user_data);
+
+void     bench_init   (gint         *argc,
+                       gchar      ***argv);
+gboolean bench_enabled (const gchar *name);
+
+/* Run the function in a loop as many times as needed to reach the configured
+ * minimum run time; bytes_per_op may be 0 if throughput isn't relevant */
+void     bench_run    (const gchar  *name,
+                       guint64       bytes_per_op,
+                       BenchFunc     func,
+                       gpointer      user_data);
+
+/* Report an externally measured benchmark, e.g. one driven by a main loop;
+ * extra_fields, if given, is appended verbatim to the JSON object */
+void     bench_report (const gchar  *name,
+                       guint64       iterations,
+                       gint64        elapsed_us,
+                       guint64       bytes,
+                       const gchar  *extra_fields);
+void     bench_skip   (const gchar  *name,
+                       const gchar  *reason);
+
+/* Minimum run time of each benchmark, in microseconds */
+gint64   bench_get_min_time (void);
+
+/*****************************************************************************/
+/* Build an indication of the given size, as a modem would send it */
+MbimMessage *bench_indication_new (guint32 transaction_id,
+                                   guint32 payload_length);
+
+G_END_DECLS
+
+#endif /* _LIBMBIM_GLIB_BENCH_COMMON_H_ */
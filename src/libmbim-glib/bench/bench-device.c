@@ -0,0 +1,330 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details:
+ *
+ * Copyright (C) 2026 agent <agent@local>
+ */
+
+#include <config.h>
+#include <string.h>
+#include <gio/gio.h>
+
+#include "mbim-message.h"
+#include "mbim-device.h"
+#include "mbim-proxy.h"
+
+#include "mbim-mock-function.h"
+
+#include "bench-common.h"
+
+#define OPEN_TIMEOUT_SECS   10
+#define CLOSE_TIMEOUT_SECS  5
+#define PAYLOAD_LENGTH      20
+#define STALL_TIMEOUT_MS    2000
+
+/*****************************************************************************/
+/* Synchronous helpers */
+
+typedef struct {
+    GMainLoop    *loop;
+    GAsyncResult *result;
+} SyncContext;
+
+static void
+sync_ready (GObject      *source,
+            GAsyncResult *res,
+            SyncContext  *ctx)
+{
+    ctx->result = g_object_ref (res);
+    g_main_loop_quit (ctx->loop);
+}
+
+static void
+sync_run (SyncContext *ctx)
+{
+    ctx->result = NULL;
+    g_main_loop_run (ctx->loop);
+}
+
+static MbimDevice *
+device_new_sync (GMainLoop    *loop,
+                 const gchar  *path,
+                 GError      **error)
+{
+    g_autoptr(GFile) file = NULL;
+    SyncContext      ctx = { loop, NULL };
+    MbimDevice      *device;
+
+    file = g_file_new_for_path (path);
+    mbim_device_new (file, NULL, (GAsyncReadyCallback) sync_ready, &ctx);
+    sync_run (&ctx);
+    device = mbim_device_new_finish (ctx.result, error);
+    g_object_unref (ctx.result);
+    return device;
+}
+
+static gboolean
+device_open_sync (GMainLoop            *loop,
+                  MbimDevice           *device,
+                  MbimDeviceOpenFlags   flags,
+                  GError              **error)
+{
+    SyncContext ctx = { loop, NULL };
+    gboolean    opened;
+
+    mbim_device_open_full (device, flags, OPEN_TIMEOUT_SECS, NULL, (GAsyncReadyCallback) sync_ready, &ctx);
+    sync_run (&ctx);
+    opened = mbim_device_open_full_finish (device, ctx.result, error);
+    g_object_unref (ctx.result);
+    return opened;
+}
+
+static void
+device_close_sync (GMainLoop  *loop,
+                   MbimDevice *device)
+{
+    g_autoptr(GError) error = NULL;
+    SyncContext       ctx = { loop, NULL };
+
+    mbim_device_close (device, CLOSE_TIMEOUT_SECS, NULL, (GAsyncReadyCallback) sync_ready, &ctx);
+    sync_run (&ctx);
+    if (!mbim_device_close_finish (device, ctx.result, &error))
+        g_warning ("couldn't close device: %s", error->message);
+    g_object_unref (ctx.result);
+}
+
+/*****************************************************************************/
+/* Indication bursts
+ *
+ * The mock function writes bursts of indications in one go, so that the host
+ * gets several messages in every read, and the time until all of them have
+ * been received and emitted by every listening device is measured. */
+
+typedef struct {
+    GMainLoop *loop;
+    guint64    received;
+    guint64    expected;
+    guint64    last_checked;
+    gboolean   stalled;
+} DeliveryContext;
+
+static void
+indication_cb (MbimDevice      *device,
+               MbimMessage     *message,
+               DeliveryContext *ctx)
+{
+    if (++ctx->received >= ctx->expected)
+        g_main_loop_quit (ctx->loop);
+}
+
+static gboolean
+stall_check_cb (DeliveryContext *ctx)
+{
+    if (ctx->received == ctx->last_checked) {
+        ctx->stalled = TRUE;
+        g_main_loop_quit (ctx->loop);
+        return G_SOURCE_REMOVE;
+    }
+    ctx->last_checked = ctx->received;
+    return G_SOURCE_CONTINUE;
+}
+
+static void
+run_burst (const gchar      *name,
+           GMainLoop        *loop,
+           MbimMockFunction *mock,
+           GPtrArray        *devices,
+           guint             burst_size)
+{
+    DeliveryContext   ctx;
+    g_autoptr(GByteArray) burst = NULL;
+    guint32           indication_length = 0;
+    gint64            start;
+    gint64            elapsed;
+    guint             i;
+    g_autofree gulong *handlers = NULL;
+    g_autofree gchar  *extra_fields = NULL;
+
+    if (!bench_enabled (name))
+        return;
+
+    burst = g_byte_array_new ();
+    for (i = 0; i < burst_size; i++) {
+        g_autoptr(MbimMessage) indication = NULL;
+        const guint8          *raw;
+
+        indication = bench_indication_new (0, PAYLOAD_LENGTH);
+        raw = mbim_message_get_raw (indication, &indication_length, NULL);
+        g_byte_array_append (burst, raw, indication_length);
+    }
+
+    memset (&ctx, 0, sizeof (ctx));
+    ctx.loop = loop;
+
+    handlers = g_new (gulong, devices->len);
+    for (i = 0; i < devices->len; i++)
+        handlers[i] = g_signal_connect (g_ptr_array_index (devices, i),
+                                        MBIM_DEVICE_SIGNAL_INDICATE_STATUS,
+                                        G_CALLBACK (indication_cb),
+                                        &ctx);
+
+    start = g_get_monotonic_time ();
+    do {
+        guint stall_id;
+
+        ctx.expected += (guint64) burst_size * devices->len;
+        mbim_mock_function_send_raw (mock, burst->data, burst->len);
+
+        stall_id = g_timeout_add (STALL_TIMEOUT_MS, (GSourceFunc) stall_check_cb, &ctx);
+        g_main_loop_run (loop);
+        if (!ctx.stalled)
+            g_source_remove (stall_id);
+        elapsed = g_get_monotonic_time () - start;
+    } while (!ctx.stalled && elapsed < bench_get_min_time ());
+
+    for (i = 0; i < devices->len; i++)
+        g_signal_handler_disconnect (g_ptr_array_index (devices, i), handlers[i]);
+
+    /* Indications may get lost, e.g. if the proxy drops them when a client
+     * isn't reading fast enough; report them along with the results */
+    extra_fields = g_strdup_printf ("\"lost\":%" G_GUINT64_FORMAT, ctx.expected - ctx.received);
+    bench_report (name,
+                  ctx.received,
+                  elapsed,
+                  ctx.received * indication_length,
+                  extra_fields);
+}
+
+/*****************************************************************************/
+/* Device parser, under bursty input */
+
+static void
+bench_device (GMainLoop           *loop,
+              MbimMockFunction    *mock,
+              const gchar         *prefix,
+              MbimDeviceOpenFlags  flags)
+{
+    static const guint  burst_sizes[] = { 1, 16, 256 };
+    g_autoptr(GError)   error = NULL;
+    g_autoptr(GPtrArray) devices = NULL;
+    MbimDevice         *device;
+    guint               i;
+
+    device = device_new_sync (loop, mbim_mock_function_get_path (mock), &error);
+    if (!device || !device_open_sync (loop, device, flags, &error)) {
+        bench_skip (prefix, error->message);
+        g_clear_object (&device);
+        return;
+    }
+
+    devices = g_ptr_array_new_with_free_func (g_object_unref);
+    g_ptr_array_add (devices, device);
+
+    for (i = 0; i < G_N_ELEMENTS (burst_sizes); i++) {
+        g_autofree gchar *name = NULL;
+
+        name = g_strdup_printf ("%s/burst-%u", prefix, burst_sizes[i]);
+        run_burst (name, loop, mock, devices, burst_sizes[i]);
+    }
+
+    device_close_sync (loop, device);
+}
+
+/*****************************************************************************/
+/* Proxy indication fan-out */
+
+#define FANOUT_BURST_SIZE 16
+
+static void
+bench_proxy_fanout (GMainLoop        *loop,
+                    MbimMockFunction *mock)
+{
+    static const guint    n_clients[] = { 1, 8, 32 };
+    g_autoptr(GError)     error = NULL;
+    g_autoptr(MbimProxy)  proxy = NULL;
+    gchar                *names[G_N_ELEMENTS (n_clients)];
+    gboolean              enabled = FALSE;
+    guint                 i;
+
+    for (i = 0; i < G_N_ELEMENTS (n_clients); i++) {
+        names[i] = g_strdup_printf ("proxy/fanout/%u-clients", n_clients[i]);
+        enabled |= bench_enabled (names[i]);
+    }
+    if (!enabled)
+        goto out;
+
+    /* The proxy requires running as an allowed user, and the abstract socket
+     * to be free */
+    proxy = mbim_proxy_new (&error);
+    if (!proxy) {
+        bench_skip ("proxy/fanout", error->message);
+        goto out;
+    }
+
+    for (i = 0; i < G_N_ELEMENTS (n_clients); i++) {
+        g_autoptr(GPtrArray) devices = NULL;
+        guint                j;
+
+        if (!bench_enabled (names[i]))
+            continue;
+
+        devices = g_ptr_array_new_with_free_func (g_object_unref);
+        for (j = 0; j < n_clients[i]; j++) {
+            MbimDevice *device;
+
+            device = device_new_sync (loop, mbim_mock_function_get_path (mock), &error);
+            if (!device || !device_open_sync (loop, device, MBIM_DEVICE_OPEN_FLAGS_PROXY, &error)) {
+                g_clear_object (&device);
+                break;
+            }
+            g_ptr_array_add (devices, device);
+        }
+
+        if (devices->len == n_clients[i])
+            run_burst (names[i], loop, mock, devices, FANOUT_BURST_SIZE);
+        else
+            bench_skip (names[i], error->message);
+
+        for (j = 0; j < devices->len; j++)
+            device_close_sync (loop, g_ptr_array_index (devices, j));
+        g_clear_error (&error);
+    }
+
+out:
+    for (i = 0; i < G_N_ELEMENTS (n_clients); i++)
+        g_free (names[i]);
+}
+
+/*****************************************************************************/
+
+int main (int argc, char **argv)
+{
+    g_autoptr(GMainLoop) loop = NULL;
+    g_autoptr(GError)    error = NULL;
+    MbimMockFunction    *mock;
+
+    bench_init (&argc, &argv);
+
+    mock = mbim_mock_function_new (&error);
+    if (!mock) {
+        bench_skip ("device", error->message);
+        return 0;
+    }
+
+    loop = g_main_loop_new (NULL, FALSE);
+
+    bench_device (loop, mock, "device/indications", MBIM_DEVICE_OPEN_FLAGS_NONE);
+    bench_device (loop, mock, "device/indications/reader-thread", MBIM_DEVICE_OPEN_FLAGS_READER_THREAD);
+    bench_proxy_fanout (loop, mock);
+
+    mbim_mock_function_free (mock);
+    return 0;
+}
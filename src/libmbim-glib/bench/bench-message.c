@@ -0,0 +1,309 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details:
+ *
+ * Copyright (C) 2026 agent <agent@local>
+ */
+
+#include <config.h>
+#include <string.h>
+
+#include "mbim-message.h"
+#include "mbim-message-private.h"
+#include "mbim-basic-connect.h"
+#include "mbim-qdu.h"
+
+#include "bench-common.h"
+
+/*****************************************************************************/
+/* Parsers, over messages captured from real devices */
+
+static const guint8 device_caps_buffer [] = {
+    0x03, 0x00, 0x00, 0x80, 0xD0, 0x00, 0x00, 0x00, 0x02, 0x00, 0x00, 0x00,
+    0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xA2, 0x89, 0xCC, 0x33,
+    0xBC, 0xBB, 0x8B, 0x4F, 0xB6, 0xB0, 0x13, 0x3E, 0xC2, 0xAA, 0xE6, 0xDF,
+    0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xA0, 0x00, 0x00, 0x00,
+    0x02, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00,
+    0x02, 0x00, 0x00, 0x00, 0x1F, 0x00, 0x00, 0x80, 0x03, 0x00, 0x00, 0x00,
+    0x01, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x40, 0x00, 0x00, 0x00,
+    0x0A, 0x00, 0x00, 0x00, 0x4C, 0x00, 0x00, 0x00, 0x1E, 0x00, 0x00, 0x00,
+    0x6C, 0x00, 0x00, 0x00, 0x1E, 0x00, 0x00, 0x00, 0x8C, 0x00, 0x00, 0x00,
+    0x12, 0x00, 0x00, 0x00, 0x48, 0x00, 0x53, 0x00, 0x50, 0x00, 0x41, 0x00,
+    0x2B, 0x00, 0x00, 0x00, 0x33, 0x00, 0x35, 0x00, 0x33, 0x00, 0x36, 0x00,
+    0x31, 0x00, 0x33, 0x00, 0x30, 0x00, 0x34, 0x00, 0x38, 0x00, 0x38, 0x00,
+    0x30, 0x00, 0x34, 0x00, 0x36, 0x00, 0x32, 0x00, 0x32, 0x00, 0x00, 0x00,
+    0x31, 0x00, 0x31, 0x00, 0x2E, 0x00, 0x38, 0x00, 0x31, 0x00, 0x30, 0x00,
+    0x2E, 0x00, 0x30, 0x00, 0x39, 0x00, 0x2E, 0x00, 0x30, 0x00, 0x30, 0x00,
+    0x2E, 0x00, 0x30, 0x00, 0x30, 0x00, 0x00, 0x00, 0x43, 0x00, 0x50, 0x00,
+    0x31, 0x00, 0x45, 0x00, 0x33, 0x00, 0x36, 0x00, 0x37, 0x00, 0x55, 0x00,
+    0x4D, 0x00, 0x00, 0x00
+};
+
+static const guint8 ip_configuration_buffer [] = {
+    0x03, 0x00, 0x00, 0x80, 0x80, 0x00, 0x00, 0x00, 0x1A, 0x00, 0x00, 0x00,
+    0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xA2, 0x89, 0xCC, 0x33,
+    0xBC, 0xBB, 0x8B, 0x4F, 0xB6, 0xB0, 0x13, 0x3E, 0xC2, 0xAA, 0xE6, 0xDF,
+    0x0F, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x50, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x0F, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x01, 0x00, 0x00, 0x00, 0x3C, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x44, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x02, 0x00, 0x00, 0x00, 0x48, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0xDC, 0x05, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x1C, 0x00, 0x00, 0x00, 0xD4, 0x49, 0x22, 0xF8, 0xD4, 0x49, 0x22, 0xF1,
+    0xD4, 0xA6, 0xD2, 0x50, 0xD4, 0x49, 0x20, 0x43
+};
+
+static const guint8 visible_providers_buffer [] = {
+    0x03, 0x00, 0x00, 0x80, 0xB4, 0x00, 0x00, 0x00, 0x02, 0x00, 0x00, 0x00,
+    0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xA2, 0x89, 0xCC, 0x33,
+    0xBC, 0xBB, 0x8B, 0x4F, 0xB6, 0xB0, 0x13, 0x3E, 0xC2, 0xAA, 0xE6, 0xDF,
+    0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x84, 0x00, 0x00, 0x00,
+    0x02, 0x00, 0x00, 0x00, 0x14, 0x00, 0x00, 0x00, 0x38, 0x00, 0x00, 0x00,
+    0x4C, 0x00, 0x00, 0x00, 0x38, 0x00, 0x00, 0x00, 0x20, 0x00, 0x00, 0x00,
+    0x0A, 0x00, 0x00, 0x00, 0x08, 0x00, 0x00, 0x00, 0x2C, 0x00, 0x00, 0x00,
+    0x0C, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x0B, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x32, 0x00, 0x31, 0x00, 0x34, 0x00, 0x30, 0x00,
+    0x33, 0x00, 0x00, 0x00, 0x4F, 0x00, 0x72, 0x00, 0x61, 0x00, 0x6E, 0x00,
+    0x67, 0x00, 0x65, 0x00, 0x20, 0x00, 0x00, 0x00, 0x0A, 0x00, 0x00, 0x00,
+    0x19, 0x00, 0x00, 0x00, 0x2C, 0x00, 0x00, 0x00, 0x0C, 0x00, 0x00, 0x00,
+    0x01, 0x00, 0x00, 0x00, 0x0B, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x32, 0x00, 0x31, 0x00, 0x34, 0x00, 0x30, 0x00, 0x33, 0x00, 0x00, 0x00,
+    0x4F, 0x00, 0x72, 0x00, 0x61, 0x00, 0x6E, 0x00, 0x67, 0x00, 0x65, 0x00
+};
+
+static void
+parse_device_caps (MbimMessage *response)
+{
+    g_autofree gchar *custom_data_class = NULL;
+    g_autofree gchar *device_id = NULL;
+    g_autofree gchar *firmware_info = NULL;
+    g_autofree gchar *hardware_info = NULL;
+
+    if (!mbim_message_device_caps_response_parse (response,
+                                                  NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL,
+                                                  &custom_data_class,
+                                                  &device_id,
+                                                  &firmware_info,
+                                                  &hardware_info,
+                                                  NULL))
+        g_assert_not_reached ();
+}
+
+static void
+parse_ip_configuration (MbimMessage *response)
+{
+    g_autofree MbimIPv4 *ipv4dnsserver = NULL;
+    g_autofree MbimIPv6 *ipv6dnsserver = NULL;
+    g_autoptr(MbimIPv4ElementArray) ipv4address = NULL;
+    g_autoptr(MbimIPv6ElementArray) ipv6address = NULL;
+
+    if (!mbim_message_ip_configuration_response_parse (response,
+                                                       NULL, NULL, NULL,
+                                                       NULL, &ipv4address,
+                                                       NULL, &ipv6address,
+                                                       NULL, NULL,
+                                                       NULL, &ipv4dnsserver,
+                                                       NULL, &ipv6dnsserver,
+                                                       NULL, NULL,
+                                                       NULL))
+        g_assert_not_reached ();
+}
+
+static void
+parse_visible_providers (MbimMessage *response)
+{
+    g_autoptr(MbimProviderArray) providers = NULL;
+
+    if (!mbim_message_visible_providers_response_parse (response, NULL, &providers, NULL))
+        g_assert_not_reached ();
+}
+
+static void
+bench_parsers (void)
+{
+    static const struct {
+        const gchar  *name;
+        const guint8 *buffer;
+        gsize         buffer_size;
+        BenchFunc     func;
+    } parsers[] = {
+        { "message/parse/device-caps",       device_caps_buffer,       sizeof (device_caps_buffer),       (BenchFunc) parse_device_caps       },
+        { "message/parse/ip-configuration",  ip_configuration_buffer,  sizeof (ip_configuration_buffer),  (BenchFunc) parse_ip_configuration  },
+        { "message/parse/visible-providers", visible_providers_buffer, sizeof (visible_providers_buffer), (BenchFunc) parse_visible_providers },
+    };
+    guint i;
+
+    for (i = 0; i < G_N_ELEMENTS (parsers); i++) {
+        g_autoptr(MbimMessage) response = NULL;
+
+        response = mbim_message_new (parsers[i].buffer, parsers[i].buffer_size);
+        bench_run (parsers[i].name, parsers[i].buffer_size, parsers[i].func, response);
+    }
+}
+
+/*****************************************************************************/
+/* Builders, with large SETs */
+
+#define N_SUBSCRIBE_SERVICES 32
+#define N_SUBSCRIBE_CIDS     64
+
+static void
+build_subscribe_list (MbimEventEntry **entries)
+{
+    g_autoptr(MbimMessage) message = NULL;
+
+    message = mbim_message_device_service_subscribe_list_set_new (N_SUBSCRIBE_SERVICES,
+                                                                  (const MbimEventEntry *const *) entries,
+                                                                  NULL);
+    g_assert (message);
+}
+
+#define FILE_WRITE_SIZE (1024 * 1024)
+
+static void
+build_file_write (const guint8 *data)
+{
+    g_autoptr(MbimMessage) message = NULL;
+
+    message = mbim_message_qdu_file_write_set_new (FILE_WRITE_SIZE, data, NULL);
+    g_assert (message);
+}
+
+static void
+bench_builders (void)
+{
+    MbimEventEntry   **entries;
+    g_autoptr(GError)  error = NULL;
+    g_autofree guint8 *data = NULL;
+    guint              i;
+    guint32            message_length;
+
+    entries = g_new0 (MbimEventEntry *, N_SUBSCRIBE_SERVICES + 1);
+    for (i = 0; i < N_SUBSCRIBE_SERVICES; i++) {
+        guint j;
+
+        entries[i] = g_new0 (MbimEventEntry, 1);
+        memcpy (&entries[i]->device_service_id, MBIM_UUID_BASIC_CONNECT, sizeof (MbimUuid));
+        entries[i]->device_service_id.e[5] = (guint8) i;
+        entries[i]->cids_count = N_SUBSCRIBE_CIDS;
+        entries[i]->cids = g_new (guint32, N_SUBSCRIBE_CIDS);
+        for (j = 0; j < N_SUBSCRIBE_CIDS; j++)
+            entries[i]->cids[j] = j + 1;
+    }
+
+    {
+        g_autoptr(MbimMessage) message = NULL;
+
+        message = mbim_message_device_service_subscribe_list_set_new (N_SUBSCRIBE_SERVICES,
+                                                                      (const MbimEventEntry *const *) entries,
+                                                                      &error);
+        g_assert_no_error (error);
+        message_length = mbim_message_get_message_length (message);
+    }
+    bench_run ("message/build/subscribe-list", message_length, (BenchFunc) build_subscribe_list, entries);
+    mbim_event_entry_array_free (entries);
+
+    data = g_malloc0 (FILE_WRITE_SIZE);
+    bench_run ("message/build/qdu-file-write-1m", FILE_WRITE_SIZE, (BenchFunc) build_file_write, data);
+}
+
+/*****************************************************************************/
+/* Fragment split and reassembly */
+
+#define FRAGMENT_SIZE 4096
+
+typedef struct {
+    MbimMessage *message;
+    GPtrArray   *fragments;
+} FragmentContext;
+
+static void
+fragment_split (FragmentContext *ctx)
+{
+    struct fragment_info *fragments;
+    guint                 n_fragments = 0;
+
+    fragments = _mbim_message_split_fragments (ctx->message, FRAGMENT_SIZE, &n_fragments);
+    g_assert (fragments);
+    g_free (fragments);
+}
+
+static void
+fragment_reassemble (FragmentContext *ctx)
+{
+    MbimMessage *message;
+    guint        i;
+
+    message = _mbim_message_fragment_collector_init (g_ptr_array_index (ctx->fragments, 0), NULL);
+    g_assert (message);
+    for (i = 1; i < ctx->fragments->len; i++) {
+        if (!_mbim_message_fragment_collector_add (message, g_ptr_array_index (ctx->fragments, i), NULL))
+            g_assert_not_reached ();
+    }
+    g_assert (_mbim_message_fragment_collector_complete (message));
+    mbim_message_unref (message);
+}
+
+static void
+bench_fragments (void)
+{
+    static const guint32 sizes_mb[] = { 1, 4 };
+    guint                i;
+
+    for (i = 0; i < G_N_ELEMENTS (sizes_mb); i++) {
+        FragmentContext       ctx;
+        struct fragment_info *fragments;
+        guint                 n_fragments = 0;
+        guint                 j;
+        g_autofree gchar     *split_name = NULL;
+        g_autofree gchar     *reassemble_name = NULL;
+
+        split_name = g_strdup_printf ("fragment/split/%um", sizes_mb[i]);
+        reassemble_name = g_strdup_printf ("fragment/reassemble/%um", sizes_mb[i]);
+        if (!bench_enabled (split_name) && !bench_enabled (reassemble_name))
+            continue;
+
+        /* Indications are the messages that get reassembled on the host */
+        ctx.message = bench_indication_new (1, sizes_mb[i] * 1024 * 1024);
+        ctx.fragments = g_ptr_array_new_with_free_func ((GDestroyNotify) mbim_message_unref);
+
+        fragments = _mbim_message_split_fragments (ctx.message, FRAGMENT_SIZE, &n_fragments);
+        for (j = 0; j < n_fragments; j++) {
+            GByteArray *fragment;
+
+            fragment = g_byte_array_sized_new (sizeof (struct header) + sizeof (struct fragment_header) + fragments[j].data_length);
+            g_byte_array_append (fragment, (const guint8 *) &fragments[j].header, sizeof (struct header));
+            g_byte_array_append (fragment, (const guint8 *) &fragments[j].fragment_header, sizeof (struct fragment_header));
+            g_byte_array_append (fragment, fragments[j].data, fragments[j].data_length);
+            g_ptr_array_add (ctx.fragments, fragment);
+        }
+        g_free (fragments);
+
+        bench_run (split_name, mbim_message_get_message_length (ctx.message), (BenchFunc) fragment_split, &ctx);
+        bench_run (reassemble_name, mbim_message_get_message_length (ctx.message), (BenchFunc) fragment_reassemble, &ctx);
+
+        g_ptr_array_unref (ctx.fragments);
+        mbim_message_unref (ctx.message);
+    }
+}
+
+/*****************************************************************************/
+
+int main (int argc, char **argv)
+{
+    bench_init (&argc, &argv);
+
+    bench_parsers ();
+    bench_builders ();
+    bench_fragments ();
+
+    return 0;
+}
@@ -0,0 +1,168 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details:
+ *
+ * Copyright (C) 2026 agent <agent@local>
+ */
+
+#include <config.h>
+#include <string.h>
+
+#include "mbim-uuid.h"
+#include "mbim-basic-connect.h"
+#include "mbim-proxy-helpers.h"
+
+#include "bench-common.h"
+
+/*****************************************************************************/
+/* Subscribe list merging with N clients */
+
+#define N_SERVICES_PER_CLIENT 4
+#define N_CIDS_PER_SERVICE    8
+
+typedef struct {
+    guint             n_clients;
+    MbimEventEntry ***lists;
+} SubscribeContext;
+
+/* Every client subscribes to a few non-standard services, some of them
+ * shared with other clients, and each one with a slightly different set of
+ * cids, so that merging actually has some work to do */
+static MbimEventEntry **
+client_list_new (guint client)
+{
+    MbimEventEntry **list;
+    guint            i;
+
+    list = g_new0 (MbimEventEntry *, N_SERVICES_PER_CLIENT + 1);
+    for (i = 0; i < N_SERVICES_PER_CLIENT; i++) {
+        guint j;
+
+        list[i] = g_new0 (MbimEventEntry, 1);
+        memcpy (&list[i]->device_service_id,
+                mbim_uuid_from_service (MBIM_SERVICE_MS_BASIC_CONNECT_EXTENSIONS),
+                sizeof (MbimUuid));
+        list[i]->device_service_id.e[5] = (guint8) ((client + i) % 16);
+        list[i]->cids_count = N_CIDS_PER_SERVICE;
+        list[i]->cids = g_new (guint32, N_CIDS_PER_SERVICE);
+        for (j = 0; j < N_CIDS_PER_SERVICE; j++)
+            list[i]->cids[j] = 1 + ((client + j) % 32);
+    }
+    return list;
+}
+
+static void
+subscribe_merge (SubscribeContext *ctx)
+{
+    MbimEventEntry **merged;
+    gsize            merged_size = 0;
+    guint            i;
+
+    merged = _mbim_proxy_helper_service_subscribe_list_new_standard (&merged_size);
+    for (i = 0; i < ctx->n_clients; i++)
+        merged = _mbim_proxy_helper_service_subscribe_list_merge (merged, merged_size,
+                                                                 ctx->lists[i], N_SERVICES_PER_CLIENT,
+                                                                 &merged_size);
+    mbim_event_entry_array_free (merged);
+}
+
+static void
+subscribe_table (SubscribeContext *ctx)
+{
+    MbimProxySubscribeTable *table;
+    MbimEventEntry         **built;
+    gsize                    built_size = 0;
+    guint                    i;
+
+    table = _mbim_proxy_helper_subscribe_table_new ();
+    for (i = 0; i < ctx->n_clients; i++)
+        _mbim_proxy_helper_subscribe_table_add (table,
+                                                (const MbimEventEntry * const *) ctx->lists[i],
+                                                N_SERVICES_PER_CLIENT);
+    built = _mbim_proxy_helper_subscribe_table_build (table, &built_size);
+    mbim_event_entry_array_free (built);
+    _mbim_proxy_helper_subscribe_table_free (table);
+}
+
+typedef struct {
+    SubscribeContext        *ctx;
+    MbimProxySubscribeTable *table;
+} SubscribeUpdateContext;
+
+/* The common case in the proxy: one single client updates its list while
+ * all the others stay the same */
+static void
+subscribe_table_update (SubscribeUpdateContext *update)
+{
+    MbimEventEntry **built;
+    gsize            built_size = 0;
+
+    _mbim_proxy_helper_subscribe_table_remove (update->table,
+                                               (const MbimEventEntry * const *) update->ctx->lists[0],
+                                               N_SERVICES_PER_CLIENT);
+    _mbim_proxy_helper_subscribe_table_add (update->table,
+                                            (const MbimEventEntry * const *) update->ctx->lists[0],
+                                            N_SERVICES_PER_CLIENT);
+    built = _mbim_proxy_helper_subscribe_table_build (update->table, &built_size);
+    mbim_event_entry_array_free (built);
+}
+
+static void
+bench_subscribe (void)
+{
+    static const guint n_clients[] = { 1, 8, 64, 256 };
+    guint              i;
+
+    for (i = 0; i < G_N_ELEMENTS (n_clients); i++) {
+        SubscribeContext       ctx;
+        SubscribeUpdateContext update;
+        g_autofree gchar      *merge_name = NULL;
+        g_autofree gchar      *table_name = NULL;
+        g_autofree gchar      *update_name = NULL;
+        guint                  j;
+
+        ctx.n_clients = n_clients[i];
+        ctx.lists = g_new (MbimEventEntry **, ctx.n_clients);
+        for (j = 0; j < ctx.n_clients; j++)
+            ctx.lists[j] = client_list_new (j);
+
+        merge_name = g_strdup_printf ("proxy/subscribe/merge/%u", ctx.n_clients);
+        bench_run (merge_name, 0, (BenchFunc) subscribe_merge, &ctx);
+
+        table_name = g_strdup_printf ("proxy/subscribe/table/%u", ctx.n_clients);
+        bench_run (table_name, 0, (BenchFunc) subscribe_table, &ctx);
+
+        update.ctx = &ctx;
+        update.table = _mbim_proxy_helper_subscribe_table_new ();
+        for (j = 0; j < ctx.n_clients; j++)
+            _mbim_proxy_helper_subscribe_table_add (update.table,
+                                                    (const MbimEventEntry * const *) ctx.lists[j],
+                                                    N_SERVICES_PER_CLIENT);
+        update_name = g_strdup_printf ("proxy/subscribe/table-update/%u", ctx.n_clients);
+        bench_run (update_name, 0, (BenchFunc) subscribe_table_update, &update);
+        _mbim_proxy_helper_subscribe_table_free (update.table);
+
+        for (j = 0; j < ctx.n_clients; j++)
+            mbim_event_entry_array_free (ctx.lists[j]);
+        g_free (ctx.lists);
+    }
+}
+
+/*****************************************************************************/
+
+int main (int argc, char **argv)
+{
+    bench_init (&argc, &argv);
+
+    bench_subscribe ();
+
+    return 0;
+}
@@ -135,9 +135,12 @@ static const CidConfig cid_ms_sar_config [MBIM_CID_MS_SAR_LAST] = {
 };
 
 /* Note: index of the array is CID-1 */
-#define MBIM_CID_PROXY_CONTROL_LAST MBIM_CID_PROXY_CONTROL_CONFIGURATION
+#define MBIM_CID_PROXY_CONTROL_LAST MBIM_CID_PROXY_CONTROL_CLIENT_CONFIGURATION
 static const CidConfig cid_proxy_control_config [MBIM_CID_PROXY_CONTROL_LAST] = {
     { SET, NO_QUERY, NO_NOTIFY }, /* MBIM_CID_PROXY_CONTROL_CONFIGURATION */
+    { NO_SET, QUERY, NO_NOTIFY }, /* MBIM_CID_PROXY_CONTROL_STATISTICS */
+    { SET, NO_QUERY, NO_NOTIFY }, /* MBIM_CID_PROXY_CONTROL_INDICATION_POLICY */
+    { SET, NO_QUERY, NO_NOTIFY }, /* MBIM_CID_PROXY_CONTROL_CLIENT_CONFIGURATION */
 };
 
 /* Note: index of the array is CID-1 */
@@ -184,157 +187,103 @@ static const CidConfig cid_qdu_config [MBIM_CID_QDU_LAST] = {
     { SET,    NO_QUERY, NO_NOTIFY }, /* MBIM_CID_QDU_FILE_OPEN */
     { SET,    NO_QUERY, NO_NOTIFY }, /* MBIM_CID_QDU_FILE_WRITE */
 };
+
+/*****************************************************************************/
+
+typedef const gchar * (* CidGetStringFunc) (guint cid);
+
+typedef struct {
+    const CidConfig  *configs;
+    guint             n_configs;
+    CidGetStringFunc  get_string;
+} CidServiceConfig;
+
+#define CID_SERVICE_CONFIG(service) {                                   \
+        cid_##service##_config,                                         \
+        G_N_ELEMENTS (cid_##service##_config),                          \
+        (CidGetStringFunc) mbim_cid_##service##_get_string              \
+    }
+
+/* Note: index of the array is the service */
+static const CidServiceConfig cid_service_config [MBIM_SERVICE_LAST] = {
+    [MBIM_SERVICE_BASIC_CONNECT]               = CID_SERVICE_CONFIG (basic_connect),
+    [MBIM_SERVICE_SMS]                         = CID_SERVICE_CONFIG (sms),
+    [MBIM_SERVICE_USSD]                        = CID_SERVICE_CONFIG (ussd),
+    [MBIM_SERVICE_PHONEBOOK]                   = CID_SERVICE_CONFIG (phonebook),
+    [MBIM_SERVICE_STK]                         = CID_SERVICE_CONFIG (stk),
+    [MBIM_SERVICE_AUTH]                        = CID_SERVICE_CONFIG (auth),
+    [MBIM_SERVICE_DSS]                         = CID_SERVICE_CONFIG (dss),
+    [MBIM_SERVICE_MS_FIRMWARE_ID]              = CID_SERVICE_CONFIG (ms_firmware_id),
+    [MBIM_SERVICE_MS_HOST_SHUTDOWN]            = CID_SERVICE_CONFIG (ms_host_shutdown),
+    [MBIM_SERVICE_MS_SAR]                      = CID_SERVICE_CONFIG (ms_sar),
+    [MBIM_SERVICE_PROXY_CONTROL]               = CID_SERVICE_CONFIG (proxy_control),
+    [MBIM_SERVICE_QMI]                         = CID_SERVICE_CONFIG (qmi),
+    [MBIM_SERVICE_ATDS]                        = CID_SERVICE_CONFIG (atds),
+    [MBIM_SERVICE_INTEL_FIRMWARE_UPDATE]       = CID_SERVICE_CONFIG (intel_firmware_update),
+    [MBIM_SERVICE_QDU]                         = CID_SERVICE_CONFIG (qdu),
+    [MBIM_SERVICE_MS_BASIC_CONNECT_EXTENSIONS] = CID_SERVICE_CONFIG (ms_basic_connect_extensions),
+};
+
+/* Returns NULL for custom services and for CIDs not known in the service */
+static const CidConfig *
+cid_config_lookup (MbimService service,
+                   guint       cid)
+{
+    const CidServiceConfig *service_config;
+
+    if (service >= MBIM_SERVICE_LAST)
+        return NULL;
+
+    service_config = &cid_service_config[service];
+    if (cid > service_config->n_configs)
+        return NULL;
+
+    return &service_config->configs[cid - 1];
+}
+
 gboolean
 mbim_cid_can_set (MbimService service,
                   guint       cid)
 {
+    const CidConfig *config;
+
     /* CID = 0 is never a valid command */
     g_return_val_if_fail (cid > 0, FALSE);
     /* Known service required */
     g_return_val_if_fail (service > MBIM_SERVICE_INVALID, FALSE);
-    g_return_val_if_fail (service < MBIM_SERVICE_LAST, FALSE);
-
-    switch (service) {
-    case MBIM_SERVICE_BASIC_CONNECT:
-        return cid_basic_connect_config[cid - 1].set;
-    case MBIM_SERVICE_SMS:
-        return cid_sms_config[cid - 1].set;
-    case MBIM_SERVICE_USSD:
-        return cid_ussd_config[cid - 1].set;
-    case MBIM_SERVICE_PHONEBOOK:
-        return cid_phonebook_config[cid - 1].set;
-    case MBIM_SERVICE_STK:
-        return cid_stk_config[cid - 1].set;
-    case MBIM_SERVICE_AUTH:
-        return cid_auth_config[cid - 1].set;
-    case MBIM_SERVICE_DSS:
-        return cid_dss_config[cid - 1].set;
-    case MBIM_SERVICE_MS_FIRMWARE_ID:
-        return cid_ms_firmware_id_config[cid - 1].set;
-    case MBIM_SERVICE_MS_HOST_SHUTDOWN:
-        return cid_ms_host_shutdown_config[cid - 1].set;
-    case MBIM_SERVICE_MS_SAR:
-        return cid_ms_sar_config[cid - 1].set;
-    case MBIM_SERVICE_PROXY_CONTROL:
-        return cid_proxy_control_config[cid - 1].set;
-    case MBIM_SERVICE_QMI:
-        return cid_qmi_config[cid - 1].set;
-    case MBIM_SERVICE_ATDS:
-        return cid_atds_config[cid - 1].set;
-    case MBIM_SERVICE_INTEL_FIRMWARE_UPDATE:
-        return cid_intel_firmware_update_config[cid - 1].set;
-    case MBIM_SERVICE_QDU:
-        return cid_qdu_config[cid - 1].set;
-    case MBIM_SERVICE_MS_BASIC_CONNECT_EXTENSIONS:
-        return cid_ms_basic_connect_extensions_config[cid - 1].set;
-    case MBIM_SERVICE_INVALID:
-    case MBIM_SERVICE_LAST:
-    default:
-        g_assert_not_reached ();
-        return FALSE;
-    }
+
+    config = cid_config_lookup (service, cid);
+    return config ? config->set : FALSE;
 }
 
 gboolean
 mbim_cid_can_query (MbimService service,
                     guint       cid)
 {
+    const CidConfig *config;
+
     /* CID = 0 is never a valid command */
     g_return_val_if_fail (cid > 0, FALSE);
     /* Known service required */
     g_return_val_if_fail (service > MBIM_SERVICE_INVALID, FALSE);
-    g_return_val_if_fail (service < MBIM_SERVICE_LAST, FALSE);
-
-    switch (service) {
-    case MBIM_SERVICE_BASIC_CONNECT:
-        return cid_basic_connect_config[cid - 1].query;
-    case MBIM_SERVICE_SMS:
-        return cid_sms_config[cid - 1].query;
-    case MBIM_SERVICE_USSD:
-        return cid_ussd_config[cid - 1].query;
-    case MBIM_SERVICE_PHONEBOOK:
-        return cid_phonebook_config[cid - 1].query;
-    case MBIM_SERVICE_STK:
-        return cid_stk_config[cid - 1].query;
-    case MBIM_SERVICE_AUTH:
-        return cid_auth_config[cid - 1].query;
-    case MBIM_SERVICE_DSS:
-        return cid_dss_config[cid - 1].query;
-    case MBIM_SERVICE_MS_FIRMWARE_ID:
-        return cid_ms_firmware_id_config[cid - 1].query;
-    case MBIM_SERVICE_MS_HOST_SHUTDOWN:
-        return cid_ms_host_shutdown_config[cid - 1].query;
-    case MBIM_SERVICE_MS_SAR:
-        return cid_ms_sar_config[cid - 1].query;
-    case MBIM_SERVICE_PROXY_CONTROL:
-        return cid_proxy_control_config[cid - 1].query;
-    case MBIM_SERVICE_QMI:
-        return cid_qmi_config[cid - 1].query;
-    case MBIM_SERVICE_ATDS:
-        return cid_atds_config[cid - 1].query;
-    case MBIM_SERVICE_INTEL_FIRMWARE_UPDATE:
-        return cid_intel_firmware_update_config[cid - 1].query;
-    case MBIM_SERVICE_QDU:
-        return cid_qdu_config[cid - 1].query;
-    case MBIM_SERVICE_MS_BASIC_CONNECT_EXTENSIONS:
-        return cid_ms_basic_connect_extensions_config[cid - 1].query;
-    case MBIM_SERVICE_INVALID:
-    case MBIM_SERVICE_LAST:
-    default:
-        g_assert_not_reached ();
-        return FALSE;
-    }
+
+    config = cid_config_lookup (service, cid);
+    return config ? config->query : FALSE;
 }
 
 gboolean
 mbim_cid_can_notify (MbimService service,
                      guint       cid)
 {
+    const CidConfig *config;
+
     /* CID = 0 is never a valid command */
     g_return_val_if_fail (cid > 0, FALSE);
     /* Known service required */
     g_return_val_if_fail (service > MBIM_SERVICE_INVALID, FALSE);
-    g_return_val_if_fail (service < MBIM_SERVICE_LAST, FALSE);
-
-    switch (service) {
-    case MBIM_SERVICE_BASIC_CONNECT:
-        return cid_basic_connect_config[cid - 1].notify;
-    case MBIM_SERVICE_SMS:
-        return cid_sms_config[cid - 1].notify;
-    case MBIM_SERVICE_USSD:
-        return cid_ussd_config[cid - 1].notify;
-    case MBIM_SERVICE_PHONEBOOK:
-        return cid_phonebook_config[cid - 1].notify;
-    case MBIM_SERVICE_STK:
-        return cid_stk_config[cid - 1].notify;
-    case MBIM_SERVICE_AUTH:
-        return cid_auth_config[cid - 1].notify;
-    case MBIM_SERVICE_DSS:
-        return cid_dss_config[cid - 1].notify;
-    case MBIM_SERVICE_MS_FIRMWARE_ID:
-        return cid_ms_firmware_id_config[cid - 1].notify;
-    case MBIM_SERVICE_MS_HOST_SHUTDOWN:
-        return cid_ms_host_shutdown_config[cid - 1].notify;
-    case MBIM_SERVICE_MS_SAR:
-        return cid_ms_sar_config[cid - 1].notify;
-    case MBIM_SERVICE_PROXY_CONTROL:
-        return cid_proxy_control_config[cid - 1].notify;
-    case MBIM_SERVICE_QMI:
-        return cid_qmi_config[cid - 1].notify;
-    case MBIM_SERVICE_ATDS:
-        return cid_atds_config[cid - 1].notify;
-    case MBIM_SERVICE_INTEL_FIRMWARE_UPDATE:
-        return cid_intel_firmware_update_config[cid - 1].notify;
-    case MBIM_SERVICE_QDU:
-        return cid_qdu_config[cid - 1].notify;
-    case MBIM_SERVICE_MS_BASIC_CONNECT_EXTENSIONS:
-        return cid_ms_basic_connect_extensions_config[cid - 1].notify;
-    case MBIM_SERVICE_INVALID:
-    case MBIM_SERVICE_LAST:
-    default:
-        g_assert_not_reached ();
-        return FALSE;
-    }
+
+    config = cid_config_lookup (service, cid);
+    return config ? config->notify : FALSE;
 }
 
 const gchar *
@@ -343,47 +292,13 @@ mbim_cid_get_printable (MbimService service,
 {
     /* CID = 0 is never a valid command */
     g_return_val_if_fail (cid > 0, NULL);
-    /* Known service required */
-    g_return_val_if_fail (service < MBIM_SERVICE_LAST, NULL);
 
-    switch (service) {
-    case MBIM_SERVICE_INVALID:
+    if (service == MBIM_SERVICE_INVALID)
         return "invalid";
-    case MBIM_SERVICE_BASIC_CONNECT:
-        return mbim_cid_basic_connect_get_string (cid);
-    case MBIM_SERVICE_SMS:
-        return mbim_cid_sms_get_string (cid);
-    case MBIM_SERVICE_USSD:
-        return mbim_cid_ussd_get_string (cid);
-    case MBIM_SERVICE_PHONEBOOK:
-        return mbim_cid_phonebook_get_string (cid);
-    case MBIM_SERVICE_STK:
-        return mbim_cid_stk_get_string (cid);
-    case MBIM_SERVICE_AUTH:
-        return mbim_cid_auth_get_string (cid);
-    case MBIM_SERVICE_DSS:
-        return mbim_cid_dss_get_string (cid);
-    case MBIM_SERVICE_MS_FIRMWARE_ID:
-        return mbim_cid_ms_firmware_id_get_string (cid);
-    case MBIM_SERVICE_MS_HOST_SHUTDOWN:
-        return mbim_cid_ms_host_shutdown_get_string (cid);
-    case MBIM_SERVICE_MS_SAR:
-        return mbim_cid_ms_sar_get_string (cid);
-    case MBIM_SERVICE_PROXY_CONTROL:
-        return mbim_cid_proxy_control_get_string (cid);
-    case MBIM_SERVICE_QMI:
-        return mbim_cid_qmi_get_string (cid);
-    case MBIM_SERVICE_ATDS:
-        return mbim_cid_atds_get_string (cid);
-    case MBIM_SERVICE_INTEL_FIRMWARE_UPDATE:
-        return mbim_cid_intel_firmware_update_get_string (cid);
-    case MBIM_SERVICE_QDU:
-        return mbim_cid_qdu_get_string (cid);
-    case MBIM_SERVICE_MS_BASIC_CONNECT_EXTENSIONS:
-        return mbim_cid_ms_basic_connect_extensions_get_string (cid);
-    case MBIM_SERVICE_LAST:
-    default:
-        g_assert_not_reached ();
+
+    /* No printable CIDs for custom services */
+    if (service >= MBIM_SERVICE_LAST)
         return NULL;
-    }
+
+    return cid_service_config[service].get_string (cid);
 }
@@ -253,14 +253,20 @@ typedef enum { /*< since=1.26 >*/
  * MbimCidProxyControl:
  * @MBIM_CID_PROXY_CONTROL_UNKNOWN: Unknown command.
  * @MBIM_CID_PROXY_CONTROL_CONFIGURATION: Configuration.
+ * @MBIM_CID_PROXY_CONTROL_STATISTICS: Statistics. Since 1.26.
+ * @MBIM_CID_PROXY_CONTROL_INDICATION_POLICY: Indication policy. Since 1.26.
+ * @MBIM_CID_PROXY_CONTROL_CLIENT_CONFIGURATION: Client configuration. Since 1.26.
  *
  * MBIM commands in the %MBIM_SERVICE_PROXY_CONTROL service.
  *
  * Since: 1.10
  */
 typedef enum { /*< since=1.10 >*/
-    MBIM_CID_PROXY_CONTROL_UNKNOWN       = 0,
-    MBIM_CID_PROXY_CONTROL_CONFIGURATION = 1
+    MBIM_CID_PROXY_CONTROL_UNKNOWN              = 0,
+    MBIM_CID_PROXY_CONTROL_CONFIGURATION        = 1,
+    MBIM_CID_PROXY_CONTROL_STATISTICS           = 2,
+    MBIM_CID_PROXY_CONTROL_INDICATION_POLICY    = 3,
+    MBIM_CID_PROXY_CONTROL_CLIENT_CONFIGURATION = 4
 } MbimCidProxyControl;
 
 /**
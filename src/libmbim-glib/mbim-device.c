@@ -35,14 +35,19 @@
 #include <unistd.h>
 #include <gio/gio.h>
 #include <gio/gunixsocketaddress.h>
+#include <glib-unix.h>
+#include <glib/gstdio.h>
 #include <sys/ioctl.h>
+#include <poll.h>
 #define IOCTL_WDM_MAX_COMMAND _IOR('H', 0xA0, guint16)
 
 #define OPEN_RETRY_TIMEOUT_SECS 5
 #define OPEN_CLOSE_TIMEOUT_SECS 2
+#define OPEN_CHECK_TIMEOUT_SECS 1
 
 #include "mbim-common.h"
 #include "mbim-utils.h"
+#include "mbim-utils-private.h"
 #include "mbim-device.h"
 #include "mbim-message.h"
 #include "mbim-message-private.h"
@@ -51,7 +56,11 @@
 #include "mbim-helpers.h"
 #include "mbim-proxy.h"
 #include "mbim-proxy-control.h"
+#include "mbim-basic-connect.h"
 #include "mbim-net-port-manager.h"
+#include "mbim-timer-queue.h"
+#include "mbim-statistics.h"
+#include "mbim-indication-filter.h"
 
 static void async_initable_iface_init (GAsyncInitableIface *iface);
 
@@ -72,6 +81,8 @@ enum {
     SIGNAL_INDICATE_STATUS,
     SIGNAL_ERROR,
     SIGNAL_REMOVED,
+    SIGNAL_LINK_ADDED,
+    SIGNAL_LINK_REMOVED,
     SIGNAL_LAST
 };
 
@@ -84,6 +95,45 @@ typedef enum {
     TRANSACTION_TYPE_LAST    = 2
 } TransactionType;
 
+typedef struct _ReaderThread ReaderThread;
+
+/* Outstanding transaction IDs are usually a small window of sequential
+ * values, so they're stored in a linear-probing table indexed by the ID
+ * itself, with the message type inline so that it can be matched without
+ * looking at the task data. */
+typedef struct {
+    guint32          transaction_id;
+    MbimMessageType  type;
+    GTask           *task; /* NULL if empty */
+} TransactionSlot;
+
+typedef struct {
+    TransactionSlot *slots;
+    guint            n_slots; /* always a power of 2 */
+    guint            n_used;
+} TransactionTable;
+
+/* Statistics, only updated and read in the device context */
+typedef struct {
+    guint64               messages_sent;
+    guint64               fragments_sent;
+    guint64               bytes_sent;
+    guint64               writes;
+    guint64               messages_received;
+    guint64               fragments_received;
+    guint64               bytes_received;
+    guint64               read_wakeups;
+    guint64               timeouts;
+    guint64               indications;
+    MbimEventRate         indication_rate;
+    guint                 pending_transactions_high_water_mark;
+    /* Round trip time of all host transactions */
+    MbimLatencyHistogram  latency;
+    /* Time between the first and last fragment of a received message */
+    MbimLatencyHistogram  reassembly;
+    GHashTable           *commands;
+} DeviceStatistics;
+
 typedef enum {
     OPEN_STATUS_CLOSED  = 0,
     OPEN_STATUS_OPENING = 1,
@@ -103,18 +153,40 @@ struct _MbimDevicePrivate {
     GIOChannel *iochannel;
     GSource *iochannel_source;
     GByteArray *response;
+
+    /* Buffer reused to build the traces */
+    GString *trace_buffer;
+    ReaderThread *reader_thread;
+
+    /* Outbound queue, used whenever the port doesn't accept more data */
+    GQueue write_queue;
+    gsize write_queue_offset;
+    gsize write_queue_size;
+    gsize write_queue_high_water_mark;
+    GSource *write_source;
+    GSList *write_queue_waiters;
+    gboolean submitting_batch;
+    /* Messages of the batch being submitted, written all at once */
+    GByteArray *batch_buffer;
+
+    /* Command stream in progress (not owned); other messages are held until
+     * it's done so that fragments of different messages are never interleaved */
+    GTask *command_stream;
+    gboolean command_stream_writing;
+    GQueue held_queue;
     OpenStatus open_status;
     guint32 open_transaction_id;
 
     /* Support for mbim-proxy */
     GSocketClient *socket_client;
+    guint proxy_command_timeout;
     GSocketConnection *socket_connection;
 
-    /* HT to keep track of ongoing host/function transactions
+    /* Tables to keep track of ongoing host/function transactions
      *  Host transactions:  created by us
      *  Modem transactions: modem-created indications with multiple fragments
      */
-    GHashTable *transactions[TRANSACTION_TYPE_LAST];
+    TransactionTable transactions[TRANSACTION_TYPE_LAST];
 
     /* Transaction ID in the device */
     guint32 transaction_id;
@@ -127,15 +199,33 @@ struct _MbimDevicePrivate {
 
     /* Link management */
     MbimNetPortManager *net_port_manager;
+
+    DeviceStatistics stats;
+
+    /* Indication policies, created when the first one is set */
+    MbimIndicationFilter *indication_filter;
+
+    /* Commands submitted from other threads, and the source processing them
+     * in the context where the device was opened. The source only exists
+     * while the device is open, and the lock protects the source pointer. */
+    gpointer submitted_commands;
+    GSource *submit_source;
+    GMutex submit_lock;
 };
 
 #define MAX_SPAWN_RETRIES             10
+#define MAX_SPAWN_WAIT_MS             1000
 #define MAX_CONTROL_TRANSFER          4096
+#define MIN_CONTROL_TRANSFER          64
 #define MAX_TIME_BETWEEN_FRAGMENTS_MS 1250
+#define RESPONSE_BUFFER_DEFAULT_SIZE  500
 
 static void device_report_error (MbimDevice   *self,
                                  guint32       transaction_id,
                                  const GError *error);
+static void setup_submit_source    (MbimDevice *self);
+static void teardown_submit_source (MbimDevice *self);
+static void write_queue_flush   (MbimDevice   *self);
 
 /*****************************************************************************/
 /* Message transactions (private) */
@@ -150,10 +240,18 @@ typedef struct {
     MbimMessage            *fragments;
     MbimMessageType         type;
     guint32                 transaction_id;
-    GSource                *timeout_source;
+    MbimTimerQueue         *timer_queue;
+    MbimTimer              *timer;
     GCancellable           *cancellable;
     gulong                  cancellable_id;
-    TransactionWaitContext *wait_ctx;
+    /* Only set once the transaction is stored */
+    TransactionWaitContext  wait_ctx;
+    /* Statistics */
+    gint64                  start_time;
+    gint64                  first_fragment_time;
+    gboolean                is_command;
+    MbimUuid                service_id;
+    guint32                 cid;
 } TransactionContext;
 
 static void
@@ -162,10 +260,10 @@ transaction_context_free (TransactionContext *ctx)
     if (ctx->fragments)
         mbim_message_unref (ctx->fragments);
 
-    if (ctx->timeout_source) {
-        if (!g_source_is_destroyed (ctx->timeout_source))
-            g_source_destroy (ctx->timeout_source);
-        g_source_unref (ctx->timeout_source);
+    if (ctx->timer_queue) {
+        if (ctx->timer)
+            mbim_timer_queue_remove (ctx->timer_queue, ctx->timer);
+        mbim_timer_queue_unref (ctx->timer_queue);
     }
 
     if (ctx->cancellable) {
@@ -174,9 +272,6 @@ transaction_context_free (TransactionContext *ctx)
         g_object_unref (ctx->cancellable);
     }
 
-    if (ctx->wait_ctx)
-        g_slice_free (TransactionWaitContext, ctx->wait_ctx);
-
     g_slice_free (TransactionContext, ctx);
 }
 
@@ -226,6 +321,57 @@ transaction_task_new (MbimDevice          *self,
     return task;
 }
 
+static void
+transaction_task_set_command (GTask          *task,
+                              const MbimUuid *service_id,
+                              guint32         cid)
+{
+    TransactionContext *ctx;
+
+    ctx = g_task_get_task_data (task);
+    ctx->is_command = TRUE;
+    memcpy (&ctx->service_id, service_id, sizeof (MbimUuid));
+    ctx->cid = cid;
+}
+
+static void
+transaction_task_update_statistics (GTask        *task,
+                                    const GError *error)
+{
+    MbimDevice            *self;
+    TransactionContext    *ctx;
+    MbimCommandStatistics *command_stats = NULL;
+    gint64                 latency;
+
+    ctx = g_task_get_task_data (task);
+
+    /* Only host transactions that were stored have a start time */
+    if (!ctx->start_time)
+        return;
+
+    self = g_task_get_source_object (task);
+    latency = g_get_monotonic_time () - ctx->start_time;
+
+    if (ctx->is_command) {
+        command_stats = mbim_command_statistics_table_lookup (self->priv->stats.commands,
+                                                              &ctx->service_id,
+                                                              ctx->cid);
+        command_stats->count++;
+    }
+
+    if (!error) {
+        mbim_latency_histogram_add (&self->priv->stats.latency, latency);
+        if (command_stats)
+            mbim_latency_histogram_add (&command_stats->latency, latency);
+    } else if (command_stats) {
+        if (g_error_matches (error, MBIM_CORE_ERROR, MBIM_CORE_ERROR_TIMEOUT) ||
+            g_error_matches (error, MBIM_PROTOCOL_ERROR, MBIM_PROTOCOL_ERROR_TIMEOUT_FRAGMENT))
+            command_stats->timeouts++;
+        else
+            command_stats->errors++;
+    }
+}
+
 static void
 transaction_task_complete_and_free (GTask        *task,
                                     const GError *error)
@@ -234,6 +380,15 @@ transaction_task_complete_and_free (GTask        *task,
 
     ctx = g_task_get_task_data (task);
 
+    /* The transaction is gone from the table, so make sure the timeout
+     * doesn't fire while the task is being finalized */
+    if (ctx->timer) {
+        mbim_timer_queue_remove (ctx->timer_queue, ctx->timer);
+        ctx->timer = NULL;
+    }
+
+    transaction_task_update_statistics (task, error);
+
     if (error) {
         transaction_task_trace (task, "complete: error");
         g_task_return_error (task, g_error_copy (error));
@@ -246,53 +401,151 @@ transaction_task_complete_and_free (GTask        *task,
     g_object_unref (task);
 }
 
+#define TRANSACTION_TABLE_INITIAL_SIZE 16
+
+static TransactionSlot *
+transaction_table_lookup (TransactionTable *table,
+                          guint32           transaction_id)
+{
+    guint i;
+
+    if (!table->n_used)
+        return NULL;
+
+    for (i = transaction_id & (table->n_slots - 1);
+         table->slots[i].task != NULL;
+         i = (i + 1) & (table->n_slots - 1)) {
+        if (table->slots[i].transaction_id == transaction_id)
+            return &table->slots[i];
+    }
+    return NULL;
+}
+
+static void
+transaction_table_insert (TransactionTable *table,
+                          guint32           transaction_id,
+                          MbimMessageType   type,
+                          GTask            *task)
+{
+    guint i;
+
+    g_assert (task != NULL);
+
+    /* Keep the load factor at or below 1/2 */
+    if ((table->n_used + 1) * 2 > table->n_slots) {
+        TransactionSlot *old_slots;
+        guint            old_n_slots;
+        guint            j;
+
+        old_slots = table->slots;
+        old_n_slots = table->n_slots;
+        table->n_slots = (old_n_slots ? old_n_slots * 2 : TRANSACTION_TABLE_INITIAL_SIZE);
+        table->slots = g_new0 (TransactionSlot, table->n_slots);
+        table->n_used = 0;
+        for (j = 0; j < old_n_slots; j++) {
+            if (old_slots[j].task != NULL)
+                transaction_table_insert (table,
+                                          old_slots[j].transaction_id,
+                                          old_slots[j].type,
+                                          old_slots[j].task);
+        }
+        g_free (old_slots);
+    }
+
+    for (i = transaction_id & (table->n_slots - 1);
+         table->slots[i].task != NULL && table->slots[i].transaction_id != transaction_id;
+         i = (i + 1) & (table->n_slots - 1));
+
+    if (table->slots[i].task == NULL)
+        table->n_used++;
+    table->slots[i].transaction_id = transaction_id;
+    table->slots[i].type = type;
+    table->slots[i].task = task;
+}
+
+static void
+transaction_table_remove (TransactionTable *table,
+                          TransactionSlot  *slot)
+{
+    guint mask;
+    guint i;
+    guint j;
+
+    mask = table->n_slots - 1;
+    i = slot - table->slots;
+
+    /* Backward-shift deletion, so that no tombstones are needed: move back
+     * any following entry that would become unreachable */
+    j = i;
+    while (TRUE) {
+        guint home;
+
+        j = (j + 1) & mask;
+        if (table->slots[j].task == NULL)
+            break;
+
+        /* Entries whose home slot is cyclically in (i, j] stay in place */
+        home = table->slots[j].transaction_id & mask;
+        if ((i <= j) ? ((i < home) && (home <= j)) : ((i < home) || (home <= j)))
+            continue;
+
+        table->slots[i] = table->slots[j];
+        i = j;
+    }
+
+    memset (&table->slots[i], 0, sizeof (TransactionSlot));
+    table->n_used--;
+}
+
 static GTask *
 device_release_transaction (MbimDevice      *self,
                             TransactionType  type,
                             MbimMessageType  expected_type,
                             guint32          transaction_id)
 {
-    GTask              *task;
-    TransactionContext *ctx;
+    GTask           *task;
+    TransactionSlot *slot;
 
     g_assert ((type != TRANSACTION_TYPE_UNKNOWN) && (type < TRANSACTION_TYPE_LAST));
 
-    /* Only return transaction if it was released from the HT */
-    if (!self->priv->transactions[type])
-        return NULL;
-
-    task = g_hash_table_lookup (self->priv->transactions[type], GUINT_TO_POINTER (transaction_id));
-    if (!task)
+    /* Only return transaction if it was released from the table */
+    slot = transaction_table_lookup (&self->priv->transactions[type], transaction_id);
+    if (!slot)
         return NULL;
 
-    ctx = g_task_get_task_data (task);
-    if ((ctx->type == expected_type) || (expected_type == MBIM_MESSAGE_TYPE_INVALID)) {
-        /* If found, remove it from the HT */
+    if ((slot->type == expected_type) || (expected_type == MBIM_MESSAGE_TYPE_INVALID)) {
+        /* If found, remove it from the table */
+        task = slot->task;
         transaction_task_trace (task, "release");
-        g_hash_table_remove (self->priv->transactions[type], GUINT_TO_POINTER (transaction_id));
+        transaction_table_remove (&self->priv->transactions[type], slot);
         return task;
     }
 
     return NULL;
 }
 
-static gboolean
+static void
 transaction_timed_out (TransactionWaitContext *wait_ctx)
 {
     GTask              *task;
     TransactionContext *ctx;
     g_autoptr(GError)   error = NULL;
 
+    /* The timer is disposed by the queue once expired, clear it even if the
+     * transaction is no longer in the table */
+    ctx = G_STRUCT_MEMBER_P (wait_ctx, -G_STRUCT_OFFSET (TransactionContext, wait_ctx));
+    ctx->timer = NULL;
+
     task = device_release_transaction (wait_ctx->self,
                                        wait_ctx->type,
                                        MBIM_MESSAGE_TYPE_INVALID,
                                        wait_ctx->transaction_id);
     if (!task)
         /* transaction already completed */
-        return FALSE;
+        return;
 
-    ctx = g_task_get_task_data (task);
-    ctx->timeout_source = NULL;
+    if (wait_ctx->type == TRANSACTION_TYPE_HOST)
+        wait_ctx->self->priv->stats.timeouts++;
 
     /* If no fragment was received, complete transaction with a timeout error */
     if (!ctx->fragments)
@@ -312,7 +565,6 @@ transaction_timed_out (TransactionWaitContext *wait_ctx)
     }
 
     transaction_task_complete_and_free (task, error);
-    return G_SOURCE_REMOVE;
 }
 
 static void
@@ -356,9 +608,6 @@ device_store_transaction (MbimDevice       *self,
 
     transaction_task_trace (task, "store");
 
-    if (G_UNLIKELY (!self->priv->transactions[type]))
-        self->priv->transactions[type] = g_hash_table_new (g_direct_hash, g_direct_equal);
-
     ctx = g_task_get_task_data (task);
 
     /* When storing the transaction in the device, we have two options: either this
@@ -367,15 +616,19 @@ device_store_transaction (MbimDevice       *self,
      * make sure we don't reset the wait context or the timeout. */
 
     /* don't add timeout and setup wait context if one already exists */
-    if (!ctx->timeout_source) {
-        g_assert (!ctx->wait_ctx);
-        ctx->wait_ctx = g_slice_new (TransactionWaitContext);
-        ctx->wait_ctx->self = self;
-        ctx->wait_ctx->transaction_id = ctx->transaction_id;
-        ctx->wait_ctx->type = type;
-        ctx->timeout_source = g_timeout_source_new (timeout_ms);
-        g_source_set_callback (ctx->timeout_source, (GSourceFunc)transaction_timed_out, ctx->wait_ctx, NULL);
-        g_source_attach (ctx->timeout_source, g_main_context_get_thread_default ());
+    if (!ctx->wait_ctx.self) {
+        ctx->wait_ctx.self = self;
+        ctx->wait_ctx.transaction_id = ctx->transaction_id;
+        ctx->wait_ctx.type = type;
+        /* All transaction timeouts in the same context are driven by one
+         * single shared timer queue */
+        ctx->timer_queue = mbim_timer_queue_ref_for_context (g_main_context_get_thread_default ());
+        ctx->timer = mbim_timer_queue_add (ctx->timer_queue,
+                                           timeout_ms,
+                                           (MbimTimerFunc)transaction_timed_out,
+                                           &ctx->wait_ctx);
+        if (type == TRANSACTION_TYPE_HOST)
+            ctx->start_time = g_get_monotonic_time ();
     }
 
     /* Indication transactions don't have cancellable */
@@ -384,7 +637,7 @@ device_store_transaction (MbimDevice       *self,
          * cancellable is already cancelled */
         ctx->cancellable_id = g_cancellable_connect (ctx->cancellable,
                                                      (GCallback)transaction_cancelled,
-                                                     ctx->wait_ctx,
+                                                     &ctx->wait_ctx,
                                                      NULL);
         if (!ctx->cancellable_id) {
             g_set_error_literal (error,
@@ -395,8 +648,12 @@ device_store_transaction (MbimDevice       *self,
         }
     }
 
-    /* Keep in the HT */
-    g_hash_table_insert (self->priv->transactions[type], GUINT_TO_POINTER (ctx->transaction_id), task);
+    /* Keep in the table */
+    transaction_table_insert (&self->priv->transactions[type], ctx->transaction_id, ctx->type, task);
+
+    if (type == TRANSACTION_TYPE_HOST &&
+        self->priv->transactions[type].n_used > self->priv->stats.pending_transactions_high_water_mark)
+        self->priv->stats.pending_transactions_high_water_mark = self->priv->transactions[type].n_used;
 
     return TRUE;
 }
@@ -512,6 +769,20 @@ reload_wwan_iface_name (MbimDevice *self)
      * the usbmisc subsystem */
 }
 
+static void
+net_port_manager_link_added_cb (MbimDevice  *self,
+                                const gchar *ifname)
+{
+    g_signal_emit (self, signals[SIGNAL_LINK_ADDED], 0, ifname);
+}
+
+static void
+net_port_manager_link_removed_cb (MbimDevice  *self,
+                                  const gchar *ifname)
+{
+    g_signal_emit (self, signals[SIGNAL_LINK_REMOVED], 0, ifname);
+}
+
 static gboolean
 setup_net_port_manager (MbimDevice  *self,
                         GError    **error)
@@ -529,7 +800,14 @@ setup_net_port_manager (MbimDevice  *self,
     }
 
     self->priv->net_port_manager = mbim_net_port_manager_new (self->priv->wwan_iface, error);
-    return !!self->priv->net_port_manager;
+    if (!self->priv->net_port_manager)
+        return FALSE;
+
+    g_signal_connect_swapped (self->priv->net_port_manager, "link-added",
+                              G_CALLBACK (net_port_manager_link_added_cb), self);
+    g_signal_connect_swapped (self->priv->net_port_manager, "link-removed",
+                              G_CALLBACK (net_port_manager_link_removed_cb), self);
+    return TRUE;
 }
 
 /*****************************************************************************/
@@ -678,6 +956,157 @@ mbim_device_delete_link (MbimDevice          *self,
 
 /*****************************************************************************/
 
+typedef struct {
+    GPtrArray *ifnames;
+    GArray    *session_ids;
+} AddLinksResult;
+
+static void
+add_links_result_free (AddLinksResult *ctx)
+{
+    if (ctx->ifnames)
+        g_ptr_array_unref (ctx->ifnames);
+    if (ctx->session_ids)
+        g_array_unref (ctx->session_ids);
+    g_free (ctx);
+}
+
+GPtrArray *
+mbim_device_add_links_finish (MbimDevice    *self,
+                              GAsyncResult  *res,
+                              GArray       **session_ids,
+                              GError       **error)
+{
+    AddLinksResult *ctx;
+    GPtrArray      *ifnames;
+
+    ctx = g_task_propagate_pointer (G_TASK (res), error);
+    if (!ctx)
+        return NULL;
+
+    if (session_ids)
+        *session_ids = g_steal_pointer (&ctx->session_ids);
+
+    ifnames = g_steal_pointer (&ctx->ifnames);
+    add_links_result_free (ctx);
+    return ifnames;
+}
+
+static void
+device_add_links_ready (MbimNetPortManager *net_port_manager,
+                        GAsyncResult       *res,
+                        GTask              *task)
+{
+    GError         *error = NULL;
+    AddLinksResult *ctx;
+
+    ctx = g_new0 (AddLinksResult, 1);
+    ctx->ifnames = mbim_net_port_manager_add_links_finish (net_port_manager, &ctx->session_ids, res, &error);
+
+    if (!ctx->ifnames) {
+        g_prefix_error (&error, "Could not allocate links: ");
+        g_task_return_error (task, error);
+        add_links_result_free (ctx);
+    } else
+        g_task_return_pointer (task, ctx, (GDestroyNotify) add_links_result_free);
+
+    g_object_unref (task);
+}
+
+void
+mbim_device_add_links (MbimDevice          *self,
+                       const guint         *session_ids,
+                       guint                n_session_ids,
+                       const gchar         *base_ifname,
+                       const gchar         *ifname_prefix,
+                       GCancellable        *cancellable,
+                       GAsyncReadyCallback  callback,
+                       gpointer             user_data)
+{
+    GTask  *task;
+    GError *error = NULL;
+    guint   i;
+
+    g_return_if_fail (MBIM_IS_DEVICE (self));
+    g_return_if_fail (base_ifname);
+    g_return_if_fail (session_ids || !n_session_ids);
+    for (i = 0; i < n_session_ids; i++)
+        g_return_if_fail ((session_ids[i] <= MBIM_DEVICE_SESSION_ID_MAX) || (session_ids[i] == MBIM_DEVICE_SESSION_ID_AUTOMATIC));
+
+    task = g_task_new (self, cancellable, callback, user_data);
+
+    if (!setup_net_port_manager (self, &error)) {
+        g_task_return_error (task, error);
+        g_object_unref (task);
+        return;
+    }
+
+    g_assert (self->priv->net_port_manager);
+    mbim_net_port_manager_add_links (self->priv->net_port_manager,
+                                     session_ids,
+                                     n_session_ids,
+                                     base_ifname,
+                                     ifname_prefix,
+                                     5,
+                                     cancellable,
+                                     (GAsyncReadyCallback) device_add_links_ready,
+                                     task);
+}
+
+gboolean
+mbim_device_delete_links_finish (MbimDevice    *self,
+                                 GAsyncResult  *res,
+                                 GError       **error)
+{
+    return g_task_propagate_boolean (G_TASK (res), error);
+}
+
+static void
+device_del_links_ready (MbimNetPortManager *net_port_manager,
+                        GAsyncResult       *res,
+                        GTask              *task)
+{
+    GError *error = NULL;
+
+    if (!mbim_net_port_manager_del_links_finish (net_port_manager, res, &error))
+        g_task_return_error (task, error);
+    else
+        g_task_return_boolean (task, TRUE);
+    g_object_unref (task);
+}
+
+void
+mbim_device_delete_links (MbimDevice          *self,
+                          const gchar * const *ifnames,
+                          GCancellable        *cancellable,
+                          GAsyncReadyCallback  callback,
+                          gpointer             user_data)
+{
+    GTask  *task;
+    GError *error = NULL;
+
+    g_return_if_fail (MBIM_IS_DEVICE (self));
+    g_return_if_fail (ifnames);
+
+    task = g_task_new (self, cancellable, callback, user_data);
+
+    if (!setup_net_port_manager (self, &error)) {
+        g_task_return_error (task, error);
+        g_object_unref (task);
+        return;
+    }
+
+    g_assert (self->priv->net_port_manager);
+    mbim_net_port_manager_del_links (self->priv->net_port_manager,
+                                     ifnames,
+                                     5, /* timeout */
+                                     cancellable,
+                                     (GAsyncReadyCallback) device_del_links_ready,
+                                     task);
+}
+
+/*****************************************************************************/
+
 gboolean
 mbim_device_delete_all_links_finish (MbimDevice    *self,
                                      GAsyncResult  *res,
@@ -731,6 +1160,65 @@ mbim_device_delete_all_links (MbimDevice          *self,
 
 /*****************************************************************************/
 
+gboolean
+mbim_device_configure_link_finish (MbimDevice    *self,
+                                   GAsyncResult  *res,
+                                   GError       **error)
+{
+    return g_task_propagate_boolean (G_TASK (res), error);
+}
+
+static void
+device_configure_link_ready (MbimNetPortManager *net_port_manager,
+                             GAsyncResult       *res,
+                             GTask              *task)
+{
+    GError *error = NULL;
+
+    if (!mbim_net_port_manager_configure_link_finish (net_port_manager, res, &error))
+        g_task_return_error (task, error);
+    else
+        g_task_return_boolean (task, TRUE);
+    g_object_unref (task);
+}
+
+void
+mbim_device_configure_link (MbimDevice          *self,
+                            const gchar         *ifname,
+                            const MbimMessage   *ip_configuration,
+                            guint32              route_metric,
+                            GCancellable        *cancellable,
+                            GAsyncReadyCallback  callback,
+                            gpointer             user_data)
+{
+    GTask  *task;
+    GError *error = NULL;
+
+    g_return_if_fail (MBIM_IS_DEVICE (self));
+    g_return_if_fail (ifname);
+    g_return_if_fail (ip_configuration);
+
+    task = g_task_new (self, cancellable, callback, user_data);
+
+    if (!setup_net_port_manager (self, &error)) {
+        g_task_return_error (task, error);
+        g_object_unref (task);
+        return;
+    }
+
+    g_assert (self->priv->net_port_manager);
+    mbim_net_port_manager_configure_link (self->priv->net_port_manager,
+                                          ifname,
+                                          ip_configuration,
+                                          route_metric,
+                                          5, /* timeout */
+                                          cancellable,
+                                          (GAsyncReadyCallback) device_configure_link_ready,
+                                          task);
+}
+
+/*****************************************************************************/
+
 gboolean
 mbim_device_list_links (MbimDevice   *self,
                         const gchar  *base_ifname,
@@ -762,6 +1250,45 @@ mbim_device_check_link_supported (MbimDevice  *self,
     return setup_net_port_manager (self, error);
 }
 
+/*****************************************************************************/
+/* Indication policies */
+
+static void
+indication_filter_emit (MbimMessage *indication,
+                        MbimDevice  *self)
+{
+    g_signal_emit (self, signals[SIGNAL_INDICATE_STATUS], 0, indication);
+}
+
+static void
+device_emit_indication (MbimDevice  *self,
+                        MbimMessage *indication)
+{
+    if (self->priv->indication_filter &&
+        mbim_indication_filter_process (self->priv->indication_filter, indication))
+        return;
+    indication_filter_emit (indication, self);
+}
+
+void
+mbim_device_set_indication_policy (MbimDevice           *self,
+                                   const MbimUuid       *service_id,
+                                   guint32               cid,
+                                   MbimIndicationPolicy  policy,
+                                   guint                 interval_ms,
+                                   guint                 burst)
+{
+    g_return_if_fail (MBIM_IS_DEVICE (self));
+    g_return_if_fail (service_id != NULL);
+
+    if (!self->priv->indication_filter) {
+        if (policy == MBIM_INDICATION_POLICY_NONE)
+            return;
+        self->priv->indication_filter = mbim_indication_filter_new ((MbimIndicationFilterEmitFunc) indication_filter_emit, self);
+    }
+    mbim_indication_filter_set_policy (self->priv->indication_filter, service_id, cid, policy, interval_ms, burst);
+}
+
 /*****************************************************************************/
 /* Open device */
 
@@ -779,7 +1306,9 @@ indication_ready (MbimDevice   *self,
         return;
     }
 
-    g_signal_emit (self, signals[SIGNAL_INDICATE_STATUS], 0, indication);
+    self->priv->stats.indications++;
+    mbim_event_rate_add (&self->priv->stats.indication_rate, g_get_monotonic_time ());
+    device_emit_indication (self, indication);
 }
 
 static void
@@ -808,21 +1337,40 @@ finalize_pending_open_request (MbimDevice *self)
     transaction_task_complete_and_free (task, error);
 }
 
+/* Returns the per-device buffer where the traces are built, emptied; the
+ * contents are only valid until the next call */
+static GString *
+trace_buffer_get (MbimDevice *self)
+{
+    if (G_UNLIKELY (!self->priv->trace_buffer))
+        self->priv->trace_buffer = g_string_sized_new (3 * MAX_CONTROL_TRANSFER);
+    else
+        g_string_truncate (self->priv->trace_buffer, 0);
+    return self->priv->trace_buffer;
+}
+
 static void
-process_message (MbimDevice        *self,
-                 const MbimMessage *message)
+process_message (MbimDevice  *self,
+                 MbimMessage *message)
 {
     gboolean is_partial_fragment;
 
     is_partial_fragment = (_mbim_message_is_fragment (message) &&
                            _mbim_message_fragment_get_total (message) > 1);
 
-    if (mbim_utils_get_traces_enabled ()) {
-        g_autofree gchar *printable = NULL;
+    self->priv->stats.fragments_received++;
+    self->priv->stats.bytes_received += ((GByteArray *)message)->len;
+    if (!is_partial_fragment)
+        self->priv->stats.messages_received++;
+
+    if (_mbim_utils_trace_enabled (MBIM_TRACE_CATEGORY_RAW_RX)) {
+        GString *printable;
 
-        printable = mbim_common_str_hex (((GByteArray *)message)->data,
-                                         ((GByteArray *)message)->len,
-                                         ':');
+        printable = trace_buffer_get (self);
+        mbim_common_str_hex_append (printable,
+                                    ((GByteArray *)message)->data,
+                                    ((GByteArray *)message)->len,
+                                    ':');
         g_debug ("[%s] Received message...%s\n"
                  ">>>>>> RAW:\n"
                  ">>>>>>   length = %u\n"
@@ -830,16 +1378,17 @@ process_message (MbimDevice        *self,
                  self->priv->path_display,
                  is_partial_fragment ? " (partial fragment)" : "",
                  ((GByteArray *)message)->len,
-                 printable);
+                 printable->str);
+    }
 
-        if (is_partial_fragment) {
-            g_autofree gchar *translated = NULL;
+    if (is_partial_fragment && _mbim_utils_trace_enabled (MBIM_TRACE_CATEGORY_FRAGMENTS)) {
+        GString *translated;
 
-            translated = mbim_message_get_printable (message, ">>>>>> ", TRUE);
-            g_debug ("[%s] Received message fragment (translated)...\n%s",
-                     self->priv->path_display,
-                     translated);
-        }
+        translated = trace_buffer_get (self);
+        mbim_message_append_printable (message, translated, ">>>>>> ", TRUE);
+        g_debug ("[%s] Received message fragment (translated)...\n%s",
+                 self->priv->path_display,
+                 translated->str);
     }
 
     switch (MBIM_MESSAGE_GET_MESSAGE_TYPE (message)) {
@@ -853,6 +1402,29 @@ process_message (MbimDevice        *self,
         TransactionType     transaction_type = TRANSACTION_TYPE_UNKNOWN;
 
         if (MBIM_MESSAGE_GET_MESSAGE_TYPE (message) == MBIM_MESSAGE_TYPE_INDICATE_STATUS) {
+            /* Fast path for indications that come in one single fragment and
+             * don't continue a previous one: no need to collect fragments, so
+             * just notify them right away without setting up a transaction */
+            if (_mbim_message_fragment_get_total (message) == 1 &&
+                _mbim_message_fragment_get_current (message) == 0 &&
+                !transaction_table_lookup (&self->priv->transactions[TRANSACTION_TYPE_MODEM],
+                                           mbim_message_get_transaction_id (message))) {
+                if (_mbim_utils_trace_enabled (MBIM_TRACE_CATEGORY_TRANSLATED)) {
+                    GString *printable;
+
+                    printable = trace_buffer_get (self);
+                    mbim_message_append_printable (message, printable, ">>>>>> ", FALSE);
+                    g_debug ("[%s] Received message (translated)...\n%s",
+                             self->priv->path_display,
+                             printable->str);
+                }
+
+                self->priv->stats.indications++;
+                mbim_event_rate_add (&self->priv->stats.indication_rate, g_get_monotonic_time ());
+                device_emit_indication (self, message);
+                return;
+            }
+
             /* Grab transaction */
             transaction_type = TRANSACTION_TYPE_MODEM;
             task = device_release_transaction (self,
@@ -877,16 +1449,16 @@ process_message (MbimDevice        *self,
                                                (MBIM_MESSAGE_GET_MESSAGE_TYPE (message) - 0x80000000),
                                                mbim_message_get_transaction_id (message));
             if (!task) {
-                g_autofree gchar *printable = NULL;
+                GString *printable;
 
                 g_debug ("[%s] No transaction matched in received message",
                          self->priv->path_display);
                 /* Attempt to print a user friendly dump of the packet anyway */
-                printable = mbim_message_get_printable (message, ">>>>>> ", is_partial_fragment);
-                if (printable)
-                    g_debug ("[%s] Received unexpected message (translated)...\n%s",
-                             self->priv->path_display,
-                             printable);
+                printable = trace_buffer_get (self);
+                mbim_message_append_printable (message, printable, ">>>>>> ", is_partial_fragment);
+                g_debug ("[%s] Received unexpected message (translated)...\n%s",
+                         self->priv->path_display,
+                         printable->str);
 
                 /* If we're opening and we get a CLOSE_DONE message without any
                  * matched transaction, finalize the open request right away to
@@ -902,7 +1474,7 @@ process_message (MbimDevice        *self,
             if (!_mbim_message_is_fragment (message)) {
                 ctx = g_task_get_task_data (task);
                 g_assert (ctx->fragments == NULL);
-                ctx->fragments = mbim_message_dup (message);
+                ctx->fragments = mbim_message_ref (message);
                 transaction_task_complete_and_free (task, NULL);
                 return;
             }
@@ -910,9 +1482,10 @@ process_message (MbimDevice        *self,
 
         /* More than one fragment expected; is this the first one? */
         ctx = g_task_get_task_data (task);
-        if (!ctx->fragments)
+        if (!ctx->fragments) {
             ctx->fragments = _mbim_message_fragment_collector_init (message, &error);
-        else
+            ctx->first_fragment_time = g_get_monotonic_time ();
+        } else
             _mbim_message_fragment_collector_add (ctx->fragments, message, &error);
 
         if (error) {
@@ -923,14 +1496,19 @@ process_message (MbimDevice        *self,
 
         /* Did we get all needed fragments? */
         if (_mbim_message_fragment_collector_complete (ctx->fragments)) {
+            self->priv->stats.messages_received++;
+            mbim_latency_histogram_add (&self->priv->stats.reassembly,
+                                        g_get_monotonic_time () - ctx->first_fragment_time);
+
             /* Now, translate the whole message */
-            if (mbim_utils_get_traces_enabled ()) {
-                g_autofree gchar *printable = NULL;
+            if (_mbim_utils_trace_enabled (MBIM_TRACE_CATEGORY_TRANSLATED)) {
+                GString *printable;
 
-                printable = mbim_message_get_printable (ctx->fragments, ">>>>>> ", FALSE);
+                printable = trace_buffer_get (self);
+                mbim_message_append_printable (ctx->fragments, printable, ">>>>>> ", FALSE);
                 g_debug ("[%s] Received message (translated)...\n%s",
                          self->priv->path_display,
-                         printable);
+                         printable->str);
             }
 
             transaction_task_complete_and_free (task, NULL);
@@ -960,13 +1538,14 @@ process_message (MbimDevice        *self,
             g_debug ("[%s] No transaction matched in received function error message",
                      self->priv->path_display);
 
-        if (mbim_utils_get_traces_enabled ()) {
-            g_autofree gchar *printable = NULL;
+        if (_mbim_utils_trace_enabled (MBIM_TRACE_CATEGORY_TRANSLATED)) {
+            GString *printable;
 
-            printable = mbim_message_get_printable (message, ">>>>>> ", FALSE);
+            printable = trace_buffer_get (self);
+            mbim_message_append_printable (message, printable, ">>>>>> ", FALSE);
             g_debug ("[%s] Received message (translated)...\n%s",
                      self->priv->path_display,
-                     printable);
+                     printable->str);
         }
 
         /* Signals are emitted regardless of whether the transaction matched or not */
@@ -980,7 +1559,7 @@ process_message (MbimDevice        *self,
 
             if (ctx->fragments)
                 mbim_message_unref (ctx->fragments);
-            ctx->fragments = mbim_message_dup (message);
+            ctx->fragments = mbim_message_ref (message);
             transaction_task_complete_and_free (task, NULL);
         }
         return;
@@ -1000,9 +1579,9 @@ process_message (MbimDevice        *self,
 }
 
 static gboolean
-validate_message_type (const MbimMessage *message)
+validate_message_type (MbimMessageType message_type)
 {
-    switch (mbim_message_get_message_type (message)) {
+    switch (message_type) {
         case MBIM_MESSAGE_TYPE_OPEN:
         case MBIM_MESSAGE_TYPE_CLOSE:
         case MBIM_MESSAGE_TYPE_COMMAND:
@@ -1019,43 +1598,195 @@ validate_message_type (const MbimMessage *message)
     }
 }
 
-static void
-parse_response (MbimDevice *self)
+/* Upper bound for the length of the messages found when resynchronizing the
+ * stream; anything longer is taken as garbage */
+#define RESYNC_MAX_MESSAGE_LENGTH (1024 * 1024)
+
+typedef gboolean (* ResyncCheckFunc) (const guint8 *data,
+                                      guint         available,
+                                      gpointer      user_data);
+
+/* After a header fails validation, look for the next position in the buffer
+ * where a plausible header starts, so that any valid message queued after the
+ * corrupted data is not lost. If none is found, the last bytes that could
+ * still be the beginning of a header are kept. Returns the new read offset. */
+static guint
+stream_resync (const guint8    *data,
+               guint            len,
+               guint            offset,
+               ResyncCheckFunc  check,
+               gpointer         user_data)
 {
-    do {
-        const MbimMessage *message;
-        guint32            in_length;
+    for (offset++; len - offset >= sizeof (struct header); offset++) {
+        struct header header;
+        guint32       type;
+        guint32       length;
 
-        /* If not even the MBIM header available, just return */
-        if (self->priv->response->len < 12)
-            return;
+        memcpy (&header, &data[offset], sizeof (header));
+
+        /* All valid message types are either 0x0000000X or 0x8000000X, so
+         * most positions are discarded with a single word comparison */
+        type = GUINT32_FROM_LE (header.type);
+        if (type & 0x7FFFFFF0)
+            continue;
+        if (!validate_message_type ((MbimMessageType) type))
+            continue;
+
+        length = GUINT32_FROM_LE (header.length);
+        if (length < sizeof (struct header) || length > RESYNC_MAX_MESSAGE_LENGTH)
+            continue;
+
+        if (check && !check (&data[offset], len - offset, user_data))
+            continue;
+
+        return offset;
+    }
+
+    return len - (sizeof (struct header) - 1);
+}
+
+/* Only accept headers of responses to requests we're waiting for, and of
+ * indications either starting a new message or continuing a known one */
+static gboolean
+resync_check_transaction (const guint8 *data,
+                          guint         available,
+                          MbimDevice   *self)
+{
+    const struct header *header;
+    guint32              transaction_id;
+
+    header = (const struct header *) data;
+    transaction_id = GUINT32_FROM_LE (header->transaction_id);
+
+    switch ((MbimMessageType) GUINT32_FROM_LE (header->type)) {
+    case MBIM_MESSAGE_TYPE_OPEN_DONE:
+    case MBIM_MESSAGE_TYPE_CLOSE_DONE:
+    case MBIM_MESSAGE_TYPE_COMMAND_DONE:
+        return !!transaction_table_lookup (&self->priv->transactions[TRANSACTION_TYPE_HOST], transaction_id);
+
+    case MBIM_MESSAGE_TYPE_FUNCTION_ERROR:
+        /* May not be associated to any request */
+        return (!transaction_id ||
+                !!transaction_table_lookup (&self->priv->transactions[TRANSACTION_TYPE_HOST], transaction_id));
+
+    case MBIM_MESSAGE_TYPE_INDICATE_STATUS: {
+        guint32 current;
+
+        if (transaction_table_lookup (&self->priv->transactions[TRANSACTION_TYPE_MODEM], transaction_id))
+            return TRUE;
+        /* Not enough data yet to look at the fragment header */
+        if (available < sizeof (struct header) + sizeof (struct fragment_header))
+            return TRUE;
+        memcpy (&current, &data[sizeof (struct header) + G_STRUCT_OFFSET (struct fragment_header, current)], sizeof (current));
+        return (GUINT32_FROM_LE (current) == 0);
+    }
 
-        message = (const MbimMessage *)self->priv->response;
+    case MBIM_MESSAGE_TYPE_INVALID:
+    case MBIM_MESSAGE_TYPE_OPEN:
+    case MBIM_MESSAGE_TYPE_CLOSE:
+    case MBIM_MESSAGE_TYPE_COMMAND:
+    case MBIM_MESSAGE_TYPE_HOST_ERROR:
+    default:
+        return FALSE;
+    }
+}
 
-        /* Fully ignore data that is clearly not a MBIM message */
-        if (!validate_message_type (message)) {
+static void
+parse_response (MbimDevice *self)
+{
+    GByteArray *response;
+    guint       offset = 0;
+
+    /* Keep our own reference, the buffer may be disposed if the device is
+     * force-closed while processing one of the messages */
+    response = g_byte_array_ref (self->priv->response);
+
+    /* Messages are not removed from the buffer one by one; instead, a read
+     * cursor is moved forward and whatever was consumed gets dropped in one
+     * single operation once we're done. */
+    while (response->len - offset >= sizeof (struct header)) {
+        const struct header *header;
+        MbimMessage         *message;
+        guint32              in_length;
+
+        header = (const struct header *)&response->data[offset];
+
+        /* Skip data that is clearly not a MBIM message, up to the next
+         * plausible header */
+        in_length = GUINT32_FROM_LE (header->length);
+        if (!validate_message_type ((MbimMessageType) GUINT32_FROM_LE (header->type)) ||
+            in_length < sizeof (struct header)) {
+            guint next;
+
+            next = stream_resync (response->data, response->len, offset,
+                                  (ResyncCheckFunc) resync_check_transaction, self);
             g_warning ("[%s] discarding %u bytes in MBIM stream as message type validation fails",
-                       self->priv->path_display, self->priv->response->len);
-            g_byte_array_remove_range (self->priv->response, 0, self->priv->response->len);
-            return;
+                       self->priv->path_display, next - offset);
+            offset = next;
+            continue;
         }
 
         /* No full message yet */
-        in_length = mbim_message_get_message_length (message);
-        if (self->priv->response->len < in_length)
-            return;
+        if (response->len - offset < in_length)
+            break;
+
+        if (offset == 0 && in_length == response->len) {
+            /* The buffer holds exactly one message (the most common case), so
+             * just hand over the buffer itself as the message, and setup a new
+             * one for the next reads. */
+            message = (MbimMessage *) g_byte_array_ref (response);
+            g_byte_array_unref (self->priv->response);
+            self->priv->response = g_byte_array_sized_new (RESPONSE_BUFFER_DEFAULT_SIZE);
+        } else
+            message = mbim_message_new (&response->data[offset], in_length);
+        offset += in_length;
 
         /* Play with the received message */
         process_message (self, message);
+        mbim_message_unref (message);
 
-        /* If we were force-closed during the processing of a message, we'd be
-         * losing the response array directly, so check just in case */
-        if (!self->priv->response)
+        /* If we were force-closed during the processing of a message, or if
+         * the buffer was handed over as a message, we're done */
+        if (self->priv->response != response)
             break;
+    }
+
+    /* Remove all consumed messages from the buffer, if still in use */
+    if (offset > 0 && self->priv->response == response)
+        g_byte_array_remove_range (response, 0, offset);
+
+    g_byte_array_unref (response);
+}
 
-        /* Remove message from buffer */
-        g_byte_array_remove_range (self->priv->response, 0, in_length);
-    } while (self->priv->response->len > 0);
+/* Whenever the amount of data queued can be queried (sockets), read all of
+ * it in one single syscall. This is required for SOCK_SEQPACKET sockets, as
+ * each read() in those returns one single packet, and any data in the packet
+ * not fitting in the given buffer is lost; the amount of data queued in the
+ * socket is never less than the size of the next packet. The cdc-wdm driver
+ * returns one message per read(), so the max control transfer is enough
+ * there. */
+static gsize
+get_read_size (gint    fd,
+               guint16 max_control_transfer)
+{
+    gint  available = 0;
+    gsize read_size;
+
+    read_size = (max_control_transfer >= MIN_CONTROL_TRANSFER ? max_control_transfer : MAX_CONTROL_TRANSFER);
+    if (ioctl (fd, FIONREAD, &available) == 0 && (gsize) available > read_size)
+        return (gsize) available;
+    return read_size;
+}
+
+/* Maximum size of the fragments we send, as negotiated with the device in
+ * the open request */
+static guint32
+device_get_max_fragment_size (MbimDevice *self)
+{
+    /* Bogus or unset values fall back to the default */
+    if (self->priv->max_control_transfer < MIN_CONTROL_TRANSFER)
+        return MAX_CONTROL_TRANSFER;
+    return self->priv->max_control_transfer;
 }
 
 static gboolean
@@ -1064,8 +1795,8 @@ data_available (GIOChannel   *source,
                 MbimDevice   *self)
 {
     gsize     bytes_read;
+    gsize     to_read;
     GIOStatus status;
-    gchar     buffer[MAX_CONTROL_TRANSFER + 1];
 
     if (condition & G_IO_HUP) {
         g_debug ("[%s] unexpected port hangup!",
@@ -1087,9 +1818,11 @@ data_available (GIOChannel   *source,
         return TRUE;
     }
 
+    self->priv->stats.read_wakeups++;
+
     /* If not ready yet, prepare the response with default initial size. */
     if (G_UNLIKELY (!self->priv->response))
-        self->priv->response = g_byte_array_sized_new (500);
+        self->priv->response = g_byte_array_sized_new (RESPONSE_BUFFER_DEFAULT_SIZE);
 
     /* The parse_response() message may end up triggering a close of the
      * MbimDevice or even a full unref. We are going to make sure a valid
@@ -1099,16 +1832,27 @@ data_available (GIOChannel   *source,
     {
         do {
             g_autoptr(GError) error = NULL;
+            guint             previous_len;
 
             /* Port is closed; we're done */
-            if (!self->priv->iochannel_source)
+            if (!self->priv->iochannel_source || !self->priv->response)
                 break;
 
+            /* Read directly into the tail of the response buffer, so that
+             * there is no intermediate copy of the received data */
+            previous_len = self->priv->response->len;
+            to_read = get_read_size (g_io_channel_unix_get_fd (source),
+                                     self->priv->max_control_transfer);
+            g_byte_array_set_size (self->priv->response, previous_len + to_read);
+
+            bytes_read = 0;
             status = g_io_channel_read_chars (source,
-                                              buffer,
-                                              self->priv->max_control_transfer,
+                                              (gchar *)&self->priv->response->data[previous_len],
+                                              to_read,
                                               &bytes_read,
                                               &error);
+            g_byte_array_set_size (self->priv->response, previous_len + bytes_read);
+
             if (status == G_IO_STATUS_ERROR && error)
                 g_warning ("[%s] error reading from the IOChannel: '%s'",
                            self->priv->path_display,
@@ -1118,20 +1862,250 @@ data_available (GIOChannel   *source,
             if (bytes_read == 0)
                 break;
 
-            if (bytes_read > 0)
-                g_byte_array_append (self->priv->response, (const guint8 *)buffer, bytes_read);
-
             /* Try to parse what we already got */
             parse_response (self);
 
             /* And keep on if we were told to keep on */
-        } while (bytes_read == self->priv->max_control_transfer || status == G_IO_STATUS_AGAIN);
+        } while (bytes_read == to_read || status == G_IO_STATUS_AGAIN);
     }
     g_object_unref (self);
 
     return TRUE;
 }
 
+/*****************************************************************************/
+/* Reader thread
+ *
+ * When requested, reading from the port is done in a dedicated thread which
+ * frames the received data into full messages, so that the port is always
+ * drained even if the main context is busy doing something else. Only the
+ * complete messages are pushed to the main context, where they're processed
+ * exactly in the same way as in the default GIOChannel based setup.
+ *
+ * Writing is always done from the main context, using the GIOChannel.
+ */
+
+struct _ReaderThread {
+    GThread      *thread;
+    gchar        *path_display;
+    gint          fd;
+    gint          wakeup_fds[2];
+    guint16       max_control_transfer;
+    GAsyncQueue  *messages;
+    GSource      *source;
+    gint          hangup;
+};
+
+/* Sources woken up from other threads by setting their ready time */
+static gboolean
+wakeup_source_dispatch (GSource     *source,
+                        GSourceFunc  callback,
+                        gpointer     user_data)
+{
+    /* Reset before the callback, so that we don't miss any wakeup */
+    g_source_set_ready_time (source, -1);
+    return callback (user_data);
+}
+
+static GSourceFuncs wakeup_source_funcs = {
+    NULL, /* prepare */
+    NULL, /* check */
+    wakeup_source_dispatch,
+    NULL, /* finalize */
+    NULL, /* closure_callback */
+    NULL, /* closure_marshal */
+};
+
+static void
+reader_thread_frame_messages (ReaderThread *reader,
+                              GByteArray   *buffer)
+{
+    guint offset = 0;
+
+    while (buffer->len - offset >= sizeof (struct header)) {
+        const struct header *header;
+        guint32              in_length;
+
+        header = (const struct header *)&buffer->data[offset];
+
+        /* Skip data that is clearly not a MBIM message, up to the next
+         * plausible header; the transaction tables cannot be checked from
+         * this thread, so that is left to the main context */
+        in_length = GUINT32_FROM_LE (header->length);
+        if (!validate_message_type ((MbimMessageType) GUINT32_FROM_LE (header->type)) ||
+            in_length < sizeof (struct header)) {
+            guint next;
+
+            next = stream_resync (buffer->data, buffer->len, offset, NULL, NULL);
+            g_warning ("[%s] discarding %u bytes in MBIM stream as message type validation fails",
+                       reader->path_display, next - offset);
+            offset = next;
+            continue;
+        }
+
+        /* No full message yet */
+        if (buffer->len - offset < in_length)
+            break;
+
+        g_async_queue_push (reader->messages, mbim_message_new (&buffer->data[offset], in_length));
+        offset += in_length;
+    }
+
+    if (offset > 0) {
+        g_byte_array_remove_range (buffer, 0, offset);
+        g_source_set_ready_time (reader->source, 0);
+    }
+}
+
+static gpointer
+reader_thread_func (ReaderThread *reader)
+{
+    g_autoptr(GByteArray) buffer = NULL;
+
+    buffer = g_byte_array_sized_new (RESPONSE_BUFFER_DEFAULT_SIZE);
+
+    while (TRUE) {
+        struct pollfd fds[2];
+        guint         previous_len;
+        gsize         to_read;
+        gssize        bytes_read;
+
+        fds[0].fd      = reader->fd;
+        fds[0].events  = POLLIN;
+        fds[0].revents = 0;
+        fds[1].fd      = reader->wakeup_fds[0];
+        fds[1].events  = POLLIN;
+        fds[1].revents = 0;
+
+        if (poll (fds, G_N_ELEMENTS (fds), -1) < 0) {
+            if (errno == EINTR)
+                continue;
+            g_warning ("[%s] error polling the port: %s",
+                       reader->path_display, g_strerror (errno));
+            break;
+        }
+
+        /* Requested to stop */
+        if (fds[1].revents)
+            return NULL;
+
+        if (fds[0].revents & (POLLHUP | POLLNVAL))
+            break;
+
+        /* Errors reported in the port imply discarding whatever we had
+         * pending; still read in order to get the error cleared */
+        if (fds[0].revents & POLLERR)
+            g_byte_array_set_size (buffer, 0);
+
+        previous_len = buffer->len;
+        to_read = get_read_size (reader->fd, reader->max_control_transfer);
+        g_byte_array_set_size (buffer, previous_len + to_read);
+        bytes_read = read (reader->fd, &buffer->data[previous_len], to_read);
+        if (bytes_read < 0) {
+            g_byte_array_set_size (buffer, previous_len);
+            if (errno == EAGAIN || errno == EINTR)
+                continue;
+            g_warning ("[%s] error reading from the port: %s",
+                       reader->path_display, g_strerror (errno));
+            continue;
+        }
+
+        g_byte_array_set_size (buffer, previous_len + bytes_read);
+        if (bytes_read == 0) {
+            /* EOF, only expected when talking to the proxy through a socket */
+            if (fds[0].revents & POLLIN)
+                break;
+            continue;
+        }
+
+        reader_thread_frame_messages (reader, buffer);
+    }
+
+    /* Let the main context know that the port is gone */
+    g_atomic_int_set (&reader->hangup, TRUE);
+    g_source_set_ready_time (reader->source, 0);
+    return NULL;
+}
+
+static gboolean
+reader_thread_messages_available (MbimDevice *self)
+{
+    self->priv->stats.read_wakeups++;
+
+    /* Processing messages may end up closing the device or even fully
+     * unref-ing it, so keep a valid reference while we need it */
+    g_object_ref (self);
+    {
+        while (self->priv->reader_thread) {
+            MbimMessage *message;
+
+            message = g_async_queue_try_pop (self->priv->reader_thread->messages);
+            if (!message)
+                break;
+
+            process_message (self, message);
+            mbim_message_unref (message);
+        }
+
+        if (self->priv->reader_thread && g_atomic_int_get (&self->priv->reader_thread->hangup)) {
+            g_debug ("[%s] unexpected port hangup!",
+                     self->priv->path_display);
+            mbim_device_close_force (self, NULL);
+            g_signal_emit (self, signals[SIGNAL_REMOVED], 0);
+        }
+    }
+    g_object_unref (self);
+
+    return G_SOURCE_CONTINUE;
+}
+
+static void
+reader_thread_stop (ReaderThread *reader)
+{
+    /* Wake up the thread and wait for it to finish */
+    if (write (reader->wakeup_fds[1], "", 1) < 0)
+        g_warning ("[%s] couldn't wake up reader thread: %s",
+                   reader->path_display, g_strerror (errno));
+    g_thread_join (reader->thread);
+
+    g_source_destroy (reader->source);
+    g_source_unref (reader->source);
+    g_async_queue_unref (reader->messages);
+    close (reader->wakeup_fds[0]);
+    close (reader->wakeup_fds[1]);
+    g_free (reader->path_display);
+    g_slice_free (ReaderThread, reader);
+}
+
+static ReaderThread *
+reader_thread_start (MbimDevice  *self,
+                     GError     **error)
+{
+    ReaderThread *reader;
+
+    reader = g_slice_new0 (ReaderThread);
+    if (!g_unix_open_pipe (reader->wakeup_fds, FD_CLOEXEC, error)) {
+        g_prefix_error (error, "Couldn't setup reader thread: ");
+        g_slice_free (ReaderThread, reader);
+        return NULL;
+    }
+
+    reader->path_display = g_strdup (self->priv->path_display);
+    reader->fd = g_io_channel_unix_get_fd (self->priv->iochannel);
+    reader->max_control_transfer = self->priv->max_control_transfer;
+    reader->messages = g_async_queue_new_full ((GDestroyNotify) mbim_message_unref);
+
+    reader->source = g_source_new (&wakeup_source_funcs, sizeof (GSource));
+    g_source_set_callback (reader->source,
+                           (GSourceFunc)reader_thread_messages_available,
+                           self,
+                           NULL);
+    g_source_attach (reader->source, g_main_context_get_thread_default ());
+
+    reader->thread = g_thread_new ("mbim-reader", (GThreadFunc)reader_thread_func, reader);
+    return reader;
+}
+
 /* "MBIM Control Model Functional Descriptor" */
 struct usb_cdc_mbim_desc {
     guint8  bLength;
@@ -1186,6 +2160,77 @@ get_descriptors_filepath (MbimDevice *self)
     return g_steal_pointer (&descriptors_path);
 }
 
+/* Process-wide cache of the max control transfer read from the descriptors
+ * file, keyed by device path. Entries are validated against the inode of the
+ * descriptors file, which changes whenever the USB device is re-enumerated. */
+typedef struct {
+    gchar   *descriptors_path;
+    dev_t    dev;
+    ino_t    ino;
+    time_t   mtime;
+    guint16  max_control_transfer;
+} DescriptorsCacheEntry;
+
+static GHashTable *descriptors_cache;
+G_LOCK_DEFINE_STATIC (descriptors_cache);
+
+static void
+descriptors_cache_entry_free (DescriptorsCacheEntry *entry)
+{
+    g_free (entry->descriptors_path);
+    g_slice_free (DescriptorsCacheEntry, entry);
+}
+
+static gboolean
+descriptors_cache_lookup (const gchar *path,
+                          guint16     *max_control_transfer)
+{
+    DescriptorsCacheEntry *entry;
+    GStatBuf               st;
+    gboolean               found = FALSE;
+
+    G_LOCK (descriptors_cache);
+    entry = descriptors_cache ? g_hash_table_lookup (descriptors_cache, path) : NULL;
+    if (entry) {
+        if ((g_stat (entry->descriptors_path, &st) == 0) &&
+            (st.st_dev == entry->dev) &&
+            (st.st_ino == entry->ino) &&
+            (st.st_mtime == entry->mtime)) {
+            *max_control_transfer = entry->max_control_transfer;
+            found = TRUE;
+        } else
+            g_hash_table_remove (descriptors_cache, path);
+    }
+    G_UNLOCK (descriptors_cache);
+
+    return found;
+}
+
+static void
+descriptors_cache_store (const gchar    *path,
+                         const gchar    *descriptors_path,
+                         const GStatBuf *st,
+                         guint16         max_control_transfer)
+{
+    DescriptorsCacheEntry *entry;
+
+    entry = g_slice_new (DescriptorsCacheEntry);
+    entry->descriptors_path = g_strdup (descriptors_path);
+    entry->dev = st->st_dev;
+    entry->ino = st->st_ino;
+    entry->mtime = st->st_mtime;
+    entry->max_control_transfer = max_control_transfer;
+
+    G_LOCK (descriptors_cache);
+    if (G_UNLIKELY (!descriptors_cache))
+        descriptors_cache = g_hash_table_new_full (g_str_hash,
+                                                   g_str_equal,
+                                                   g_free,
+                                                   (GDestroyNotify)descriptors_cache_entry_free);
+    g_hash_table_replace (descriptors_cache, g_strdup (path), entry);
+    G_UNLOCK (descriptors_cache);
+}
+
 static guint16
 read_max_control_transfer (MbimDevice *self)
 {
@@ -1195,6 +2240,16 @@ read_max_control_transfer (MbimDevice *self)
     g_autofree gchar    *contents = NULL;
     gsize                length = 0;
     guint                i;
+    guint16              max;
+    GStatBuf             st;
+
+    /* Reuse the value read in a previous open of the same device, as long as
+     * the device hasn't been re-enumerated since then */
+    if (descriptors_cache_lookup (self->priv->path, &max)) {
+        g_debug ("[%s] Reusing cached max control message size: %" G_GUINT16_FORMAT,
+                 self->priv->path_display, max);
+        return max;
+    }
 
     /* Build descriptors filepath */
     descriptors_path = get_descriptors_filepath (self);
@@ -1209,6 +2264,15 @@ read_max_control_transfer (MbimDevice *self)
         return MAX_CONTROL_TRANSFER;
     }
 
+    /* Stat before reading, so that the cache entry is invalidated if the
+     * device is re-enumerated in between */
+    if (g_stat (descriptors_path, &st) != 0) {
+        g_warning ("[%s] Couldn't stat descriptors file: %s",
+                   self->priv->path_display,
+                   g_strerror (errno));
+        return MAX_CONTROL_TRANSFER;
+    }
+
     if (!g_file_get_contents (descriptors_path,
                               &contents,
                               &length,
@@ -1223,13 +2287,12 @@ read_max_control_transfer (MbimDevice *self)
     while (i <= (length - sizeof (struct usb_cdc_mbim_desc))) {
         /* Try to match the MBIM descriptor signature */
         if ((memcmp (&contents[i], mbim_signature, sizeof (mbim_signature)) == 0)) {
-            guint16 max;
-
             /* Found! */
             max = GUINT16_FROM_LE (((struct usb_cdc_mbim_desc *)&contents[i])->wMaxControlMessage);
             g_debug ("[%s] Read max control message size from descriptors file: %" G_GUINT16_FORMAT,
                      self->priv->path_display,
                      max);
+            descriptors_cache_store (self->priv->path, descriptors_path, &st, max);
             return max;
         }
 
@@ -1245,11 +2308,35 @@ read_max_control_transfer (MbimDevice *self)
 
 typedef struct {
     guint spawn_retries;
+    gboolean reader_thread;
+    gboolean seqpacket;
+    /* Waiting for a spawned proxy to be ready */
+    gint ready_fd;
+    GSource *ready_source;
+    GSource *ready_timeout_source;
 } CreateIoChannelContext;
 
+static void
+create_iochannel_context_clear_ready (CreateIoChannelContext *ctx)
+{
+    if (ctx->ready_source) {
+        g_source_destroy (ctx->ready_source);
+        g_clear_pointer (&ctx->ready_source, g_source_unref);
+    }
+    if (ctx->ready_timeout_source) {
+        g_source_destroy (ctx->ready_timeout_source);
+        g_clear_pointer (&ctx->ready_timeout_source, g_source_unref);
+    }
+    if (ctx->ready_fd >= 0) {
+        close (ctx->ready_fd);
+        ctx->ready_fd = -1;
+    }
+}
+
 static void
 create_iochannel_context_free (CreateIoChannelContext *ctx)
 {
+    create_iochannel_context_clear_ready (ctx);
     g_slice_free (CreateIoChannelContext, ctx);
 }
 
@@ -1265,9 +2352,11 @@ static void
 setup_iochannel (GTask *task)
 {
     MbimDevice *self;
+    CreateIoChannelContext *ctx;
     GError *inner_error = NULL;
 
     self = g_task_get_source_object (task);
+    ctx = g_task_get_task_data (task);
 
     /* We don't want UTF-8 encoding, we're playing with raw binary data */
     g_io_channel_set_encoding (self->priv->iochannel, NULL, NULL);
@@ -1292,13 +2381,27 @@ setup_iochannel (GTask *task)
         return;
     }
 
-    self->priv->iochannel_source = g_io_create_watch (self->priv->iochannel,
-                                                      G_IO_IN | G_IO_ERR | G_IO_HUP);
-    g_source_set_callback (self->priv->iochannel_source,
-                           (GSourceFunc)data_available,
-                           self,
-                           NULL);
-    g_source_attach (self->priv->iochannel_source, g_main_context_get_thread_default ());
+    if (ctx->reader_thread) {
+        self->priv->reader_thread = reader_thread_start (self, &inner_error);
+        if (!self->priv->reader_thread) {
+            g_io_channel_shutdown (self->priv->iochannel, FALSE, NULL);
+            g_io_channel_unref (self->priv->iochannel);
+            self->priv->iochannel = NULL;
+            g_clear_object (&self->priv->socket_connection);
+            g_clear_object (&self->priv->socket_client);
+            g_task_return_error (task, inner_error);
+            g_object_unref (task);
+            return;
+        }
+    } else {
+        self->priv->iochannel_source = g_io_create_watch (self->priv->iochannel,
+                                                          G_IO_IN | G_IO_ERR | G_IO_HUP);
+        g_source_set_callback (self->priv->iochannel_source,
+                               (GSourceFunc)data_available,
+                               self,
+                               NULL);
+        g_source_attach (self->priv->iochannel_source, g_main_context_get_thread_default ());
+    }
 
     g_task_return_boolean (task, TRUE);
     g_object_unref (task);
@@ -1348,57 +2451,122 @@ create_iochannel_with_fd (GTask *task)
 
 static void create_iochannel_with_socket (GTask *task);
 
+static GSocketConnection *
+connect_proxy_socket (MbimDevice   *self,
+                      GSocketType   type,
+                      const gchar  *path,
+                      GError      **error)
+{
+    g_autoptr(GSocketAddress) socket_address = NULL;
+
+    /* Create socket client */
+    if (self->priv->socket_client)
+        g_object_unref (self->priv->socket_client);
+    self->priv->socket_client = g_socket_client_new ();
+    g_socket_client_set_family (self->priv->socket_client, G_SOCKET_FAMILY_UNIX);
+    g_socket_client_set_socket_type (self->priv->socket_client, type);
+    g_socket_client_set_protocol (self->priv->socket_client, G_SOCKET_PROTOCOL_DEFAULT);
+
+    /* Setup socket address */
+    socket_address = (g_unix_socket_address_new_with_type (
+                          path,
+                          -1,
+                          G_UNIX_SOCKET_ADDRESS_ABSTRACT));
+
+    /* Connect to address */
+    return g_socket_client_connect (self->priv->socket_client,
+                                    G_SOCKET_CONNECTABLE (socket_address),
+                                    NULL,
+                                    error);
+}
+
 static gboolean
 wait_for_proxy_cb (GTask *task)
 {
+    CreateIoChannelContext *ctx;
+
+    ctx = g_task_get_task_data (task);
+    g_debug ("timed out waiting for the mbim-proxy to be ready");
+    create_iochannel_context_clear_ready (ctx);
+    create_iochannel_with_socket (task);
+    return G_SOURCE_REMOVE;
+}
+
+static gboolean
+proxy_ready_cb (gint          fd,
+                GIOCondition  condition,
+                GTask        *task)
+{
+    CreateIoChannelContext *ctx;
+    gchar                   byte;
+    gssize                  n_read;
+
+    ctx = g_task_get_task_data (task);
+
+    n_read = read (fd, &byte, 1);
+    if (n_read < 0 && (errno == EAGAIN || errno == EINTR))
+        return G_SOURCE_CONTINUE;
+
+    /* Either the proxy is listening already, or it exited without getting
+     * ready (e.g. because another one started right before); in both cases,
+     * try to connect right away */
+    if (n_read > 0)
+        g_debug ("mbim-proxy reported being ready");
+    else
+        g_debug ("mbim-proxy exited without reporting being ready");
+
+    create_iochannel_context_clear_ready (ctx);
     create_iochannel_with_socket (task);
-    return FALSE;
+    return G_SOURCE_REMOVE;
 }
 
 static void
-spawn_child_setup (void)
+spawn_child_setup (gpointer user_data)
 {
+    gint ready_fd = GPOINTER_TO_INT (user_data);
+
     if (setpgid (0, 0) < 0)
         g_warning ("couldn't setup proxy specific process group");
+
+    /* The readiness pipe must be inherited by the proxy */
+    if (fcntl (ready_fd, F_SETFD, 0) < 0)
+        g_warning ("couldn't setup proxy readiness notification");
 }
 
 static void
 create_iochannel_with_socket (GTask *task)
 {
-    MbimDevice                *self;
-    CreateIoChannelContext    *ctx;
-    g_autoptr(GSocketAddress)  socket_address = NULL;
-    GError                    *error = NULL;
+    MbimDevice             *self;
+    CreateIoChannelContext *ctx;
+    GError                 *error = NULL;
 
     self = g_task_get_source_object (task);
     ctx = g_task_get_task_data (task);
 
-    /* Create socket client */
-    if (self->priv->socket_client)
-        g_object_unref (self->priv->socket_client);
-    self->priv->socket_client = g_socket_client_new ();
-    g_socket_client_set_family (self->priv->socket_client, G_SOCKET_FAMILY_UNIX);
-    g_socket_client_set_socket_type (self->priv->socket_client, G_SOCKET_TYPE_STREAM);
-    g_socket_client_set_protocol (self->priv->socket_client, G_SOCKET_PROTOCOL_DEFAULT);
+    g_clear_object (&self->priv->socket_connection);
 
-    /* Setup socket address */
-    socket_address = (g_unix_socket_address_new_with_type (
-                          MBIM_PROXY_SOCKET_PATH,
-                          -1,
-                          G_UNIX_SOCKET_ADDRESS_ABSTRACT));
+    /* If requested, try first the socket preserving message boundaries; older
+     * proxies don't provide it, so fallback to the default one */
+    if (ctx->seqpacket) {
+        self->priv->socket_connection = connect_proxy_socket (self,
+                                                              G_SOCKET_TYPE_SEQPACKET,
+                                                              MBIM_PROXY_SEQPACKET_SOCKET_PATH,
+                                                              &error);
+        if (!self->priv->socket_connection) {
+            g_debug ("cannot connect to proxy seqpacket socket: %s", error->message);
+            g_clear_error (&error);
+        }
+    }
 
-    /* Connect to address */
-    if (self->priv->socket_connection)
-        g_object_unref (self->priv->socket_connection);
-    self->priv->socket_connection = (g_socket_client_connect (
-                                              self->priv->socket_client,
-                                              G_SOCKET_CONNECTABLE (socket_address),
-                                              NULL,
-                                              &error));
+    if (!self->priv->socket_connection)
+        self->priv->socket_connection = connect_proxy_socket (self,
+                                                              G_SOCKET_TYPE_STREAM,
+                                                              MBIM_PROXY_SOCKET_PATH,
+                                                              &error);
 
     if (!self->priv->socket_connection) {
-        g_auto(GStrv)      argc = NULL;
-        g_autoptr(GSource) source = NULL;
+        g_auto(GStrv) argc = NULL;
+        gint          fds[2];
 
         g_debug ("cannot connect to proxy: %s", error->message);
         g_clear_error (&error);
@@ -1417,24 +2585,45 @@ create_iochannel_with_socket (GTask *task)
 
         g_debug ("spawning new mbim-proxy (try %u)...", ctx->spawn_retries);
 
-        argc = g_new0 (gchar *, 2);
+        /* The proxy writes to the pipe once it is listening, and the pipe
+         * gets closed if it exits before that */
+        if (!g_unix_open_pipe (fds, FD_CLOEXEC, &error)) {
+            g_task_return_new_error (task,
+                                     MBIM_CORE_ERROR,
+                                     MBIM_CORE_ERROR_FAILED,
+                                     "Couldn't create mbim-proxy readiness pipe: %s",
+                                     error->message);
+            g_error_free (error);
+            g_object_unref (task);
+            return;
+        }
+
+        argc = g_new0 (gchar *, 3);
         argc[0] = g_strdup (LIBEXEC_PATH "/mbim-proxy");
+        argc[1] = g_strdup_printf ("--ready-fd=%d", fds[1]);
         if (!g_spawn_async (NULL, /* working directory */
                             argc,
                             NULL, /* envp */
                             G_SPAWN_STDOUT_TO_DEV_NULL | G_SPAWN_STDERR_TO_DEV_NULL,
                             (GSpawnChildSetupFunc) spawn_child_setup,
-                            NULL, /* child_setup_user_data */
+                            GINT_TO_POINTER (fds[1]),
                             NULL,
                             &error)) {
             g_debug ("error spawning mbim-proxy: %s", error->message);
             g_clear_error (&error);
         }
-
-        /* Wait some ms and retry */
-        source = g_timeout_source_new (100);
-        g_source_set_callback (source, (GSourceFunc)wait_for_proxy_cb, task, NULL);
-        g_source_attach (source, g_main_context_get_thread_default ());
+        close (fds[1]);
+
+        g_unix_set_fd_nonblocking (fds[0], TRUE, NULL);
+        ctx->ready_fd = fds[0];
+        ctx->ready_source = g_unix_fd_source_new (ctx->ready_fd, G_IO_IN | G_IO_ERR | G_IO_HUP);
+        g_source_set_callback (ctx->ready_source, (GSourceFunc)proxy_ready_cb, task, NULL);
+        g_source_attach (ctx->ready_source, g_main_context_get_thread_default ());
+
+        /* Don't wait forever for a proxy that never gets ready */
+        ctx->ready_timeout_source = g_timeout_source_new (MAX_SPAWN_WAIT_MS);
+        g_source_set_callback (ctx->ready_timeout_source, (GSourceFunc)wait_for_proxy_cb, task, NULL);
+        g_source_attach (ctx->ready_timeout_source, g_main_context_get_thread_default ());
         return;
     }
 
@@ -1450,7 +2639,7 @@ create_iochannel_with_socket (GTask *task)
 
 static void
 create_iochannel (MbimDevice           *self,
-                  gboolean              proxy,
+                  MbimDeviceOpenFlags   flags,
                   GAsyncReadyCallback   callback,
                   gpointer              user_data)
 {
@@ -1459,6 +2648,11 @@ create_iochannel (MbimDevice           *self,
 
     ctx = g_slice_new (CreateIoChannelContext);
     ctx->spawn_retries = 0;
+    ctx->ready_fd = -1;
+    ctx->ready_source = NULL;
+    ctx->ready_timeout_source = NULL;
+    ctx->reader_thread = !!(flags & MBIM_DEVICE_OPEN_FLAGS_READER_THREAD);
+    ctx->seqpacket = !!(flags & MBIM_DEVICE_OPEN_FLAGS_PROXY_SEQPACKET);
 
     task = g_task_new (self, NULL, callback, user_data);
     g_task_set_task_data (task, ctx, (GDestroyNotify)create_iochannel_context_free);
@@ -1475,7 +2669,7 @@ create_iochannel (MbimDevice           *self,
     g_assert (self->priv->file);
     g_assert (self->priv->path);
 
-    if (proxy)
+    if (flags & MBIM_DEVICE_OPEN_FLAGS_PROXY)
         create_iochannel_with_socket (task);
     else
         create_iochannel_with_fd (task);
@@ -1485,6 +2679,8 @@ typedef enum {
     DEVICE_OPEN_CONTEXT_STEP_FIRST = 0,
     DEVICE_OPEN_CONTEXT_STEP_CREATE_IOCHANNEL,
     DEVICE_OPEN_CONTEXT_STEP_FLAGS_PROXY,
+    DEVICE_OPEN_CONTEXT_STEP_PROXY_CLIENT_CONFIG,
+    DEVICE_OPEN_CONTEXT_STEP_CHECK_SESSION,
     DEVICE_OPEN_CONTEXT_STEP_CLOSE_MESSAGE,
     DEVICE_OPEN_CONTEXT_STEP_OPEN_MESSAGE,
     DEVICE_OPEN_CONTEXT_STEP_LAST
@@ -1636,12 +2832,66 @@ close_message_before_open (GTask *task)
 }
 
 static void
-proxy_cfg_message_ready (MbimDevice   *self,
-                         GAsyncResult *res,
-                         GTask        *task)
+check_session_message_ready (MbimDevice   *self,
+                             GAsyncResult *res,
+                             GTask        *task)
 {
     DeviceOpenContext      *ctx;
-    GError                 *error = NULL;
+    g_autoptr(MbimMessage)  response = NULL;
+    g_autoptr(GError)       error = NULL;
+
+    ctx = g_task_get_task_data (task);
+
+    /* Any command done response, even one reporting a failed status, means
+     * the function is already in an open session; a function closed would
+     * have reported a 'not opened' error, or not replied at all */
+    response = mbim_device_command_finish (self, res, &error);
+    if (response) {
+        g_debug ("device already open: skipping open sequence");
+        ctx->step = DEVICE_OPEN_CONTEXT_STEP_LAST;
+        device_open_context_step (task);
+        return;
+    }
+
+    if (g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED)) {
+        g_debug ("session check cancelled: closed");
+        self->priv->open_status = OPEN_STATUS_CLOSED;
+        g_task_return_error (task, g_steal_pointer (&error));
+        g_object_unref (task);
+        return;
+    }
+
+    g_debug ("device not open yet: %s", error->message);
+    ctx->step++;
+    device_open_context_step (task);
+}
+
+static void
+check_session_message (GTask *task)
+{
+    MbimDevice             *self;
+    g_autoptr(MbimMessage)  request = NULL;
+
+    self = g_task_get_source_object (task);
+
+    /* A short-timeout query tells us whether a previous user of the port left
+     * the function open, in which case the open sequence can be skipped */
+    request = mbim_message_device_caps_query_new (NULL);
+    mbim_device_command (self,
+                         request,
+                         OPEN_CHECK_TIMEOUT_SECS,
+                         g_task_get_cancellable (task),
+                         (GAsyncReadyCallback)check_session_message_ready,
+                         task);
+}
+
+static void
+proxy_cfg_message_ready (MbimDevice   *self,
+                         GAsyncResult *res,
+                         GTask        *task)
+{
+    DeviceOpenContext      *ctx;
+    GError                 *error = NULL;
     g_autoptr(MbimMessage)  response = NULL;
 
     ctx = g_task_get_task_data (task);
@@ -1683,6 +2933,48 @@ proxy_cfg_message (GTask *task)
                          task);
 }
 
+static void
+proxy_client_cfg_message_ready (MbimDevice   *self,
+                                GAsyncResult *res,
+                                GTask        *task)
+{
+    DeviceOpenContext      *ctx;
+    g_autoptr(GError)       error = NULL;
+    g_autoptr(MbimMessage)  response = NULL;
+
+    ctx = g_task_get_task_data (task);
+
+    /* Not fatal; older proxies just forward the unknown request to the device,
+     * which will reject it, and the proxy default timeout applies */
+    response = mbim_device_command_finish (self, res, &error);
+    if (!response || !mbim_message_response_get_result (response, MBIM_MESSAGE_TYPE_COMMAND_DONE, &error))
+        g_debug ("proxy client configuration failed: %s", error->message);
+
+    ctx->step++;
+    device_open_context_step (task);
+}
+
+static void
+proxy_client_cfg_message (GTask *task)
+{
+    MbimDevice             *self;
+    DeviceOpenContext      *ctx;
+    g_autoptr(MbimMessage)  request = NULL;
+
+    self = g_task_get_source_object (task);
+    ctx = g_task_get_task_data (task);
+
+    request = mbim_message_proxy_control_client_configuration_set_new (self->priv->proxy_command_timeout, NULL);
+    g_assert (request);
+
+    mbim_device_command (self,
+                         request,
+                         ctx->timeout,
+                         g_task_get_cancellable (task),
+                         (GAsyncReadyCallback)proxy_client_cfg_message_ready,
+                         task);
+}
+
 static void
 create_iochannel_ready (MbimDevice   *self,
                         GAsyncResult *res,
@@ -1755,7 +3047,7 @@ device_open_context_step (GTask *task)
 
     case DEVICE_OPEN_CONTEXT_STEP_CREATE_IOCHANNEL:
         create_iochannel (self,
-                          !!(ctx->flags & MBIM_DEVICE_OPEN_FLAGS_PROXY),
+                          ctx->flags,
                           (GAsyncReadyCallback)create_iochannel_ready,
                           task);
         return;
@@ -1768,6 +3060,25 @@ device_open_context_step (GTask *task)
         ctx->step++;
         /* Fall through */
 
+    case DEVICE_OPEN_CONTEXT_STEP_PROXY_CLIENT_CONFIG:
+        if ((ctx->flags & MBIM_DEVICE_OPEN_FLAGS_PROXY) && self->priv->proxy_command_timeout > 0) {
+            proxy_client_cfg_message (task);
+            return;
+        }
+        ctx->step++;
+        /* Fall through */
+
+    case DEVICE_OPEN_CONTEXT_STEP_CHECK_SESSION:
+        /* The proxy already manages the open sequence on its own */
+        if ((ctx->flags & MBIM_DEVICE_OPEN_FLAGS_FAST_REOPEN) &&
+            !(ctx->flags & MBIM_DEVICE_OPEN_FLAGS_PROXY) &&
+            !self->priv->in_session) {
+            check_session_message (task);
+            return;
+        }
+        ctx->step++;
+        /* Fall through */
+
     case DEVICE_OPEN_CONTEXT_STEP_CLOSE_MESSAGE:
         /* Only send an explicit close during open if needed */
         if (ctx->close_before_open) {
@@ -1788,6 +3099,10 @@ device_open_context_step (GTask *task)
         /* Fall through */
 
     case DEVICE_OPEN_CONTEXT_STEP_LAST:
+        /* Commands submitted from other threads are processed in the context
+         * where the device is opened, again on every new open */
+        setup_submit_source (self);
+
         /* Nothing else to process, complete without error */
         self->priv->open_status = OPEN_STATUS_OPEN;
         g_task_return_boolean (task, TRUE);
@@ -1855,12 +3170,28 @@ destroy_iochannel (MbimDevice  *self,
 
     self->priv->open_status = OPEN_STATUS_CLOSED;
 
+    /* No more commands from other threads until opened again */
+    teardown_submit_source (self);
+
     /* Already closed? */
     if (!self->priv->iochannel && !self->priv->socket_connection && !self->priv->socket_client)
         return TRUE;
 
     g_debug ("[%s] channel destroyed", self->priv->path_display);
 
+    /* The last indications held back are not lost */
+    if (self->priv->indication_filter)
+        mbim_indication_filter_flush (self->priv->indication_filter);
+
+    /* Anything not yet written is lost */
+    write_queue_flush (self);
+
+    /* The reader thread must be stopped before the fd gets closed */
+    if (self->priv->reader_thread) {
+        reader_thread_stop (self->priv->reader_thread);
+        self->priv->reader_thread = NULL;
+    }
+
     if (self->priv->iochannel) {
         g_io_channel_shutdown (self->priv->iochannel, TRUE, &inner_error);
         g_io_channel_unref (self->priv->iochannel);
@@ -2017,19 +3348,184 @@ mbim_device_get_transaction_id (MbimDevice *self)
 }
 
 /*****************************************************************************/
+/* Write queue */
+
+static void
+write_queue_complete_waiters (MbimDevice   *self,
+                              const GError *error)
+{
+    GSList *waiters;
+    GSList *l;
+
+    /* Steal the list, the waiters may queue more data right away */
+    waiters = g_slist_reverse (self->priv->write_queue_waiters);
+    self->priv->write_queue_waiters = NULL;
+
+    for (l = waiters; l; l = g_slist_next (l)) {
+        GTask *task;
+
+        task = l->data;
+        if (error)
+            g_task_return_error (task, g_error_copy (error));
+        else
+            g_task_return_boolean (task, TRUE);
+        g_object_unref (task);
+    }
+    g_slist_free (waiters);
+}
 
 static gboolean
-device_write (MbimDevice    *self,
-              const guint8  *data,
-              guint32        data_length,
-              GError       **error)
+write_queue_wait_drained_finish (MbimDevice    *self,
+                                 GAsyncResult  *res,
+                                 GError       **error)
+{
+    return g_task_propagate_boolean (G_TASK (res), error);
+}
+
+/* Completes once there is no data waiting in the write queue */
+static void
+write_queue_wait_drained (MbimDevice          *self,
+                          GAsyncReadyCallback  callback,
+                          gpointer             user_data)
+{
+    GTask *task;
+
+    task = g_task_new (self, NULL, callback, user_data);
+    if (g_queue_is_empty (&self->priv->write_queue)) {
+        g_task_return_boolean (task, TRUE);
+        g_object_unref (task);
+        return;
+    }
+
+    self->priv->write_queue_waiters = g_slist_prepend (self->priv->write_queue_waiters, task);
+}
+
+static void
+write_queue_flush (MbimDevice *self)
+{
+    if (self->priv->write_source) {
+        g_source_destroy (self->priv->write_source);
+        g_source_unref (self->priv->write_source);
+        self->priv->write_source = NULL;
+    }
+
+    g_queue_foreach (&self->priv->write_queue, (GFunc) g_byte_array_unref, NULL);
+    g_queue_clear (&self->priv->write_queue);
+    self->priv->write_queue_offset = 0;
+    self->priv->write_queue_size = 0;
+
+    /* A command stream still reading from its input stream fails as soon as
+     * the read is done, and must not affect the device if opened again */
+    self->priv->command_stream = NULL;
+    g_queue_foreach (&self->priv->held_queue, (GFunc) g_byte_array_unref, NULL);
+    g_queue_clear (&self->priv->held_queue);
+
+    if (self->priv->write_queue_waiters) {
+        g_autoptr(GError) error = NULL;
+
+        error = g_error_new (MBIM_CORE_ERROR,
+                             MBIM_CORE_ERROR_WRONG_STATE,
+                             "Device closed");
+        write_queue_complete_waiters (self, error);
+    }
+}
+
+static gboolean
+write_queue_drain (GIOChannel   *source,
+                   GIOCondition  condition,
+                   MbimDevice   *self)
+{
+    while (!g_queue_is_empty (&self->priv->write_queue)) {
+        g_autoptr(GError)  error = NULL;
+        GByteArray        *pending;
+        gsize              written = 0;
+        GIOStatus          write_status;
+
+        pending = g_queue_peek_head (&self->priv->write_queue);
+        write_status = g_io_channel_write_chars (self->priv->iochannel,
+                                                 (const gchar *)&pending->data[self->priv->write_queue_offset],
+                                                 (gssize)(pending->len - self->priv->write_queue_offset),
+                                                 &written,
+                                                 &error);
+        switch (write_status) {
+        case G_IO_STATUS_ERROR:
+            /* Pending transactions will end up timing out */
+            g_warning ("[%s] Cannot write queued message: %s; discarding %" G_GSIZE_FORMAT " bytes",
+                       self->priv->path_display, error->message, self->priv->write_queue_size);
+            g_queue_foreach (&self->priv->write_queue, (GFunc) g_byte_array_unref, NULL);
+            g_queue_clear (&self->priv->write_queue);
+            self->priv->write_queue_offset = 0;
+            self->priv->write_queue_size = 0;
+            write_queue_complete_waiters (self, error);
+            break;
+
+        case G_IO_STATUS_EOF:
+            /* We shouldn't get EOF when writing */
+            g_assert_not_reached ();
+            break;
+
+        case G_IO_STATUS_NORMAL:
+        case G_IO_STATUS_AGAIN:
+            self->priv->write_queue_offset += written;
+            self->priv->write_queue_size -= written;
+            if (self->priv->write_queue_offset == pending->len) {
+                g_byte_array_unref (g_queue_pop_head (&self->priv->write_queue));
+                self->priv->write_queue_offset = 0;
+            }
+            /* If not everything written, wait until the port is writable again */
+            if (write_status == G_IO_STATUS_AGAIN || !written)
+                return G_SOURCE_CONTINUE;
+            break;
+
+        default:
+            g_assert_not_reached ();
+            break;
+        }
+    }
+
+    /* The main context keeps its own reference while dispatching */
+    g_source_unref (self->priv->write_source);
+    self->priv->write_source = NULL;
+    write_queue_complete_waiters (self, NULL);
+    return G_SOURCE_REMOVE;
+}
+
+static void
+write_queue_push (MbimDevice   *self,
+                  const guint8 *data,
+                  gsize         data_length)
 {
-    gsize     written;
-    GIOStatus write_status;
+    GByteArray *pending;
+
+    pending = g_byte_array_sized_new (data_length);
+    g_byte_array_append (pending, data, data_length);
+    g_queue_push_tail (&self->priv->write_queue, pending);
+    self->priv->write_queue_size += data_length;
+
+    if (!self->priv->write_source) {
+        self->priv->write_source = g_io_create_watch (self->priv->iochannel, G_IO_OUT);
+        g_source_set_callback (self->priv->write_source,
+                               (GSourceFunc)write_queue_drain,
+                               self,
+                               NULL);
+        g_source_attach (self->priv->write_source, g_main_context_get_thread_default ());
+    }
+}
+
+static gboolean
+device_write_raw (MbimDevice    *self,
+                  const guint8  *data,
+                  gsize          data_length,
+                  GError       **error)
+{
+    gsize written = 0;
+
+    self->priv->stats.writes++;
+
+    /* Only write right away if there is nothing queued, so that we keep order */
+    if (g_queue_is_empty (&self->priv->write_queue)) {
+        GIOStatus write_status;
 
-    written = 0;
-    write_status = G_IO_STATUS_AGAIN;
-    while (write_status == G_IO_STATUS_AGAIN) {
         write_status = g_io_channel_write_chars (self->priv->iochannel,
                                                  (gconstpointer)data,
                                                  (gssize)data_length,
@@ -2046,12 +3542,14 @@ device_write (MbimDevice    *self,
             break;
 
         case G_IO_STATUS_NORMAL:
-            /* All good, we'll exit the loop now */
+            /* All good, we're done if everything was written */
+            if (written == data_length)
+                return TRUE;
             break;
 
         case G_IO_STATUS_AGAIN:
             /* We're in a non-blocking channel and therefore we're up to receive
-             * EAGAIN; just retry in this case. TODO: in an idle? */
+             * EAGAIN; queue the data and write it once the port is writable */
             break;
 
         default:
@@ -2060,9 +3558,81 @@ device_write (MbimDevice    *self,
         }
     }
 
+    write_queue_push (self, &data[written], data_length - written);
     return TRUE;
 }
 
+static gboolean
+device_write_batch_flush (MbimDevice  *self,
+                          GError     **error)
+{
+    gboolean success;
+
+    if (!self->priv->batch_buffer->len)
+        return TRUE;
+
+    success = device_write_raw (self, self->priv->batch_buffer->data, self->priv->batch_buffer->len, error);
+    g_byte_array_set_size (self->priv->batch_buffer, 0);
+    return success;
+}
+
+static gboolean
+device_write (MbimDevice    *self,
+              const guint8  *data,
+              guint32        data_length,
+              GError       **error)
+{
+    /* Hold any other message while a command stream is being sent */
+    if (self->priv->command_stream && !self->priv->command_stream_writing) {
+        GByteArray *held;
+
+        held = g_byte_array_sized_new (data_length);
+        g_byte_array_append (held, data, data_length);
+        g_queue_push_tail (&self->priv->held_queue, held);
+        return TRUE;
+    }
+
+    self->priv->stats.fragments_sent++;
+    self->priv->stats.bytes_sent += data_length;
+
+    /* While a batch is being submitted, accumulate as many messages as fit in
+     * a single write */
+    if (self->priv->batch_buffer) {
+        if (self->priv->batch_buffer->len + data_length > device_get_max_fragment_size (self) &&
+            !device_write_batch_flush (self, error))
+            return FALSE;
+        g_byte_array_append (self->priv->batch_buffer, data, data_length);
+        return TRUE;
+    }
+
+    return device_write_raw (self, data, data_length, error);
+}
+
+static void
+trace_sent_fragment (MbimDevice       *self,
+                     guint             i,
+                     const GByteArray *full_fragment)
+{
+    GString *printable_full;
+
+    printable_full = trace_buffer_get (self);
+    mbim_common_str_hex_append (printable_full, full_fragment->data, full_fragment->len, ':');
+    g_debug ("[%s] Sent fragment (%u)...\n"
+             "<<<<<< RAW:\n"
+             "<<<<<<   length = %u\n"
+             "<<<<<<   data   = %s\n",
+             self->priv->path_display, i,
+             full_fragment->len,
+             printable_full->str);
+
+    /* Only the headers of the fragment are translated */
+    printable_full = trace_buffer_get (self);
+    mbim_message_append_printable ((const MbimMessage *)full_fragment, printable_full, "<<<<<< ", TRUE);
+    g_debug ("[%s] Sent fragment (translated)...\n%s",
+             self->priv->path_display,
+             printable_full->str);
+}
+
 static gboolean
 device_send (MbimDevice   *self,
              MbimMessage  *message,
@@ -2071,71 +3641,67 @@ device_send (MbimDevice   *self,
     const guint8                    *raw_message;
     guint32                          raw_message_len;
     g_autofree struct fragment_info *fragments = NULL;
+    g_autoptr(GByteArray)            full_fragment = NULL;
     guint                            n_fragments;
     guint                            i;
+    guint32                          max_fragment_size;
 
     raw_message = mbim_message_get_raw (message, &raw_message_len, NULL);
     g_assert (raw_message);
 
-    if (mbim_utils_get_traces_enabled ()) {
-        g_autofree gchar *hex = NULL;
-        g_autofree gchar *printable = NULL;
+    if (_mbim_utils_trace_enabled (MBIM_TRACE_CATEGORY_RAW_TX)) {
+        GString *printable;
 
-        hex = mbim_common_str_hex (raw_message, raw_message_len, ':');
+        printable = trace_buffer_get (self);
+        mbim_common_str_hex_append (printable, raw_message, raw_message_len, ':');
         g_debug ("[%s] Sent message...\n"
                  "<<<<<< RAW:\n"
                  "<<<<<<   length = %u\n"
                  "<<<<<<   data   = %s\n",
                  self->priv->path_display,
                  ((GByteArray *)message)->len,
-                 hex);
+                 printable->str);
+    }
+
+    if (_mbim_utils_trace_enabled (MBIM_TRACE_CATEGORY_TRANSLATED)) {
+        GString *printable;
 
-        printable = mbim_message_get_printable (message, "<<<<<< ", FALSE);
+        printable = trace_buffer_get (self);
+        mbim_message_append_printable (message, printable, "<<<<<< ", FALSE);
         g_debug ("[%s] Sent message (translated)...\n%s",
                  self->priv->path_display,
-                 printable);
+                 printable->str);
     }
 
+    self->priv->stats.messages_sent++;
+
     /* Single fragment? Send it! */
-    if (raw_message_len <= MAX_CONTROL_TRANSFER)
+    max_fragment_size = device_get_max_fragment_size (self);
+    if (raw_message_len <= max_fragment_size)
         return device_write (self, raw_message, raw_message_len, error);
 
     /* The message to send must be able to handle fragments */
     g_assert (_mbim_message_is_fragment (message));
 
-    fragments = _mbim_message_split_fragments (message, MAX_CONTROL_TRANSFER, &n_fragments);
-    for (i = 0; i < n_fragments; i++) {
-        g_autoptr(GByteArray)  full_fragment = NULL;
-        g_autofree gchar      *printable_headers = NULL;
+    /* A single buffer is reused to build all fragments; device_write() will
+     * only copy the data if it needs to be queued */
+    full_fragment = g_byte_array_sized_new (max_fragment_size);
 
+    fragments = _mbim_message_split_fragments (message, max_fragment_size, &n_fragments);
+    if (_mbim_utils_trace_enabled (MBIM_TRACE_CATEGORY_FRAGMENTS))
+        g_debug ("[%s] Sending message (%u bytes) in %u fragments of up to %u bytes",
+                 self->priv->path_display, raw_message_len, n_fragments, max_fragment_size);
+    for (i = 0; i < n_fragments; i++) {
         /* Build compiled fragment headers */
-        full_fragment = g_byte_array_new ();
+        g_byte_array_set_size (full_fragment, 0);
         g_byte_array_append (full_fragment, (guint8 *)&fragments[i].header, sizeof (fragments[i].header));
         g_byte_array_append (full_fragment, (guint8 *)&fragments[i].fragment_header, sizeof (fragments[i].fragment_header));
 
-        /* Build dummy message with only headers for printable purposes only */
-        if (mbim_utils_get_traces_enabled ())
-            printable_headers = mbim_message_get_printable ((MbimMessage *)full_fragment, "<<<<<< ", TRUE);
-
         /* Append the actual fragment data */
         g_byte_array_append (full_fragment, (guint8 *)fragments[i].data, fragments[i].data_length);
 
-        if (mbim_utils_get_traces_enabled ()) {
-            g_autofree gchar *printable_full = NULL;
-
-            printable_full  = mbim_common_str_hex ((const guint8 *)full_fragment->data, full_fragment->len, ':');
-            g_debug ("[%s] Sent fragment (%u)...\n"
-                     "<<<<<< RAW:\n"
-                     "<<<<<<   length = %u\n"
-                     "<<<<<<   data   = %s\n",
-                     self->priv->path_display, i,
-                     full_fragment->len,
-                     printable_full);
-
-            g_debug ("[%s] Sent fragment (translated)...\n%s",
-                     self->priv->path_display,
-                     printable_headers);
-        }
+        if (_mbim_utils_trace_enabled (MBIM_TRACE_CATEGORY_FRAGMENTS))
+            trace_sent_fragment (self, i, full_fragment);
 
         /* Write whole packet to MBIM device.
          * Here send whole packet rather than seperated elements, such as header,
@@ -2152,6 +3718,95 @@ device_send (MbimDevice   *self,
     return TRUE;
 }
 
+/*****************************************************************************/
+
+gsize
+mbim_device_get_write_queue_size (MbimDevice *self)
+{
+    g_return_val_if_fail (MBIM_IS_DEVICE (self), 0);
+
+    return self->priv->write_queue_size;
+}
+
+gsize
+mbim_device_get_write_queue_high_water_mark (MbimDevice *self)
+{
+    g_return_val_if_fail (MBIM_IS_DEVICE (self), 0);
+
+    return self->priv->write_queue_high_water_mark;
+}
+
+void
+mbim_device_set_write_queue_high_water_mark (MbimDevice *self,
+                                             gsize       high_water_mark)
+{
+    g_return_if_fail (MBIM_IS_DEVICE (self));
+
+    self->priv->write_queue_high_water_mark = high_water_mark;
+}
+
+/*****************************************************************************/
+/* Statistics */
+
+GVariant *
+mbim_device_get_statistics (MbimDevice *self)
+{
+    GVariantBuilder   builder;
+    DeviceStatistics *stats;
+
+    g_return_val_if_fail (MBIM_IS_DEVICE (self), NULL);
+
+    stats = &self->priv->stats;
+
+    g_variant_builder_init (&builder, G_VARIANT_TYPE ("a{sv}"));
+
+#define ADD_UINT64(key, value) \
+    g_variant_builder_add (&builder, "{sv}", key, g_variant_new_uint64 (value))
+
+    ADD_UINT64 ("messages-sent",                        stats->messages_sent);
+    ADD_UINT64 ("fragments-sent",                       stats->fragments_sent);
+    ADD_UINT64 ("bytes-sent",                           stats->bytes_sent);
+    ADD_UINT64 ("writes",                               stats->writes);
+    ADD_UINT64 ("messages-received",                    stats->messages_received);
+    ADD_UINT64 ("fragments-received",                   stats->fragments_received);
+    ADD_UINT64 ("bytes-received",                       stats->bytes_received);
+    ADD_UINT64 ("read-wakeups",                         stats->read_wakeups);
+    ADD_UINT64 ("timeouts",                             stats->timeouts);
+    ADD_UINT64 ("indications",                          stats->indications);
+    ADD_UINT64 ("pending-transactions",                 self->priv->transactions[TRANSACTION_TYPE_HOST].n_used);
+    ADD_UINT64 ("pending-transactions-high-water-mark", stats->pending_transactions_high_water_mark);
+
+#undef ADD_UINT64
+
+    g_variant_builder_add (&builder, "{sv}", "indications-per-second",
+                           g_variant_new_double (mbim_event_rate_get (&stats->indication_rate, g_get_monotonic_time ())));
+    mbim_latency_histogram_add_to_builder (&stats->latency, "latency", &builder);
+    mbim_latency_histogram_add_to_builder (&stats->reassembly, "reassembly", &builder);
+    g_variant_builder_add (&builder, "{sv}", "histogram-bounds-us", mbim_latency_histogram_get_bounds ());
+    g_variant_builder_add (&builder, "{sv}", "commands", mbim_command_statistics_table_build (stats->commands));
+
+    return g_variant_ref_sink (g_variant_builder_end (&builder));
+}
+
+/*****************************************************************************/
+
+guint
+mbim_device_get_proxy_command_timeout (MbimDevice *self)
+{
+    g_return_val_if_fail (MBIM_IS_DEVICE (self), 0);
+
+    return self->priv->proxy_command_timeout;
+}
+
+void
+mbim_device_set_proxy_command_timeout (MbimDevice *self,
+                                       guint       timeout)
+{
+    g_return_if_fail (MBIM_IS_DEVICE (self));
+
+    self->priv->proxy_command_timeout = timeout;
+}
+
 /*****************************************************************************/
 /* Report error */
 
@@ -2246,6 +3901,10 @@ mbim_device_command (MbimDevice          *self,
                                  cancellable,
                                  callback,
                                  user_data);
+    if (MBIM_MESSAGE_GET_MESSAGE_TYPE (message) == MBIM_MESSAGE_TYPE_COMMAND)
+        transaction_task_set_command (task,
+                                      mbim_message_command_get_service_id (message),
+                                      mbim_message_command_get_cid (message));
 
     /* Device must be open */
     if (!self->priv->iochannel) {
@@ -2256,6 +3915,18 @@ mbim_device_command (MbimDevice          *self,
         return;
     }
 
+    /* Apply back-pressure if requested */
+    if (!self->priv->submitting_batch &&
+        self->priv->write_queue_high_water_mark > 0 &&
+        self->priv->write_queue_size >= self->priv->write_queue_high_water_mark) {
+        error = g_error_new (MBIM_CORE_ERROR,
+                             MBIM_CORE_ERROR_WOULD_BLOCK,
+                             "Write queue is full (%" G_GSIZE_FORMAT " bytes pending)",
+                             self->priv->write_queue_size);
+        transaction_task_complete_and_free (task, error);
+        return;
+    }
+
     /* Setup context to match response */
     if (!device_store_transaction (self, TRANSACTION_TYPE_HOST, task, timeout * 1000, &error)) {
         g_prefix_error (&error, "Cannot store transaction: ");
@@ -2276,6 +3947,1200 @@ mbim_device_command (MbimDevice          *self,
     /* Just return, we'll get response asynchronously */
 }
 
+/*****************************************************************************/
+/* Thread-safe command submission
+ *
+ * Commands submitted from other threads are pushed to a lock-free stack, and
+ * taken all at once from the context where the device was opened, which is
+ * only woken up when the stack goes from empty to non-empty. The task is
+ * created in the caller thread, so the result is given in the caller's own
+ * thread-default context.
+ *
+ * The source waking up the device context is bound to the context given when
+ * opening, so it is created once the open operation succeeds and destroyed
+ * when closing; commands still in the stack at that point fail. The lock only
+ * serializes the submitters with the setup and teardown of the source. */
+
+typedef struct _SubmittedCommand SubmittedCommand;
+struct _SubmittedCommand {
+    SubmittedCommand *next;
+    MbimMessage      *message;
+    guint             timeout;
+    GTask            *task;
+    GMainContext     *context;
+    /* The caller's cancellable is cancelled in the caller's thread, so it is
+     * forwarded to the device context through our own one */
+    GCancellable     *cancellable;
+    gulong            cancellable_id;
+};
+
+static void
+submitted_command_free (SubmittedCommand *cmd)
+{
+    if (cmd->cancellable_id)
+        g_cancellable_disconnect (g_task_get_cancellable (cmd->task), cmd->cancellable_id);
+    g_object_unref (cmd->cancellable);
+    g_main_context_unref (cmd->context);
+    mbim_message_unref (cmd->message);
+    g_object_unref (cmd->task);
+    g_slice_free (SubmittedCommand, cmd);
+}
+
+static gboolean
+submitted_command_cancel_in_context (GCancellable *cancellable)
+{
+    g_cancellable_cancel (cancellable);
+    return G_SOURCE_REMOVE;
+}
+
+static void
+submitted_command_cancelled (GCancellable     *caller_cancellable,
+                             SubmittedCommand *cmd)
+{
+    g_autoptr(GSource) source = NULL;
+
+    source = g_idle_source_new ();
+    g_source_set_callback (source,
+                           (GSourceFunc) submitted_command_cancel_in_context,
+                           g_object_ref (cmd->cancellable),
+                           g_object_unref);
+    g_source_attach (source, cmd->context);
+}
+
+static void
+submitted_command_ready (MbimDevice       *self,
+                         GAsyncResult     *res,
+                         SubmittedCommand *cmd)
+{
+    MbimMessage *response;
+    GError      *error = NULL;
+
+    response = mbim_device_command_finish (self, res, &error);
+    if (!response)
+        g_task_return_error (cmd->task, error);
+    else
+        g_task_return_pointer (cmd->task, response, (GDestroyNotify) mbim_message_unref);
+    submitted_command_free (cmd);
+}
+
+static gboolean
+submit_source_cb (GWeakRef *weak_self)
+{
+    MbimDevice       *self;
+    SubmittedCommand *head;
+    SubmittedCommand *next;
+    SubmittedCommand *cmds = NULL;
+
+    self = g_weak_ref_get (weak_self);
+    if (!self)
+        return G_SOURCE_REMOVE;
+
+    /* Take all the commands at once, and reverse them so that they are
+     * sent in the same order as submitted */
+    do {
+        head = g_atomic_pointer_get (&self->priv->submitted_commands);
+    } while (!g_atomic_pointer_compare_and_exchange (&self->priv->submitted_commands, head, NULL));
+
+    for (; head; head = next) {
+        next = head->next;
+        head->next = cmds;
+        cmds = head;
+    }
+
+    for (; cmds; cmds = next) {
+        next = cmds->next;
+        cmds->next = NULL;
+        mbim_device_command (self,
+                             cmds->message,
+                             cmds->timeout,
+                             cmds->cancellable,
+                             (GAsyncReadyCallback) submitted_command_ready,
+                             cmds);
+    }
+
+    g_object_unref (self);
+    return G_SOURCE_CONTINUE;
+}
+
+static void
+weak_ref_free (GWeakRef *weak_ref)
+{
+    g_weak_ref_clear (weak_ref);
+    g_slice_free (GWeakRef, weak_ref);
+}
+
+static void
+setup_submit_source (MbimDevice *self)
+{
+    GSource  *source;
+    GWeakRef *weak_self;
+
+    /* Opened again without closing first */
+    teardown_submit_source (self);
+
+    /* The source may be dispatched while the last reference to the device is
+     * dropped in another thread, so it only keeps a weak one */
+    weak_self = g_slice_new0 (GWeakRef);
+    g_weak_ref_init (weak_self, self);
+
+    source = g_source_new (&wakeup_source_funcs, sizeof (GSource));
+    g_source_set_callback (source, (GSourceFunc) submit_source_cb, weak_self, (GDestroyNotify) weak_ref_free);
+    g_source_attach (source, g_main_context_get_thread_default ());
+
+    g_mutex_lock (&self->priv->submit_lock);
+    self->priv->submit_source = source;
+    g_mutex_unlock (&self->priv->submit_lock);
+}
+
+static void
+teardown_submit_source (MbimDevice *self)
+{
+    GSource          *source;
+    SubmittedCommand *head;
+    SubmittedCommand *next;
+
+    g_mutex_lock (&self->priv->submit_lock);
+    source = self->priv->submit_source;
+    self->priv->submit_source = NULL;
+    g_mutex_unlock (&self->priv->submit_lock);
+
+    if (!source)
+        return;
+
+    g_source_destroy (source);
+    g_source_unref (source);
+
+    /* Nothing else can be pushed once the source is gone */
+    do {
+        head = g_atomic_pointer_get (&self->priv->submitted_commands);
+    } while (!g_atomic_pointer_compare_and_exchange (&self->priv->submitted_commands, head, NULL));
+
+    for (; head; head = next) {
+        next = head->next;
+        g_task_return_new_error (head->task,
+                                 MBIM_CORE_ERROR,
+                                 MBIM_CORE_ERROR_WRONG_STATE,
+                                 "Device closed");
+        submitted_command_free (head);
+    }
+}
+
+MbimMessage *
+mbim_device_command_threadsafe_finish (MbimDevice    *self,
+                                       GAsyncResult  *res,
+                                       GError       **error)
+{
+    return g_task_propagate_pointer (G_TASK (res), error);
+}
+
+void
+mbim_device_command_threadsafe (MbimDevice          *self,
+                                MbimMessage         *message,
+                                guint                timeout,
+                                GCancellable        *cancellable,
+                                GAsyncReadyCallback  callback,
+                                gpointer             user_data)
+{
+    SubmittedCommand *cmd;
+    GSource          *source;
+    GTask            *task;
+    gpointer          head;
+
+    g_return_if_fail (MBIM_IS_DEVICE (self));
+    g_return_if_fail (message != NULL);
+
+    task = g_task_new (self, cancellable, callback, user_data);
+
+    /* Keep the lock until the command is in the stack, so that the source
+     * isn't destroyed meanwhile */
+    g_mutex_lock (&self->priv->submit_lock);
+    source = self->priv->submit_source;
+    if (!source) {
+        g_mutex_unlock (&self->priv->submit_lock);
+        g_task_return_new_error (task,
+                                 MBIM_CORE_ERROR,
+                                 MBIM_CORE_ERROR_WRONG_STATE,
+                                 "Device must be open to send commands");
+        g_object_unref (task);
+        return;
+    }
+
+    cmd = g_slice_new0 (SubmittedCommand);
+    cmd->message = mbim_message_ref (message);
+    cmd->timeout = timeout;
+    cmd->task = task;
+    cmd->context = g_main_context_ref (g_source_get_context (source));
+    cmd->cancellable = g_cancellable_new ();
+    if (cancellable) {
+        if (g_cancellable_is_cancelled (cancellable))
+            g_cancellable_cancel (cmd->cancellable);
+        else
+            cmd->cancellable_id = g_cancellable_connect (cancellable,
+                                                         G_CALLBACK (submitted_command_cancelled),
+                                                         cmd,
+                                                         NULL);
+    }
+
+    do {
+        head = g_atomic_pointer_get (&self->priv->submitted_commands);
+        cmd->next = head;
+    } while (!g_atomic_pointer_compare_and_exchange (&self->priv->submitted_commands, head, cmd));
+
+    /* If the stack wasn't empty, the device context is already woken up */
+    if (!head)
+        g_source_set_ready_time (source, 0);
+    g_mutex_unlock (&self->priv->submit_lock);
+}
+
+/*****************************************************************************/
+/* Batched commands */
+
+typedef struct {
+    guint                               n_messages;
+    guint                               n_pending;
+    MbimMessage                       **responses;
+    GError                            **errors;
+    MbimDeviceCommandBatchResponseFunc  response_callback;
+    gpointer                            response_callback_data;
+} CommandBatchContext;
+
+typedef struct {
+    GTask *task;
+    guint  index;
+} CommandBatchItem;
+
+static void
+command_batch_context_free (CommandBatchContext *ctx)
+{
+    guint i;
+
+    for (i = 0; i < ctx->n_messages; i++) {
+        if (ctx->responses[i])
+            mbim_message_unref (ctx->responses[i]);
+        if (ctx->errors[i])
+            g_error_free (ctx->errors[i]);
+    }
+    g_free (ctx->responses);
+    g_free (ctx->errors);
+    g_slice_free (CommandBatchContext, ctx);
+}
+
+GPtrArray *
+mbim_device_command_batch_full_finish (MbimDevice    *self,
+                                       GAsyncResult  *res,
+                                       GError       **error)
+{
+    return g_task_propagate_pointer (G_TASK (res), error);
+}
+
+GPtrArray *
+mbim_device_command_batch_finish (MbimDevice    *self,
+                                  GAsyncResult  *res,
+                                  GError       **error)
+{
+    return mbim_device_command_batch_full_finish (self, res, error);
+}
+
+static void
+command_batch_complete (GTask *task)
+{
+    CommandBatchContext *ctx;
+    GPtrArray           *responses;
+    guint                i;
+
+    ctx = g_task_get_task_data (task);
+
+    /* Report the error of the first failed command, in batch order */
+    for (i = 0; i < ctx->n_messages; i++) {
+        if (ctx->errors[i]) {
+            g_task_return_error (task, ctx->errors[i]);
+            ctx->errors[i] = NULL;
+            g_object_unref (task);
+            return;
+        }
+    }
+
+    responses = g_ptr_array_new_full (ctx->n_messages, (GDestroyNotify) mbim_message_unref);
+    for (i = 0; i < ctx->n_messages; i++) {
+        g_ptr_array_add (responses, ctx->responses[i]);
+        ctx->responses[i] = NULL;
+    }
+    g_task_return_pointer (task, responses, (GDestroyNotify) g_ptr_array_unref);
+    g_object_unref (task);
+}
+
+static void
+command_batch_ready (MbimDevice       *self,
+                     GAsyncResult     *res,
+                     CommandBatchItem *item)
+{
+    CommandBatchContext *ctx;
+
+    ctx = g_task_get_task_data (item->task);
+    ctx->responses[item->index] = mbim_device_command_finish (self, res, &ctx->errors[item->index]);
+
+    if (ctx->response_callback)
+        ctx->response_callback (self,
+                                item->index,
+                                ctx->responses[item->index],
+                                ctx->errors[item->index],
+                                ctx->response_callback_data);
+
+    g_assert (ctx->n_pending > 0);
+    if (--ctx->n_pending == 0)
+        command_batch_complete (item->task);
+
+    g_slice_free (CommandBatchItem, item);
+}
+
+void
+mbim_device_command_batch_full (MbimDevice                          *self,
+                                MbimMessage                        **messages,
+                                guint                                n_messages,
+                                guint                                timeout,
+                                GCancellable                        *cancellable,
+                                MbimDeviceCommandBatchResponseFunc   response_callback,
+                                gpointer                             response_callback_data,
+                                GAsyncReadyCallback                  callback,
+                                gpointer                             user_data)
+{
+    CommandBatchContext *ctx;
+    GTask               *task;
+    guint                i;
+
+    g_return_if_fail (MBIM_IS_DEVICE (self));
+    g_return_if_fail (messages != NULL || n_messages == 0);
+    for (i = 0; i < n_messages; i++)
+        g_return_if_fail (messages[i] != NULL);
+
+    task = g_task_new (self, cancellable, callback, user_data);
+
+    ctx = g_slice_new0 (CommandBatchContext);
+    ctx->n_messages = n_messages;
+    ctx->n_pending = n_messages;
+    ctx->responses = g_new0 (MbimMessage *, n_messages);
+    ctx->errors = g_new0 (GError *, n_messages);
+    ctx->response_callback = response_callback;
+    ctx->response_callback_data = response_callback_data;
+    g_task_set_task_data (task, ctx, (GDestroyNotify) command_batch_context_free);
+
+    if (n_messages == 0) {
+        command_batch_complete (task);
+        return;
+    }
+
+    /* Device must be open */
+    if (!self->priv->iochannel) {
+        g_task_return_new_error (task,
+                                 MBIM_CORE_ERROR,
+                                 MBIM_CORE_ERROR_WRONG_STATE,
+                                 "Device must be open to send commands");
+        g_object_unref (task);
+        return;
+    }
+
+    /* Apply back-pressure to the batch as a whole, so that it is never
+     * left half-submitted */
+    if (self->priv->write_queue_high_water_mark > 0 &&
+        self->priv->write_queue_size >= self->priv->write_queue_high_water_mark) {
+        g_task_return_new_error (task,
+                                 MBIM_CORE_ERROR,
+                                 MBIM_CORE_ERROR_WOULD_BLOCK,
+                                 "Write queue is full (%" G_GSIZE_FORMAT " bytes pending)",
+                                 self->priv->write_queue_size);
+        g_object_unref (task);
+        return;
+    }
+
+    /* Allocate all transaction IDs before sending anything, so that the
+     * requests in the batch get consecutive IDs */
+    for (i = 0; i < n_messages; i++) {
+        if (!mbim_message_get_transaction_id (messages[i]))
+            mbim_message_set_transaction_id (messages[i], mbim_device_get_next_transaction_id (self));
+    }
+
+    /* Over the proxy stream socket there are no message boundaries, so the
+     * requests can be merged in as few writes as possible. Character devices
+     * and SEQPACKET sockets need one message per write. */
+    if (self->priv->socket_connection &&
+        g_socket_get_socket_type (g_socket_connection_get_socket (self->priv->socket_connection)) == G_SOCKET_TYPE_STREAM)
+        self->priv->batch_buffer = g_byte_array_sized_new (device_get_max_fragment_size (self));
+
+    for (i = 0; i < n_messages; i++) {
+        CommandBatchItem *item;
+
+        item = g_slice_new (CommandBatchItem);
+        item->task = task;
+        item->index = i;
+
+        /* The write queue high-water mark was already checked for the whole
+         * batch, so don't let individual commands fail with WOULD_BLOCK */
+        self->priv->submitting_batch = TRUE;
+        mbim_device_command (self,
+                             messages[i],
+                             timeout,
+                             cancellable,
+                             (GAsyncReadyCallback) command_batch_ready,
+                             item);
+        self->priv->submitting_batch = FALSE;
+    }
+
+    if (self->priv->batch_buffer) {
+        g_autoptr(GError) error = NULL;
+
+        /* On failure the requests just time out, as when the write queue
+         * cannot be drained */
+        if (self->priv->iochannel && !device_write_batch_flush (self, &error))
+            g_warning ("[%s] Cannot write batched messages: %s", self->priv->path_display, error->message);
+        g_clear_pointer (&self->priv->batch_buffer, g_byte_array_unref);
+    }
+}
+
+void
+mbim_device_command_batch (MbimDevice          *self,
+                           MbimMessage        **messages,
+                           guint                n_messages,
+                           guint                timeout,
+                           GCancellable        *cancellable,
+                           GAsyncReadyCallback  callback,
+                           gpointer             user_data)
+{
+    mbim_device_command_batch_full (self,
+                                    messages,
+                                    n_messages,
+                                    timeout,
+                                    cancellable,
+                                    NULL,
+                                    NULL,
+                                    callback,
+                                    user_data);
+}
+
+/*****************************************************************************/
+/* Streamed commands */
+
+typedef struct {
+    GInputStream                        *stream;
+    guint                                timeout;
+    guint32                              transaction_id;
+    MbimUuid                             service_id;
+    guint32                              cid;
+    guint32                              n_fragments;
+    guint32                              current_fragment;
+    guint32                              payload_size;
+    guint32                              payload_sent;
+    /* Buffer reused for every fragment */
+    GByteArray                          *fragment;
+    guint32                              fragment_header_size;
+    guint32                              max_fragment_size;
+    MbimDeviceCommandStreamProgressFunc  progress_callback;
+    gpointer                             progress_callback_data;
+} CommandStreamContext;
+
+static void
+command_stream_context_free (CommandStreamContext *ctx)
+{
+    g_object_unref (ctx->stream);
+    g_byte_array_unref (ctx->fragment);
+    g_slice_free (CommandStreamContext, ctx);
+}
+
+MbimMessage *
+mbim_device_command_stream_finish (MbimDevice    *self,
+                                   GAsyncResult  *res,
+                                   GError       **error)
+{
+    return g_task_propagate_pointer (G_TASK (res), error);
+}
+
+static void
+command_stream_release (MbimDevice *self)
+{
+    GByteArray *held;
+
+    g_assert (self->priv->command_stream);
+    self->priv->command_stream = NULL;
+
+    /* Send all messages that were held while streaming, in order */
+    while ((held = g_queue_pop_head (&self->priv->held_queue)) != NULL) {
+        g_autoptr(GError) error = NULL;
+
+        if (!self->priv->iochannel || !device_write (self, held->data, held->len, &error))
+            g_warning ("[%s] Cannot write held message: %s",
+                       self->priv->path_display, error ? error->message : "device closed");
+        g_byte_array_unref (held);
+    }
+}
+
+static void
+command_stream_return_error (GTask  *task,
+                             GError *error)
+{
+    MbimDevice *self;
+
+    /* Nothing to release if the device was closed meanwhile */
+    self = g_task_get_source_object (task);
+    if (self->priv->command_stream == task)
+        command_stream_release (self);
+    g_task_return_error (task, error);
+    g_object_unref (task);
+}
+
+static void
+command_stream_transaction_ready (MbimDevice   *self,
+                                  GAsyncResult *res,
+                                  GTask        *task)
+{
+    GError      *error = NULL;
+    MbimMessage *response;
+
+    response = mbim_device_command_finish (self, res, &error);
+    if (!response)
+        g_task_return_error (task, error);
+    else
+        g_task_return_pointer (task, response, (GDestroyNotify) mbim_message_unref);
+    g_object_unref (task);
+}
+
+static void command_stream_read_next (GTask *task);
+
+static void
+command_stream_write_queue_drained (MbimDevice   *self,
+                                    GAsyncResult *res,
+                                    GTask        *task)
+{
+    GError *error = NULL;
+
+    if (!write_queue_wait_drained_finish (self, res, &error)) {
+        command_stream_return_error (task, error);
+        return;
+    }
+
+    command_stream_read_next (task);
+}
+
+static void
+command_stream_read_ready (GInputStream *stream,
+                           GAsyncResult *res,
+                           GTask        *task)
+{
+    MbimDevice           *self;
+    CommandStreamContext *ctx;
+    GError               *error = NULL;
+    gsize                 expected;
+    gsize                 bytes_read = 0;
+    gboolean              success;
+    GTask                *transaction_task;
+    struct header        *header;
+
+    self = g_task_get_source_object (task);
+    ctx = g_task_get_task_data (task);
+
+    expected = ctx->fragment->len - ctx->fragment_header_size;
+    success = g_input_stream_read_all_finish (stream, res, &bytes_read, &error);
+
+    /* The device may have been closed while reading, even if opened again
+     * afterwards */
+    if (self->priv->command_stream != task) {
+        g_clear_error (&error);
+        command_stream_return_error (task,
+                                     g_error_new (MBIM_CORE_ERROR,
+                                                  MBIM_CORE_ERROR_WRONG_STATE,
+                                                  "Device closed while sending the command stream"));
+        return;
+    }
+
+    if (!success) {
+        g_prefix_error (&error, "Cannot read stream: ");
+        command_stream_return_error (task, error);
+        return;
+    }
+    if (bytes_read != expected) {
+        command_stream_return_error (task,
+                                     g_error_new (MBIM_CORE_ERROR,
+                                                  MBIM_CORE_ERROR_FAILED,
+                                                  "Stream ended prematurely: %u bytes expected, %u bytes read",
+                                                  ctx->payload_size, (guint32)(ctx->payload_sent + bytes_read)));
+        return;
+    }
+
+    /* Each fragment header gives the length of the fragment itself */
+    header = (struct header *)ctx->fragment->data;
+    header->length = GUINT32_TO_LE (ctx->fragment->len);
+
+    if (_mbim_utils_trace_enabled (MBIM_TRACE_CATEGORY_FRAGMENTS))
+        trace_sent_fragment (self, ctx->current_fragment, ctx->fragment);
+
+    self->priv->command_stream_writing = TRUE;
+    if (!device_write (self, ctx->fragment->data, ctx->fragment->len, &error)) {
+        self->priv->command_stream_writing = FALSE;
+        command_stream_return_error (task, error);
+        return;
+    }
+    self->priv->command_stream_writing = FALSE;
+
+    ctx->payload_sent += bytes_read;
+    ctx->current_fragment++;
+
+    if (ctx->progress_callback)
+        ctx->progress_callback (self, ctx->payload_sent, ctx->payload_size, ctx->progress_callback_data);
+
+    if (ctx->current_fragment < ctx->n_fragments) {
+        /* Don't read more than one fragment ahead of what the port accepts */
+        if (!g_queue_is_empty (&self->priv->write_queue))
+            write_queue_wait_drained (self, (GAsyncReadyCallback) command_stream_write_queue_drained, task);
+        else
+            command_stream_read_next (task);
+        return;
+    }
+
+    /* All fragments sent; the response can only be processed once we're
+     * back in the main loop, so it's safe to start waiting for it now */
+    self->priv->stats.messages_sent++;
+    command_stream_release (self);
+
+    transaction_task = transaction_task_new (self,
+                                             MBIM_MESSAGE_TYPE_COMMAND,
+                                             ctx->transaction_id,
+                                             g_task_get_cancellable (task),
+                                             (GAsyncReadyCallback) command_stream_transaction_ready,
+                                             task);
+    transaction_task_set_command (transaction_task, &ctx->service_id, ctx->cid);
+    if (!device_store_transaction (self, TRANSACTION_TYPE_HOST, transaction_task, ctx->timeout * 1000, &error)) {
+        g_prefix_error (&error, "Cannot store transaction: ");
+        transaction_task_complete_and_free (transaction_task, error);
+        g_error_free (error);
+    }
+}
+
+static void
+command_stream_read_next (GTask *task)
+{
+    CommandStreamContext *ctx;
+    guint32               to_read;
+
+    ctx = g_task_get_task_data (task);
+
+    /* The first fragment also carries the command header, which was already
+     * set up; all the following ones only carry the message and fragment
+     * headers */
+    if (ctx->current_fragment > 0) {
+        struct fragment_header *fragment_header;
+
+        ctx->fragment_header_size = sizeof (struct header) + sizeof (struct fragment_header);
+        fragment_header = (struct fragment_header *)&ctx->fragment->data[sizeof (struct header)];
+        fragment_header->current = GUINT32_TO_LE (ctx->current_fragment);
+    }
+
+    to_read = MIN (ctx->max_fragment_size - ctx->fragment_header_size,
+                   ctx->payload_size - ctx->payload_sent);
+    g_byte_array_set_size (ctx->fragment, ctx->fragment_header_size + to_read);
+
+    g_input_stream_read_all_async (ctx->stream,
+                                   &ctx->fragment->data[ctx->fragment_header_size],
+                                   to_read,
+                                   G_PRIORITY_DEFAULT,
+                                   g_task_get_cancellable (task),
+                                   (GAsyncReadyCallback) command_stream_read_ready,
+                                   task);
+}
+
+void
+mbim_device_command_stream (MbimDevice                          *self,
+                            MbimService                          service,
+                            guint32                              cid,
+                            MbimMessageCommandType               command_type,
+                            GInputStream                        *stream,
+                            guint32                              stream_size,
+                            guint                                timeout,
+                            GCancellable                        *cancellable,
+                            MbimDeviceCommandStreamProgressFunc  progress_callback,
+                            gpointer                             progress_callback_data,
+                            GAsyncReadyCallback                  callback,
+                            gpointer                             user_data)
+{
+    CommandStreamContext   *ctx;
+    GTask                  *task;
+    g_autoptr(MbimMessage)  headers = NULL;
+    guint32                 command_header_size;
+    guint32                 fragment_payload_size;
+    guint32                 total_payload_size;
+
+    g_return_if_fail (MBIM_IS_DEVICE (self));
+    g_return_if_fail (G_IS_INPUT_STREAM (stream));
+
+    task = g_task_new (self, cancellable, callback, user_data);
+
+    /* Device must be open */
+    if (!self->priv->iochannel) {
+        g_task_return_new_error (task,
+                                 MBIM_CORE_ERROR,
+                                 MBIM_CORE_ERROR_WRONG_STATE,
+                                 "Device must be open to send commands");
+        g_object_unref (task);
+        return;
+    }
+
+    if (self->priv->command_stream) {
+        g_task_return_new_error (task,
+                                 MBIM_CORE_ERROR,
+                                 MBIM_CORE_ERROR_WRONG_STATE,
+                                 "Another command stream is already being sent");
+        g_object_unref (task);
+        return;
+    }
+
+    /* The whole message length must fit in the 32bit length field */
+    command_header_size = sizeof (struct command_message) - sizeof (struct fragment_header);
+    if (stream_size > G_MAXUINT32 - sizeof (struct header) - sizeof (struct command_message)) {
+        g_task_return_new_error (task,
+                                 MBIM_CORE_ERROR,
+                                 MBIM_CORE_ERROR_INVALID_ARGS,
+                                 "Stream too big: %u bytes", stream_size);
+        g_object_unref (task);
+        return;
+    }
+
+    if (!mbim_uuid_from_service (service)) {
+        g_task_return_new_error (task,
+                                 MBIM_CORE_ERROR,
+                                 MBIM_CORE_ERROR_INVALID_ARGS,
+                                 "Unknown service: %u", (guint) service);
+        g_object_unref (task);
+        return;
+    }
+
+    headers = mbim_message_command_new (mbim_device_get_next_transaction_id (self),
+                                        service,
+                                        cid,
+                                        command_type);
+    g_assert (headers);
+
+    ctx = g_slice_new0 (CommandStreamContext);
+    ctx->stream = g_object_ref (stream);
+    ctx->timeout = timeout;
+    ctx->transaction_id = mbim_message_get_transaction_id (headers);
+    memcpy (&ctx->service_id, mbim_uuid_from_service (service), sizeof (MbimUuid));
+    ctx->cid = cid;
+    ctx->payload_size = stream_size;
+    ctx->progress_callback = progress_callback;
+    ctx->progress_callback_data = progress_callback_data;
+    g_task_set_task_data (task, ctx, (GDestroyNotify) command_stream_context_free);
+
+    /* The fragment payload is the command header plus the stream contents */
+    ctx->max_fragment_size = device_get_max_fragment_size (self);
+    fragment_payload_size = ctx->max_fragment_size - sizeof (struct header) - sizeof (struct fragment_header);
+    total_payload_size = command_header_size + stream_size;
+    ctx->n_fragments = total_payload_size / fragment_payload_size;
+    if (total_payload_size % fragment_payload_size)
+        ctx->n_fragments++;
+
+    /* Setup the first fragment from the message headers */
+    ((struct full_message *)(((GByteArray *)headers)->data))->message.command.fragment_header.total = GUINT32_TO_LE (ctx->n_fragments);
+    ((struct full_message *)(((GByteArray *)headers)->data))->message.command.buffer_length = GUINT32_TO_LE (stream_size);
+    ctx->fragment = g_byte_array_sized_new (ctx->max_fragment_size);
+    g_byte_array_append (ctx->fragment, ((GByteArray *)headers)->data, ((GByteArray *)headers)->len);
+    ctx->fragment_header_size = ctx->fragment->len;
+
+    if (_mbim_utils_trace_enabled (MBIM_TRACE_CATEGORY_TRANSLATED)) {
+        GString *printable;
+
+        printable = trace_buffer_get (self);
+        mbim_message_append_printable (headers, printable, "<<<<<< ", TRUE);
+        g_debug ("[%s] Sending streamed message (%u bytes in %u fragments)...\n%s",
+                 self->priv->path_display,
+                 stream_size,
+                 ctx->n_fragments,
+                 printable->str);
+    }
+
+    /* Hold everything else until all fragments are sent */
+    self->priv->command_stream = task;
+    command_stream_read_next (task);
+}
+
+/*****************************************************************************/
+/* Connect */
+
+typedef enum {
+    CONNECT_STEP_FIRST,
+    CONNECT_STEP_QUERY_STATE,
+    CONNECT_STEP_ATTACH,
+    CONNECT_STEP_ACTIVATE,
+    CONNECT_STEP_IP_CONFIGURATION,
+    CONNECT_STEP_LAST
+} ConnectStep;
+
+typedef struct {
+    ConnectStep        step;
+    guint32            session_id;
+    gchar             *apn;
+    MbimAuthProtocol   auth_protocol;
+    gchar             *username;
+    gchar             *password;
+    MbimContextIpType  ip_type;
+    guint              timeout;
+    gboolean           attached;
+    MbimMessage       *connect_response;
+    MbimMessage       *ip_configuration_response;
+} ConnectContext;
+
+static void
+connect_context_free (ConnectContext *ctx)
+{
+    if (ctx->connect_response)
+        mbim_message_unref (ctx->connect_response);
+    if (ctx->ip_configuration_response)
+        mbim_message_unref (ctx->ip_configuration_response);
+    g_free (ctx->apn);
+    g_free (ctx->username);
+    g_free (ctx->password);
+    g_slice_free (ConnectContext, ctx);
+}
+
+gboolean
+mbim_device_connect_finish (MbimDevice    *self,
+                            GAsyncResult  *res,
+                            MbimMessage  **out_connect_response,
+                            MbimMessage  **out_ip_configuration_response,
+                            GError       **error)
+{
+    ConnectContext *ctx;
+
+    if (!g_task_propagate_boolean (G_TASK (res), error))
+        return FALSE;
+
+    ctx = g_task_get_task_data (G_TASK (res));
+    if (out_connect_response)
+        *out_connect_response = mbim_message_ref (ctx->connect_response);
+    if (out_ip_configuration_response)
+        *out_ip_configuration_response = mbim_message_ref (ctx->ip_configuration_response);
+    return TRUE;
+}
+
+static void connect_step (GTask *task);
+
+/* Completes the command and checks its status, returning the response */
+static MbimMessage *
+connect_command_finish (MbimDevice    *self,
+                        GAsyncResult  *res,
+                        GError       **error)
+{
+    g_autoptr(MbimMessage) response = NULL;
+
+    response = mbim_device_command_finish (self, res, error);
+    if (!response || !mbim_message_response_get_result (response, MBIM_MESSAGE_TYPE_COMMAND_DONE, error))
+        return NULL;
+    return g_steal_pointer (&response);
+}
+
+static void
+connect_ip_configuration_ready (MbimDevice   *self,
+                                GAsyncResult *res,
+                                GTask        *task)
+{
+    ConnectContext *ctx;
+    GError         *error = NULL;
+
+    ctx = g_task_get_task_data (task);
+    ctx->ip_configuration_response = connect_command_finish (self, res, &error);
+    if (!ctx->ip_configuration_response) {
+        g_prefix_error (&error, "IP configuration query failed: ");
+        g_task_return_error (task, error);
+        g_object_unref (task);
+        return;
+    }
+
+    ctx->step++;
+    connect_step (task);
+}
+
+static void
+connect_activate_ready (MbimDevice   *self,
+                        GAsyncResult *res,
+                        GTask        *task)
+{
+    ConnectContext      *ctx;
+    GError              *error = NULL;
+    MbimActivationState  activation_state;
+    guint32              nw_error;
+
+    ctx = g_task_get_task_data (task);
+    ctx->connect_response = connect_command_finish (self, res, &error);
+    if (!ctx->connect_response ||
+        !mbim_message_connect_response_parse (ctx->connect_response,
+                                              NULL, /* session id */
+                                              &activation_state,
+                                              NULL, /* voice call state */
+                                              NULL, /* ip type */
+                                              NULL, /* context type */
+                                              &nw_error,
+                                              &error)) {
+        g_prefix_error (&error, "connection activation failed: ");
+        g_task_return_error (task, error);
+        g_object_unref (task);
+        return;
+    }
+
+    if (activation_state != MBIM_ACTIVATION_STATE_ACTIVATED) {
+        g_task_return_new_error (task, MBIM_CORE_ERROR, MBIM_CORE_ERROR_WRONG_STATE,
+                                 "connection not activated: %s (network error: %s)",
+                                 mbim_activation_state_get_string (activation_state),
+                                 mbim_nw_error_get_string (nw_error));
+        g_object_unref (task);
+        return;
+    }
+
+    ctx->step++;
+    connect_step (task);
+}
+
+static void
+connect_attach_ready (MbimDevice   *self,
+                      GAsyncResult *res,
+                      GTask        *task)
+{
+    ConnectContext         *ctx;
+    GError                 *error = NULL;
+    g_autoptr(MbimMessage)  response = NULL;
+
+    ctx = g_task_get_task_data (task);
+    response = connect_command_finish (self, res, &error);
+    if (!response) {
+        g_prefix_error (&error, "packet service attach failed: ");
+        g_task_return_error (task, error);
+        g_object_unref (task);
+        return;
+    }
+
+    ctx->step++;
+    connect_step (task);
+}
+
+static gboolean
+connect_check_state (MbimMessage  *subscriber_ready_status_response,
+                     MbimMessage  *register_state_response,
+                     MbimMessage  *packet_service_response,
+                     gboolean     *out_attached,
+                     GError      **error)
+{
+    MbimSubscriberReadyState ready_state;
+    MbimRegisterState        register_state;
+    MbimPacketServiceState   packet_service_state;
+
+    if (!mbim_message_response_get_result (subscriber_ready_status_response, MBIM_MESSAGE_TYPE_COMMAND_DONE, error) ||
+        !mbim_message_subscriber_ready_status_response_parse (subscriber_ready_status_response,
+                                                              &ready_state,
+                                                              NULL, NULL, NULL, NULL, NULL,
+                                                              error)) {
+        g_prefix_error (error, "subscriber ready status query failed: ");
+        return FALSE;
+    }
+    if (ready_state != MBIM_SUBSCRIBER_READY_STATE_INITIALIZED) {
+        g_set_error (error, MBIM_CORE_ERROR, MBIM_CORE_ERROR_WRONG_STATE,
+                     "subscriber not ready: %s",
+                     mbim_subscriber_ready_state_get_string (ready_state));
+        return FALSE;
+    }
+
+    if (!mbim_message_response_get_result (register_state_response, MBIM_MESSAGE_TYPE_COMMAND_DONE, error) ||
+        !mbim_message_register_state_response_parse (register_state_response,
+                                                     NULL,
+                                                     &register_state,
+                                                     NULL, NULL, NULL, NULL, NULL, NULL, NULL,
+                                                     error)) {
+        g_prefix_error (error, "registration state query failed: ");
+        return FALSE;
+    }
+    if (register_state != MBIM_REGISTER_STATE_HOME &&
+        register_state != MBIM_REGISTER_STATE_ROAMING &&
+        register_state != MBIM_REGISTER_STATE_PARTNER) {
+        g_set_error (error, MBIM_CORE_ERROR, MBIM_CORE_ERROR_WRONG_STATE,
+                     "not registered: %s",
+                     mbim_register_state_get_string (register_state));
+        return FALSE;
+    }
+
+    /* The packet service state is only used to skip the attach request, so
+     * there is no need to fail if it cannot be queried */
+    *out_attached = (mbim_message_response_get_result (packet_service_response, MBIM_MESSAGE_TYPE_COMMAND_DONE, NULL) &&
+                     mbim_message_packet_service_response_parse (packet_service_response,
+                                                                 NULL,
+                                                                 &packet_service_state,
+                                                                 NULL, NULL, NULL,
+                                                                 NULL) &&
+                     packet_service_state == MBIM_PACKET_SERVICE_STATE_ATTACHED);
+    return TRUE;
+}
+
+static void
+connect_query_state_ready (MbimDevice   *self,
+                           GAsyncResult *res,
+                           GTask        *task)
+{
+    ConnectContext       *ctx;
+    GError               *error = NULL;
+    g_autoptr(GPtrArray)  responses = NULL;
+
+    ctx = g_task_get_task_data (task);
+    responses = mbim_device_command_batch_finish (self, res, &error);
+    if (!responses ||
+        !connect_check_state (g_ptr_array_index (responses, 0),
+                              g_ptr_array_index (responses, 1),
+                              g_ptr_array_index (responses, 2),
+                              &ctx->attached,
+                              &error)) {
+        g_task_return_error (task, error);
+        g_object_unref (task);
+        return;
+    }
+
+    ctx->step++;
+    connect_step (task);
+}
+
+static void
+connect_step (GTask *task)
+{
+    MbimDevice             *self;
+    ConnectContext         *ctx;
+    GError                 *error = NULL;
+    g_autoptr(MbimMessage)  request = NULL;
+
+    self = g_task_get_source_object (task);
+    ctx = g_task_get_task_data (task);
+
+    switch (ctx->step) {
+    case CONNECT_STEP_FIRST:
+        ctx->step++;
+        /* fall through */
+
+    case CONNECT_STEP_QUERY_STATE: {
+        MbimMessage *messages[3];
+        guint        i;
+
+        /* None of these depend on each other, so send them all at once */
+        messages[0] = mbim_message_subscriber_ready_status_query_new (NULL);
+        messages[1] = mbim_message_register_state_query_new (NULL);
+        messages[2] = mbim_message_packet_service_query_new (NULL);
+        mbim_device_command_batch (self,
+                                   messages,
+                                   G_N_ELEMENTS (messages),
+                                   ctx->timeout,
+                                   g_task_get_cancellable (task),
+                                   (GAsyncReadyCallback) connect_query_state_ready,
+                                   task);
+        for (i = 0; i < G_N_ELEMENTS (messages); i++)
+            mbim_message_unref (messages[i]);
+        return;
+    }
+
+    case CONNECT_STEP_ATTACH:
+        if (!ctx->attached) {
+            request = mbim_message_packet_service_set_new (MBIM_PACKET_SERVICE_ACTION_ATTACH, NULL);
+            mbim_device_command (self,
+                                 request,
+                                 ctx->timeout,
+                                 g_task_get_cancellable (task),
+                                 (GAsyncReadyCallback) connect_attach_ready,
+                                 task);
+            return;
+        }
+        ctx->step++;
+        /* fall through */
+
+    case CONNECT_STEP_ACTIVATE:
+        request = mbim_message_connect_set_new (ctx->session_id,
+                                                MBIM_ACTIVATION_COMMAND_ACTIVATE,
+                                                ctx->apn,
+                                                ctx->username,
+                                                ctx->password,
+                                                MBIM_COMPRESSION_NONE,
+                                                ctx->auth_protocol,
+                                                ctx->ip_type,
+                                                mbim_uuid_from_context_type (MBIM_CONTEXT_TYPE_INTERNET),
+                                                &error);
+        if (!request) {
+            g_task_return_error (task, error);
+            g_object_unref (task);
+            return;
+        }
+        mbim_device_command (self,
+                             request,
+                             ctx->timeout,
+                             g_task_get_cancellable (task),
+                             (GAsyncReadyCallback) connect_activate_ready,
+                             task);
+        return;
+
+    case CONNECT_STEP_IP_CONFIGURATION:
+        request = mbim_message_ip_configuration_query_new (ctx->session_id,
+                                                           MBIM_IP_CONFIGURATION_AVAILABLE_FLAG_NONE,
+                                                           MBIM_IP_CONFIGURATION_AVAILABLE_FLAG_NONE,
+                                                           0, NULL, /* ipv4 addresses */
+                                                           0, NULL, /* ipv6 addresses */
+                                                           NULL, NULL, /* gateways */
+                                                           0, NULL, /* ipv4 dns servers */
+                                                           0, NULL, /* ipv6 dns servers */
+                                                           0, 0, /* mtus */
+                                                           &error);
+        if (!request) {
+            g_task_return_error (task, error);
+            g_object_unref (task);
+            return;
+        }
+        mbim_device_command (self,
+                             request,
+                             ctx->timeout,
+                             g_task_get_cancellable (task),
+                             (GAsyncReadyCallback) connect_ip_configuration_ready,
+                             task);
+        return;
+
+    case CONNECT_STEP_LAST:
+        g_task_return_boolean (task, TRUE);
+        g_object_unref (task);
+        return;
+
+    default:
+        g_assert_not_reached ();
+    }
+}
+
+void
+mbim_device_connect (MbimDevice          *self,
+                     guint32              session_id,
+                     const gchar         *apn,
+                     MbimAuthProtocol     auth_protocol,
+                     const gchar         *username,
+                     const gchar         *password,
+                     MbimContextIpType    ip_type,
+                     guint                timeout,
+                     GCancellable        *cancellable,
+                     GAsyncReadyCallback  callback,
+                     gpointer             user_data)
+{
+    ConnectContext *ctx;
+    GTask          *task;
+
+    g_return_if_fail (MBIM_IS_DEVICE (self));
+
+    task = g_task_new (self, cancellable, callback, user_data);
+
+    ctx = g_slice_new0 (ConnectContext);
+    ctx->step = CONNECT_STEP_FIRST;
+    ctx->session_id = session_id;
+    ctx->apn = g_strdup (apn);
+    ctx->auth_protocol = auth_protocol;
+    ctx->username = g_strdup (username);
+    ctx->password = g_strdup (password);
+    ctx->ip_type = ip_type;
+    ctx->timeout = timeout;
+    g_task_set_task_data (task, ctx, (GDestroyNotify) connect_context_free);
+
+    connect_step (task);
+}
+
 /*****************************************************************************/
 /* New MBIM device */
 
@@ -2450,6 +5315,12 @@ mbim_device_init (MbimDevice *self)
     /* Initialize transaction ID */
     self->priv->transaction_id = 0x01;
     self->priv->open_status = OPEN_STATUS_CLOSED;
+
+    g_queue_init (&self->priv->write_queue);
+    g_queue_init (&self->priv->held_queue);
+    g_mutex_init (&self->priv->submit_lock);
+
+    self->priv->stats.commands = mbim_command_statistics_table_new ();
 }
 
 static void
@@ -2460,7 +5331,11 @@ dispose (GObject *object)
     g_clear_object (&self->priv->file);
 
     destroy_iochannel (self, NULL);
-    g_clear_object (&self->priv->net_port_manager);
+    g_clear_pointer (&self->priv->indication_filter, mbim_indication_filter_free);
+    if (self->priv->net_port_manager) {
+        g_signal_handlers_disconnect_by_data (self->priv->net_port_manager, self);
+        g_clear_object (&self->priv->net_port_manager);
+    }
 
     G_OBJECT_CLASS (mbim_device_parent_class)->dispose (object);
 }
@@ -2472,18 +5347,24 @@ finalize (GObject *object)
     guint i;
 
     /* Transactions keep refs to the device, so it's actually
-     * impossible to have any content in the HT */
+     * impossible to have any content in the tables */
     for (i = 0; i < TRANSACTION_TYPE_LAST; i++) {
-        if (self->priv->transactions[i]) {
-            g_assert (g_hash_table_size (self->priv->transactions[i]) == 0);
-            g_hash_table_unref (self->priv->transactions[i]);
-            self->priv->transactions[i] = NULL;
-        }
+        g_assert (self->priv->transactions[i].n_used == 0);
+        g_clear_pointer (&self->priv->transactions[i].slots, g_free);
     }
 
+    /* Submitted commands keep refs to the device as well, and the source is
+     * destroyed when closing */
+    g_assert (!self->priv->submitted_commands);
+    g_assert (!self->priv->submit_source);
+    g_mutex_clear (&self->priv->submit_lock);
+
     g_free (self->priv->path);
     g_free (self->priv->path_display);
     g_free (self->priv->wwan_iface);
+    if (self->priv->trace_buffer)
+        g_string_free (self->priv->trace_buffer, TRUE);
+    g_hash_table_unref (self->priv->stats.commands);
 
     G_OBJECT_CLASS (mbim_device_parent_class)->finalize (object);
 }
@@ -2609,4 +5490,52 @@ mbim_device_class_init (MbimDeviceClass *klass)
                       NULL,
                       G_TYPE_NONE,
                       0);
+
+  /**
+   * MbimDevice::device-link-added:
+   * @self: the #MbimDevice
+   * @ifname: the name of the link
+   *
+   * The ::device-link-added signal is emitted when a new link is added on top
+   * of the net interface of the device. It is only emitted once link
+   * management has been used in the device, e.g. after a successful
+   * mbim_device_check_link_supported().
+   *
+   * Since: 1.26
+   */
+    signals[SIGNAL_LINK_ADDED] =
+        g_signal_new (MBIM_DEVICE_SIGNAL_LINK_ADDED,
+                      G_OBJECT_CLASS_TYPE (G_OBJECT_CLASS (klass)),
+                      G_SIGNAL_RUN_LAST,
+                      0,
+                      NULL,
+                      NULL,
+                      NULL,
+                      G_TYPE_NONE,
+                      1,
+                      G_TYPE_STRING);
+
+  /**
+   * MbimDevice::device-link-removed:
+   * @self: the #MbimDevice
+   * @ifname: the name of the link
+   *
+   * The ::device-link-removed signal is emitted when a link on top of the net
+   * interface of the device is removed. It is only emitted once link
+   * management has been used in the device, e.g. after a successful
+   * mbim_device_check_link_supported().
+   *
+   * Since: 1.26
+   */
+    signals[SIGNAL_LINK_REMOVED] =
+        g_signal_new (MBIM_DEVICE_SIGNAL_LINK_REMOVED,
+                      G_OBJECT_CLASS_TYPE (G_OBJECT_CLASS (klass)),
+                      G_SIGNAL_RUN_LAST,
+                      0,
+                      NULL,
+                      NULL,
+                      NULL,
+                      G_TYPE_NONE,
+                      1,
+                      G_TYPE_STRING);
 }
@@ -31,6 +31,7 @@
 #include <gio/gio.h>
 
 #include "mbim-message.h"
+#include "mbim-enums.h"
 
 G_BEGIN_DECLS
 
@@ -110,6 +111,24 @@ typedef struct _MbimDevicePrivate MbimDevicePrivate;
  */
 #define MBIM_DEVICE_SIGNAL_REMOVED "device-removed"
 
+/**
+ * MBIM_DEVICE_SIGNAL_LINK_ADDED:
+ *
+ * Symbol defining the #MbimDevice::device-link-added signal.
+ *
+ * Since: 1.26
+ */
+#define MBIM_DEVICE_SIGNAL_LINK_ADDED "device-link-added"
+
+/**
+ * MBIM_DEVICE_SIGNAL_LINK_REMOVED:
+ *
+ * Symbol defining the #MbimDevice::device-link-removed signal.
+ *
+ * Since: 1.26
+ */
+#define MBIM_DEVICE_SIGNAL_LINK_REMOVED "device-link-removed"
+
 /**
  * MbimDevice:
  *
@@ -229,14 +248,29 @@ gboolean mbim_device_is_open (MbimDevice *self);
  * MbimDeviceOpenFlags:
  * @MBIM_DEVICE_OPEN_FLAGS_NONE: None.
  * @MBIM_DEVICE_OPEN_FLAGS_PROXY: Try to open the port through the 'mbim-proxy'.
+ * @MBIM_DEVICE_OPEN_FLAGS_READER_THREAD: Read from the port in a dedicated
+ *  thread, so that data is drained from the port and framed into full
+ *  messages regardless of how busy the main context is; only complete messages
+ *  are dispatched in the main context. Since 1.26.
+ * @MBIM_DEVICE_OPEN_FLAGS_PROXY_SEQPACKET: When opening the port through the
+ *  'mbim-proxy', prefer a %G_SOCKET_TYPE_SEQPACKET socket, which preserves the
+ *  boundaries of the messages exchanged with the proxy. If the proxy doesn't
+ *  support it, the default stream socket is used instead. Since 1.26.
+ * @MBIM_DEVICE_OPEN_FLAGS_FAST_REOPEN: Before running the open sequence, check
+ *  with a single short-timeout query whether the function was left open by a
+ *  previous user of the port, and if so, skip the open sequence altogether.
+ *  Ignored when opening the port through the 'mbim-proxy'. Since 1.26.
  *
  * Flags to specify which actions to be performed when the device is open.
  *
  * Since: 1.10
  */
 typedef enum { /*< since=1.10 >*/
-    MBIM_DEVICE_OPEN_FLAGS_NONE  = 0,
-    MBIM_DEVICE_OPEN_FLAGS_PROXY = 1 << 0
+    MBIM_DEVICE_OPEN_FLAGS_NONE            = 0,
+    MBIM_DEVICE_OPEN_FLAGS_PROXY           = 1 << 0,
+    MBIM_DEVICE_OPEN_FLAGS_READER_THREAD   = 1 << 1,
+    MBIM_DEVICE_OPEN_FLAGS_PROXY_SEQPACKET = 1 << 2,
+    MBIM_DEVICE_OPEN_FLAGS_FAST_REOPEN     = 1 << 3
 } MbimDeviceOpenFlags;
 
 /**
@@ -434,6 +468,433 @@ MbimMessage *mbim_device_command_finish (MbimDevice    *self,
                                          GAsyncResult  *res,
                                          GError       **error);
 
+/**
+ * mbim_device_command_threadsafe:
+ * @self: a #MbimDevice.
+ * @message: the message to send.
+ * @timeout: maximum time, in seconds, to wait for the response.
+ * @cancellable: a #GCancellable, or %NULL.
+ * @callback: a #GAsyncReadyCallback to call when the operation is finished.
+ * @user_data: the data to pass to callback function.
+ *
+ * Asynchronously sends a #MbimMessage to the device, like mbim_device_command()
+ * does, but may be called from any thread.
+ *
+ * The message is sent from the thread-default #GMainContext in which the
+ * device was last opened, and @callback is called in the thread-default
+ * #GMainContext of the caller. @message must not be modified after
+ * submission, as the transaction ID is set on it if it doesn't have one.
+ *
+ * If the device is closed before the message is sent, the operation fails
+ * with %MBIM_CORE_ERROR_WRONG_STATE.
+ *
+ * When the operation is finished @callback will be called. You can then call
+ * mbim_device_command_threadsafe_finish() to get the result of the operation.
+ *
+ * Since: 1.26
+ */
+void mbim_device_command_threadsafe (MbimDevice          *self,
+                                     MbimMessage         *message,
+                                     guint                timeout,
+                                     GCancellable        *cancellable,
+                                     GAsyncReadyCallback  callback,
+                                     gpointer             user_data);
+
+/**
+ * mbim_device_command_threadsafe_finish:
+ * @self: a #MbimDevice.
+ * @res: a #GAsyncResult.
+ * @error: Return location for error or %NULL.
+ *
+ * Finishes an operation started with mbim_device_command_threadsafe().
+ *
+ * Returns: a #MbimMessage response, or #NULL if @error is set. The returned value should be freed with mbim_message_unref().
+ *
+ * Since: 1.26
+ */
+MbimMessage *mbim_device_command_threadsafe_finish (MbimDevice    *self,
+                                                    GAsyncResult  *res,
+                                                    GError       **error);
+
+/**
+ * mbim_device_command_batch:
+ * @self: a #MbimDevice.
+ * @messages: (array length=n_messages): the messages to send.
+ * @n_messages: the number of messages in @messages.
+ * @timeout: maximum time, in seconds, to wait for each of the responses.
+ * @cancellable: a #GCancellable, or %NULL.
+ * @callback: a #GAsyncReadyCallback to call when the operation is finished.
+ * @user_data: the data to pass to callback function.
+ *
+ * Asynchronously sends a set of #MbimMessage requests to the device at once.
+ *
+ * Transaction IDs are allocated for all the messages that don't have one
+ * before any of them is sent, and all requests are submitted right away
+ * without waiting for the previous responses. When the device is accessed
+ * through the proxy, the requests are written to the socket in as few writes
+ * as possible, each one of at most the maximum control transfer size.
+ *
+ * When all the responses have been received @callback will be called. You can
+ * then call mbim_device_command_batch_finish() to get the result of the
+ * operation.
+ *
+ * Since: 1.26
+ */
+void mbim_device_command_batch (MbimDevice          *self,
+                                MbimMessage        **messages,
+                                guint                n_messages,
+                                guint                timeout,
+                                GCancellable        *cancellable,
+                                GAsyncReadyCallback  callback,
+                                gpointer             user_data);
+
+/**
+ * mbim_device_command_batch_finish:
+ * @self: a #MbimDevice.
+ * @res: a #GAsyncResult.
+ * @error: Return location for error or %NULL.
+ *
+ * Finishes an operation started with mbim_device_command_batch().
+ *
+ * If any of the commands in the batch failed, @error is set to the error of
+ * the first failed command, in batch order.
+ *
+ * Returns: (transfer full)(element-type MbimMessage): a #GPtrArray with one
+ * #MbimMessage response per request, in the same order, or #NULL if @error is
+ * set. The returned value should be freed with g_ptr_array_unref().
+ *
+ * Since: 1.26
+ */
+GPtrArray *mbim_device_command_batch_finish (MbimDevice    *self,
+                                             GAsyncResult  *res,
+                                             GError       **error);
+
+/**
+ * MbimDeviceCommandBatchResponseFunc:
+ * @self: a #MbimDevice.
+ * @index: the position of the request in the batch.
+ * @response: (nullable): the #MbimMessage response, or %NULL if @error is set.
+ * @error: (nullable): the error of the request, or %NULL if @response is set.
+ * @user_data: the data given in mbim_device_command_batch_full().
+ *
+ * Callback used by mbim_device_command_batch_full() to report the result of
+ * each request as soon as it is available, in the order the responses are
+ * received.
+ *
+ * Since: 1.26
+ */
+typedef void (* MbimDeviceCommandBatchResponseFunc) (MbimDevice   *self,
+                                                     guint         index,
+                                                     MbimMessage  *response,
+                                                     const GError *error,
+                                                     gpointer      user_data);
+
+/**
+ * mbim_device_command_batch_full:
+ * @self: a #MbimDevice.
+ * @messages: (array length=n_messages): the messages to send.
+ * @n_messages: the number of messages in @messages.
+ * @timeout: maximum time, in seconds, to wait for each of the responses.
+ * @cancellable: a #GCancellable, or %NULL.
+ * @response_callback: (nullable): a #MbimDeviceCommandBatchResponseFunc, or %NULL.
+ * @response_callback_data: the data to pass to @response_callback.
+ * @callback: a #GAsyncReadyCallback to call when the operation is finished.
+ * @user_data: the data to pass to callback function.
+ *
+ * Asynchronously sends a set of #MbimMessage requests to the device at once,
+ * as mbim_device_command_batch() does, and also reports the result of each
+ * request through @response_callback as soon as it is available, without
+ * waiting for the rest of the batch.
+ *
+ * When all the responses have been received @callback will be called. You can
+ * then call mbim_device_command_batch_full_finish() to get the result of the
+ * operation.
+ *
+ * Since: 1.26
+ */
+void mbim_device_command_batch_full (MbimDevice                          *self,
+                                     MbimMessage                        **messages,
+                                     guint                                n_messages,
+                                     guint                                timeout,
+                                     GCancellable                        *cancellable,
+                                     MbimDeviceCommandBatchResponseFunc   response_callback,
+                                     gpointer                             response_callback_data,
+                                     GAsyncReadyCallback                  callback,
+                                     gpointer                             user_data);
+
+/**
+ * mbim_device_command_batch_full_finish:
+ * @self: a #MbimDevice.
+ * @res: a #GAsyncResult.
+ * @error: Return location for error or %NULL.
+ *
+ * Finishes an operation started with mbim_device_command_batch_full().
+ *
+ * If any of the commands in the batch failed, @error is set to the error of
+ * the first failed command, in batch order.
+ *
+ * Returns: (transfer full)(element-type MbimMessage): a #GPtrArray with one
+ * #MbimMessage response per request, in the same order, or #NULL if @error is
+ * set. The returned value should be freed with g_ptr_array_unref().
+ *
+ * Since: 1.26
+ */
+GPtrArray *mbim_device_command_batch_full_finish (MbimDevice    *self,
+                                                  GAsyncResult  *res,
+                                                  GError       **error);
+
+/**
+ * MbimDeviceCommandStreamProgressFunc:
+ * @self: a #MbimDevice.
+ * @sent: the amount of bytes of the stream already sent.
+ * @total: the total amount of bytes of the stream.
+ * @user_data: the data given in mbim_device_command_stream().
+ *
+ * Callback used to report the progress of mbim_device_command_stream(), called
+ * every time a fragment has been written.
+ *
+ * Since: 1.26
+ */
+typedef void (* MbimDeviceCommandStreamProgressFunc) (MbimDevice *self,
+                                                      guint32     sent,
+                                                      guint32     total,
+                                                      gpointer    user_data);
+
+/**
+ * mbim_device_command_stream:
+ * @self: a #MbimDevice.
+ * @service: a known #MbimService.
+ * @cid: the command ID.
+ * @command_type: the #MbimMessageCommandType.
+ * @stream: a #GInputStream providing the contents of the information buffer.
+ * @stream_size: the amount of bytes to read from @stream.
+ * @timeout: maximum time, in seconds, to wait for the response once the whole
+ *  request has been sent.
+ * @cancellable: a #GCancellable, or %NULL.
+ * @progress_callback: (nullable): a #MbimDeviceCommandStreamProgressFunc, or %NULL.
+ * @progress_callback_data: the data to pass to @progress_callback.
+ * @callback: a #GAsyncReadyCallback to call when the operation is finished.
+ * @user_data: the data to pass to callback function.
+ *
+ * Asynchronously sends a command request whose information buffer is read
+ * from @stream, e.g. the data of a %MBIM_CID_QDU_FILE_WRITE request. A mapped
+ * file may be given with g_memory_input_stream_new_from_bytes().
+ *
+ * The request is never built in memory as a whole: each fragment is read from
+ * @stream right before it is written to the device, so the memory required
+ * doesn't depend on @stream_size. Other requests sent to @self while the stream
+ * is in progress are held until all its fragments have been written.
+ *
+ * When the operation is finished @callback will be called. You can then call
+ * mbim_device_command_stream_finish() to get the result of the operation.
+ *
+ * Since: 1.26
+ */
+void mbim_device_command_stream (MbimDevice                          *self,
+                                 MbimService                          service,
+                                 guint32                              cid,
+                                 MbimMessageCommandType               command_type,
+                                 GInputStream                        *stream,
+                                 guint32                              stream_size,
+                                 guint                                timeout,
+                                 GCancellable                        *cancellable,
+                                 MbimDeviceCommandStreamProgressFunc  progress_callback,
+                                 gpointer                             progress_callback_data,
+                                 GAsyncReadyCallback                  callback,
+                                 gpointer                             user_data);
+
+/**
+ * mbim_device_command_stream_finish:
+ * @self: a #MbimDevice.
+ * @res: a #GAsyncResult.
+ * @error: Return location for error or %NULL.
+ *
+ * Finishes an operation started with mbim_device_command_stream().
+ *
+ * Returns: a #MbimMessage response, or #NULL if @error is set. The returned value should be freed with mbim_message_unref().
+ *
+ * Since: 1.26
+ */
+MbimMessage *mbim_device_command_stream_finish (MbimDevice    *self,
+                                                GAsyncResult  *res,
+                                                GError       **error);
+
+/**
+ * mbim_device_get_write_queue_size:
+ * @self: a #MbimDevice.
+ *
+ * Gets the amount of data, in bytes, queued in @self waiting for the port to
+ * become writable again.
+ *
+ * Returns: the amount of bytes pending to be written.
+ *
+ * Since: 1.26
+ */
+gsize mbim_device_get_write_queue_size (MbimDevice *self);
+
+/**
+ * mbim_device_get_write_queue_high_water_mark:
+ * @self: a #MbimDevice.
+ *
+ * Gets the write queue high-water mark configured in @self.
+ *
+ * Returns: the high-water mark, in bytes, or 0 if none set.
+ *
+ * Since: 1.26
+ */
+gsize mbim_device_get_write_queue_high_water_mark (MbimDevice *self);
+
+/**
+ * mbim_device_set_write_queue_high_water_mark:
+ * @self: a #MbimDevice.
+ * @high_water_mark: the high-water mark, in bytes, or 0 to disable it.
+ *
+ * Sets the maximum amount of data that may be queued in @self waiting for the
+ * port to become writable again. Once the amount of queued data reaches this
+ * value, mbim_device_command() fails right away with
+ * %MBIM_CORE_ERROR_WOULD_BLOCK, so that callers can apply back-pressure.
+ *
+ * By default no high-water mark is set.
+ *
+ * Since: 1.26
+ */
+void mbim_device_set_write_queue_high_water_mark (MbimDevice *self,
+                                                  gsize       high_water_mark);
+
+/**
+ * mbim_device_get_statistics:
+ * @self: a #MbimDevice.
+ *
+ * Gets a snapshot of the statistics collected by @self since it was created.
+ *
+ * The statistics are given as a %G_VARIANT_TYPE_VARDICT dictionary, so that
+ * new values may be added in the future. All counters are of type 't'.
+ *
+ * The "messages-sent", "fragments-sent", "bytes-sent", "messages-received",
+ * "fragments-received" and "bytes-received" keys give the traffic on the port,
+ * "writes" the number of write operations issued on the port,
+ * "read-wakeups" the number of times the device was woken up to read from it,
+ * and "timeouts" the number of requests that timed out waiting for the response
+ * or for one of its fragments.
+ *
+ * The "indications" key gives the number of indications received, and
+ * "indications-per-second" (type 'd') the rate measured over the last complete
+ * second. The "pending-transactions" key gives the number of requests currently
+ * waiting for a response, and "pending-transactions-high-water-mark" the
+ * maximum ever reached.
+ *
+ * The time between sending a request and receiving its full response is given
+ * in microseconds by the "latency-min-us", "latency-max-us", "latency-mean-us",
+ * "latency-p50-us" and "latency-p99-us" keys, along with a "latency-histogram"
+ * (type 'at') with the number of responses in each bucket. The time between the
+ * first and last fragment of the messages received in multiple fragments is
+ * given in the same way with the "reassembly-" prefix. The upper bounds of the
+ * histogram buckets are given in "histogram-bounds-us" (type 'at'); the last
+ * bucket has no upper bound. Percentiles are reported as the upper bound of the
+ * bucket where they fall.
+ *
+ * The "commands" key (type 'aa{sv}') gives one dictionary per command requested,
+ * identified by the "service" (type 's') and "cid" (type 'u') keys, with the
+ * number of requests completed in "count", the number of failed ones in
+ * "errors" and "timeouts", and the "latency-" values described above.
+ *
+ * Returns: (transfer full): a #GVariant, which should be unreffed with
+ * g_variant_unref().
+ *
+ * Since: 1.26
+ */
+GVariant *mbim_device_get_statistics (MbimDevice *self);
+
+/**
+ * mbim_device_get_proxy_command_timeout:
+ * @self: a #MbimDevice.
+ *
+ * Gets the timeout the 'mbim-proxy' is requested to use for the commands
+ * forwarded on behalf of @self.
+ *
+ * Returns: the timeout, in seconds, or 0 if the proxy default is used.
+ *
+ * Since: 1.26
+ */
+guint mbim_device_get_proxy_command_timeout (MbimDevice *self);
+
+/**
+ * mbim_device_set_proxy_command_timeout:
+ * @self: a #MbimDevice.
+ * @timeout: the timeout, in seconds, or 0 to use the proxy default.
+ *
+ * Sets the maximum time the 'mbim-proxy' should wait for the responses to the
+ * commands it forwards to the device on behalf of @self. The timeout is given
+ * to the proxy with a %MBIM_CID_PROXY_CONTROL_CLIENT_CONFIGURATION request
+ * when the device is opened with %MBIM_DEVICE_OPEN_FLAGS_PROXY, so it must be
+ * set before that. Proxies not supporting that request keep on using their
+ * default timeout.
+ *
+ * The timeout should not be shorter than the ones given in
+ * mbim_device_command(), or responses may be lost.
+ *
+ * Since: 1.26
+ */
+void mbim_device_set_proxy_command_timeout (MbimDevice *self,
+                                            guint       timeout);
+
+/**
+ * MbimIndicationPolicy:
+ * @MBIM_INDICATION_POLICY_NONE: Every indication is emitted as soon as it is
+ *  received.
+ * @MBIM_INDICATION_POLICY_COALESCE: The first indication received starts an
+ *  interval, and only the latest one received within it is emitted when the
+ *  interval ends.
+ * @MBIM_INDICATION_POLICY_RATE_LIMIT: Indications are emitted right away as long
+ *  as the rate limit allows it, using a token bucket which holds up to a given
+ *  burst of tokens and gets a new one every interval. Once exhausted, only the
+ *  latest indication received is emitted when the next token is available.
+ *
+ * Policy applied to the indications of a given service and command.
+ *
+ * With any policy, the latest indication received is always emitted
+ * eventually, so that the last state reported by the function is never lost.
+ *
+ * Since: 1.26
+ */
+typedef enum { /*< since=1.26 >*/
+    MBIM_INDICATION_POLICY_NONE       = 0,
+    MBIM_INDICATION_POLICY_COALESCE   = 1,
+    MBIM_INDICATION_POLICY_RATE_LIMIT = 2
+} MbimIndicationPolicy;
+
+/**
+ * mbim_device_set_indication_policy:
+ * @self: a #MbimDevice.
+ * @service_id: the #MbimUuid of the service.
+ * @cid: the command ID.
+ * @policy: a #MbimIndicationPolicy.
+ * @interval_ms: the coalescing interval, or the time to get a new token when
+ *  rate limiting, in milliseconds.
+ * @burst: the maximum number of indications emitted back to back when rate
+ *  limiting; ignored otherwise.
+ *
+ * Sets the policy applied to the indications of the given service and command
+ * before they are emitted in the #MbimDevice::device-indicate-status signal.
+ *
+ * Setting %MBIM_INDICATION_POLICY_NONE, or a zero @interval_ms, removes any
+ * previous policy, and the indication held back, if any, is emitted right away.
+ * Indications held back are also emitted when the device is closed.
+ *
+ * The policy only applies to the indications emitted by @self. When the port
+ * is opened through the 'mbim-proxy', the same policy may be applied by the
+ * proxy itself with the %MBIM_CID_PROXY_CONTROL_INDICATION_POLICY command, so
+ * that the indications skipped are not even forwarded.
+ *
+ * Since: 1.26
+ */
+void mbim_device_set_indication_policy (MbimDevice           *self,
+                                        const MbimUuid       *service_id,
+                                        guint32               cid,
+                                        MbimIndicationPolicy  policy,
+                                        guint                 interval_ms,
+                                        guint                 burst);
+
 /**
  * MBIM_DEVICE_SESSION_ID_AUTOMATIC:
  *
@@ -561,6 +1022,103 @@ gboolean mbim_device_delete_link_finish (MbimDevice    *self,
                                          GAsyncResult  *res,
                                          GError       **error);
 
+/**
+ * mbim_device_add_links:
+ * @self: a #MbimDevice.
+ * @session_ids: (array length=n_session_ids): the session ids for the links,
+ *   each one in the
+ *   [#MBIM_DEVICE_SESSION_ID_MIN,#MBIM_DEVICE_SESSION_ID_MAX] range, or
+ *   #MBIM_DEVICE_SESSION_ID_AUTOMATIC to find the first available session id.
+ * @n_session_ids: the number of items in @session_ids.
+ * @base_ifname: the interface which the new links will be created on.
+ * @ifname_prefix: the prefix suggested to be used for the name of the new links
+ *   created.
+ * @cancellable: a #GCancellable, or %NULL.
+ * @callback: a #GAsyncReadyCallback to call when the operation is finished.
+ * @user_data: the data to pass to callback function.
+ *
+ * Asynchronously creates multiple virtual network device nodes on top of
+ * @base_ifname, as mbim_device_add_link() does for a single one, with all the
+ * requests sent to the kernel at once.
+ *
+ * If the creation of any of the links fails, the operation reports the first
+ * error found, even if some of the other links were successfully created.
+ *
+ * When the operation is finished @callback will be called. You can then call
+ * mbim_device_add_links_finish() to get the result of the operation.
+ *
+ * Since: 1.26
+ */
+void mbim_device_add_links (MbimDevice          *self,
+                            const guint         *session_ids,
+                            guint                n_session_ids,
+                            const gchar         *base_ifname,
+                            const gchar         *ifname_prefix,
+                            GCancellable        *cancellable,
+                            GAsyncReadyCallback  callback,
+                            gpointer             user_data);
+
+/**
+ * mbim_device_add_links_finish:
+ * @self: a #MbimDevice.
+ * @res: a #GAsyncResult.
+ * @session_ids: (out)(optional)(transfer full)(element-type guint): return
+ *   location for a #GArray with the session IDs of the links created, or %NULL.
+ * @error: Return location for error or %NULL.
+ *
+ * Finishes an operation started with mbim_device_add_links().
+ *
+ * Returns: (transfer full)(element-type utf8): a #GPtrArray with the names of
+ * the net interfaces created, in the same order as the session ids given, or
+ * %NULL if @error is set.
+ *
+ * Since: 1.26
+ */
+GPtrArray *mbim_device_add_links_finish (MbimDevice    *self,
+                                         GAsyncResult  *res,
+                                         GArray       **session_ids,
+                                         GError       **error);
+
+/**
+ * mbim_device_delete_links:
+ * @self: a #MbimDevice.
+ * @ifnames: (array zero-terminated=1): a %NULL-terminated array with the names
+ *   of the links to remove.
+ * @cancellable: a #GCancellable, or %NULL.
+ * @callback: a #GAsyncReadyCallback to call when the operation is finished.
+ * @user_data: the data to pass to callback function.
+ *
+ * Asynchronously deletes multiple virtual network interfaces that have been
+ * previously created with mbim_device_add_link() or mbim_device_add_links(),
+ * with all the requests sent to the kernel at once.
+ *
+ * When the operation is finished @callback will be called. You can then call
+ * mbim_device_delete_links_finish() to get the result of the operation.
+ *
+ * Since: 1.26
+ */
+void mbim_device_delete_links (MbimDevice          *self,
+                               const gchar * const *ifnames,
+                               GCancellable        *cancellable,
+                               GAsyncReadyCallback  callback,
+                               gpointer             user_data);
+
+/**
+ * mbim_device_delete_links_finish:
+ * @self: a #MbimDevice.
+ * @res: a #GAsyncResult.
+ * @error: Return location for error or %NULL.
+ *
+ * Finishes an operation started with mbim_device_delete_links().
+ *
+ * Returns: %TRUE if successful, %FALSE if @error is set.
+ *
+ * Since: 1.26
+ */
+gboolean mbim_device_delete_links_finish (MbimDevice    *self,
+                                          GAsyncResult  *res,
+                                          GError       **error);
+
 /**
  * mbim_device_delete_all_links:
  * @self: a #MbimDevice.
@@ -606,6 +1164,65 @@ gboolean mbim_device_delete_all_links_finish (MbimDevice    *self,
                                               GAsyncResult  *res,
                                               GError       **error);
 
+/**
+ * mbim_device_configure_link:
+ * @self: a #MbimDevice.
+ * @ifname: the name of the network interface to configure.
+ * @ip_configuration: a #MbimMessage with the response to an IP Configuration
+ *   query.
+ * @route_metric: the metric of the default routes, or 0 to use the default
+ *   one (700).
+ * @cancellable: a #GCancellable, or %NULL.
+ * @callback: a #GAsyncReadyCallback to call when the operation is finished.
+ * @user_data: the data to pass to callback function.
+ *
+ * Asynchronously applies the settings reported in @ip_configuration to the
+ * @ifname network interface: the interface is brought up with the reported
+ * MTU, and the reported IPv4 and IPv6 addresses and default routes through the
+ * reported gateways are added.
+ *
+ * All the settings are given to the kernel at once and in order, and if any
+ * of them fails, the operation reports the first error found. DNS servers are
+ * not configured, as that is not a network interface setting.
+ *
+ * Existing default routes are never replaced: a route already present with
+ * the same metric is left untouched and not reported as an error, so that the
+ * same settings can be applied again. The default metric is higher than the
+ * ones usually given to wired and wireless interfaces, so that the routes
+ * through the modem are only preferred if the caller asks for it.
+ *
+ * The base interface in which @ifname was created with mbim_device_add_link()
+ * must already be up.
+ *
+ * When the operation is finished @callback will be called. You can then call
+ * mbim_device_configure_link_finish() to get the result of the operation.
+ *
+ * Since: 1.26
+ */
+void mbim_device_configure_link (MbimDevice          *self,
+                                 const gchar         *ifname,
+                                 const MbimMessage   *ip_configuration,
+                                 guint32              route_metric,
+                                 GCancellable        *cancellable,
+                                 GAsyncReadyCallback  callback,
+                                 gpointer             user_data);
+
+/**
+ * mbim_device_configure_link_finish:
+ * @self: a #MbimDevice.
+ * @res: a #GAsyncResult.
+ * @error: Return location for error or %NULL.
+ *
+ * Finishes an operation started with mbim_device_configure_link().
+ *
+ * Returns: %TRUE if successful, %FALSE if @error is set.
+ *
+ * Since: 1.26
+ */
+gboolean mbim_device_configure_link_finish (MbimDevice    *self,
+                                            GAsyncResult  *res,
+                                            GError       **error);
+
 /**
  * mbim_device_list_links:
  * @self: a #MbimDevice.
@@ -637,6 +1254,73 @@ gboolean mbim_device_list_links (MbimDevice   *self,
 gboolean mbim_device_check_link_supported (MbimDevice  *self,
                                            GError     **error);
 
+/**
+ * mbim_device_connect:
+ * @self: a #MbimDevice.
+ * @session_id: the session ID to connect.
+ * @apn: (nullable): the access string, or %NULL.
+ * @auth_protocol: a #MbimAuthProtocol.
+ * @username: (nullable): the user name, or %NULL.
+ * @password: (nullable): the password, or %NULL.
+ * @ip_type: a #MbimContextIpType.
+ * @timeout: maximum time, in seconds, to wait for each of the responses.
+ * @cancellable: a #GCancellable, or %NULL.
+ * @callback: a #GAsyncReadyCallback to call when the operation is finished.
+ * @user_data: the data to pass to callback function.
+ *
+ * Asynchronously brings up an internet data connection in the given session,
+ * running the whole sequence in the already open @self.
+ *
+ * The subscriber ready status, the registration state and the packet service
+ * state are queried at the same time; if the SIM is ready and the device is
+ * registered, the packet service is attached (unless it already is), then the
+ * connection is activated and finally the IP configuration is queried.
+ *
+ * When the operation is finished @callback will be called. You can then call
+ * mbim_device_connect_finish() to get the result of the operation.
+ *
+ * Since: 1.26
+ */
+void mbim_device_connect (MbimDevice          *self,
+                          guint32              session_id,
+                          const gchar         *apn,
+                          MbimAuthProtocol     auth_protocol,
+                          const gchar         *username,
+                          const gchar         *password,
+                          MbimContextIpType    ip_type,
+                          guint                timeout,
+                          GCancellable        *cancellable,
+                          GAsyncReadyCallback  callback,
+                          gpointer             user_data);
+
+/**
+ * mbim_device_connect_finish:
+ * @self: a #MbimDevice.
+ * @res: a #GAsyncResult.
+ * @out_connect_response: (out)(optional)(transfer full): return location for
+ *   the response to the connect request, or %NULL. Free the returned value with
+ *   mbim_message_unref().
+ * @out_ip_configuration_response: (out)(optional)(transfer full): return
+ *   location for the response to the IP configuration query, or %NULL. Free
+ *   the returned value with mbim_message_unref().
+ * @error: Return location for error or %NULL.
+ *
+ * Finishes an operation started with mbim_device_connect().
+ *
+ * The responses are given so that they can be parsed with
+ * mbim_message_connect_response_parse() and
+ * mbim_message_ip_configuration_response_parse().
+ *
+ * Returns: %TRUE if the connection is activated, %FALSE if @error is set.
+ *
+ * Since: 1.26
+ */
+gboolean mbim_device_connect_finish (MbimDevice    *self,
+                                     GAsyncResult  *res,
+                                     MbimMessage  **out_connect_response,
+                                     MbimMessage  **out_ip_configuration_response,
+                                     GError       **error);
+
 G_END_DECLS
 
 #endif /* _LIBMBIM_GLIB_MBIM_DEVICE_H_ */
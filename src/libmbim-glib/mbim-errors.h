@@ -51,6 +51,7 @@
  * @MBIM_CORE_ERROR_UNSUPPORTED: Not supported.
  * @MBIM_CORE_ERROR_ABORTED: Operation aborted.
  * @MBIM_CORE_ERROR_UNKNOWN_STATE: State is unknown. Since 1.16.
+ * @MBIM_CORE_ERROR_WOULD_BLOCK: Operation would block, e.g. because the write queue is full. Since 1.26.
  *
  * Common errors that may be reported by libmbim-glib.
  *
@@ -64,7 +65,8 @@ typedef enum { /*< since=1.0 >*/
     MBIM_CORE_ERROR_INVALID_MESSAGE  = 4, /*< nick=InvalidMessage >*/
     MBIM_CORE_ERROR_UNSUPPORTED      = 5, /*< nick=Unsupported >*/
     MBIM_CORE_ERROR_ABORTED          = 6, /*< nick=Aborted >*/
-    MBIM_CORE_ERROR_UNKNOWN_STATE    = 7  /*< nick=UnknownState >*/
+    MBIM_CORE_ERROR_UNKNOWN_STATE    = 7, /*< nick=UnknownState >*/
+    MBIM_CORE_ERROR_WOULD_BLOCK      = 8  /*< nick=WouldBlock >*/
 } MbimCoreError;
 
 /**
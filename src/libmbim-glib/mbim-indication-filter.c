@@ -0,0 +1,274 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+
+/*
+ * libmbim-glib -- GLib/GIO based library to control MBIM devices
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ *
+ * Copyright (C) 2026 agent <agent@local>
+ */
+
+#include <config.h>
+#include <string.h>
+
+#include "mbim-indication-filter.h"
+#include "mbim-timer-queue.h"
+
+typedef struct {
+    MbimIndicationFilter *filter;
+    MbimUuid              service_id;
+    guint32               cid;
+    MbimIndicationPolicy  policy;
+    guint                 interval_ms;
+    guint                 burst;
+
+    /* Token bucket, only used when rate limiting */
+    gdouble               tokens;
+    gint64                refill_time;
+
+    /* Latest indication held back, and the timer to emit it */
+    MbimMessage          *pending;
+    MbimTimerQueue       *timer_queue;
+    MbimTimer            *timer;
+} PolicyEntry;
+
+struct _MbimIndicationFilter {
+    GHashTable                   *entries;
+    MbimIndicationFilterEmitFunc  emit;
+    gpointer                      user_data;
+};
+
+/*****************************************************************************/
+
+static guint
+policy_entry_hash (const PolicyEntry *entry)
+{
+    guint32 hash;
+
+    memcpy (&hash, &entry->service_id, sizeof (hash));
+    return hash ^ entry->cid;
+}
+
+static gboolean
+policy_entry_equal (const PolicyEntry *a,
+                    const PolicyEntry *b)
+{
+    return (a->cid == b->cid && mbim_uuid_cmp (&a->service_id, &b->service_id));
+}
+
+static void
+policy_entry_timer_remove (PolicyEntry *entry)
+{
+    if (entry->timer) {
+        mbim_timer_queue_remove (entry->timer_queue, entry->timer);
+        entry->timer = NULL;
+    }
+    g_clear_pointer (&entry->timer_queue, mbim_timer_queue_unref);
+}
+
+static void
+policy_entry_free (PolicyEntry *entry)
+{
+    policy_entry_timer_remove (entry);
+    if (entry->pending)
+        mbim_message_unref (entry->pending);
+    g_slice_free (PolicyEntry, entry);
+}
+
+static void
+policy_entry_refill (PolicyEntry *entry,
+                     gint64       now)
+{
+    entry->tokens += (gdouble) (now - entry->refill_time) / (entry->interval_ms * 1000.0);
+    if (entry->tokens > entry->burst)
+        entry->tokens = entry->burst;
+    entry->refill_time = now;
+}
+
+static void
+policy_entry_timer_cb (PolicyEntry *entry)
+{
+    MbimIndicationFilter *filter;
+    MbimMessage          *message;
+
+    /* The timer handle is no longer valid once expired */
+    entry->timer = NULL;
+    g_clear_pointer (&entry->timer_queue, mbim_timer_queue_unref);
+
+    if (entry->policy == MBIM_INDICATION_POLICY_RATE_LIMIT) {
+        policy_entry_refill (entry, g_get_monotonic_time ());
+        entry->tokens = MAX (entry->tokens - 1, 0);
+    }
+
+    /* The entry may be gone after emitting */
+    filter = entry->filter;
+    message = g_steal_pointer (&entry->pending);
+    filter->emit (message, filter->user_data);
+    mbim_message_unref (message);
+}
+
+static void
+policy_entry_timer_add (PolicyEntry *entry,
+                        guint        timeout_ms)
+{
+    g_assert (!entry->timer);
+    entry->timer_queue = mbim_timer_queue_ref_for_context (g_main_context_get_thread_default ());
+    entry->timer = mbim_timer_queue_add (entry->timer_queue,
+                                         timeout_ms,
+                                         (MbimTimerFunc) policy_entry_timer_cb,
+                                         entry);
+}
+
+/*****************************************************************************/
+
+void
+mbim_indication_filter_set_policy (MbimIndicationFilter *self,
+                                   const MbimUuid       *service_id,
+                                   guint32               cid,
+                                   MbimIndicationPolicy  policy,
+                                   guint                 interval_ms,
+                                   guint                 burst)
+{
+    PolicyEntry  key;
+    PolicyEntry *entry;
+
+    memcpy (&key.service_id, service_id, sizeof (MbimUuid));
+    key.cid = cid;
+    entry = g_hash_table_lookup (self->entries, &key);
+
+    if (policy == MBIM_INDICATION_POLICY_NONE || !interval_ms) {
+        MbimMessage *message;
+
+        if (!entry)
+            return;
+
+        message = g_steal_pointer (&entry->pending);
+        g_hash_table_remove (self->entries, entry);
+        if (message) {
+            self->emit (message, self->user_data);
+            mbim_message_unref (message);
+        }
+        return;
+    }
+
+    if (!entry) {
+        entry = g_slice_new0 (PolicyEntry);
+        entry->filter = self;
+        memcpy (&entry->service_id, service_id, sizeof (MbimUuid));
+        entry->cid = cid;
+        g_hash_table_add (self->entries, entry);
+    }
+
+    /* Whatever is held back is emitted with the timer already running, if
+     * any; the new settings apply from the next indication */
+    entry->policy = policy;
+    entry->interval_ms = interval_ms;
+    entry->burst = MAX (burst, 1);
+    entry->tokens = entry->burst;
+    entry->refill_time = g_get_monotonic_time ();
+}
+
+gboolean
+mbim_indication_filter_process (MbimIndicationFilter *self,
+                                MbimMessage          *message)
+{
+    PolicyEntry  key;
+    PolicyEntry *entry;
+
+    if (!g_hash_table_size (self->entries))
+        return FALSE;
+
+    memcpy (&key.service_id, mbim_message_indicate_status_get_service_id (message), sizeof (MbimUuid));
+    key.cid = mbim_message_indicate_status_get_cid (message);
+    entry = g_hash_table_lookup (self->entries, &key);
+    if (!entry)
+        return FALSE;
+
+    /* Latest value wins: an indication already held back is just replaced,
+     * and emitted when the ongoing timer fires */
+    if (entry->pending) {
+        mbim_message_unref (entry->pending);
+        entry->pending = mbim_message_ref (message);
+        return TRUE;
+    }
+
+    switch (entry->policy) {
+    case MBIM_INDICATION_POLICY_COALESCE:
+        entry->pending = mbim_message_ref (message);
+        policy_entry_timer_add (entry, entry->interval_ms);
+        return TRUE;
+
+    case MBIM_INDICATION_POLICY_RATE_LIMIT:
+        policy_entry_refill (entry, g_get_monotonic_time ());
+        if (entry->tokens >= 1) {
+            entry->tokens -= 1;
+            return FALSE;
+        }
+        /* Wait until the next token is available */
+        entry->pending = mbim_message_ref (message);
+        policy_entry_timer_add (entry, (guint) ((1 - entry->tokens) * entry->interval_ms) + 1);
+        return TRUE;
+
+    case MBIM_INDICATION_POLICY_NONE:
+    default:
+        g_assert_not_reached ();
+    }
+}
+
+void
+mbim_indication_filter_flush (MbimIndicationFilter *self)
+{
+    GHashTableIter  iter;
+    PolicyEntry    *entry;
+    GList          *messages = NULL;
+    GList          *l;
+
+    /* Collect first, the entries may change while emitting */
+    g_hash_table_iter_init (&iter, self->entries);
+    while (g_hash_table_iter_next (&iter, (gpointer *) &entry, NULL)) {
+        if (!entry->pending)
+            continue;
+        policy_entry_timer_remove (entry);
+        messages = g_list_prepend (messages, g_steal_pointer (&entry->pending));
+    }
+
+    for (l = messages; l; l = g_list_next (l))
+        self->emit ((MbimMessage *) l->data, self->user_data);
+    g_list_free_full (messages, (GDestroyNotify) mbim_message_unref);
+}
+
+MbimIndicationFilter *
+mbim_indication_filter_new (MbimIndicationFilterEmitFunc emit,
+                            gpointer                     user_data)
+{
+    MbimIndicationFilter *self;
+
+    self = g_slice_new0 (MbimIndicationFilter);
+    self->entries = g_hash_table_new_full ((GHashFunc) policy_entry_hash,
+                                           (GEqualFunc) policy_entry_equal,
+                                           (GDestroyNotify) policy_entry_free,
+                                           NULL);
+    self->emit = emit;
+    self->user_data = user_data;
+    return self;
+}
+
+void
+mbim_indication_filter_free (MbimIndicationFilter *self)
+{
+    g_hash_table_unref (self->entries);
+    g_slice_free (MbimIndicationFilter, self);
+}
@@ -0,0 +1,82 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+
+/*
+ * libmbim-glib -- GLib/GIO based library to control MBIM devices
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ *
+ * Copyright (C) 2026 agent <agent@local>
+ */
+
+#ifndef _LIBMBIM_GLIB_MBIM_INDICATION_FILTER_H_
+#define _LIBMBIM_GLIB_MBIM_INDICATION_FILTER_H_
+
+#if !defined (LIBMBIM_GLIB_COMPILATION)
+#error "This is a private header!!"
+#endif
+
+#include <glib.h>
+
+#include "mbim-uuid.h"
+#include "mbim-message.h"
+#include "mbim-device.h"
+
+G_BEGIN_DECLS
+
+/*
+ * Per (service, cid) policies to coalesce or rate limit indications. An
+ * indication held back is always emitted eventually, unless replaced by a
+ * newer one of the same service and cid, so the most recent value is never
+ * lost.
+ *
+ * Timers run in the thread-default main context of the caller processing the
+ * indication.
+ */
+
+typedef struct _MbimIndicationFilter MbimIndicationFilter;
+
+typedef void (* MbimIndicationFilterEmitFunc) (MbimMessage *message,
+                                               gpointer     user_data);
+
+G_GNUC_INTERNAL
+MbimIndicationFilter *mbim_indication_filter_new        (MbimIndicationFilterEmitFunc  emit,
+                                                         gpointer                      user_data);
+G_GNUC_INTERNAL
+void                  mbim_indication_filter_free       (MbimIndicationFilter         *self);
+
+/* A policy of MBIM_INDICATION_POLICY_NONE removes the one set before, if any,
+ * emitting right away whatever was held back */
+G_GNUC_INTERNAL
+void                  mbim_indication_filter_set_policy (MbimIndicationFilter         *self,
+                                                         const MbimUuid               *service_id,
+                                                         guint32                       cid,
+                                                         MbimIndicationPolicy          policy,
+                                                         guint                         interval_ms,
+                                                         guint                         burst);
+
+/* Returns TRUE if the indication was held back, to be emitted later through
+ * the emit callback, or FALSE if the caller should emit it right away */
+G_GNUC_INTERNAL
+gboolean              mbim_indication_filter_process    (MbimIndicationFilter         *self,
+                                                         MbimMessage                  *message);
+
+/* Emits right away all the indications held back */
+G_GNUC_INTERNAL
+void                  mbim_indication_filter_flush      (MbimIndicationFilter         *self);
+
+G_END_DECLS
+
+#endif /* _LIBMBIM_GLIB_MBIM_INDICATION_FILTER_H_ */
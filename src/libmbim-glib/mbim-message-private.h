@@ -166,12 +166,34 @@ struct fragment_info *_mbim_message_split_fragments (const MbimMessage *self,
 /*****************************************************************************/
 /* Struct builder */
 
+/* The builder works in one of two modes:
+ *  - Growing the fixed and variable buffers while appending, and merging
+ *    them both on completion (fixed_buffer, variable_buffer, offsets).
+ *  - If the final sizes are precomputed with the _mbim_struct_builder_size_*()
+ *    methods, writing everything in place in a single preallocated buffer,
+ *    with the fixed part in [start, fixed_end) and the variable part in
+ *    [fixed_end, variable_end). */
 typedef struct {
     GByteArray  *fixed_buffer;
     GByteArray  *variable_buffer;
     GArray      *offsets;
+    /* Sized mode only */
+    GByteArray  *buffer;
+    guint32      start;
+    guint32      fixed_offset;
+    guint32      fixed_end;
+    guint32      variable_offset;
+    guint32      variable_end;
 } MbimStructBuilder;
 
+/* Used for nested structs: computes the fixed and variable sizes the struct
+ * requires (adding them to the given values), and writes it */
+typedef void (* MbimStructSizeFunc)  (gconstpointer      value,
+                                      guint32           *fixed_size,
+                                      guint32           *variable_size);
+typedef void (* MbimStructWriteFunc) (MbimStructBuilder *builder,
+                                      gconstpointer      value);
+
 MbimStructBuilder *_mbim_struct_builder_new                  (void);
 GByteArray        *_mbim_struct_builder_complete             (MbimStructBuilder *builder);
 void               _mbim_struct_builder_append_byte_array    (MbimStructBuilder *builder,
@@ -206,6 +228,57 @@ void               _mbim_struct_builder_append_ipv6          (MbimStructBuilder
 void               _mbim_struct_builder_append_ipv6_array    (MbimStructBuilder *builder,
                                                               const MbimIPv6    *values,
                                                               guint32            n_values);
+void               _mbim_struct_builder_append_struct        (MbimStructBuilder   *builder,
+                                                              MbimStructSizeFunc   size_func,
+                                                              MbimStructWriteFunc  write_func,
+                                                              gconstpointer        value);
+void               _mbim_struct_builder_append_struct_array  (MbimStructBuilder   *builder,
+                                                              MbimStructSizeFunc   size_func,
+                                                              MbimStructWriteFunc  write_func,
+                                                              const gconstpointer *values,
+                                                              guint32              n_values,
+                                                              gboolean             refs);
+
+/* Sizes required by each of the append methods above; all of them add to the
+ * given fixed and variable sizes. Fixed-size types (uuid, guint32, guint64)
+ * just take sizeof() in the fixed buffer. */
+void               _mbim_struct_builder_size_byte_array      (gboolean            with_offset,
+                                                              gboolean            with_length,
+                                                              gboolean            pad_buffer,
+                                                              guint32             buffer_len,
+                                                              guint32            *fixed_size,
+                                                              guint32            *variable_size);
+void               _mbim_struct_builder_size_string          (const gchar        *value,
+                                                              guint32            *fixed_size,
+                                                              guint32            *variable_size);
+void               _mbim_struct_builder_size_string_array    (const gchar *const *values,
+                                                              guint32             n_values,
+                                                              guint32            *fixed_size,
+                                                              guint32            *variable_size);
+void               _mbim_struct_builder_size_ipv4            (const MbimIPv4     *value,
+                                                              gboolean            ref,
+                                                              guint32            *fixed_size,
+                                                              guint32            *variable_size);
+void               _mbim_struct_builder_size_ipv4_array      (guint32             n_values,
+                                                              guint32            *fixed_size,
+                                                              guint32            *variable_size);
+void               _mbim_struct_builder_size_ipv6            (const MbimIPv6     *value,
+                                                              gboolean            ref,
+                                                              guint32            *fixed_size,
+                                                              guint32            *variable_size);
+void               _mbim_struct_builder_size_ipv6_array      (guint32             n_values,
+                                                              guint32            *fixed_size,
+                                                              guint32            *variable_size);
+void               _mbim_struct_builder_size_struct          (MbimStructSizeFunc  size_func,
+                                                              gconstpointer       value,
+                                                              guint32            *fixed_size,
+                                                              guint32            *variable_size);
+void               _mbim_struct_builder_size_struct_array    (MbimStructSizeFunc   size_func,
+                                                              const gconstpointer *values,
+                                                              guint32              n_values,
+                                                              gboolean             refs,
+                                                              guint32             *fixed_size,
+                                                              guint32             *variable_size);
 
 /*****************************************************************************/
 /* Message builder */
@@ -219,6 +292,12 @@ MbimMessageCommandBuilder *_mbim_message_command_builder_new                  (g
                                                                                MbimService                service,
                                                                                guint32                    cid,
                                                                                MbimMessageCommandType     command_type);
+MbimMessageCommandBuilder *_mbim_message_command_builder_new_sized            (guint32                    transaction_id,
+                                                                               MbimService                service,
+                                                                               guint32                    cid,
+                                                                               MbimMessageCommandType     command_type,
+                                                                               guint32                    fixed_size,
+                                                                               guint32                    variable_size);
 MbimMessage               *_mbim_message_command_builder_complete             (MbimMessageCommandBuilder *builder);
 void                       _mbim_message_command_builder_append_byte_array    (MbimMessageCommandBuilder *builder,
                                                                                gboolean                   with_offset,
@@ -252,10 +331,81 @@ void                       _mbim_message_command_builder_append_ipv6          (M
 void                       _mbim_message_command_builder_append_ipv6_array    (MbimMessageCommandBuilder *builder,
                                                                                const MbimIPv6            *values,
                                                                                guint32                    n_values);
+void                       _mbim_message_command_builder_append_struct        (MbimMessageCommandBuilder *builder,
+                                                                               MbimStructSizeFunc         size_func,
+                                                                               MbimStructWriteFunc        write_func,
+                                                                               gconstpointer              value);
+void                       _mbim_message_command_builder_append_struct_array  (MbimMessageCommandBuilder *builder,
+                                                                               MbimStructSizeFunc         size_func,
+                                                                               MbimStructWriteFunc        write_func,
+                                                                               const gconstpointer       *values,
+                                                                               guint32                    n_values,
+                                                                               gboolean                   refs);
+
+/*****************************************************************************/
+/* Arena where parsed struct arrays are allocated, when one is the thread
+ * default */
+
+/* All allocation methods fall back to the plain GLib allocator if no arena
+ * is given */
+MbimArena *_mbim_arena_get_thread_default (void);
+void       _mbim_arena_reserve            (MbimArena     *arena,
+                                           gsize          size);
+gpointer   _mbim_arena_alloc              (MbimArena     *arena,
+                                           gsize          size);
+gpointer   _mbim_arena_alloc0             (MbimArena     *arena,
+                                           gsize          size);
+gpointer   _mbim_arena_alloc0_n           (MbimArena     *arena,
+                                           gsize          n_blocks,
+                                           gsize          block_size);
+gpointer   _mbim_arena_memdup             (MbimArena     *arena,
+                                           gconstpointer  mem,
+                                           gsize          size);
+
+/* Fails if the given number of array elements, each taking at least the given
+ * size, doesn't fit in the information buffer of the message */
+gboolean _mbim_message_check_array_size (const MbimMessage  *self,
+                                         guint32             array_size,
+                                         gsize               element_size,
+                                         GError            **error);
+
+/* Validates the size of a struct array, and gets the thread default arena
+ * with enough space reserved for it, or NULL if there is none */
+gboolean _mbim_message_struct_array_prepare (const MbimMessage  *self,
+                                             guint32             array_size,
+                                             gsize               element_size,
+                                             gsize               struct_size,
+                                             MbimArena         **arena,
+                                             GError            **error);
+
+/*****************************************************************************/
+/* Struct array iterators */
+
+/* The struct type is an opaque tag unique to each struct type, so that the
+ * iterator accessors of one type can't be used with arrays of another one */
+gboolean _mbim_struct_array_iter_init        (MbimStructArrayIter  *iter,
+                                              const MbimMessage    *message,
+                                              gconstpointer         struct_type,
+                                              guint32               n_elements,
+                                              guint32               relative_offset_array_start,
+                                              gboolean              refs,
+                                              guint32               struct_size,
+                                              GError              **error);
+gboolean _mbim_struct_array_iter_get_element (const MbimStructArrayIter  *iter,
+                                              gconstpointer              struct_type,
+                                              const MbimMessage        **message,
+                                              guint32                   *element_offset);
 
 /*****************************************************************************/
 /* Message parser */
 
+gboolean      _mbim_message_check_information_buffer (const MbimMessage  *self,
+                                                      MbimMessageType     message_type,
+                                                      GError            **error);
+const guint8 *_mbim_message_read_fixed_prefix        (const MbimMessage  *self,
+                                                      guint32             size,
+                                                      GError            **error);
+
 gboolean _mbim_message_read_byte_array    (const MbimMessage  *self,
                                            guint32             struct_start_offset,
                                            guint32             relative_offset,
@@ -278,6 +428,12 @@ gboolean _mbim_message_read_guint32_array (const MbimMessage  *self,
                                            guint32             relative_offset_array_start,
                                            guint32           **array,
                                            GError            **error);
+gboolean _mbim_message_read_guint32_array_full (const MbimMessage  *self,
+                                                guint32             array_size,
+                                                guint32             relative_offset_array_start,
+                                                MbimArena          *arena,
+                                                guint32           **array,
+                                                GError            **error);
 gboolean _mbim_message_read_guint64       (const MbimMessage  *self,
                                            guint64             relative_offset,
                                            guint64            *value,
@@ -287,12 +443,25 @@ gboolean _mbim_message_read_string        (const MbimMessage  *self,
                                            guint32             relative_offset,
                                            gchar             **str,
                                            GError            **error);
+gboolean _mbim_message_read_string_full   (const MbimMessage  *self,
+                                           guint32             struct_start_offset,
+                                           guint32             relative_offset,
+                                           MbimArena          *arena,
+                                           gchar             **str,
+                                           GError            **error);
 gboolean _mbim_message_read_string_array  (const MbimMessage   *self,
                                            guint32              array_size,
                                            guint32              struct_start_offset,
                                            guint32              relative_offset_array_start,
                                            gchar             ***array,
                                            GError             **error);
+gboolean _mbim_message_read_string_array_full (const MbimMessage   *self,
+                                               guint32              array_size,
+                                               guint32              struct_start_offset,
+                                               guint32              relative_offset_array_start,
+                                               MbimArena           *arena,
+                                               gchar             ***array,
+                                               GError             **error);
 gboolean _mbim_message_read_ipv4          (const MbimMessage  *self,
                                            guint32             relative_offset,
                                            gboolean            ref,
@@ -314,6 +483,87 @@ gboolean _mbim_message_read_ipv6_array    (const MbimMessage  *self,
                                            MbimIPv6          **array,
                                            GError            **error);
 
+/*****************************************************************************/
+/* Message printable
+ *
+ * Instead of one printable method per message, the generated code describes
+ * the fields of each message in a constant table, which is interpreted by one
+ * single shared method. */
+
+typedef enum {
+    MBIM_FIELD_FORMAT_GUINT32,
+    MBIM_FIELD_FORMAT_GUINT64,
+    MBIM_FIELD_FORMAT_UUID,
+    MBIM_FIELD_FORMAT_STRING,
+    MBIM_FIELD_FORMAT_STRING_ARRAY,
+    MBIM_FIELD_FORMAT_BYTE_ARRAY,
+    MBIM_FIELD_FORMAT_UNSIZED_BYTE_ARRAY,
+    MBIM_FIELD_FORMAT_REF_BYTE_ARRAY,
+    MBIM_FIELD_FORMAT_REF_BYTE_ARRAY_NO_OFFSET,
+    MBIM_FIELD_FORMAT_STRUCT,
+    MBIM_FIELD_FORMAT_STRUCT_ARRAY,
+    MBIM_FIELD_FORMAT_REF_STRUCT_ARRAY,
+    MBIM_FIELD_FORMAT_IPV4,
+    MBIM_FIELD_FORMAT_REF_IPV4,
+    MBIM_FIELD_FORMAT_IPV4_ARRAY,
+    MBIM_FIELD_FORMAT_IPV6,
+    MBIM_FIELD_FORMAT_REF_IPV6,
+    MBIM_FIELD_FORMAT_IPV6_ARRAY,
+} MbimFieldFormat;
+
+typedef const gchar *(* MbimFieldEnumGetStringFunc)    (guint value);
+typedef gchar       *(* MbimFieldFlagsBuildStringFunc) (guint value);
+
+typedef gpointer (* MbimStructReadFunc)      (const MbimMessage *self,
+                                              guint32            relative_offset,
+                                              MbimArena         *arena,
+                                              guint32           *bytes_read,
+                                              GError           **error);
+typedef gboolean (* MbimStructArrayReadFunc) (const MbimMessage *self,
+                                              guint32            array_size,
+                                              guint32            relative_offset_array_start,
+                                              gboolean           refs,
+                                              gpointer         **out_array,
+                                              GError           **error);
+typedef void     (* MbimStructPrintFunc)     (gconstpointer      value,
+                                              GString           *str,
+                                              const gchar       *line_prefix,
+                                              const gchar       *indent);
+
+/* One per struct type, with whatever methods are generated for it */
+typedef struct {
+    MbimStructReadFunc       read;
+    MbimStructArrayReadFunc  read_array;
+    MbimStructPrintFunc      print;
+    GDestroyNotify           free;
+    GDestroyNotify           array_free;
+} MbimStructDescriptor;
+
+typedef struct {
+    const gchar                   *name;
+    MbimFieldFormat                format;
+    /* Index of the guint32 field giving the number of items in arrays */
+    gint                           array_size_field;
+    /* Index of the guint32 field that must be equal to the given value for
+     * this field to be available, or -1 if always available */
+    gint                           condition_field;
+    guint32                        condition_value;
+    /* Number of bytes in fixed-size byte arrays */
+    guint32                        array_size;
+    /* Only for guint32 and guint64 values given as enums or flags */
+    MbimFieldEnumGetStringFunc     enum_get_string;
+    MbimFieldFlagsBuildStringFunc  flags_build_string;
+    /* Only for structs and struct arrays */
+    const MbimStructDescriptor    *struct_descriptor;
+} MbimFieldDescriptor;
+
+gboolean _mbim_message_print_fields (const MbimMessage         *self,
+                                     const MbimFieldDescriptor *fields,
+                                     guint                      n_fields,
+                                     GString                   *str,
+                                     const gchar               *line_prefix,
+                                     GError                   **error);
+
 G_END_DECLS
 
 #endif /* _LIBMBIM_GLIB_MBIM_MESSAGE_PRIVATE_H_ */
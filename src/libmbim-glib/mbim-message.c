@@ -51,22 +51,6 @@
 
 /*****************************************************************************/
 
-static void
-bytearray_apply_padding (GByteArray *buffer,
-                         guint32    *len)
-{
-    static const guint8 padding = 0;
-
-    g_assert (buffer);
-    g_assert (len);
-
-    /* Apply padding to the requested length until multiple of 4 */
-    while (*len % 4 != 0) {
-        g_byte_array_append (buffer, &padding, 1);
-        (*len)++;
-    }
-}
-
 static void
 set_error_from_status (GError          **error,
                        MbimStatusError   status)
@@ -106,6 +90,149 @@ mbim_message_get_type (void)
     return g_define_type_id__volatile;
 }
 
+/*****************************************************************************/
+/* Arenas */
+
+#define ARENA_ALIGN(size) (((size) + 7) & ~((gsize) 7))
+
+/* Minimum size of each chunk; a chunk is only ever larger if reserved so */
+#define ARENA_CHUNK_SIZE_MIN 1024
+
+typedef struct _MbimArenaChunk MbimArenaChunk;
+
+struct _MbimArenaChunk {
+    MbimArenaChunk *next;
+};
+
+struct _MbimArena {
+    guint8         *next;
+    guint8         *end;
+    MbimArenaChunk *chunks;
+    /* Arena that was the thread default before this one was pushed */
+    MbimArena      *prev;
+};
+
+static GPrivate thread_default_arena = G_PRIVATE_INIT (NULL);
+
+MbimArena *
+mbim_arena_new (void)
+{
+    return g_slice_new0 (MbimArena);
+}
+
+void
+mbim_arena_free (MbimArena *arena)
+{
+    g_return_if_fail (arena != NULL);
+
+    while (arena->chunks) {
+        MbimArenaChunk *next;
+
+        next = arena->chunks->next;
+        g_free (arena->chunks);
+        arena->chunks = next;
+    }
+    g_slice_free (MbimArena, arena);
+}
+
+void
+mbim_arena_push_thread_default (MbimArena *arena)
+{
+    g_return_if_fail (arena != NULL);
+    g_return_if_fail (arena->prev == NULL);
+
+    arena->prev = g_private_get (&thread_default_arena);
+    g_private_set (&thread_default_arena, arena);
+}
+
+void
+mbim_arena_pop_thread_default (MbimArena *arena)
+{
+    g_return_if_fail (arena != NULL);
+    g_return_if_fail (g_private_get (&thread_default_arena) == arena);
+
+    g_private_set (&thread_default_arena, arena->prev);
+    arena->prev = NULL;
+}
+
+MbimArena *
+_mbim_arena_get_thread_default (void)
+{
+    return g_private_get (&thread_default_arena);
+}
+
+void
+_mbim_arena_reserve (MbimArena *arena,
+                     gsize      size)
+{
+    MbimArenaChunk *chunk;
+    gsize           chunk_size;
+
+    if (G_UNLIKELY (size > G_MAXSIZE - ARENA_CHUNK_SIZE_MIN))
+        g_error ("%s: overflow reserving %" G_GSIZE_FORMAT " bytes", G_STRLOC, size);
+
+    size = ARENA_ALIGN (size);
+    if ((gsize) (arena->end - arena->next) >= size)
+        return;
+
+    /* Whatever is left in the current chunk is wasted */
+    chunk_size = MAX (size, ARENA_CHUNK_SIZE_MIN);
+    chunk = g_malloc (ARENA_ALIGN (sizeof (MbimArenaChunk)) + chunk_size);
+    chunk->next = arena->chunks;
+    arena->chunks = chunk;
+    arena->next = (guint8 *) chunk + ARENA_ALIGN (sizeof (MbimArenaChunk));
+    arena->end = arena->next + chunk_size;
+}
+
+gpointer
+_mbim_arena_alloc (MbimArena *arena,
+                   gsize      size)
+{
+    gpointer mem;
+
+    if (!arena)
+        return g_malloc (size);
+
+    _mbim_arena_reserve (arena, size);
+    mem = arena->next;
+    arena->next += ARENA_ALIGN (size);
+    return mem;
+}
+
+gpointer
+_mbim_arena_alloc0 (MbimArena *arena,
+                    gsize      size)
+{
+    if (!arena)
+        return g_malloc0 (size);
+    return memset (_mbim_arena_alloc (arena, size), 0, size);
+}
+
+gpointer
+_mbim_arena_alloc0_n (MbimArena *arena,
+                      gsize      n_blocks,
+                      gsize      block_size)
+{
+    gsize size;
+
+    /* Same as g_malloc0_n(), abort on overflow */
+    if (!g_size_checked_mul (&size, n_blocks, block_size))
+        g_error ("%s: overflow allocating %" G_GSIZE_FORMAT "*%" G_GSIZE_FORMAT " bytes",
+                 G_STRLOC, n_blocks, block_size);
+    return _mbim_arena_alloc0 (arena, size);
+}
+
+gpointer
+_mbim_arena_memdup (MbimArena     *arena,
+                    gconstpointer  mem,
+                    gsize          size)
+{
+    /* Same as g_malloc(), no memory for empty contents */
+    if (!size)
+        return NULL;
+    return memcpy (_mbim_arena_alloc (arena, size), mem, size);
+}
+
 /*****************************************************************************/
 
 GByteArray *
@@ -164,6 +291,236 @@ _mbim_message_get_information_buffer_offset (const MbimMessage *self)
     }
 }
 
+gboolean
+_mbim_message_check_array_size (const MbimMessage  *self,
+                                guint32             array_size,
+                                gsize               element_size,
+                                GError            **error)
+{
+    guint32 information_buffer_offset;
+    gsize   available;
+    gsize   required;
+
+    information_buffer_offset = _mbim_message_get_information_buffer_offset (self);
+    available = (self->len > information_buffer_offset) ? (self->len - information_buffer_offset) : 0;
+
+    /* Every element takes at least the given size in the information buffer,
+     * so the number of elements reported by the device is bounded by the
+     * message length, and so are the sizes computed from it afterwards */
+    if (!g_size_checked_mul (&required, array_size, MAX (element_size, 1)) || (required > available)) {
+        g_set_error (error, MBIM_CORE_ERROR, MBIM_CORE_ERROR_INVALID_MESSAGE,
+                     "cannot read array of %u elements of at least %" G_GSIZE_FORMAT " bytes (%" G_GSIZE_FORMAT " bytes available)",
+                     array_size, element_size, available);
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+gboolean
+_mbim_message_struct_array_prepare (const MbimMessage  *self,
+                                    guint32             array_size,
+                                    gsize               element_size,
+                                    gsize               struct_size,
+                                    MbimArena         **arena,
+                                    GError            **error)
+{
+    gsize pointers_size;
+    gsize structs_size;
+    gsize reserve_size;
+
+    if (!_mbim_message_check_array_size (self, array_size, element_size, error))
+        return FALSE;
+
+    *arena = _mbim_arena_get_thread_default ();
+    if (!*arena)
+        return TRUE;
+
+    /* Reserve the pointer array and all the structs in one single chunk. The
+     * variable contents of the structs (strings, byte arrays...) are never
+     * larger than the message itself, except for non-ASCII strings growing
+     * when converted to UTF-8; those may need an additional chunk */
+    if (!g_size_checked_add (&pointers_size, array_size, 1) ||
+        !g_size_checked_mul (&pointers_size, pointers_size, sizeof (gpointer)) ||
+        !g_size_checked_mul (&structs_size, array_size, ARENA_ALIGN (struct_size)) ||
+        !g_size_checked_add (&reserve_size, pointers_size, structs_size) ||
+        !g_size_checked_add (&reserve_size, reserve_size, self->len)) {
+        g_set_error (error, MBIM_CORE_ERROR, MBIM_CORE_ERROR_INVALID_MESSAGE,
+                     "cannot read array of %u elements: size overflow", array_size);
+        return FALSE;
+    }
+
+    _mbim_arena_reserve (*arena, reserve_size);
+    return TRUE;
+}
+
+gboolean
+_mbim_message_check_information_buffer (const MbimMessage  *self,
+                                        MbimMessageType     message_type,
+                                        GError            **error)
+{
+    g_assert (message_type == MBIM_MESSAGE_TYPE_COMMAND_DONE ||
+              message_type == MBIM_MESSAGE_TYPE_INDICATE_STATUS);
+
+    if (MBIM_MESSAGE_GET_MESSAGE_TYPE (self) != message_type) {
+        g_set_error (error, MBIM_CORE_ERROR, MBIM_CORE_ERROR_INVALID_MESSAGE,
+                     "Message is not a %s",
+                     message_type == MBIM_MESSAGE_TYPE_COMMAND_DONE ? "response" : "notification");
+        return FALSE;
+    }
+
+    if ((message_type == MBIM_MESSAGE_TYPE_COMMAND_DONE &&
+         !mbim_message_command_done_get_raw_information_buffer (self, NULL)) ||
+        (message_type == MBIM_MESSAGE_TYPE_INDICATE_STATUS &&
+         !mbim_message_indicate_status_get_raw_information_buffer (self, NULL))) {
+        g_set_error (error, MBIM_CORE_ERROR, MBIM_CORE_ERROR_INVALID_MESSAGE,
+                     "Message does not have information buffer");
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+const guint8 *
+_mbim_message_read_fixed_prefix (const MbimMessage  *self,
+                                 guint32             size,
+                                 GError            **error)
+{
+    guint32 required_size;
+    guint32 information_buffer_offset;
+
+    information_buffer_offset = _mbim_message_get_information_buffer_offset (self);
+
+    required_size = information_buffer_offset + size;
+    if (self->len < required_size) {
+        g_set_error (error, MBIM_CORE_ERROR, MBIM_CORE_ERROR_INVALID_MESSAGE,
+                     "cannot read fixed-size fields (%u bytes) (%u < %u)",
+                     size, self->len, required_size);
+        return NULL;
+    }
+
+    return (const guint8 *) G_STRUCT_MEMBER_P (self->data, information_buffer_offset);
+}
+
+/*****************************************************************************/
+/* Struct array iterators */
+
+typedef struct {
+    const MbimMessage *message;
+    gconstpointer      struct_type;
+    guint32            n_elements;
+    guint32            next_index;
+    guint32            array_offset;
+    guint32            element_offset;
+    guint32            struct_size;
+    gboolean           refs;
+    gboolean           valid;
+} RealStructArrayIter;
+
+G_STATIC_ASSERT (sizeof (MbimStructArrayIter) >= sizeof (RealStructArrayIter));
+
+gboolean
+_mbim_struct_array_iter_init (MbimStructArrayIter  *iter,
+                              const MbimMessage    *message,
+                              gconstpointer         struct_type,
+                              guint32               n_elements,
+                              guint32               relative_offset_array_start,
+                              gboolean              refs,
+                              guint32               struct_size,
+                              GError              **error)
+{
+    RealStructArrayIter *ri = (RealStructArrayIter *) iter;
+
+    memset (ri, 0, sizeof (RealStructArrayIter));
+
+    /* Each element takes at least its fixed size, or its offset/size pair */
+    if (!_mbim_message_check_array_size (message, n_elements, refs ? 8 : struct_size, error))
+        return FALSE;
+
+    /* Arrays without refs are given as an offset to the first element */
+    ri->array_offset = relative_offset_array_start;
+    if (!refs && n_elements && !_mbim_message_read_guint32 (message, relative_offset_array_start, &ri->array_offset, error))
+        return FALSE;
+
+    ri->message = message;
+    ri->struct_type = struct_type;
+    ri->n_elements = n_elements;
+    ri->struct_size = struct_size;
+    ri->refs = refs;
+    return TRUE;
+}
+
+gboolean
+_mbim_struct_array_iter_get_element (const MbimStructArrayIter  *iter,
+                                     gconstpointer              struct_type,
+                                     const MbimMessage        **message,
+                                     guint32                   *element_offset)
+{
+    const RealStructArrayIter *ri = (const RealStructArrayIter *) iter;
+
+    g_return_val_if_fail (iter != NULL, FALSE);
+    g_return_val_if_fail (ri->struct_type == struct_type, FALSE);
+    g_return_val_if_fail (ri->valid, FALSE);
+
+    *message = ri->message;
+    *element_offset = ri->element_offset;
+    return TRUE;
+}
+
+guint32
+mbim_struct_array_iter_get_n_elements (const MbimStructArrayIter *iter)
+{
+    g_return_val_if_fail (iter != NULL, 0);
+
+    return ((const RealStructArrayIter *) iter)->n_elements;
+}
+
+gboolean
+mbim_struct_array_iter_next (MbimStructArrayIter  *iter,
+                             GError              **error)
+{
+    RealStructArrayIter *ri = (RealStructArrayIter *) iter;
+    guint32              information_buffer_offset;
+    guint64              available;
+    guint32              offset;
+    guint32              size;
+
+    g_return_val_if_fail (iter != NULL, FALSE);
+    g_return_val_if_fail (ri->message != NULL, FALSE);
+
+    ri->valid = FALSE;
+    if (ri->next_index >= ri->n_elements)
+        return FALSE;
+
+    /* The array size was already validated against the message length, so
+     * the location of the element within the array doesn't overflow */
+    if (ri->refs) {
+        guint32 pair_offset;
+
+        pair_offset = ri->array_offset + (8 * ri->next_index);
+        if (!_mbim_message_read_guint32 (ri->message, pair_offset, &offset, error) ||
+            !_mbim_message_read_guint32 (ri->message, pair_offset + 4, &size, error))
+            return FALSE;
+    } else {
+        offset = ri->array_offset + (ri->struct_size * ri->next_index);
+        size = ri->struct_size;
+    }
+
+    information_buffer_offset = _mbim_message_get_information_buffer_offset (ri->message);
+    available = (ri->message->len > information_buffer_offset) ? (ri->message->len - information_buffer_offset) : 0;
+    if ((guint64) offset + (guint64) size > available) {
+        g_set_error (error, MBIM_CORE_ERROR, MBIM_CORE_ERROR_INVALID_MESSAGE,
+                     "cannot read struct array element %u (%u bytes at offset %u) (%" G_GUINT64_FORMAT " bytes available)",
+                     ri->next_index, size, offset, available);
+        return FALSE;
+    }
+
+    ri->element_offset = offset;
+    ri->next_index++;
+    ri->valid = TRUE;
+    return TRUE;
+}
+
 gboolean
 _mbim_message_read_guint32 (const MbimMessage  *self,
                             guint32             relative_offset,
@@ -198,6 +555,17 @@ _mbim_message_read_guint32_array (const MbimMessage  *self,
                                   guint32             relative_offset_array_start,
                                   guint32           **array,
                                   GError            **error)
+{
+    return _mbim_message_read_guint32_array_full (self, array_size, relative_offset_array_start, NULL, array, error);
+}
+
+gboolean
+_mbim_message_read_guint32_array_full (const MbimMessage  *self,
+                                       guint32             array_size,
+                                       guint32             relative_offset_array_start,
+                                       MbimArena          *arena,
+                                       guint32           **array,
+                                       GError            **error)
 {
     guint32 required_size;
     guint   i;
@@ -210,6 +578,9 @@ _mbim_message_read_guint32_array (const MbimMessage  *self,
         return TRUE;
     }
 
+    if (!_mbim_message_check_array_size (self, array_size, 4, error))
+        return FALSE;
+
     information_buffer_offset = _mbim_message_get_information_buffer_offset (self);
 
     required_size = information_buffer_offset + relative_offset_array_start + (4 * array_size);
@@ -220,7 +591,7 @@ _mbim_message_read_guint32_array (const MbimMessage  *self,
         return FALSE;
     }
 
-    *array = g_new (guint32, array_size + 1);
+    *array = _mbim_arena_alloc0_n (arena, (gsize) array_size + 1, sizeof (guint32));
     for (i = 0; i < array_size; i++) {
         (*array)[i] = GUINT32_FROM_LE (G_STRUCT_MEMBER (
                                            guint32,
@@ -261,12 +632,64 @@ _mbim_message_read_guint64 (const MbimMessage  *self,
     return TRUE;
 }
 
+/* Most strings exchanged with the device (provider ids, IMSI, ICCID, APNs...)
+ * are plain ASCII, which in UTF-16LE means every odd byte is 0 and every even
+ * byte is below 0x80. Those are narrowed directly from the message buffer, so
+ * no byteswapped copy or full UTF-16 decoding is required. Returns NULL if
+ * the string isn't pure ASCII. */
+static gchar *
+utf16le_ascii_to_utf8 (MbimArena    *arena,
+                       const guint8 *data,
+                       guint32       n_chars)
+{
+    static const guint8  non_ascii_mask_bytes[8] = { 0x80, 0xFF, 0x80, 0xFF, 0x80, 0xFF, 0x80, 0xFF };
+    guint64              non_ascii_mask;
+    guint32              n_bytes;
+    guint32              i;
+    gchar               *str;
+
+    n_bytes = n_chars * 2;
+
+    /* Check 4 characters at a time, the mask is built from bytes so that it
+     * applies the same way regardless of the host byte order */
+    memcpy (&non_ascii_mask, non_ascii_mask_bytes, sizeof (non_ascii_mask));
+    for (i = 0; i + 8 <= n_bytes; i += 8) {
+        guint64 chunk;
+
+        memcpy (&chunk, &data[i], sizeof (chunk));
+        if (chunk & non_ascii_mask)
+            return NULL;
+    }
+    for (; i < n_bytes; i += 2) {
+        if ((data[i] & 0x80) || data[i + 1])
+            return NULL;
+    }
+
+    /* Like g_utf16_to_utf8(), stop at the first NUL */
+    str = _mbim_arena_alloc (arena, n_chars + 1);
+    for (i = 0; i < n_chars && data[2 * i]; i++)
+        str[i] = (gchar) data[2 * i];
+    str[i] = '\0';
+    return str;
+}
+
 gboolean
 _mbim_message_read_string (const MbimMessage  *self,
                            guint32             struct_start_offset,
                            guint32             relative_offset,
                            gchar             **str,
                            GError            **error)
+{
+    return _mbim_message_read_string_full (self, struct_start_offset, relative_offset, NULL, str, error);
+}
+
+gboolean
+_mbim_message_read_string_full (const MbimMessage  *self,
+                                guint32             struct_start_offset,
+                                guint32             relative_offset,
+                                MbimArena          *arena,
+                                gchar             **str,
+                                GError            **error)
 {
     guint32               required_size;
     guint32               offset;
@@ -308,6 +731,10 @@ _mbim_message_read_string (const MbimMessage  *self,
 
     utf16 = (const gunichar2 *) G_STRUCT_MEMBER_P (self->data, (information_buffer_offset + struct_start_offset + offset));
 
+    *str = utf16le_ascii_to_utf8 (arena, (const guint8 *) utf16, size / 2);
+    if (*str)
+        return TRUE;
+
     /* For BE systems, convert from LE to BE */
     if (G_BYTE_ORDER == G_BIG_ENDIAN) {
         guint i;
@@ -328,6 +755,14 @@ _mbim_message_read_string (const MbimMessage  *self,
         return FALSE;
     }
 
+    if (arena) {
+        gchar *tmp;
+
+        tmp = *str;
+        *str = _mbim_arena_memdup (arena, tmp, strlen (tmp) + 1);
+        g_free (tmp);
+    }
+
     return TRUE;
 }
 
@@ -338,6 +773,18 @@ _mbim_message_read_string_array (const MbimMessage   *self,
                                  guint32              relative_offset_array_start,
                                  gchar             ***array,
                                  GError             **error)
+{
+    return _mbim_message_read_string_array_full (self, array_size, struct_start_offset, relative_offset_array_start, NULL, array, error);
+}
+
+gboolean
+_mbim_message_read_string_array_full (const MbimMessage   *self,
+                                      guint32              array_size,
+                                      guint32              struct_start_offset,
+                                      guint32              relative_offset_array_start,
+                                      MbimArena           *arena,
+                                      gchar             ***array,
+                                      GError             **error)
 {
     guint32  offset;
     guint32  i;
@@ -350,17 +797,22 @@ _mbim_message_read_string_array (const MbimMessage   *self,
         return TRUE;
     }
 
-    *array = g_new0 (gchar *, array_size + 1);
+    /* Each string takes at least its offset/size pair */
+    if (!_mbim_message_check_array_size (self, array_size, 8, error))
+        return FALSE;
+
+    *array = _mbim_arena_alloc0_n (arena, (gsize) array_size + 1, sizeof (gchar *));
     for (i = 0, offset = relative_offset_array_start;
          i < array_size;
          offset += 8, i++) {
         /* Read next string in the OL pair list */
-        if (!_mbim_message_read_string (self, struct_start_offset, offset, &((*array)[i]), &inner_error))
+        if (!_mbim_message_read_string_full (self, struct_start_offset, offset, arena, &((*array)[i]), &inner_error))
             break;
     }
 
     if (inner_error) {
-        g_strfreev (*array);
+        if (!arena)
+            g_strfreev (*array);
         g_propagate_error (error, inner_error);
         return FALSE;
     }
@@ -756,57 +1208,472 @@ _mbim_message_read_ipv6_array (const MbimMessage  *self,
     return TRUE;
 }
 
+/*****************************************************************************/
+/* Message printable */
+
+static void
+print_byte_array (GString      *str,
+                  const guint8 *array,
+                  guint32       array_size)
+{
+    static const gchar hex_digits[] = "0123456789abcdef";
+    guint32            i;
+
+    g_string_append_c (str, '\'');
+    for (i = 0; i < array_size; i++) {
+        if (i > 0)
+            g_string_append_c (str, ':');
+        g_string_append_c (str, hex_digits[array[i] >> 4]);
+        g_string_append_c (str, hex_digits[array[i] & 0x0F]);
+    }
+    g_string_append_c (str, '\'');
+}
+
+static void
+print_ip_array (GString        *str,
+                const guint8   *array,
+                guint32         array_size,
+                GSocketFamily   family)
+{
+    gsize   addr_size;
+    guint32 i;
+
+    addr_size = (family == G_SOCKET_FAMILY_IPV4 ? 4 : 16);
+
+    g_string_append (str, "'");
+    for (i = 0; array && i < array_size; i++) {
+        g_autoptr(GInetAddress)  addr = NULL;
+        g_autofree gchar        *tmpstr = NULL;
+
+        addr = g_inet_address_new_from_bytes (&array[i * addr_size], family);
+        tmpstr = g_inet_address_to_string (addr);
+        g_string_append_printf (str, "%s", tmpstr);
+        if (i < (array_size - 1))
+            g_string_append (str, ", ");
+    }
+    g_string_append (str, "'");
+}
+
+static void
+print_value (GString                   *str,
+             const MbimFieldDescriptor *field,
+             guint64                    value)
+{
+    if (field->enum_get_string)
+        g_string_append_printf (str, "'%s'", field->enum_get_string ((guint) value));
+    else if (field->flags_build_string) {
+        g_autofree gchar *tmpstr = NULL;
+
+        tmpstr = field->flags_build_string ((guint) value);
+        g_string_append_printf (str, "'%s'", tmpstr);
+    } else if (field->format == MBIM_FIELD_FORMAT_GUINT64)
+        g_string_append_printf (str, "'%" G_GUINT64_FORMAT "'", value);
+    else
+        g_string_append_printf (str, "'%" G_GUINT32_FORMAT "'", (guint32) value);
+}
+
+static gboolean
+print_field (const MbimMessage          *self,
+             const MbimFieldDescriptor  *field,
+             const guint32              *values,
+             guint32                    *value,
+             guint32                    *offset,
+             GString                    *str,
+             const gchar                *line_prefix,
+             GError                    **error)
+{
+    guint32 array_size = 0;
+
+    if (field->array_size_field >= 0)
+        array_size = values[field->array_size_field];
+
+    switch (field->format) {
+    case MBIM_FIELD_FORMAT_GUINT32:
+        if (!_mbim_message_read_guint32 (self, *offset, value, error))
+            return FALSE;
+        *offset += 4;
+        print_value (str, field, *value);
+        return TRUE;
+
+    case MBIM_FIELD_FORMAT_GUINT64: {
+        guint64 tmp;
+
+        if (!_mbim_message_read_guint64 (self, *offset, &tmp, error))
+            return FALSE;
+        *offset += 8;
+        print_value (str, field, tmp);
+        return TRUE;
+    }
+
+    case MBIM_FIELD_FORMAT_UUID: {
+        const MbimUuid   *tmp;
+        g_autofree gchar *tmpstr = NULL;
+
+        if (!_mbim_message_read_uuid (self, *offset, &tmp, error))
+            return FALSE;
+        *offset += 16;
+        tmpstr = mbim_uuid_get_printable (tmp);
+        g_string_append_printf (str, "'%s'", tmpstr);
+        return TRUE;
+    }
+
+    case MBIM_FIELD_FORMAT_STRING: {
+        g_autofree gchar *tmp = NULL;
+
+        if (!_mbim_message_read_string (self, 0, *offset, &tmp, error))
+            return FALSE;
+        *offset += 8;
+        g_string_append_printf (str, "'%s'", tmp);
+        return TRUE;
+    }
+
+    case MBIM_FIELD_FORMAT_STRING_ARRAY: {
+        g_auto(GStrv) tmp = NULL;
+        guint32       i;
+
+        if (!_mbim_message_read_string_array (self, array_size, 0, *offset, &tmp, error))
+            return FALSE;
+        *offset += (8 * array_size);
+
+        g_string_append (str, "'");
+        for (i = 0; i < array_size; i++) {
+            g_string_append (str, tmp[i]);
+            if (i < (array_size - 1))
+                g_string_append (str, ", ");
+        }
+        g_string_append (str, "'");
+        return TRUE;
+    }
+
+    case MBIM_FIELD_FORMAT_BYTE_ARRAY:
+    case MBIM_FIELD_FORMAT_UNSIZED_BYTE_ARRAY:
+    case MBIM_FIELD_FORMAT_REF_BYTE_ARRAY:
+    case MBIM_FIELD_FORMAT_REF_BYTE_ARRAY_NO_OFFSET: {
+        const guint8 *tmp;
+        guint32       tmpsize = 0;
+        gboolean      success;
+
+        if (field->format == MBIM_FIELD_FORMAT_BYTE_ARRAY) {
+            success = _mbim_message_read_byte_array (self, 0, *offset, FALSE, FALSE, field->array_size, &tmp, NULL, error);
+            tmpsize = field->array_size;
+            *offset += field->array_size;
+        } else if (field->format == MBIM_FIELD_FORMAT_UNSIZED_BYTE_ARRAY) {
+            success = _mbim_message_read_byte_array (self, 0, *offset, FALSE, FALSE, 0, &tmp, &tmpsize, error);
+            *offset += tmpsize;
+        } else if (field->format == MBIM_FIELD_FORMAT_REF_BYTE_ARRAY) {
+            success = _mbim_message_read_byte_array (self, 0, *offset, TRUE, TRUE, 0, &tmp, &tmpsize, error);
+            *offset += 8;
+        } else {
+            success = _mbim_message_read_byte_array (self, 0, *offset, FALSE, TRUE, 0, &tmp, &tmpsize, error);
+            *offset += 4;
+        }
+        if (!success)
+            return FALSE;
+        print_byte_array (str, tmp, tmpsize);
+        return TRUE;
+    }
+
+    case MBIM_FIELD_FORMAT_STRUCT: {
+        gpointer tmp;
+        guint32  bytes_read = 0;
+
+        tmp = field->struct_descriptor->read (self, *offset, NULL, &bytes_read, error);
+        if (!tmp)
+            return FALSE;
+        *offset += bytes_read;
+        g_string_append (str, "{\n");
+        field->struct_descriptor->print (tmp, str, line_prefix, "    ");
+        g_string_append_printf (str, "%s  }\n", line_prefix);
+        field->struct_descriptor->free (tmp);
+        return TRUE;
+    }
+
+    case MBIM_FIELD_FORMAT_STRUCT_ARRAY:
+    case MBIM_FIELD_FORMAT_REF_STRUCT_ARRAY: {
+        gpointer *tmp = NULL;
+        gboolean  refs;
+        guint32   i;
+
+        refs = (field->format == MBIM_FIELD_FORMAT_REF_STRUCT_ARRAY);
+        if (!field->struct_descriptor->read_array (self, array_size, *offset, refs, &tmp, error))
+            return FALSE;
+        *offset += (refs ? (8 * array_size) : 4);
+
+        g_string_append (str, "'{\n");
+        for (i = 0; i < array_size; i++) {
+            g_string_append_printf (str, "%s    [%u] = {\n", line_prefix, i);
+            field->struct_descriptor->print (tmp[i], str, line_prefix, "        ");
+            g_string_append_printf (str, "%s    },\n", line_prefix);
+        }
+        g_string_append_printf (str, "%s  }'", line_prefix);
+        /* Arrays parsed into the thread default arena are owned by it */
+        if (tmp && !_mbim_arena_get_thread_default ())
+            field->struct_descriptor->array_free (tmp);
+        return TRUE;
+    }
+
+    case MBIM_FIELD_FORMAT_IPV4:
+    case MBIM_FIELD_FORMAT_REF_IPV4: {
+        const MbimIPv4 *tmp;
+
+        if (!_mbim_message_read_ipv4 (self, *offset, (field->format == MBIM_FIELD_FORMAT_REF_IPV4), &tmp, error))
+            return FALSE;
+        *offset += 4;
+        print_ip_array (str, (const guint8 *) tmp, 1, G_SOCKET_FAMILY_IPV4);
+        return TRUE;
+    }
+
+    case MBIM_FIELD_FORMAT_IPV4_ARRAY: {
+        g_autofree MbimIPv4 *tmp = NULL;
+
+        if (!_mbim_message_read_ipv4_array (self, array_size, *offset, &tmp, error))
+            return FALSE;
+        *offset += 4;
+        print_ip_array (str, (const guint8 *) tmp, array_size, G_SOCKET_FAMILY_IPV4);
+        return TRUE;
+    }
+
+    case MBIM_FIELD_FORMAT_IPV6:
+    case MBIM_FIELD_FORMAT_REF_IPV6: {
+        const MbimIPv6 *tmp;
+
+        if (!_mbim_message_read_ipv6 (self, *offset, (field->format == MBIM_FIELD_FORMAT_REF_IPV6), &tmp, error))
+            return FALSE;
+        *offset += (field->format == MBIM_FIELD_FORMAT_REF_IPV6 ? 4 : 16);
+        print_ip_array (str, (const guint8 *) tmp, 1, G_SOCKET_FAMILY_IPV6);
+        return TRUE;
+    }
+
+    case MBIM_FIELD_FORMAT_IPV6_ARRAY: {
+        g_autofree MbimIPv6 *tmp = NULL;
+
+        if (!_mbim_message_read_ipv6_array (self, array_size, *offset, &tmp, error))
+            return FALSE;
+        *offset += 4;
+        print_ip_array (str, (const guint8 *) tmp, array_size, G_SOCKET_FAMILY_IPV6);
+        return TRUE;
+    }
+
+    default:
+        g_assert_not_reached ();
+    }
+}
+
+gboolean
+_mbim_message_print_fields (const MbimMessage         *self,
+                            const MbimFieldDescriptor *fields,
+                            guint                      n_fields,
+                            GString                   *str,
+                            const gchar               *line_prefix,
+                            GError                   **error)
+{
+    GError  *inner_error = NULL;
+    guint32 *values;
+    guint32  offset = 0;
+    guint    i;
+
+    /* Values of the guint32 fields, as they may give the size of arrays or
+     * the availability of other fields */
+    values = g_newa (guint32, n_fields);
+    memset (values, 0, sizeof (guint32) * n_fields);
+
+    for (i = 0; i < n_fields; i++) {
+        const MbimFieldDescriptor *field = &fields[i];
+
+        g_string_append_printf (str, "%s  %s = ", line_prefix, field->name);
+        if ((field->condition_field < 0 || values[field->condition_field] == field->condition_value) &&
+            !print_field (self, field, values, &values[i], &offset, str, line_prefix, &inner_error)) {
+            g_string_append_printf (str, "n/a: %s", inner_error->message);
+            g_clear_error (&inner_error);
+            break;
+        }
+        g_string_append (str, "\n");
+    }
+
+    return TRUE;
+}
+
 /*****************************************************************************/
 /* Struct builder interface
  *
  * Types like structs consist of a fixed sized prefix plus a variable length
  * data buffer. Items of variable size are usually given as an offset (with
- * respect to the start of the struct) plus a size field. */
+ * respect to the start of the struct) plus a size field.
+ *
+ * The builder either collects the fixed and variable parts in growable
+ * buffers and merges them on completion, or, if the exact sizes of both
+ * parts are known in advance, writes everything in place into a buffer that
+ * was already allocated with the final size. The _mbim_struct_builder_size_*()
+ * methods compute the sizes required by each of the _mbim_struct_builder_append_*()
+ * methods, adding them to the given fixed and variable sizes. */
 
 MbimStructBuilder *
 _mbim_struct_builder_new (void)
 {
     MbimStructBuilder *builder;
 
-    builder = g_slice_new (MbimStructBuilder);
+    builder = g_slice_new0 (MbimStructBuilder);
     builder->fixed_buffer = g_byte_array_new ();
     builder->variable_buffer = g_byte_array_new ();
     builder->offsets = g_array_new (FALSE, FALSE, sizeof (guint32));
     return builder;
 }
 
+static void
+struct_builder_init_sized (MbimStructBuilder *builder,
+                           GByteArray        *buffer,
+                           guint32            start,
+                           guint32            fixed_size,
+                           guint32            variable_size)
+{
+    g_assert (start + fixed_size + variable_size <= buffer->len);
+
+    memset (builder, 0, sizeof (MbimStructBuilder));
+    builder->buffer = buffer;
+    builder->start = start;
+    builder->fixed_offset = start;
+    builder->fixed_end = start + fixed_size;
+    builder->variable_offset = builder->fixed_end;
+    builder->variable_end = builder->fixed_end + variable_size;
+}
+
+static void
+struct_builder_finish_sized (MbimStructBuilder *builder)
+{
+    /* The precomputed sizes must match exactly what was written */
+    g_assert_cmpuint (builder->fixed_offset, ==, builder->fixed_end);
+    g_assert_cmpuint (builder->variable_offset, ==, builder->variable_end);
+}
+
 GByteArray *
 _mbim_struct_builder_complete (MbimStructBuilder *builder)
 {
     GByteArray *out;
     guint i;
 
-    /* Update offsets with the length of the information buffer, and store them
-     * in LE. */
-    for (i = 0; i < builder->offsets->len; i++) {
-        guint32 offset_offset;
-        guint32 offset_value;
+    g_assert (!builder->buffer);
+
+    /* Update offsets with the length of the information buffer, and store them
+     * in LE. */
+    for (i = 0; i < builder->offsets->len; i++) {
+        guint32 offset_offset;
+        guint32 offset_value;
+
+        offset_offset = g_array_index (builder->offsets, guint32, i);
+        memcpy (&offset_value, &(builder->fixed_buffer->data[offset_offset]), sizeof (guint32));
+        offset_value = GUINT32_TO_LE (offset_value + builder->fixed_buffer->len);
+        memcpy (&(builder->fixed_buffer->data[offset_offset]), &offset_value, sizeof (guint32));
+    }
+
+    /* Merge both buffers */
+    g_byte_array_append (builder->fixed_buffer,
+                         (const guint8 *)builder->variable_buffer->data,
+                         (guint32)builder->variable_buffer->len);
+
+    /* Steal the buffer to return */
+    out = builder->fixed_buffer;
+
+    /* Dispose the builder */
+    g_array_unref (builder->offsets);
+    g_byte_array_unref (builder->variable_buffer);
+    g_slice_free (MbimStructBuilder, builder);
+
+    return out;
+}
+
+static guint8 *
+struct_builder_reserve_fixed (MbimStructBuilder *builder,
+                              guint32            len)
+{
+    guint8 *out;
+
+    if (builder->buffer) {
+        g_assert (builder->fixed_offset + len <= builder->fixed_end);
+        out = &builder->buffer->data[builder->fixed_offset];
+        builder->fixed_offset += len;
+        return out;
+    }
+
+    g_byte_array_set_size (builder->fixed_buffer, builder->fixed_buffer->len + len);
+    return &builder->fixed_buffer->data[builder->fixed_buffer->len - len];
+}
+
+static guint8 *
+struct_builder_reserve_variable (MbimStructBuilder *builder,
+                                 guint32            len)
+{
+    guint8 *out;
+
+    if (builder->buffer) {
+        g_assert (builder->variable_offset + len <= builder->variable_end);
+        out = &builder->buffer->data[builder->variable_offset];
+        builder->variable_offset += len;
+        return out;
+    }
+
+    g_byte_array_set_size (builder->variable_buffer, builder->variable_buffer->len + len);
+    return &builder->variable_buffer->data[builder->variable_buffer->len - len];
+}
+
+static guint32
+padding_size (guint32 len)
+{
+    /* Padding until multiple of 4 */
+    return (4 - (len % 4)) % 4;
+}
+
+static void
+struct_builder_append_fixed (MbimStructBuilder *builder,
+                             gconstpointer      data,
+                             guint32            len,
+                             gboolean           pad)
+{
+    guint32 padding;
+
+    padding = pad ? padding_size (len) : 0;
+    if (len + padding == 0)
+        return;
+    memcpy (struct_builder_reserve_fixed (builder, len), data, len);
+    if (padding)
+        memset (struct_builder_reserve_fixed (builder, padding), 0, padding);
+}
 
-        offset_offset = g_array_index (builder->offsets, guint32, i);
-        memcpy (&offset_value, &(builder->fixed_buffer->data[offset_offset]), sizeof (guint32));
-        offset_value = GUINT32_TO_LE (offset_value + builder->fixed_buffer->len);
-        memcpy (&(builder->fixed_buffer->data[offset_offset]), &offset_value, sizeof (guint32));
-    }
+static void
+struct_builder_append_variable (MbimStructBuilder *builder,
+                                gconstpointer      data,
+                                guint32            len,
+                                gboolean           pad)
+{
+    guint32 padding;
 
-    /* Merge both buffers */
-    g_byte_array_append (builder->fixed_buffer,
-                         (const guint8 *)builder->variable_buffer->data,
-                         (guint32)builder->variable_buffer->len);
+    padding = pad ? padding_size (len) : 0;
+    if (len + padding == 0)
+        return;
+    memcpy (struct_builder_reserve_variable (builder, len), data, len);
+    if (padding)
+        memset (struct_builder_reserve_variable (builder, padding), 0, padding);
+}
 
-    /* Steal the buffer to return */
-    out = builder->fixed_buffer;
+/* Adds an offset to the fixed buffer pointing to the current position of the
+ * variable buffer */
+static void
+struct_builder_append_offset (MbimStructBuilder *builder)
+{
+    guint32 offset;
 
-    /* Dispose the builder */
-    g_array_unref (builder->offsets);
-    g_byte_array_unref (builder->variable_buffer);
-    g_slice_free (MbimStructBuilder, builder);
+    /* The variable buffer position with respect to the start of the struct is
+     * known right away */
+    if (builder->buffer) {
+        offset = GUINT32_TO_LE (builder->variable_offset - builder->start);
+        memcpy (struct_builder_reserve_fixed (builder, sizeof (offset)), &offset, sizeof (offset));
+        return;
+    }
 
-    return out;
+    /* Length of the fixed buffer *not* known yet, so add the value *not* in
+     * LE plus the offset of the offset, so that it's updated on completion */
+    offset = builder->variable_buffer->len;
+    g_array_append_val (builder->offsets, builder->fixed_buffer->len);
+    g_byte_array_append (builder->fixed_buffer, (guint8 *)&offset, sizeof (offset));
 }
 
 /*
@@ -817,6 +1684,27 @@ _mbim_struct_builder_complete (MbimStructBuilder *builder)
  *  - (d) Fixed-sized array directly in the static buffer.
  *  - (e) Unsized array directly in the variable buffer, length is assumed until end of message.
  */
+void
+_mbim_struct_builder_size_byte_array (gboolean  with_offset,
+                                      gboolean  with_length,
+                                      gboolean  pad_buffer,
+                                      guint32   buffer_len,
+                                      guint32  *fixed_size,
+                                      guint32  *variable_size)
+{
+    if (!with_offset && !with_length) {
+        *fixed_size += buffer_len + (pad_buffer ? padding_size (buffer_len) : 0);
+        return;
+    }
+
+    if (with_offset)
+        *fixed_size += 4;
+    if (with_length)
+        *fixed_size += 4;
+    if (buffer_len)
+        *variable_size += buffer_len + (pad_buffer ? padding_size (buffer_len) : 0);
+}
+
 void
 _mbim_struct_builder_append_byte_array (MbimStructBuilder *builder,
                                         gboolean           with_offset,
@@ -830,9 +1718,7 @@ _mbim_struct_builder_append_byte_array (MbimStructBuilder *builder,
      * (e) Unsized array directly in the variable buffer (here end of static buffer is also beginning of variable)
      */
     if (!with_offset && !with_length) {
-        g_byte_array_append (builder->fixed_buffer, buffer, buffer_len);
-        if (pad_buffer)
-            bytearray_apply_padding (builder->fixed_buffer, &buffer_len);
+        struct_builder_append_fixed (builder, buffer, buffer_len, pad_buffer);
         return;
     }
 
@@ -841,45 +1727,21 @@ _mbim_struct_builder_append_byte_array (MbimStructBuilder *builder,
 
     /* (c) Just offset in static buffer, length given in another variable, data in variable buffer. */
     if (with_offset) {
-        guint32 offset;
-
         /* If string length is greater than 0, add the offset to fix, otherwise set
          * the offset to 0 and don't configure the update */
-        if (buffer_len == 0) {
-            offset = 0;
-            g_byte_array_append (builder->fixed_buffer, (guint8 *)&offset, sizeof (offset));
-        } else {
-            guint32 offset_offset;
-
-            /* Offset of the offset */
-            offset_offset = builder->fixed_buffer->len;
-
-            /* Length *not* in LE yet */
-            offset = builder->variable_buffer->len;
-            /* Add the offset value */
-            g_byte_array_append (builder->fixed_buffer, (guint8 *)&offset, sizeof (offset));
-            /* Configure the value to get updated */
-            g_array_append_val (builder->offsets, offset_offset);
-        }
+        if (buffer_len == 0)
+            _mbim_struct_builder_append_guint32 (builder, 0);
+        else
+            struct_builder_append_offset (builder);
     }
 
     /* (b) Just length in static buffer, data just afterwards. */
-    if (with_length) {
-        guint32 length;
-
-        /* Add the length value */
-        length = GUINT32_TO_LE (buffer_len);
-        g_byte_array_append (builder->fixed_buffer, (guint8 *)&length, sizeof (length));
-    }
-
-    /* And finally, the bytearray itself to the variable buffer */
-    if (buffer_len) {
-        g_byte_array_append (builder->variable_buffer, (const guint8 *)buffer, (guint)buffer_len);
+    if (with_length)
+        _mbim_struct_builder_append_guint32 (builder, buffer_len);
 
-        /* Note: adding zero padding causes trouble for QMI service */
-        if (pad_buffer)
-            bytearray_apply_padding (builder->variable_buffer, &buffer_len);
-    }
+    /* And finally, the bytearray itself to the variable buffer.
+     * Note: adding zero padding causes trouble for QMI service */
+    struct_builder_append_variable (builder, buffer, buffer_len, pad_buffer);
 }
 
 void
@@ -895,9 +1757,10 @@ _mbim_struct_builder_append_uuid (MbimStructBuilder *builder,
     };
 
     /* uuids are added in the static buffer only */
-    g_byte_array_append (builder->fixed_buffer,
-                         value ? (guint8 *)value : (guint8 *)&uuid_invalid,
-                         sizeof (MbimUuid));
+    struct_builder_append_fixed (builder,
+                                 value ? value : &uuid_invalid,
+                                 sizeof (MbimUuid),
+                                 FALSE);
 }
 
 void
@@ -908,7 +1771,7 @@ _mbim_struct_builder_append_guint32 (MbimStructBuilder *builder,
 
     /* guint32 values are added in the static buffer only */
     tmp = GUINT32_TO_LE (value);
-    g_byte_array_append (builder->fixed_buffer, (guint8 *)&tmp, sizeof (tmp));
+    memcpy (struct_builder_reserve_fixed (builder, sizeof (tmp)), &tmp, sizeof (tmp));
 }
 
 void
@@ -931,83 +1794,141 @@ _mbim_struct_builder_append_guint64 (MbimStructBuilder *builder,
 
     /* guint64 values are added in the static buffer only */
     tmp = GUINT64_TO_LE (value);
-    g_byte_array_append (builder->fixed_buffer, (guint8 *)&tmp, sizeof (tmp));
+    memcpy (struct_builder_reserve_fixed (builder, sizeof (tmp)), &tmp, sizeof (tmp));
+}
+
+/* Number of bytes the string takes once converted to UTF-16, or 0 if the
+ * string is empty or not valid UTF-8 */
+static guint32
+string_get_utf16_size (const gchar *value,
+                       gboolean    *valid)
+{
+    const gchar *p;
+    guint32      n_units = 0;
+
+    if (valid)
+        *valid = TRUE;
+
+    if (!value || !value[0])
+        return 0;
+
+    if (!g_utf8_validate (value, -1, NULL)) {
+        if (valid)
+            *valid = FALSE;
+        return 0;
+    }
+
+    /* Characters out of the BMP need a surrogate pair */
+    for (p = value; *p; p = g_utf8_next_char (p))
+        n_units += (g_utf8_get_char (p) >= 0x10000) ? 2 : 1;
+
+    return n_units * 2;
+}
+
+/* Writes the already validated string in UTF-16LE */
+static void
+string_write_utf16le (const gchar *value,
+                      guint8      *out)
+{
+    const gchar *p;
+
+    for (p = value; *p; p = g_utf8_next_char (p)) {
+        gunichar c;
+
+        c = g_utf8_get_char (p);
+        if (c >= 0x10000) {
+            c -= 0x10000;
+            *out++ = (guint8) ((0xD800 + (c >> 10)) & 0xFF);
+            *out++ = (guint8) ((0xD800 + (c >> 10)) >> 8);
+            c = 0xDC00 + (c & 0x3FF);
+        }
+        *out++ = (guint8) (c & 0xFF);
+        *out++ = (guint8) (c >> 8);
+    }
+}
+
+void
+_mbim_struct_builder_size_string (const gchar *value,
+                                  guint32     *fixed_size,
+                                  guint32     *variable_size)
+{
+    guint32 utf16_bytes;
+
+    *fixed_size += 8;
+    utf16_bytes = string_get_utf16_size (value, NULL);
+    *variable_size += utf16_bytes + padding_size (utf16_bytes);
 }
 
 void
 _mbim_struct_builder_append_string (MbimStructBuilder *builder,
                                     const gchar       *value)
 {
-    guint32               offset;
-    guint32               length;
-    g_autofree gunichar2 *utf16 = NULL;
-    guint32               utf16_bytes = 0;
+    guint32  utf16_bytes;
+    guint32  padding;
+    gboolean valid;
 
     /* A string consists of Offset+Size in the static buffer, plus the
      * string itself in the variable buffer */
-
-    /* Convert the string from UTF-8 to UTF-16HE */
-    if (value && value[0]) {
-        g_autoptr(GError) error = NULL;
-        glong             items_written = 0;
-
-        utf16 = g_utf8_to_utf16 (value,
-                                 -1,
-                                 NULL, /* bytes */
-                                 &items_written, /* gunichar2 */
-                                 &error);
-        if (!utf16) {
-            g_warning ("Error converting string: %s", error->message);
-            return;
-        }
-
-        utf16_bytes = items_written * 2;
-    }
+    utf16_bytes = string_get_utf16_size (value, &valid);
+    if (!valid)
+        g_warning ("Error converting string: invalid UTF-8");
 
     /* If string length is greater than 0, add the offset to fix, otherwise set
      * the offset to 0 and don't configure the update */
-    if (utf16_bytes == 0) {
-        offset = 0;
-        g_byte_array_append (builder->fixed_buffer, (guint8 *)&offset, sizeof (offset));
-    } else {
-        guint32 offset_offset;
-
-        /* Offset of the offset */
-        offset_offset = builder->fixed_buffer->len;
-
-        /* Length *not* in LE yet */
-        offset = builder->variable_buffer->len;
-        /* Add the offset value */
-        g_byte_array_append (builder->fixed_buffer, (guint8 *)&offset, sizeof (offset));
-        /* Configure the value to get updated */
-        g_array_append_val (builder->offsets, offset_offset);
-    }
+    if (utf16_bytes == 0)
+        _mbim_struct_builder_append_guint32 (builder, 0);
+    else
+        struct_builder_append_offset (builder);
 
     /* Add the length value */
-    length = GUINT32_TO_LE (utf16_bytes);
-    g_byte_array_append (builder->fixed_buffer, (guint8 *)&length, sizeof (length));
+    _mbim_struct_builder_append_guint32 (builder, utf16_bytes);
 
-    /* And finally, the string itself to the variable buffer */
+    /* And finally, the string itself to the variable buffer, converted from
+     * UTF-8 to UTF-16LE in place */
     if (utf16_bytes) {
-        /* For BE systems, convert from BE to LE */
-        if (G_BYTE_ORDER == G_BIG_ENDIAN) {
-            guint i;
-
-            for (i = 0; i < (utf16_bytes / 2); i++)
-                utf16[i] = GUINT16_TO_LE (utf16[i]);
-        }
-        g_byte_array_append (builder->variable_buffer, (const guint8 *)utf16, (guint)utf16_bytes);
-        bytearray_apply_padding (builder->variable_buffer, &utf16_bytes);
+        string_write_utf16le (value, struct_builder_reserve_variable (builder, utf16_bytes));
+        padding = padding_size (utf16_bytes);
+        if (padding)
+            memset (struct_builder_reserve_variable (builder, padding), 0, padding);
     }
 }
 
+void
+_mbim_struct_builder_size_string_array (const gchar *const *values,
+                                        guint32             n_values,
+                                        guint32            *fixed_size,
+                                        guint32            *variable_size)
+{
+    guint32 i;
+
+    for (i = 0; i < n_values; i++)
+        _mbim_struct_builder_size_string (values[i], fixed_size, variable_size);
+}
+
 void
 _mbim_struct_builder_append_string_array (MbimStructBuilder  *builder,
                                           const gchar *const *values,
                                           guint32             n_values)
 {
-    /* TODO */
-    g_warn_if_reached ();
+    guint32 i;
+
+    /* A string array consists of one Offset+Size pair per string in the static
+     * buffer, one after the other, plus the strings themselves in the variable
+     * buffer; the number of strings must be given in a separate variable */
+    for (i = 0; i < n_values; i++)
+        _mbim_struct_builder_append_string (builder, values[i]);
+}
+
+void
+_mbim_struct_builder_size_ipv4 (const MbimIPv4 *value,
+                                gboolean        ref,
+                                guint32        *fixed_size,
+                                guint32        *variable_size)
+{
+    if (ref)
+        _mbim_struct_builder_size_ipv4_array (value ? 1 : 0, fixed_size, variable_size);
+    else
+        *fixed_size += sizeof (MbimIPv4);
 }
 
 void
@@ -1018,7 +1939,16 @@ _mbim_struct_builder_append_ipv4 (MbimStructBuilder *builder,
     if (ref)
         _mbim_struct_builder_append_ipv4_array (builder, value, value ? 1 : 0);
     else
-        g_byte_array_append (builder->fixed_buffer, (guint8 *)value, sizeof (MbimIPv4));
+        struct_builder_append_fixed (builder, value, sizeof (MbimIPv4), FALSE);
+}
+
+void
+_mbim_struct_builder_size_ipv4_array (guint32  n_values,
+                                      guint32 *fixed_size,
+                                      guint32 *variable_size)
+{
+    *fixed_size += 4;
+    *variable_size += n_values * sizeof (MbimIPv4);
 }
 
 void
@@ -1026,29 +1956,29 @@ _mbim_struct_builder_append_ipv4_array (MbimStructBuilder *builder,
                                         const MbimIPv4    *values,
                                         guint32            n_values)
 {
-    guint32 offset;
-
     if (!n_values) {
-        offset = 0;
-        g_byte_array_append (builder->fixed_buffer, (guint8 *)&offset, sizeof (offset));
-    } else {
-        guint32 offset_offset;
+        _mbim_struct_builder_append_guint32 (builder, 0);
+        return;
+    }
 
-        /* Offset of the offset */
-        offset_offset = builder->fixed_buffer->len;
+    struct_builder_append_offset (builder);
 
-        /* Length *not* in LE yet */
-        offset = builder->variable_buffer->len;
-        /* Add the offset value */
-        g_byte_array_append (builder->fixed_buffer, (guint8 *)&offset, sizeof (offset));
-        /* Configure the value to get updated */
-        g_array_append_val (builder->offsets, offset_offset);
+    /* NOTE: length of the array must be given in a separate variable */
 
-        /* NOTE: length of the array must be given in a separate variable */
+    /* And finally, the array of IPs itself to the variable buffer */
+    struct_builder_append_variable (builder, values, n_values * sizeof (MbimIPv4), FALSE);
+}
 
-        /* And finally, the array of IPs itself to the variable buffer */
-        g_byte_array_append (builder->variable_buffer, (guint8 *)values, n_values * sizeof (MbimIPv4));
-    }
+void
+_mbim_struct_builder_size_ipv6 (const MbimIPv6 *value,
+                                gboolean        ref,
+                                guint32        *fixed_size,
+                                guint32        *variable_size)
+{
+    if (ref)
+        _mbim_struct_builder_size_ipv6_array (value ? 1 : 0, fixed_size, variable_size);
+    else
+        *fixed_size += sizeof (MbimIPv6);
 }
 
 void
@@ -1059,7 +1989,16 @@ _mbim_struct_builder_append_ipv6 (MbimStructBuilder *builder,
     if (ref)
         _mbim_struct_builder_append_ipv6_array (builder, value, value ? 1 : 0);
     else
-        g_byte_array_append (builder->fixed_buffer, (guint8 *)value, sizeof (MbimIPv6));
+        struct_builder_append_fixed (builder, value, sizeof (MbimIPv6), FALSE);
+}
+
+void
+_mbim_struct_builder_size_ipv6_array (guint32  n_values,
+                                      guint32 *fixed_size,
+                                      guint32 *variable_size)
+{
+    *fixed_size += 4;
+    *variable_size += n_values * sizeof (MbimIPv6);
 }
 
 void
@@ -1067,34 +2006,154 @@ _mbim_struct_builder_append_ipv6_array (MbimStructBuilder *builder,
                                         const MbimIPv6    *values,
                                         guint32            n_values)
 {
-    guint32 offset;
-
     if (!n_values) {
-        offset = 0;
-        g_byte_array_append (builder->fixed_buffer, (guint8 *)&offset, sizeof (offset));
+        _mbim_struct_builder_append_guint32 (builder, 0);
+        return;
+    }
+
+    struct_builder_append_offset (builder);
+
+    /* NOTE: length of the array must be given in a separate variable */
+
+    /* And finally, the array of IPs itself to the variable buffer */
+    struct_builder_append_variable (builder, values, n_values * sizeof (MbimIPv6), FALSE);
+}
+
+/* Nested structs are fully written (both their fixed and variable parts)
+ * either in the fixed or in the variable buffer of the parent struct */
+static void
+struct_builder_append_struct_full (MbimStructBuilder   *builder,
+                                   gboolean             to_variable,
+                                   gboolean             with_offset,
+                                   gboolean             with_length,
+                                   MbimStructSizeFunc   size_func,
+                                   MbimStructWriteFunc  write_func,
+                                   gconstpointer        value)
+{
+    GByteArray *raw = NULL;
+    guint32     fixed_size = 0;
+    guint32     variable_size = 0;
+    guint32     length;
+
+    g_assert (value != NULL);
+
+    if (builder->buffer) {
+        size_func (value, &fixed_size, &variable_size);
+        length = fixed_size + variable_size;
     } else {
-        guint32 offset_offset;
+        MbimStructBuilder *child;
+
+        child = _mbim_struct_builder_new ();
+        write_func (child, value);
+        raw = _mbim_struct_builder_complete (child);
+        length = raw->len;
+    }
+
+    if (with_offset)
+        struct_builder_append_offset (builder);
+    if (with_length) {
+        g_assert (length > 0);
+        _mbim_struct_builder_append_guint32 (builder, length);
+    }
+
+    if (raw) {
+        if (to_variable)
+            struct_builder_append_variable (builder, raw->data, raw->len, FALSE);
+        else
+            struct_builder_append_fixed (builder, raw->data, raw->len, FALSE);
+        g_byte_array_unref (raw);
+    } else {
+        MbimStructBuilder  child;
+        guint8            *dest;
+
+        dest = (to_variable ?
+                struct_builder_reserve_variable (builder, length) :
+                struct_builder_reserve_fixed (builder, length));
+        struct_builder_init_sized (&child, builder->buffer, dest - builder->buffer->data, fixed_size, variable_size);
+        write_func (&child, value);
+        struct_builder_finish_sized (&child);
+    }
+}
+
+void
+_mbim_struct_builder_size_struct (MbimStructSizeFunc  size_func,
+                                  gconstpointer       value,
+                                  guint32            *fixed_size,
+                                  guint32            *variable_size)
+{
+    guint32 struct_fixed_size = 0;
+    guint32 struct_variable_size = 0;
+
+    size_func (value, &struct_fixed_size, &struct_variable_size);
+    *fixed_size += struct_fixed_size + struct_variable_size;
+}
+
+void
+_mbim_struct_builder_append_struct (MbimStructBuilder   *builder,
+                                    MbimStructSizeFunc   size_func,
+                                    MbimStructWriteFunc  write_func,
+                                    gconstpointer        value)
+{
+    struct_builder_append_struct_full (builder, FALSE, FALSE, FALSE, size_func, write_func, value);
+}
+
+void
+_mbim_struct_builder_size_struct_array (MbimStructSizeFunc          size_func,
+                                        const gconstpointer        *values,
+                                        guint32                     n_values,
+                                        gboolean                    refs,
+                                        guint32                    *fixed_size,
+                                        guint32                    *variable_size)
+{
+    guint32 i;
+
+    /* Either a single offset to all the structs, or an offset and length
+     * pair for each */
+    *fixed_size += refs ? (8 * n_values) : 4;
+    for (i = 0; i < n_values; i++) {
+        guint32 struct_fixed_size = 0;
+        guint32 struct_variable_size = 0;
 
-        /* Offset of the offset */
-        offset_offset = builder->fixed_buffer->len;
+        size_func (values[i], &struct_fixed_size, &struct_variable_size);
+        *variable_size += struct_fixed_size + struct_variable_size;
+    }
+}
 
-        /* Length *not* in LE yet */
-        offset = builder->variable_buffer->len;
-        /* Add the offset value */
-        g_byte_array_append (builder->fixed_buffer, (guint8 *)&offset, sizeof (offset));
-        /* Configure the value to get updated */
-        g_array_append_val (builder->offsets, offset_offset);
+void
+_mbim_struct_builder_append_struct_array (MbimStructBuilder          *builder,
+                                          MbimStructSizeFunc          size_func,
+                                          MbimStructWriteFunc         write_func,
+                                          const gconstpointer        *values,
+                                          guint32                     n_values,
+                                          gboolean                    refs)
+{
+    guint32 i;
 
-        /* NOTE: length of the array must be given in a separate variable */
+    if (refs) {
+        for (i = 0; i < n_values; i++)
+            struct_builder_append_struct_full (builder, TRUE, TRUE, TRUE, size_func, write_func, values[i]);
+        return;
+    }
 
-        /* And finally, the array of IPs itself to the variable buffer */
-        g_byte_array_append (builder->variable_buffer, (guint8 *)values, n_values * sizeof (MbimIPv6));
+    if (!n_values) {
+        _mbim_struct_builder_append_guint32 (builder, 0);
+        return;
     }
+
+    struct_builder_append_offset (builder);
+    for (i = 0; i < n_values; i++)
+        struct_builder_append_struct_full (builder, TRUE, FALSE, FALSE, size_func, write_func, values[i]);
 }
 
 /*****************************************************************************/
 /* Command message builder interface */
 
+static MbimMessage *message_command_new_sized (guint32                transaction_id,
+                                               MbimService            service,
+                                               guint32                cid,
+                                               MbimMessageCommandType command_type,
+                                               guint32                buffer_length);
+
 MbimMessageCommandBuilder *
 _mbim_message_command_builder_new (guint32                transaction_id,
                                    MbimService            service,
@@ -1109,24 +2168,53 @@ _mbim_message_command_builder_new (guint32                transaction_id,
     return builder;
 }
 
+MbimMessageCommandBuilder *
+_mbim_message_command_builder_new_sized (guint32                transaction_id,
+                                         MbimService            service,
+                                         guint32                cid,
+                                         MbimMessageCommandType command_type,
+                                         guint32                fixed_size,
+                                         guint32                variable_size)
+{
+    MbimMessageCommandBuilder *builder;
+
+    builder = g_slice_new (MbimMessageCommandBuilder);
+    builder->message = message_command_new_sized (transaction_id, service, cid, command_type, fixed_size + variable_size);
+    g_assert (builder->message);
+    builder->contents_builder = g_slice_new (MbimStructBuilder);
+    struct_builder_init_sized (builder->contents_builder,
+                               (GByteArray *) builder->message,
+                               _mbim_message_get_information_buffer_offset (builder->message),
+                               fixed_size,
+                               variable_size);
+    return builder;
+}
+
 MbimMessage *
 _mbim_message_command_builder_complete (MbimMessageCommandBuilder *builder)
 {
     MbimMessage *message;
-    GByteArray *contents;
-
-    /* Complete contents, which disposes the builder itself */
-    contents = _mbim_struct_builder_complete (builder->contents_builder);
-
-    /* Merge both buffers */
-    mbim_message_command_append (builder->message,
-                                 (const guint8 *)contents->data,
-                                 (guint32)contents->len);
-    g_byte_array_unref (contents);
 
     /* Steal the message to return */
     message = builder->message;
 
+    if (builder->contents_builder->buffer) {
+        /* Contents already written in place */
+        struct_builder_finish_sized (builder->contents_builder);
+        g_slice_free (MbimStructBuilder, builder->contents_builder);
+    } else {
+        GByteArray *contents;
+
+        /* Complete contents, which disposes the builder itself */
+        contents = _mbim_struct_builder_complete (builder->contents_builder);
+
+        /* Merge both buffers */
+        mbim_message_command_append (message,
+                                     (const guint8 *)contents->data,
+                                     (guint32)contents->len);
+        g_byte_array_unref (contents);
+    }
+
     /* Dispose the remaining stuff from the message builder */
     g_slice_free (MbimMessageCommandBuilder, builder);
 
@@ -1220,6 +2308,26 @@ _mbim_message_command_builder_append_ipv6_array (MbimMessageCommandBuilder *buil
     _mbim_struct_builder_append_ipv6_array (builder->contents_builder, values, n_values);
 }
 
+void
+_mbim_message_command_builder_append_struct (MbimMessageCommandBuilder *builder,
+                                             MbimStructSizeFunc         size_func,
+                                             MbimStructWriteFunc        write_func,
+                                             gconstpointer              value)
+{
+    _mbim_struct_builder_append_struct (builder->contents_builder, size_func, write_func, value);
+}
+
+void
+_mbim_message_command_builder_append_struct_array (MbimMessageCommandBuilder *builder,
+                                                   MbimStructSizeFunc         size_func,
+                                                   MbimStructWriteFunc        write_func,
+                                                   const gconstpointer       *values,
+                                                   guint32                    n_values,
+                                                   gboolean                   refs)
+{
+    _mbim_struct_builder_append_struct_array (builder->contents_builder, size_func, write_func, values, n_values, refs);
+}
+
 /*****************************************************************************/
 /* Generic message interface */
 
@@ -1314,21 +2422,20 @@ mbim_message_get_raw (const MbimMessage  *self,
     return self->data;
 }
 
-gchar *
-mbim_message_get_printable (const MbimMessage *self,
-                            const gchar       *line_prefix,
-                            gboolean           headers_only)
+void
+mbim_message_append_printable (const MbimMessage *self,
+                               GString           *printable,
+                               const gchar       *line_prefix,
+                               gboolean           headers_only)
 {
-    GString *printable;
     MbimService service_read_fields = MBIM_SERVICE_INVALID;
 
-    g_return_val_if_fail (self != NULL, NULL);
-    g_return_val_if_fail (line_prefix != NULL, NULL);
+    g_return_if_fail (self != NULL);
+    g_return_if_fail (printable != NULL);
 
     if (!line_prefix)
         line_prefix = "";
 
-    printable = g_string_new ("");
     g_string_append_printf (printable,
                             "%sHeader:\n"
                             "%s  length      = %u\n"
@@ -1488,57 +2595,65 @@ mbim_message_get_printable (const MbimMessage *self,
     }
 
     if (service_read_fields != MBIM_SERVICE_INVALID) {
-        g_autofree gchar  *fields_printable = NULL;
         g_autoptr(GError)  error = NULL;
+        gsize              fields_start;
+        gsize              fields_header_len;
+        gboolean           fields_read = FALSE;
+
+        /* The fields are appended right after the header; if there are none
+         * or they cannot be read, the header is removed afterwards */
+        fields_start = printable->len;
+        g_string_append_printf (printable, "%sFields:\n", line_prefix);
+        fields_header_len = printable->len - fields_start;
 
         switch (service_read_fields) {
         case MBIM_SERVICE_BASIC_CONNECT:
-            fields_printable = __mbim_message_basic_connect_get_printable_fields (self, line_prefix, &error);
+            fields_read = __mbim_message_basic_connect_get_printable_fields (self, printable, line_prefix, &error);
             break;
         case MBIM_SERVICE_SMS:
-            fields_printable = __mbim_message_sms_get_printable_fields (self, line_prefix, &error);
+            fields_read = __mbim_message_sms_get_printable_fields (self, printable, line_prefix, &error);
             break;
         case MBIM_SERVICE_USSD:
-            fields_printable = __mbim_message_ussd_get_printable_fields (self, line_prefix, &error);
+            fields_read = __mbim_message_ussd_get_printable_fields (self, printable, line_prefix, &error);
             break;
         case MBIM_SERVICE_PHONEBOOK:
-            fields_printable = __mbim_message_phonebook_get_printable_fields (self, line_prefix, &error);
+            fields_read = __mbim_message_phonebook_get_printable_fields (self, printable, line_prefix, &error);
             break;
         case MBIM_SERVICE_STK:
-            fields_printable = __mbim_message_stk_get_printable_fields (self, line_prefix, &error);
+            fields_read = __mbim_message_stk_get_printable_fields (self, printable, line_prefix, &error);
             break;
         case MBIM_SERVICE_AUTH:
-            fields_printable = __mbim_message_auth_get_printable_fields (self, line_prefix, &error);
+            fields_read = __mbim_message_auth_get_printable_fields (self, printable, line_prefix, &error);
             break;
         case MBIM_SERVICE_DSS:
-            fields_printable = __mbim_message_dss_get_printable_fields (self, line_prefix, &error);
+            fields_read = __mbim_message_dss_get_printable_fields (self, printable, line_prefix, &error);
             break;
         case MBIM_SERVICE_MS_FIRMWARE_ID:
-            fields_printable = __mbim_message_ms_firmware_id_get_printable_fields (self, line_prefix, &error);
+            fields_read = __mbim_message_ms_firmware_id_get_printable_fields (self, printable, line_prefix, &error);
             break;
         case MBIM_SERVICE_MS_HOST_SHUTDOWN:
-            fields_printable = __mbim_message_ms_host_shutdown_get_printable_fields (self, line_prefix, &error);
+            fields_read = __mbim_message_ms_host_shutdown_get_printable_fields (self, printable, line_prefix, &error);
             break;
         case MBIM_SERVICE_MS_SAR:
-            fields_printable = __mbim_message_ms_sar_get_printable_fields (self, line_prefix, &error);
+            fields_read = __mbim_message_ms_sar_get_printable_fields (self, printable, line_prefix, &error);
             break;
         case MBIM_SERVICE_PROXY_CONTROL:
-            fields_printable = __mbim_message_proxy_control_get_printable_fields (self, line_prefix, &error);
+            fields_read = __mbim_message_proxy_control_get_printable_fields (self, printable, line_prefix, &error);
             break;
         case MBIM_SERVICE_QMI:
-            fields_printable = __mbim_message_qmi_get_printable_fields (self, line_prefix, &error);
+            fields_read = __mbim_message_qmi_get_printable_fields (self, printable, line_prefix, &error);
             break;
         case MBIM_SERVICE_ATDS:
-            fields_printable = __mbim_message_atds_get_printable_fields (self, line_prefix, &error);
+            fields_read = __mbim_message_atds_get_printable_fields (self, printable, line_prefix, &error);
             break;
         case MBIM_SERVICE_INTEL_FIRMWARE_UPDATE:
-            fields_printable = __mbim_message_intel_firmware_update_get_printable_fields (self, line_prefix, &error);
+            fields_read = __mbim_message_intel_firmware_update_get_printable_fields (self, printable, line_prefix, &error);
             break;
         case MBIM_SERVICE_QDU:
-            fields_printable = __mbim_message_qdu_get_printable_fields (self, line_prefix, &error);
+            fields_read = __mbim_message_qdu_get_printable_fields (self, printable, line_prefix, &error);
             break;
         case MBIM_SERVICE_MS_BASIC_CONNECT_EXTENSIONS:
-            fields_printable = __mbim_message_ms_basic_connect_extensions_get_printable_fields (self, line_prefix, &error);
+            fields_read = __mbim_message_ms_basic_connect_extensions_get_printable_fields (self, printable, line_prefix, &error);
             break;
         case MBIM_SERVICE_INVALID:
         case MBIM_SERVICE_LAST:
@@ -1547,17 +2662,28 @@ mbim_message_get_printable (const MbimMessage *self,
             break;
         }
 
-        if (error)
+        if (error) {
+            g_string_truncate (printable, fields_start);
             g_string_append_printf (printable,
                                     "%sFields: %s\n",
                                     line_prefix, error->message);
-        else if (fields_printable && fields_printable[0])
-            g_string_append_printf (printable,
-                                    "%sFields:\n"
-                                    "%s",
-                                    line_prefix, fields_printable);
+        } else if (!fields_read || (printable->len == fields_start + fields_header_len))
+            g_string_truncate (printable, fields_start);
     }
+}
+
+gchar *
+mbim_message_get_printable (const MbimMessage *self,
+                            const gchar       *line_prefix,
+                            gboolean           headers_only)
+{
+    GString *printable;
+
+    g_return_val_if_fail (self != NULL, NULL);
+    g_return_val_if_fail (line_prefix != NULL, NULL);
 
+    printable = g_string_new ("");
+    mbim_message_append_printable (self, printable, line_prefix, headers_only);
     return g_string_free (printable, FALSE);
 }
 
@@ -1610,25 +2736,53 @@ _mbim_message_fragment_get_payload (const MbimMessage *self,
     return ((struct full_message *)(self->data))->message.fragment.buffer;
 }
 
+/* Upper limit for the amount of memory to reserve up front when collecting
+ * fragments, just in case the total fragment count is bogus */
+#define MAX_FRAGMENT_COLLECTOR_RESERVED_SIZE (1024 * 1024)
+
 MbimMessage *
 _mbim_message_fragment_collector_init (const MbimMessage  *fragment,
                                        GError            **error)
 {
-   g_assert (MBIM_MESSAGE_IS_FRAGMENT (fragment));
+    GByteArray *self;
+    guint32     fragment_length;
+    guint32     payload_length;
+    guint64     reserved_size;
+
+    g_assert (MBIM_MESSAGE_IS_FRAGMENT (fragment));
+
+    /* Collector must start with fragment #0 */
+    if (MBIM_MESSAGE_FRAGMENT_GET_CURRENT (fragment) != 0) {
+        g_set_error (error,
+                     MBIM_PROTOCOL_ERROR,
+                     MBIM_PROTOCOL_ERROR_FRAGMENT_OUT_OF_SEQUENCE,
+                     "Expecting fragment '0/%u', got '%u/%u'",
+                     MBIM_MESSAGE_FRAGMENT_GET_TOTAL (fragment),
+                     MBIM_MESSAGE_FRAGMENT_GET_CURRENT (fragment),
+                     MBIM_MESSAGE_FRAGMENT_GET_TOTAL (fragment));
+        return NULL;
+    }
 
-   /* Collector must start with fragment #0 */
-   if (MBIM_MESSAGE_FRAGMENT_GET_CURRENT (fragment) != 0) {
-       g_set_error (error,
-                    MBIM_PROTOCOL_ERROR,
-                    MBIM_PROTOCOL_ERROR_FRAGMENT_OUT_OF_SEQUENCE,
-                    "Expecting fragment '0/%u', got '%u/%u'",
-                    MBIM_MESSAGE_FRAGMENT_GET_TOTAL (fragment),
-                    MBIM_MESSAGE_FRAGMENT_GET_CURRENT (fragment),
-                    MBIM_MESSAGE_FRAGMENT_GET_TOTAL (fragment));
-       return NULL;
-   }
+    if (MBIM_MESSAGE_FRAGMENT_GET_TOTAL (fragment) == 0) {
+        g_set_error (error,
+                     MBIM_PROTOCOL_ERROR,
+                     MBIM_PROTOCOL_ERROR_FRAGMENT_OUT_OF_SEQUENCE,
+                     "Invalid total fragment count '0'");
+        return NULL;
+    }
 
-   return mbim_message_dup (fragment);
+    /* All fragments except for the last one are expected to be as big as the
+     * first one, so reserve the size of the whole reassembled message up
+     * front and avoid reallocating while fragments get added */
+    fragment_length = MBIM_MESSAGE_GET_MESSAGE_LENGTH (fragment);
+    _mbim_message_fragment_get_payload (fragment, &payload_length);
+    reserved_size = fragment_length + ((guint64)payload_length * (MBIM_MESSAGE_FRAGMENT_GET_TOTAL (fragment) - 1));
+    if (reserved_size > MAX_FRAGMENT_COLLECTOR_RESERVED_SIZE)
+        reserved_size = MAX_FRAGMENT_COLLECTOR_RESERVED_SIZE;
+
+    self = g_byte_array_sized_new ((guint) reserved_size);
+    g_byte_array_append (self, fragment->data, fragment_length);
+    return (MbimMessage *)self;
 }
 
 gboolean
@@ -1642,9 +2796,11 @@ _mbim_message_fragment_collector_add (MbimMessage        *self,
     g_assert (MBIM_MESSAGE_IS_FRAGMENT (self));
     g_assert (MBIM_MESSAGE_IS_FRAGMENT (fragment));
 
-    /* We can only add a fragment if it is the next one we're expecting.
-     * Otherwise, we return an error. */
-    if (MBIM_MESSAGE_FRAGMENT_GET_CURRENT (self) != (MBIM_MESSAGE_FRAGMENT_GET_CURRENT (fragment) - 1)) {
+    /* We can only add a fragment if it is the next one we're expecting, and
+     * if it belongs to the same fragment window. Otherwise, we return an
+     * error, without touching the collected data. */
+    if ((MBIM_MESSAGE_FRAGMENT_GET_CURRENT (self) != (MBIM_MESSAGE_FRAGMENT_GET_CURRENT (fragment) - 1)) ||
+        (MBIM_MESSAGE_FRAGMENT_GET_TOTAL (self) != MBIM_MESSAGE_FRAGMENT_GET_TOTAL (fragment))) {
         g_set_error (error,
                      MBIM_PROTOCOL_ERROR,
                      MBIM_PROTOCOL_ERROR_FRAGMENT_OUT_OF_SEQUENCE,
@@ -1658,7 +2814,7 @@ _mbim_message_fragment_collector_add (MbimMessage        *self,
 
     buffer = _mbim_message_fragment_get_payload (fragment, &buffer_len);
     if (buffer_len) {
-        /* Concatenate information buffers */
+        /* Concatenate information buffers; space is already reserved */
         g_byte_array_append ((GByteArray *)self, buffer, buffer_len);
         /* Update the whole message length */
         ((struct header *)(self->data))->length =
@@ -1959,11 +3115,12 @@ mbim_message_error_get_error (const MbimMessage *self)
 /*****************************************************************************/
 /* 'Command' message interface */
 
-MbimMessage *
-mbim_message_command_new (guint32                transaction_id,
-                          MbimService            service,
-                          guint32                cid,
-                          MbimMessageCommandType command_type)
+static MbimMessage *
+message_command_new_sized (guint32                transaction_id,
+                           MbimService            service,
+                           guint32                cid,
+                           MbimMessageCommandType command_type,
+                           guint32                buffer_length)
 {
     GByteArray *self;
     const MbimUuid *service_id;
@@ -1972,9 +3129,11 @@ mbim_message_command_new (guint32                transaction_id,
     service_id = mbim_uuid_from_service (service);
     g_return_val_if_fail (service_id != NULL, NULL);
 
+    /* The information buffer, if any, is allocated right away along with the
+     * headers */
     self = _mbim_message_allocate (MBIM_MESSAGE_TYPE_COMMAND,
                                    transaction_id,
-                                   sizeof (struct command_message));
+                                   sizeof (struct command_message) + buffer_length);
 
     /* Fragment header */
     ((struct full_message *)(self->data))->message.command.fragment_header.total   = GUINT32_TO_LE (1);
@@ -1984,11 +3143,20 @@ mbim_message_command_new (guint32                transaction_id,
     memcpy (((struct full_message *)(self->data))->message.command.service_id, service_id, sizeof (*service_id));
     ((struct full_message *)(self->data))->message.command.command_id    = GUINT32_TO_LE (cid);
     ((struct full_message *)(self->data))->message.command.command_type  = GUINT32_TO_LE (command_type);
-    ((struct full_message *)(self->data))->message.command.buffer_length = 0;
+    ((struct full_message *)(self->data))->message.command.buffer_length = GUINT32_TO_LE (buffer_length);
 
     return (MbimMessage *)self;
 }
 
+MbimMessage *
+mbim_message_command_new (guint32                transaction_id,
+                          MbimService            service,
+                          guint32                cid,
+                          MbimMessageCommandType command_type)
+{
+    return message_command_new_sized (transaction_id, service, cid, command_type, 0);
+}
+
 void
 mbim_message_command_append (MbimMessage  *self,
                              const guint8 *buffer,
@@ -183,6 +183,25 @@ gchar *mbim_message_get_printable (const MbimMessage  *self,
                                    const gchar        *line_prefix,
                                    gboolean            headers_only);
 
+/**
+ * mbim_message_append_printable:
+ * @self: a #MbimMessage.
+ * @str: a #GString where the printable contents will be appended.
+ * @line_prefix: prefix string to use in each new generated line.
+ * @headers_only: %TRUE if only basic headers should be printed.
+ *
+ * Appends the printable contents of the whole MBIM message to @str. The output
+ * is the same one as given by mbim_message_get_printable(), but it is written
+ * directly into the given string, so that the same buffer can be reused to
+ * print multiple messages.
+ *
+ * Since: 1.26
+ */
+void mbim_message_append_printable (const MbimMessage  *self,
+                                    GString            *str,
+                                    const gchar        *line_prefix,
+                                    gboolean            headers_only);
+
 /**
  * mbim_message_get_raw:
  * @self: a #MbimMessage.
@@ -249,6 +268,138 @@ void mbim_message_set_transaction_id (MbimMessage *self,
 
 G_DEFINE_AUTOPTR_CLEANUP_FUNC (MbimMessage, mbim_message_unref)
 
+/*****************************************************************************/
+/* Arenas */
+
+/**
+ * MbimArena:
+ *
+ * An opaque type representing a block of memory where the arrays of structs
+ * read from messages may be allocated.
+ *
+ * Since: 1.26
+ */
+typedef struct _MbimArena MbimArena;
+
+/**
+ * mbim_arena_new:
+ *
+ * Create a new empty #MbimArena.
+ *
+ * Returns: (transfer full): a newly created #MbimArena. The returned value
+ * should be freed with mbim_arena_free().
+ *
+ * Since: 1.26
+ */
+MbimArena *mbim_arena_new (void);
+
+/**
+ * mbim_arena_free:
+ * @arena: a #MbimArena.
+ *
+ * Releases @arena, along with all the arrays that were allocated in it.
+ *
+ * Since: 1.26
+ */
+void mbim_arena_free (MbimArena *arena);
+
+/**
+ * mbim_arena_push_thread_default:
+ * @arena: a #MbimArena.
+ *
+ * Makes @arena the thread default arena, until it is popped with
+ * mbim_arena_pop_thread_default().
+ *
+ * The arrays of structs read by the message parsers called from this thread
+ * while @arena is the thread default (e.g. the list of providers in a
+ * #MbimProviderArray) are allocated in @arena, in one single block of memory
+ * together with all their structs and their contents.
+ *
+ * Those arrays are owned by @arena: they, and the structs they contain, must
+ * never be freed with the array free method of their type, e.g.
+ * mbim_provider_array_free(), nor modified on their own. They are all
+ * released at once with mbim_arena_free(). Arrays parsed while @arena is not
+ * the thread default are not affected.
+ *
+ * Since: 1.26
+ */
+void mbim_arena_push_thread_default (MbimArena *arena);
+
+/**
+ * mbim_arena_pop_thread_default:
+ * @arena: a #MbimArena, which must be the current thread default one.
+ *
+ * Pops @arena off the thread default arena stack, restoring the previous
+ * thread default arena, if any.
+ *
+ * Since: 1.26
+ */
+void mbim_arena_pop_thread_default (MbimArena *arena);
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC (MbimArena, mbim_arena_free)
+
+/*****************************************************************************/
+/* Struct array iterators */
+
+/**
+ * MbimStructArrayIter:
+ *
+ * An opaque structure used to walk in place the elements of an array of
+ * structs in a #MbimMessage, without parsing or allocating them.
+ *
+ * The iterator is initialized with the iterator method of the message field
+ * holding the array, e.g. mbim_message_visible_providers_response_iter_providers(),
+ * and moved to each element with mbim_struct_array_iter_next(). The fields
+ * of the current element are read with the iterator accessors of the struct
+ * type, e.g. mbim_provider_iter_get_rssi().
+ *
+ * The iterator does not hold a reference to the message, which must be kept
+ * valid while the iterator is in use.
+ *
+ * Since: 1.26
+ */
+typedef struct {
+    /*< private >*/
+    gconstpointer dummy1;
+    gconstpointer dummy2;
+    guint32       dummy3;
+    guint32       dummy4;
+    guint32       dummy5;
+    guint32       dummy6;
+    guint32       dummy7;
+    gboolean      dummy8;
+    gboolean      dummy9;
+} MbimStructArrayIter;
+
+/**
+ * mbim_struct_array_iter_get_n_elements:
+ * @iter: an initialized #MbimStructArrayIter.
+ *
+ * Gets the number of elements in the array walked by @iter.
+ *
+ * Returns: the number of elements.
+ *
+ * Since: 1.26
+ */
+guint32 mbim_struct_array_iter_get_n_elements (const MbimStructArrayIter *iter);
+
+/**
+ * mbim_struct_array_iter_next:
+ * @iter: an initialized #MbimStructArrayIter.
+ * @error: return location for error or %NULL.
+ *
+ * Moves @iter to the next element of the array, which is the first one if
+ * the iterator was just initialized. The location of the element is
+ * validated against the bounds of the message.
+ *
+ * Returns: %TRUE if @iter points to a valid element, %FALSE if there are no
+ * more elements in the array or if @error is set.
+ *
+ * Since: 1.26
+ */
+gboolean mbim_struct_array_iter_next (MbimStructArrayIter  *iter,
+                                      GError              **error);
+
 /*****************************************************************************/
 /* 'Open' message interface */
 
@@ -32,26 +32,53 @@
 #include <sys/socket.h>
 #include <sys/types.h>
 #include <string.h>
+#include <errno.h>
+#include <unistd.h>
 
 #include "mbim-device.h"
+#include "mbim-basic-connect.h"
 #include "mbim-helpers.h"
 #include "mbim-error-types.h"
 #include "mbim-net-port-manager.h"
+#include "mbim-timer-queue.h"
+#include "mbim-utils-private.h"
 
 G_DEFINE_TYPE (MbimNetPortManager, mbim_net_port_manager, G_TYPE_OBJECT)
 
 struct _MbimNetPortManagerPrivate {
     gchar *iface;
 
-    /* Netlink socket */
-    GSocket *socket;
-    GSource *source;
+    /* Netlink socket, and the buffer where datagrams are received */
+    GSocket    *socket;
+    GSource    *source;
+    GByteArray *buffer;
 
     /* Netlink state */
     guint       current_sequence_id;
     GHashTable *transactions;
+
+    /* Link cache, kept up to date with the link notifications received from
+     * the kernel; if not available, the kernel is queried every time */
+    gboolean    links_cached;
+    GHashTable *links;          /* ifindex -> Link */
+    GHashTable *links_by_name;  /* ifname -> Link */
+    GHashTable *uppers;         /* parent ifindex -> GPtrArray of Link */
+};
+
+enum {
+    SIGNAL_LINK_ADDED,
+    SIGNAL_LINK_REMOVED,
+    SIGNAL_LAST
 };
 
+static guint signals[SIGNAL_LAST] = { 0 };
+
+/* Minimum size of the buffer used to receive netlink messages */
+#define NETLINK_BUFFER_SIZE 8192
+
+/* Maximum number of datagrams received in one single main context dispatch */
+#define NETLINK_MAX_DATAGRAMS_PER_DISPATCH 32
+
 /* alternative VLAN for IP session 0 if not untagged */
 #define MBIM_IPS0_VID	4094
 
@@ -177,6 +204,31 @@ netlink_message_new (guint16 type,
     return msg;
 }
 
+/* Messages which don't carry a link request, with a different payload after
+ * the netlink header (e.g. a struct ifaddrmsg or a struct rtmsg) */
+static NetlinkMessage *
+netlink_message_new_with_payload (guint16       type,
+                                  guint16       extra_flags,
+                                  gconstpointer payload,
+                                  gsize         payload_size)
+{
+    NetlinkMessage  *msg;
+    struct nlmsghdr *hdr;
+    guint            size;
+
+    size = NLMSG_SPACE (payload_size);
+    msg = g_byte_array_sized_new (size);
+    g_byte_array_set_size (msg, size);
+    memset ((char *) msg->data, 0, size);
+    memcpy (NLMSG_DATA (msg->data), payload, payload_size);
+
+    hdr = (struct nlmsghdr *) msg->data;
+    hdr->nlmsg_len = msg->len;
+    hdr->nlmsg_type = type;
+    hdr->nlmsg_flags = NLM_F_REQUEST | NLM_F_ACK | extra_flags;
+    return msg;
+}
+
 static void
 netlink_message_free (NetlinkMessage *msg)
 {
@@ -188,16 +240,20 @@ netlink_message_free (NetlinkMessage *msg)
 typedef struct {
     MbimNetPortManager *manager;
     guint32             sequence_id;
-    GSource            *timeout_source;
+    MbimTimerQueue     *timer_queue;
+    MbimTimer          *timer;
     GTask              *completion_task;
 } Transaction;
 
-static gboolean
+static void
 transaction_timed_out (Transaction *tr)
 {
     GTask *task;
     guint32 sequence_id;
 
+    /* The timer is disposed by the queue once expired */
+    tr->timer = NULL;
+
     task = g_steal_pointer (&tr->completion_task);
     sequence_id = tr->sequence_id;
 
@@ -211,7 +267,6 @@ transaction_timed_out (Transaction *tr)
                              sequence_id);
 
     g_object_unref (task);
-    return G_SOURCE_REMOVE;
 }
 
 static void
@@ -260,8 +315,11 @@ static void
 transaction_free (Transaction *tr)
 {
     g_assert (tr->completion_task == NULL);
-    g_source_destroy (tr->timeout_source);
-    g_source_unref (tr->timeout_source);
+    if (tr->timer_queue) {
+        if (tr->timer)
+            mbim_timer_queue_remove (tr->timer_queue, tr->timer);
+        mbim_timer_queue_unref (tr->timer_queue);
+    }
     g_slice_free (Transaction, tr);
 }
 
@@ -278,13 +336,11 @@ transaction_new (MbimNetPortManager *manager,
     tr->sequence_id = ++manager->priv->current_sequence_id;
     netlink_message_header (msg)->msghdr.nlmsg_seq = tr->sequence_id;
     if (timeout) {
-        tr->timeout_source = g_timeout_source_new_seconds (timeout);
-        g_source_set_callback (tr->timeout_source,
-                               (GSourceFunc) transaction_timed_out,
-                               tr,
-                               NULL);
-        g_source_attach (tr->timeout_source,
-                         g_main_context_get_thread_default ());
+        tr->timer_queue = mbim_timer_queue_ref_for_context (g_main_context_get_thread_default ());
+        tr->timer = mbim_timer_queue_add (tr->timer_queue,
+                                          timeout * 1000,
+                                          (MbimTimerFunc) transaction_timed_out,
+                                          tr);
     }
     tr->completion_task = g_object_ref (task);
 
@@ -358,38 +414,323 @@ netlink_message_del_link (guint ifindex)
 }
 
 /*****************************************************************************/
+/* Link cache */
+
+typedef struct {
+    guint  ifindex;
+    guint  parent_ifindex;
+    gchar *ifname;
+} Link;
+
+static void
+link_free (Link *link)
+{
+    g_free (link->ifname);
+    g_slice_free (Link, link);
+}
+
+static void
+links_cache_set_parent (MbimNetPortManager *self,
+                        Link               *link,
+                        guint               parent_ifindex)
+{
+    GPtrArray *uppers;
+
+    if (link->parent_ifindex == parent_ifindex)
+        return;
+
+    if (link->parent_ifindex) {
+        uppers = g_hash_table_lookup (self->priv->uppers, GUINT_TO_POINTER (link->parent_ifindex));
+        g_assert (uppers);
+        g_ptr_array_remove_fast (uppers, link);
+        if (!uppers->len)
+            g_hash_table_remove (self->priv->uppers, GUINT_TO_POINTER (link->parent_ifindex));
+    }
+
+    link->parent_ifindex = parent_ifindex;
+
+    if (link->parent_ifindex) {
+        uppers = g_hash_table_lookup (self->priv->uppers, GUINT_TO_POINTER (link->parent_ifindex));
+        if (!uppers) {
+            uppers = g_ptr_array_new ();
+            g_hash_table_insert (self->priv->uppers, GUINT_TO_POINTER (link->parent_ifindex), uppers);
+        }
+        g_ptr_array_add (uppers, link);
+    }
+}
 
 static gboolean
-netlink_message_cb (GSocket                *socket,
-                    GIOCondition            condition,
-                    MbimNetPortManager *self)
+links_cache_is_upper (MbimNetPortManager *self,
+                      Link               *link)
 {
-    GError          *error = NULL;
-    gchar            buf[512];
-    int              bytes_received;
-    unsigned int     buffer_len;
-    struct nlmsghdr *hdr;
+    Link *parent;
 
-    if (condition & G_IO_HUP || condition & G_IO_ERR) {
-        g_warning ("[netlink] socket connection closed.");
-        return G_SOURCE_REMOVE;
+    if (!link->parent_ifindex)
+        return FALSE;
+    parent = g_hash_table_lookup (self->priv->links, GUINT_TO_POINTER (link->parent_ifindex));
+    return (parent && g_strcmp0 (parent->ifname, self->priv->iface) == 0);
+}
+
+static void
+links_cache_update (MbimNetPortManager *self,
+                    guint               ifindex,
+                    guint               parent_ifindex,
+                    const gchar        *ifname,
+                    gboolean            notify)
+{
+    Link     *link;
+    gboolean  added = FALSE;
+
+    link = g_hash_table_lookup (self->priv->links, GUINT_TO_POINTER (ifindex));
+    if (!link) {
+        link = g_slice_new0 (Link);
+        link->ifindex = ifindex;
+        g_hash_table_insert (self->priv->links, GUINT_TO_POINTER (ifindex), link);
+        added = TRUE;
     }
 
-    bytes_received = g_socket_receive (socket, buf, sizeof (buf), NULL, &error);
+    if (g_strcmp0 (link->ifname, ifname) != 0) {
+        if (link->ifname && g_hash_table_lookup (self->priv->links_by_name, link->ifname) == link)
+            g_hash_table_remove (self->priv->links_by_name, link->ifname);
+        g_free (link->ifname);
+        link->ifname = g_strdup (ifname);
+        g_hash_table_insert (self->priv->links_by_name, link->ifname, link);
+    }
 
-    if (bytes_received < 0) {
-        g_warning ("[netlink] socket i/o failure: %s", error->message);
-        g_error_free (error);
-        return G_SOURCE_REMOVE;
+    links_cache_set_parent (self, link, parent_ifindex);
+
+    if (added && notify && links_cache_is_upper (self, link)) {
+        if (_mbim_utils_trace_enabled (MBIM_TRACE_CATEGORY_NETLINK))
+            g_debug ("[netlink] link %s added", link->ifname);
+        g_signal_emit (self, signals[SIGNAL_LINK_ADDED], 0, link->ifname);
+    }
+}
+
+static void
+links_cache_remove (MbimNetPortManager *self,
+                    guint               ifindex,
+                    gboolean            notify)
+{
+    Link     *link;
+    gboolean  upper;
+
+    link = g_hash_table_lookup (self->priv->links, GUINT_TO_POINTER (ifindex));
+    if (!link)
+        return;
+
+    upper = links_cache_is_upper (self, link);
+    links_cache_set_parent (self, link, 0);
+    if (g_hash_table_lookup (self->priv->links_by_name, link->ifname) == link)
+        g_hash_table_remove (self->priv->links_by_name, link->ifname);
+    g_hash_table_steal (self->priv->links, GUINT_TO_POINTER (ifindex));
+
+    if (upper && notify) {
+        if (_mbim_utils_trace_enabled (MBIM_TRACE_CATEGORY_NETLINK))
+            g_debug ("[netlink] link %s removed", link->ifname);
+        g_signal_emit (self, signals[SIGNAL_LINK_REMOVED], 0, link->ifname);
+    }
+    link_free (link);
+}
+
+static void
+links_cache_process_message (MbimNetPortManager *self,
+                             struct nlmsghdr    *hdr,
+                             gboolean            notify)
+{
+    struct ifinfomsg *ifi;
+    struct rtattr    *attr;
+    gint              attr_len;
+    const gchar      *ifname = NULL;
+    guint             parent_ifindex = 0;
+
+    if (hdr->nlmsg_len < NLMSG_LENGTH (sizeof (struct ifinfomsg)))
+        return;
+
+    ifi = NLMSG_DATA (hdr);
+    if (hdr->nlmsg_type == RTM_DELLINK) {
+        links_cache_remove (self, ifi->ifi_index, notify);
+        return;
+    }
+
+    attr_len = IFLA_PAYLOAD (hdr);
+    for (attr = IFLA_RTA (ifi); RTA_OK (attr, attr_len); attr = RTA_NEXT (attr, attr_len)) {
+        switch (attr->rta_type) {
+        case IFLA_IFNAME:
+            /* The string is NUL-terminated */
+            ifname = (const gchar *) RTA_DATA (attr);
+            break;
+        case IFLA_LINK:
+            if (RTA_PAYLOAD (attr) >= sizeof (guint32))
+                memcpy (&parent_ifindex, RTA_DATA (attr), sizeof (guint32));
+            break;
+        default:
+            break;
+        }
+    }
+
+    if (!ifname)
+        return;
+
+    /* Links report themselves as parent when they have none */
+    if (parent_ifindex == (guint) ifi->ifi_index)
+        parent_ifindex = 0;
+
+    links_cache_update (self, ifi->ifi_index, parent_ifindex, ifname, notify);
+}
+
+/* Returns the size of the datagram received, or a negative errno value */
+static gssize
+netlink_receive (gint        fd,
+                 GByteArray *buffer,
+                 gint        flags)
+{
+    gssize size;
+
+    /* Peek the size of the next datagram, so that it's never truncated */
+    size = recv (fd, NULL, 0, MSG_PEEK | MSG_TRUNC | flags);
+    if (size >= 0) {
+        g_byte_array_set_size (buffer, MAX (size, NETLINK_BUFFER_SIZE));
+        size = recv (fd, buffer->data, buffer->len, flags);
+    }
+
+    if (size < 0) {
+        size = -errno;
+        g_byte_array_set_size (buffer, 0);
+        return size;
+    }
+
+    g_byte_array_set_size (buffer, size);
+    return size;
+}
+
+/* The initial contents of the cache are loaded with a link dump done in a
+ * separate socket, so that it doesn't get mixed with the notifications and
+ * acknowledgements received in the main one */
+static gboolean
+links_cache_load (MbimNetPortManager  *self,
+                  GError             **error)
+{
+    g_autoptr(GByteArray)  buffer = NULL;
+    NetlinkMessage        *msg;
+    NetlinkHeader         *hdr;
+    gint                   fd;
+    gboolean               done = FALSE;
+    gboolean               success = TRUE;
+
+    g_hash_table_remove_all (self->priv->uppers);
+    g_hash_table_remove_all (self->priv->links_by_name);
+    g_hash_table_remove_all (self->priv->links);
+
+    fd = socket (AF_NETLINK, SOCK_DGRAM | SOCK_CLOEXEC, NETLINK_ROUTE);
+    if (fd < 0) {
+        g_set_error (error, MBIM_CORE_ERROR, MBIM_CORE_ERROR_FAILED,
+                     "Failed to create netlink socket: %s", g_strerror (errno));
+        return FALSE;
+    }
+
+    msg = netlink_message_new (RTM_GETLINK, 0);
+    hdr = netlink_message_header (msg);
+    hdr->msghdr.nlmsg_flags = NLM_F_REQUEST | NLM_F_DUMP;
+    hdr->msghdr.nlmsg_seq = 1;
+    if (send (fd, msg->data, msg->len, 0) < 0) {
+        g_set_error (error, MBIM_CORE_ERROR, MBIM_CORE_ERROR_FAILED,
+                     "Failed to request link dump: %s", g_strerror (errno));
+        netlink_message_free (msg);
+        close (fd);
+        return FALSE;
+    }
+    netlink_message_free (msg);
+
+    buffer = g_byte_array_new ();
+    while (success && !done) {
+        struct nlmsghdr *nlh;
+        guint            len;
+        gssize           received;
+
+        received = netlink_receive (fd, buffer, 0);
+        if (received == -EINTR)
+            continue;
+        if (received < 0) {
+            g_set_error (error, MBIM_CORE_ERROR, MBIM_CORE_ERROR_FAILED,
+                         "Failed to receive link dump: %s", g_strerror (-received));
+            success = FALSE;
+            break;
+        }
+
+        /* The dump reply is multipart (NLM_F_MULTI), and spans as many
+         * datagrams as needed until NLMSG_DONE is received */
+        len = buffer->len;
+        for (nlh = (struct nlmsghdr *) buffer->data; NLMSG_OK (nlh, len); nlh = NLMSG_NEXT (nlh, len)) {
+            if (nlh->nlmsg_seq != 1)
+                continue;
+            if (nlh->nlmsg_type == NLMSG_DONE) {
+                done = TRUE;
+                break;
+            }
+            if (nlh->nlmsg_type == NLMSG_ERROR) {
+                struct nlmsgerr *err;
+
+                err = NLMSG_DATA (nlh);
+                g_set_error (error, MBIM_CORE_ERROR, MBIM_CORE_ERROR_FAILED,
+                             "Link dump failed: %s", g_strerror (-err->error));
+                success = FALSE;
+                break;
+            }
+            if (nlh->nlmsg_type == RTM_NEWLINK)
+                links_cache_process_message (self, nlh, FALSE);
+        }
     }
 
-    buffer_len = (unsigned int ) bytes_received;
-    for (hdr = (struct nlmsghdr *) buf; NLMSG_OK (hdr, buffer_len);
-         NLMSG_NEXT (hdr, buffer_len)) {
-        Transaction     *tr;
-        struct nlmsgerr *err;
+    close (fd);
+
+    if (!success) {
+        g_hash_table_remove_all (self->priv->uppers);
+        g_hash_table_remove_all (self->priv->links_by_name);
+        g_hash_table_remove_all (self->priv->links);
+        return FALSE;
+    }
+
+    g_debug ("[netlink] link cache loaded with %u links", g_hash_table_size (self->priv->links));
+    return TRUE;
+}
+
+static guint
+lookup_ifindex (MbimNetPortManager *self,
+                const gchar        *ifname)
+{
+    Link *link;
+
+    if (!self->priv->links_cached)
+        return if_nametoindex (ifname);
+
+    link = g_hash_table_lookup (self->priv->links_by_name, ifname);
+    return link ? link->ifindex : 0;
+}
+
+/*****************************************************************************/
+
+static void
+netlink_process_datagram (MbimNetPortManager *self,
+                          GByteArray         *buffer)
+{
+    unsigned int     buffer_len;
+    struct nlmsghdr *hdr;
+
+    buffer_len = buffer->len;
+    for (hdr = (struct nlmsghdr *) buffer->data; NLMSG_OK (hdr, buffer_len);
+         hdr = NLMSG_NEXT (hdr, buffer_len)) {
+        Transaction *tr;
+        gint         saved_errno = 0;
+
+        if (hdr->nlmsg_type == RTM_NEWLINK || hdr->nlmsg_type == RTM_DELLINK) {
+            if (self->priv->links_cached)
+                links_cache_process_message (self, hdr, TRUE);
+            continue;
+        }
 
-        if (hdr->nlmsg_type != NLMSG_ERROR)
+        /* Transactions are completed either with an acknowledgement, or with
+         * the end of a multipart reply */
+        if (hdr->nlmsg_type != NLMSG_ERROR && hdr->nlmsg_type != NLMSG_DONE)
             continue;
 
         tr = g_hash_table_lookup (self->priv->transactions,
@@ -397,9 +738,72 @@ netlink_message_cb (GSocket                *socket,
         if (!tr)
             continue;
 
-        err = NLMSG_DATA (buf);
-        transaction_complete (tr, err->error);
+        if (hdr->nlmsg_type == NLMSG_ERROR) {
+            if (hdr->nlmsg_len >= NLMSG_LENGTH (sizeof (struct nlmsgerr)))
+                saved_errno = -((struct nlmsgerr *) NLMSG_DATA (hdr))->error;
+            else
+                saved_errno = EBADMSG;
+        } else if (hdr->nlmsg_len >= NLMSG_LENGTH (sizeof (gint))) {
+            gint done_error;
+
+            memcpy (&done_error, NLMSG_DATA (hdr), sizeof (gint));
+            saved_errno = -done_error;
+        }
+
+        transaction_complete (tr, saved_errno);
+    }
+}
+
+static gboolean
+netlink_message_cb (GSocket                *socket,
+                    GIOCondition            condition,
+                    MbimNetPortManager *self)
+{
+    guint i;
+
+    if (condition & G_IO_HUP || condition & G_IO_ERR) {
+        g_warning ("[netlink] socket connection closed.");
+        return G_SOURCE_REMOVE;
+    }
+
+    /* Completing transactions may end up disposing the manager */
+    g_object_ref (self);
+
+    /* Drain all the datagrams already queued, with a limit so that a burst of
+     * notifications doesn't block the main context for too long */
+    for (i = 0; i < NETLINK_MAX_DATAGRAMS_PER_DISPATCH; i++) {
+        gssize received;
+
+        received = netlink_receive (g_socket_get_fd (socket), self->priv->buffer, MSG_DONTWAIT);
+        if (received == -EINTR)
+            continue;
+        if (received == -EAGAIN || received == -EWOULDBLOCK)
+            break;
+
+        /* If notifications were lost, the cache needs to be fully reloaded */
+        if (received == -ENOBUFS) {
+            g_autoptr(GError) error = NULL;
+
+            if (self->priv->links_cached) {
+                g_debug ("[netlink] link notifications lost, reloading link cache");
+                if (!links_cache_load (self, &error)) {
+                    g_debug ("[netlink] link cache disabled: %s", error->message);
+                    self->priv->links_cached = FALSE;
+                }
+            }
+            continue;
+        }
+
+        if (received < 0) {
+            g_warning ("[netlink] socket i/o failure: %s", g_strerror (-received));
+            g_object_unref (self);
+            return G_SOURCE_REMOVE;
+        }
+
+        netlink_process_datagram (self, self->priv->buffer);
     }
+
+    g_object_unref (self);
     return G_SOURCE_CONTINUE;
 }
 
@@ -408,15 +812,26 @@ netlink_message_cb (GSocket                *socket,
 static gboolean
 get_first_free_session_id (MbimNetPortManager *self,
                            const gchar        *ifname_prefix,
+                           guint               first,
+                           GArray             *reserved,
                            guint              *session_id)
 {
     guint i;
 
-    for (i = MBIM_DEVICE_SESSION_ID_MIN; i <= MBIM_DEVICE_SESSION_ID_MAX; i++) {
+    for (i = first; i <= MBIM_DEVICE_SESSION_ID_MAX; i++) {
         g_autofree gchar *ifname = NULL;
+        guint             j;
+
+        /* Skip the ones already requested by other links in the same batch */
+        for (j = 0; reserved && j < reserved->len; j++) {
+            if (g_array_index (reserved, guint, j) == i)
+                break;
+        }
+        if (reserved && j < reserved->len)
+            continue;
 
         ifname = session_id_to_ifname (ifname_prefix, i);
-        if (!if_nametoindex (ifname)) {
+        if (!lookup_ifindex (self, ifname)) {
             *session_id = i;
             return TRUE;
         }
@@ -484,7 +899,7 @@ mbim_net_port_manager_add_link (MbimNetPortManager  *self,
     g_task_set_task_data (task, ctx, (GDestroyNotify) add_link_context_free);
 
     if (ctx->session_id == MBIM_DEVICE_SESSION_ID_AUTOMATIC) {
-        if (!get_first_free_session_id (self, ifname_prefix, &ctx->session_id)) {
+        if (!get_first_free_session_id (self, ifname_prefix, MBIM_DEVICE_SESSION_ID_MIN, NULL, &ctx->session_id)) {
             g_task_return_new_error (task, MBIM_CORE_ERROR, MBIM_CORE_ERROR_FAILED,
                                      "Failed to find an available session ID");
             g_object_unref (task);
@@ -503,7 +918,7 @@ mbim_net_port_manager_add_link (MbimNetPortManager  *self,
         return;
     }
 
-    base_if_index = if_nametoindex (base_ifname);
+    base_if_index = lookup_ifindex (self, base_ifname);
     if (!base_if_index) {
         g_task_return_new_error (task, MBIM_CORE_ERROR, MBIM_CORE_ERROR_FAILED,
                                  "%s interface is not available",
@@ -557,7 +972,7 @@ mbim_net_port_manager_del_link (MbimNetPortManager  *self,
 
     task = g_task_new (self, cancellable, callback, user_data);
 
-    ifindex = if_nametoindex (ifname);
+    ifindex = lookup_ifindex (self, ifname);
     if (ifindex == 0) {
         g_task_return_new_error (task, MBIM_CORE_ERROR, MBIM_CORE_ERROR_FAILED,
                                  "Failed to retrieve interface index for interface %s",
@@ -584,87 +999,560 @@ mbim_net_port_manager_del_link (MbimNetPortManager  *self,
 }
 
 /*****************************************************************************/
+/* Batched link operations
+ *
+ * All the netlink requests of a batch are sent together in one single
+ * datagram, each one with its own transaction, and the operation completes
+ * once all the transactions have been acknowledged. */
 
-gboolean
-mbim_net_port_manager_list_links (MbimNetPortManager  *self,
-                                  const gchar         *base_ifname,
-                                  GPtrArray          **out_links,
-                                  GError             **error)
+typedef struct {
+    GTask  *task;
+    guint   n_pending;
+    GError *error;
+} LinkBatch;
+
+static void
+link_batch_item_ready (MbimNetPortManager *self,
+                       GAsyncResult       *res,
+                       LinkBatch          *batch)
 {
-    g_autoptr(GFile)  sysfs_file = NULL;
-    g_autofree gchar *sysfs_path = NULL;
+    GError   *error = NULL;
+    gboolean  exists_ok;
+
+    exists_ok = GPOINTER_TO_UINT (g_task_get_task_data (G_TASK (res)));
+
+    /* Only the first error is reported */
+    if (!g_task_propagate_boolean (G_TASK (res), &error)) {
+        if (exists_ok && g_error_matches (error, G_IO_ERROR, G_IO_ERROR_EXISTS))
+            g_clear_error (&error);
+        else if (!batch->error)
+            batch->error = error;
+        else
+            g_error_free (error);
+    }
 
-    sysfs_path = g_strdup_printf ("/sys/class/net/%s", base_ifname);
-    sysfs_file = g_file_new_for_path (sysfs_path);
+    g_assert (batch->n_pending > 0);
+    if (--batch->n_pending > 0)
+        return;
 
-    return mbim_helpers_list_links (sysfs_file, NULL, NULL, out_links, error);
+    if (batch->error)
+        g_task_return_error (batch->task, batch->error);
+    else
+        g_task_return_boolean (batch->task, TRUE);
+    g_object_unref (batch->task);
+    g_slice_free (LinkBatch, batch);
 }
 
-/*****************************************************************************/
+/* Takes ownership of the task, which is completed once all the messages have
+ * been acknowledged */
+static void
+link_batch_send (MbimNetPortManager *self,
+                 GPtrArray          *msgs,
+                 guint               timeout,
+                 GTask              *task)
+{
+    LinkBatch             *batch;
+    g_autoptr(GByteArray)  buffer = NULL;
+    g_autoptr(GPtrArray)   transactions = NULL;
+    GError                *error = NULL;
+    guint                  i;
+
+    if (msgs->len == 0) {
+        g_task_return_boolean (task, TRUE);
+        g_object_unref (task);
+        return;
+    }
+
+    batch = g_slice_new0 (LinkBatch);
+    batch->task = task;
+    batch->n_pending = msgs->len;
+
+    buffer = g_byte_array_new ();
+    transactions = g_ptr_array_sized_new (msgs->len);
+    for (i = 0; i < msgs->len; i++) {
+        NetlinkMessage *msg;
+        GTask          *item;
+
+        msg = g_ptr_array_index (msgs, i);
+        item = g_task_new (self,
+                           g_task_get_cancellable (task),
+                           (GAsyncReadyCallback) link_batch_item_ready,
+                           batch);
+        /* Exclusive creations fail if the same object is already there, e.g.
+         * when applying the same settings again, which is not an error */
+        g_task_set_task_data (item,
+                              GUINT_TO_POINTER (!!(netlink_message_header (msg)->msghdr.nlmsg_flags & NLM_F_EXCL)),
+                              NULL);
+        g_ptr_array_add (transactions, transaction_new (self, msg, timeout, item));
+        g_object_unref (item);
+
+        /* Each message in the datagram must start aligned */
+        g_byte_array_append (buffer, msg->data, msg->len);
+        g_byte_array_set_size (buffer, NLMSG_ALIGN (buffer->len));
+    }
+
+    if (_mbim_utils_trace_enabled (MBIM_TRACE_CATEGORY_NETLINK))
+        g_debug ("[netlink] sending batch of %u link requests", msgs->len);
+    if (g_socket_send (self->priv->socket,
+                       (const gchar *) buffer->data,
+                       buffer->len,
+                       g_task_get_cancellable (task),
+                       &error) < 0) {
+        for (i = 0; i < transactions->len; i++)
+            transaction_complete_with_error (g_ptr_array_index (transactions, i), g_error_copy (error));
+        g_error_free (error);
+    }
+}
 
 typedef struct {
-    GPtrArray *links;
-    guint      link_i;
-} DelAllLinksContext;
+    GArray    *session_ids;
+    GPtrArray *ifnames;
+} AddLinksContext;
 
 static void
-del_all_links_context_free (DelAllLinksContext *ctx)
+add_links_context_free (AddLinksContext *ctx)
+{
+    g_array_unref (ctx->session_ids);
+    g_ptr_array_unref (ctx->ifnames);
+    g_slice_free (AddLinksContext, ctx);
+}
+
+GPtrArray *
+mbim_net_port_manager_add_links_finish (MbimNetPortManager  *self,
+                                        GArray             **session_ids,
+                                        GAsyncResult        *res,
+                                        GError             **error)
+{
+    AddLinksContext *ctx;
+
+    if (!g_task_propagate_boolean (G_TASK (res), error)) {
+        g_prefix_error (error, "Failed to add links: ");
+        return NULL;
+    }
+
+    ctx = g_task_get_task_data (G_TASK (res));
+    if (session_ids)
+        *session_ids = g_array_ref (ctx->session_ids);
+    return g_ptr_array_ref (ctx->ifnames);
+}
+
+void
+mbim_net_port_manager_add_links (MbimNetPortManager  *self,
+                                 const guint         *session_ids,
+                                 guint                n_session_ids,
+                                 const gchar         *base_ifname,
+                                 const gchar         *ifname_prefix,
+                                 guint                timeout,
+                                 GCancellable        *cancellable,
+                                 GAsyncReadyCallback  callback,
+                                 gpointer             user_data)
 {
-    g_clear_pointer (&ctx->links, g_ptr_array_unref);
-    g_slice_free (DelAllLinksContext, ctx);
+    GTask                *task;
+    AddLinksContext      *ctx;
+    g_autoptr(GPtrArray)  msgs = NULL;
+    guint                 base_if_index;
+    guint                 next_free;
+    guint                 i;
+
+    task = g_task_new (self, cancellable, callback, user_data);
+
+    ctx = g_slice_new0 (AddLinksContext);
+    ctx->session_ids = g_array_sized_new (FALSE, FALSE, sizeof (guint), n_session_ids);
+    ctx->ifnames = g_ptr_array_new_with_free_func (g_free);
+    g_task_set_task_data (task, ctx, (GDestroyNotify) add_links_context_free);
+
+    /* validate interface to use */
+    if (g_strcmp0 (self->priv->iface, base_ifname) != 0) {
+        g_task_return_new_error (task, MBIM_CORE_ERROR, MBIM_CORE_ERROR_FAILED,
+                                 "Invalid network interface %s: expected %s",
+                                 base_ifname, self->priv->iface);
+        g_object_unref (task);
+        return;
+    }
+
+    base_if_index = lookup_ifindex (self, base_ifname);
+    if (!base_if_index) {
+        g_task_return_new_error (task, MBIM_CORE_ERROR, MBIM_CORE_ERROR_FAILED,
+                                 "%s interface is not available",
+                                 base_ifname);
+        g_object_unref (task);
+        return;
+    }
+
+    /* Dynamic session ids are allocated in increasing order, so the search for
+     * the next one always goes on from where the previous one was found. The
+     * session ids explicitly requested in the batch are never used as dynamic
+     * ones. */
+    next_free = MBIM_DEVICE_SESSION_ID_MIN;
+    for (i = 0; i < n_session_ids; i++) {
+        guint session_id;
+
+        session_id = session_ids[i];
+        if (session_id == MBIM_DEVICE_SESSION_ID_AUTOMATIC) {
+            g_autoptr(GArray) reserved = NULL;
+            guint             j;
+
+            reserved = g_array_new (FALSE, FALSE, sizeof (guint));
+            g_array_append_vals (reserved, ctx->session_ids->data, ctx->session_ids->len);
+            for (j = i + 1; j < n_session_ids; j++) {
+                if (session_ids[j] != MBIM_DEVICE_SESSION_ID_AUTOMATIC)
+                    g_array_append_val (reserved, session_ids[j]);
+            }
+
+            if (!get_first_free_session_id (self, ifname_prefix, next_free, reserved, &session_id)) {
+                g_task_return_new_error (task, MBIM_CORE_ERROR, MBIM_CORE_ERROR_FAILED,
+                                         "Failed to find an available session ID");
+                g_object_unref (task);
+                return;
+            }
+            next_free = session_id + 1;
+        }
+
+        g_array_append_val (ctx->session_ids, session_id);
+        g_ptr_array_add (ctx->ifnames, session_id_to_ifname (ifname_prefix, session_id));
+    }
+
+    msgs = g_ptr_array_new_with_free_func ((GDestroyNotify) netlink_message_free);
+    for (i = 0; i < ctx->session_ids->len; i++)
+        g_ptr_array_add (msgs, netlink_message_new_link (g_array_index (ctx->session_ids, guint, i),
+                                                         g_ptr_array_index (ctx->ifnames, i),
+                                                         base_if_index));
+
+    link_batch_send (self, msgs, timeout, task);
 }
 
 gboolean
-mbim_net_port_manager_del_all_links_finish (MbimNetPortManager  *self,
-                                            GAsyncResult       *res,
-                                            GError            **error)
+mbim_net_port_manager_del_links_finish (MbimNetPortManager  *self,
+                                        GAsyncResult        *res,
+                                        GError             **error)
 {
     return g_task_propagate_boolean (G_TASK (res), error);
 }
 
-static void delete_next_link (GTask *task);
+void
+mbim_net_port_manager_del_links (MbimNetPortManager  *self,
+                                 const gchar * const *ifnames,
+                                 guint                timeout,
+                                 GCancellable        *cancellable,
+                                 GAsyncReadyCallback  callback,
+                                 gpointer             user_data)
+{
+    GTask                *task;
+    g_autoptr(GPtrArray)  msgs = NULL;
+    guint                 i;
+
+    task = g_task_new (self, cancellable, callback, user_data);
 
-static void
-port_manager_del_link_ready (MbimNetPortManager *self,
-                             GAsyncResult      *res,
-                             GTask             *task)
+    msgs = g_ptr_array_new_with_free_func ((GDestroyNotify) netlink_message_free);
+    for (i = 0; ifnames && ifnames[i]; i++) {
+        guint ifindex;
+
+        ifindex = lookup_ifindex (self, ifnames[i]);
+        if (ifindex == 0) {
+            g_task_return_new_error (task, MBIM_CORE_ERROR, MBIM_CORE_ERROR_FAILED,
+                                     "Failed to retrieve interface index for interface %s",
+                                     ifnames[i]);
+            g_object_unref (task);
+            return;
+        }
+        g_ptr_array_add (msgs, netlink_message_del_link (ifindex));
+    }
+
+    link_batch_send (self, msgs, timeout, task);
+}
+
+/*****************************************************************************/
+/* IP configuration
+ *
+ * The settings reported in an IP Configuration response are applied in one
+ * single batch, in the order in which they depend on each other: the link
+ * setup (MTU and administrative state) first, then the addresses, and then
+ * the default routes through the gateways reached with those addresses. */
+
+static NetlinkMessage *
+netlink_message_set_link_up (guint   ifindex,
+                             guint32 mtu)
+{
+    NetlinkMessage *msg;
+
+    g_assert (ifindex != 0);
+
+    msg = netlink_message_new (RTM_NEWLINK, 0);
+    netlink_message_header (msg)->ifreq.ifi_index = ifindex;
+    netlink_message_header (msg)->ifreq.ifi_flags = IFF_UP;
+    netlink_message_header (msg)->ifreq.ifi_change = IFF_UP;
+    if (mtu)
+        append_netlink_attribute_uint32 (msg, IFLA_MTU, mtu);
+
+    return msg;
+}
+
+static NetlinkMessage *
+netlink_message_new_address (guint         ifindex,
+                             guchar        family,
+                             const guint8 *address,
+                             gushort       address_size,
+                             guint         prefix_length)
 {
-    DelAllLinksContext *ctx;
-    GError             *error = NULL;
+    NetlinkMessage   *msg;
+    struct ifaddrmsg  ifa;
+
+    memset (&ifa, 0, sizeof (ifa));
+    ifa.ifa_family = family;
+    ifa.ifa_prefixlen = prefix_length;
+    ifa.ifa_scope = RT_SCOPE_UNIVERSE;
+    ifa.ifa_index = ifindex;
+    /* There is no one else in the network to detect duplicates with */
+    if (family == AF_INET6)
+        ifa.ifa_flags = IFA_F_NODAD;
+
+    msg = netlink_message_new_with_payload (RTM_NEWADDR, NLM_F_CREATE | NLM_F_REPLACE, &ifa, sizeof (ifa));
+    append_netlink_attribute (msg, IFA_LOCAL, address, address_size);
+    append_netlink_attribute (msg, IFA_ADDRESS, address, address_size);
 
-    ctx = g_task_get_task_data (task);
+    return msg;
+}
+
+/* Same default as for WWAN devices in NetworkManager, so that the routes
+ * through the modem are less preferred than the ones through wired or
+ * wireless interfaces, which use lower metrics */
+#define DEFAULT_ROUTE_METRIC 700
 
-    if (!mbim_net_port_manager_del_link_finish (self, res, &error)) {
+static NetlinkMessage *
+netlink_message_new_default_route (guint         ifindex,
+                                   guchar        family,
+                                   const guint8 *gateway,
+                                   gushort       gateway_size,
+                                   guint32       metric)
+{
+    NetlinkMessage *msg;
+    struct rtmsg    rtm;
+
+    memset (&rtm, 0, sizeof (rtm));
+    rtm.rtm_family = family;
+    rtm.rtm_table = RT_TABLE_MAIN;
+    rtm.rtm_protocol = RTPROT_STATIC;
+    rtm.rtm_scope = RT_SCOPE_UNIVERSE;
+    rtm.rtm_type = RTN_UNICAST;
+    /* The IPv4 gateway is not always within the subnet of the address */
+    if (family == AF_INET)
+        rtm.rtm_flags = RTNH_F_ONLINK;
+
+    /* Never replace an existing default route, e.g. the one through a wired
+     * or wireless interface, which the kernel would do with any other one
+     * with the same metric, whatever its gateway or interface */
+    msg = netlink_message_new_with_payload (RTM_NEWROUTE, NLM_F_CREATE | NLM_F_EXCL, &rtm, sizeof (rtm));
+    append_netlink_attribute (msg, RTA_GATEWAY, gateway, gateway_size);
+    append_netlink_attribute_uint32 (msg, RTA_OIF, ifindex);
+    append_netlink_attribute_uint32 (msg, RTA_PRIORITY, metric ? metric : DEFAULT_ROUTE_METRIC);
+
+    return msg;
+}
+
+static gboolean
+address_is_unspecified (const guint8 *address,
+                        gsize         address_size)
+{
+    gsize i;
+
+    for (i = 0; i < address_size; i++) {
+        if (address[i])
+            return FALSE;
+    }
+    return TRUE;
+}
+
+gboolean
+mbim_net_port_manager_configure_link_finish (MbimNetPortManager  *self,
+                                             GAsyncResult        *res,
+                                             GError             **error)
+{
+    if (!g_task_propagate_boolean (G_TASK (res), error)) {
+        g_prefix_error (error, "Failed to configure link: ");
+        return FALSE;
+    }
+    return TRUE;
+}
+
+void
+mbim_net_port_manager_configure_link (MbimNetPortManager  *self,
+                                      const gchar         *ifname,
+                                      const MbimMessage   *ip_configuration,
+                                      guint32              route_metric,
+                                      guint                timeout,
+                                      GCancellable        *cancellable,
+                                      GAsyncReadyCallback  callback,
+                                      gpointer             user_data)
+{
+    GTask                            *task;
+    GError                           *error = NULL;
+    g_autoptr(GPtrArray)              msgs = NULL;
+    g_autoptr(MbimIPv4ElementArray)   ipv4_address = NULL;
+    g_autoptr(MbimIPv6ElementArray)   ipv6_address = NULL;
+    MbimIPConfigurationAvailableFlag  ipv4_available;
+    MbimIPConfigurationAvailableFlag  ipv6_available;
+    guint32                           ipv4_address_count;
+    guint32                           ipv6_address_count;
+    const MbimIPv4                   *ipv4_gateway;
+    const MbimIPv6                   *ipv6_gateway;
+    guint32                           ipv4_mtu;
+    guint32                           ipv6_mtu;
+    guint32                           mtu = 0;
+    guint                             ifindex;
+    guint                             i;
+
+    task = g_task_new (self, cancellable, callback, user_data);
+
+    ifindex = lookup_ifindex (self, ifname);
+    if (ifindex == 0) {
+        g_task_return_new_error (task, MBIM_CORE_ERROR, MBIM_CORE_ERROR_FAILED,
+                                 "Failed to retrieve interface index for interface %s",
+                                 ifname);
+        g_object_unref (task);
+        return;
+    }
+
+    if (!mbim_message_ip_configuration_response_parse (
+            ip_configuration,
+            NULL, /* session_id */
+            &ipv4_available,
+            &ipv6_available,
+            &ipv4_address_count,
+            &ipv4_address,
+            &ipv6_address_count,
+            &ipv6_address,
+            &ipv4_gateway,
+            &ipv6_gateway,
+            NULL, /* ipv4_dns_server_count */
+            NULL, /* ipv4_dns_server */
+            NULL, /* ipv6_dns_server_count */
+            NULL, /* ipv6_dns_server */
+            &ipv4_mtu,
+            &ipv6_mtu,
+            &error)) {
         g_task_return_error (task, error);
         g_object_unref (task);
         return;
     }
 
-    g_ptr_array_remove_index_fast (ctx->links, 0);
-    delete_next_link (task);
+    /* There is one single MTU for the link; prefer the IPv4 one if both are
+     * given, as the IPv6 one would not be applicable if lower than 1280 */
+    if (ipv4_available & MBIM_IP_CONFIGURATION_AVAILABLE_FLAG_MTU)
+        mtu = ipv4_mtu;
+    else if (ipv6_available & MBIM_IP_CONFIGURATION_AVAILABLE_FLAG_MTU)
+        mtu = ipv6_mtu;
+
+    msgs = g_ptr_array_new_with_free_func ((GDestroyNotify) netlink_message_free);
+    g_ptr_array_add (msgs, netlink_message_set_link_up (ifindex, mtu));
+
+    if ((ipv4_available & MBIM_IP_CONFIGURATION_AVAILABLE_FLAG_ADDRESS) && ipv4_address) {
+        for (i = 0; i < ipv4_address_count; i++)
+            g_ptr_array_add (msgs, netlink_message_new_address (ifindex,
+                                                                AF_INET,
+                                                                ipv4_address[i]->ipv4_address.addr,
+                                                                sizeof (MbimIPv4),
+                                                                ipv4_address[i]->on_link_prefix_length));
+    }
+    if ((ipv6_available & MBIM_IP_CONFIGURATION_AVAILABLE_FLAG_ADDRESS) && ipv6_address) {
+        for (i = 0; i < ipv6_address_count; i++)
+            g_ptr_array_add (msgs, netlink_message_new_address (ifindex,
+                                                                AF_INET6,
+                                                                ipv6_address[i]->ipv6_address.addr,
+                                                                sizeof (MbimIPv6),
+                                                                ipv6_address[i]->on_link_prefix_length));
+    }
+
+    if ((ipv4_available & MBIM_IP_CONFIGURATION_AVAILABLE_FLAG_GATEWAY) &&
+        ipv4_gateway && !address_is_unspecified (ipv4_gateway->addr, sizeof (MbimIPv4)))
+        g_ptr_array_add (msgs, netlink_message_new_default_route (ifindex,
+                                                                  AF_INET,
+                                                                  ipv4_gateway->addr,
+                                                                  sizeof (MbimIPv4),
+                                                                  route_metric));
+    if ((ipv6_available & MBIM_IP_CONFIGURATION_AVAILABLE_FLAG_GATEWAY) &&
+        ipv6_gateway && !address_is_unspecified (ipv6_gateway->addr, sizeof (MbimIPv6)))
+        g_ptr_array_add (msgs, netlink_message_new_default_route (ifindex,
+                                                                  AF_INET6,
+                                                                  ipv6_gateway->addr,
+                                                                  sizeof (MbimIPv6),
+                                                                  route_metric));
+
+    link_batch_send (self, msgs, timeout, task);
 }
 
-static void
-delete_next_link (GTask *task)
+/*****************************************************************************/
+
+static gint
+link_name_cmp (const gchar **a,
+               const gchar **b)
 {
-    MbimNetPortManager *self;
-    DelAllLinksContext *ctx;
+    return g_ascii_strcasecmp (*a, *b);
+}
 
-    self = g_task_get_source_object (task);
-    ctx = g_task_get_task_data (task);
+gboolean
+mbim_net_port_manager_list_links (MbimNetPortManager  *self,
+                                  const gchar         *base_ifname,
+                                  GPtrArray          **out_links,
+                                  GError             **error)
+{
+    g_autoptr(GFile)  sysfs_file = NULL;
+    g_autofree gchar *sysfs_path = NULL;
 
-    if (!ctx->links || ctx->links->len == 0) {
-        g_task_return_boolean (task, TRUE);
-        g_object_unref (task);
-        return;
+    if (self->priv->links_cached) {
+        Link      *base;
+        GPtrArray *uppers;
+        GPtrArray *links;
+        guint      i;
+
+        base = g_hash_table_lookup (self->priv->links_by_name, base_ifname);
+        if (!base) {
+            g_set_error (error, MBIM_CORE_ERROR, MBIM_CORE_ERROR_FAILED,
+                         "%s interface is not available", base_ifname);
+            return FALSE;
+        }
+
+        uppers = g_hash_table_lookup (self->priv->uppers, GUINT_TO_POINTER (base->ifindex));
+        if (!uppers) {
+            *out_links = NULL;
+            return TRUE;
+        }
+
+        links = g_ptr_array_new_full (uppers->len, g_free);
+        for (i = 0; i < uppers->len; i++)
+            g_ptr_array_add (links, g_strdup (((Link *) g_ptr_array_index (uppers, i))->ifname));
+        g_ptr_array_sort (links, (GCompareFunc) link_name_cmp);
+        *out_links = links;
+        return TRUE;
     }
 
-    mbim_net_port_manager_del_link (self,
-                                    g_ptr_array_index (ctx->links, 0),
-                                    5,
-                                    g_task_get_cancellable (task),
-                                    (GAsyncReadyCallback)port_manager_del_link_ready,
-                                    task);
+    sysfs_path = g_strdup_printf ("/sys/class/net/%s", base_ifname);
+    sysfs_file = g_file_new_for_path (sysfs_path);
+
+    return mbim_helpers_list_links (sysfs_file, NULL, NULL, out_links, error);
+}
+
+/*****************************************************************************/
+
+gboolean
+mbim_net_port_manager_del_all_links_finish (MbimNetPortManager  *self,
+                                            GAsyncResult       *res,
+                                            GError            **error)
+{
+    return g_task_propagate_boolean (G_TASK (res), error);
+}
+
+static void
+port_manager_del_links_ready (MbimNetPortManager *self,
+                              GAsyncResult       *res,
+                              GTask              *task)
+{
+    GError *error = NULL;
+
+    if (!mbim_net_port_manager_del_links_finish (self, res, &error))
+        g_task_return_error (task, error);
+    else
+        g_task_return_boolean (task, TRUE);
+    g_object_unref (task);
 }
 
 void
@@ -674,21 +1562,32 @@ mbim_net_port_manager_del_all_links (MbimNetPortManager   *self,
                                      GAsyncReadyCallback   callback,
                                      gpointer              user_data)
 {
-    GTask              *task;
-    DelAllLinksContext *ctx;
-    GError             *error = NULL;
+    GTask                *task;
+    g_autoptr(GPtrArray)  links = NULL;
+    GError               *error = NULL;
 
     task = g_task_new (self, cancellable, callback, user_data);
-    ctx = g_slice_new0 (DelAllLinksContext);
-    g_task_set_task_data (task, ctx, (GDestroyNotify)del_all_links_context_free);
 
-    if (!mbim_net_port_manager_list_links (self, base_ifname, &ctx->links, &error)) {
+    if (!mbim_net_port_manager_list_links (self, base_ifname, &links, &error)) {
         g_task_return_error (task, error);
         g_object_unref (task);
         return;
     }
 
-    delete_next_link (task);
+    if (!links || links->len == 0) {
+        g_task_return_boolean (task, TRUE);
+        g_object_unref (task);
+        return;
+    }
+
+    /* Delete all links at once */
+    g_ptr_array_add (links, NULL);
+    mbim_net_port_manager_del_links (self,
+                                     (const gchar * const *) links->pdata,
+                                     5,
+                                     cancellable,
+                                     (GAsyncReadyCallback) port_manager_del_links_ready,
+                                     task);
 }
 
 /*****************************************************************************/
@@ -701,6 +1600,8 @@ mbim_net_port_manager_new (const gchar  *iface,
     gint                socket_fd;
     GSocket            *gsocket;
     GError             *inner_error = NULL;
+    struct sockaddr_nl  addr;
+    gboolean            subscribed;
 
     socket_fd = socket (AF_NETLINK, SOCK_DGRAM, NETLINK_ROUTE);
     if (socket_fd < 0) {
@@ -709,6 +1610,15 @@ mbim_net_port_manager_new (const gchar  *iface,
         return NULL;
     }
 
+    /* Subscribe to link notifications, before loading the link cache so that
+     * no change is lost */
+    memset (&addr, 0, sizeof (addr));
+    addr.nl_family = AF_NETLINK;
+    addr.nl_groups = RTMGRP_LINK;
+    subscribed = (bind (socket_fd, (struct sockaddr *) &addr, sizeof (addr)) == 0);
+    if (!subscribed)
+        g_debug ("[netlink] couldn't subscribe to link notifications: %s", g_strerror (errno));
+
     gsocket = g_socket_new_from_fd (socket_fd, &inner_error);
     if (inner_error) {
         g_debug ("Could not create socket: %s", inner_error->message);
@@ -736,6 +1646,15 @@ mbim_net_port_manager_new (const gchar  *iface,
                                NULL,
                                (GDestroyNotify) transaction_free);
 
+    if (subscribed) {
+        if (links_cache_load (self, &inner_error))
+            self->priv->links_cached = TRUE;
+        else {
+            g_debug ("[netlink] link cache disabled: %s", inner_error->message);
+            g_clear_error (&inner_error);
+        }
+    }
+
     return self;
 }
 
@@ -743,6 +1662,11 @@ static void
 mbim_net_port_manager_init (MbimNetPortManager *self)
 {
     self->priv = G_TYPE_INSTANCE_GET_PRIVATE (self, MBIM_TYPE_NET_PORT_MANAGER, MbimNetPortManagerPrivate);
+
+    self->priv->buffer = g_byte_array_sized_new (NETLINK_BUFFER_SIZE);
+    self->priv->links = g_hash_table_new_full (g_direct_hash, g_direct_equal, NULL, (GDestroyNotify) link_free);
+    self->priv->links_by_name = g_hash_table_new (g_str_hash, g_str_equal);
+    self->priv->uppers = g_hash_table_new_full (g_direct_hash, g_direct_equal, NULL, (GDestroyNotify) g_ptr_array_unref);
 }
 
 static void
@@ -752,6 +1676,15 @@ finalize (GObject *object)
 
     g_assert (g_hash_table_size (self->priv->transactions) == 0);
     g_hash_table_unref (self->priv->transactions);
+    if (self->priv->source) {
+        g_source_destroy (self->priv->source);
+        g_source_unref (self->priv->source);
+    }
+    g_clear_object (&self->priv->socket);
+    g_byte_array_unref (self->priv->buffer);
+    g_hash_table_unref (self->priv->uppers);
+    g_hash_table_unref (self->priv->links_by_name);
+    g_hash_table_unref (self->priv->links);
     g_free (self->priv->iface);
 
     G_OBJECT_CLASS (mbim_net_port_manager_parent_class)->finalize (object);
@@ -765,4 +1698,32 @@ mbim_net_port_manager_class_init (MbimNetPortManagerClass *klass)
     g_type_class_add_private (object_class, sizeof (MbimNetPortManagerPrivate));
 
     object_class->finalize = finalize;
+
+    /* Emitted with the name of the link, when a link is added on top of the
+     * managed interface */
+    signals[SIGNAL_LINK_ADDED] =
+        g_signal_new ("link-added",
+                      G_OBJECT_CLASS_TYPE (G_OBJECT_CLASS (klass)),
+                      G_SIGNAL_RUN_LAST,
+                      0,
+                      NULL,
+                      NULL,
+                      NULL,
+                      G_TYPE_NONE,
+                      1,
+                      G_TYPE_STRING);
+
+    /* Emitted with the name of the link, when a link on top of the managed
+     * interface is removed */
+    signals[SIGNAL_LINK_REMOVED] =
+        g_signal_new ("link-removed",
+                      G_OBJECT_CLASS_TYPE (G_OBJECT_CLASS (klass)),
+                      G_SIGNAL_RUN_LAST,
+                      0,
+                      NULL,
+                      NULL,
+                      NULL,
+                      G_TYPE_NONE,
+                      1,
+                      G_TYPE_STRING);
 }
@@ -30,6 +30,8 @@
 #include <gio/gio.h>
 #include <glib-object.h>
 
+#include "mbim-message.h"
+
 #define MBIM_TYPE_NET_PORT_MANAGER            (mbim_net_port_manager_get_type ())
 #define MBIM_NET_PORT_MANAGER(obj)            (G_TYPE_CHECK_INSTANCE_CAST ((obj), MBIM_TYPE_NET_PORT_MANAGER, MbimNetPortManager))
 #define MBIM_NET_PORT_MANAGER_CLASS(klass)    (G_TYPE_CHECK_CLASS_CAST ((klass),  MBIM_TYPE_NET_PORT_MANAGER, MbimNetPortManagerClass))
@@ -84,6 +86,30 @@ gboolean  mbim_net_port_manager_del_link_finish (MbimNetPortManager   *self,
                                                  GAsyncResult         *res,
                                                  GError              **error);
 
+void       mbim_net_port_manager_add_links        (MbimNetPortManager   *self,
+                                                   const guint          *session_ids,
+                                                   guint                 n_session_ids,
+                                                   const gchar          *base_ifname,
+                                                   const gchar          *ifname_prefix,
+                                                   guint                 timeout,
+                                                   GCancellable         *cancellable,
+                                                   GAsyncReadyCallback   callback,
+                                                   gpointer              user_data);
+GPtrArray *mbim_net_port_manager_add_links_finish (MbimNetPortManager   *self,
+                                                   GArray              **session_ids,
+                                                   GAsyncResult         *res,
+                                                   GError              **error);
+
+void      mbim_net_port_manager_del_links        (MbimNetPortManager   *self,
+                                                  const gchar * const  *ifnames,
+                                                  guint                 timeout,
+                                                  GCancellable         *cancellable,
+                                                  GAsyncReadyCallback   callback,
+                                                  gpointer              user_data);
+gboolean  mbim_net_port_manager_del_links_finish (MbimNetPortManager   *self,
+                                                  GAsyncResult         *res,
+                                                  GError              **error);
+
 void      mbim_net_port_manager_del_all_links        (MbimNetPortManager   *self,
                                                       const gchar          *base_ifname,
                                                       GCancellable         *cancellable,
@@ -93,4 +119,16 @@ gboolean  mbim_net_port_manager_del_all_links_finish (MbimNetPortManager   *self
                                                       GAsyncResult         *res,
                                                       GError              **error);
 
+void      mbim_net_port_manager_configure_link        (MbimNetPortManager   *self,
+                                                      const gchar          *ifname,
+                                                      const MbimMessage    *ip_configuration,
+                                                      guint32               route_metric,
+                                                      guint                 timeout,
+                                                      GCancellable         *cancellable,
+                                                      GAsyncReadyCallback   callback,
+                                                      gpointer              user_data);
+gboolean  mbim_net_port_manager_configure_link_finish (MbimNetPortManager   *self,
+                                                      GAsyncResult         *res,
+                                                      GError              **error);
+
 #endif /* _LIBMBIM_GLIB_MBIM_NET_PORT_MANAGER_H_ */
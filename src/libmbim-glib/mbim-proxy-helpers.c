@@ -414,3 +414,213 @@ _mbim_proxy_helper_service_subscribe_list_new_standard (gsize *out_size)
     *out_size = i;
     return out;
 }
+
+/*****************************************************************************/
+
+void
+_mbim_proxy_helper_service_cid_key_init (MbimProxyServiceCidKey *key,
+                                         const MbimUuid         *service_id,
+                                         guint32                 cid)
+{
+    memcpy (&key->service_id, service_id, sizeof (MbimUuid));
+    key->cid = cid;
+}
+
+guint
+_mbim_proxy_helper_service_cid_key_hash (gconstpointer v)
+{
+    const MbimProxyServiceCidKey *key = v;
+    const guint8                 *bytes;
+    guint                         hash;
+    guint                         i;
+
+    hash = key->cid;
+    bytes = (const guint8 *) &key->service_id;
+    for (i = 0; i < sizeof (MbimUuid); i++)
+        hash = (hash * 31) + bytes[i];
+    return hash;
+}
+
+gboolean
+_mbim_proxy_helper_service_cid_key_equal (gconstpointer a,
+                                          gconstpointer b)
+{
+    const MbimProxyServiceCidKey *key_a = a;
+    const MbimProxyServiceCidKey *key_b = b;
+
+    return (key_a->cid == key_b->cid && mbim_uuid_cmp (&key_a->service_id, &key_b->service_id));
+}
+
+/*****************************************************************************/
+
+struct _MbimProxySubscribeTable {
+    /* MbimProxyServiceCidKey -> number of lists including it (guint *) */
+    GHashTable *keys;
+};
+
+MbimProxySubscribeTable *
+_mbim_proxy_helper_subscribe_table_new (void)
+{
+    MbimProxySubscribeTable *table;
+
+    table = g_slice_new (MbimProxySubscribeTable);
+    table->keys = g_hash_table_new_full (_mbim_proxy_helper_service_cid_key_hash,
+                                        _mbim_proxy_helper_service_cid_key_equal,
+                                        g_free,
+                                        g_free);
+    return table;
+}
+
+void
+_mbim_proxy_helper_subscribe_table_free (MbimProxySubscribeTable *table)
+{
+    g_hash_table_unref (table->keys);
+    g_slice_free (MbimProxySubscribeTable, table);
+}
+
+/* Returns TRUE if the set of keys in the table changed */
+static gboolean
+subscribe_table_update_key (MbimProxySubscribeTable *table,
+                            const MbimUuid          *service_id,
+                            guint32                  cid,
+                            gboolean                 add)
+{
+    MbimProxyServiceCidKey  key;
+    guint                  *count;
+
+    _mbim_proxy_helper_service_cid_key_init (&key, service_id, cid);
+    count = g_hash_table_lookup (table->keys, &key);
+
+    if (add) {
+        if (count) {
+            (*count)++;
+            return FALSE;
+        }
+        count = g_new (guint, 1);
+        *count = 1;
+        g_hash_table_insert (table->keys, g_memdup (&key, sizeof (key)), count);
+        return TRUE;
+    }
+
+    /* Only lists previously added may be removed */
+    g_return_val_if_fail (count != NULL, FALSE);
+    if (--(*count) > 0)
+        return FALSE;
+    g_hash_table_remove (table->keys, &key);
+    return TRUE;
+}
+
+static gboolean
+subscribe_table_update (MbimProxySubscribeTable      *table,
+                        const MbimEventEntry * const *list,
+                        gsize                         list_size,
+                        gboolean                      add)
+{
+    gboolean changed = FALSE;
+    gsize    i;
+    guint32  j;
+
+    for (i = 0; i < list_size; i++) {
+        MbimService id;
+
+        /* standard services are always enabled */
+        id = mbim_uuid_to_service (&list[i]->device_service_id);
+        if (id >= MBIM_SERVICE_BASIC_CONNECT && id <= MBIM_SERVICE_DSS)
+            continue;
+
+        if (list[i]->cids_count == 0) {
+            changed |= subscribe_table_update_key (table, &list[i]->device_service_id, 0, add);
+            continue;
+        }
+
+        for (j = 0; j < list[i]->cids_count; j++)
+            changed |= subscribe_table_update_key (table, &list[i]->device_service_id, list[i]->cids[j], add);
+    }
+
+    return changed;
+}
+
+gboolean
+_mbim_proxy_helper_subscribe_table_add (MbimProxySubscribeTable      *table,
+                                        const MbimEventEntry * const *list,
+                                        gsize                         list_size)
+{
+    return subscribe_table_update (table, list, list_size, TRUE);
+}
+
+gboolean
+_mbim_proxy_helper_subscribe_table_remove (MbimProxySubscribeTable      *table,
+                                           const MbimEventEntry * const *list,
+                                           gsize                         list_size)
+{
+    return subscribe_table_update (table, list, list_size, FALSE);
+}
+
+MbimEventEntry **
+_mbim_proxy_helper_subscribe_table_build (MbimProxySubscribeTable *table,
+                                          gsize                   *out_size)
+{
+    MbimEventEntry         **out;
+    gsize                    n_standard;
+    GPtrArray               *entries;
+    GPtrArray               *all_cids;
+    GHashTableIter           iter;
+    MbimProxyServiceCidKey  *key;
+    guint                    i;
+
+    g_assert (out_size != NULL);
+
+    out = _mbim_proxy_helper_service_subscribe_list_new_standard (&n_standard);
+    if (!g_hash_table_size (table->keys)) {
+        *out_size = n_standard;
+        return out;
+    }
+
+    /* Group the keys by service; the number of non-standard services is
+     * always small */
+    entries = g_ptr_array_new ();
+    all_cids = g_ptr_array_new ();
+    g_hash_table_iter_init (&iter, table->keys);
+    while (g_hash_table_iter_next (&iter, (gpointer *)&key, NULL)) {
+        MbimEventEntry *entry = NULL;
+
+        for (i = 0; i < entries->len; i++) {
+            if (mbim_uuid_cmp (&key->service_id, &((MbimEventEntry *) g_ptr_array_index (entries, i))->device_service_id)) {
+                entry = g_ptr_array_index (entries, i);
+                break;
+            }
+        }
+        if (!entry) {
+            entry = g_new0 (MbimEventEntry, 1);
+            memcpy (&entry->device_service_id, &key->service_id, sizeof (MbimUuid));
+            g_ptr_array_add (entries, entry);
+        }
+
+        if (key->cid == 0) {
+            g_ptr_array_add (all_cids, entry);
+            continue;
+        }
+
+        entry->cids = g_realloc (entry->cids, sizeof (guint32) * (entry->cids_count + 1));
+        entry->cids[entry->cids_count++] = key->cid;
+    }
+
+    /* If all cids are enabled for a service, the specific ones don't matter */
+    for (i = 0; i < all_cids->len; i++) {
+        MbimEventEntry *entry;
+
+        entry = g_ptr_array_index (all_cids, i);
+        g_clear_pointer (&entry->cids, g_free);
+        entry->cids_count = 0;
+    }
+
+    out = g_realloc (out, sizeof (MbimEventEntry *) * (n_standard + entries->len + 1));
+    for (i = 0; i < entries->len; i++)
+        out[n_standard + i] = g_ptr_array_index (entries, i);
+    out[n_standard + entries->len] = NULL;
+    *out_size = n_standard + entries->len;
+
+    g_ptr_array_unref (all_cids);
+    g_ptr_array_unref (entries);
+    return out;
+}
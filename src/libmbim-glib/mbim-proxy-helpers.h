@@ -56,6 +56,36 @@ MbimEventEntry **_mbim_proxy_helper_service_subscribe_list_dup          (MbimEve
                                                                          gsize           *out_size);
 MbimEventEntry **_mbim_proxy_helper_service_subscribe_list_new_standard (gsize           *out_size);
 
+/* Key for tables indexed by service and cid; a cid of 0 stands for all the
+ * cids in the service */
+typedef struct {
+    MbimUuid service_id;
+    guint32  cid;
+} MbimProxyServiceCidKey;
+
+void     _mbim_proxy_helper_service_cid_key_init  (MbimProxyServiceCidKey *key,
+                                                   const MbimUuid         *service_id,
+                                                   guint32                 cid);
+guint    _mbim_proxy_helper_service_cid_key_hash  (gconstpointer           v);
+gboolean _mbim_proxy_helper_service_cid_key_equal (gconstpointer           a,
+                                                   gconstpointer           b);
+
+/* Table with the services and cids requested by a set of subscribe lists,
+ * refcounted so that lists can be added and removed one by one. Standard
+ * services are ignored, as they are always enabled. */
+typedef struct _MbimProxySubscribeTable MbimProxySubscribeTable;
+
+MbimProxySubscribeTable *_mbim_proxy_helper_subscribe_table_new    (void);
+void                     _mbim_proxy_helper_subscribe_table_free   (MbimProxySubscribeTable       *table);
+gboolean                 _mbim_proxy_helper_subscribe_table_add    (MbimProxySubscribeTable       *table,
+                                                                    const MbimEventEntry * const  *list,
+                                                                    gsize                          list_size);
+gboolean                 _mbim_proxy_helper_subscribe_table_remove (MbimProxySubscribeTable       *table,
+                                                                    const MbimEventEntry * const  *list,
+                                                                    gsize                          list_size);
+MbimEventEntry         **_mbim_proxy_helper_subscribe_table_build  (MbimProxySubscribeTable       *table,
+                                                                    gsize                         *out_size);
+
 G_END_DECLS
 
 #endif /* _LIBMBIM_GLIB_MBIM_PROXY_HELPERS_H_ */
@@ -35,6 +35,7 @@
 #include "config.h"
 #include "mbim-device.h"
 #include "mbim-utils.h"
+#include "mbim-utils-private.h"
 #include "mbim-helpers.h"
 #include "mbim-proxy.h"
 #include "mbim-message-private.h"
@@ -42,7 +43,10 @@
 #include "mbim-enum-types.h"
 #include "mbim-error-types.h"
 #include "mbim-basic-connect.h"
+#include "mbim-proxy-control.h"
 #include "mbim-proxy-helpers.h"
+#include "mbim-statistics.h"
+#include "mbim-indication-filter.h"
 
 /* The mbim-proxy may be used for bulk data transfer, such as modem
  * firmware upgrade, and the BUFFER_SIZE should be at least equal
@@ -51,6 +55,20 @@
  */
 #define BUFFER_SIZE 4096
 
+/* Maximum amount of data read from a client at once, when completing a
+ * message bigger than BUFFER_SIZE */
+#define MAX_READ_SIZE (16 * BUFFER_SIZE)
+
+/* Maximum number of messages pending to be written to a client before new
+ * indications for that client start to be dropped */
+#define CLIENT_OUTPUT_QUEUE_MAX_INDICATIONS 64
+
+/* The timeout needs to be big enough for any kind of transaction to complete,
+ * otherwise the remote clients will lose the reply if they configured a
+ * timeout bigger than this internal one. Clients may request a different one
+ * in the proxy configuration. */
+#define DEFAULT_COMMAND_TIMEOUT_SECS 300
+
 G_DEFINE_TYPE (MbimProxy, mbim_proxy, G_TYPE_OBJECT)
 
 enum {
@@ -63,15 +81,36 @@ enum {
 static GParamSpec *properties[PROP_LAST];
 
 struct _MbimProxyPrivate {
+    MbimProxyFlags flags;
+
+    /* Context where the proxy was created */
+    GMainContext *main_context;
+
     /* Unix socket service */
     GSocketService *socket_service;
 
-    /* Clients */
-    GList *clients;
+    /* Protects the client, device and worker lists, which may be
+     * accessed from the device worker threads */
+    GMutex lock;
+
+    /* Clients, each one holding a full reference */
+    GHashTable *clients;
+
+    /* Devices, by path, each one holding a full reference */
+    GHashTable *devices;
+
+    /* Devices being opened, and bring-up time metrics: when the first one
+     * started to be opened, and how many have been opened since then */
+    GHashTable *opening_devices;
+    gint64      bringup_started;
+    guint       bringup_n_devices;
 
-    /* Devices */
-    GList *devices;
-    GList *opening_devices;
+    /* Device worker threads, by path */
+    GHashTable *workers;
+
+    /* Protects the statistics of clients and devices, which are updated in
+     * the thread where each of them runs but may be queried from any other */
+    GMutex stats_lock;
 };
 
 static void        track_device         (MbimProxy *self, MbimDevice *device);
@@ -83,19 +122,168 @@ static MbimDevice *peek_device_for_path (MbimProxy *self, const gchar *path);
 guint
 mbim_proxy_get_n_clients (MbimProxy *self)
 {
+    guint n_clients;
+
     g_return_val_if_fail (MBIM_IS_PROXY (self), 0);
 
-    return g_list_length (self->priv->clients);
+    g_mutex_lock (&self->priv->lock);
+    n_clients = g_hash_table_size (self->priv->clients);
+    g_mutex_unlock (&self->priv->lock);
+    return n_clients;
 }
 
 guint
 mbim_proxy_get_n_devices (MbimProxy *self)
 {
+    guint n_devices;
+
     g_return_val_if_fail (MBIM_IS_PROXY (self), 0);
 
-    return g_list_length (self->priv->devices);
+    g_mutex_lock (&self->priv->lock);
+    n_devices = g_hash_table_size (self->priv->devices);
+    g_mutex_unlock (&self->priv->lock);
+    return n_devices;
+}
+
+typedef struct {
+    MbimProxy  *self;
+    GParamSpec *pspec;
+} NotifyContext;
+
+static gboolean
+notify_in_main_context_cb (NotifyContext *ctx)
+{
+    g_object_notify_by_pspec (G_OBJECT (ctx->self), ctx->pspec);
+    g_object_unref (ctx->self);
+    g_slice_free (NotifyContext, ctx);
+    return G_SOURCE_REMOVE;
+}
+
+static void
+proxy_notify (MbimProxy  *self,
+              GParamSpec *pspec)
+{
+    NotifyContext *ctx;
+    GSource       *source;
+
+    if (!(self->priv->flags & MBIM_PROXY_FLAGS_DEVICE_THREADS)) {
+        g_object_notify_by_pspec (G_OBJECT (self), pspec);
+        return;
+    }
+
+    /* Property changes are always notified in the context of the proxy, never
+     * in the device worker threads */
+    ctx = g_slice_new (NotifyContext);
+    ctx->self = g_object_ref (self);
+    ctx->pspec = pspec;
+    source = g_idle_source_new ();
+    g_source_set_callback (source, (GSourceFunc) notify_in_main_context_cb, ctx, NULL);
+    g_source_attach (source, self->priv->main_context);
+    g_source_unref (source);
+}
+
+/*****************************************************************************/
+/* Device worker threads */
+
+typedef struct {
+    gchar        *path;
+    GMainContext *context;
+    GMainLoop    *loop;
+    GThread      *thread;
+} DeviceWorker;
+
+static gpointer
+device_worker_thread_func (DeviceWorker *worker)
+{
+    g_main_context_push_thread_default (worker->context);
+    g_main_loop_run (worker->loop);
+    g_main_context_pop_thread_default (worker->context);
+    return NULL;
+}
+
+static void
+device_worker_free (DeviceWorker *worker)
+{
+    g_main_loop_quit (worker->loop);
+    g_thread_join (worker->thread);
+    g_main_loop_unref (worker->loop);
+    g_main_context_unref (worker->context);
+    g_free (worker->path);
+    g_slice_free (DeviceWorker, worker);
+}
+
+static DeviceWorker *
+device_worker_get_for_path (MbimProxy   *self,
+                            const gchar *path)
+{
+    DeviceWorker *worker;
+
+    g_mutex_lock (&self->priv->lock);
+
+    worker = g_hash_table_lookup (self->priv->workers, path);
+
+    /* Workers are kept around until the proxy is disposed, so that all the
+     * clients and devices for the same path always end up in the same thread */
+    if (!worker) {
+        g_debug ("[%s] creating device worker thread...", path);
+        worker = g_slice_new0 (DeviceWorker);
+        worker->path = g_strdup (path);
+        worker->context = g_main_context_new ();
+        worker->loop = g_main_loop_new (worker->context, FALSE);
+        worker->thread = g_thread_new ("mbim-proxy-device", (GThreadFunc)device_worker_thread_func, worker);
+        g_hash_table_insert (self->priv->workers, worker->path, worker);
+    }
+
+    g_mutex_unlock (&self->priv->lock);
+
+    return worker;
+}
+
+/*****************************************************************************/
+/* Statistics, kept both per client and per device */
+
+typedef struct {
+    guint64              forwarded_requests;
+    guint                in_flight_requests;
+    /* Time between receiving the request and sending back the response */
+    MbimLatencyHistogram forward_latency;
+    guint64              indications_forwarded;
+    guint64              indications_dropped;
+    /* Requests for which no response could be sent back */
+    guint64              responses_dropped;
+    guint32              subscribed_services;
+    guint32              subscribed_cids;
+} ForwardStatistics;
+
+static void
+forward_statistics_set_subscribed (ForwardStatistics     *stats,
+                                   MbimEventEntry *const *array,
+                                   gsize                  array_size)
+{
+    gsize i;
+
+    stats->subscribed_services = (array ? array_size : 0);
+    stats->subscribed_cids = 0;
+    for (i = 0; array && i < array_size; i++)
+        stats->subscribed_cids += array[i]->cids_count;
+}
+
+static void
+forward_statistics_update_subscribed (MbimProxy             *self,
+                                      ForwardStatistics     *stats,
+                                      MbimEventEntry *const *array,
+                                      gsize                  array_size)
+{
+    g_mutex_lock (&self->priv->stats_lock);
+    forward_statistics_set_subscribed (stats, array, array_size);
+    g_mutex_unlock (&self->priv->stats_lock);
 }
 
+static ForwardStatistics *device_forward_statistics_get  (MbimDevice        *device);
+static gboolean           device_forward_statistics_peek (MbimDevice        *device,
+                                                          ForwardStatistics *out_stats,
+                                                          guint64           *out_indications);
+
 /*****************************************************************************/
 /* Client info */
 
@@ -107,25 +295,90 @@ typedef struct {
     GSocketConnection *connection;
     GSource *connection_readable_source;
     GByteArray *buffer;
+    /* Whether the connection preserves message boundaries */
+    gboolean seqpacket;
+
+    /* ClientOutput items pending to be written, the first one possibly
+     * partially */
+    GQueue output_queue;
+    gsize output_offset;
+    GSource *connection_writable_source;
 
     /* Only one proxy config allowed at a time */
     gboolean config_ongoing;
 
+    /* Timeout of the commands forwarded to the device */
+    guint32 command_timeout_secs;
+
+    /* Cancelled as soon as the client is untracked, so that all its requests
+     * are released in the device right away */
+    GCancellable *cancellable;
+
+    /* Worker thread where the client is handled, if any, and the proxy config
+     * request to complete there once the client has been moved */
+    DeviceWorker *worker;
+    gpointer      migrate_request;
+
     MbimDevice *device;
-    guint indication_id;
     MbimEventEntry **mbim_event_entry_array;
     gsize mbim_event_entry_array_size;
+
+    /* Indication policies requested by the client, if any */
+    MbimIndicationFilter *indication_filter;
+
+    /* Statistics, protected by the stats lock */
+    ForwardStatistics stats;
+    guint64           bytes_received;
+    guint64           bytes_sent;
 } Client;
 
 static gboolean connection_readable_cb (GSocket *socket, GIOCondition condition, Client *client);
 static void     track_client           (MbimProxy *self, Client *client);
 static void     untrack_client         (MbimProxy *self, Client *client);
 
+static void device_index_add_client    (Client *client);
+static void device_index_remove_client (Client *client);
+static void device_clients_add         (Client *client);
+static void device_clients_remove      (Client *client);
+
+static void release_client_coalesced_queries (Client *client);
+
+/* Messages are shared among clients, and with the device, so they are never
+ * modified when forwarded; instead, each client output keeps its own copy
+ * of the header, with the transaction ID that client expects, which is
+ * written in place of the original one. */
+typedef struct {
+    MbimMessage   *message;
+    struct header  header;
+} ClientOutput;
+
+static ClientOutput *
+client_output_new (MbimMessage *message,
+                   guint32      transaction_id)
+{
+    ClientOutput *output;
+
+    output = g_slice_new (ClientOutput);
+    output->message = mbim_message_ref (message);
+    memcpy (&output->header, message->data, sizeof (struct header));
+    output->header.transaction_id = GUINT32_TO_LE (transaction_id);
+    return output;
+}
+
+static void
+client_output_free (ClientOutput *output)
+{
+    mbim_message_unref (output->message);
+    g_slice_free (ClientOutput, output);
+}
+
 static void
 client_disconnect (Client *client)
 {
+    device_index_remove_client (client);
     g_clear_pointer (&client->mbim_event_entry_array, mbim_event_entry_array_free);
     client->mbim_event_entry_array_size = 0;
+    forward_statistics_update_subscribed (client->self, &client->stats, NULL, 0);
 
     if (client->connection_readable_source) {
         g_source_destroy (client->connection_readable_source);
@@ -133,6 +386,20 @@ client_disconnect (Client *client)
         client->connection_readable_source = 0;
     }
 
+    if (client->connection_writable_source) {
+        g_source_destroy (client->connection_writable_source);
+        g_source_unref (client->connection_writable_source);
+        client->connection_writable_source = NULL;
+    }
+
+    /* Indications held back are lost as well */
+    g_clear_pointer (&client->indication_filter, mbim_indication_filter_free);
+
+    /* Whatever was pending to be written is lost */
+    while (!g_queue_is_empty (&client->output_queue))
+        client_output_free (g_queue_pop_head (&client->output_queue));
+    client->output_offset = 0;
+
     if (client->connection) {
         g_debug ("[client %lu] connection closed", client->id);
         g_output_stream_close (g_io_stream_get_output_stream (G_IO_STREAM (client->connection)), NULL, NULL);
@@ -141,29 +408,29 @@ client_disconnect (Client *client)
     }
 }
 
-static void client_indication_cb (MbimDevice *device,
-                                  MbimMessage *message,
-                                  Client *client);
-
 static void
 client_set_device (Client *client,
                    MbimDevice *device)
 {
+    MbimDevice *previous;
+
     if (client->device) {
-        if (g_signal_handler_is_connected (client->device, client->indication_id))
-            g_signal_handler_disconnect (client->device, client->indication_id);
-        g_object_unref (client->device);
+        device_index_remove_client (client);
+        device_clients_remove (client);
     }
 
+    /* The device of the client is also read when querying statistics */
+    g_mutex_lock (&client->self->priv->stats_lock);
+    previous = client->device;
+    client->device = (device ? g_object_ref (device) : NULL);
+    g_mutex_unlock (&client->self->priv->stats_lock);
+
+    if (previous)
+        g_object_unref (previous);
+
     if (device) {
-        client->device = g_object_ref (device);
-        client->indication_id = g_signal_connect (client->device,
-                                                  MBIM_DEVICE_SIGNAL_INDICATE_STATUS,
-                                                  G_CALLBACK (client_indication_cb),
-                                                  client);
-    } else {
-        client->device = NULL;
-        client->indication_id = 0;
+        device_clients_add (client);
+        device_index_add_client (client);
     }
 }
 
@@ -182,6 +449,7 @@ client_unref (Client *client)
         if (client->mbim_event_entry_array)
             mbim_event_entry_array_free (client->mbim_event_entry_array);
 
+        g_object_unref (client->cancellable);
         g_slice_free (Client, client);
     }
 }
@@ -193,9 +461,85 @@ client_ref (Client *client)
     return client;
 }
 
+static gboolean connection_writable_cb (GSocket *socket, GIOCondition condition, Client *client);
+
+static gboolean
+client_output_flush (Client  *client,
+                     GError **error)
+{
+    GSocket      *socket;
+    ClientOutput *output;
+
+    socket = g_socket_connection_get_socket (client->connection);
+
+    /* Write as much as possible without blocking */
+    while ((output = g_queue_peek_head (&client->output_queue)) != NULL) {
+        g_autoptr(GError) inner_error = NULL;
+        GOutputVector     vectors[2];
+        guint             n_vectors = 0;
+        MbimMessage      *message;
+        gssize            written;
+
+        /* Header and body are written with a single call, so that the message
+         * is still sent in a single packet in SOCK_SEQPACKET sockets */
+        message = output->message;
+        if (client->output_offset < sizeof (struct header)) {
+            vectors[n_vectors].buffer = ((const guint8 *) &output->header) + client->output_offset;
+            vectors[n_vectors].size = sizeof (struct header) - client->output_offset;
+            n_vectors++;
+        }
+        if (message->len > MAX (client->output_offset, sizeof (struct header))) {
+            vectors[n_vectors].buffer = &message->data[MAX (client->output_offset, sizeof (struct header))];
+            vectors[n_vectors].size = message->len - MAX (client->output_offset, sizeof (struct header));
+            n_vectors++;
+        }
+
+        written = g_socket_send_message (socket,
+                                         NULL,
+                                         vectors,
+                                         n_vectors,
+                                         NULL,
+                                         0,
+                                         0,
+                                         NULL,
+                                         &inner_error);
+        if (written < 0) {
+            if (g_error_matches (inner_error, G_IO_ERROR, G_IO_ERROR_WOULD_BLOCK))
+                break;
+            g_propagate_prefixed_error (error, g_steal_pointer (&inner_error), "Cannot send message to client: ");
+            return FALSE;
+        }
+
+        g_mutex_lock (&client->self->priv->stats_lock);
+        client->bytes_sent += written;
+        g_mutex_unlock (&client->self->priv->stats_lock);
+
+        client->output_offset += written;
+        if (client->output_offset < message->len)
+            continue;
+
+        client_output_free (g_queue_pop_head (&client->output_queue));
+        client->output_offset = 0;
+    }
+
+    /* Wait until the socket is writable if there is still data pending */
+    if (!g_queue_is_empty (&client->output_queue) && !client->connection_writable_source) {
+        client->connection_writable_source = g_socket_create_source (socket, G_IO_OUT, NULL);
+        g_source_set_callback (client->connection_writable_source,
+                               (GSourceFunc)connection_writable_cb,
+                               client,
+                               NULL);
+        g_source_attach (client->connection_writable_source, g_main_context_get_thread_default ());
+    }
+
+    return TRUE;
+}
+
 static gboolean
 client_send_message (Client       *client,
                      MbimMessage  *message,
+                     guint32       transaction_id,
+                     gboolean      indication,
                      GError      **error)
 {
     if (!client->connection) {
@@ -206,17 +550,26 @@ client_send_message (Client       *client,
         return FALSE;
     }
 
-    if (!g_output_stream_write_all (g_io_stream_get_output_stream (G_IO_STREAM (client->connection)),
-                                    message->data,
-                                    message->len,
-                                    NULL, /* bytes_written */
-                                    NULL, /* cancellable */
-                                    error)) {
-        g_prefix_error (error, "Cannot send message to client: ");
+    /* Clients not reading fast enough won't stall anyone else; they just
+     * start losing indications */
+    if (indication && g_queue_get_length (&client->output_queue) >= CLIENT_OUTPUT_QUEUE_MAX_INDICATIONS) {
+        g_set_error (error,
+                     MBIM_CORE_ERROR,
+                     MBIM_CORE_ERROR_WOULD_BLOCK,
+                     "Cannot send message: too many messages pending (%u)",
+                     g_queue_get_length (&client->output_queue));
         return FALSE;
     }
 
-    return TRUE;
+    /* The message buffer is shared, not copied; this allows the same
+     * indication or response to be queued for all clients at once */
+    g_queue_push_tail (&client->output_queue, client_output_new (message, transaction_id));
+
+    /* If already waiting for the socket to be writable, we're done */
+    if (client->connection_writable_source)
+        return TRUE;
+
+    return client_output_flush (client, error);
 }
 
 /*****************************************************************************/
@@ -226,21 +579,31 @@ static void
 track_client (MbimProxy *self,
               Client *client)
 {
-    self->priv->clients = g_list_append (self->priv->clients, client_ref (client));
-    g_object_notify_by_pspec (G_OBJECT (self), properties[PROP_N_CLIENTS]);
+    g_mutex_lock (&self->priv->lock);
+    g_hash_table_add (self->priv->clients, client_ref (client));
+    g_mutex_unlock (&self->priv->lock);
+    proxy_notify (self, properties[PROP_N_CLIENTS]);
 }
 
 static void
 untrack_client (MbimProxy *self,
                 Client *client)
 {
-    /* Disconnect the client explicitly when untracking */
+    gboolean found;
+
+    /* Disconnect the client explicitly when untracking, and abort all its
+     * ongoing requests */
     client_disconnect (client);
+    g_cancellable_cancel (client->cancellable);
+    release_client_coalesced_queries (client);
 
-    if (g_list_find (self->priv->clients, client)) {
-        self->priv->clients = g_list_remove (self->priv->clients, client);
+    g_mutex_lock (&self->priv->lock);
+    found = g_hash_table_remove (self->priv->clients, client);
+    g_mutex_unlock (&self->priv->lock);
+
+    if (found) {
         client_unref (client);
-        g_object_notify_by_pspec (G_OBJECT (self), properties[PROP_N_CLIENTS]);
+        proxy_notify (self, properties[PROP_N_CLIENTS]);
     }
 }
 
@@ -248,55 +611,76 @@ untrack_client (MbimProxy *self,
 /* Client indications */
 
 static void
-forward_indication (Client      *client,
-                    MbimMessage *message)
+client_forward_indication (MbimMessage *message,
+                           Client      *client)
 {
-    g_autoptr(GError) error = NULL;
+    g_autoptr(GError)  error = NULL;
+    ForwardStatistics *device_stats;
+    gboolean           forwarded;
+
+    forwarded = client_send_message (client, message, mbim_message_get_transaction_id (message), TRUE, &error);
+
+    device_stats = device_forward_statistics_get (client->device);
+    g_mutex_lock (&client->self->priv->stats_lock);
+    if (forwarded) {
+        client->stats.indications_forwarded++;
+        device_stats->indications_forwarded++;
+    } else {
+        client->stats.indications_dropped++;
+        device_stats->indications_dropped++;
+    }
+    g_mutex_unlock (&client->self->priv->stats_lock);
+
+    if (forwarded)
+        return;
 
-    if (!client_send_message (client, message, &error))
+    if (g_error_matches (error, MBIM_CORE_ERROR, MBIM_CORE_ERROR_WOULD_BLOCK))
+        g_debug ("[client %lu] indication dropped: %s", client->id, error->message);
+    else
         g_warning ("[client %lu] couldn't forward indication: %s", client->id, error->message);
 }
 
 static void
-client_indication_cb (MbimDevice *device,
-                      MbimMessage *message,
-                      Client *client)
+forward_indication (Client      *client,
+                    MbimMessage *message)
 {
-    MbimEventEntry *entry;
-    guint           i;
-
-    /* if client doesn't have a subscribe list, we're done. */
-    if (!client->mbim_event_entry_array)
+    if (client->indication_filter &&
+        mbim_indication_filter_process (client->indication_filter, message))
         return;
+    client_forward_indication (message, client);
+}
 
-    /* Look for the event list associated to the service */
-    entry = NULL;
-    for (i = 0; i < client->mbim_event_entry_array_size; i++) {
-        if (mbim_uuid_cmp (mbim_message_indicate_status_get_service_id (message),
-                           &client->mbim_event_entry_array[i]->device_service_id)) {
-            entry = client->mbim_event_entry_array[i];
-            break;
-        }
-    }
+static GPtrArray *device_index_lookup (MbimDevice     *device,
+                                       const MbimUuid *service_id,
+                                       guint32         cid);
+static void       device_indication_received (MbimProxy  *self,
+                                              MbimDevice *device);
+static void       state_cache_update_from_indication (MbimProxy   *self,
+                                                      MbimDevice  *device,
+                                                      MbimMessage *indication);
 
-    /* if client didn't subscribe to anything in this service, we're done */
-    if (!entry)
-        return;
+static void
+proxy_device_indication_cb (MbimDevice  *device,
+                            MbimMessage *message,
+                            MbimProxy   *self)
+{
+    const MbimUuid *service_id;
+    GPtrArray      *clients;
+    guint           i;
 
-    /* if client subscribed using the wildcard, no need to match specific cid */
-    if (entry->cids_count == 0) {
-        forward_indication (client, message);
-        return;
-    }
+    service_id = mbim_message_indicate_status_get_service_id (message);
+    device_indication_received (self, device);
+    state_cache_update_from_indication (self, device, message);
 
-    /* Look for the specific cid in the event list */
-    for (i = 0; i < entry->cids_count; i++) {
-        if (mbim_message_indicate_status_get_cid (message) == entry->cids[i]) {
-            /* exact match in the subscription */
-            forward_indication (client, message);
-            return;
-        }
-    }
+    /* Clients subscribed to the specific cid */
+    clients = device_index_lookup (device, service_id, mbim_message_indicate_status_get_cid (message));
+    for (i = 0; clients && i < clients->len; i++)
+        forward_indication ((Client *) g_ptr_array_index (clients, i), message);
+
+    /* Clients subscribed using the wildcard */
+    clients = device_index_lookup (device, service_id, 0);
+    for (i = 0; clients && i < clients->len; i++)
+        forward_indication ((Client *) g_ptr_array_index (clients, i), message);
 }
 
 /*****************************************************************************/
@@ -310,28 +694,65 @@ typedef struct {
     guint32 original_transaction_id;
     /* Only used in proxy config */
     guint32 timeout_secs;
+    gchar *path;
+    /* Only used in coalesced queries */
+    gboolean released;
+    /* Only set in requests forwarded to the device */
+    gint64 forward_time;
 } Request;
 
+static void
+request_forward_statistics_update (Request  *request,
+                                   gboolean  delivered)
+{
+    ForwardStatistics *device_stats;
+    ForwardStatistics *client_stats;
+    gint64             latency;
+
+    latency = g_get_monotonic_time () - request->forward_time;
+    client_stats = &request->client->stats;
+    device_stats = device_forward_statistics_get (request->client->device);
+
+    g_mutex_lock (&request->self->priv->stats_lock);
+    client_stats->in_flight_requests--;
+    device_stats->in_flight_requests--;
+    if (delivered) {
+        mbim_latency_histogram_add (&client_stats->forward_latency, latency);
+        mbim_latency_histogram_add (&device_stats->forward_latency, latency);
+    } else {
+        client_stats->responses_dropped++;
+        device_stats->responses_dropped++;
+    }
+    g_mutex_unlock (&request->self->priv->stats_lock);
+}
+
 static void
 request_complete_and_free (Request *request)
 {
+    gboolean delivered = FALSE;
+
     if (request->response) {
         g_autoptr(GError) error = NULL;
 
         /* Try to send response to client; if it fails, always assume we have
          * to close the connection */
-        if (!client_send_message (request->client, request->response, &error)) {
+        if (!client_send_message (request->client, request->response, request->original_transaction_id, FALSE, &error)) {
             g_warning ("[client %lu,0x%08x] couldn't send response back to client: %s",
                        request->client->id, request->original_transaction_id, error->message);
             /* Disconnect and untrack client */
             untrack_client (request->self, request->client);
-        }
+        } else
+            delivered = TRUE;
 
         mbim_message_unref (request->response);
     }
 
+    if (request->forward_time)
+        request_forward_statistics_update (request, delivered);
+
     if (request->message)
         mbim_message_unref (request->message);
+    g_free (request->path);
     client_unref (request->client);
     g_object_unref (request->self);
     g_slice_free (Request, request);
@@ -353,6 +774,25 @@ request_new (MbimProxy   *self,
     return request;
 }
 
+static void
+request_forward_statistics_start (Request *request)
+{
+    ForwardStatistics *device_stats;
+
+    if (!request->client->device)
+        return;
+
+    request->forward_time = g_get_monotonic_time ();
+    device_stats = device_forward_statistics_get (request->client->device);
+
+    g_mutex_lock (&request->self->priv->stats_lock);
+    request->client->stats.forwarded_requests++;
+    request->client->stats.in_flight_requests++;
+    device_stats->forwarded_requests++;
+    device_stats->in_flight_requests++;
+    g_mutex_unlock (&request->self->priv->stats_lock);
+}
+
 /*****************************************************************************/
 /* Internal proxy device opening operation */
 
@@ -361,18 +801,7 @@ static MbimEventEntry **merge_client_service_subscribe_lists (MbimProxy  *self,
                                                               gsize      *out_size);
 static void             reset_client_service_subscribe_lists (MbimProxy  *self,
                                                               MbimDevice *device);
-
-typedef struct {
-    MbimDevice *device;
-    guint32     timeout_secs;
-} InternalDeviceOpenContext;
-
-static void
-internal_device_open_context_free (InternalDeviceOpenContext *ctx)
-{
-    g_object_unref (ctx->device);
-    g_slice_free (InternalDeviceOpenContext, ctx);
-}
+static void             device_state_cache_clear             (MbimDevice *device);
 
 static gboolean
 internal_device_open_finish (MbimProxy     *self,
@@ -382,9 +811,21 @@ internal_device_open_finish (MbimProxy     *self,
     return g_task_propagate_boolean (G_TASK (res), error);
 }
 
+/* Each device being opened by the proxy goes through its own sequence of
+ * states, independently of any other device being opened at the same time.
+ * Clients requesting to open the same device while the sequence is ongoing
+ * just wait for it to finish. */
+typedef enum {
+    OPENING_DEVICE_STATE_CHECKING,
+    OPENING_DEVICE_STATE_OPENING
+} OpeningDeviceState;
+
 typedef struct {
-    MbimDevice *device;
-    GList *pending;
+    MbimDevice         *device;
+    OpeningDeviceState  state;
+    guint32             timeout_secs;
+    gint64              started;
+    GList              *pending;
 } OpeningDevice;
 
 static void
@@ -393,6 +834,11 @@ opening_device_complete_and_free (OpeningDevice *info,
 {
     GList *l;
 
+    g_debug ("[%s] device %s in %" G_GINT64_FORMAT " ms",
+             mbim_device_get_path (info->device),
+             error ? "open failed" : (info->state == OPENING_DEVICE_STATE_CHECKING ? "checked" : "opened"),
+             (g_get_monotonic_time () - info->started) / 1000);
+
     /* Complete all pending open tasks */
     for (l = info->pending; l; l = g_list_next (l)) {
         GTask *task = (GTask *)(l->data);
@@ -413,18 +859,15 @@ static OpeningDevice *
 peek_opening_device_info (MbimProxy  *self,
                           MbimDevice *device)
 {
-    GList *l;
-
-    /* If already being opened, queue it up */
-    for (l = self->priv->opening_devices; l; l = g_list_next (l)) {
-        OpeningDevice *info;
+    OpeningDevice *info;
 
-        info = (OpeningDevice *)(l->data);
-        if (device == info->device)
-            return info;
-    }
+    /* The table is shared, but each info is only ever used in the context of
+     * its own device */
+    g_mutex_lock (&self->priv->lock);
+    info = g_hash_table_lookup (self->priv->opening_devices, device);
+    g_mutex_unlock (&self->priv->lock);
 
-    return NULL;
+    return info;
 }
 
 static void
@@ -433,24 +876,41 @@ complete_opening_device (MbimProxy    *self,
                          const GError *error)
 {
     OpeningDevice *info;
+    guint          n_devices = 0;
+    gint64         elapsed = 0;
+
+    g_mutex_lock (&self->priv->lock);
+    info = g_hash_table_lookup (self->priv->opening_devices, device);
+    if (info) {
+        g_hash_table_remove (self->priv->opening_devices, device);
+        self->priv->bringup_n_devices++;
+        /* Report the whole bring-up time once there are no more devices
+         * being opened */
+        if (g_hash_table_size (self->priv->opening_devices) == 0) {
+            n_devices = self->priv->bringup_n_devices;
+            elapsed = g_get_monotonic_time () - self->priv->bringup_started;
+            self->priv->bringup_n_devices = 0;
+            self->priv->bringup_started = 0;
+        }
+    }
+    g_mutex_unlock (&self->priv->lock);
 
-    info = peek_opening_device_info (self, device);
     if (!info)
         return;
 
-    self->priv->opening_devices = g_list_remove (self->priv->opening_devices, info);
     opening_device_complete_and_free (info, error);
+
+    if (n_devices > 0)
+        g_debug ("%u device(s) brought up in %" G_GINT64_FORMAT " ms", n_devices, elapsed / 1000);
 }
 
 static void
 cancel_opening_device (MbimProxy  *self,
                        MbimDevice *device)
 {
-    OpeningDevice *info;
     GError *error;
 
-    info = peek_opening_device_info (self, device);
-    if (!info)
+    if (!peek_opening_device_info (self, device))
         return;
 
     error = g_error_new (MBIM_CORE_ERROR, MBIM_CORE_ERROR_ABORTED, "Device is gone");
@@ -475,37 +935,22 @@ device_open_ready (MbimDevice   *device,
         untrack_device (self, device);
         g_error_free (error);
     }
+
+    g_object_unref (self);
 }
 
 static void
-internal_open (GTask *task)
+opening_device_open (MbimProxy     *self,
+                     OpeningDevice *info)
 {
-    MbimProxy                 *self;
-    InternalDeviceOpenContext *ctx;
-    OpeningDevice             *info;
-
-    self = g_task_get_source_object (task);
-    ctx  = g_task_get_task_data (task);
+    info->state = OPENING_DEVICE_STATE_OPENING;
 
-    /* If already being opened, queue it up */
-    info = peek_opening_device_info (self, ctx->device);
-    if (info) {
-        info->pending = g_list_append (info->pending, task);
-        return;
-    }
-
-    /* First time opening */
-    info = g_slice_new0 (OpeningDevice);
-    info->device = g_object_ref (ctx->device);
-    info->pending = g_list_append (info->pending, task);
-    self->priv->opening_devices = g_list_prepend (self->priv->opening_devices, info);
+    /* Whatever happened while the device was closed is unknown */
+    device_state_cache_clear (info->device);
 
     /* Note: for now, only the first timeout request is taken into account */
-
-    /* Need to open the device; and we must make sure the proxy only does this once, even
-     * when multiple clients request it */
-    mbim_device_open (ctx->device,
-                      ctx->timeout_secs,
+    mbim_device_open (info->device,
+                      info->timeout_secs,
                       NULL,
                       (GAsyncReadyCallback)device_open_ready,
                       g_object_ref (self));
@@ -518,14 +963,11 @@ static void proxy_device_error_cb (MbimDevice *device,
 static void
 internal_device_open_caps_query_ready (MbimDevice   *device,
                                        GAsyncResult *res,
-                                       GTask        *task)
+                                       MbimProxy    *self)
 {
-    MbimProxy              *self;
     g_autoptr(MbimMessage)  response = NULL;
     g_autoptr(GError)       error = NULL;
 
-    self = g_task_get_source_object (task);
-
     /* Always unblock error signals */
     g_signal_handlers_unblock_by_func (device, proxy_device_error_cb, self);
 
@@ -533,10 +975,17 @@ internal_device_open_caps_query_ready (MbimDevice   *device,
     if (!response || !mbim_message_response_get_result (response, MBIM_MESSAGE_TYPE_COMMAND_DONE, &error)) {
         /* If we get a not-opened error, well, force closing right away and reopen */
         if (g_error_matches (error, MBIM_PROTOCOL_ERROR, MBIM_PROTOCOL_ERROR_NOT_OPENED)) {
-            g_debug ("[%s] device not-opened error reported, reopening", mbim_device_get_path (device));
-            reset_client_service_subscribe_lists (self, device);
-            mbim_device_close_force (device, NULL);
-            internal_open (task);
+            OpeningDevice *info;
+
+            /* The device may have been untracked in the meantime */
+            info = peek_opening_device_info (self, device);
+            if (info) {
+                g_debug ("[%s] device not-opened error reported, reopening", mbim_device_get_path (device));
+                reset_client_service_subscribe_lists (self, device);
+                mbim_device_close_force (device, NULL);
+                opening_device_open (self, info);
+            }
+            g_object_unref (self);
             return;
         }
 
@@ -548,8 +997,8 @@ internal_device_open_caps_query_ready (MbimDevice   *device,
     g_debug ("[%s] device caps query during internal open succeeded",
              mbim_device_get_path (device));
 
-    g_task_return_boolean (task, TRUE);
-    g_object_unref (task);
+    complete_opening_device (self, device, NULL);
+    g_object_unref (self);
 }
 
 static void
@@ -559,21 +1008,37 @@ internal_device_open (MbimProxy           *self,
                       GAsyncReadyCallback  callback,
                       gpointer             user_data)
 {
-    InternalDeviceOpenContext *ctx;
-    GTask                     *task;
+    OpeningDevice *info;
+    GTask         *task;
 
     task = g_task_new (self, NULL, callback, user_data);
 
-    ctx = g_slice_new0 (InternalDeviceOpenContext);
-    ctx->device = g_object_ref (device);
-    ctx->timeout_secs = timeout_secs;
-    g_task_set_task_data (task, ctx, (GDestroyNotify) internal_device_open_context_free);
+    /* If already being checked or opened, queue it up */
+    info = peek_opening_device_info (self, device);
+    if (info) {
+        info->pending = g_list_append (info->pending, task);
+        return;
+    }
+
+    info = g_slice_new0 (OpeningDevice);
+    info->device = g_object_ref (device);
+    info->timeout_secs = timeout_secs;
+    info->started = g_get_monotonic_time ();
+    info->pending = g_list_append (info->pending, task);
+
+    g_mutex_lock (&self->priv->lock);
+    if (g_hash_table_size (self->priv->opening_devices) == 0)
+        self->priv->bringup_started = info->started;
+    g_hash_table_insert (self->priv->opening_devices, device, info);
+    g_mutex_unlock (&self->priv->lock);
 
     /* If the device is flagged as already open, we still want to check
      * whether that's totally true, and we do that with a standard command
      * (loading caps in this case). */
     if (mbim_device_is_open (device)) {
-        MbimMessage *message;
+        g_autoptr(MbimMessage) message = NULL;
+
+        info->state = OPENING_DEVICE_STATE_CHECKING;
 
         /* Avoid getting notified of errors in this internal check, as we're
          * already going to check for the NotOpened error ourselves in the
@@ -588,12 +1053,13 @@ internal_device_open (MbimProxy           *self,
                              5,
                              NULL,
                              (GAsyncReadyCallback)internal_device_open_caps_query_ready,
-                             task);
-        mbim_message_unref (message);
+                             g_object_ref (self));
         return;
     }
 
-    internal_open (task);
+    /* Need to open the device; and we must make sure the proxy only does this
+     * once, even when multiple clients request it */
+    opening_device_open (self, info);
 }
 
 /*****************************************************************************/
@@ -649,26 +1115,37 @@ process_internal_proxy_close (MbimProxy   *self,
 /* Proxy config */
 
 static MbimMessage *
-build_proxy_control_command_done (MbimMessage     *message,
-                                  MbimStatusError  status)
+build_proxy_control_command_done_full (MbimMessage     *message,
+                                       MbimStatusError  status,
+                                       const guint8    *buffer,
+                                       guint32          buffer_length)
 {
     MbimMessage *response;
     struct command_done_message *command_done;
 
     response = (MbimMessage *) _mbim_message_allocate (MBIM_MESSAGE_TYPE_COMMAND_DONE,
                                                        mbim_message_get_transaction_id (message),
-                                                       sizeof (struct command_done_message));
+                                                       sizeof (struct command_done_message) + buffer_length);
     command_done = &(((struct full_message *)(response->data))->message.command_done);
     command_done->fragment_header.total   = GUINT32_TO_LE (1);
     command_done->fragment_header.current = 0;
     memcpy (command_done->service_id, MBIM_UUID_PROXY_CONTROL, sizeof (MbimUuid));
     command_done->command_id  = GUINT32_TO_LE (mbim_message_command_get_cid (message));
     command_done->status_code = GUINT32_TO_LE (status);
-    command_done->buffer_length = 0;
+    command_done->buffer_length = GUINT32_TO_LE (buffer_length);
+    if (buffer_length)
+        memcpy (&command_done->buffer[0], buffer, buffer_length);
 
     return response;
 }
 
+static MbimMessage *
+build_proxy_control_command_done (MbimMessage     *message,
+                                  MbimStatusError  status)
+{
+    return build_proxy_control_command_done_full (message, status, NULL, 0);
+}
+
 static void
 proxy_config_internal_device_open_ready (MbimProxy    *self,
                                          GAsyncResult *res,
@@ -733,16 +1210,45 @@ device_new_ready (GObject      *source,
                           request);
 }
 
+static void
+proxy_config_device (MbimProxy *self,
+                     Request   *request)
+{
+    MbimDevice       *device;
+    g_autoptr(GFile)  file = NULL;
+
+    /* Check if some other client already handled the same device */
+    device = peek_device_for_path (self, request->path);
+    if (device) {
+        /* Keep reference and continue */
+        client_set_device (request->client, device);
+        internal_device_open (self,
+                              device,
+                              request->timeout_secs,
+                              (GAsyncReadyCallback)proxy_config_internal_device_open_ready,
+                              request);
+        return;
+    }
+
+    /* Flag as ongoing */
+    request->client->config_ongoing = TRUE;
+
+    /* Create new MBIM device */
+    file = g_file_new_for_path (request->path);
+    mbim_device_new (file,
+                     NULL,
+                     (GAsyncReadyCallback)device_new_ready,
+                     request);
+}
+
 static gboolean
 process_internal_proxy_config (MbimProxy   *self,
                                Client      *client,
                                MbimMessage *message)
 {
     Request           *request;
-    MbimDevice        *device;
     g_autofree gchar  *incoming_path = NULL;
     g_autofree gchar  *path = NULL;
-    g_autoptr(GFile)   file = NULL;
     g_autoptr(GError)  error = NULL;
 
     /* create request holder */
@@ -814,28 +1320,337 @@ process_internal_proxy_config (MbimProxy   *self,
         return TRUE;
     }
 
-    /* Check if some other client already handled the same device */
-    device = peek_device_for_path (self, path);
-    if (device) {
-        /* Keep reference and continue */
-        client_set_device (client, device);
-        internal_device_open (self,
-                              device,
-                              request->timeout_secs,
-                              (GAsyncReadyCallback)proxy_config_internal_device_open_ready,
-                              request);
+    request->path = g_steal_pointer (&path);
+
+    /* Clients already moved to a device worker thread must keep on using it */
+    if (client->worker && !g_str_equal (client->worker->path, request->path)) {
+        g_warning ("[client %lu,0x%08x] cannot configure proxy: different device path given",
+                   request->client->id, request->original_transaction_id);
+        request->response = build_proxy_control_command_done (message, MBIM_STATUS_ERROR_FAILURE);
+        request_complete_and_free (request);
         return TRUE;
     }
 
-    /* Flag as ongoing */
-    client->config_ongoing = TRUE;
+    /* If devices run in their own threads, the client is moved to the thread of
+     * the device before going on; this is done once the current input has been
+     * processed, see parse_request() */
+    if ((self->priv->flags & MBIM_PROXY_FLAGS_DEVICE_THREADS) && !client->worker) {
+        client->worker = device_worker_get_for_path (self, request->path);
+        client->migrate_request = request;
+        return TRUE;
+    }
 
-    /* Create new MBIM device */
-    file = g_file_new_for_path (path);
-    mbim_device_new (file,
-                     NULL,
-                     (GAsyncReadyCallback)device_new_ready,
-                     request);
+    proxy_config_device (self, request);
+    return TRUE;
+}
+
+/*****************************************************************************/
+/* Proxy client configuration */
+
+static gboolean
+process_internal_proxy_client_config (MbimProxy   *self,
+                                      Client      *client,
+                                      MbimMessage *message)
+{
+    Request           *request;
+    g_autoptr(GError)  error = NULL;
+    guint32            command_timeout_secs = 0;
+
+    request = request_new (self, client, message);
+
+    if (!mbim_message_proxy_control_client_configuration_set_parse (message, &command_timeout_secs, &error)) {
+        g_warning ("[client %lu,0x%08x] cannot configure client: %s",
+                   request->client->id, request->original_transaction_id, error->message);
+        request->response = build_proxy_control_command_done (message, MBIM_STATUS_ERROR_INVALID_PARAMETERS);
+        request_complete_and_free (request);
+        return TRUE;
+    }
+
+    g_debug ("[client %lu,0x%08x] command timeout requested: %us",
+             request->client->id, request->original_transaction_id, command_timeout_secs);
+    client->command_timeout_secs = (command_timeout_secs > 0 ? command_timeout_secs : DEFAULT_COMMAND_TIMEOUT_SECS);
+
+    request->response = build_proxy_control_command_done (message, MBIM_STATUS_ERROR_NONE);
+    request_complete_and_free (request);
+    return TRUE;
+}
+
+/*****************************************************************************/
+/* Proxy statistics */
+
+static void
+forward_statistics_get_latency (const ForwardStatistics *stats,
+                                guint64                 *out_mean_us,
+                                guint64                 *out_p99_us)
+{
+    const MbimLatencyHistogram *latency;
+
+    latency = &stats->forward_latency;
+    *out_mean_us = (latency->count ? (latency->total_us / latency->count) : 0);
+    *out_p99_us = mbim_latency_histogram_get_percentile (latency, 99);
+}
+
+static void
+device_statistics_size (const MbimProxyDeviceStatistics *value,
+                        guint32                         *fixed_size,
+                        guint32                         *variable_size)
+{
+    _mbim_struct_builder_size_string (value->device_path, fixed_size, variable_size);
+    *fixed_size += (4 * sizeof (guint32)) + (7 * sizeof (guint64));
+}
+
+static void
+device_statistics_write (MbimStructBuilder               *builder,
+                         const MbimProxyDeviceStatistics *value)
+{
+    _mbim_struct_builder_append_string  (builder, value->device_path);
+    _mbim_struct_builder_append_guint32 (builder, value->clients_count);
+    _mbim_struct_builder_append_guint64 (builder, value->forwarded_requests);
+    _mbim_struct_builder_append_guint32 (builder, value->in_flight_requests);
+    _mbim_struct_builder_append_guint64 (builder, value->forward_latency_mean_us);
+    _mbim_struct_builder_append_guint64 (builder, value->forward_latency_p99_us);
+    _mbim_struct_builder_append_guint64 (builder, value->indications);
+    _mbim_struct_builder_append_guint64 (builder, value->indications_forwarded);
+    _mbim_struct_builder_append_guint64 (builder, value->indications_dropped);
+    _mbim_struct_builder_append_guint64 (builder, value->responses_dropped);
+    _mbim_struct_builder_append_guint32 (builder, value->subscribed_services);
+    _mbim_struct_builder_append_guint32 (builder, value->subscribed_cids);
+}
+
+static void
+client_statistics_size (const MbimProxyClientStatistics *value,
+                        guint32                         *fixed_size,
+                        guint32                         *variable_size)
+{
+    _mbim_struct_builder_size_string (value->device_path, fixed_size, variable_size);
+    *fixed_size += (4 * sizeof (guint32)) + (8 * sizeof (guint64));
+}
+
+static void
+client_statistics_write (MbimStructBuilder               *builder,
+                         const MbimProxyClientStatistics *value)
+{
+    _mbim_struct_builder_append_guint32 (builder, value->client_id);
+    _mbim_struct_builder_append_string  (builder, value->device_path);
+    _mbim_struct_builder_append_guint64 (builder, value->forwarded_requests);
+    _mbim_struct_builder_append_guint32 (builder, value->in_flight_requests);
+    _mbim_struct_builder_append_guint64 (builder, value->forward_latency_mean_us);
+    _mbim_struct_builder_append_guint64 (builder, value->forward_latency_p99_us);
+    _mbim_struct_builder_append_guint64 (builder, value->indications_forwarded);
+    _mbim_struct_builder_append_guint64 (builder, value->indications_dropped);
+    _mbim_struct_builder_append_guint64 (builder, value->responses_dropped);
+    _mbim_struct_builder_append_guint64 (builder, value->bytes_received);
+    _mbim_struct_builder_append_guint64 (builder, value->bytes_sent);
+    _mbim_struct_builder_append_guint32 (builder, value->subscribed_services);
+    _mbim_struct_builder_append_guint32 (builder, value->subscribed_cids);
+}
+
+static GPtrArray *
+build_device_statistics (MbimProxy *self)
+{
+    GPtrArray      *array;
+    GHashTableIter  iter;
+    MbimDevice     *device;
+
+    array = g_ptr_array_new ();
+
+    g_hash_table_iter_init (&iter, self->priv->devices);
+    while (g_hash_table_iter_next (&iter, NULL, (gpointer *)&device)) {
+        MbimProxyDeviceStatistics *item;
+        ForwardStatistics          stats;
+        guint64                    indications;
+        GHashTableIter             clients_iter;
+        Client                    *client;
+
+        item = g_new0 (MbimProxyDeviceStatistics, 1);
+        item->device_path = g_strdup (mbim_device_get_path (device));
+        g_ptr_array_add (array, item);
+
+        g_hash_table_iter_init (&clients_iter, self->priv->clients);
+        while (g_hash_table_iter_next (&clients_iter, (gpointer *)&client, NULL)) {
+            if (client->device == device)
+                item->clients_count++;
+        }
+
+        if (!device_forward_statistics_peek (device, &stats, &indications))
+            continue;
+
+        item->forwarded_requests = stats.forwarded_requests;
+        item->in_flight_requests = stats.in_flight_requests;
+        forward_statistics_get_latency (&stats, &item->forward_latency_mean_us, &item->forward_latency_p99_us);
+        item->indications = indications;
+        item->indications_forwarded = stats.indications_forwarded;
+        item->indications_dropped = stats.indications_dropped;
+        item->responses_dropped = stats.responses_dropped;
+        item->subscribed_services = stats.subscribed_services;
+        item->subscribed_cids = stats.subscribed_cids;
+    }
+
+    g_ptr_array_add (array, NULL);
+    return array;
+}
+
+static GPtrArray *
+build_client_statistics (MbimProxy *self)
+{
+    GPtrArray      *array;
+    GHashTableIter  iter;
+    Client         *client;
+
+    array = g_ptr_array_new ();
+
+    g_hash_table_iter_init (&iter, self->priv->clients);
+    while (g_hash_table_iter_next (&iter, (gpointer *)&client, NULL)) {
+        MbimProxyClientStatistics *item;
+
+        item = g_new0 (MbimProxyClientStatistics, 1);
+        item->client_id = (guint32) client->id;
+        item->device_path = g_strdup (client->device ? mbim_device_get_path (client->device) : "");
+        item->forwarded_requests = client->stats.forwarded_requests;
+        item->in_flight_requests = client->stats.in_flight_requests;
+        forward_statistics_get_latency (&client->stats, &item->forward_latency_mean_us, &item->forward_latency_p99_us);
+        item->indications_forwarded = client->stats.indications_forwarded;
+        item->indications_dropped = client->stats.indications_dropped;
+        item->responses_dropped = client->stats.responses_dropped;
+        item->bytes_received = client->bytes_received;
+        item->bytes_sent = client->bytes_sent;
+        item->subscribed_services = client->stats.subscribed_services;
+        item->subscribed_cids = client->stats.subscribed_cids;
+        g_ptr_array_add (array, item);
+    }
+
+    g_ptr_array_add (array, NULL);
+    return array;
+}
+
+static gboolean
+process_internal_proxy_statistics (MbimProxy   *self,
+                                   Client      *client,
+                                   MbimMessage *message)
+{
+    Request           *request;
+    GPtrArray         *devices;
+    GPtrArray         *clients;
+    MbimStructBuilder *builder;
+    GByteArray        *information_buffer;
+
+    request = request_new (self, client, message);
+
+    if (mbim_message_command_get_command_type (message) != MBIM_MESSAGE_COMMAND_TYPE_QUERY) {
+        g_warning ("[client %lu,0x%08x] cannot query proxy statistics: invalid request type",
+                   request->client->id, request->original_transaction_id);
+        request->response = build_proxy_control_command_done (message, MBIM_STATUS_ERROR_INVALID_PARAMETERS);
+        request_complete_and_free (request);
+        return TRUE;
+    }
+
+    g_debug ("[client %lu,0x%08x] request to query proxy statistics",
+             request->client->id, request->original_transaction_id);
+
+    /* Devices and clients may be handled in different threads, so take a
+     * snapshot of all of them at once */
+    g_mutex_lock (&self->priv->lock);
+    g_mutex_lock (&self->priv->stats_lock);
+    devices = build_device_statistics (self);
+    clients = build_client_statistics (self);
+    g_mutex_unlock (&self->priv->stats_lock);
+    g_mutex_unlock (&self->priv->lock);
+
+    builder = _mbim_struct_builder_new ();
+    _mbim_struct_builder_append_guint32 (builder, devices->len - 1);
+    _mbim_struct_builder_append_struct_array (builder,
+                                              (MbimStructSizeFunc) device_statistics_size,
+                                              (MbimStructWriteFunc) device_statistics_write,
+                                              (const gconstpointer *) devices->pdata,
+                                              devices->len - 1,
+                                              TRUE);
+    _mbim_struct_builder_append_guint32 (builder, clients->len - 1);
+    _mbim_struct_builder_append_struct_array (builder,
+                                              (MbimStructSizeFunc) client_statistics_size,
+                                              (MbimStructWriteFunc) client_statistics_write,
+                                              (const gconstpointer *) clients->pdata,
+                                              clients->len - 1,
+                                              TRUE);
+    information_buffer = _mbim_struct_builder_complete (builder);
+
+    mbim_proxy_device_statistics_array_free ((MbimProxyDeviceStatisticsArray *) g_ptr_array_free (devices, FALSE));
+    mbim_proxy_client_statistics_array_free ((MbimProxyClientStatisticsArray *) g_ptr_array_free (clients, FALSE));
+
+    request->response = build_proxy_control_command_done_full (message,
+                                                               MBIM_STATUS_ERROR_NONE,
+                                                               information_buffer->data,
+                                                               information_buffer->len);
+    g_byte_array_unref (information_buffer);
+    request_complete_and_free (request);
+    return TRUE;
+}
+
+/*****************************************************************************/
+/* Proxy indication policy */
+
+static gboolean
+process_internal_proxy_indication_policy (MbimProxy   *self,
+                                          Client      *client,
+                                          MbimMessage *message)
+{
+    Request           *request;
+    g_autoptr(GError)  error = NULL;
+    const MbimUuid    *service_id = NULL;
+    guint32            cid = 0;
+    guint32            policy = 0;
+    guint32            interval_ms = 0;
+    guint32            burst = 0;
+    g_autofree gchar  *service_str = NULL;
+
+    request = request_new (self, client, message);
+
+    if (mbim_message_command_get_command_type (message) != MBIM_MESSAGE_COMMAND_TYPE_SET) {
+        g_warning ("[client %lu,0x%08x] cannot set indication policy: invalid request type",
+                   request->client->id, request->original_transaction_id);
+        request->response = build_proxy_control_command_done (message, MBIM_STATUS_ERROR_INVALID_PARAMETERS);
+        request_complete_and_free (request);
+        return TRUE;
+    }
+
+    if (!mbim_message_proxy_control_indication_policy_set_parse (message,
+                                                                 &service_id,
+                                                                 &cid,
+                                                                 &policy,
+                                                                 &interval_ms,
+                                                                 &burst,
+                                                                 &error)) {
+        g_warning ("[client %lu,0x%08x] cannot set indication policy: %s",
+                   request->client->id, request->original_transaction_id, error->message);
+        request->response = build_proxy_control_command_done (message, MBIM_STATUS_ERROR_INVALID_PARAMETERS);
+        request_complete_and_free (request);
+        return TRUE;
+    }
+
+    if (policy > MBIM_INDICATION_POLICY_RATE_LIMIT) {
+        g_warning ("[client %lu,0x%08x] cannot set indication policy: unknown policy %u",
+                   request->client->id, request->original_transaction_id, policy);
+        request->response = build_proxy_control_command_done (message, MBIM_STATUS_ERROR_INVALID_PARAMETERS);
+        request_complete_and_free (request);
+        return TRUE;
+    }
+
+    service_str = mbim_uuid_get_printable (service_id);
+    g_debug ("[client %lu,0x%08x] request to set indication policy %u (%u ms, burst %u) for %s, cid %u",
+             request->client->id, request->original_transaction_id,
+             policy, interval_ms, burst, service_str, cid);
+
+    if (!client->indication_filter && policy != MBIM_INDICATION_POLICY_NONE)
+        client->indication_filter = mbim_indication_filter_new ((MbimIndicationFilterEmitFunc) client_forward_indication, client);
+    if (client->indication_filter)
+        mbim_indication_filter_set_policy (client->indication_filter,
+                                           service_id,
+                                           cid,
+                                           (MbimIndicationPolicy) policy,
+                                           interval_ms,
+                                           burst);
+
+    request->response = build_proxy_control_command_done (message, MBIM_STATUS_ERROR_NONE);
+    request_complete_and_free (request);
     return TRUE;
 }
 
@@ -859,11 +1674,17 @@ track_service_subscribe_list (Client      *client,
     /* On each new request from the client, it should provide the FULL list of
      * events it's subscribed to, so we can safely recreate the whole array each
      * time. */
+    device_index_remove_client (client);
     g_clear_pointer (&client->mbim_event_entry_array, mbim_event_entry_array_free);
     client->mbim_event_entry_array = g_steal_pointer (&mbim_event_entry_array);
     client->mbim_event_entry_array_size = mbim_event_entry_array_size;
+    device_index_add_client (client);
+    forward_statistics_update_subscribed (client->self,
+                                          &client->stats,
+                                          client->mbim_event_entry_array,
+                                          client->mbim_event_entry_array_size);
 
-    if (mbim_utils_get_traces_enabled ()) {
+    if (_mbim_utils_trace_enabled (MBIM_TRACE_CATEGORY_PROXY)) {
         g_debug ("[client %lu] service subscribe list built", client->id);
         _mbim_proxy_helper_service_subscribe_list_debug ((const MbimEventEntry * const *)client->mbim_event_entry_array,
                                                          client->mbim_event_entry_array_size);
@@ -924,8 +1745,9 @@ device_service_subscribe_list_set_ready (MbimDevice   *device,
         return;
     }
 
-    g_debug ("[client %lu,0x%08x] response from device received",
-             request->client->id, request->original_transaction_id);
+    if (_mbim_utils_trace_enabled (MBIM_TRACE_CATEGORY_PROXY))
+        g_debug ("[client %lu,0x%08x] response from device received",
+                 request->client->id, request->original_transaction_id);
     error_status_code = GUINT32_FROM_LE (((struct full_message *)(tmp_response->data))->message.command_done.status_code);
     device_service_subscribe_list_set_complete (request, error_status_code);
 }
@@ -966,7 +1788,7 @@ process_device_service_subscribe_list (MbimProxy   *self,
              request->client->id, request->original_transaction_id);
     mbim_device_command (client->device,
                          request_message,
-                         300,
+                         DEFAULT_COMMAND_TIMEOUT_SECS,
                          NULL,
                          (GAsyncReadyCallback)device_service_subscribe_list_set_ready,
                          request);
@@ -976,14 +1798,19 @@ process_device_service_subscribe_list (MbimProxy   *self,
 /*****************************************************************************/
 /* Standard command */
 
+static void state_cache_update_from_response (MbimProxy   *self,
+                                              MbimDevice  *device,
+                                              MbimMessage *message,
+                                              MbimMessage *response);
+
 static void
-device_command_ready (MbimDevice   *device,
-                      GAsyncResult *res,
-                      Request      *request)
+request_complete_with_device_response (Request      *request,
+                                       MbimMessage  *response,
+                                       const GError *error)
 {
-    g_autoptr(GError) error = NULL;
+    state_cache_update_from_response (request->self, request->client->device, request->message, response);
 
-    request->response = mbim_device_command_finish (device, res, &error);
+    request->response = response;
     if (!request->response) {
         /* Translate a MbimDevice wrong state error into a Not-Opened function error. */
         if (g_error_matches (error, MBIM_CORE_ERROR, MBIM_CORE_ERROR_WRONG_STATE)) {
@@ -1001,36 +1828,465 @@ device_command_ready (MbimDevice   *device,
         return;
     }
 
-    /* replace reponse transaction id with the requested transaction id */
-    g_debug ("[client %lu,0x%08x] response from device received",
-             request->client->id, request->original_transaction_id);
-    mbim_message_set_transaction_id (request->response, request->original_transaction_id);
+    /* The response is sent with the transaction id originally requested by
+     * the client, without modifying the message itself */
+    if (_mbim_utils_trace_enabled (MBIM_TRACE_CATEGORY_PROXY))
+        g_debug ("[client %lu,0x%08x] response from device received",
+                 request->client->id, request->original_transaction_id);
     request_complete_and_free (request);
 }
 
+static void
+device_command_ready (MbimDevice   *device,
+                      GAsyncResult *res,
+                      Request      *request)
+{
+    g_autoptr(GError)  error = NULL;
+    MbimMessage       *response;
+
+    response = mbim_device_command_finish (device, res, &error);
+    request_complete_with_device_response (request, response, error);
+}
+
+/*****************************************************************************/
+/* Coalesced queries
+ *
+ * Identical queries (same service, cid and information buffer) requested by
+ * one or more clients while a previous one is still ongoing in the device are
+ * not forwarded again; they all get the response of the ongoing one instead.
+ *
+ * A set forwarded to the device may change the state reported by any query
+ * sent before it, so once that happens the ongoing queries are detached: the
+ * requests already waiting for them still get their responses, but any new
+ * query is forwarded to the device again.
+ */
+
+typedef struct {
+    MbimDevice   *device;
+    GBytes       *key;
+    /* Requests sharing the query, in the order they were received */
+    GList        *requests;
+    /* Requests from clients still connected; the query is cancelled in the
+     * device only when there are none left */
+    guint         n_active;
+    GCancellable *cancellable;
+    /* Whether new identical queries can no longer wait for this one */
+    gboolean      detached;
+} CoalescedQuery;
+
+static GHashTable *device_queries_get        (MbimDevice     *device);
+static GList      *device_queries_list       (MbimDevice     *device);
+static void        device_queries_remove     (MbimDevice     *device,
+                                              CoalescedQuery *query);
+static void        device_queries_detach_all (MbimDevice     *device);
+
+static GBytes *
+coalesced_query_key_new (MbimMessage *message)
+{
+    GByteArray   *key;
+    const guint8 *information_buffer;
+    guint32       information_buffer_length;
+    guint32       cid_le;
+
+    information_buffer = mbim_message_command_get_raw_information_buffer (message, &information_buffer_length);
+    cid_le = GUINT32_TO_LE (mbim_message_command_get_cid (message));
+
+    key = g_byte_array_sized_new (sizeof (MbimUuid) + sizeof (cid_le) + information_buffer_length);
+    g_byte_array_append (key, (const guint8 *) mbim_message_command_get_service_id (message), sizeof (MbimUuid));
+    g_byte_array_append (key, (const guint8 *) &cid_le, sizeof (cid_le));
+    if (information_buffer_length)
+        g_byte_array_append (key, information_buffer, information_buffer_length);
+    return g_byte_array_free_to_bytes (key);
+}
+
+static void
+coalesced_query_ready (MbimDevice     *device,
+                       GAsyncResult   *res,
+                       CoalescedQuery *query)
+{
+    g_autoptr(GError)      error = NULL;
+    g_autoptr(MbimMessage) response = NULL;
+    GList                 *l;
+
+    response = mbim_device_command_finish (device, res, &error);
+
+    /* New identical queries from now on need a new request to the device */
+    device_queries_remove (device, query);
+
+    for (l = query->requests; l; l = g_list_next (l)) {
+        Request     *request;
+        MbimMessage *client_response = NULL;
+
+        request = (Request *)(l->data);
+
+        /* Nothing to send to clients already gone */
+        if (request->released) {
+            request_complete_and_free (request);
+            continue;
+        }
+
+        /* All clients share the same response, each one with its own
+         * transaction id overlaid when sent */
+        if (response)
+            client_response = mbim_message_ref (response);
+        request_complete_with_device_response (request, client_response, error);
+    }
+
+    g_list_free (query->requests);
+    g_object_unref (query->cancellable);
+    g_bytes_unref (query->key);
+    g_object_unref (query->device);
+    g_slice_free (CoalescedQuery, query);
+}
+
+static gboolean
+command_can_be_coalesced (MbimMessage *message)
+{
+    return (mbim_message_command_get_command_type (message) == MBIM_MESSAGE_COMMAND_TYPE_QUERY &&
+            _mbim_message_fragment_get_total (message) == 1);
+}
+
+static void
+forward_coalesced_query (Request *request)
+{
+    GHashTable     *queries;
+    CoalescedQuery *query;
+    GBytes         *key;
+    Client         *client;
+
+    client = request->client;
+    queries = device_queries_get (client->device);
+    key = coalesced_query_key_new (request->message);
+
+    query = g_hash_table_lookup (queries, key);
+    if (query) {
+        if (_mbim_utils_trace_enabled (MBIM_TRACE_CATEGORY_PROXY))
+            g_debug ("[client %lu,0x%08x] identical query already ongoing in device, waiting for its response",
+                     client->id, request->original_transaction_id);
+        query->requests = g_list_append (query->requests, request);
+        query->n_active++;
+        g_bytes_unref (key);
+        return;
+    }
+
+    query = g_slice_new0 (CoalescedQuery);
+    query->device = g_object_ref (client->device);
+    query->key = key;
+    query->requests = g_list_append (NULL, request);
+    query->n_active = 1;
+    query->cancellable = g_cancellable_new ();
+    g_hash_table_insert (queries, g_bytes_ref (key), query);
+
+    /* replace command transaction id with internal proxy transaction id to avoid collision */
+    mbim_message_set_transaction_id (request->message, mbim_device_get_next_transaction_id (client->device));
+
+    mbim_device_command (client->device,
+                         request->message,
+                         client->command_timeout_secs,
+                         query->cancellable,
+                         (GAsyncReadyCallback)coalesced_query_ready,
+                         query);
+}
+
+static void
+release_client_coalesced_queries (Client *client)
+{
+    GList *queries;
+    GList *q;
+    GList *to_cancel = NULL;
+    GList *l;
+
+    if (!client->device)
+        return;
+
+    queries = device_queries_list (client->device);
+    for (q = queries; q; q = g_list_next (q)) {
+        CoalescedQuery *query;
+
+        query = (CoalescedQuery *)(q->data);
+        for (l = query->requests; l; l = g_list_next (l)) {
+            Request *request;
+
+            request = (Request *)(l->data);
+            if (request->client != client || request->released)
+                continue;
+            request->released = TRUE;
+            if (--query->n_active == 0)
+                to_cancel = g_list_prepend (to_cancel, g_object_ref (query->cancellable));
+        }
+    }
+    g_list_free (queries);
+
+    /* Cancelling may complete the queries right away, so not while iterating */
+    for (l = to_cancel; l; l = g_list_next (l))
+        g_cancellable_cancel (G_CANCELLABLE (l->data));
+    g_list_free_full (to_cancel, g_object_unref);
+}
+
+/*****************************************************************************/
+/* State cache
+ *
+ * When enabled with MBIM_PROXY_FLAGS_STATE_CACHE, the latest state reported
+ * by the device for some notifiable cids, either in a response or in an
+ * indication, is kept per device, and further queries of the same cid are
+ * answered right away from it, without going to the device. The state is only
+ * used while the device is subscribed to the indications of the cid, and it
+ * is dropped as soon as the state may change without the proxy knowing it:
+ * while a set is ongoing, when the device reports an error, when the
+ * subscriptions change, or when the device is closed or reopened.
+ */
+
+typedef struct {
+    MbimService service;
+    guint32     cid;
+    /* The state is kept per session, given in the first field of both the
+     * query and the response */
+    gboolean    per_session;
+} StateCacheCid;
+
+static const StateCacheCid state_cache_cids[] = {
+    { MBIM_SERVICE_BASIC_CONNECT, MBIM_CID_BASIC_CONNECT_SUBSCRIBER_READY_STATUS, FALSE },
+    { MBIM_SERVICE_BASIC_CONNECT, MBIM_CID_BASIC_CONNECT_REGISTER_STATE,          FALSE },
+    { MBIM_SERVICE_BASIC_CONNECT, MBIM_CID_BASIC_CONNECT_PACKET_SERVICE,          FALSE },
+    { MBIM_SERVICE_BASIC_CONNECT, MBIM_CID_BASIC_CONNECT_SIGNAL_STATE,            FALSE },
+    { MBIM_SERVICE_BASIC_CONNECT, MBIM_CID_BASIC_CONNECT_CONNECT,                 TRUE  },
+};
+
+typedef struct {
+    MbimService service;
+    guint32     cid;
+    guint32     session_id;
+} StateCacheKey;
+
+static GHashTable *device_state_cache_get (MbimDevice     *device);
+static gboolean    device_is_subscribed   (MbimDevice     *device,
+                                           const MbimUuid *service_id,
+                                           guint32         cid);
+
+static guint
+state_cache_key_hash (gconstpointer v)
+{
+    const StateCacheKey *key = v;
+
+    return (((key->service * 31) + key->cid) * 31) + key->session_id;
+}
+
+static gboolean
+state_cache_key_equal (gconstpointer a,
+                       gconstpointer b)
+{
+    const StateCacheKey *key_a = a;
+    const StateCacheKey *key_b = b;
+
+    return (key_a->service == key_b->service &&
+            key_a->cid == key_b->cid &&
+            key_a->session_id == key_b->session_id);
+}
+
+static gboolean
+state_cache_key_init (MbimProxy      *self,
+                      const MbimUuid *service_id,
+                      guint32         cid,
+                      const guint8   *buffer,
+                      guint32         buffer_length,
+                      StateCacheKey  *key)
+{
+    MbimService service;
+    guint       i;
+
+    if (!(self->priv->flags & MBIM_PROXY_FLAGS_STATE_CACHE))
+        return FALSE;
+
+    service = mbim_uuid_to_service (service_id);
+    for (i = 0; i < G_N_ELEMENTS (state_cache_cids); i++) {
+        if (state_cache_cids[i].service != service || state_cache_cids[i].cid != cid)
+            continue;
+
+        memset (key, 0, sizeof (StateCacheKey));
+        key->service = service;
+        key->cid = cid;
+        if (state_cache_cids[i].per_session) {
+            if (buffer_length < sizeof (guint32))
+                return FALSE;
+            memcpy (&key->session_id, buffer, sizeof (guint32));
+            key->session_id = GUINT32_FROM_LE (key->session_id);
+        }
+        return TRUE;
+    }
+    return FALSE;
+}
+
+static gboolean
+state_cache_key_init_from_command (MbimProxy     *self,
+                                   MbimMessage   *message,
+                                   StateCacheKey *key)
+{
+    const guint8 *buffer;
+    guint32       buffer_length;
+
+    buffer = mbim_message_command_get_raw_information_buffer (message, &buffer_length);
+    return state_cache_key_init (self,
+                                 mbim_message_command_get_service_id (message),
+                                 mbim_message_command_get_cid (message),
+                                 buffer,
+                                 buffer_length,
+                                 key);
+}
+
+static void
+state_cache_invalidate (MbimProxy   *self,
+                        MbimDevice  *device,
+                        MbimMessage *message)
+{
+    StateCacheKey key;
+
+    if (device && state_cache_key_init_from_command (self, message, &key))
+        g_hash_table_remove (device_state_cache_get (device), &key);
+}
+
+/* Stores the response to the given command, or drops the state kept if the
+ * command failed */
+static void
+state_cache_update_from_response (MbimProxy   *self,
+                                  MbimDevice  *device,
+                                  MbimMessage *message,
+                                  MbimMessage *response)
+{
+    StateCacheKey key;
+
+    if (!device || !state_cache_key_init_from_command (self, message, &key))
+        return;
+
+    if (!response ||
+        mbim_message_get_message_type (response) != MBIM_MESSAGE_TYPE_COMMAND_DONE ||
+        mbim_message_command_done_get_status_code (response) != MBIM_STATUS_ERROR_NONE ||
+        !device_is_subscribed (device, mbim_message_command_get_service_id (message), key.cid)) {
+        g_hash_table_remove (device_state_cache_get (device), &key);
+        return;
+    }
+
+    g_hash_table_replace (device_state_cache_get (device),
+                          g_memdup (&key, sizeof (key)),
+                          mbim_message_ref (response));
+}
+
+static void
+state_cache_update_from_indication (MbimProxy   *self,
+                                    MbimDevice  *device,
+                                    MbimMessage *indication)
+{
+    StateCacheKey                key;
+    const guint8                *buffer;
+    guint32                      buffer_length;
+    MbimMessage                 *response;
+    struct command_done_message *command_done;
+
+    buffer = mbim_message_indicate_status_get_raw_information_buffer (indication, &buffer_length);
+    if (!state_cache_key_init (self,
+                               mbim_message_indicate_status_get_service_id (indication),
+                               mbim_message_indicate_status_get_cid (indication),
+                               buffer,
+                               buffer_length,
+                               &key))
+        return;
+
+    /* The indication carries the same contents as the query response, so the
+     * response can be built right away */
+    response = (MbimMessage *) _mbim_message_allocate (MBIM_MESSAGE_TYPE_COMMAND_DONE,
+                                                       0,
+                                                       sizeof (struct command_done_message) + buffer_length);
+    command_done = &(((struct full_message *)(response->data))->message.command_done);
+    command_done->fragment_header.total   = GUINT32_TO_LE (1);
+    command_done->fragment_header.current = 0;
+    memcpy (command_done->service_id, mbim_message_indicate_status_get_service_id (indication), sizeof (MbimUuid));
+    command_done->command_id  = GUINT32_TO_LE (key.cid);
+    command_done->status_code = GUINT32_TO_LE (MBIM_STATUS_ERROR_NONE);
+    command_done->buffer_length = GUINT32_TO_LE (buffer_length);
+    if (buffer_length)
+        memcpy (&command_done->buffer[0], buffer, buffer_length);
+
+    g_hash_table_replace (device_state_cache_get (device), g_memdup (&key, sizeof (key)), response);
+}
+
+static gboolean
+state_cache_complete_query (Request *request)
+{
+    StateCacheKey  key;
+    MbimMessage   *response;
+    MbimDevice    *device;
+
+    device = request->client->device;
+    if (!device ||
+        mbim_message_command_get_command_type (request->message) != MBIM_MESSAGE_COMMAND_TYPE_QUERY ||
+        _mbim_message_fragment_get_total (request->message) != 1 ||
+        !state_cache_key_init_from_command (request->self, request->message, &key))
+        return FALSE;
+
+    response = g_hash_table_lookup (device_state_cache_get (device), &key);
+    if (!response)
+        return FALSE;
+
+    /* The subscriptions are checked again, as they may have changed since the
+     * state was stored */
+    if (!device_is_subscribed (device, mbim_message_command_get_service_id (request->message), key.cid)) {
+        g_hash_table_remove (device_state_cache_get (device), &key);
+        return FALSE;
+    }
+
+    if (_mbim_utils_trace_enabled (MBIM_TRACE_CATEGORY_PROXY))
+        g_debug ("[client %lu,0x%08x] query answered from the state cache",
+                 request->client->id, request->original_transaction_id);
+
+    /* Shared like any other response, with the client transaction id overlaid
+     * when sent */
+    request->response = mbim_message_ref (response);
+    request_complete_and_free (request);
+    return TRUE;
+}
+
 static gboolean
 process_command (MbimProxy   *self,
                  Client      *client,
                  MbimMessage *message)
 {
-    Request     *request;
-    const gchar *command;
-    const gchar *command_type;
-    const gchar *service;
-
-    command = mbim_cid_get_printable (mbim_message_command_get_service (message),
-                                      mbim_message_command_get_cid (message));
-    command_type = mbim_message_command_type_get_string (mbim_message_command_get_command_type (message));
-    service = mbim_service_get_string (mbim_message_command_get_service (message));
+    Request *request;
 
     /* create request holder */
     request = request_new (self, client, message);
 
-    g_debug ("[client %lu,0x%08x] forwarding request to device: %s, %s, %s",
-             client->id, request->original_transaction_id,
-             service      ? service      : "unknown service",
-             command_type ? command_type : "unknown command type",
-             command      ? command      : "unknown command");
+    if (state_cache_complete_query (request))
+        return TRUE;
+
+    if (_mbim_utils_trace_enabled (MBIM_TRACE_CATEGORY_PROXY)) {
+        const gchar *command;
+        const gchar *command_type;
+        const gchar *service;
+
+        command = mbim_cid_get_printable (mbim_message_command_get_service (message),
+                                          mbim_message_command_get_cid (message));
+        command_type = mbim_message_command_type_get_string (mbim_message_command_get_command_type (message));
+        service = mbim_service_get_string (mbim_message_command_get_service (message));
+        g_debug ("[client %lu,0x%08x] forwarding request to device: %s, %s, %s",
+                 client->id, request->original_transaction_id,
+                 service      ? service      : "unknown service",
+                 command_type ? command_type : "unknown command type",
+                 command      ? command      : "unknown command");
+    }
+
+    /* The state may change with any set, so neither the state cached nor
+     * the one reported by queries sent before can be given to later queries */
+    if (mbim_message_command_get_command_type (message) == MBIM_MESSAGE_COMMAND_TYPE_SET) {
+        state_cache_invalidate (self, client->device, message);
+        if (client->device)
+            device_queries_detach_all (client->device);
+    }
+
+    request_forward_statistics_start (request);
+
+    if (command_can_be_coalesced (message)) {
+        forward_coalesced_query (request);
+        return TRUE;
+    }
 
     if (_mbim_message_fragment_get_current (message) == _mbim_message_fragment_get_total (message) - 1)
         /* replace command transaction id with internal proxy transaction id to avoid collision */
@@ -1039,15 +2295,10 @@ process_command (MbimProxy   *self,
         /* avoid incrementing transaction until the last fragment is processed */
         mbim_message_set_transaction_id (message, mbim_device_get_transaction_id (client->device));
 
-    /* The timeout needs to be big enough for any kind of transaction to
-     * complete, otherwise the remote clients will lose the reply if they
-     * configured a timeout bigger than this internal one. We should likely
-     * make this value configurable per-client, instead of a hardcoded value.
-     */
     mbim_device_command (client->device,
                          message,
-                         300,
-                         NULL,
+                         client->command_timeout_secs,
+                         client->cancellable,
                          (GAsyncReadyCallback)device_command_ready,
                          request);
     return TRUE;
@@ -1071,6 +2322,15 @@ process_message (MbimProxy   *self,
         if (mbim_message_command_get_service (message) == MBIM_SERVICE_PROXY_CONTROL &&
             mbim_message_command_get_cid (message) == MBIM_CID_PROXY_CONTROL_CONFIGURATION)
             return process_internal_proxy_config (self, client, message);
+        if (mbim_message_command_get_service (message) == MBIM_SERVICE_PROXY_CONTROL &&
+            mbim_message_command_get_cid (message) == MBIM_CID_PROXY_CONTROL_STATISTICS)
+            return process_internal_proxy_statistics (self, client, message);
+        if (mbim_message_command_get_service (message) == MBIM_SERVICE_PROXY_CONTROL &&
+            mbim_message_command_get_cid (message) == MBIM_CID_PROXY_CONTROL_INDICATION_POLICY)
+            return process_internal_proxy_indication_policy (self, client, message);
+        if (mbim_message_command_get_service (message) == MBIM_SERVICE_PROXY_CONTROL &&
+            mbim_message_command_get_cid (message) == MBIM_CID_PROXY_CONTROL_CLIENT_CONFIGURATION)
+            return process_internal_proxy_client_config (self, client, message);
         /* device service subscribe list message? */
         if (mbim_message_command_get_service (message) == MBIM_SERVICE_BASIC_CONNECT &&
             mbim_message_command_get_cid (message) == MBIM_CID_BASIC_CONNECT_DEVICE_SERVICE_SUBSCRIBE_LIST)
@@ -1092,30 +2352,50 @@ process_message (MbimProxy   *self,
     g_assert_not_reached ();
 }
 
+static void client_migrate (Client *client);
+
 static void
 parse_request (MbimProxy *self,
                Client    *client)
 {
-    do {
+    guint offset = 0;
+
+    while (client->buffer &&
+           client->buffer->len - offset >= sizeof (struct header) &&
+           !client->migrate_request) {
         g_autoptr(MbimMessage) message = NULL;
-        guint32                len = 0;
+        guint32                len;
 
-        if (client->buffer->len >= sizeof (struct header) &&
-            (len = GUINT32_FROM_LE (((struct header *)client->buffer->data)->length)) > client->buffer->len) {
+        len = GUINT32_FROM_LE (((struct header *)&client->buffer->data[offset])->length);
+        if (len > client->buffer->len - offset) {
             /* have not received complete message */
-            return;
+            break;
         }
 
         if (!len)
-            return;
+            break;
 
-        message = mbim_message_new (client->buffer->data, len);
-        if (!message)
-            return;
+        if (offset == 0 && len == client->buffer->len) {
+            /* The buffer holds exactly one message, so it becomes the message
+             * itself, without copying; a new buffer is allocated on the next
+             * read */
+            message = (MbimMessage *) g_steal_pointer (&client->buffer);
+        } else {
+            /* Requests outlive the receive buffer, so copy just this message */
+            message = mbim_message_new (&client->buffer->data[offset], len);
+        }
 
-        g_byte_array_remove_range (client->buffer, 0, len);
+        offset += len;
         process_message (self, client, message);
-    } while (client->buffer->len > 0);
+    }
+
+    /* Drop all the processed messages at once */
+    if (client->buffer && offset > 0)
+        g_byte_array_remove_range (client->buffer, 0, offset);
+
+    /* Any other pending input will be processed in the worker thread */
+    if (client->migrate_request)
+        client_migrate (client);
 }
 
 static gboolean
@@ -1124,8 +2404,9 @@ connection_readable_cb (GSocket *socket,
                         Client *client)
 {
     MbimProxy         *self;
-    guint8             buffer[BUFFER_SIZE];
     g_autoptr(GError)  error = NULL;
+    guint              buffered;
+    gsize              to_read;
     gssize             r;
 
     /* Recover proxy pointer soon */
@@ -1139,11 +2420,40 @@ connection_readable_cb (GSocket *socket,
     if (!(condition & G_IO_IN || condition & G_IO_PRI))
         return TRUE;
 
+    if (G_UNLIKELY (!client->buffer))
+        client->buffer = g_byte_array_sized_new (BUFFER_SIZE);
+
+    /* If the header of a message is already available, read exactly the bytes
+     * missing to complete it, so that large messages end up on their own in
+     * the buffer and can be processed without copying them */
+    buffered = client->buffer->len;
+    to_read = BUFFER_SIZE;
+    if (client->seqpacket) {
+        gssize available;
+
+        /* Each read returns one single packet, and whatever doesn't fit in the
+         * buffer is lost. The amount of queued data is never less than the
+         * size of the next packet, so read that much if needed */
+        available = g_socket_get_available_bytes (g_socket_connection_get_socket (client->connection));
+        if (available > BUFFER_SIZE)
+            to_read = available;
+    } else if (buffered >= sizeof (struct header)) {
+        guint32 len;
+
+        len = GUINT32_FROM_LE (((struct header *)client->buffer->data)->length);
+        if (len > buffered)
+            to_read = MIN (len - buffered, MAX_READ_SIZE);
+    }
+
+    /* Read straight into the tail of the receive buffer */
+    g_byte_array_set_size (client->buffer, buffered + to_read);
     r = g_input_stream_read (g_io_stream_get_input_stream (G_IO_STREAM (client->connection)),
-                             buffer,
-                             BUFFER_SIZE,
+                             &client->buffer->data[buffered],
+                             to_read,
                              NULL,
                              &error);
+    g_byte_array_set_size (client->buffer, buffered + MAX (r, 0));
+
     if (r < 0) {
         g_warning ("[client %lu] error reading from istream: %s", client->id, error ? error->message : "unknown");
         /* Close the device */
@@ -1154,10 +2464,9 @@ connection_readable_cb (GSocket *socket,
     if (r == 0)
         return TRUE;
 
-    /* else, r > 0 */
-    if (!G_UNLIKELY (client->buffer))
-        client->buffer = g_byte_array_sized_new (r);
-    g_byte_array_append (client->buffer, buffer, r);
+    g_mutex_lock (&self->priv->stats_lock);
+    client->bytes_received += r;
+    g_mutex_unlock (&self->priv->stats_lock);
 
     /* Try to parse input messages */
     parse_request (self, client);
@@ -1165,6 +2474,103 @@ connection_readable_cb (GSocket *socket,
     return TRUE;
 }
 
+static void
+client_setup_readable_source (Client *client)
+{
+    client->connection_readable_source = g_socket_create_source (g_socket_connection_get_socket (client->connection),
+                                                                 G_IO_IN | G_IO_PRI | G_IO_ERR | G_IO_HUP,
+                                                                 NULL);
+    g_source_set_callback (client->connection_readable_source,
+                           (GSourceFunc)connection_readable_cb,
+                           client,
+                           NULL);
+    g_source_attach (client->connection_readable_source, g_main_context_get_thread_default ());
+}
+
+static gboolean
+client_migrated_cb (Request *request)
+{
+    Client            *client;
+    g_autoptr(GError)  error = NULL;
+
+    client = request->client;
+    g_debug ("[client %lu] handled in the worker thread of device '%s'", client->id, client->worker->path);
+
+    /* Reinstall the sources in the context of the worker thread */
+    client_setup_readable_source (client);
+    if (!g_queue_is_empty (&client->output_queue) && !client_output_flush (client, &error)) {
+        g_warning ("[client %lu] %s", client->id, error->message);
+        untrack_client (request->self, client);
+        request_complete_and_free (request);
+        return G_SOURCE_REMOVE;
+    }
+
+    /* Go on with the proxy config */
+    proxy_config_device (request->self, request);
+
+    /* And process whatever else was received in the meantime */
+    if (client->connection && client->buffer && client->buffer->len > 0)
+        parse_request (client->self, client);
+
+    return G_SOURCE_REMOVE;
+}
+
+static void
+client_migrate (Client *client)
+{
+    Request *request;
+    GSource *source;
+
+    request = client->migrate_request;
+    client->migrate_request = NULL;
+
+    /* Timers of the indications held back run in this context */
+    if (client->indication_filter)
+        mbim_indication_filter_flush (client->indication_filter);
+
+    /* From now on, the client is no longer handled in this context; the output
+     * pending to be written, if any, is kept */
+    if (client->connection_readable_source) {
+        g_source_destroy (client->connection_readable_source);
+        g_source_unref (client->connection_readable_source);
+        client->connection_readable_source = NULL;
+    }
+    if (client->connection_writable_source) {
+        g_source_destroy (client->connection_writable_source);
+        g_source_unref (client->connection_writable_source);
+        client->connection_writable_source = NULL;
+    }
+
+    source = g_idle_source_new ();
+    g_source_set_callback (source, (GSourceFunc) client_migrated_cb, request, NULL);
+    g_source_attach (source, client->worker->context);
+    g_source_unref (source);
+}
+
+static gboolean
+connection_writable_cb (GSocket      *socket,
+                        GIOCondition  condition,
+                        Client       *client)
+{
+    g_autoptr(GError) error = NULL;
+
+    if (!client_output_flush (client, &error)) {
+        g_warning ("[client %lu] %s", client->id, error->message);
+        /* Disconnect and untrack client; the source is disposed there */
+        client_ref (client);
+        untrack_client (client->self, client);
+        client_unref (client);
+        return G_SOURCE_REMOVE;
+    }
+
+    if (!g_queue_is_empty (&client->output_queue))
+        return G_SOURCE_CONTINUE;
+
+    g_source_unref (client->connection_writable_source);
+    client->connection_writable_source = NULL;
+    return G_SOURCE_REMOVE;
+}
+
 static void
 incoming_cb (GSocketService    *service,
              GSocketConnection *connection,
@@ -1206,18 +2612,17 @@ incoming_cb (GSocketService    *service,
     client->ref_count = 1;
     client->id = client_id;
     client->connection = g_object_ref (connection);
+    client->seqpacket = (g_socket_get_socket_type (g_socket_connection_get_socket (connection)) == G_SOCKET_TYPE_SEQPACKET);
+    /* Output is flushed with g_socket_send_message(), which has no explicit
+     * blocking argument */
+    g_socket_set_blocking (g_socket_connection_get_socket (connection), FALSE);
+    client->command_timeout_secs = DEFAULT_COMMAND_TIMEOUT_SECS;
+    client->cancellable = g_cancellable_new ();
 
     /* By default, a new client has all the standard services enabled for indications */
     client->mbim_event_entry_array = _mbim_proxy_helper_service_subscribe_list_new_standard (&client->mbim_event_entry_array_size);
 
-    client->connection_readable_source = g_socket_create_source (g_socket_connection_get_socket (client->connection),
-                                                                 G_IO_IN | G_IO_PRI | G_IO_ERR | G_IO_HUP,
-                                                                 NULL);
-    g_source_set_callback (client->connection_readable_source,
-                           (GSourceFunc)connection_readable_cb,
-                           client,
-                           NULL);
-    g_source_attach (client->connection_readable_source, g_main_context_get_thread_default ());
+    client_setup_readable_source (client);
 
     /* Keep the client info around */
     track_client (self, client);
@@ -1226,14 +2631,16 @@ incoming_cb (GSocketService    *service,
 }
 
 static gboolean
-setup_socket_service (MbimProxy  *self,
-                      GError    **error)
+add_listening_socket (MbimProxy    *self,
+                      GSocketType   type,
+                      const gchar  *path,
+                      GError      **error)
 {
     g_autoptr(GSocketAddress) socket_address = NULL;
     g_autoptr(GSocket)        socket = NULL;
 
     socket = g_socket_new (G_SOCKET_FAMILY_UNIX,
-                           G_SOCKET_TYPE_STREAM,
+                           type,
                            G_SOCKET_PROTOCOL_DEFAULT,
                            error);
     if (!socket)
@@ -1241,30 +2648,49 @@ setup_socket_service (MbimProxy  *self,
 
     /* Bind to address */
     socket_address = (g_unix_socket_address_new_with_type (
-                          MBIM_PROXY_SOCKET_PATH,
+                          path,
                           -1,
                           G_UNIX_SOCKET_ADDRESS_ABSTRACT));
     if (!g_socket_bind (socket, socket_address, TRUE, error))
         return FALSE;
 
-    g_debug ("creating UNIX socket service...");
-
     /* Listen */
     if (!g_socket_listen (socket, error))
         return FALSE;
 
-    /* Create socket service */
-    self->priv->socket_service = g_socket_service_new ();
-    g_signal_connect (self->priv->socket_service, "incoming", G_CALLBACK (incoming_cb), self);
     if (!g_socket_listener_add_socket (G_SOCKET_LISTENER (self->priv->socket_service),
                                        socket,
                                        NULL, /* don't pass an object, will take a reference */
                                        error)) {
-        g_prefix_error (error, "Error adding socket at '%s' to socket service: ", MBIM_PROXY_SOCKET_PATH);
+        g_prefix_error (error, "Error adding socket at '%s' to socket service: ", path);
         return FALSE;
     }
 
-    g_debug ("starting UNIX socket service at '%s'...", MBIM_PROXY_SOCKET_PATH);
+    g_debug ("listening at '%s'...", path);
+    return TRUE;
+}
+
+static gboolean
+setup_socket_service (MbimProxy  *self,
+                      GError    **error)
+{
+    g_autoptr(GError) inner_error = NULL;
+
+    g_debug ("creating UNIX socket service...");
+
+    /* Create socket service */
+    self->priv->socket_service = g_socket_service_new ();
+    g_signal_connect (self->priv->socket_service, "incoming", G_CALLBACK (incoming_cb), self);
+
+    if (!add_listening_socket (self, G_SOCKET_TYPE_STREAM, MBIM_PROXY_SOCKET_PATH, error))
+        return FALSE;
+
+    /* The socket preserving message boundaries is optional, clients fallback
+     * to the stream one if it's not available */
+    if (!add_listening_socket (self, G_SOCKET_TYPE_SEQPACKET, MBIM_PROXY_SEQPACKET_SOCKET_PATH, &inner_error))
+        g_warning ("couldn't setup seqpacket socket: %s", inner_error->message);
+
+    g_debug ("starting UNIX socket service...");
     g_socket_service_start (self->priv->socket_service);
     return TRUE;
 }
@@ -1279,12 +2705,34 @@ typedef struct {
     /* Combined events array */
     MbimEventEntry **mbim_event_entry_array;
     gsize            mbim_event_entry_array_size;
+    /* Services and cids requested by all clients, and whether they changed
+     * since the combined events array was last built */
+    MbimProxySubscribeTable *subscribe_table;
+    gboolean                 subscribe_table_changed;
+    /* Indication dispatch index: MbimProxyServiceCidKey -> GPtrArray of Client */
+    GHashTable      *dispatch_index;
+    /* Clients using the device, not full refs */
+    GPtrArray       *clients;
+    /* Ongoing coalesced queries: GBytes key -> CoalescedQuery */
+    GHashTable      *queries;
+    /* Ongoing coalesced queries that new ones can no longer wait for */
+    GList           *detached_queries;
+    /* Latest known state: StateCacheKey -> MbimMessage */
+    GHashTable      *state_cache;
+    /* Statistics, protected by the stats lock */
+    ForwardStatistics stats;
+    guint64           indications;
 } DeviceContext;
 
 static void
 device_context_free (DeviceContext *ctx)
 {
     mbim_event_entry_array_free (ctx->mbim_event_entry_array);
+    _mbim_proxy_helper_subscribe_table_free (ctx->subscribe_table);
+    g_hash_table_unref (ctx->dispatch_index);
+    g_ptr_array_unref (ctx->clients);
+    g_hash_table_unref (ctx->queries);
+    g_hash_table_unref (ctx->state_cache);
     g_slice_free (DeviceContext, ctx);
 }
 
@@ -1293,57 +2741,286 @@ device_context_get (MbimDevice *device)
 {
     DeviceContext *ctx;
 
-    if (G_UNLIKELY (!device_context_quark))
-        device_context_quark = g_quark_from_static_string (DEVICE_CONTEXT_TAG);
-
     ctx = g_object_get_qdata (G_OBJECT (device), device_context_quark);
     if (!ctx) {
         ctx = g_slice_new0 (DeviceContext);
         ctx->mbim_event_entry_array = _mbim_proxy_helper_service_subscribe_list_new_standard (&ctx->mbim_event_entry_array_size);
+        ctx->subscribe_table = _mbim_proxy_helper_subscribe_table_new ();
+        ctx->dispatch_index = g_hash_table_new_full (_mbim_proxy_helper_service_cid_key_hash,
+                                                     _mbim_proxy_helper_service_cid_key_equal,
+                                                     g_free,
+                                                     (GDestroyNotify) g_ptr_array_unref);
+        ctx->clients = g_ptr_array_new ();
+        ctx->queries = g_hash_table_new_full (g_bytes_hash, g_bytes_equal, (GDestroyNotify) g_bytes_unref, NULL);
+        ctx->state_cache = g_hash_table_new_full (state_cache_key_hash, state_cache_key_equal, g_free, (GDestroyNotify) mbim_message_unref);
 
         g_debug ("[%s] initial device subscribe list...", mbim_device_get_path (device));
         _mbim_proxy_helper_service_subscribe_list_debug ((const MbimEventEntry * const *)ctx->mbim_event_entry_array, ctx->mbim_event_entry_array_size);
 
+        /* Not yet visible to anyone else, so no need to lock */
+        forward_statistics_set_subscribed (&ctx->stats, ctx->mbim_event_entry_array, ctx->mbim_event_entry_array_size);
+
         g_object_set_qdata_full (G_OBJECT (device), device_context_quark, ctx, (GDestroyNotify)device_context_free);
     }
 
     return ctx;
 }
 
+static GPtrArray *
+device_index_lookup (MbimDevice     *device,
+                     const MbimUuid *service_id,
+                     guint32         cid)
+{
+    DeviceContext          *ctx;
+    MbimProxyServiceCidKey  key;
+
+    ctx = device_context_get (device);
+    _mbim_proxy_helper_service_cid_key_init (&key, service_id, cid);
+    return g_hash_table_lookup (ctx->dispatch_index, &key);
+}
+
+static void
+device_index_update (DeviceContext  *ctx,
+                     const MbimUuid *service_id,
+                     guint32         cid,
+                     Client         *client,
+                     gboolean        add)
+{
+    MbimProxyServiceCidKey  key;
+    GPtrArray              *clients;
+
+    _mbim_proxy_helper_service_cid_key_init (&key, service_id, cid);
+    clients = g_hash_table_lookup (ctx->dispatch_index, &key);
+
+    if (!add) {
+        if (clients && g_ptr_array_remove (clients, client) && clients->len == 0)
+            g_hash_table_remove (ctx->dispatch_index, &key);
+        return;
+    }
+
+    if (!clients) {
+        clients = g_ptr_array_new ();
+        g_hash_table_insert (ctx->dispatch_index, g_memdup (&key, sizeof (key)), clients);
+    }
+    if (!g_ptr_array_find (clients, client, NULL))
+        g_ptr_array_add (clients, client);
+}
+
+static void
+device_index_update_client (Client   *client,
+                            gboolean  add)
+{
+    DeviceContext *ctx;
+    gsize          i;
+    guint          j;
+
+    if (!client->device || !client->mbim_event_entry_array)
+        return;
+
+    ctx = device_context_get (client->device);
+
+    /* The device-level subscriptions consider every entry in the client list */
+    if (add)
+        ctx->subscribe_table_changed |= _mbim_proxy_helper_subscribe_table_add (ctx->subscribe_table,
+                                                                               (const MbimEventEntry * const *)client->mbim_event_entry_array,
+                                                                               client->mbim_event_entry_array_size);
+    else
+        ctx->subscribe_table_changed |= _mbim_proxy_helper_subscribe_table_remove (ctx->subscribe_table,
+                                                                                  (const MbimEventEntry * const *)client->mbim_event_entry_array,
+                                                                                  client->mbim_event_entry_array_size);
+
+    for (i = 0; i < client->mbim_event_entry_array_size; i++) {
+        const MbimEventEntry *entry;
+        gsize                 k;
+
+        /* Only the first entry for a given service is ever considered */
+        entry = client->mbim_event_entry_array[i];
+        for (k = 0; k < i; k++) {
+            if (mbim_uuid_cmp (&entry->device_service_id,
+                               &client->mbim_event_entry_array[k]->device_service_id))
+                break;
+        }
+        if (k < i)
+            continue;
+
+        if (entry->cids_count == 0) {
+            device_index_update (ctx, &entry->device_service_id, 0, client, add);
+            continue;
+        }
+
+        for (j = 0; j < entry->cids_count; j++)
+            device_index_update (ctx, &entry->device_service_id, entry->cids[j], client, add);
+    }
+}
+
+static void
+device_index_add_client (Client *client)
+{
+    device_index_update_client (client, TRUE);
+}
+
+static void
+device_index_remove_client (Client *client)
+{
+    device_index_update_client (client, FALSE);
+}
+
+static GHashTable *
+device_queries_get (MbimDevice *device)
+{
+    return device_context_get (device)->queries;
+}
+
+/* Returns all the ongoing coalesced queries, detached or not */
+static GList *
+device_queries_list (MbimDevice *device)
+{
+    DeviceContext *ctx;
+
+    ctx = device_context_get (device);
+    return g_list_concat (g_hash_table_get_values (ctx->queries),
+                          g_list_copy (ctx->detached_queries));
+}
+
+static void
+device_queries_remove (MbimDevice     *device,
+                       CoalescedQuery *query)
+{
+    DeviceContext *ctx;
+
+    ctx = device_context_get (device);
+    if (query->detached)
+        ctx->detached_queries = g_list_remove (ctx->detached_queries, query);
+    else
+        g_hash_table_remove (ctx->queries, query->key);
+}
+
+static void
+device_queries_detach_all (MbimDevice *device)
+{
+    DeviceContext  *ctx;
+    GHashTableIter  iter;
+    CoalescedQuery *query;
+
+    ctx = device_context_get (device);
+    g_hash_table_iter_init (&iter, ctx->queries);
+    while (g_hash_table_iter_next (&iter, NULL, (gpointer *)&query)) {
+        query->detached = TRUE;
+        ctx->detached_queries = g_list_prepend (ctx->detached_queries, query);
+        g_hash_table_iter_remove (&iter);
+    }
+}
+
+static GHashTable *
+device_state_cache_get (MbimDevice *device)
+{
+    return device_context_get (device)->state_cache;
+}
+
+static void
+device_state_cache_clear (MbimDevice *device)
+{
+    g_hash_table_remove_all (device_context_get (device)->state_cache);
+}
+
+static gboolean
+device_is_subscribed (MbimDevice     *device,
+                      const MbimUuid *service_id,
+                      guint32         cid)
+{
+    DeviceContext *ctx;
+    gsize          i;
+    guint          j;
+
+    ctx = device_context_get (device);
+    for (i = 0; i < ctx->mbim_event_entry_array_size; i++) {
+        const MbimEventEntry *entry;
+
+        entry = ctx->mbim_event_entry_array[i];
+        if (!mbim_uuid_cmp (&entry->device_service_id, service_id))
+            continue;
+        if (entry->cids_count == 0)
+            return TRUE;
+        for (j = 0; j < entry->cids_count; j++) {
+            if (entry->cids[j] == cid)
+                return TRUE;
+        }
+    }
+    return FALSE;
+}
+
+static ForwardStatistics *
+device_forward_statistics_get (MbimDevice *device)
+{
+    return &device_context_get (device)->stats;
+}
+
+/* Must be called with the stats lock held; may be called from any thread */
+static gboolean
+device_forward_statistics_peek (MbimDevice        *device,
+                                ForwardStatistics *out_stats,
+                                guint64           *out_indications)
+{
+    DeviceContext *ctx;
+
+    ctx = g_object_get_qdata (G_OBJECT (device), device_context_quark);
+    if (!ctx)
+        return FALSE;
+
+    *out_stats = ctx->stats;
+    *out_indications = ctx->indications;
+    return TRUE;
+}
+
+static void
+device_indication_received (MbimProxy  *self,
+                            MbimDevice *device)
+{
+    DeviceContext *ctx;
+
+    ctx = device_context_get (device);
+    g_mutex_lock (&self->priv->stats_lock);
+    ctx->indications++;
+    g_mutex_unlock (&self->priv->stats_lock);
+}
+
+static void
+device_clients_add (Client *client)
+{
+    g_ptr_array_add (device_context_get (client->device)->clients, client);
+}
+
+static void
+device_clients_remove (Client *client)
+{
+    g_ptr_array_remove (device_context_get (client->device)->clients, client);
+}
+
 static MbimEventEntry **
 merge_client_service_subscribe_lists (MbimProxy  *self,
                                       MbimDevice *device,
                                       gsize      *out_size)
 {
-    GList                          *l;
     g_autoptr(MbimEventEntryArray)  updated = NULL;
     gsize                           updated_size = 0;
     DeviceContext                  *ctx;
 
-    g_debug ("[%s] merging client service subscribe lists...", mbim_device_get_path (device));
     ctx = device_context_get (device);
     g_assert (ctx);
 
     g_assert (out_size != NULL);
 
-    /* Init default list */
-    updated = _mbim_proxy_helper_service_subscribe_list_new_standard (&updated_size);
-
-    /* Lookup all clients with this device */
-    for (l = self->priv->clients; l; l = g_list_next (l)) {
-        Client *client;
-
-        client = l->data;
-        if (!client->mbim_event_entry_array)
-            continue;
-
-        /* Add per-client list */
-        if (client->device == device)
-            updated = _mbim_proxy_helper_service_subscribe_list_merge (updated, updated_size,
-                                                                       client->mbim_event_entry_array, client->mbim_event_entry_array_size,
-                                                                       &updated_size);
+    /* The table is updated as soon as any client list changes, so there is
+     * nothing to merge unless it changed since last time */
+    if (!ctx->subscribe_table_changed) {
+        g_debug ("[%s] service subscribe list not updated", mbim_device_get_path (device));
+        return NULL;
     }
 
+    g_debug ("[%s] building merged service subscribe list...", mbim_device_get_path (device));
+    updated = _mbim_proxy_helper_subscribe_table_build (ctx->subscribe_table, &updated_size);
+    ctx->subscribe_table_changed = FALSE;
+
     /* If lists are equal, ignore re-setting them up */
     if (_mbim_proxy_helper_service_subscribe_list_cmp (
             (const MbimEventEntry *const *)updated, updated_size,
@@ -1352,12 +3029,15 @@ merge_client_service_subscribe_lists (MbimProxy  *self,
         return NULL;
     }
 
-    /* Lists are different, update stored one */
+    /* Lists are different, update stored one; the state kept may no longer
+     * be updated with indications */
+    device_state_cache_clear (device);
     g_clear_pointer (&ctx->mbim_event_entry_array, mbim_event_entry_array_free);
     ctx->mbim_event_entry_array = g_steal_pointer (&updated);
     ctx->mbim_event_entry_array_size = updated_size;
+    forward_statistics_update_subscribed (self, &ctx->stats, ctx->mbim_event_entry_array, ctx->mbim_event_entry_array_size);
 
-    if (mbim_utils_get_traces_enabled ()) {
+    if (_mbim_utils_trace_enabled (MBIM_TRACE_CATEGORY_PROXY)) {
         g_debug ("[%s] merged service subscribe list built", mbim_device_get_path (device));
         _mbim_proxy_helper_service_subscribe_list_debug ((const MbimEventEntry * const *)ctx->mbim_event_entry_array,
                                                          ctx->mbim_event_entry_array_size);
@@ -1372,29 +3052,37 @@ reset_client_service_subscribe_lists (MbimProxy  *self,
                                       MbimDevice *device)
 {
     DeviceContext *ctx;
-    GList         *l;
+    guint          i;
 
     g_debug ("[%s] reseting client service subscribe lists...", mbim_device_get_path (device));
     ctx = device_context_get (device);
     g_assert (ctx);
 
     /* make sure that all clients of this device don't track any event registered */
-    for (l = self->priv->clients; l; l = g_list_next (l)) {
+    for (i = 0; i < ctx->clients->len; i++) {
         Client *client;
 
-        client = l->data;
+        client = g_ptr_array_index (ctx->clients, i);
         if (!client->mbim_event_entry_array)
             continue;
 
-        if (client->device == device) {
-            g_clear_pointer (&client->mbim_event_entry_array, mbim_event_entry_array_free);
-            client->mbim_event_entry_array = _mbim_proxy_helper_service_subscribe_list_new_standard (&client->mbim_event_entry_array_size);
-        }
+        device_index_remove_client (client);
+        g_clear_pointer (&client->mbim_event_entry_array, mbim_event_entry_array_free);
+        client->mbim_event_entry_array = _mbim_proxy_helper_service_subscribe_list_new_standard (&client->mbim_event_entry_array_size);
+        device_index_add_client (client);
+        forward_statistics_update_subscribed (self,
+                                              &client->stats,
+                                              client->mbim_event_entry_array,
+                                              client->mbim_event_entry_array_size);
     }
 
-    /* And reset the device-specific merged list */
+    /* And reset the device-specific merged list; the table is now empty, as
+     * no client has anything but standard services */
+    device_state_cache_clear (device);
     g_clear_pointer (&ctx->mbim_event_entry_array, mbim_event_entry_array_free);
     ctx->mbim_event_entry_array = _mbim_proxy_helper_service_subscribe_list_new_standard (&ctx->mbim_event_entry_array_size);
+    ctx->subscribe_table_changed = FALSE;
+    forward_statistics_update_subscribed (self, &ctx->stats, ctx->mbim_event_entry_array, ctx->mbim_event_entry_array_size);
 }
 
 static void
@@ -1413,15 +3101,13 @@ static MbimDevice *
 peek_device_for_path (MbimProxy   *self,
                       const gchar *path)
 {
-    GList *l;
+    MbimDevice *device;
 
-    for (l = self->priv->devices; l; l = g_list_next (l)) {
-        /* Return if found */
-        if (g_str_equal (mbim_device_get_path ((MbimDevice *)l->data), path))
-            return (MbimDevice *)l->data;
-    }
+    g_mutex_lock (&self->priv->lock);
+    device = g_hash_table_lookup (self->priv->devices, path);
+    g_mutex_unlock (&self->priv->lock);
 
-    return NULL;
+    return device;
 }
 
 static void
@@ -1435,26 +3121,32 @@ static void
 untrack_device (MbimProxy  *self,
                 MbimDevice *device)
 {
-    GList *l;
-    GList *to_remove = NULL;
+    DeviceContext *ctx;
+    GList         *l;
+    GList         *to_remove = NULL;
+    guint          i;
+    gboolean       tracked;
 
     g_debug ("[%s] untracking device...", mbim_device_get_path (device));
 
-    if (!g_list_find (self->priv->devices, device))
+    g_mutex_lock (&self->priv->lock);
+    tracked = (g_hash_table_lookup (self->priv->devices, mbim_device_get_path (device)) == device);
+    g_mutex_unlock (&self->priv->lock);
+    if (!tracked)
         return;
 
     /* Disconnect right away */
     g_signal_handlers_disconnect_by_func (device, proxy_device_error_cb, self);
     g_signal_handlers_disconnect_by_func (device, proxy_device_removed_cb, self);
+    g_signal_handlers_disconnect_by_func (device, proxy_device_indication_cb, self);
 
     /* If pending openings ongoing, complete them with error */
     cancel_opening_device (self, device);
 
     /* Lookup all clients with this device */
-    for (l = self->priv->clients; l; l = g_list_next (l)) {
-        if (((Client *)(l->data))->device == device)
-            to_remove = g_list_append (to_remove, l->data);
-    }
+    ctx = device_context_get (device);
+    for (i = 0; i < ctx->clients->len; i++)
+        to_remove = g_list_prepend (to_remove, g_ptr_array_index (ctx->clients, i));
 
     /* Remove all these clients */
     for (l = to_remove; l; l = g_list_next (l))
@@ -1462,9 +3154,11 @@ untrack_device (MbimProxy  *self,
     g_list_free (to_remove);
 
     /* And finally, remove the device */
-    self->priv->devices = g_list_remove (self->priv->devices, device);
+    g_mutex_lock (&self->priv->lock);
+    g_hash_table_remove (self->priv->devices, mbim_device_get_path (device));
+    g_mutex_unlock (&self->priv->lock);
     g_object_unref (device);
-    g_object_notify_by_pspec (G_OBJECT (self), properties[PROP_N_DEVICES]);
+    proxy_notify (self, properties[PROP_N_DEVICES]);
 }
 
 static void
@@ -1481,14 +3175,23 @@ track_device (MbimProxy *self,
                       G_CALLBACK (proxy_device_error_cb),
                       self);
 
-    self->priv->devices = g_list_append (self->priv->devices, g_object_ref (device));
-    g_object_notify_by_pspec (G_OBJECT (self), properties[PROP_N_DEVICES]);
+    g_signal_connect (device,
+                      MBIM_DEVICE_SIGNAL_INDICATE_STATUS,
+                      G_CALLBACK (proxy_device_indication_cb),
+                      self);
+
+    g_mutex_lock (&self->priv->lock);
+    /* The path is owned by the device itself */
+    g_hash_table_insert (self->priv->devices, (gpointer) mbim_device_get_path (device), g_object_ref (device));
+    g_mutex_unlock (&self->priv->lock);
+    proxy_notify (self, properties[PROP_N_DEVICES]);
 }
 
 /*****************************************************************************/
 
 MbimProxy *
-mbim_proxy_new (GError **error)
+mbim_proxy_new_full (MbimProxyFlags   flags,
+                     GError         **error)
 {
     g_autoptr(MbimProxy) self = NULL;
 
@@ -1496,16 +3199,30 @@ mbim_proxy_new (GError **error)
         return NULL;
 
     self = g_object_new (MBIM_TYPE_PROXY, NULL);
+    self->priv->flags = flags;
     if (!setup_socket_service (self, error))
         return NULL;
 
     return g_steal_pointer (&self);
 }
 
+MbimProxy *
+mbim_proxy_new (GError **error)
+{
+    return mbim_proxy_new_full (MBIM_PROXY_FLAGS_NONE, error);
+}
+
 static void
 mbim_proxy_init (MbimProxy *self)
 {
     self->priv = G_TYPE_INSTANCE_GET_PRIVATE (self, MBIM_TYPE_PROXY, MbimProxyPrivate);
+    self->priv->main_context = g_main_context_ref_thread_default ();
+    g_mutex_init (&self->priv->lock);
+    g_mutex_init (&self->priv->stats_lock);
+    self->priv->clients = g_hash_table_new (g_direct_hash, g_direct_equal);
+    self->priv->devices = g_hash_table_new (g_str_hash, g_str_equal);
+    self->priv->opening_devices = g_hash_table_new (g_direct_hash, g_direct_equal);
+    self->priv->workers = g_hash_table_new_full (g_str_hash, g_str_equal, NULL, (GDestroyNotify) device_worker_free);
 }
 
 static void
@@ -1518,10 +3235,10 @@ get_property (GObject    *object,
 
     switch (prop_id) {
     case PROP_N_CLIENTS:
-        g_value_set_uint (value, g_list_length (self->priv->clients));
+        g_value_set_uint (value, mbim_proxy_get_n_clients (self));
         break;
     case PROP_N_DEVICES:
-        g_value_set_uint (value, g_list_length (self->priv->devices));
+        g_value_set_uint (value, mbim_proxy_get_n_devices (self));
         break;
     default:
         G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
@@ -1534,17 +3251,27 @@ dispose (GObject *object)
 {
     MbimProxyPrivate *priv = MBIM_PROXY (object)->priv;
 
-    /* This list should always be empty when disposing */
-    g_assert (priv->opening_devices == NULL);
+    /* This table should always be empty when disposing */
+    g_assert (g_hash_table_size (priv->opening_devices) == 0);
+
+    /* Stop all worker threads before releasing the clients and devices
+     * handled in them */
+    g_hash_table_remove_all (priv->workers);
 
-    if (priv->clients) {
-        g_list_free_full (priv->clients, (GDestroyNotify) client_unref);
-        priv->clients = NULL;
+    if (g_hash_table_size (priv->clients)) {
+        GList *clients;
+
+        clients = g_hash_table_get_keys (priv->clients);
+        g_hash_table_remove_all (priv->clients);
+        g_list_free_full (clients, (GDestroyNotify) client_unref);
     }
 
-    if (priv->devices) {
-        g_list_free_full (priv->devices, g_object_unref);
-        priv->devices = NULL;
+    if (g_hash_table_size (priv->devices)) {
+        GList *devices;
+
+        devices = g_hash_table_get_values (priv->devices);
+        g_hash_table_remove_all (priv->devices);
+        g_list_free_full (devices, g_object_unref);
     }
 
     if (priv->socket_service) {
@@ -1558,6 +3285,22 @@ dispose (GObject *object)
     G_OBJECT_CLASS (mbim_proxy_parent_class)->dispose (object);
 }
 
+static void
+finalize (GObject *object)
+{
+    MbimProxyPrivate *priv = MBIM_PROXY (object)->priv;
+
+    g_hash_table_unref (priv->workers);
+    g_hash_table_unref (priv->opening_devices);
+    g_hash_table_unref (priv->devices);
+    g_hash_table_unref (priv->clients);
+    g_mutex_clear (&priv->stats_lock);
+    g_mutex_clear (&priv->lock);
+    g_main_context_unref (priv->main_context);
+
+    G_OBJECT_CLASS (mbim_proxy_parent_class)->finalize (object);
+}
+
 static void
 mbim_proxy_class_init (MbimProxyClass *proxy_class)
 {
@@ -1568,6 +3311,9 @@ mbim_proxy_class_init (MbimProxyClass *proxy_class)
     /* Virtual methods */
     object_class->get_property = get_property;
     object_class->dispose = dispose;
+    object_class->finalize = finalize;
+
+    device_context_quark = g_quark_from_static_string (DEVICE_CONTEXT_TAG);
 
     /**
      * MbimProxy:mbim-proxy-n-clients
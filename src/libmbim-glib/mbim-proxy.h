@@ -67,6 +67,16 @@ typedef struct _MbimProxyPrivate MbimProxyPrivate;
  */
 #define MBIM_PROXY_SOCKET_PATH "mbim-proxy"
 
+/**
+ * MBIM_PROXY_SEQPACKET_SOCKET_PATH:
+ *
+ * Symbol defining the abstract socket name where the #MbimProxy will listen
+ * for %G_SOCKET_TYPE_SEQPACKET connections.
+ *
+ * Since: 1.26
+ */
+#define MBIM_PROXY_SEQPACKET_SOCKET_PATH "mbim-proxy-seqpacket"
+
 /**
  * MBIM_PROXY_N_CLIENTS:
  *
@@ -117,6 +127,48 @@ G_DEFINE_AUTOPTR_CLEANUP_FUNC (MbimProxy, g_object_unref)
  */
 MbimProxy *mbim_proxy_new (GError **error);
 
+/**
+ * MbimProxyFlags:
+ * @MBIM_PROXY_FLAGS_NONE: None.
+ * @MBIM_PROXY_FLAGS_DEVICE_THREADS: Run each device in its own thread, with
+ *  its own main context. Once a client has configured the device it wants to
+ *  use, all the communication with that client is also handled in the thread
+ *  of that device, so that a busy device doesn't delay the clients of other
+ *  devices.
+ * @MBIM_PROXY_FLAGS_STATE_CACHE: Keep the latest state reported by each device
+ *  for the Subscriber Ready Status, Register State, Packet Service, Signal
+ *  State and Connect commands, either in responses or in indications, and
+ *  answer the queries of those commands right away from it while the device is
+ *  subscribed to their indications.
+ *
+ * Flags to specify how the #MbimProxy should run.
+ *
+ * Since: 1.26
+ */
+typedef enum { /*< since=1.26 >*/
+    MBIM_PROXY_FLAGS_NONE           = 0,
+    MBIM_PROXY_FLAGS_DEVICE_THREADS = 1 << 0,
+    MBIM_PROXY_FLAGS_STATE_CACHE    = 1 << 1
+} MbimProxyFlags;
+
+/**
+ * mbim_proxy_new_full:
+ * @flags: a set of #MbimProxyFlags.
+ * @error: Return location for error or %NULL.
+ *
+ * Creates a #MbimProxy object.
+ *
+ * The proxy itself, and the properties notifying the number of clients and
+ * devices, are always handled in the thread-default main context of the
+ * caller.
+ *
+ * Returns: (transfer full): a newly created #MbimProxy, or #NULL if @error is set.
+ *
+ * Since: 1.26
+ */
+MbimProxy *mbim_proxy_new_full (MbimProxyFlags   flags,
+                                GError         **error);
+
 /**
  * mbim_proxy_get_n_clients: (skip)
  * @self: a #MbimProxy.
@@ -0,0 +1,255 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+
+/*
+ * libmbim-glib -- GLib/GIO based library to control MBIM devices
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ *
+ * Copyright (C) 2026 agent <agent@local>
+ */
+
+#include <config.h>
+#include <string.h>
+
+#include "mbim-statistics.h"
+
+/*****************************************************************************/
+/* Latency histogram */
+
+static const guint64 latency_bounds_us[MBIM_LATENCY_HISTOGRAM_N_BOUNDS] = {
+    1000, 2000, 5000,
+    10000, 20000, 50000,
+    100000, 200000, 500000,
+    1000000, 2000000, 5000000,
+};
+
+void
+mbim_latency_histogram_add (MbimLatencyHistogram *histogram,
+                            gint64                latency_us)
+{
+    guint64 value;
+    guint   i;
+
+    /* Monotonic time never goes back, but be safe */
+    value = (latency_us > 0 ? (guint64) latency_us : 0);
+
+    if (!histogram->count || value < histogram->min_us)
+        histogram->min_us = value;
+    if (value > histogram->max_us)
+        histogram->max_us = value;
+    histogram->count++;
+    histogram->total_us += value;
+
+    for (i = 0; i < MBIM_LATENCY_HISTOGRAM_N_BOUNDS; i++) {
+        if (value < latency_bounds_us[i])
+            break;
+    }
+    histogram->buckets[i]++;
+}
+
+guint64
+mbim_latency_histogram_get_percentile (const MbimLatencyHistogram *histogram,
+                                       guint                       percentile)
+{
+    guint64 needed;
+    guint64 accumulated = 0;
+    guint   i;
+
+    g_assert (percentile <= 100);
+
+    if (!histogram->count)
+        return 0;
+
+    /* Number of samples at or below the percentile, rounded up */
+    needed = (histogram->count * percentile + 99) / 100;
+    if (!needed)
+        needed = 1;
+
+    /* Report the upper bound of the bucket where the percentile falls, never
+     * above the maximum value seen */
+    for (i = 0; i < MBIM_LATENCY_HISTOGRAM_N_BOUNDS; i++) {
+        accumulated += histogram->buckets[i];
+        if (accumulated >= needed)
+            return MIN (latency_bounds_us[i], histogram->max_us);
+    }
+    return histogram->max_us;
+}
+
+void
+mbim_latency_histogram_add_to_builder (const MbimLatencyHistogram *histogram,
+                                       const gchar                *prefix,
+                                       GVariantBuilder            *builder)
+{
+    g_autofree gchar *key = NULL;
+
+#define ADD_VALUE(name, value) do {                                     \
+        g_free (key);                                                   \
+        key = g_strdup_printf ("%s-" name, prefix);                     \
+        g_variant_builder_add (builder, "{sv}", key, g_variant_new_uint64 (value)); \
+    } while (0)
+
+    ADD_VALUE ("min-us",  histogram->min_us);
+    ADD_VALUE ("max-us",  histogram->max_us);
+    ADD_VALUE ("mean-us", histogram->count ? (histogram->total_us / histogram->count) : 0);
+    ADD_VALUE ("p50-us",  mbim_latency_histogram_get_percentile (histogram, 50));
+    ADD_VALUE ("p99-us",  mbim_latency_histogram_get_percentile (histogram, 99));
+
+#undef ADD_VALUE
+
+    g_free (key);
+    key = g_strdup_printf ("%s-histogram", prefix);
+    g_variant_builder_add (builder, "{sv}", key,
+                           g_variant_new_fixed_array (G_VARIANT_TYPE_UINT64,
+                                                      histogram->buckets,
+                                                      MBIM_LATENCY_HISTOGRAM_N_BUCKETS,
+                                                      sizeof (guint64)));
+}
+
+GVariant *
+mbim_latency_histogram_get_bounds (void)
+{
+    return g_variant_new_fixed_array (G_VARIANT_TYPE_UINT64,
+                                      latency_bounds_us,
+                                      MBIM_LATENCY_HISTOGRAM_N_BOUNDS,
+                                      sizeof (guint64));
+}
+
+/*****************************************************************************/
+/* Per command statistics */
+
+static guint
+command_statistics_hash (const MbimCommandStatistics *stats)
+{
+    guint32 a;
+
+    memcpy (&a, stats->service_id.a, sizeof (a));
+    return (guint) (a ^ (stats->cid * 2654435761u));
+}
+
+static gboolean
+command_statistics_equal (const MbimCommandStatistics *a,
+                          const MbimCommandStatistics *b)
+{
+    return (a->cid == b->cid && mbim_uuid_cmp (&a->service_id, &b->service_id));
+}
+
+static void
+command_statistics_free (MbimCommandStatistics *stats)
+{
+    g_slice_free (MbimCommandStatistics, stats);
+}
+
+GHashTable *
+mbim_command_statistics_table_new (void)
+{
+    /* Keys and values are the same */
+    return g_hash_table_new_full ((GHashFunc) command_statistics_hash,
+                                  (GEqualFunc) command_statistics_equal,
+                                  NULL,
+                                  (GDestroyNotify) command_statistics_free);
+}
+
+MbimCommandStatistics *
+mbim_command_statistics_table_lookup (GHashTable     *table,
+                                      const MbimUuid *service_id,
+                                      guint32         cid)
+{
+    MbimCommandStatistics  key;
+    MbimCommandStatistics *stats;
+
+    memcpy (&key.service_id, service_id, sizeof (MbimUuid));
+    key.cid = cid;
+
+    stats = g_hash_table_lookup (table, &key);
+    if (!stats) {
+        stats = g_slice_new0 (MbimCommandStatistics);
+        memcpy (&stats->service_id, service_id, sizeof (MbimUuid));
+        stats->cid = cid;
+        g_hash_table_add (table, stats);
+    }
+    return stats;
+}
+
+GVariant *
+mbim_command_statistics_table_build (GHashTable *table)
+{
+    GVariantBuilder        builder;
+    GHashTableIter         iter;
+    MbimCommandStatistics *stats;
+
+    g_variant_builder_init (&builder, G_VARIANT_TYPE ("aa{sv}"));
+
+    g_hash_table_iter_init (&iter, table);
+    while (g_hash_table_iter_next (&iter, (gpointer *)&stats, NULL)) {
+        g_autofree gchar *service_str = NULL;
+
+        service_str = mbim_uuid_get_printable (&stats->service_id);
+
+        g_variant_builder_open (&builder, G_VARIANT_TYPE ("a{sv}"));
+        g_variant_builder_add (&builder, "{sv}", "service",  g_variant_new_string (service_str));
+        g_variant_builder_add (&builder, "{sv}", "cid",      g_variant_new_uint32 (stats->cid));
+        g_variant_builder_add (&builder, "{sv}", "count",    g_variant_new_uint64 (stats->count));
+        g_variant_builder_add (&builder, "{sv}", "errors",   g_variant_new_uint64 (stats->errors));
+        g_variant_builder_add (&builder, "{sv}", "timeouts", g_variant_new_uint64 (stats->timeouts));
+        mbim_latency_histogram_add_to_builder (&stats->latency, "latency", &builder);
+        g_variant_builder_close (&builder);
+    }
+
+    return g_variant_builder_end (&builder);
+}
+
+/*****************************************************************************/
+/* Event rate */
+
+#define RATE_WINDOW_US G_USEC_PER_SEC
+
+static void
+event_rate_update (MbimEventRate *rate,
+                   gint64         now)
+{
+    gint64 elapsed;
+
+    if (!rate->window_start) {
+        rate->window_start = now;
+        return;
+    }
+
+    elapsed = now - rate->window_start;
+    if (elapsed < RATE_WINDOW_US)
+        return;
+
+    /* If more than one window elapsed, the events are averaged over all of
+     * them, which correctly decays the rate when events stop */
+    rate->rate = (gdouble) rate->window_count * G_USEC_PER_SEC / elapsed;
+    rate->window_start = now;
+    rate->window_count = 0;
+}
+
+void
+mbim_event_rate_add (MbimEventRate *rate,
+                     gint64         now)
+{
+    event_rate_update (rate, now);
+    rate->window_count++;
+}
+
+gdouble
+mbim_event_rate_get (MbimEventRate *rate,
+                     gint64         now)
+{
+    event_rate_update (rate, now);
+    return rate->rate;
+}
@@ -0,0 +1,113 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+
+/*
+ * libmbim-glib -- GLib/GIO based library to control MBIM devices
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ *
+ * Copyright (C) 2026 agent <agent@local>
+ */
+
+#ifndef _LIBMBIM_GLIB_MBIM_STATISTICS_H_
+#define _LIBMBIM_GLIB_MBIM_STATISTICS_H_
+
+#if !defined (LIBMBIM_GLIB_COMPILATION)
+#error "This is a private header!!"
+#endif
+
+#include <glib.h>
+
+#include "mbim-uuid.h"
+
+G_BEGIN_DECLS
+
+/*
+ * Helpers to keep cheap, always-on, control plane statistics, exported as
+ * GVariant dictionaries so that new values can be added without breaking
+ * the API.
+ */
+
+/*****************************************************************************/
+/* Latency histogram */
+
+/* Bucket upper bounds, in microseconds; the last bucket has no bound */
+#define MBIM_LATENCY_HISTOGRAM_N_BOUNDS  12
+#define MBIM_LATENCY_HISTOGRAM_N_BUCKETS (MBIM_LATENCY_HISTOGRAM_N_BOUNDS + 1)
+
+typedef struct {
+    guint64 count;
+    guint64 total_us;
+    guint64 min_us;
+    guint64 max_us;
+    guint64 buckets[MBIM_LATENCY_HISTOGRAM_N_BUCKETS];
+} MbimLatencyHistogram;
+
+G_GNUC_INTERNAL
+void      mbim_latency_histogram_add            (MbimLatencyHistogram       *histogram,
+                                                 gint64                      latency_us);
+G_GNUC_INTERNAL
+guint64   mbim_latency_histogram_get_percentile (const MbimLatencyHistogram *histogram,
+                                                 guint                       percentile);
+G_GNUC_INTERNAL
+void      mbim_latency_histogram_add_to_builder (const MbimLatencyHistogram *histogram,
+                                                 const gchar                *prefix,
+                                                 GVariantBuilder            *builder);
+G_GNUC_INTERNAL
+GVariant *mbim_latency_histogram_get_bounds     (void);
+
+/*****************************************************************************/
+/* Per command statistics */
+
+typedef struct {
+    MbimUuid             service_id;
+    guint32              cid;
+    guint64              count;
+    guint64              errors;
+    guint64              timeouts;
+    MbimLatencyHistogram latency;
+} MbimCommandStatistics;
+
+/* Creates a table of MbimCommandStatistics indexed by service and CID */
+G_GNUC_INTERNAL
+GHashTable            *mbim_command_statistics_table_new    (void);
+G_GNUC_INTERNAL
+MbimCommandStatistics *mbim_command_statistics_table_lookup (GHashTable     *table,
+                                                             const MbimUuid *service_id,
+                                                             guint32         cid);
+G_GNUC_INTERNAL
+GVariant              *mbim_command_statistics_table_build  (GHashTable     *table);
+
+/*****************************************************************************/
+/* Event rate */
+
+typedef struct {
+    gint64  window_start;
+    guint64 window_count;
+    gdouble rate;
+} MbimEventRate;
+
+/* Rates are computed over windows of one second; the value reported is the one
+ * of the last complete window */
+G_GNUC_INTERNAL
+void    mbim_event_rate_add (MbimEventRate *rate,
+                             gint64         now);
+G_GNUC_INTERNAL
+gdouble mbim_event_rate_get (MbimEventRate *rate,
+                             gint64         now);
+
+G_END_DECLS
+
+#endif /* _LIBMBIM_GLIB_MBIM_STATISTICS_H_ */
@@ -0,0 +1,307 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+
+/*
+ * libmbim-glib -- GLib/GIO based library to control MBIM devices
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ *
+ * Copyright (C) 2026 agent <agent@local>
+ */
+
+#include <config.h>
+
+#include "mbim-timer-queue.h"
+
+/*****************************************************************************/
+
+struct _MbimTimer {
+    gint64        deadline;
+    guint64       sequence;
+    guint         index;
+    MbimTimerFunc callback;
+    gpointer      user_data;
+};
+
+struct _MbimTimerQueue {
+    guint         ref_count;
+    GMainContext *context;
+    GSource      *source;
+    /* Binary min-heap of MbimTimer, sorted by deadline */
+    GPtrArray    *heap;
+    guint64       sequence;
+};
+
+typedef struct {
+    GSource         parent;
+    MbimTimerQueue *queue;
+} TimerQueueSource;
+
+/* One queue per main context */
+static GHashTable *queues;
+G_LOCK_DEFINE_STATIC (queues);
+
+/*****************************************************************************/
+/* Heap management */
+
+#define HEAP_TIMER(queue,i) ((MbimTimer *) g_ptr_array_index ((queue)->heap, i))
+
+static gboolean
+timer_before (MbimTimer *a,
+              MbimTimer *b)
+{
+    /* Timers with the same deadline expire in the order they were added */
+    if (a->deadline != b->deadline)
+        return (a->deadline < b->deadline);
+    return (a->sequence < b->sequence);
+}
+
+static void
+heap_set (MbimTimerQueue *queue,
+          guint           i,
+          MbimTimer      *timer)
+{
+    g_ptr_array_index (queue->heap, i) = timer;
+    timer->index = i;
+}
+
+static void
+heap_sift_up (MbimTimerQueue *queue,
+              guint           i)
+{
+    MbimTimer *timer;
+
+    timer = HEAP_TIMER (queue, i);
+    while (i > 0) {
+        guint parent;
+
+        parent = (i - 1) / 2;
+        if (!timer_before (timer, HEAP_TIMER (queue, parent)))
+            break;
+        heap_set (queue, i, HEAP_TIMER (queue, parent));
+        i = parent;
+    }
+    heap_set (queue, i, timer);
+}
+
+static void
+heap_sift_down (MbimTimerQueue *queue,
+                guint           i)
+{
+    MbimTimer *timer;
+
+    timer = HEAP_TIMER (queue, i);
+    while (TRUE) {
+        guint child;
+
+        child = (2 * i) + 1;
+        if (child >= queue->heap->len)
+            break;
+        if ((child + 1 < queue->heap->len) &&
+            timer_before (HEAP_TIMER (queue, child + 1), HEAP_TIMER (queue, child)))
+            child++;
+        if (!timer_before (HEAP_TIMER (queue, child), timer))
+            break;
+        heap_set (queue, i, HEAP_TIMER (queue, child));
+        i = child;
+    }
+    heap_set (queue, i, timer);
+}
+
+static void
+heap_remove (MbimTimerQueue *queue,
+             MbimTimer      *timer)
+{
+    MbimTimer *last;
+    guint      i;
+
+    g_assert (timer->index < queue->heap->len);
+    g_assert (HEAP_TIMER (queue, timer->index) == timer);
+
+    i = timer->index;
+    last = g_ptr_array_remove_index (queue->heap, queue->heap->len - 1);
+    if (last == timer)
+        return;
+
+    /* Move the last element to the free slot and restore the heap order */
+    heap_set (queue, i, last);
+    heap_sift_down (queue, i);
+    heap_sift_up (queue, last->index);
+}
+
+static void
+timer_queue_update_ready_time (MbimTimerQueue *queue)
+{
+    g_source_set_ready_time (queue->source,
+                             queue->heap->len > 0 ? HEAP_TIMER (queue, 0)->deadline : -1);
+}
+
+/*****************************************************************************/
+/* Source */
+
+static void timer_queue_ref (MbimTimerQueue *queue);
+
+static gboolean
+timer_queue_source_dispatch (GSource     *source,
+                             GSourceFunc  callback,
+                             gpointer     user_data)
+{
+    MbimTimerQueue *queue;
+    gint64          now;
+
+    queue = ((TimerQueueSource *) source)->queue;
+    now = g_source_get_time (source);
+
+    /* The callbacks may drop the last reference to the queue */
+    timer_queue_ref (queue);
+
+    while (queue->heap->len > 0) {
+        MbimTimer *timer;
+
+        timer = HEAP_TIMER (queue, 0);
+        if (timer->deadline > now)
+            break;
+
+        /* Remove before calling the callback, as the callback may add or
+         * remove other timers */
+        heap_remove (queue, timer);
+        timer->callback (timer->user_data);
+        g_slice_free (MbimTimer, timer);
+    }
+
+    timer_queue_update_ready_time (queue);
+    mbim_timer_queue_unref (queue);
+
+    return G_SOURCE_CONTINUE;
+}
+
+static GSourceFuncs timer_queue_source_funcs = {
+    NULL, /* prepare */
+    NULL, /* check */
+    timer_queue_source_dispatch,
+    NULL, /* finalize */
+};
+
+/*****************************************************************************/
+
+static void
+timer_queue_ref (MbimTimerQueue *queue)
+{
+    G_LOCK (queues);
+    queue->ref_count++;
+    G_UNLOCK (queues);
+}
+
+MbimTimerQueue *
+mbim_timer_queue_ref_for_context (GMainContext *context)
+{
+    MbimTimerQueue *queue;
+
+    if (!context)
+        context = g_main_context_default ();
+
+    G_LOCK (queues);
+
+    if (G_UNLIKELY (!queues))
+        queues = g_hash_table_new (g_direct_hash, g_direct_equal);
+
+    queue = g_hash_table_lookup (queues, context);
+    if (queue) {
+        queue->ref_count++;
+        G_UNLOCK (queues);
+        return queue;
+    }
+
+    queue = g_slice_new0 (MbimTimerQueue);
+    queue->ref_count = 1;
+    queue->context = g_main_context_ref (context);
+    queue->heap = g_ptr_array_new ();
+    queue->source = g_source_new (&timer_queue_source_funcs, sizeof (TimerQueueSource));
+    ((TimerQueueSource *) queue->source)->queue = queue;
+    g_source_set_ready_time (queue->source, -1);
+    g_source_attach (queue->source, context);
+
+    g_hash_table_insert (queues, context, queue);
+
+    G_UNLOCK (queues);
+    return queue;
+}
+
+void
+mbim_timer_queue_unref (MbimTimerQueue *queue)
+{
+    guint i;
+
+    G_LOCK (queues);
+    g_assert (queue->ref_count > 0);
+    if (--queue->ref_count > 0) {
+        G_UNLOCK (queues);
+        return;
+    }
+    g_hash_table_remove (queues, queue->context);
+    G_UNLOCK (queues);
+
+    /* All users should have removed their timers already */
+    if (queue->heap->len > 0)
+        g_warning ("timer queue disposed with %u pending timers", queue->heap->len);
+    for (i = 0; i < queue->heap->len; i++)
+        g_slice_free (MbimTimer, HEAP_TIMER (queue, i));
+    g_ptr_array_unref (queue->heap);
+
+    g_source_destroy (queue->source);
+    g_source_unref (queue->source);
+    g_main_context_unref (queue->context);
+    g_slice_free (MbimTimerQueue, queue);
+}
+
+MbimTimer *
+mbim_timer_queue_add (MbimTimerQueue *queue,
+                      guint           timeout_ms,
+                      MbimTimerFunc   callback,
+                      gpointer        user_data)
+{
+    MbimTimer *timer;
+
+    g_assert (callback != NULL);
+
+    timer = g_slice_new (MbimTimer);
+    timer->deadline = g_get_monotonic_time () + ((gint64) timeout_ms * 1000);
+    timer->sequence = queue->sequence++;
+    timer->callback = callback;
+    timer->user_data = user_data;
+
+    g_ptr_array_add (queue->heap, timer);
+    timer->index = queue->heap->len - 1;
+    heap_sift_up (queue, timer->index);
+
+    if (timer->index == 0)
+        timer_queue_update_ready_time (queue);
+
+    return timer;
+}
+
+void
+mbim_timer_queue_remove (MbimTimerQueue *queue,
+                         MbimTimer      *timer)
+{
+    gboolean was_first;
+
+    was_first = (timer->index == 0);
+    heap_remove (queue, timer);
+    g_slice_free (MbimTimer, timer);
+
+    if (was_first)
+        timer_queue_update_ready_time (queue);
+}
@@ -0,0 +1,64 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+
+/*
+ * libmbim-glib -- GLib/GIO based library to control MBIM devices
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ *
+ * Copyright (C) 2026 agent <agent@local>
+ */
+
+#ifndef _LIBMBIM_GLIB_MBIM_TIMER_QUEUE_H_
+#define _LIBMBIM_GLIB_MBIM_TIMER_QUEUE_H_
+
+#if !defined (LIBMBIM_GLIB_COMPILATION)
+#error "This is a private header!!"
+#endif
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/*
+ * A timer queue drives any number of one-shot timers from a single GSource
+ * attached to a given GMainContext. There is one single queue per context,
+ * shared by all the users running in that context.
+ *
+ * The timer callbacks are called exactly once, unless the timer is removed
+ * before it expires; the timer handle is no longer valid after either.
+ */
+
+typedef struct _MbimTimerQueue MbimTimerQueue;
+typedef struct _MbimTimer      MbimTimer;
+
+typedef void (* MbimTimerFunc) (gpointer user_data);
+
+G_GNUC_INTERNAL
+MbimTimerQueue *mbim_timer_queue_ref_for_context (GMainContext   *context);
+G_GNUC_INTERNAL
+void            mbim_timer_queue_unref           (MbimTimerQueue *queue);
+G_GNUC_INTERNAL
+MbimTimer      *mbim_timer_queue_add             (MbimTimerQueue *queue,
+                                                  guint           timeout_ms,
+                                                  MbimTimerFunc   callback,
+                                                  gpointer        user_data);
+G_GNUC_INTERNAL
+void            mbim_timer_queue_remove          (MbimTimerQueue *queue,
+                                                  MbimTimer      *timer);
+
+G_END_DECLS
+
+#endif /* _LIBMBIM_GLIB_MBIM_TIMER_QUEUE_H_ */
@@ -21,7 +21,10 @@
  * Copyright (C) 2013 - 2019 Aleksander Morgado <aleksander@aleksander.es>
  */
 
+#include <string.h>
+
 #include "mbim-utils.h"
+#include "mbim-utils-private.h"
 
 /**
  * SECTION:mbim-utils
@@ -31,16 +34,132 @@
  * with the MBIM library.
  */
 
-static volatile gint __traces_enabled = FALSE;
+/* Mask of MbimTraceCategory values */
+static volatile gint __trace_categories = MBIM_TRACE_CATEGORY_NONE;
 
 gboolean
 mbim_utils_get_traces_enabled (void)
 {
-    return (gboolean) g_atomic_int_get (&__traces_enabled);
+    return (g_atomic_int_get (&__trace_categories) != MBIM_TRACE_CATEGORY_NONE);
 }
 
 void
 mbim_utils_set_traces_enabled (gboolean enabled)
 {
-    g_atomic_int_set (&__traces_enabled, enabled);
+    g_atomic_int_set (&__trace_categories, enabled ? MBIM_TRACE_CATEGORY_ALL : MBIM_TRACE_CATEGORY_NONE);
+}
+
+MbimTraceCategory
+mbim_utils_get_trace_categories (void)
+{
+    return (MbimTraceCategory) g_atomic_int_get (&__trace_categories);
+}
+
+void
+mbim_utils_set_trace_categories (MbimTraceCategory categories)
+{
+    g_atomic_int_set (&__trace_categories, categories & MBIM_TRACE_CATEGORY_ALL);
+}
+
+/*****************************************************************************/
+/* Rate limits */
+
+#define N_TRACE_CATEGORIES 6
+G_STATIC_ASSERT (MBIM_TRACE_CATEGORY_ALL == (1 << N_TRACE_CATEGORIES) - 1);
+
+typedef struct {
+    guint  max_per_second;
+    gint64 window_start;
+    guint  n_in_window;
+    guint  n_dropped;
+} TraceRateLimit;
+
+static const gchar *trace_category_names[N_TRACE_CATEGORIES] = {
+    "raw-rx",
+    "raw-tx",
+    "translated",
+    "fragments",
+    "proxy",
+    "netlink",
+};
+
+/* Mask of the categories with a rate limit, to avoid the lock otherwise */
+static volatile gint __trace_rate_limited = MBIM_TRACE_CATEGORY_NONE;
+static TraceRateLimit trace_rate_limits[N_TRACE_CATEGORIES];
+G_LOCK_DEFINE_STATIC (trace_rate_limits);
+
+void
+mbim_utils_set_trace_rate_limit (MbimTraceCategory categories,
+                                 guint             max_per_second)
+{
+    guint i;
+    gint  limited;
+
+    G_LOCK (trace_rate_limits);
+    limited = g_atomic_int_get (&__trace_rate_limited);
+    for (i = 0; i < N_TRACE_CATEGORIES; i++) {
+        if (!(categories & (1 << i)))
+            continue;
+        memset (&trace_rate_limits[i], 0, sizeof (TraceRateLimit));
+        trace_rate_limits[i].max_per_second = max_per_second;
+        if (max_per_second)
+            limited |= (1 << i);
+        else
+            limited &= ~(1 << i);
+    }
+    g_atomic_int_set (&__trace_rate_limited, limited);
+    G_UNLOCK (trace_rate_limits);
+}
+
+static gboolean
+trace_rate_limit_check (guint i)
+{
+    TraceRateLimit *limit;
+    gint64          now;
+    guint           n_dropped = 0;
+    gboolean        allowed;
+
+    now = g_get_monotonic_time ();
+
+    G_LOCK (trace_rate_limits);
+    limit = &trace_rate_limits[i];
+    if (!limit->max_per_second) {
+        G_UNLOCK (trace_rate_limits);
+        return TRUE;
+    }
+    if (now - limit->window_start >= G_USEC_PER_SEC) {
+        n_dropped = limit->n_dropped;
+        limit->window_start = now;
+        limit->n_in_window = 0;
+        limit->n_dropped = 0;
+    }
+    allowed = (limit->n_in_window < limit->max_per_second);
+    if (allowed)
+        limit->n_in_window++;
+    else
+        limit->n_dropped++;
+    G_UNLOCK (trace_rate_limits);
+
+    if (n_dropped)
+        g_debug ("%u '%s' trace records dropped by the rate limit", n_dropped, trace_category_names[i]);
+
+    return allowed;
+}
+
+gboolean
+_mbim_utils_trace_enabled (MbimTraceCategory category)
+{
+    guint i;
+
+    g_assert (category != MBIM_TRACE_CATEGORY_NONE && !(category & (category - 1)));
+
+    if (G_LIKELY (!(g_atomic_int_get (&__trace_categories) & category)))
+        return FALSE;
+
+    if (G_LIKELY (!(g_atomic_int_get (&__trace_rate_limited) & category)))
+        return TRUE;
+
+    i = g_bit_nth_lsf (category, -1);
+    g_assert (i < N_TRACE_CATEGORIES);
+    return trace_rate_limit_check (i);
 }
@@ -55,6 +55,80 @@ gboolean mbim_utils_get_traces_enabled (void);
  */
 void mbim_utils_set_traces_enabled (gboolean enabled);
 
+/**
+ * MbimTraceCategory:
+ * @MBIM_TRACE_CATEGORY_NONE: No traces.
+ * @MBIM_TRACE_CATEGORY_RAW_RX: Hex dumps of the messages received from the device.
+ * @MBIM_TRACE_CATEGORY_RAW_TX: Hex dumps of the messages sent to the device.
+ * @MBIM_TRACE_CATEGORY_TRANSLATED: Human readable translation of the messages
+ *  sent and received.
+ * @MBIM_TRACE_CATEGORY_FRAGMENTS: Traces of the individual fragments of
+ *  messages split across multiple transfers.
+ * @MBIM_TRACE_CATEGORY_PROXY: Routing of requests, responses and service
+ *  subscribe lists in the #MbimProxy.
+ * @MBIM_TRACE_CATEGORY_NETLINK: Netlink link events and requests.
+ * @MBIM_TRACE_CATEGORY_ALL: All the categories.
+ *
+ * Categories of traces that can be individually enabled with
+ * mbim_utils_set_trace_categories().
+ *
+ * Since: 1.26
+ */
+typedef enum { /*< since=1.26 >*/
+    MBIM_TRACE_CATEGORY_NONE       = 0,
+    MBIM_TRACE_CATEGORY_RAW_RX     = 1 << 0,
+    MBIM_TRACE_CATEGORY_RAW_TX     = 1 << 1,
+    MBIM_TRACE_CATEGORY_TRANSLATED = 1 << 2,
+    MBIM_TRACE_CATEGORY_FRAGMENTS  = 1 << 3,
+    MBIM_TRACE_CATEGORY_PROXY      = 1 << 4,
+    MBIM_TRACE_CATEGORY_NETLINK    = 1 << 5,
+    MBIM_TRACE_CATEGORY_ALL        = (1 << 6) - 1
+} MbimTraceCategory;
+
+/**
+ * mbim_utils_get_trace_categories:
+ *
+ * Gets the set of trace categories currently enabled.
+ *
+ * Returns: a mask of #MbimTraceCategory values.
+ *
+ * Since: 1.26
+ */
+MbimTraceCategory mbim_utils_get_trace_categories (void);
+
+/**
+ * mbim_utils_set_trace_categories:
+ * @categories: a mask of #MbimTraceCategory values.
+ *
+ * Sets which categories of traces are enabled. The traces of the categories
+ * not enabled are never built, so enabling only the cheap ones (e.g. not
+ * %MBIM_TRACE_CATEGORY_RAW_RX or %MBIM_TRACE_CATEGORY_RAW_TX) keeps the
+ * overhead low.
+ *
+ * mbim_utils_set_traces_enabled() is equivalent to enabling either all or
+ * none of the categories, and mbim_utils_get_traces_enabled() reports whether
+ * any category is enabled.
+ *
+ * Since: 1.26
+ */
+void mbim_utils_set_trace_categories (MbimTraceCategory categories);
+
+/**
+ * mbim_utils_set_trace_rate_limit:
+ * @categories: a mask of #MbimTraceCategory values.
+ * @max_per_second: maximum number of trace records per second, or 0 to
+ *  disable the rate limit.
+ *
+ * Limits how many trace records are built and logged per second in each one
+ * of the given @categories. The records over the limit are dropped before
+ * being built, and the number of records dropped is reported once the limit
+ * is no longer hit.
+ *
+ * Since: 1.26
+ */
+void mbim_utils_set_trace_rate_limit (MbimTraceCategory categories,
+                                      guint             max_per_second);
+
 G_END_DECLS
 
 #endif /* _LIBMBIM_GLIB_MBIM_UTILS_H_ */
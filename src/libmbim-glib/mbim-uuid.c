@@ -239,7 +239,83 @@ static const MbimUuid uuid_ms_basic_connect_extensions = {
     .e = { 0xbe, 0xf7, 0x05, 0x8e, 0x9a, 0xaf }
 };
 
-static GList *mbim_custom_service_list = NULL;
+/*****************************************************************************/
+/* UUID lookup tables */
+
+static guint
+uuid_hash (gconstpointer v)
+{
+    guint32 words[4];
+
+    /* UUIDs are already random enough, just fold all the bits */
+    memcpy (words, v, sizeof (words));
+    return (words[0] ^ words[1] ^ words[2] ^ words[3]);
+}
+
+static gboolean
+uuid_equal (gconstpointer a,
+            gconstpointer b)
+{
+    return mbim_uuid_cmp ((const MbimUuid *)a, (const MbimUuid *)b);
+}
+
+typedef struct {
+    const MbimUuid *uuid;
+    guint           value;
+} UuidLookup;
+
+/* Builds a table with the given entries; never modified afterwards, so safe
+ * to use from any thread without locking */
+static GHashTable *
+uuid_lookup_table_new (const UuidLookup *entries,
+                       guint             n_entries)
+{
+    GHashTable *table;
+    guint       i;
+
+    table = g_hash_table_new (uuid_hash, uuid_equal);
+    for (i = 0; i < n_entries; i++)
+        g_hash_table_insert (table, (gpointer)entries[i].uuid, GUINT_TO_POINTER (entries[i].value));
+    return table;
+}
+
+static GHashTable *
+service_table_get (void)
+{
+    static gsize       initialized = 0;
+    static GHashTable *table;
+
+    if (g_once_init_enter (&initialized)) {
+        static const UuidLookup services[] = {
+            { &uuid_basic_connect,               MBIM_SERVICE_BASIC_CONNECT               },
+            { &uuid_sms,                         MBIM_SERVICE_SMS                         },
+            { &uuid_ussd,                        MBIM_SERVICE_USSD                        },
+            { &uuid_phonebook,                   MBIM_SERVICE_PHONEBOOK                   },
+            { &uuid_stk,                         MBIM_SERVICE_STK                         },
+            { &uuid_auth,                        MBIM_SERVICE_AUTH                        },
+            { &uuid_dss,                         MBIM_SERVICE_DSS                         },
+            { &uuid_ms_firmware_id,              MBIM_SERVICE_MS_FIRMWARE_ID              },
+            { &uuid_ms_host_shutdown,            MBIM_SERVICE_MS_HOST_SHUTDOWN            },
+            { &uuid_ms_sar,                      MBIM_SERVICE_MS_SAR                      },
+            { &uuid_proxy_control,               MBIM_SERVICE_PROXY_CONTROL               },
+            { &uuid_qmi,                         MBIM_SERVICE_QMI                         },
+            { &uuid_atds,                        MBIM_SERVICE_ATDS                        },
+            { &uuid_intel_firmware_update,       MBIM_SERVICE_INTEL_FIRMWARE_UPDATE       },
+            { &uuid_qdu,                         MBIM_SERVICE_QDU                         },
+            { &uuid_ms_basic_connect_extensions, MBIM_SERVICE_MS_BASIC_CONNECT_EXTENSIONS },
+        };
+
+        table = uuid_lookup_table_new (services, G_N_ELEMENTS (services));
+        g_once_init_leave (&initialized, 1);
+    }
+
+    return table;
+}
+
+/*****************************************************************************/
+
+/* Custom service IDs are allocated right after the highest one in use */
+#define CUSTOM_SERVICE_ID_FIRST 101
 
 typedef struct {
     guint service_id;
@@ -247,29 +323,46 @@ typedef struct {
     gchar *nickname;
 } MbimCustomService;
 
+/* Custom services indexed by (service_id - CUSTOM_SERVICE_ID_FIRST), with
+ * NULL holes for the ones unregistered; no trailing holes are kept */
+static GPtrArray *custom_services;
+/* UUID to MbimCustomService */
+static GHashTable *custom_services_by_uuid;
+
+static MbimCustomService *
+custom_service_lookup (guint id)
+{
+    if (!custom_services || id < CUSTOM_SERVICE_ID_FIRST)
+        return NULL;
+    id -= CUSTOM_SERVICE_ID_FIRST;
+    if (id >= custom_services->len)
+        return NULL;
+    return g_ptr_array_index (custom_services, id);
+}
+
 guint
 mbim_register_custom_service (const MbimUuid *uuid,
                               const gchar *nickname)
 {
     MbimCustomService *s;
-    GList *l;
-    guint service_id = 100;
 
-    for (l = mbim_custom_service_list; l != NULL; l = l->next) {
-        s = (MbimCustomService *)l->data;
-        if (mbim_uuid_cmp (&s->uuid, uuid))
-            return s->service_id;
-        else
-            service_id = MAX (service_id, s->service_id);
+    if (G_UNLIKELY (!custom_services)) {
+        custom_services = g_ptr_array_new ();
+        custom_services_by_uuid = g_hash_table_new (uuid_hash, uuid_equal);
     }
 
+    s = g_hash_table_lookup (custom_services_by_uuid, uuid);
+    if (s)
+        return s->service_id;
+
     /* create a new custom service */
     s = g_slice_new (MbimCustomService);
-    s->service_id = service_id + 1;
+    s->service_id = CUSTOM_SERVICE_ID_FIRST + custom_services->len;
     memcpy (&s->uuid, uuid, sizeof (MbimUuid));
     s->nickname = g_strdup (nickname);
 
-    mbim_custom_service_list = g_list_append (mbim_custom_service_list, s);
+    g_ptr_array_add (custom_services, s);
+    g_hash_table_insert (custom_services_by_uuid, &s->uuid, s);
     return s->service_id;
 }
 
@@ -277,57 +370,47 @@ gboolean
 mbim_unregister_custom_service (const guint id)
 {
     MbimCustomService *s;
-    GList *l;
-
-    for (l = mbim_custom_service_list; l != NULL; l = l->next) {
-        s = (MbimCustomService *)l->data;
-        if (s->service_id == id) {
-            g_free (s->nickname);
-            g_slice_free (MbimCustomService, s);
-            mbim_custom_service_list = \
-                g_list_delete_link (mbim_custom_service_list, l);
-            return TRUE;
-        }
-    }
 
-    return FALSE;
+    s = custom_service_lookup (id);
+    if (!s)
+        return FALSE;
+
+    g_hash_table_remove (custom_services_by_uuid, &s->uuid);
+    g_ptr_array_index (custom_services, id - CUSTOM_SERVICE_ID_FIRST) = NULL;
+    while (custom_services->len > 0 &&
+           !g_ptr_array_index (custom_services, custom_services->len - 1))
+        g_ptr_array_set_size (custom_services, custom_services->len - 1);
+
+    g_free (s->nickname);
+    g_slice_free (MbimCustomService, s);
+    return TRUE;
 }
 
 gboolean
 mbim_service_id_is_custom (const guint id)
 {
-    GList *l;
-
     if (id < MBIM_SERVICE_LAST)
         return FALSE;
 
-    for (l = mbim_custom_service_list; l != NULL; l = l->next) {
-        if (((MbimCustomService *)l->data)->service_id == id)
-            return TRUE;
-    }
-
-    return FALSE;
+    return !!custom_service_lookup (id);
 }
 
 const gchar *
 mbim_service_lookup_name (guint service)
 {
-    GList *l;
+    MbimCustomService *s;
 
     if (service < MBIM_SERVICE_LAST)
         return mbim_service_get_string (service);
 
-    for (l = mbim_custom_service_list; l != NULL; l = l->next) {
-        if (service == ((MbimCustomService *)l->data)->service_id)
-            return ((MbimCustomService *)l->data)->nickname;
-    }
-    return NULL;
+    s = custom_service_lookup (service);
+    return s ? s->nickname : NULL;
 }
 
 const MbimUuid *
 mbim_uuid_from_service (MbimService service)
 {
-    GList *l;
+    MbimCustomService *s;
 
     g_return_val_if_fail (service < MBIM_SERVICE_LAST || mbim_service_id_is_custom (service), &uuid_invalid);
 
@@ -369,10 +452,9 @@ mbim_uuid_from_service (MbimService service)
     case MBIM_SERVICE_LAST:
         g_assert_not_reached ();
     default:
-        for (l = mbim_custom_service_list; l != NULL; l = l->next) {
-            if (service == ((MbimCustomService *)l->data)->service_id)
-                return &((MbimCustomService *)l->data)->uuid;
-        }
+        s = custom_service_lookup (service);
+        if (s)
+            return &s->uuid;
         g_return_val_if_reached (NULL);
     }
 }
@@ -380,59 +462,16 @@ mbim_uuid_from_service (MbimService service)
 MbimService
 mbim_uuid_to_service (const MbimUuid *uuid)
 {
-    GList *l;
-
-    if (mbim_uuid_cmp (uuid, &uuid_basic_connect))
-        return MBIM_SERVICE_BASIC_CONNECT;
-
-    if (mbim_uuid_cmp (uuid, &uuid_sms))
-        return MBIM_SERVICE_SMS;
-
-    if (mbim_uuid_cmp (uuid, &uuid_ussd))
-        return MBIM_SERVICE_USSD;
-
-    if (mbim_uuid_cmp (uuid, &uuid_phonebook))
-        return MBIM_SERVICE_PHONEBOOK;
-
-    if (mbim_uuid_cmp (uuid, &uuid_stk))
-        return MBIM_SERVICE_STK;
-
-    if (mbim_uuid_cmp (uuid, &uuid_auth))
-        return MBIM_SERVICE_AUTH;
-
-    if (mbim_uuid_cmp (uuid, &uuid_dss))
-        return MBIM_SERVICE_DSS;
-
-    if (mbim_uuid_cmp (uuid, &uuid_ms_firmware_id))
-        return MBIM_SERVICE_MS_FIRMWARE_ID;
-
-    if (mbim_uuid_cmp (uuid, &uuid_ms_host_shutdown))
-        return MBIM_SERVICE_MS_HOST_SHUTDOWN;
-
-    if (mbim_uuid_cmp (uuid, &uuid_ms_sar))
-        return MBIM_SERVICE_MS_SAR;
-
-    if (mbim_uuid_cmp (uuid, &uuid_proxy_control))
-        return MBIM_SERVICE_PROXY_CONTROL;
-
-    if (mbim_uuid_cmp (uuid, &uuid_qmi))
-        return MBIM_SERVICE_QMI;
-
-    if (mbim_uuid_cmp (uuid, &uuid_atds))
-        return MBIM_SERVICE_ATDS;
-
-    if (mbim_uuid_cmp (uuid, &uuid_intel_firmware_update))
-        return MBIM_SERVICE_INTEL_FIRMWARE_UPDATE;
-
-    if (mbim_uuid_cmp (uuid, &uuid_qdu))
-        return MBIM_SERVICE_QDU;
+    gpointer           value;
+    MbimCustomService *s;
 
-    if (mbim_uuid_cmp (uuid, &uuid_ms_basic_connect_extensions))
-        return MBIM_SERVICE_MS_BASIC_CONNECT_EXTENSIONS;
+    if (g_hash_table_lookup_extended (service_table_get (), uuid, NULL, &value))
+        return (MbimService) GPOINTER_TO_UINT (value);
 
-    for (l = mbim_custom_service_list; l != NULL; l = l->next) {
-        if (mbim_uuid_cmp (&((MbimCustomService *)l->data)->uuid, uuid))
-            return ((MbimCustomService *)l->data)->service_id;
+    if (custom_services_by_uuid) {
+        s = g_hash_table_lookup (custom_services_by_uuid, uuid);
+        if (s)
+            return s->service_id;
     }
 
     return MBIM_SERVICE_INVALID;
@@ -527,7 +566,7 @@ mbim_uuid_from_context_type (MbimContextType context_type)
     case MBIM_CONTEXT_TYPE_VPN:
         return &uuid_context_type_vpn;
     case MBIM_CONTEXT_TYPE_VOICE:
-        return &uuid_context_type_none;
+        return &uuid_context_type_voice;
     case MBIM_CONTEXT_TYPE_VIDEO_SHARE:
         return &uuid_context_type_video_share;
     case MBIM_CONTEXT_TYPE_PURCHASE:
@@ -546,32 +585,29 @@ mbim_uuid_from_context_type (MbimContextType context_type)
 MbimContextType
 mbim_uuid_to_context_type (const MbimUuid *uuid)
 {
-    if (mbim_uuid_cmp (uuid, &uuid_context_type_none))
-        return MBIM_CONTEXT_TYPE_NONE;
-
-    if (mbim_uuid_cmp (uuid, &uuid_context_type_internet))
-        return MBIM_CONTEXT_TYPE_INTERNET;
-
-    if (mbim_uuid_cmp (uuid, &uuid_context_type_vpn))
-        return MBIM_CONTEXT_TYPE_VPN;
-
-    if (mbim_uuid_cmp (uuid, &uuid_context_type_voice))
-        return MBIM_CONTEXT_TYPE_VOICE;
-
-    if (mbim_uuid_cmp (uuid, &uuid_context_type_video_share))
-        return MBIM_CONTEXT_TYPE_VIDEO_SHARE;
-
-    if (mbim_uuid_cmp (uuid, &uuid_context_type_purchase))
-        return MBIM_CONTEXT_TYPE_PURCHASE;
-
-    if (mbim_uuid_cmp (uuid, &uuid_context_type_ims))
-        return MBIM_CONTEXT_TYPE_IMS;
-
-    if (mbim_uuid_cmp (uuid, &uuid_context_type_mms))
-        return MBIM_CONTEXT_TYPE_MMS;
+    static gsize       initialized = 0;
+    static GHashTable *table;
+    gpointer           value;
+
+    if (g_once_init_enter (&initialized)) {
+        static const UuidLookup context_types[] = {
+            { &uuid_context_type_none,        MBIM_CONTEXT_TYPE_NONE        },
+            { &uuid_context_type_internet,    MBIM_CONTEXT_TYPE_INTERNET    },
+            { &uuid_context_type_vpn,         MBIM_CONTEXT_TYPE_VPN         },
+            { &uuid_context_type_voice,       MBIM_CONTEXT_TYPE_VOICE       },
+            { &uuid_context_type_video_share, MBIM_CONTEXT_TYPE_VIDEO_SHARE },
+            { &uuid_context_type_purchase,    MBIM_CONTEXT_TYPE_PURCHASE    },
+            { &uuid_context_type_ims,         MBIM_CONTEXT_TYPE_IMS         },
+            { &uuid_context_type_mms,         MBIM_CONTEXT_TYPE_MMS         },
+            { &uuid_context_type_local,       MBIM_CONTEXT_TYPE_LOCAL       },
+        };
+
+        table = uuid_lookup_table_new (context_types, G_N_ELEMENTS (context_types));
+        g_once_init_leave (&initialized, 1);
+    }
 
-    if (mbim_uuid_cmp (uuid, &uuid_context_type_local))
-        return MBIM_CONTEXT_TYPE_LOCAL;
+    if (g_hash_table_lookup_extended (table, uuid, NULL, &value))
+        return (MbimContextType) GPOINTER_TO_UINT (value);
 
     return MBIM_CONTEXT_TYPE_INVALID;
 }
@@ -0,0 +1,1077 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details:
+ *
+ * Copyright (C) 2026 agent <agent@local>
+ */
+
+#include <config.h>
+
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <termios.h>
+#include <unistd.h>
+#include <glib-unix.h>
+
+#include "mbim-message.h"
+#include "mbim-message-private.h"
+#include "mbim-uuid.h"
+#include "mbim-enum-types.h"
+#include "mbim-error-types.h"
+
+#include "mbim-mock-function.h"
+
+/* Interval of the indication timer when sending at high rates */
+#define INDICATIONS_MAX_INTERVAL_MS 10
+
+typedef struct {
+    MbimStatusError    status;
+    GBytes            *buffer;
+    /* If set, sent instead of the response */
+    MbimProtocolError  function_error;
+} MockResponse;
+
+typedef struct {
+    gint64       due;
+    MbimMessage *message;
+} DelayedMessage;
+
+typedef struct {
+    MbimUuid  service_id;
+    guint32   cid;
+    GBytes   *buffer;
+    guint     rate;
+    guint     count;
+    guint64   sent;
+    gint64    start;
+    GSource  *source;
+} IndicationStorm;
+
+struct _MbimMockFunction {
+    gint          fd;
+    gint          slave;
+    gchar        *path;
+    GMainContext *context;
+    GMainLoop    *loop;
+    GThread      *thread;
+    GSource      *in_source;
+
+    /* Only used in the mock thread */
+    GByteArray      *input;
+    GByteArray      *output;
+    GSource         *out_source;
+    GQueue          *delayed;
+    GSource         *delayed_source;
+    GQueue          *held;
+    MbimMessage     *collector;
+    IndicationStorm *storm;
+
+    /* Configuration, protected by the lock */
+    GMutex                 lock;
+    MbimMockFunctionFlags  flags;
+    guint                  latency_ms;
+    guint                  n_fragments;
+    gboolean               holding;
+    GHashTable            *responses;
+    guint64                n_commands;
+    guint64                n_command_fragments;
+    MbimMessage           *last_command;
+};
+
+/*****************************************************************************/
+
+static gchar *
+response_key_new (const MbimUuid *service_id,
+                  guint32         cid)
+{
+    g_autofree gchar *uuid_printable = NULL;
+
+    uuid_printable = mbim_uuid_get_printable (service_id);
+    return g_strdup_printf ("%s/%u", uuid_printable, cid);
+}
+
+static void
+mock_response_free (MockResponse *response)
+{
+    g_bytes_unref (response->buffer);
+    g_slice_free (MockResponse, response);
+}
+
+static void
+delayed_message_free (DelayedMessage *delayed)
+{
+    mbim_message_unref (delayed->message);
+    g_slice_free (DelayedMessage, delayed);
+}
+
+static void
+indication_storm_free (IndicationStorm *storm)
+{
+    if (storm->source) {
+        g_source_destroy (storm->source);
+        g_source_unref (storm->source);
+    }
+    g_bytes_unref (storm->buffer);
+    g_slice_free (IndicationStorm, storm);
+}
+
+/*****************************************************************************/
+/* Output */
+
+static gboolean
+output_ready_cb (gint              fd,
+                 GIOCondition      condition,
+                 MbimMockFunction *self)
+{
+    gssize n_written;
+
+    n_written = write (self->fd, self->output->data, self->output->len);
+    if (n_written > 0)
+        g_byte_array_remove_range (self->output, 0, n_written);
+    else if (n_written < 0 && errno != EAGAIN && errno != EINTR) {
+        g_warning ("[mock] couldn't write: %s", g_strerror (errno));
+        g_byte_array_set_size (self->output, 0);
+    }
+
+    if (self->output->len > 0)
+        return G_SOURCE_CONTINUE;
+
+    g_source_unref (self->out_source);
+    self->out_source = NULL;
+    return G_SOURCE_REMOVE;
+}
+
+static void
+mock_write (MbimMockFunction *self,
+            const guint8     *data,
+            gsize             data_length)
+{
+    g_byte_array_append (self->output, data, data_length);
+    if (self->out_source)
+        return;
+
+    self->out_source = g_unix_fd_source_new (self->fd, G_IO_OUT);
+    g_source_set_callback (self->out_source, (GSourceFunc) output_ready_cb, self, NULL);
+    g_source_attach (self->out_source, self->context);
+}
+
+static void
+mock_send_message (MbimMockFunction  *self,
+                   const MbimMessage *message)
+{
+    struct fragment_info *fragments = NULL;
+    guint                 n_fragments = 0;
+    guint                 config_n_fragments;
+    MbimMockFunctionFlags flags;
+    guint32               message_length;
+    guint                 i;
+
+    g_mutex_lock (&self->lock);
+    config_n_fragments = self->n_fragments;
+    flags = self->flags;
+    g_mutex_unlock (&self->lock);
+
+    message_length = mbim_message_get_message_length (message);
+
+    /* Only the messages with a fragment header can be split */
+    if (config_n_fragments > 1 &&
+        (mbim_message_get_message_type (message) == MBIM_MESSAGE_TYPE_COMMAND_DONE ||
+         mbim_message_get_message_type (message) == MBIM_MESSAGE_TYPE_INDICATE_STATUS)) {
+        guint32 headers_length;
+        guint32 payload_length;
+
+        headers_length = sizeof (struct header) + sizeof (struct fragment_header);
+        payload_length = message_length - headers_length;
+        fragments = _mbim_message_split_fragments (message,
+                                                   headers_length + ((payload_length + config_n_fragments - 1) / config_n_fragments),
+                                                   &n_fragments);
+    }
+
+    if (!fragments) {
+        mock_write (self, ((const GByteArray *) message)->data, message_length);
+        return;
+    }
+
+    for (i = 0; i < n_fragments; i++) {
+        const struct fragment_info *fragment;
+
+        fragment = &fragments[(flags & MBIM_MOCK_FUNCTION_FLAGS_REORDER_FRAGMENTS) ? (n_fragments - 1 - i) : i];
+        mock_write (self, (const guint8 *) &fragment->header, sizeof (struct header));
+        mock_write (self, (const guint8 *) &fragment->fragment_header, sizeof (struct fragment_header));
+        mock_write (self, fragment->data, fragment->data_length);
+    }
+    g_free (fragments);
+}
+
+/*****************************************************************************/
+/* Delayed responses */
+
+static void schedule_delayed (MbimMockFunction *self);
+
+static gboolean
+delayed_ready_cb (MbimMockFunction *self)
+{
+    gint64 now;
+
+    g_source_unref (self->delayed_source);
+    self->delayed_source = NULL;
+
+    now = g_get_monotonic_time ();
+    while (!g_queue_is_empty (self->delayed)) {
+        DelayedMessage *delayed;
+
+        delayed = g_queue_peek_head (self->delayed);
+        if (delayed->due > now)
+            break;
+        g_queue_pop_head (self->delayed);
+        mock_send_message (self, delayed->message);
+        delayed_message_free (delayed);
+    }
+
+    schedule_delayed (self);
+    return G_SOURCE_REMOVE;
+}
+
+static void
+schedule_delayed (MbimMockFunction *self)
+{
+    DelayedMessage *delayed;
+    gint64          wait_ms;
+
+    if (self->delayed_source || g_queue_is_empty (self->delayed))
+        return;
+
+    delayed = g_queue_peek_head (self->delayed);
+    wait_ms = (delayed->due - g_get_monotonic_time () + 999) / 1000;
+    self->delayed_source = g_timeout_source_new (wait_ms > 0 ? (guint) wait_ms : 0);
+    g_source_set_callback (self->delayed_source, (GSourceFunc) delayed_ready_cb, self, NULL);
+    g_source_attach (self->delayed_source, self->context);
+}
+
+/* Takes ownership of the response */
+static void
+mock_respond (MbimMockFunction *self,
+              MbimMessage      *response)
+{
+    DelayedMessage *delayed;
+    guint           latency_ms;
+    gboolean        holding;
+
+    g_mutex_lock (&self->lock);
+    latency_ms = self->latency_ms;
+    holding = self->holding;
+    g_mutex_unlock (&self->lock);
+
+    if (holding) {
+        g_queue_push_tail (self->held, response);
+        return;
+    }
+
+    /* Keep the order of the responses even with no latency */
+    if (!latency_ms && g_queue_is_empty (self->delayed)) {
+        mock_send_message (self, response);
+        mbim_message_unref (response);
+        return;
+    }
+
+    /* The latency is the same for all, so the queue is always sorted */
+    delayed = g_slice_new (DelayedMessage);
+    delayed->due = g_get_monotonic_time () + ((gint64) latency_ms * 1000);
+    delayed->message = response;
+    g_queue_push_tail (self->delayed, delayed);
+    schedule_delayed (self);
+}
+
+/*****************************************************************************/
+/* Input */
+
+static MbimMessage *
+command_done_new (const MbimMessage *command,
+                  MbimStatusError    status,
+                  GBytes            *buffer)
+{
+    MbimMessage                 *response;
+    struct command_done_message *command_done;
+    const guint8                *data = NULL;
+    gsize                        data_length = 0;
+
+    if (buffer)
+        data = g_bytes_get_data (buffer, &data_length);
+
+    response = (MbimMessage *) _mbim_message_allocate (MBIM_MESSAGE_TYPE_COMMAND_DONE,
+                                                       mbim_message_get_transaction_id (command),
+                                                       sizeof (struct command_done_message) + data_length);
+    command_done = &(((struct full_message *)(response->data))->message.command_done);
+    command_done->fragment_header.total   = GUINT32_TO_LE (1);
+    command_done->fragment_header.current = 0;
+    memcpy (command_done->service_id, mbim_message_command_get_service_id (command), sizeof (MbimUuid));
+    command_done->command_id    = GUINT32_TO_LE (mbim_message_command_get_cid (command));
+    command_done->status_code   = GUINT32_TO_LE (status);
+    command_done->buffer_length = GUINT32_TO_LE ((guint32) data_length);
+    if (data_length)
+        memcpy (command_done->buffer, data, data_length);
+    return response;
+}
+
+static void
+process_command (MbimMockFunction  *self,
+                 const MbimMessage *command)
+{
+    g_autofree gchar    *key = NULL;
+    MockResponse        *response;
+    MbimStatusError      status = MBIM_STATUS_ERROR_NONE;
+    MbimProtocolError    function_error = MBIM_PROTOCOL_ERROR_INVALID;
+    g_autoptr(GBytes)    buffer = NULL;
+
+    key = response_key_new (mbim_message_command_get_service_id (command),
+                            mbim_message_command_get_cid (command));
+
+    g_mutex_lock (&self->lock);
+    self->n_commands++;
+    g_clear_pointer (&self->last_command, mbim_message_unref);
+    self->last_command = mbim_message_dup (command);
+    response = g_hash_table_lookup (self->responses, key);
+    if (response) {
+        status = response->status;
+        buffer = response->buffer ? g_bytes_ref (response->buffer) : NULL;
+        function_error = response->function_error;
+    }
+    g_mutex_unlock (&self->lock);
+
+    if (function_error != MBIM_PROTOCOL_ERROR_INVALID) {
+        mock_respond (self, mbim_message_function_error_new (mbim_message_get_transaction_id (command), function_error));
+        return;
+    }
+
+    mock_respond (self, command_done_new (command, status, buffer));
+}
+
+static void
+process_command_fragment (MbimMockFunction  *self,
+                          const MbimMessage *fragment)
+{
+    g_autoptr(GError) error = NULL;
+
+    g_mutex_lock (&self->lock);
+    self->n_command_fragments++;
+    g_mutex_unlock (&self->lock);
+
+    if (_mbim_message_fragment_get_total (fragment) <= 1) {
+        process_command (self, fragment);
+        return;
+    }
+
+    if (_mbim_message_fragment_get_current (fragment) == 0) {
+        g_clear_pointer (&self->collector, mbim_message_unref);
+        self->collector = _mbim_message_fragment_collector_init (fragment, &error);
+    } else if (!self->collector)
+        g_set_error (&error, MBIM_CORE_ERROR, MBIM_CORE_ERROR_INVALID_MESSAGE, "unexpected fragment");
+    else if (!_mbim_message_fragment_collector_add (self->collector, fragment, &error))
+        g_clear_pointer (&self->collector, mbim_message_unref);
+
+    if (error) {
+        g_warning ("[mock] dropping fragmented command: %s", error->message);
+        return;
+    }
+
+    if (self->collector && _mbim_message_fragment_collector_complete (self->collector)) {
+        process_command (self, self->collector);
+        g_clear_pointer (&self->collector, mbim_message_unref);
+    }
+}
+
+static void
+process_message (MbimMockFunction  *self,
+                 const MbimMessage *message)
+{
+    switch (mbim_message_get_message_type (message)) {
+    case MBIM_MESSAGE_TYPE_OPEN:
+        mock_respond (self, mbim_message_open_done_new (mbim_message_get_transaction_id (message),
+                                                        MBIM_STATUS_ERROR_NONE));
+        break;
+    case MBIM_MESSAGE_TYPE_CLOSE:
+        g_clear_pointer (&self->collector, mbim_message_unref);
+        mock_respond (self, mbim_message_close_done_new (mbim_message_get_transaction_id (message),
+                                                         MBIM_STATUS_ERROR_NONE));
+        break;
+    case MBIM_MESSAGE_TYPE_COMMAND:
+        process_command_fragment (self, message);
+        break;
+    case MBIM_MESSAGE_TYPE_INVALID:
+    case MBIM_MESSAGE_TYPE_HOST_ERROR:
+    case MBIM_MESSAGE_TYPE_OPEN_DONE:
+    case MBIM_MESSAGE_TYPE_CLOSE_DONE:
+    case MBIM_MESSAGE_TYPE_COMMAND_DONE:
+    case MBIM_MESSAGE_TYPE_FUNCTION_ERROR:
+    case MBIM_MESSAGE_TYPE_INDICATE_STATUS:
+    default:
+        g_debug ("[mock] ignoring message of type %s",
+                 mbim_message_type_get_string (mbim_message_get_message_type (message)));
+        break;
+    }
+}
+
+static void
+process_input (MbimMockFunction *self)
+{
+    guint offset = 0;
+
+    while (self->input->len - offset >= sizeof (struct header)) {
+        const struct header   *header;
+        guint32                length;
+        g_autoptr(MbimMessage) message = NULL;
+
+        header = (const struct header *) &self->input->data[offset];
+        length = GUINT32_FROM_LE (header->length);
+        if (length < sizeof (struct header)) {
+            g_warning ("[mock] discarding %u bytes of invalid data", self->input->len - offset);
+            offset = self->input->len;
+            break;
+        }
+        if (self->input->len - offset < length)
+            break;
+
+        message = mbim_message_new (&self->input->data[offset], length);
+        process_message (self, message);
+        offset += length;
+    }
+
+    if (offset > 0)
+        g_byte_array_remove_range (self->input, 0, offset);
+}
+
+static gboolean
+input_ready_cb (gint              fd,
+                GIOCondition      condition,
+                MbimMockFunction *self)
+{
+    guint8 buffer[4096];
+    gssize n_read;
+
+    while ((n_read = read (self->fd, buffer, sizeof (buffer))) > 0)
+        g_byte_array_append (self->input, buffer, n_read);
+
+    if (n_read == 0 && self->slave < 0) {
+        g_debug ("[mock] connection closed");
+        g_source_unref (self->in_source);
+        self->in_source = NULL;
+        return G_SOURCE_REMOVE;
+    }
+
+    process_input (self);
+    return G_SOURCE_CONTINUE;
+}
+
+/*****************************************************************************/
+/* Indications */
+
+static MbimMessage *
+indication_new (const MbimUuid *service_id,
+                guint32         cid,
+                const guint8   *buffer,
+                guint32         buffer_length)
+{
+    MbimMessage                    *indication;
+    struct indicate_status_message *indicate_status;
+
+    indication = (MbimMessage *) _mbim_message_allocate (MBIM_MESSAGE_TYPE_INDICATE_STATUS,
+                                                         0,
+                                                         sizeof (struct indicate_status_message) + buffer_length);
+    indicate_status = &(((struct full_message *)(indication->data))->message.indicate_status);
+    indicate_status->fragment_header.total   = GUINT32_TO_LE (1);
+    indicate_status->fragment_header.current = 0;
+    memcpy (indicate_status->service_id, service_id, sizeof (MbimUuid));
+    indicate_status->command_id    = GUINT32_TO_LE (cid);
+    indicate_status->buffer_length = GUINT32_TO_LE (buffer_length);
+    if (buffer_length)
+        memcpy (indicate_status->buffer, buffer, buffer_length);
+    return indication;
+}
+
+static void
+storm_send (MbimMockFunction *self,
+            IndicationStorm  *storm,
+            guint64           n_indications)
+{
+    g_autoptr(MbimMessage) indication = NULL;
+    const guint8          *data;
+    gsize                  data_length;
+
+    data = g_bytes_get_data (storm->buffer, &data_length);
+    indication = indication_new (&storm->service_id, storm->cid, data, (guint32) data_length);
+    for (; n_indications > 0; n_indications--) {
+        mock_send_message (self, indication);
+        storm->sent++;
+    }
+}
+
+static gboolean
+storm_tick_cb (MbimMockFunction *self)
+{
+    IndicationStorm *storm;
+    guint64          expected;
+
+    storm = self->storm;
+
+    /* Send as many as needed to keep up with the requested rate */
+    expected = 1 + (((g_get_monotonic_time () - storm->start) * storm->rate) / G_USEC_PER_SEC);
+    if (storm->count && expected > storm->count)
+        expected = storm->count;
+    if (expected > storm->sent)
+        storm_send (self, storm, expected - storm->sent);
+
+    if (storm->count && storm->sent >= storm->count) {
+        g_clear_pointer (&self->storm, indication_storm_free);
+        return G_SOURCE_REMOVE;
+    }
+    return G_SOURCE_CONTINUE;
+}
+
+/*****************************************************************************/
+/* Operations run in the mock thread */
+
+typedef struct {
+    MbimMockFunction *self;
+    GBytes           *data;
+    IndicationStorm  *storm;
+} Operation;
+
+static void
+operation_free (Operation *operation)
+{
+    if (operation->data)
+        g_bytes_unref (operation->data);
+    if (operation->storm)
+        indication_storm_free (operation->storm);
+    g_slice_free (Operation, operation);
+}
+
+static void
+run_in_thread (MbimMockFunction *self,
+               GSourceFunc       func,
+               GBytes           *data,
+               IndicationStorm  *storm)
+{
+    Operation *operation;
+
+    operation = g_slice_new0 (Operation);
+    operation->self = self;
+    operation->data = data;
+    operation->storm = storm;
+    g_main_context_invoke_full (self->context,
+                                G_PRIORITY_DEFAULT,
+                                func,
+                                operation,
+                                (GDestroyNotify) operation_free);
+}
+
+static gboolean
+send_raw_in_thread (Operation *operation)
+{
+    const guint8 *data;
+    gsize         data_length;
+
+    data = g_bytes_get_data (operation->data, &data_length);
+    mock_write (operation->self, data, data_length);
+    return G_SOURCE_REMOVE;
+}
+
+static gboolean
+send_message_in_thread (Operation *operation)
+{
+    g_autoptr(MbimMessage) message = NULL;
+    const guint8          *data;
+    gsize                  data_length;
+
+    data = g_bytes_get_data (operation->data, &data_length);
+    message = mbim_message_new (data, data_length);
+    mock_send_message (operation->self, message);
+    return G_SOURCE_REMOVE;
+}
+
+static gboolean
+start_indications_in_thread (Operation *operation)
+{
+    MbimMockFunction *self;
+    IndicationStorm  *storm;
+
+    self = operation->self;
+    g_clear_pointer (&self->storm, indication_storm_free);
+
+    storm = g_steal_pointer (&operation->storm);
+    if (!storm->rate) {
+        storm_send (self, storm, storm->count);
+        indication_storm_free (storm);
+        return G_SOURCE_REMOVE;
+    }
+
+    self->storm = storm;
+    storm->start = g_get_monotonic_time ();
+    storm->source = g_timeout_source_new (MAX (1, MIN (1000 / storm->rate, INDICATIONS_MAX_INTERVAL_MS)));
+    g_source_set_callback (storm->source, (GSourceFunc) storm_tick_cb, self, NULL);
+    g_source_attach (storm->source, self->context);
+
+    /* The first one right away */
+    storm_tick_cb (self);
+    return G_SOURCE_REMOVE;
+}
+
+static gboolean
+stop_indications_in_thread (Operation *operation)
+{
+    g_clear_pointer (&operation->self->storm, indication_storm_free);
+    return G_SOURCE_REMOVE;
+}
+
+static gboolean
+release_responses_in_thread (Operation *operation)
+{
+    MbimMockFunction *self;
+    MbimMessage      *response;
+
+    self = operation->self;
+
+    /* Stop holding in the mock thread, so that no new response can be sent
+     * before the ones already held */
+    g_mutex_lock (&self->lock);
+    self->holding = FALSE;
+    g_mutex_unlock (&self->lock);
+
+    while ((response = g_queue_pop_head (self->held)) != NULL)
+        mock_respond (self, response);
+    return G_SOURCE_REMOVE;
+}
+
+/*****************************************************************************/
+
+void
+mbim_mock_function_set_flags (MbimMockFunction      *self,
+                              MbimMockFunctionFlags  flags)
+{
+    g_mutex_lock (&self->lock);
+    self->flags = flags;
+    g_mutex_unlock (&self->lock);
+}
+
+void
+mbim_mock_function_set_latency (MbimMockFunction *self,
+                                guint             latency_ms)
+{
+    g_mutex_lock (&self->lock);
+    self->latency_ms = latency_ms;
+    g_mutex_unlock (&self->lock);
+}
+
+void
+mbim_mock_function_set_n_fragments (MbimMockFunction *self,
+                                    guint             n_fragments)
+{
+    g_mutex_lock (&self->lock);
+    self->n_fragments = n_fragments;
+    g_mutex_unlock (&self->lock);
+}
+
+void
+mbim_mock_function_add_response (MbimMockFunction *self,
+                                 const MbimUuid   *service_id,
+                                 guint32           cid,
+                                 MbimStatusError   status,
+                                 const guint8     *buffer,
+                                 guint32           buffer_length)
+{
+    MockResponse *response;
+
+    response = g_slice_new0 (MockResponse);
+    response->status = status;
+    if (buffer_length)
+        response->buffer = g_bytes_new (buffer, buffer_length);
+
+    g_mutex_lock (&self->lock);
+    g_hash_table_replace (self->responses, response_key_new (service_id, cid), response);
+    g_mutex_unlock (&self->lock);
+}
+
+void
+mbim_mock_function_add_function_error (MbimMockFunction  *self,
+                                       const MbimUuid    *service_id,
+                                       guint32            cid,
+                                       MbimProtocolError  error)
+{
+    MockResponse *response;
+
+    g_return_if_fail (error != MBIM_PROTOCOL_ERROR_INVALID);
+
+    response = g_slice_new0 (MockResponse);
+    response->function_error = error;
+
+    g_mutex_lock (&self->lock);
+    g_hash_table_replace (self->responses, response_key_new (service_id, cid), response);
+    g_mutex_unlock (&self->lock);
+}
+
+void
+mbim_mock_function_hold_responses (MbimMockFunction *self)
+{
+    g_mutex_lock (&self->lock);
+    self->holding = TRUE;
+    g_mutex_unlock (&self->lock);
+}
+
+void
+mbim_mock_function_release_responses (MbimMockFunction *self)
+{
+    run_in_thread (self, (GSourceFunc) release_responses_in_thread, NULL, NULL);
+}
+
+gboolean
+mbim_mock_function_parse_service (const gchar *str,
+                                  MbimUuid    *out_uuid)
+{
+    guint service;
+
+    if (mbim_uuid_from_printable (str, out_uuid))
+        return TRUE;
+
+    for (service = MBIM_SERVICE_BASIC_CONNECT; service < MBIM_SERVICE_LAST; service++) {
+        if (g_str_equal (str, mbim_service_get_string ((MbimService) service))) {
+            memcpy (out_uuid, mbim_uuid_from_service ((MbimService) service), sizeof (MbimUuid));
+            return TRUE;
+        }
+    }
+    return FALSE;
+}
+
+GByteArray *
+mbim_mock_function_parse_hex (const gchar  *str,
+                              GError      **error)
+{
+    g_autoptr(GByteArray) array = NULL;
+    const gchar          *p;
+
+    array = g_byte_array_new ();
+    for (p = str; *p; ) {
+        gint   high;
+        gint   low;
+        guint8 value;
+
+        /* Allow any kind of separator between bytes */
+        if (*p == ' ' || *p == ':' || *p == ',' || *p == '\t') {
+            p++;
+            continue;
+        }
+
+        high = g_ascii_xdigit_value (p[0]);
+        low = (high >= 0 ? g_ascii_xdigit_value (p[1]) : -1);
+        if (high < 0 || low < 0) {
+            g_set_error (error, MBIM_CORE_ERROR, MBIM_CORE_ERROR_INVALID_ARGS,
+                         "invalid hex string: '%s'", str);
+            return NULL;
+        }
+        value = (guint8) ((high << 4) | low);
+        g_byte_array_append (array, &value, 1);
+        p += 2;
+    }
+    return g_steal_pointer (&array);
+}
+
+gboolean
+mbim_mock_function_load_responses (MbimMockFunction  *self,
+                                   const gchar       *path,
+                                   GError           **error)
+{
+    g_autoptr(GKeyFile)  key_file = NULL;
+    g_auto(GStrv)        groups = NULL;
+    guint                i;
+
+    key_file = g_key_file_new ();
+    if (!g_key_file_load_from_file (key_file, path, G_KEY_FILE_NONE, error))
+        return FALSE;
+
+    groups = g_key_file_get_groups (key_file, NULL);
+    for (i = 0; groups[i]; i++) {
+        g_autofree gchar      *service_str = NULL;
+        g_autofree gchar      *buffer_str = NULL;
+        g_autoptr(GByteArray)  buffer = NULL;
+        g_autoptr(GError)      inner_error = NULL;
+        MbimUuid               service_id;
+        guint32                cid;
+        MbimStatusError        status;
+
+        service_str = g_key_file_get_string (key_file, groups[i], "service", &inner_error);
+        if (!service_str || !mbim_mock_function_parse_service (service_str, &service_id)) {
+            g_set_error (error, MBIM_CORE_ERROR, MBIM_CORE_ERROR_INVALID_ARGS,
+                         "response '%s': invalid or missing service", groups[i]);
+            return FALSE;
+        }
+
+        cid = (guint32) g_key_file_get_integer (key_file, groups[i], "cid", &inner_error);
+        if (inner_error) {
+            g_set_error (error, MBIM_CORE_ERROR, MBIM_CORE_ERROR_INVALID_ARGS,
+                         "response '%s': invalid or missing cid: %s", groups[i], inner_error->message);
+            return FALSE;
+        }
+
+        /* Both optional */
+        status = (MbimStatusError) g_key_file_get_integer (key_file, groups[i], "status", NULL);
+        buffer_str = g_key_file_get_string (key_file, groups[i], "buffer", NULL);
+        if (buffer_str) {
+            buffer = mbim_mock_function_parse_hex (buffer_str, &inner_error);
+            if (!buffer) {
+                g_set_error (error, MBIM_CORE_ERROR, MBIM_CORE_ERROR_INVALID_ARGS,
+                             "response '%s': %s", groups[i], inner_error->message);
+                return FALSE;
+            }
+        }
+
+        mbim_mock_function_add_response (self, &service_id, cid, status,
+                                         buffer ? buffer->data : NULL,
+                                         buffer ? buffer->len : 0);
+    }
+
+    return TRUE;
+}
+
+void
+mbim_mock_function_send_raw (MbimMockFunction *self,
+                             const guint8     *data,
+                             gsize             data_length)
+{
+    run_in_thread (self, (GSourceFunc) send_raw_in_thread, g_bytes_new (data, data_length), NULL);
+}
+
+void
+mbim_mock_function_send_indication (MbimMockFunction *self,
+                                    const MbimUuid   *service_id,
+                                    guint32           cid,
+                                    const guint8     *buffer,
+                                    guint32           buffer_length)
+{
+    g_autoptr(MbimMessage) indication = NULL;
+
+    indication = indication_new (service_id, cid, buffer, buffer_length);
+    run_in_thread (self,
+                   (GSourceFunc) send_message_in_thread,
+                   g_bytes_new (((GByteArray *) indication)->data, mbim_message_get_message_length (indication)),
+                   NULL);
+}
+
+void
+mbim_mock_function_start_indications (MbimMockFunction *self,
+                                      const MbimUuid   *service_id,
+                                      guint32           cid,
+                                      const guint8     *buffer,
+                                      guint32           buffer_length,
+                                      guint             rate,
+                                      guint             count)
+{
+    IndicationStorm *storm;
+
+    g_return_if_fail (rate > 0 || count > 0);
+
+    storm = g_slice_new0 (IndicationStorm);
+    memcpy (&storm->service_id, service_id, sizeof (MbimUuid));
+    storm->cid = cid;
+    storm->buffer = g_bytes_new (buffer, buffer_length);
+    storm->rate = rate;
+    storm->count = count;
+    run_in_thread (self, (GSourceFunc) start_indications_in_thread, NULL, storm);
+}
+
+void
+mbim_mock_function_stop_indications (MbimMockFunction *self)
+{
+    run_in_thread (self, (GSourceFunc) stop_indications_in_thread, NULL, NULL);
+}
+
+guint64
+mbim_mock_function_get_n_commands (MbimMockFunction *self)
+{
+    guint64 n_commands;
+
+    g_mutex_lock (&self->lock);
+    n_commands = self->n_commands;
+    g_mutex_unlock (&self->lock);
+    return n_commands;
+}
+
+guint64
+mbim_mock_function_get_n_command_fragments (MbimMockFunction *self)
+{
+    guint64 n_command_fragments;
+
+    g_mutex_lock (&self->lock);
+    n_command_fragments = self->n_command_fragments;
+    g_mutex_unlock (&self->lock);
+    return n_command_fragments;
+}
+
+MbimMessage *
+mbim_mock_function_get_last_command (MbimMockFunction *self)
+{
+    MbimMessage *last_command;
+
+    g_mutex_lock (&self->lock);
+    last_command = self->last_command ? mbim_message_ref (self->last_command) : NULL;
+    g_mutex_unlock (&self->lock);
+    return last_command;
+}
+
+const gchar *
+mbim_mock_function_get_path (MbimMockFunction *self)
+{
+    return self->path;
+}
+
+/*****************************************************************************/
+
+static gpointer
+mock_thread (MbimMockFunction *self)
+{
+    g_main_context_push_thread_default (self->context);
+    g_main_loop_run (self->loop);
+    g_main_context_pop_thread_default (self->context);
+    return NULL;
+}
+
+static MbimMockFunction *
+mock_function_new (void)
+{
+    MbimMockFunction *self;
+
+    self = g_slice_new0 (MbimMockFunction);
+    self->fd = -1;
+    self->slave = -1;
+    g_mutex_init (&self->lock);
+    self->responses = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, (GDestroyNotify) mock_response_free);
+    self->input = g_byte_array_new ();
+    self->output = g_byte_array_new ();
+    self->delayed = g_queue_new ();
+    self->held = g_queue_new ();
+    self->context = g_main_context_new ();
+    self->loop = g_main_loop_new (self->context, FALSE);
+    return self;
+}
+
+static MbimMockFunction *
+mock_function_start (MbimMockFunction  *self,
+                     GError           **error)
+{
+    if (!g_unix_set_fd_nonblocking (self->fd, TRUE, error)) {
+        mbim_mock_function_free (self);
+        return NULL;
+    }
+
+    self->in_source = g_unix_fd_source_new (self->fd, G_IO_IN);
+    g_source_set_callback (self->in_source, (GSourceFunc) input_ready_cb, self, NULL);
+    g_source_attach (self->in_source, self->context);
+
+    self->thread = g_thread_new ("mbim-mock", (GThreadFunc) mock_thread, self);
+    return self;
+}
+
+MbimMockFunction *
+mbim_mock_function_new (GError **error)
+{
+    MbimMockFunction *self;
+    struct termios    tio;
+    gchar             name[64];
+
+    self = mock_function_new ();
+
+    self->fd = posix_openpt (O_RDWR | O_NOCTTY);
+    if (self->fd < 0 ||
+        grantpt (self->fd) < 0 ||
+        unlockpt (self->fd) < 0 ||
+        ptsname_r (self->fd, name, sizeof (name)) != 0) {
+        g_set_error (error, MBIM_CORE_ERROR, MBIM_CORE_ERROR_FAILED,
+                     "couldn't setup pseudo-terminal: %s", g_strerror (errno));
+        mbim_mock_function_free (self);
+        return NULL;
+    }
+    self->path = g_strdup (name);
+
+    /* Keep the slave side always open, so that the master doesn't get a
+     * hangup while the device under test isn't open */
+    self->slave = open (self->path, O_RDWR | O_NOCTTY | O_NONBLOCK);
+    if (self->slave < 0 || tcgetattr (self->slave, &tio) < 0) {
+        g_set_error (error, MBIM_CORE_ERROR, MBIM_CORE_ERROR_FAILED,
+                     "couldn't open pseudo-terminal: %s", g_strerror (errno));
+        mbim_mock_function_free (self);
+        return NULL;
+    }
+
+    /* Binary data, no line discipline processing at all */
+    cfmakeraw (&tio);
+    if (tcsetattr (self->slave, TCSANOW, &tio) < 0) {
+        g_set_error (error, MBIM_CORE_ERROR, MBIM_CORE_ERROR_FAILED,
+                     "couldn't setup raw mode in pseudo-terminal: %s", g_strerror (errno));
+        mbim_mock_function_free (self);
+        return NULL;
+    }
+
+    return mock_function_start (self, error);
+}
+
+MbimMockFunction *
+mbim_mock_function_new_for_fd (gint     fd,
+                               GError **error)
+{
+    MbimMockFunction *self;
+
+    self = mock_function_new ();
+    self->fd = fd;
+    return mock_function_start (self, error);
+}
+
+void
+mbim_mock_function_free (MbimMockFunction *self)
+{
+    if (self->thread) {
+        g_main_loop_quit (self->loop);
+        g_thread_join (self->thread);
+    }
+
+    /* The thread is gone, so the sources can be safely destroyed here */
+    g_clear_pointer (&self->storm, indication_storm_free);
+    if (self->in_source) {
+        g_source_destroy (self->in_source);
+        g_source_unref (self->in_source);
+    }
+    if (self->out_source) {
+        g_source_destroy (self->out_source);
+        g_source_unref (self->out_source);
+    }
+    if (self->delayed_source) {
+        g_source_destroy (self->delayed_source);
+        g_source_unref (self->delayed_source);
+    }
+    g_queue_free_full (self->delayed, (GDestroyNotify) delayed_message_free);
+    g_queue_free_full (self->held, (GDestroyNotify) mbim_message_unref);
+    g_clear_pointer (&self->collector, mbim_message_unref);
+    g_clear_pointer (&self->last_command, mbim_message_unref);
+
+    if (self->slave >= 0)
+        close (self->slave);
+    if (self->fd >= 0)
+        close (self->fd);
+    g_free (self->path);
+
+    g_main_loop_unref (self->loop);
+    g_main_context_unref (self->context);
+    g_byte_array_unref (self->input);
+    g_byte_array_unref (self->output);
+    g_hash_table_unref (self->responses);
+    g_mutex_clear (&self->lock);
+    g_slice_free (MbimMockFunction, self);
+}
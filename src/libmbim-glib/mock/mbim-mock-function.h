@@ -0,0 +1,148 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details:
+ *
+ * Copyright (C) 2026 agent <agent@local>
+ */
+
+#ifndef _LIBMBIM_GLIB_MBIM_MOCK_FUNCTION_H_
+#define _LIBMBIM_GLIB_MBIM_MOCK_FUNCTION_H_
+
+#if !defined (LIBMBIM_GLIB_COMPILATION)
+#error "This is a private header!!"
+#endif
+
+#include <glib.h>
+
+#include "mbim-uuid.h"
+#include "mbim-errors.h"
+#include "mbim-message.h"
+
+G_BEGIN_DECLS
+
+/*****************************************************************************/
+/* Mock MBIM function
+ *
+ * Speaks the device side of the MBIM control protocol, so that a MbimDevice
+ * (or a MbimProxy) can be tested or load-tested without real hardware. By
+ * default a pseudo-terminal is created, and its path can be given to
+ * mbim_device_new() like any other cdc-wdm port.
+ *
+ * OPEN and CLOSE requests are always acknowledged. Commands are answered
+ * with the responses configured for their service and cid, or with an empty
+ * successful response otherwise.
+ *
+ * All the I/O is done in a dedicated thread, so the methods may be called
+ * from any thread, including the one running the MbimDevice under test. */
+
+typedef struct _MbimMockFunction MbimMockFunction;
+
+typedef enum {
+    MBIM_MOCK_FUNCTION_FLAGS_NONE              = 0,
+    /* Send the fragments of every fragmented message in reverse order */
+    MBIM_MOCK_FUNCTION_FLAGS_REORDER_FRAGMENTS = 1 << 0,
+} MbimMockFunctionFlags;
+
+MbimMockFunction *mbim_mock_function_new        (GError               **error);
+/* Use an already connected fd (e.g. one end of a socketpair), which will be
+ * owned by the mock function */
+MbimMockFunction *mbim_mock_function_new_for_fd (gint                   fd,
+                                                 GError               **error);
+void              mbim_mock_function_free       (MbimMockFunction      *self);
+
+/* Path of the pseudo-terminal, or NULL if created for a given fd */
+const gchar      *mbim_mock_function_get_path   (MbimMockFunction      *self);
+
+/* Number of commands received so far */
+guint64           mbim_mock_function_get_n_commands (MbimMockFunction  *self);
+/* Number of command fragments received so far */
+guint64           mbim_mock_function_get_n_command_fragments (MbimMockFunction *self);
+/* Last command received, once all its fragments were collected */
+MbimMessage      *mbim_mock_function_get_last_command (MbimMockFunction *self);
+
+/*****************************************************************************/
+/* Behavior */
+
+void     mbim_mock_function_set_flags       (MbimMockFunction      *self,
+                                             MbimMockFunctionFlags  flags);
+/* Delay applied to every response, not to indications */
+void     mbim_mock_function_set_latency     (MbimMockFunction      *self,
+                                             guint                  latency_ms);
+/* Split every response and indication in the given number of fragments;
+ * 0 or 1 to never split */
+void     mbim_mock_function_set_n_fragments (MbimMockFunction      *self,
+                                             guint                  n_fragments);
+
+void     mbim_mock_function_add_response    (MbimMockFunction      *self,
+                                             const MbimUuid        *service_id,
+                                             guint32                cid,
+                                             MbimStatusError        status,
+                                             const guint8          *buffer,
+                                             guint32                buffer_length);
+/* Answer the given command with a function error instead of a response */
+void     mbim_mock_function_add_function_error (MbimMockFunction   *self,
+                                                const MbimUuid     *service_id,
+                                                guint32             cid,
+                                                MbimProtocolError   error);
+
+/* Keep all the responses to commands (and to OPEN/CLOSE) until released, so
+ * that the host sees requests pending for as long as needed. Once released,
+ * they are sent in order, with the configured latency. */
+void     mbim_mock_function_hold_responses    (MbimMockFunction    *self);
+void     mbim_mock_function_release_responses (MbimMockFunction    *self);
+
+/* Load responses from a key file, with one group per response:
+ *
+ *   [device-caps]
+ *   service=basic-connect
+ *   cid=1
+ *   status=0
+ *   buffer=02 00 00 00 01 00 00 00 ...
+ *
+ * The service is given either as a service name or as a printable UUID; the
+ * status and the information buffer (given in hex) are both optional. */
+gboolean mbim_mock_function_load_responses  (MbimMockFunction      *self,
+                                             const gchar           *path,
+                                             GError               **error);
+
+/* Helpers to parse the same formats as in the key file */
+gboolean    mbim_mock_function_parse_service (const gchar  *str,
+                                              MbimUuid     *out_uuid);
+GByteArray *mbim_mock_function_parse_hex     (const gchar  *str,
+                                              GError      **error);
+
+/*****************************************************************************/
+/* Unsolicited data */
+
+/* Write raw data to the host, as is */
+void     mbim_mock_function_send_raw        (MbimMockFunction      *self,
+                                             const guint8          *data,
+                                             gsize                  data_length);
+void     mbim_mock_function_send_indication (MbimMockFunction      *self,
+                                             const MbimUuid        *service_id,
+                                             guint32                cid,
+                                             const guint8          *buffer,
+                                             guint32                buffer_length);
+
+/* Send indications at the given rate (per second); if rate is 0 all of them
+ * are sent at once. If count is 0, they are sent until stopped. */
+void     mbim_mock_function_start_indications (MbimMockFunction    *self,
+                                               const MbimUuid      *service_id,
+                                               guint32              cid,
+                                               const guint8        *buffer,
+                                               guint32              buffer_length,
+                                               guint                rate,
+                                               guint                count);
+void     mbim_mock_function_stop_indications  (MbimMockFunction    *self);
+
+G_END_DECLS
+
+#endif /* _LIBMBIM_GLIB_MBIM_MOCK_FUNCTION_H_ */
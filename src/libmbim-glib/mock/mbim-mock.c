@@ -0,0 +1,262 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+/*
+ * mbim-mock -- A mock MBIM function, to test and load-test MBIM hosts
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Copyright (C) 2026 agent <agent@local>
+ */
+
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <locale.h>
+#include <string.h>
+
+#include <glib.h>
+#include <glib-unix.h>
+
+#include "mbim-uuid.h"
+#include "mbim-error-types.h"
+
+#include "mbim-mock-function.h"
+
+#define PROGRAM_NAME    "mbim-mock"
+#define PROGRAM_VERSION PACKAGE_VERSION
+
+/* Globals */
+static GMainLoop *loop;
+
+/* Main options */
+static gchar    *responses_str;
+static gint      latency_ms;
+static gint      n_fragments;
+static gboolean  reorder_fragments_flag;
+static gchar    *indication_str;
+static gint      indication_rate;
+static gint      indication_count;
+static gboolean  verbose_flag;
+static gboolean  version_flag;
+
+static GOptionEntry main_entries[] = {
+    { "responses", 'r', 0, G_OPTION_ARG_FILENAME, &responses_str,
+      "Load the command responses from the given key file",
+      "[PATH]"
+    },
+    { "latency", 'l', 0, G_OPTION_ARG_INT, &latency_ms,
+      "Delay every response by the given time",
+      "[MS]"
+    },
+    { "fragments", 'f', 0, G_OPTION_ARG_INT, &n_fragments,
+      "Split every response and indication in the given number of fragments",
+      "[N]"
+    },
+    { "reorder-fragments", 0, 0, G_OPTION_ARG_NONE, &reorder_fragments_flag,
+      "Send the fragments in reverse order",
+      NULL
+    },
+    { "indication", 'i', 0, G_OPTION_ARG_STRING, &indication_str,
+      "Send indications with the given service, cid and contents",
+      "[(Service),(CID),(Hex buffer)]"
+    },
+    { "indication-rate", 0, 0, G_OPTION_ARG_INT, &indication_rate,
+      "Number of indications to send per second; 0 to send all at once",
+      "[RATE]"
+    },
+    { "indication-count", 0, 0, G_OPTION_ARG_INT, &indication_count,
+      "Number of indications to send; 0 to send them until stopped",
+      "[COUNT]"
+    },
+    { "verbose", 'v', 0, G_OPTION_ARG_NONE, &verbose_flag,
+      "Run action with verbose logs, including the debug ones",
+      NULL
+    },
+    { "version", 'V', 0, G_OPTION_ARG_NONE, &version_flag,
+      "Print version",
+      NULL
+    },
+    { NULL }
+};
+
+static gboolean
+quit_cb (gpointer user_data)
+{
+    if (loop) {
+        g_warning ("Caught signal, stopping the loop...");
+        g_idle_add ((GSourceFunc) g_main_loop_quit, loop);
+    }
+
+    return FALSE;
+}
+
+static void
+log_handler (const gchar    *log_domain,
+             GLogLevelFlags  log_level,
+             const gchar    *message,
+             gpointer        user_data)
+{
+    const gchar *log_level_str;
+    gboolean     err = FALSE;
+
+    switch (log_level) {
+    case G_LOG_LEVEL_WARNING:
+        log_level_str = "-Warning **";
+        err = TRUE;
+        break;
+
+    case G_LOG_LEVEL_CRITICAL:
+    case G_LOG_FLAG_FATAL:
+    case G_LOG_LEVEL_ERROR:
+        log_level_str = "-Error **";
+        err = TRUE;
+        break;
+
+    case G_LOG_LEVEL_DEBUG:
+        log_level_str = "[Debug]";
+        break;
+
+    case G_LOG_LEVEL_MESSAGE:
+    case G_LOG_LEVEL_INFO:
+        log_level_str = "";
+        break;
+
+    case G_LOG_FLAG_RECURSION:
+    case G_LOG_LEVEL_MASK:
+    default:
+        g_assert_not_reached ();
+    }
+
+    if (!verbose_flag && !err)
+        return;
+
+    g_printerr ("%s %s\n", log_level_str, message);
+}
+
+/*****************************************************************************/
+
+static gboolean
+start_indications (MbimMockFunction  *mock,
+                   GError           **error)
+{
+    g_auto(GStrv)         split = NULL;
+    g_autoptr(GByteArray) buffer = NULL;
+    MbimUuid              service_id;
+    guint64               cid;
+
+    split = g_strsplit (indication_str, ",", 3);
+    if (g_strv_length (split) < 2 || !mbim_mock_function_parse_service (split[0], &service_id)) {
+        g_set_error (error, MBIM_CORE_ERROR, MBIM_CORE_ERROR_INVALID_ARGS,
+                     "invalid indication service: '%s'", indication_str);
+        return FALSE;
+    }
+
+    if (!g_ascii_string_to_unsigned (split[1], 10, 0, G_MAXUINT32, &cid, NULL)) {
+        g_set_error (error, MBIM_CORE_ERROR, MBIM_CORE_ERROR_INVALID_ARGS,
+                     "invalid indication cid: '%s'", split[1]);
+        return FALSE;
+    }
+
+    if (split[2] && split[2][0]) {
+        buffer = mbim_mock_function_parse_hex (split[2], error);
+        if (!buffer)
+            return FALSE;
+    }
+
+    if (indication_rate < 0 || indication_count < 0 || (!indication_rate && !indication_count)) {
+        g_set_error (error, MBIM_CORE_ERROR, MBIM_CORE_ERROR_INVALID_ARGS,
+                     "either an indication rate or an indication count is required");
+        return FALSE;
+    }
+
+    mbim_mock_function_start_indications (mock,
+                                          &service_id,
+                                          (guint32) cid,
+                                          buffer ? buffer->data : NULL,
+                                          buffer ? buffer->len : 0,
+                                          (guint) indication_rate,
+                                          (guint) indication_count);
+    return TRUE;
+}
+
+/*****************************************************************************/
+
+int main (int argc, char **argv)
+{
+    g_autoptr(GError)         error = NULL;
+    g_autoptr(GOptionContext) context = NULL;
+    MbimMockFunction         *mock;
+    MbimMockFunctionFlags     flags = MBIM_MOCK_FUNCTION_FLAGS_NONE;
+
+    setlocale (LC_ALL, "");
+
+    /* Setup option context, process it and destroy it */
+    context = g_option_context_new ("- Mock MBIM function");
+    g_option_context_add_main_entries (context, main_entries, NULL);
+    if (!g_option_context_parse (context, &argc, &argv, &error)) {
+        g_printerr ("error: %s\n", error->message);
+        exit (EXIT_FAILURE);
+    }
+
+    if (version_flag) {
+        g_print (PROGRAM_NAME " " PROGRAM_VERSION "\n");
+        exit (EXIT_SUCCESS);
+    }
+
+    if (latency_ms < 0 || n_fragments < 0) {
+        g_printerr ("error: latency and number of fragments must not be negative\n");
+        exit (EXIT_FAILURE);
+    }
+
+    g_log_set_handler (NULL,  G_LOG_LEVEL_MASK, log_handler, NULL);
+    g_log_set_handler ("Mbim", G_LOG_LEVEL_MASK, log_handler, NULL);
+
+    mock = mbim_mock_function_new (&error);
+    if (!mock) {
+        g_printerr ("error: %s\n", error->message);
+        exit (EXIT_FAILURE);
+    }
+
+    if (reorder_fragments_flag)
+        flags |= MBIM_MOCK_FUNCTION_FLAGS_REORDER_FRAGMENTS;
+    mbim_mock_function_set_flags (mock, flags);
+    mbim_mock_function_set_latency (mock, (guint) latency_ms);
+    mbim_mock_function_set_n_fragments (mock, (guint) n_fragments);
+
+    if ((responses_str && !mbim_mock_function_load_responses (mock, responses_str, &error)) ||
+        (indication_str && !start_indications (mock, &error))) {
+        g_printerr ("error: %s\n", error->message);
+        mbim_mock_function_free (mock);
+        exit (EXIT_FAILURE);
+    }
+
+    /* The path is the only thing printed to stdout, so that scripts can
+     * easily use it */
+    g_print ("%s\n", mbim_mock_function_get_path (mock));
+
+    /* Setup signals */
+    g_unix_signal_add (SIGINT,  quit_cb, NULL);
+    g_unix_signal_add (SIGHUP,  quit_cb, NULL);
+    g_unix_signal_add (SIGTERM, quit_cb, NULL);
+
+    /* Loop */
+    loop = g_main_loop_new (NULL, FALSE);
+    g_main_loop_run (loop);
+    g_main_loop_unref (loop);
+
+    g_debug ("%" G_GUINT64_FORMAT " commands processed", mbim_mock_function_get_n_commands (mock));
+    mbim_mock_function_free (mock);
+
+    return EXIT_SUCCESS;
+}
@@ -129,6 +129,35 @@ test_cid_ms_sar (void)
                  TRUE, TRUE, TRUE);
 }
 
+static void
+test_cid_proxy_control (void)
+{
+    test_common (MBIM_SERVICE_PROXY_CONTROL,
+                 MBIM_CID_PROXY_CONTROL_CLIENT_CONFIGURATION,
+                 TRUE, FALSE, FALSE);
+}
+
+static void
+test_cid_out_of_range (void)
+{
+    /* CIDs past the last known one in the service */
+    test_common (MBIM_SERVICE_USSD,
+                 MBIM_CID_USSD + 1,
+                 FALSE, FALSE, FALSE);
+    test_common (MBIM_SERVICE_BASIC_CONNECT,
+                 1000,
+                 FALSE, FALSE, FALSE);
+    g_assert (mbim_cid_get_printable (MBIM_SERVICE_BASIC_CONNECT, 1000) == NULL);
+
+    /* Custom services */
+    test_common (MBIM_SERVICE_LAST + 10,
+                 1,
+                 FALSE, FALSE, FALSE);
+    g_assert (mbim_cid_get_printable (MBIM_SERVICE_LAST + 10, 1) == NULL);
+
+    g_assert_cmpstr (mbim_cid_get_printable (MBIM_SERVICE_BASIC_CONNECT, MBIM_CID_BASIC_CONNECT_DEVICE_CAPS), ==, "device-caps");
+}
+
 int main (int argc, char **argv)
 {
     g_test_init (&argc, &argv, NULL);
@@ -143,6 +172,8 @@ int main (int argc, char **argv)
     g_test_add_func ("/libmbim-glib/cid/ms-firmware-id",   test_cid_ms_firmware_id);
     g_test_add_func ("/libmbim-glib/cid/ms-host-shutdown", test_cid_ms_host_shutdown);
     g_test_add_func ("/libmbim-glib/cid/ms-sar",           test_cid_ms_sar);
+    g_test_add_func ("/libmbim-glib/cid/proxy-control",    test_cid_proxy_control);
+    g_test_add_func ("/libmbim-glib/cid/out-of-range",     test_cid_out_of_range);
 
     return g_test_run ();
 }
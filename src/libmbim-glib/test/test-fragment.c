@@ -18,6 +18,7 @@
 
 #include "mbim-message.h"
 #include "mbim-message-private.h"
+#include "mbim-error-types.h"
 
 static void
 test_fragment_receive_single (void)
@@ -160,6 +161,73 @@ test_fragment_receive_multiple (void)
     mbim_message_unref (message);
 }
 
+static void
+test_fragment_receive_out_of_window (void)
+{
+    MbimMessage *message;
+    MbimMessage *fragment;
+    GError *error = NULL;
+    guint32 collected_length;
+
+    const guint8 first [] = {
+        0x07, 0x00, 0x00, 0x80, /* indications have fragments */
+        0x1C, 0x00, 0x00, 0x00, /* length of this fragment */
+        0x01, 0x00, 0x00, 0x00, /* transaction id */
+        0x03, 0x00, 0x00, 0x00, /* total fragments */
+        0x00, 0x00, 0x00, 0x00, /* current fragment */
+        0x00, 0x01, 0x02, 0x03, /* frament data */
+        0x04, 0x05, 0x06, 0x07
+    };
+
+    const guint8 wrong_total [] = {
+        0x07, 0x00, 0x00, 0x80, /* indications have fragments */
+        0x1C, 0x00, 0x00, 0x00, /* length of this fragment */
+        0x01, 0x00, 0x00, 0x00, /* transaction id */
+        0x04, 0x00, 0x00, 0x00, /* total fragments (mismatch) */
+        0x01, 0x00, 0x00, 0x00, /* current fragment */
+        0x08, 0x09, 0x0A, 0x0B, /* frament data */
+        0x0C, 0x0D, 0x0E, 0x0F
+    };
+
+    const guint8 wrong_current [] = {
+        0x07, 0x00, 0x00, 0x80, /* indications have fragments */
+        0x1C, 0x00, 0x00, 0x00, /* length of this fragment */
+        0x01, 0x00, 0x00, 0x00, /* transaction id */
+        0x03, 0x00, 0x00, 0x00, /* total fragments */
+        0x02, 0x00, 0x00, 0x00, /* current fragment (skips one) */
+        0x08, 0x09, 0x0A, 0x0B, /* frament data */
+        0x0C, 0x0D, 0x0E, 0x0F
+    };
+
+    fragment = mbim_message_new (first, sizeof (first));
+    message = _mbim_message_fragment_collector_init (fragment, &error);
+    g_assert_no_error (error);
+    g_assert (message != NULL);
+    mbim_message_unref (fragment);
+    collected_length = mbim_message_get_message_length (message);
+
+    /* Fragment with a different total count is rejected */
+    fragment = mbim_message_new (wrong_total, sizeof (wrong_total));
+    g_assert (!_mbim_message_fragment_collector_add (message, fragment, &error));
+    g_assert_error (error, MBIM_PROTOCOL_ERROR, MBIM_PROTOCOL_ERROR_FRAGMENT_OUT_OF_SEQUENCE);
+    g_clear_error (&error);
+    mbim_message_unref (fragment);
+
+    /* Fragment out of sequence is rejected */
+    fragment = mbim_message_new (wrong_current, sizeof (wrong_current));
+    g_assert (!_mbim_message_fragment_collector_add (message, fragment, &error));
+    g_assert_error (error, MBIM_PROTOCOL_ERROR, MBIM_PROTOCOL_ERROR_FRAGMENT_OUT_OF_SEQUENCE);
+    g_clear_error (&error);
+    mbim_message_unref (fragment);
+
+    /* Collected data is untouched */
+    g_assert_cmpuint (mbim_message_get_message_length (message), ==, collected_length);
+    g_assert_cmpuint (_mbim_message_fragment_get_current (message), ==, 0);
+    g_assert         (_mbim_message_fragment_collector_complete (message) == FALSE);
+
+    mbim_message_unref (message);
+}
+
 static void
 test_fragment_send_multiple_common (guint32       max_fragment_size,
                                     const guint8 *buffer,
@@ -324,6 +392,7 @@ int main (int argc, char **argv)
 
     g_test_add_func ("/libmbim-glib/fragment/receive/single",   test_fragment_receive_single);
     g_test_add_func ("/libmbim-glib/fragment/receive/multiple", test_fragment_receive_multiple);
+    g_test_add_func ("/libmbim-glib/fragment/receive/out-of-window", test_fragment_receive_out_of_window);
     g_test_add_func ("/libmbim-glib/fragment/send/multiple-1",  test_fragment_send_multiple_1);
     g_test_add_func ("/libmbim-glib/fragment/send/multiple-2",  test_fragment_send_multiple_2);
 
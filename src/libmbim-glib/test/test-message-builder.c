@@ -1346,6 +1346,146 @@ test_message_builder_ms_host_shutdown_notify_set (void)
     mbim_message_unref (message);
 }
 
+static void
+test_message_builder_sized (void)
+{
+    MbimMessage *message_sized;
+    MbimMessage *message_unsized;
+    MbimMessageCommandBuilder *builder;
+    guint32 fixed_size = 0;
+    guint32 variable_size = 0;
+    guint i;
+    const guint8 buffer[] = { 0x01, 0x02, 0x03, 0x04, 0x05 };
+    const MbimIPv4 ipv4 = { .addr = { 0xC0, 0xA8, 0x01, 0x01 } };
+    /* One 2-byte, one 3-byte and one 4-byte (non-BMP) UTF-8 sequence */
+    const gchar *str = "a\xC3\xB1\xE2\x82\xAC\xF0\x9F\x98\x80";
+    static const guint8 expected_utf16le[] = {
+        0x61, 0x00, 0xF1, 0x00, 0xAC, 0x20, 0x3D, 0xD8, 0x00, 0xDE
+    };
+
+    fixed_size += sizeof (guint32);
+    _mbim_struct_builder_size_string (str, &fixed_size, &variable_size);
+    _mbim_struct_builder_size_byte_array (TRUE, TRUE, TRUE, sizeof (buffer), &fixed_size, &variable_size);
+    _mbim_struct_builder_size_byte_array (FALSE, TRUE, FALSE, sizeof (buffer), &fixed_size, &variable_size);
+    _mbim_struct_builder_size_string (NULL, &fixed_size, &variable_size);
+    _mbim_struct_builder_size_ipv4 (&ipv4, TRUE, &fixed_size, &variable_size);
+    _mbim_struct_builder_size_ipv4_array (1, &fixed_size, &variable_size);
+    fixed_size += sizeof (guint64);
+
+    g_assert_cmpuint (fixed_size, ==, 4 + 8 + 8 + 4 + 8 + 4 + 4 + 8);
+    g_assert_cmpuint (variable_size, ==, 12 + 8 + 5 + 4 + 4);
+
+    for (i = 0; i < 2; i++) {
+        MbimMessage *message;
+
+        if (i == 0)
+            builder = _mbim_message_command_builder_new_sized (1,
+                                                               MBIM_SERVICE_BASIC_CONNECT,
+                                                               MBIM_CID_BASIC_CONNECT_CONNECT,
+                                                               MBIM_MESSAGE_COMMAND_TYPE_SET,
+                                                               fixed_size,
+                                                               variable_size);
+        else
+            builder = _mbim_message_command_builder_new (1,
+                                                         MBIM_SERVICE_BASIC_CONNECT,
+                                                         MBIM_CID_BASIC_CONNECT_CONNECT,
+                                                         MBIM_MESSAGE_COMMAND_TYPE_SET);
+        _mbim_message_command_builder_append_guint32     (builder, 0x01);
+        _mbim_message_command_builder_append_string      (builder, str);
+        _mbim_message_command_builder_append_byte_array  (builder, TRUE, TRUE, TRUE, buffer, sizeof (buffer));
+        _mbim_message_command_builder_append_byte_array  (builder, FALSE, TRUE, FALSE, buffer, sizeof (buffer));
+        _mbim_message_command_builder_append_string      (builder, NULL);
+        _mbim_message_command_builder_append_ipv4        (builder, &ipv4, TRUE);
+        _mbim_message_command_builder_append_ipv4_array  (builder, &ipv4, 1);
+        _mbim_message_command_builder_append_guint64     (builder, G_GUINT64_CONSTANT (0x0102030405060708));
+        message = _mbim_message_command_builder_complete (builder);
+        g_assert (message != NULL);
+
+        if (i == 0)
+            message_sized = message;
+        else
+            message_unsized = message;
+    }
+
+    test_message_trace ((const guint8 *)((GByteArray *)message_sized)->data,
+                        ((GByteArray *)message_sized)->len,
+                        (const guint8 *)((GByteArray *)message_unsized)->data,
+                        ((GByteArray *)message_unsized)->len);
+
+    /* Both ways of building the message must give the same result */
+    g_assert_cmpuint (mbim_message_get_message_length (message_sized), ==, ((GByteArray *)message_sized)->len);
+    g_assert_cmpuint (((GByteArray *)message_sized)->len, ==, ((GByteArray *)message_unsized)->len);
+    g_assert (memcmp (((GByteArray *)message_sized)->data,
+                      ((GByteArray *)message_unsized)->data,
+                      ((GByteArray *)message_sized)->len) == 0);
+
+    /* String offset is right after the fixed buffer, with surrogate pair */
+    g_assert_cmpuint (GUINT32_FROM_LE (*(guint32 *)(&((GByteArray *)message_sized)->data[48 + 4])), ==, fixed_size);
+    g_assert_cmpuint (GUINT32_FROM_LE (*(guint32 *)(&((GByteArray *)message_sized)->data[48 + 8])), ==, sizeof (expected_utf16le));
+    g_assert (memcmp (&((GByteArray *)message_sized)->data[48 + fixed_size], expected_utf16le, sizeof (expected_utf16le)) == 0);
+
+    mbim_message_unref (message_sized);
+    mbim_message_unref (message_unsized);
+}
+
+static void
+test_message_builder_sized_string_array (void)
+{
+    MbimMessage               *messages[2];
+    MbimMessageCommandBuilder *builder;
+    guint32                    fixed_size = 0;
+    guint32                    variable_size = 0;
+    guint                      i;
+    g_auto(GStrv)              parsed = NULL;
+    g_autoptr(GError)          error = NULL;
+    const gchar *const         values[] = { "+15555550100", "a\xC3\xB1", "" };
+
+    fixed_size += sizeof (guint32);
+    _mbim_struct_builder_size_string_array (values, G_N_ELEMENTS (values), &fixed_size, &variable_size);
+    fixed_size += sizeof (guint32);
+
+    /* One Offset+Size pair per string, and the padded UTF-16 strings */
+    g_assert_cmpuint (fixed_size, ==, 4 + 3 * 8 + 4);
+    g_assert_cmpuint (variable_size, ==, 24 + 4 + 0);
+
+    for (i = 0; i < 2; i++) {
+        if (i == 0)
+            builder = _mbim_message_command_builder_new_sized (1,
+                                                               MBIM_SERVICE_BASIC_CONNECT,
+                                                               MBIM_CID_BASIC_CONNECT_SUBSCRIBER_READY_STATUS,
+                                                               MBIM_MESSAGE_COMMAND_TYPE_SET,
+                                                               fixed_size,
+                                                               variable_size);
+        else
+            builder = _mbim_message_command_builder_new (1,
+                                                         MBIM_SERVICE_BASIC_CONNECT,
+                                                         MBIM_CID_BASIC_CONNECT_SUBSCRIBER_READY_STATUS,
+                                                         MBIM_MESSAGE_COMMAND_TYPE_SET);
+        _mbim_message_command_builder_append_guint32      (builder, G_N_ELEMENTS (values));
+        _mbim_message_command_builder_append_string_array (builder, values, G_N_ELEMENTS (values));
+        _mbim_message_command_builder_append_guint32      (builder, 0xFFFFFFFF);
+        messages[i] = _mbim_message_command_builder_complete (builder);
+        g_assert (messages[i] != NULL);
+    }
+
+    /* Both ways of building the message must give the same result */
+    g_assert_cmpuint (((GByteArray *)messages[0])->len, ==, ((GByteArray *)messages[1])->len);
+    g_assert (memcmp (((GByteArray *)messages[0])->data,
+                      ((GByteArray *)messages[1])->data,
+                      ((GByteArray *)messages[0])->len) == 0);
+
+    /* And the strings must be read back as given */
+    g_assert (_mbim_message_read_string_array (messages[0], G_N_ELEMENTS (values), 0, 4, &parsed, &error));
+    g_assert_no_error (error);
+    g_assert_cmpstr (parsed[0], ==, values[0]);
+    g_assert_cmpstr (parsed[1], ==, values[1]);
+    /* Empty strings are read as NULL */
+    g_assert (parsed[2] == NULL);
+
+    mbim_message_unref (messages[0]);
+    mbim_message_unref (messages[1]);
+}
+
 int main (int argc, char **argv)
 {
     g_test_init (&argc, &argv, NULL);
@@ -1367,6 +1507,8 @@ int main (int argc, char **argv)
     g_test_add_func ("/libmbim-glib/message/builder/dss/connect/set", test_message_builder_dss_connect_set);
     g_test_add_func ("/libmbim-glib/message/builder/basic-connect/multicarrier-providers/set", test_message_builder_basic_connect_multicarrier_providers_set);
     g_test_add_func ("/libmbim-glib/message/builder/ms-host-shutdown/notify/set", test_message_builder_ms_host_shutdown_notify_set);
+    g_test_add_func ("/libmbim-glib/message/builder/sized", test_message_builder_sized);
+    g_test_add_func ("/libmbim-glib/message/builder/sized/string-array", test_message_builder_sized_string_array);
 
     return g_test_run ();
 }
@@ -65,73 +65,95 @@ test_message_trace (const guint8 *computed,
 #endif
 
 static void
-test_message_parser_basic_connect_visible_providers (void)
+test_message_printable (MbimMessage *message,
+                        const gchar *expected,
+                        const gchar *unexpected)
+{
+    g_autofree gchar *printable = NULL;
+
+    printable = mbim_message_get_printable (message, "", FALSE);
+    g_assert (printable != NULL);
+    g_test_message ("%s", printable);
+
+    /* Only the fields section is compared, header contents are already
+     * covered elsewhere */
+    g_assert (strstr (printable, expected) != NULL);
+    if (unexpected)
+        g_assert (strstr (printable, unexpected) == NULL);
+}
+
+static const guint8 visible_providers_buffer [] =  {
+    /* header */
+    0x03, 0x00, 0x00, 0x80, /* type */
+    0xB4, 0x00, 0x00, 0x00, /* length */
+    0x02, 0x00, 0x00, 0x00, /* transaction id */
+    /* fragment header */
+    0x01, 0x00, 0x00, 0x00, /* total */
+    0x00, 0x00, 0x00, 0x00, /* current */
+    /* command_done_message */
+    0xA2, 0x89, 0xCC, 0x33, /* service id */
+    0xBC, 0xBB, 0x8B, 0x4F,
+    0xB6, 0xB0, 0x13, 0x3E,
+    0xC2, 0xAA, 0xE6, 0xDF,
+    0x08, 0x00, 0x00, 0x00, /* command id */
+    0x00, 0x00, 0x00, 0x00, /* status code */
+    0x84, 0x00, 0x00, 0x00, /* buffer length */
+    /* information buffer */
+    0x02, 0x00, 0x00, 0x00, /* 0x00 providers count */
+    0x14, 0x00, 0x00, 0x00, /* 0x04 provider 0 offset */
+    0x38, 0x00, 0x00, 0x00, /* 0x08 provider 0 length */
+    0x4C, 0x00, 0x00, 0x00, /* 0x0C provider 1 offset */
+    0x38, 0x00, 0x00, 0x00, /* 0x10 provider 1 length */
+    /* data buffer... struct provider 0 */
+    0x20, 0x00, 0x00, 0x00, /* 0x14 [0x00] id offset */
+    0x0A, 0x00, 0x00, 0x00, /* 0x18 [0x04] id length */
+    0x08, 0x00, 0x00, 0x00, /* 0x1C [0x08] state */
+    0x2C, 0x00, 0x00, 0x00, /* 0x20 [0x0C] name offset */
+    0x0C, 0x00, 0x00, 0x00, /* 0x24 [0x10] name length */
+    0x01, 0x00, 0x00, 0x00, /* 0x28 [0x14] cellular class */
+    0x0B, 0x00, 0x00, 0x00, /* 0x2C [0x18] rssi */
+    0x00, 0x00, 0x00, 0x00, /* 0x30 [0x1C] error rate */
+    0x32, 0x00, 0x31, 0x00, /* 0x34 [0x20] id string (10 bytes) */
+    0x34, 0x00, 0x30, 0x00,
+    0x33, 0x00, 0x00, 0x00,
+    0x4F, 0x00, 0x72, 0x00, /* 0x40 [0x2C] name string (12 bytes) */
+    0x61, 0x00, 0x6E, 0x00,
+    0x67, 0x00, 0x65, 0x00,
+    /* data buffer... struct provider 1 */
+    0x20, 0x00, 0x00, 0x00, /* 0x4C [0x00] id offset */
+    0x0A, 0x00, 0x00, 0x00, /* 0x50 [0x04] id length */
+    0x19, 0x00, 0x00, 0x00, /* 0x51 [0x08] state */
+    0x2C, 0x00, 0x00, 0x00, /* 0x54 [0x0C] name offset */
+    0x0C, 0x00, 0x00, 0x00, /* 0x58 [0x10] name length */
+    0x01, 0x00, 0x00, 0x00, /* 0x5C [0x14] cellular class */
+    0x0B, 0x00, 0x00, 0x00, /* 0x60 [0x18] rssi */
+    0x00, 0x00, 0x00, 0x00, /* 0x64 [0x1C] error rate */
+    0x32, 0x00, 0x31, 0x00, /* 0x68 [0x20] id string (10 bytes) */
+    0x34, 0x00, 0x30, 0x00,
+    0x33, 0x00, 0x00, 0x00,
+    0x4F, 0x00, 0x72, 0x00, /* 0x74 [0x2C] name string (12 bytes) */
+    0x61, 0x00, 0x6E, 0x00,
+    0x67, 0x00, 0x65, 0x00 };
+
+static void
+common_test_message_parser_basic_connect_visible_providers (MbimArena *arena)
 {
     guint32 n_providers;
     g_autoptr(GError) error = NULL;
-    g_autoptr(MbimProviderArray) providers = NULL;
+    MbimProviderArray *providers = NULL;
     g_autoptr(MbimMessage) response = NULL;
 
-    const guint8 buffer [] =  {
-        /* header */
-        0x03, 0x00, 0x00, 0x80, /* type */
-        0xB4, 0x00, 0x00, 0x00, /* length */
-        0x02, 0x00, 0x00, 0x00, /* transaction id */
-        /* fragment header */
-        0x01, 0x00, 0x00, 0x00, /* total */
-        0x00, 0x00, 0x00, 0x00, /* current */
-        /* command_done_message */
-        0xA2, 0x89, 0xCC, 0x33, /* service id */
-        0xBC, 0xBB, 0x8B, 0x4F,
-        0xB6, 0xB0, 0x13, 0x3E,
-        0xC2, 0xAA, 0xE6, 0xDF,
-        0x08, 0x00, 0x00, 0x00, /* command id */
-        0x00, 0x00, 0x00, 0x00, /* status code */
-        0x84, 0x00, 0x00, 0x00, /* buffer length */
-        /* information buffer */
-        0x02, 0x00, 0x00, 0x00, /* 0x00 providers count */
-        0x14, 0x00, 0x00, 0x00, /* 0x04 provider 0 offset */
-        0x38, 0x00, 0x00, 0x00, /* 0x08 provider 0 length */
-        0x4C, 0x00, 0x00, 0x00, /* 0x0C provider 1 offset */
-        0x38, 0x00, 0x00, 0x00, /* 0x10 provider 1 length */
-        /* data buffer... struct provider 0 */
-        0x20, 0x00, 0x00, 0x00, /* 0x14 [0x00] id offset */
-        0x0A, 0x00, 0x00, 0x00, /* 0x18 [0x04] id length */
-        0x08, 0x00, 0x00, 0x00, /* 0x1C [0x08] state */
-        0x2C, 0x00, 0x00, 0x00, /* 0x20 [0x0C] name offset */
-        0x0C, 0x00, 0x00, 0x00, /* 0x24 [0x10] name length */
-        0x01, 0x00, 0x00, 0x00, /* 0x28 [0x14] cellular class */
-        0x0B, 0x00, 0x00, 0x00, /* 0x2C [0x18] rssi */
-        0x00, 0x00, 0x00, 0x00, /* 0x30 [0x1C] error rate */
-        0x32, 0x00, 0x31, 0x00, /* 0x34 [0x20] id string (10 bytes) */
-        0x34, 0x00, 0x30, 0x00,
-        0x33, 0x00, 0x00, 0x00,
-        0x4F, 0x00, 0x72, 0x00, /* 0x40 [0x2C] name string (12 bytes) */
-        0x61, 0x00, 0x6E, 0x00,
-        0x67, 0x00, 0x65, 0x00,
-        /* data buffer... struct provider 1 */
-        0x20, 0x00, 0x00, 0x00, /* 0x4C [0x00] id offset */
-        0x0A, 0x00, 0x00, 0x00, /* 0x50 [0x04] id length */
-        0x19, 0x00, 0x00, 0x00, /* 0x51 [0x08] state */
-        0x2C, 0x00, 0x00, 0x00, /* 0x54 [0x0C] name offset */
-        0x0C, 0x00, 0x00, 0x00, /* 0x58 [0x10] name length */
-        0x01, 0x00, 0x00, 0x00, /* 0x5C [0x14] cellular class */
-        0x0B, 0x00, 0x00, 0x00, /* 0x60 [0x18] rssi */
-        0x00, 0x00, 0x00, 0x00, /* 0x64 [0x1C] error rate */
-        0x32, 0x00, 0x31, 0x00, /* 0x68 [0x20] id string (10 bytes) */
-        0x34, 0x00, 0x30, 0x00,
-        0x33, 0x00, 0x00, 0x00,
-        0x4F, 0x00, 0x72, 0x00, /* 0x74 [0x2C] name string (12 bytes) */
-        0x61, 0x00, 0x6E, 0x00,
-        0x67, 0x00, 0x65, 0x00 };
-
-    response = mbim_message_new (buffer, sizeof (buffer));
+    response = mbim_message_new (visible_providers_buffer, sizeof (visible_providers_buffer));
 
+    if (arena)
+        mbim_arena_push_thread_default (arena);
     g_assert (mbim_message_visible_providers_response_parse (
                   response,
                   &n_providers,
                   &providers,
                   &error));
+    if (arena)
+        mbim_arena_pop_thread_default (arena);
 
     g_assert_no_error (error);
 
@@ -168,6 +190,172 @@ test_message_parser_basic_connect_visible_providers (void)
     g_assert_cmpuint (providers[1]->cellular_class, ==, MBIM_CELLULAR_CLASS_GSM);
     g_assert_cmpuint (providers[1]->rssi, ==, 11);
     g_assert_cmpuint (providers[1]->error_rate, ==, 0);
+
+    /* Struct array fields */
+    test_message_printable (response,
+                            "  ProvidersCount = '2'\n"
+                            "  Providers = '{\n"
+                            "    [0] = {\n"
+                            "          ProviderId = '21403'\n"
+                            "          ProviderState = '8'\n"
+                            "          ProviderName = 'Orange'\n"
+                            "          CellularClass = '1'\n"
+                            "          Rssi = '11'\n"
+                            "          ErrorRate = '0'\n"
+                            "    },\n"
+                            "    [1] = {\n"
+                            "          ProviderId = '21403'\n"
+                            "          ProviderState = '25'\n"
+                            "          ProviderName = 'Orange'\n"
+                            "          CellularClass = '1'\n"
+                            "          Rssi = '11'\n"
+                            "          ErrorRate = '0'\n"
+                            "    },\n"
+                            "  }'\n",
+                            NULL);
+
+    /* Arrays in the arena are released along with it */
+    if (!arena)
+        mbim_provider_array_free (providers);
+}
+
+static void
+test_message_parser_basic_connect_visible_providers (void)
+{
+    common_test_message_parser_basic_connect_visible_providers (NULL);
+}
+
+static void
+test_message_parser_basic_connect_visible_providers_arena (void)
+{
+    g_autoptr(MbimArena) arena = NULL;
+
+    /* Same contents expected, all allocated in the arena; parse twice so that
+     * the arena holds more than one array */
+    arena = mbim_arena_new ();
+    common_test_message_parser_basic_connect_visible_providers (arena);
+    common_test_message_parser_basic_connect_visible_providers (arena);
+}
+
+static void
+test_message_parser_basic_connect_visible_providers_iter (void)
+{
+    MbimStructArrayIter iter;
+    guint32 provider_state;
+    guint32 cellular_class;
+    guint32 rssi;
+    guint32 error_rate;
+    guint8 corrupted [sizeof (visible_providers_buffer)];
+    g_autoptr(GError) error = NULL;
+    g_autoptr(MbimMessage) response = NULL;
+    g_autoptr(MbimMessage) corrupted_response = NULL;
+
+    response = mbim_message_new (visible_providers_buffer, sizeof (visible_providers_buffer));
+
+    g_assert (mbim_message_visible_providers_response_iter_providers (response, &iter, &error));
+    g_assert_no_error (error);
+    g_assert_cmpuint (mbim_struct_array_iter_get_n_elements (&iter), ==, 2);
+
+    /* Provider [0] */
+    g_assert (mbim_struct_array_iter_next (&iter, &error));
+    g_assert_no_error (error);
+    g_assert (mbim_provider_iter_get_provider_state (&iter, &provider_state, &error));
+    g_assert_no_error (error);
+    g_assert_cmpuint (provider_state, ==, MBIM_PROVIDER_STATE_VISIBLE);
+    g_assert (mbim_provider_iter_get_cellular_class (&iter, &cellular_class, &error));
+    g_assert_no_error (error);
+    g_assert_cmpuint (cellular_class, ==, MBIM_CELLULAR_CLASS_GSM);
+    g_assert (mbim_provider_iter_get_rssi (&iter, &rssi, &error));
+    g_assert_no_error (error);
+    g_assert_cmpuint (rssi, ==, 11);
+    g_assert (mbim_provider_iter_get_error_rate (&iter, &error_rate, &error));
+    g_assert_no_error (error);
+    g_assert_cmpuint (error_rate, ==, 0);
+
+    /* Provider [1] */
+    g_assert (mbim_struct_array_iter_next (&iter, &error));
+    g_assert_no_error (error);
+    g_assert (mbim_provider_iter_get_provider_state (&iter, &provider_state, &error));
+    g_assert_no_error (error);
+    g_assert_cmpuint (provider_state, ==, (MBIM_PROVIDER_STATE_HOME |
+                                           MBIM_PROVIDER_STATE_VISIBLE |
+                                           MBIM_PROVIDER_STATE_REGISTERED));
+    g_assert (mbim_provider_iter_get_rssi (&iter, &rssi, &error));
+    g_assert_no_error (error);
+    g_assert_cmpuint (rssi, ==, 11);
+
+    /* No more providers */
+    g_assert (!mbim_struct_array_iter_next (&iter, &error));
+    g_assert_no_error (error);
+
+    /* Elements out of the bounds of the message must not be read */
+    memcpy (corrupted, visible_providers_buffer, sizeof (corrupted));
+    corrupted[48 + 0x0C] = 0x00;
+    corrupted[48 + 0x0D] = 0x10;
+    corrupted_response = mbim_message_new (corrupted, sizeof (corrupted));
+
+    g_assert (mbim_message_visible_providers_response_iter_providers (corrupted_response, &iter, &error));
+    g_assert_no_error (error);
+    g_assert (mbim_struct_array_iter_next (&iter, &error));
+    g_assert_no_error (error);
+    g_assert (!mbim_struct_array_iter_next (&iter, &error));
+    g_assert_error (error, MBIM_CORE_ERROR, MBIM_CORE_ERROR_INVALID_MESSAGE);
+}
+
+static void
+common_test_message_parser_basic_connect_visible_providers_overflow (MbimArena *arena)
+{
+    guint32 n_providers;
+    g_autoptr(GError) error = NULL;
+    MbimProviderArray *providers = NULL;
+    g_autoptr(MbimMessage) response = NULL;
+
+    const guint8 buffer [] =  {
+        /* header */
+        0x03, 0x00, 0x00, 0x80, /* type */
+        0x34, 0x00, 0x00, 0x00, /* length */
+        0x02, 0x00, 0x00, 0x00, /* transaction id */
+        /* fragment header */
+        0x01, 0x00, 0x00, 0x00, /* total */
+        0x00, 0x00, 0x00, 0x00, /* current */
+        /* command_done_message */
+        0xA2, 0x89, 0xCC, 0x33, /* service id */
+        0xBC, 0xBB, 0x8B, 0x4F,
+        0xB6, 0xB0, 0x13, 0x3E,
+        0xC2, 0xAA, 0xE6, 0xDF,
+        0x08, 0x00, 0x00, 0x00, /* command id */
+        0x00, 0x00, 0x00, 0x00, /* status code */
+        0x04, 0x00, 0x00, 0x00, /* buffer length */
+        /* information buffer */
+        0xFF, 0xFF, 0xFF, 0xFF  /* 0x00 providers count */
+    };
+
+    response = mbim_message_new (buffer, sizeof (buffer));
+
+    /* The providers count must not be trusted to size the array */
+    if (arena)
+        mbim_arena_push_thread_default (arena);
+    g_assert (!mbim_message_visible_providers_response_parse (
+                  response,
+                  &n_providers,
+                  &providers,
+                  &error));
+    if (arena)
+        mbim_arena_pop_thread_default (arena);
+
+    g_assert_error (error, MBIM_CORE_ERROR, MBIM_CORE_ERROR_INVALID_MESSAGE);
+    g_assert (providers == NULL);
+}
+
+static void
+test_message_parser_basic_connect_visible_providers_overflow (void)
+{
+    g_autoptr(MbimArena) arena = NULL;
+
+    common_test_message_parser_basic_connect_visible_providers_overflow (NULL);
+
+    arena = mbim_arena_new ();
+    common_test_message_parser_basic_connect_visible_providers_overflow (arena);
 }
 
 static void
@@ -264,6 +452,50 @@ test_message_parser_basic_connect_subscriber_ready_status (void)
     g_assert_cmpstr (telephone_numbers[0], ==, "11111111111");
     g_assert_cmpstr (telephone_numbers[1], ==, "00000000000");
     g_assert (telephone_numbers[2] == NULL);
+
+    /* Enum, flags and string array fields */
+    test_message_printable (response,
+                            "  ReadyState = 'initialized'\n"
+                            "  SubscriberId = '310410000110761'\n"
+                            "  SimIccId = '89010104054601100612'\n"
+                            "  ReadyInfo = 'none'\n"
+                            "  TelephoneNumbersCount = '2'\n"
+                            "  TelephoneNumbers = '11111111111, 00000000000'\n",
+                            NULL);
+}
+
+static void
+test_message_parser_basic_connect_subscriber_ready_status_truncated (void)
+{
+    g_autoptr(MbimMessage) response = NULL;
+
+    const guint8 buffer [] =  {
+        /* header */
+        0x03, 0x00, 0x00, 0x80, /* type */
+        0x34, 0x00, 0x00, 0x00, /* length */
+        0x02, 0x00, 0x00, 0x00, /* transaction id */
+        /* fragment header */
+        0x01, 0x00, 0x00, 0x00, /* total */
+        0x00, 0x00, 0x00, 0x00, /* current */
+        /* command_message */
+        0xA2, 0x89, 0xCC, 0x33, /* service id */
+        0xBC, 0xBB, 0x8B, 0x4F,
+        0xB6, 0xB0, 0x13, 0x3E,
+        0xC2, 0xAA, 0xE6, 0xDF,
+        0x02, 0x00, 0x00, 0x00, /* command id */
+        0x00, 0x00, 0x00, 0x00, /* status code */
+        0x04, 0x00, 0x00, 0x00, /* buffer_length */
+        /* information buffer, truncated after the ready state */
+        0x01, 0x00, 0x00, 0x00  /* 0x00 ready state */
+    };
+
+    response = mbim_message_new (buffer, sizeof (buffer));
+
+    /* Fields are printed up to the first one that cannot be read */
+    test_message_printable (response,
+                            "  ReadyState = 'initialized'\n"
+                            "  SubscriberId = n/a: ",
+                            "SimIccId");
 }
 
 static void
@@ -373,6 +605,16 @@ test_message_parser_basic_connect_device_caps (void)
     g_assert_cmpstr (device_id, ==, "353613048804622");
     g_assert_cmpstr (firmware_info, ==, "11.810.09.00.00");
     g_assert_cmpstr (hardware_info, ==, "CP1E367UM");
+
+    /* Flags with multiple bits set */
+    test_message_printable (response,
+                            "  DeviceType = 'removable'\n"
+                            "  CellularClass = 'gsm'\n",
+                            NULL);
+    test_message_printable (response,
+                            "  DataClass = 'gprs, edge, umts, hsdpa, hsupa, custom'\n"
+                            "  SmsCaps = 'pdu-receive, pdu-send'\n",
+                            NULL);
 }
 
 static void
@@ -636,6 +878,74 @@ test_message_parser_basic_connect_register_state (void)
     g_assert_cmpuint (registration_flag, ==, MBIM_REGISTRATION_FLAG_PACKET_SERVICE_AUTOMATIC_ATTACH);
 }
 
+static void
+test_message_parser_basic_connect_register_state_accessors (void)
+{
+    MbimRegisterState register_state;
+    MbimDataClass available_data_classes;
+    MbimRegistrationFlag registration_flag;
+    g_autoptr(GError) error = NULL;
+    g_autoptr(MbimMessage) response = NULL;
+    g_autoptr(MbimMessage) truncated = NULL;
+
+    const guint8 buffer [] =  {
+        /* header */
+        0x03, 0x00, 0x00, 0x80, /* type */
+        0x6C, 0x00, 0x00, 0x00, /* length */
+        0x12, 0x00, 0x00, 0x00, /* transaction id */
+        /* fragment header */
+        0x01, 0x00, 0x00, 0x00, /* total */
+        0x00, 0x00, 0x00, 0x00, /* current */
+        /* command_done message */
+        0xA2, 0x89, 0xCC, 0x33, /* service id */
+        0xBC, 0xBB, 0x8B, 0x4F,
+        0xB6, 0xB0, 0x13, 0x3E,
+        0xC2, 0xAA, 0xE6, 0xDF,
+        0x09, 0x00, 0x00, 0x00, /* command id */
+        0x00, 0x00, 0x00, 0x00, /* status code */
+        0x3C, 0x00, 0x00, 0x00, /* buffer length */
+        /* information buffer */
+        0x00, 0x00, 0x00, 0x00, /* nw error */
+        0x03, 0x00, 0x00, 0x00, /* register state */
+        0x01, 0x00, 0x00, 0x00, /* register mode */
+        0x1C, 0x00, 0x00, 0x00, /* available data classes */
+        0x01, 0x00, 0x00, 0x00, /* current cellular class */
+        0x30, 0x00, 0x00, 0x00, /* provider id offset */
+        0x0A, 0x00, 0x00, 0x00, /* provider id size */
+        0x00, 0x00, 0x00, 0x00, /* provider name offset */
+        0x00, 0x00, 0x00, 0x00, /* provider name size */
+        0x00, 0x00, 0x00, 0x00, /* roaming text offset */
+        0x00, 0x00, 0x00, 0x00, /* roaming text size */
+        0x02, 0x00, 0x00, 0x00, /* registration flag */
+        /* data buffer */
+        0x32, 0x00, 0x36, 0x00,
+        0x30, 0x00, 0x30, 0x00,
+        0x36, 0x00, 0x00, 0x00 };
+
+    response = mbim_message_new (buffer, sizeof (buffer));
+
+    g_assert (mbim_message_register_state_response_get_register_state (response, &register_state, &error));
+    g_assert_no_error (error);
+    g_assert_cmpuint (register_state, ==, MBIM_REGISTER_STATE_HOME);
+
+    g_assert (mbim_message_register_state_response_get_available_data_classes (response, &available_data_classes, &error));
+    g_assert_no_error (error);
+    g_assert_cmpuint (available_data_classes, ==, (MBIM_DATA_CLASS_UMTS |
+                                                   MBIM_DATA_CLASS_HSDPA |
+                                                   MBIM_DATA_CLASS_HSUPA));
+
+    g_assert (mbim_message_register_state_response_get_registration_flag (response, &registration_flag, &error));
+    g_assert_no_error (error);
+    g_assert_cmpuint (registration_flag, ==, MBIM_REGISTRATION_FLAG_PACKET_SERVICE_AUTOMATIC_ATTACH);
+
+    /* Fields beyond the end of the buffer must not be read */
+    truncated = mbim_message_new (buffer, 48 + 20);
+    g_assert (mbim_message_register_state_response_get_current_cellular_class (truncated, NULL, &error));
+    g_assert_no_error (error);
+    g_assert (!mbim_message_register_state_response_get_registration_flag (truncated, &registration_flag, &error));
+    g_assert_error (error, MBIM_CORE_ERROR, MBIM_CORE_ERROR_INVALID_MESSAGE);
+}
+
 static void
 test_message_parser_provisioned_contexts (void)
 {
@@ -794,6 +1104,20 @@ test_message_parser_sms_read_single_pdu (void)
                         sizeof (expected_pdu));
     g_assert_cmpuint (pdu_messages[0]->pdu_data_size, ==, sizeof (expected_pdu));
     g_assert (memcmp (pdu_messages[0]->pdu_data, expected_pdu, sizeof (expected_pdu)) == 0);
+
+    /* Only the PDU messages are available with the PDU format */
+    test_message_printable (response,
+                            "  Format = '0'\n"
+                            "  MessagesCount = '1'\n"
+                            "  PduMessages = '{\n"
+                            "    [0] = {\n"
+                            "          MessageIndex = '7'\n"
+                            "          MessageStatus = '3'\n"
+                            "          PduData = '01:02:03:04:05:06:07:08:09:0a:0b:0c:0d:0e:0f:00'\n"
+                            "    },\n"
+                            "  }'\n"
+                            "  CdmaMessages = \n",
+                            NULL);
 }
 
 static void
@@ -1788,11 +2112,16 @@ int main (int argc, char **argv)
     g_test_init (&argc, &argv, NULL);
 
     g_test_add_func ("/libmbim-glib/message/parser/basic-connect/visible-providers", test_message_parser_basic_connect_visible_providers);
+    g_test_add_func ("/libmbim-glib/message/parser/basic-connect/visible-providers/arena", test_message_parser_basic_connect_visible_providers_arena);
+    g_test_add_func ("/libmbim-glib/message/parser/basic-connect/visible-providers/overflow", test_message_parser_basic_connect_visible_providers_overflow);
+    g_test_add_func ("/libmbim-glib/message/parser/basic-connect/visible-providers/iter", test_message_parser_basic_connect_visible_providers_iter);
     g_test_add_func ("/libmbim-glib/message/parser/basic-connect/subscriber-ready-status", test_message_parser_basic_connect_subscriber_ready_status);
+    g_test_add_func ("/libmbim-glib/message/parser/basic-connect/subscriber-ready-status/truncated", test_message_parser_basic_connect_subscriber_ready_status_truncated);
     g_test_add_func ("/libmbim-glib/message/parser/basic-connect/device-caps", test_message_parser_basic_connect_device_caps);
     g_test_add_func ("/libmbim-glib/message/parser/basic-connect/ip-configuration", test_message_parser_basic_connect_ip_configuration);
     g_test_add_func ("/libmbim-glib/message/parser/basic-connect/service-activation", test_message_parser_basic_connect_service_activation);
     g_test_add_func ("/libmbim-glib/message/parser/basic-connect/register-state", test_message_parser_basic_connect_register_state);
+    g_test_add_func ("/libmbim-glib/message/parser/basic-connect/register-state/accessors", test_message_parser_basic_connect_register_state_accessors);
     g_test_add_func ("/libmbim-glib/message/parser/basic-connect/provisioned-contexts", test_message_parser_provisioned_contexts);
     g_test_add_func ("/libmbim-glib/message/parser/sms/read/zero-pdu", test_message_parser_sms_read_zero_pdu);
     g_test_add_func ("/libmbim-glib/message/parser/sms/read/single-pdu", test_message_parser_sms_read_single_pdu);
@@ -17,6 +17,7 @@
 #include <string.h>
 
 #include "mbim-message.h"
+#include "mbim-message-private.h"
 #include "mbim-cid.h"
 
 static void
@@ -178,6 +179,51 @@ test_message_command_custom_service (void)
     mbim_message_unref (message);
 }
 
+static void
+test_message_command_read_string (void)
+{
+    MbimMessage *message;
+    gchar *str;
+    GError *error = NULL;
+    const guint8 information_buffer [] = {
+        /* offset/size pairs */
+        0x18, 0x00, 0x00, 0x00, 0x18, 0x00, 0x00, 0x00,
+        0x30, 0x00, 0x00, 0x00, 0x06, 0x00, 0x00, 0x00,
+        0x38, 0x00, 0x00, 0x00, 0x08, 0x00, 0x00, 0x00,
+        /* "internet.apn", ASCII, 3 full chunks */
+        0x69, 0x00, 0x6E, 0x00, 0x74, 0x00, 0x65, 0x00,
+        0x72, 0x00, 0x6E, 0x00, 0x65, 0x00, 0x74, 0x00,
+        0x2E, 0x00, 0x61, 0x00, 0x70, 0x00, 0x6E, 0x00,
+        /* "abc", ASCII, no full chunk; plus padding */
+        0x61, 0x00, 0x62, 0x00, 0x63, 0x00, 0x00, 0x00,
+        /* "ca\u00F1a", not ASCII */
+        0x63, 0x00, 0x61, 0x00, 0xF1, 0x00, 0x61, 0x00
+    };
+
+    message = mbim_message_command_new (1,
+                                        MBIM_SERVICE_BASIC_CONNECT,
+                                        MBIM_CID_BASIC_CONNECT_HOME_PROVIDER,
+                                        MBIM_MESSAGE_COMMAND_TYPE_QUERY);
+    mbim_message_command_append (message, information_buffer, sizeof (information_buffer));
+
+    g_assert (_mbim_message_read_string (message, 0, 0, &str, &error));
+    g_assert_no_error (error);
+    g_assert_cmpstr (str, ==, "internet.apn");
+    g_free (str);
+
+    g_assert (_mbim_message_read_string (message, 0, 8, &str, &error));
+    g_assert_no_error (error);
+    g_assert_cmpstr (str, ==, "abc");
+    g_free (str);
+
+    g_assert (_mbim_message_read_string (message, 0, 16, &str, &error));
+    g_assert_no_error (error);
+    g_assert_cmpstr (str, ==, "ca\xC3\xB1" "a");
+    g_free (str);
+
+    mbim_message_unref (message);
+}
+
 static void
 test_message_command_done (void)
 {
@@ -232,6 +278,7 @@ int main (int argc, char **argv)
     g_test_add_func ("/libmbim-glib/message/command/empty",          test_message_command_empty);
     g_test_add_func ("/libmbim-glib/message/command/not-empty",      test_message_command_not_empty);
     g_test_add_func ("/libmbim-glib/message/command/custom-service", test_message_command_custom_service);
+    g_test_add_func ("/libmbim-glib/message/command/read-string",    test_message_command_read_string);
     g_test_add_func ("/libmbim-glib/message/command-done",           test_message_command_done);
 
     return g_test_run ();
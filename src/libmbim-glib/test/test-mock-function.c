@@ -0,0 +1,1835 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details:
+ *
+ * Copyright (C) 2026 agent <agent@local>
+ */
+
+#include <config.h>
+#include <string.h>
+#include <gio/gio.h>
+
+#include "mbim-device.h"
+#include "mbim-proxy.h"
+#include "mbim-cid.h"
+#include "mbim-basic-connect.h"
+#include "mbim-proxy-control.h"
+#include "mbim-error-types.h"
+#include "mbim-mock-function.h"
+
+#define TIMEOUT_SECS 5
+
+/*****************************************************************************/
+
+typedef struct {
+    GMainLoop        *loop;
+    GAsyncResult     *result;
+    MbimMockFunction *mock;
+    MbimProxy        *proxy;
+    MbimDevice       *device;
+    guint             n_indications;
+    guint             n_expected_indications;
+    gboolean          sentinel_received;
+    gint              n_pending_workers;
+} TestContext;
+
+static void
+async_ready (GObject      *source,
+             GAsyncResult *res,
+             TestContext  *ctx)
+{
+    ctx->result = g_object_ref (res);
+    g_main_loop_quit (ctx->loop);
+}
+
+static GAsyncResult *
+wait_result (TestContext *ctx)
+{
+    g_main_loop_run (ctx->loop);
+    g_assert (ctx->result);
+    return ctx->result;
+}
+
+typedef gboolean (* WaitConditionFunc) (gpointer user_data);
+
+static gboolean
+wait_timeout_cb (gboolean *timed_out)
+{
+    *timed_out = TRUE;
+    return G_SOURCE_REMOVE;
+}
+
+/* Iterates the main context until the condition is met, checking it again
+ * after every event dispatched. The timeout is just a safety net, so that a
+ * test fails instead of hanging when the event never happens. */
+static void
+wait_until (WaitConditionFunc condition,
+            gpointer          user_data)
+{
+    gboolean timed_out = FALSE;
+    guint    timeout_id;
+
+    timeout_id = g_timeout_add_seconds (TIMEOUT_SECS, (GSourceFunc) wait_timeout_cb, &timed_out);
+    while (!condition (user_data)) {
+        g_assert (!timed_out);
+        g_main_context_iteration (NULL, TRUE);
+    }
+    if (!timed_out)
+        g_source_remove (timeout_id);
+}
+
+static void
+command_ready (MbimDevice    *device,
+               GAsyncResult  *res,
+               GAsyncResult **out_result)
+{
+    *out_result = g_object_ref (res);
+}
+
+static gboolean
+command_result_received (GAsyncResult **result)
+{
+    return (*result != NULL);
+}
+
+static void
+wait_command_result (GAsyncResult **result)
+{
+    wait_until ((WaitConditionFunc) command_result_received, result);
+}
+
+static guint64
+get_device_counter (MbimDevice  *device,
+                    const gchar *key)
+{
+    g_autoptr(GVariant) stats = NULL;
+    guint64             value = 0;
+
+    stats = mbim_device_get_statistics (device);
+    g_assert (g_variant_lookup (stats, key, "t", &value));
+    return value;
+}
+
+static MbimDevice *
+test_context_device_new (TestContext         *ctx,
+                         MbimDeviceOpenFlags  open_flags,
+                         guint                proxy_command_timeout)
+{
+    g_autoptr(GError) error = NULL;
+    g_autoptr(GFile)  file = NULL;
+    MbimDevice       *device;
+
+    file = g_file_new_for_path (mbim_mock_function_get_path (ctx->mock));
+    mbim_device_new (file, NULL, (GAsyncReadyCallback) async_ready, ctx);
+    device = mbim_device_new_finish (wait_result (ctx), &error);
+    g_clear_object (&ctx->result);
+    g_assert_no_error (error);
+    g_assert (device);
+
+    mbim_device_set_proxy_command_timeout (device, proxy_command_timeout);
+    mbim_device_open_full (device, open_flags, TIMEOUT_SECS, NULL, (GAsyncReadyCallback) async_ready, ctx);
+    g_assert (mbim_device_open_full_finish (device, wait_result (ctx), &error));
+    g_clear_object (&ctx->result);
+    g_assert_no_error (error);
+    return device;
+}
+
+static gboolean
+test_context_setup_full (TestContext    *ctx,
+                         gboolean        use_proxy,
+                         MbimProxyFlags  proxy_flags,
+                         guint           proxy_command_timeout)
+{
+    g_autoptr(GError) error = NULL;
+
+    memset (ctx, 0, sizeof (TestContext));
+
+    ctx->mock = mbim_mock_function_new (&error);
+    if (!ctx->mock) {
+        g_test_skip (error->message);
+        return FALSE;
+    }
+
+    /* The proxy runs in this same process and main context, and the device
+     * is opened through it */
+    if (use_proxy) {
+        ctx->proxy = mbim_proxy_new_full (proxy_flags, &error);
+        if (!ctx->proxy) {
+            g_test_skip (error->message);
+            mbim_mock_function_free (ctx->mock);
+            return FALSE;
+        }
+    }
+
+    ctx->loop = g_main_loop_new (NULL, FALSE);
+    ctx->device = test_context_device_new (ctx,
+                                           use_proxy ? MBIM_DEVICE_OPEN_FLAGS_PROXY : MBIM_DEVICE_OPEN_FLAGS_NONE,
+                                           proxy_command_timeout);
+    return TRUE;
+}
+
+static gboolean
+test_context_setup (TestContext *ctx)
+{
+    return test_context_setup_full (ctx, FALSE, MBIM_PROXY_FLAGS_NONE, 0);
+}
+
+static void
+test_context_teardown (TestContext *ctx)
+{
+    g_autoptr(GError) error = NULL;
+
+    mbim_device_close (ctx->device, TIMEOUT_SECS, NULL, (GAsyncReadyCallback) async_ready, ctx);
+    g_assert (mbim_device_close_finish (ctx->device, wait_result (ctx), &error));
+    g_clear_object (&ctx->result);
+    g_assert_no_error (error);
+
+    g_object_unref (ctx->device);
+    g_clear_object (&ctx->proxy);
+    mbim_mock_function_free (ctx->mock);
+    g_main_loop_unref (ctx->loop);
+}
+
+/*****************************************************************************/
+
+static void
+test_mock_function_open_close (void)
+{
+    TestContext ctx;
+
+    if (!test_context_setup (&ctx))
+        return;
+
+    g_assert (mbim_device_is_open (ctx.device));
+    test_context_teardown (&ctx);
+}
+
+/*****************************************************************************/
+
+static const guint8 radio_state_buffer[] = {
+    0x01, 0x00, 0x00, 0x00, /* hw radio state: on */
+    0x00, 0x00, 0x00, 0x00, /* sw radio state: off */
+};
+
+static void
+run_radio_state_query (TestContext *ctx)
+{
+    g_autoptr(GError)      error = NULL;
+    g_autoptr(MbimMessage) request = NULL;
+    g_autoptr(MbimMessage) response = NULL;
+    MbimRadioSwitchState   hw_radio_state;
+    MbimRadioSwitchState   sw_radio_state;
+
+    request = mbim_message_radio_state_query_new (NULL);
+    mbim_device_command (ctx->device, request, TIMEOUT_SECS, NULL, (GAsyncReadyCallback) async_ready, ctx);
+    response = mbim_device_command_finish (ctx->device, wait_result (ctx), &error);
+    g_clear_object (&ctx->result);
+    g_assert_no_error (error);
+    g_assert (response);
+
+    g_assert (mbim_message_response_get_result (response, MBIM_MESSAGE_TYPE_COMMAND_DONE, &error));
+    g_assert_no_error (error);
+    g_assert (mbim_message_radio_state_response_parse (response, &hw_radio_state, &sw_radio_state, &error));
+    g_assert_no_error (error);
+    g_assert_cmpuint (hw_radio_state, ==, MBIM_RADIO_SWITCH_STATE_ON);
+    g_assert_cmpuint (sw_radio_state, ==, MBIM_RADIO_SWITCH_STATE_OFF);
+}
+
+static void
+test_mock_function_response (void)
+{
+    TestContext ctx;
+
+    if (!test_context_setup (&ctx))
+        return;
+
+    mbim_mock_function_add_response (ctx.mock,
+                                     MBIM_UUID_BASIC_CONNECT,
+                                     MBIM_CID_BASIC_CONNECT_RADIO_STATE,
+                                     MBIM_STATUS_ERROR_NONE,
+                                     radio_state_buffer,
+                                     sizeof (radio_state_buffer));
+    run_radio_state_query (&ctx);
+    g_assert_cmpuint (mbim_mock_function_get_n_commands (ctx.mock), ==, 1);
+
+    test_context_teardown (&ctx);
+}
+
+static void
+test_mock_function_response_fragmented (void)
+{
+    TestContext ctx;
+
+    if (!test_context_setup (&ctx))
+        return;
+
+    mbim_mock_function_add_response (ctx.mock,
+                                     MBIM_UUID_BASIC_CONNECT,
+                                     MBIM_CID_BASIC_CONNECT_RADIO_STATE,
+                                     MBIM_STATUS_ERROR_NONE,
+                                     radio_state_buffer,
+                                     sizeof (radio_state_buffer));
+    mbim_mock_function_set_n_fragments (ctx.mock, 3);
+    mbim_mock_function_set_latency (ctx.mock, 10);
+    run_radio_state_query (&ctx);
+    run_radio_state_query (&ctx);
+    g_assert_cmpuint (mbim_mock_function_get_n_commands (ctx.mock), ==, 2);
+
+    test_context_teardown (&ctx);
+}
+
+/*****************************************************************************/
+
+#define N_WORKERS 4
+
+typedef struct {
+    TestContext  *ctx;
+    GThread      *thread;
+    GMainContext *context;
+    GAsyncResult *result;
+} WorkerContext;
+
+static void
+worker_async_ready (GObject       *source,
+                    GAsyncResult  *res,
+                    WorkerContext *worker)
+{
+    /* Completed in the worker context, not in the device one */
+    g_assert (g_main_context_is_owner (worker->context));
+    worker->result = g_object_ref (res);
+}
+
+static gpointer
+worker_thread_func (WorkerContext *worker)
+{
+    g_autoptr(GError)      error = NULL;
+    g_autoptr(MbimMessage) request = NULL;
+    g_autoptr(MbimMessage) response = NULL;
+
+    g_main_context_push_thread_default (worker->context);
+
+    request = mbim_message_radio_state_query_new (NULL);
+    mbim_device_command_threadsafe (worker->ctx->device, request, TIMEOUT_SECS, NULL,
+                                    (GAsyncReadyCallback) worker_async_ready, worker);
+    while (!worker->result)
+        g_main_context_iteration (worker->context, TRUE);
+
+    response = mbim_device_command_threadsafe_finish (worker->ctx->device, worker->result, &error);
+    g_clear_object (&worker->result);
+    g_assert_no_error (error);
+    g_assert (response);
+    g_assert (mbim_message_response_get_result (response, MBIM_MESSAGE_TYPE_COMMAND_DONE, &error));
+    g_assert_no_error (error);
+
+    g_main_context_pop_thread_default (worker->context);
+
+    if (g_atomic_int_dec_and_test (&worker->ctx->n_pending_workers))
+        g_main_loop_quit (worker->ctx->loop);
+    return NULL;
+}
+
+static void
+test_mock_function_command_threadsafe (void)
+{
+    TestContext   ctx;
+    WorkerContext workers[N_WORKERS];
+    guint         i;
+
+    if (!test_context_setup (&ctx))
+        return;
+
+    mbim_mock_function_add_response (ctx.mock,
+                                     MBIM_UUID_BASIC_CONNECT,
+                                     MBIM_CID_BASIC_CONNECT_RADIO_STATE,
+                                     MBIM_STATUS_ERROR_NONE,
+                                     radio_state_buffer,
+                                     sizeof (radio_state_buffer));
+
+    ctx.n_pending_workers = N_WORKERS;
+    for (i = 0; i < N_WORKERS; i++) {
+        workers[i].ctx = &ctx;
+        workers[i].context = g_main_context_new ();
+        workers[i].result = NULL;
+        workers[i].thread = g_thread_new ("worker", (GThreadFunc) worker_thread_func, &workers[i]);
+    }
+
+    /* The commands are processed in the context where the device was opened */
+    g_main_loop_run (ctx.loop);
+
+    for (i = 0; i < N_WORKERS; i++) {
+        g_thread_join (workers[i].thread);
+        g_main_context_unref (workers[i].context);
+    }
+    g_assert_cmpuint (mbim_mock_function_get_n_commands (ctx.mock), ==, N_WORKERS);
+
+    test_context_teardown (&ctx);
+}
+
+/*****************************************************************************/
+
+/* Sent after the indications under test, so that once received all of those
+ * are known to have been received as well */
+#define SENTINEL_CID MBIM_CID_BASIC_CONNECT_SIGNAL_STATE
+
+static void
+indication_cb (MbimDevice  *device,
+               MbimMessage *message,
+               TestContext *ctx)
+{
+    if (mbim_message_indicate_status_get_cid (message) == SENTINEL_CID) {
+        ctx->sentinel_received = TRUE;
+        return;
+    }
+
+    g_assert_cmpuint (mbim_message_indicate_status_get_cid (message), ==, MBIM_CID_BASIC_CONNECT_RADIO_STATE);
+    if (++ctx->n_indications == ctx->n_expected_indications)
+        g_main_loop_quit (ctx->loop);
+}
+
+static gboolean
+expected_indications_received (TestContext *ctx)
+{
+    return (ctx->n_indications >= ctx->n_expected_indications);
+}
+
+static gboolean
+sentinel_received (TestContext *ctx)
+{
+    return ctx->sentinel_received;
+}
+
+static void
+send_sentinel_indication (TestContext *ctx)
+{
+    /* Always written by the mock after anything requested before */
+    ctx->sentinel_received = FALSE;
+    mbim_mock_function_send_indication (ctx->mock,
+                                        MBIM_UUID_BASIC_CONNECT,
+                                        SENTINEL_CID,
+                                        radio_state_buffer,
+                                        sizeof (radio_state_buffer));
+}
+
+static void
+test_mock_function_indications (void)
+{
+    TestContext ctx;
+    gulong      handler_id;
+
+    if (!test_context_setup (&ctx))
+        return;
+
+    handler_id = g_signal_connect (ctx.device,
+                                   MBIM_DEVICE_SIGNAL_INDICATE_STATUS,
+                                   G_CALLBACK (indication_cb),
+                                   &ctx);
+
+    /* A burst sent all at once, and then the same at a given rate */
+    ctx.n_expected_indications = 50;
+    mbim_mock_function_start_indications (ctx.mock,
+                                          MBIM_UUID_BASIC_CONNECT,
+                                          MBIM_CID_BASIC_CONNECT_RADIO_STATE,
+                                          radio_state_buffer,
+                                          sizeof (radio_state_buffer),
+                                          0, 50);
+    g_main_loop_run (ctx.loop);
+    g_assert_cmpuint (ctx.n_indications, ==, 50);
+
+    ctx.n_expected_indications = 100;
+    mbim_mock_function_start_indications (ctx.mock,
+                                          MBIM_UUID_BASIC_CONNECT,
+                                          MBIM_CID_BASIC_CONNECT_RADIO_STATE,
+                                          radio_state_buffer,
+                                          sizeof (radio_state_buffer),
+                                          500, 50);
+    g_main_loop_run (ctx.loop);
+    g_assert_cmpuint (ctx.n_indications, ==, 100);
+
+    g_signal_handler_disconnect (ctx.device, handler_id);
+    test_context_teardown (&ctx);
+}
+
+static void
+append_uint32 (GByteArray *array,
+               guint32     value)
+{
+    value = GUINT32_TO_LE (value);
+    g_byte_array_append (array, (const guint8 *) &value, sizeof (value));
+}
+
+static void
+test_mock_function_resync (void)
+{
+    static const guint8 garbage[] = { 0xDE, 0xAD, 0xBE, 0xEF, 0x07, 0x00, 0x00 };
+    g_autoptr(GByteArray) raw = NULL;
+    TestContext           ctx;
+    gulong                handler_id;
+
+    if (!test_context_setup (&ctx))
+        return;
+
+    handler_id = g_signal_connect (ctx.device,
+                                   MBIM_DEVICE_SIGNAL_INDICATE_STATUS,
+                                   G_CALLBACK (indication_cb),
+                                   &ctx);
+
+    /* Garbage followed by a valid indication, written all at once */
+    raw = g_byte_array_new ();
+    g_byte_array_append (raw, garbage, sizeof (garbage));
+    append_uint32 (raw, MBIM_MESSAGE_TYPE_INDICATE_STATUS);
+    append_uint32 (raw, 44 + sizeof (radio_state_buffer));
+    append_uint32 (raw, 0); /* transaction id */
+    append_uint32 (raw, 1); /* fragment total */
+    append_uint32 (raw, 0); /* fragment current */
+    g_byte_array_append (raw, (const guint8 *) MBIM_UUID_BASIC_CONNECT, sizeof (MbimUuid));
+    append_uint32 (raw, MBIM_CID_BASIC_CONNECT_RADIO_STATE);
+    append_uint32 (raw, sizeof (radio_state_buffer));
+    g_byte_array_append (raw, radio_state_buffer, sizeof (radio_state_buffer));
+
+    ctx.n_expected_indications = 1;
+    mbim_mock_function_send_raw (ctx.mock, raw->data, raw->len);
+    wait_until ((WaitConditionFunc) expected_indications_received, &ctx);
+    g_assert_cmpuint (ctx.n_indications, ==, 1);
+
+    /* The stream is still usable afterwards */
+    mbim_mock_function_add_response (ctx.mock,
+                                     MBIM_UUID_BASIC_CONNECT,
+                                     MBIM_CID_BASIC_CONNECT_RADIO_STATE,
+                                     MBIM_STATUS_ERROR_NONE,
+                                     radio_state_buffer,
+                                     sizeof (radio_state_buffer));
+    run_radio_state_query (&ctx);
+
+    g_signal_handler_disconnect (ctx.device, handler_id);
+    test_context_teardown (&ctx);
+}
+
+static void
+test_mock_function_indication_coalesce (void)
+{
+    TestContext ctx;
+    gulong      handler_id;
+    guint64     indications;
+
+    if (!test_context_setup (&ctx))
+        return;
+
+    handler_id = g_signal_connect (ctx.device,
+                                   MBIM_DEVICE_SIGNAL_INDICATE_STATUS,
+                                   G_CALLBACK (indication_cb),
+                                   &ctx);
+
+    /* An interval that never ends while the test runs... */
+    mbim_device_set_indication_policy (ctx.device,
+                                       MBIM_UUID_BASIC_CONNECT,
+                                       MBIM_CID_BASIC_CONNECT_RADIO_STATE,
+                                       MBIM_INDICATION_POLICY_COALESCE,
+                                       3600 * 1000, 0);
+
+    /* ...so that a whole burst is held back... */
+    ctx.n_expected_indications = G_MAXUINT;
+    indications = get_device_counter (ctx.device, "indications");
+    mbim_mock_function_start_indications (ctx.mock,
+                                          MBIM_UUID_BASIC_CONNECT,
+                                          MBIM_CID_BASIC_CONNECT_RADIO_STATE,
+                                          radio_state_buffer,
+                                          sizeof (radio_state_buffer),
+                                          0, 50);
+    send_sentinel_indication (&ctx);
+    wait_until ((WaitConditionFunc) sentinel_received, &ctx);
+    g_assert_cmpuint (get_device_counter (ctx.device, "indications") - indications, ==, 51);
+    g_assert_cmpuint (ctx.n_indications, ==, 0);
+
+    /* ...and emitted as one single indication when the policy is removed */
+    mbim_device_set_indication_policy (ctx.device,
+                                       MBIM_UUID_BASIC_CONNECT,
+                                       MBIM_CID_BASIC_CONNECT_RADIO_STATE,
+                                       MBIM_INDICATION_POLICY_NONE,
+                                       0, 0);
+    g_assert_cmpuint (ctx.n_indications, ==, 1);
+
+    /* Also when the interval ends */
+    mbim_device_set_indication_policy (ctx.device,
+                                       MBIM_UUID_BASIC_CONNECT,
+                                       MBIM_CID_BASIC_CONNECT_RADIO_STATE,
+                                       MBIM_INDICATION_POLICY_COALESCE,
+                                       100, 0);
+    ctx.n_expected_indications = 2;
+    mbim_mock_function_start_indications (ctx.mock,
+                                          MBIM_UUID_BASIC_CONNECT,
+                                          MBIM_CID_BASIC_CONNECT_RADIO_STATE,
+                                          radio_state_buffer,
+                                          sizeof (radio_state_buffer),
+                                          0, 50);
+    wait_until ((WaitConditionFunc) expected_indications_received, &ctx);
+
+    g_signal_handler_disconnect (ctx.device, handler_id);
+    test_context_teardown (&ctx);
+}
+
+static void
+test_mock_function_indication_rate_limit (void)
+{
+    TestContext ctx;
+    gulong      handler_id;
+
+    if (!test_context_setup (&ctx))
+        return;
+
+    handler_id = g_signal_connect (ctx.device,
+                                   MBIM_DEVICE_SIGNAL_INDICATE_STATUS,
+                                   G_CALLBACK (indication_cb),
+                                   &ctx);
+
+    mbim_device_set_indication_policy (ctx.device,
+                                       MBIM_UUID_BASIC_CONNECT,
+                                       MBIM_CID_BASIC_CONNECT_RADIO_STATE,
+                                       MBIM_INDICATION_POLICY_RATE_LIMIT,
+                                       1000, 5);
+
+    /* The first ones of a burst received well within the interval are
+     * emitted right away, up to the burst size... */
+    ctx.n_expected_indications = G_MAXUINT;
+    mbim_mock_function_start_indications (ctx.mock,
+                                          MBIM_UUID_BASIC_CONNECT,
+                                          MBIM_CID_BASIC_CONNECT_RADIO_STATE,
+                                          radio_state_buffer,
+                                          sizeof (radio_state_buffer),
+                                          0, 50);
+    send_sentinel_indication (&ctx);
+    wait_until ((WaitConditionFunc) sentinel_received, &ctx);
+    g_assert_cmpuint (ctx.n_indications, ==, 5);
+
+    /* ...and the latest one once the next token is available */
+    ctx.n_expected_indications = 6;
+    wait_until ((WaitConditionFunc) expected_indications_received, &ctx);
+    g_assert_cmpuint (ctx.n_indications, ==, 6);
+
+    g_signal_handler_disconnect (ctx.device, handler_id);
+    test_context_teardown (&ctx);
+}
+
+/*****************************************************************************/
+
+static const guint8 subscriber_ready_status_buffer[] = {
+    0x01, 0x00, 0x00, 0x00, /* ready state: initialized */
+    0x00, 0x00, 0x00, 0x00, /* subscriber id: offset */
+    0x00, 0x00, 0x00, 0x00, /* subscriber id: size */
+    0x00, 0x00, 0x00, 0x00, /* sim icc id: offset */
+    0x00, 0x00, 0x00, 0x00, /* sim icc id: size */
+    0x00, 0x00, 0x00, 0x00, /* ready info */
+    0x00, 0x00, 0x00, 0x00, /* telephone numbers count */
+};
+
+static const guint8 packet_service_buffer[] = {
+    0x00, 0x00, 0x00, 0x00, /* nw error */
+    0x00, 0x00, 0x00, 0x00, /* packet service state: set in each test */
+    0x00, 0x00, 0x00, 0x00, /* highest available data class */
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, /* uplink speed */
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, /* downlink speed */
+};
+
+static const guint8 connect_buffer[] = {
+    0x00, 0x00, 0x00, 0x00, /* session id */
+    0x01, 0x00, 0x00, 0x00, /* activation state: activated */
+    0x00, 0x00, 0x00, 0x00, /* voice call state */
+    0x01, 0x00, 0x00, 0x00, /* ip type: ipv4 */
+    0x7E, 0x5E, 0x2A, 0x7E, 0x4E, 0x6F, 0x72, 0x72, /* context type: internet */
+    0x73, 0x6B, 0x65, 0x6E, 0x7E, 0x5E, 0x2A, 0x7E,
+    0x00, 0x00, 0x00, 0x00, /* nw error */
+};
+
+static const guint8 ip_configuration_buffer[60] = { 0 };
+
+static guint8 *
+register_state_buffer_new (MbimRegisterState  register_state,
+                           gsize             *out_size)
+{
+    guint8 *buffer;
+
+    /* nw error, register state, register mode, available data classes,
+     * current cellular class, 3 empty strings and registration flag */
+    *out_size = 48;
+    buffer = g_malloc0 (*out_size);
+    buffer[4] = (guint8) register_state;
+    return buffer;
+}
+
+static void
+add_connect_responses (TestContext            *ctx,
+                       MbimRegisterState       register_state,
+                       MbimPacketServiceState  packet_service_state)
+{
+    g_autofree guint8 *register_state_buffer = NULL;
+    gsize              register_state_buffer_size;
+    guint8             packet_service_state_buffer[sizeof (packet_service_buffer)];
+
+    register_state_buffer = register_state_buffer_new (register_state, &register_state_buffer_size);
+    memcpy (packet_service_state_buffer, packet_service_buffer, sizeof (packet_service_buffer));
+    packet_service_state_buffer[4] = (guint8) packet_service_state;
+
+    mbim_mock_function_add_response (ctx->mock, MBIM_UUID_BASIC_CONNECT, MBIM_CID_BASIC_CONNECT_SUBSCRIBER_READY_STATUS,
+                                     MBIM_STATUS_ERROR_NONE, subscriber_ready_status_buffer, sizeof (subscriber_ready_status_buffer));
+    mbim_mock_function_add_response (ctx->mock, MBIM_UUID_BASIC_CONNECT, MBIM_CID_BASIC_CONNECT_REGISTER_STATE,
+                                     MBIM_STATUS_ERROR_NONE, register_state_buffer, register_state_buffer_size);
+    mbim_mock_function_add_response (ctx->mock, MBIM_UUID_BASIC_CONNECT, MBIM_CID_BASIC_CONNECT_PACKET_SERVICE,
+                                     MBIM_STATUS_ERROR_NONE, packet_service_state_buffer, sizeof (packet_service_state_buffer));
+    mbim_mock_function_add_response (ctx->mock, MBIM_UUID_BASIC_CONNECT, MBIM_CID_BASIC_CONNECT_CONNECT,
+                                     MBIM_STATUS_ERROR_NONE, connect_buffer, sizeof (connect_buffer));
+    mbim_mock_function_add_response (ctx->mock, MBIM_UUID_BASIC_CONNECT, MBIM_CID_BASIC_CONNECT_IP_CONFIGURATION,
+                                     MBIM_STATUS_ERROR_NONE, ip_configuration_buffer, sizeof (ip_configuration_buffer));
+}
+
+static gboolean
+run_connect (TestContext  *ctx,
+             GError      **error)
+{
+    g_autoptr(MbimMessage) connect_response = NULL;
+    g_autoptr(MbimMessage) ip_configuration_response = NULL;
+    gboolean               success;
+
+    mbim_device_connect (ctx->device, 0, "internet", MBIM_AUTH_PROTOCOL_NONE, NULL, NULL, MBIM_CONTEXT_IP_TYPE_IPV4,
+                         TIMEOUT_SECS, NULL, (GAsyncReadyCallback) async_ready, ctx);
+    success = mbim_device_connect_finish (ctx->device, wait_result (ctx), &connect_response, &ip_configuration_response, error);
+    g_clear_object (&ctx->result);
+
+    if (success) {
+        g_assert (connect_response);
+        g_assert (ip_configuration_response);
+        g_assert_cmpuint (mbim_message_command_done_get_cid (connect_response), ==, MBIM_CID_BASIC_CONNECT_CONNECT);
+        g_assert_cmpuint (mbim_message_command_done_get_cid (ip_configuration_response), ==, MBIM_CID_BASIC_CONNECT_IP_CONFIGURATION);
+    }
+    return success;
+}
+
+static void
+test_mock_function_connect (void)
+{
+    g_autoptr(GError) error = NULL;
+    TestContext       ctx;
+
+    if (!test_context_setup (&ctx))
+        return;
+
+    /* Already attached: state queries, connect and IP configuration */
+    add_connect_responses (&ctx, MBIM_REGISTER_STATE_HOME, MBIM_PACKET_SERVICE_STATE_ATTACHED);
+    g_assert (run_connect (&ctx, &error));
+    g_assert_no_error (error);
+    g_assert_cmpuint (mbim_mock_function_get_n_commands (ctx.mock), ==, 5);
+
+    test_context_teardown (&ctx);
+}
+
+static void
+test_mock_function_connect_attach (void)
+{
+    g_autoptr(GError) error = NULL;
+    TestContext       ctx;
+
+    if (!test_context_setup (&ctx))
+        return;
+
+    /* Detached: the attach request goes before the connect one */
+    add_connect_responses (&ctx, MBIM_REGISTER_STATE_ROAMING, MBIM_PACKET_SERVICE_STATE_DETACHED);
+    g_assert (run_connect (&ctx, &error));
+    g_assert_no_error (error);
+    g_assert_cmpuint (mbim_mock_function_get_n_commands (ctx.mock), ==, 6);
+
+    test_context_teardown (&ctx);
+}
+
+static void
+test_mock_function_connect_not_registered (void)
+{
+    g_autoptr(GError) error = NULL;
+    TestContext       ctx;
+
+    if (!test_context_setup (&ctx))
+        return;
+
+    /* Nothing else is sent after the state queries */
+    add_connect_responses (&ctx, MBIM_REGISTER_STATE_SEARCHING, MBIM_PACKET_SERVICE_STATE_ATTACHED);
+    g_assert (!run_connect (&ctx, &error));
+    g_assert_error (error, MBIM_CORE_ERROR, MBIM_CORE_ERROR_WRONG_STATE);
+    g_assert_cmpuint (mbim_mock_function_get_n_commands (ctx.mock), ==, 3);
+
+    test_context_teardown (&ctx);
+}
+
+/*****************************************************************************/
+
+static guint32
+get_proxy_in_flight_requests (TestContext *ctx)
+{
+    g_autoptr(GError)                         error = NULL;
+    g_autoptr(MbimMessage)                    request = NULL;
+    g_autoptr(MbimMessage)                    response = NULL;
+    g_autoptr(MbimProxyDeviceStatisticsArray) devices = NULL;
+    guint32                                   devices_count = 0;
+
+    request = mbim_message_proxy_control_statistics_query_new (NULL);
+    mbim_device_command (ctx->device, request, TIMEOUT_SECS, NULL, (GAsyncReadyCallback) async_ready, ctx);
+    response = mbim_device_command_finish (ctx->device, wait_result (ctx), &error);
+    g_clear_object (&ctx->result);
+    g_assert_no_error (error);
+    g_assert (response);
+
+    g_assert (mbim_message_proxy_control_statistics_response_parse (response, &devices_count, &devices, NULL, NULL, &error));
+    g_assert_no_error (error);
+    g_assert_cmpuint (devices_count, ==, 1);
+    return devices[0]->in_flight_requests;
+}
+
+typedef struct {
+    TestContext *ctx;
+    guint32      expected;
+} InFlightRequestsContext;
+
+static gboolean
+proxy_in_flight_requests_match (InFlightRequestsContext *in_flight)
+{
+    return (get_proxy_in_flight_requests (in_flight->ctx) == in_flight->expected);
+}
+
+/* The proxy runs in this same main context, so the requests it forwards are
+ * checked again after each of its events, e.g. when they time out */
+static void
+wait_proxy_in_flight_requests (TestContext *ctx,
+                               guint32      expected)
+{
+    InFlightRequestsContext in_flight = { ctx, expected };
+
+    wait_until ((WaitConditionFunc) proxy_in_flight_requests_match, &in_flight);
+}
+
+static void
+wait_cancelled_command (MbimDevice    *device,
+                        GCancellable  *cancellable,
+                        GAsyncResult **result)
+{
+    g_autoptr(GError)      error = NULL;
+    g_autoptr(MbimMessage) response = NULL;
+
+    /* The transaction may be completed right away when cancelled */
+    g_cancellable_cancel (cancellable);
+    wait_command_result (result);
+    response = mbim_device_command_finish (device, *result, &error);
+    g_clear_object (result);
+    g_assert_error (error, MBIM_CORE_ERROR, MBIM_CORE_ERROR_ABORTED);
+    g_assert (!response);
+}
+
+static void
+test_mock_function_proxy_command_timeout (void)
+{
+    g_autoptr(MbimMessage)  request = NULL;
+    g_autoptr(GCancellable) cancellable = NULL;
+    GAsyncResult           *result = NULL;
+    TestContext             ctx;
+
+    /* The proxy waits just 1s for the responses of the commands it forwards */
+    if (!test_context_setup_full (&ctx, TRUE, MBIM_PROXY_FLAGS_NONE, 1))
+        return;
+
+    mbim_mock_function_add_response (ctx.mock, MBIM_UUID_BASIC_CONNECT, MBIM_CID_BASIC_CONNECT_RADIO_STATE,
+                                     MBIM_STATUS_ERROR_NONE, radio_state_buffer, sizeof (radio_state_buffer));
+
+    /* The device doesn't respond until told to */
+    mbim_mock_function_hold_responses (ctx.mock);
+
+    /* Sets are never coalesced, so this is forwarded as is */
+    cancellable = g_cancellable_new ();
+    request = mbim_message_radio_state_set_new (MBIM_RADIO_SWITCH_STATE_ON, NULL);
+    mbim_device_command (ctx.device, request, 2 * TIMEOUT_SECS, cancellable, (GAsyncReadyCallback) command_ready, &result);
+    wait_proxy_in_flight_requests (&ctx, 1);
+
+    /* Dropped by the proxy before the device responds */
+    wait_proxy_in_flight_requests (&ctx, 0);
+
+    /* The late response is not reported back by the proxy: the one of the
+     * next command, sent by the device right after it, is received first */
+    mbim_mock_function_release_responses (ctx.mock);
+    run_radio_state_query (&ctx);
+    g_assert (!result);
+
+    /* So the request stays pending in the client until cancelled */
+    wait_cancelled_command (ctx.device, cancellable, &result);
+
+    test_context_teardown (&ctx);
+}
+
+static void
+test_mock_function_proxy_untrack_client (void)
+{
+    g_autoptr(GError)       error = NULL;
+    g_autoptr(MbimMessage)  request = NULL;
+    g_autoptr(GCancellable) cancellable = NULL;
+    g_autoptr(MbimDevice)   other = NULL;
+    GAsyncResult           *result = NULL;
+    TestContext             ctx;
+
+    if (!test_context_setup_full (&ctx, TRUE, MBIM_PROXY_FLAGS_NONE, 0))
+        return;
+
+    /* A second client, which goes away with a request still in flight */
+    other = test_context_device_new (&ctx, MBIM_DEVICE_OPEN_FLAGS_PROXY, 0);
+    mbim_mock_function_hold_responses (ctx.mock);
+
+    cancellable = g_cancellable_new ();
+    request = mbim_message_radio_state_set_new (MBIM_RADIO_SWITCH_STATE_ON, NULL);
+    mbim_device_command (other, request, 2 * TIMEOUT_SECS, cancellable, (GAsyncReadyCallback) command_ready, &result);
+    wait_proxy_in_flight_requests (&ctx, 1);
+
+    g_assert (mbim_device_close_force (other, &error));
+    g_assert_no_error (error);
+
+    /* The request is cancelled in the proxy as soon as the client is gone,
+     * while the device still holds the response */
+    wait_proxy_in_flight_requests (&ctx, 0);
+    mbim_mock_function_release_responses (ctx.mock);
+
+    wait_cancelled_command (other, cancellable, &result);
+
+    test_context_teardown (&ctx);
+}
+
+#define N_COALESCED_REQUESTS 3
+
+static void
+wait_proxy_command_results (TestContext   *ctx,
+                            MbimMessage  **requests,
+                            GAsyncResult **results,
+                            guint          n_requests)
+{
+    guint i;
+
+    /* Responses are received in order, so the last one is received after
+     * all the others */
+    wait_command_result (&results[n_requests - 1]);
+    for (i = 0; i < n_requests; i++) {
+        g_autoptr(GError)      error = NULL;
+        g_autoptr(MbimMessage) response = NULL;
+
+        g_assert (results[i]);
+        response = mbim_device_command_finish (ctx->device, results[i], &error);
+        g_clear_object (&results[i]);
+        g_assert_no_error (error);
+        g_assert_cmpuint (mbim_message_get_transaction_id (response), ==, mbim_message_get_transaction_id (requests[i]));
+        g_assert_cmpuint (mbim_message_command_done_get_cid (response), ==, MBIM_CID_BASIC_CONNECT_RADIO_STATE);
+        g_assert_cmpuint (mbim_message_command_done_get_status_code (response), ==, MBIM_STATUS_ERROR_NONE);
+    }
+}
+
+static void
+test_mock_function_proxy_coalesce (void)
+{
+    g_autoptr(MbimMessage) command = NULL;
+    MbimMessage           *requests[N_COALESCED_REQUESTS];
+    GAsyncResult          *results[N_COALESCED_REQUESTS] = { NULL };
+    guint64                n_commands;
+    guint                  i;
+    TestContext            ctx;
+
+    if (!test_context_setup_full (&ctx, TRUE, MBIM_PROXY_FLAGS_NONE, 0))
+        return;
+
+    mbim_mock_function_add_response (ctx.mock, MBIM_UUID_BASIC_CONNECT, MBIM_CID_BASIC_CONNECT_RADIO_STATE,
+                                     MBIM_STATUS_ERROR_NONE, radio_state_buffer, sizeof (radio_state_buffer));
+
+    /* Identical queries received while the first one is still ongoing in the
+     * device all get its response */
+    n_commands = mbim_mock_function_get_n_commands (ctx.mock);
+    mbim_mock_function_hold_responses (ctx.mock);
+    for (i = 0; i < N_COALESCED_REQUESTS; i++) {
+        requests[i] = mbim_message_radio_state_query_new (NULL);
+        mbim_device_command (ctx.device, requests[i], TIMEOUT_SECS, NULL, (GAsyncReadyCallback) command_ready, &results[i]);
+    }
+    g_assert_cmpuint (get_proxy_in_flight_requests (&ctx), ==, N_COALESCED_REQUESTS);
+    mbim_mock_function_release_responses (ctx.mock);
+    wait_proxy_command_results (&ctx, requests, results, N_COALESCED_REQUESTS);
+    g_assert_cmpuint (mbim_mock_function_get_n_commands (ctx.mock), ==, n_commands + 1);
+    for (i = 0; i < N_COALESCED_REQUESTS; i++)
+        mbim_message_unref (requests[i]);
+
+    /* But not if a set was forwarded in between, as the state reported by
+     * the device may have changed since the first query was sent */
+    n_commands = mbim_mock_function_get_n_commands (ctx.mock);
+    mbim_mock_function_hold_responses (ctx.mock);
+    requests[0] = mbim_message_radio_state_query_new (NULL);
+    requests[1] = mbim_message_radio_state_set_new (MBIM_RADIO_SWITCH_STATE_ON, NULL);
+    requests[2] = mbim_message_radio_state_query_new (NULL);
+    for (i = 0; i < N_COALESCED_REQUESTS; i++)
+        mbim_device_command (ctx.device, requests[i], TIMEOUT_SECS, NULL, (GAsyncReadyCallback) command_ready, &results[i]);
+    g_assert_cmpuint (get_proxy_in_flight_requests (&ctx), ==, N_COALESCED_REQUESTS);
+    mbim_mock_function_release_responses (ctx.mock);
+    wait_proxy_command_results (&ctx, requests, results, N_COALESCED_REQUESTS);
+    g_assert_cmpuint (mbim_mock_function_get_n_commands (ctx.mock), ==, n_commands + N_COALESCED_REQUESTS);
+    for (i = 0; i < N_COALESCED_REQUESTS; i++)
+        mbim_message_unref (requests[i]);
+
+    /* And the last query reached the device after the set */
+    command = mbim_mock_function_get_last_command (ctx.mock);
+    g_assert (command);
+    g_assert_cmpuint (mbim_message_command_get_cid (command), ==, MBIM_CID_BASIC_CONNECT_RADIO_STATE);
+    g_assert_cmpuint (mbim_message_command_get_command_type (command), ==, MBIM_MESSAGE_COMMAND_TYPE_QUERY);
+
+    test_context_teardown (&ctx);
+}
+
+/*****************************************************************************/
+
+static MbimMessage *
+run_proxy_command (TestContext *ctx,
+                   MbimDevice  *device,
+                   MbimMessage *request)
+{
+    g_autoptr(GError)  error = NULL;
+    MbimMessage       *response;
+
+    mbim_device_command (device, request, TIMEOUT_SECS, NULL, (GAsyncReadyCallback) async_ready, ctx);
+    response = mbim_device_command_finish (device, wait_result (ctx), &error);
+    g_clear_object (&ctx->result);
+    g_assert_no_error (error);
+    g_assert (response);
+
+    /* Always sent back with the transaction id of the client request, even
+     * when not coming from the device */
+    g_assert_cmpuint (mbim_message_get_transaction_id (response), ==, mbim_message_get_transaction_id (request));
+    return response;
+}
+
+/* Returns the number of commands that reached the device */
+static guint64
+run_proxy_query (TestContext     *ctx,
+                 MbimDevice      *device,
+                 guint32          cid,
+                 MbimStatusError  expected_status)
+{
+    g_autoptr(MbimMessage) request = NULL;
+    g_autoptr(MbimMessage) response = NULL;
+    guint64                n_commands;
+
+    n_commands = mbim_mock_function_get_n_commands (ctx->mock);
+    request = mbim_message_command_new (0, MBIM_SERVICE_BASIC_CONNECT, cid, MBIM_MESSAGE_COMMAND_TYPE_QUERY);
+    response = run_proxy_command (ctx, device, request);
+    g_assert_cmpuint (mbim_message_command_done_get_cid (response), ==, cid);
+    g_assert_cmpuint (mbim_message_command_done_get_status_code (response), ==, expected_status);
+    return mbim_mock_function_get_n_commands (ctx->mock) - n_commands;
+}
+
+static void
+test_mock_function_proxy_state_cache_query (void)
+{
+    TestContext ctx;
+
+    if (!test_context_setup_full (&ctx, TRUE, MBIM_PROXY_FLAGS_STATE_CACHE, 0))
+        return;
+
+    mbim_mock_function_add_response (ctx.mock, MBIM_UUID_BASIC_CONNECT, MBIM_CID_BASIC_CONNECT_SUBSCRIBER_READY_STATUS,
+                                     MBIM_STATUS_ERROR_NONE, subscriber_ready_status_buffer, sizeof (subscriber_ready_status_buffer));
+
+    /* Only the first one goes to the device */
+    g_assert_cmpuint (run_proxy_query (&ctx, ctx.device, MBIM_CID_BASIC_CONNECT_SUBSCRIBER_READY_STATUS, MBIM_STATUS_ERROR_NONE), ==, 1);
+    g_assert_cmpuint (run_proxy_query (&ctx, ctx.device, MBIM_CID_BASIC_CONNECT_SUBSCRIBER_READY_STATUS, MBIM_STATUS_ERROR_NONE), ==, 0);
+    g_assert_cmpuint (run_proxy_query (&ctx, ctx.device, MBIM_CID_BASIC_CONNECT_SUBSCRIBER_READY_STATUS, MBIM_STATUS_ERROR_NONE), ==, 0);
+
+    test_context_teardown (&ctx);
+}
+
+static void
+test_mock_function_proxy_state_cache_set (void)
+{
+    g_autoptr(GError)        error = NULL;
+    g_autoptr(MbimMessage)   request = NULL;
+    g_autoptr(MbimMessage)   query = NULL;
+    g_autoptr(MbimMessage)   response = NULL;
+    g_autofree guint8       *register_state_buffer = NULL;
+    gsize                    register_state_buffer_size;
+    GAsyncResult            *set_result = NULL;
+    GAsyncResult            *query_result = NULL;
+    guint64                  n_commands;
+    TestContext              ctx;
+
+    if (!test_context_setup_full (&ctx, TRUE, MBIM_PROXY_FLAGS_STATE_CACHE, 0))
+        return;
+
+    register_state_buffer = register_state_buffer_new (MBIM_REGISTER_STATE_HOME, &register_state_buffer_size);
+    mbim_mock_function_add_response (ctx.mock, MBIM_UUID_BASIC_CONNECT, MBIM_CID_BASIC_CONNECT_REGISTER_STATE,
+                                     MBIM_STATUS_ERROR_NONE, register_state_buffer, register_state_buffer_size);
+
+    g_assert_cmpuint (run_proxy_query (&ctx, ctx.device, MBIM_CID_BASIC_CONNECT_REGISTER_STATE, MBIM_STATUS_ERROR_NONE), ==, 1);
+    g_assert_cmpuint (run_proxy_query (&ctx, ctx.device, MBIM_CID_BASIC_CONNECT_REGISTER_STATE, MBIM_STATUS_ERROR_NONE), ==, 0);
+
+    /* While the set is ongoing, which lasts until the device is told to
+     * respond, queries go to the device again */
+    n_commands = mbim_mock_function_get_n_commands (ctx.mock);
+    mbim_mock_function_hold_responses (ctx.mock);
+    request = mbim_message_register_state_set_new (NULL, MBIM_REGISTER_ACTION_AUTOMATIC, (MbimDataClass) 0, NULL);
+    mbim_device_command (ctx.device, request, TIMEOUT_SECS, NULL, (GAsyncReadyCallback) command_ready, &set_result);
+    query = mbim_message_register_state_query_new (NULL);
+    mbim_device_command (ctx.device, query, TIMEOUT_SECS, NULL, (GAsyncReadyCallback) command_ready, &query_result);
+    g_assert_cmpuint (get_proxy_in_flight_requests (&ctx), ==, 2);
+
+    mbim_mock_function_release_responses (ctx.mock);
+    wait_command_result (&query_result);
+    response = mbim_device_command_finish (ctx.device, query_result, &error);
+    g_object_unref (query_result);
+    g_assert_no_error (error);
+    g_assert_cmpuint (mbim_message_command_done_get_cid (response), ==, MBIM_CID_BASIC_CONNECT_REGISTER_STATE);
+    g_assert_cmpuint (mbim_message_command_done_get_status_code (response), ==, MBIM_STATUS_ERROR_NONE);
+    g_assert_cmpuint (mbim_mock_function_get_n_commands (ctx.mock), ==, n_commands + 2);
+    g_clear_pointer (&response, mbim_message_unref);
+
+    /* Responses are received in order, so the set one is already there */
+    g_assert (set_result);
+    response = mbim_device_command_finish (ctx.device, set_result, &error);
+    g_object_unref (set_result);
+    g_assert_no_error (error);
+    g_assert (mbim_message_response_get_result (response, MBIM_MESSAGE_TYPE_COMMAND_DONE, &error));
+    g_assert_no_error (error);
+
+    test_context_teardown (&ctx);
+}
+
+static void
+test_mock_function_proxy_state_cache_error (void)
+{
+    g_autoptr(MbimMessage)  request = NULL;
+    g_autoptr(MbimMessage)  response = NULL;
+    TestContext             ctx;
+
+    if (!test_context_setup_full (&ctx, TRUE, MBIM_PROXY_FLAGS_STATE_CACHE, 0))
+        return;
+
+    /* Errors are never kept */
+    mbim_mock_function_add_response (ctx.mock, MBIM_UUID_BASIC_CONNECT, MBIM_CID_BASIC_CONNECT_PACKET_SERVICE,
+                                     MBIM_STATUS_ERROR_FAILURE, NULL, 0);
+    g_assert_cmpuint (run_proxy_query (&ctx, ctx.device, MBIM_CID_BASIC_CONNECT_PACKET_SERVICE, MBIM_STATUS_ERROR_FAILURE), ==, 1);
+    g_assert_cmpuint (run_proxy_query (&ctx, ctx.device, MBIM_CID_BASIC_CONNECT_PACKET_SERVICE, MBIM_STATUS_ERROR_FAILURE), ==, 1);
+
+    mbim_mock_function_add_response (ctx.mock, MBIM_UUID_BASIC_CONNECT, MBIM_CID_BASIC_CONNECT_PACKET_SERVICE,
+                                     MBIM_STATUS_ERROR_NONE, packet_service_buffer, sizeof (packet_service_buffer));
+    g_assert_cmpuint (run_proxy_query (&ctx, ctx.device, MBIM_CID_BASIC_CONNECT_PACKET_SERVICE, MBIM_STATUS_ERROR_NONE), ==, 1);
+    g_assert_cmpuint (run_proxy_query (&ctx, ctx.device, MBIM_CID_BASIC_CONNECT_PACKET_SERVICE, MBIM_STATUS_ERROR_NONE), ==, 0);
+
+    /* And a failed set drops the state kept */
+    mbim_mock_function_add_response (ctx.mock, MBIM_UUID_BASIC_CONNECT, MBIM_CID_BASIC_CONNECT_PACKET_SERVICE,
+                                     MBIM_STATUS_ERROR_FAILURE, NULL, 0);
+    request = mbim_message_packet_service_set_new (MBIM_PACKET_SERVICE_ACTION_ATTACH, NULL);
+    response = run_proxy_command (&ctx, ctx.device, request);
+    g_assert_cmpuint (mbim_message_command_done_get_status_code (response), ==, MBIM_STATUS_ERROR_FAILURE);
+
+    mbim_mock_function_add_response (ctx.mock, MBIM_UUID_BASIC_CONNECT, MBIM_CID_BASIC_CONNECT_PACKET_SERVICE,
+                                     MBIM_STATUS_ERROR_NONE, packet_service_buffer, sizeof (packet_service_buffer));
+    g_assert_cmpuint (run_proxy_query (&ctx, ctx.device, MBIM_CID_BASIC_CONNECT_PACKET_SERVICE, MBIM_STATUS_ERROR_NONE), ==, 1);
+
+    test_context_teardown (&ctx);
+}
+
+static void
+test_mock_function_proxy_state_cache_reset (void)
+{
+    g_autoptr(GError)      error = NULL;
+    g_autoptr(MbimMessage) request = NULL;
+    g_autoptr(MbimMessage) response = NULL;
+    g_autoptr(MbimDevice)  other = NULL;
+    TestContext            ctx;
+
+    if (!test_context_setup_full (&ctx, TRUE, MBIM_PROXY_FLAGS_STATE_CACHE, 0))
+        return;
+
+    mbim_mock_function_add_response (ctx.mock, MBIM_UUID_BASIC_CONNECT, MBIM_CID_BASIC_CONNECT_SUBSCRIBER_READY_STATUS,
+                                     MBIM_STATUS_ERROR_NONE, subscriber_ready_status_buffer, sizeof (subscriber_ready_status_buffer));
+    g_assert_cmpuint (run_proxy_query (&ctx, ctx.device, MBIM_CID_BASIC_CONNECT_SUBSCRIBER_READY_STATUS, MBIM_STATUS_ERROR_NONE), ==, 1);
+    g_assert_cmpuint (run_proxy_query (&ctx, ctx.device, MBIM_CID_BASIC_CONNECT_SUBSCRIBER_READY_STATUS, MBIM_STATUS_ERROR_NONE), ==, 0);
+
+    /* The device reports it was reset when asked for something else, so the
+     * proxy closes it before relaying the error... */
+    mbim_mock_function_add_function_error (ctx.mock, MBIM_UUID_BASIC_CONNECT, MBIM_CID_BASIC_CONNECT_DEVICE_CAPS,
+                                           MBIM_PROTOCOL_ERROR_NOT_OPENED);
+    request = mbim_message_device_caps_query_new (NULL);
+    response = run_proxy_command (&ctx, ctx.device, request);
+    g_assert (!mbim_message_response_get_result (response, MBIM_MESSAGE_TYPE_COMMAND_DONE, &error));
+    g_assert_error (error, MBIM_PROTOCOL_ERROR, MBIM_PROTOCOL_ERROR_NOT_OPENED);
+    g_clear_error (&error);
+
+    /* ...and opens it again for the next client, without any previous state */
+    other = test_context_device_new (&ctx, MBIM_DEVICE_OPEN_FLAGS_PROXY, 0);
+    g_assert_cmpuint (run_proxy_query (&ctx, other, MBIM_CID_BASIC_CONNECT_SUBSCRIBER_READY_STATUS, MBIM_STATUS_ERROR_NONE), ==, 1);
+    g_assert_cmpuint (run_proxy_query (&ctx, other, MBIM_CID_BASIC_CONNECT_SUBSCRIBER_READY_STATUS, MBIM_STATUS_ERROR_NONE), ==, 0);
+
+    mbim_device_close (other, TIMEOUT_SECS, NULL, (GAsyncReadyCallback) async_ready, &ctx);
+    g_assert (mbim_device_close_finish (other, wait_result (&ctx), &error));
+    g_clear_object (&ctx.result);
+    g_assert_no_error (error);
+
+    test_context_teardown (&ctx);
+}
+
+static void
+test_mock_function_proxy_state_cache_not_notifiable (void)
+{
+    TestContext ctx;
+
+    if (!test_context_setup_full (&ctx, TRUE, MBIM_PROXY_FLAGS_STATE_CACHE, 0))
+        return;
+
+    /* Device caps are never notified, so always queried in the device */
+    g_assert_cmpuint (run_proxy_query (&ctx, ctx.device, MBIM_CID_BASIC_CONNECT_DEVICE_CAPS, MBIM_STATUS_ERROR_NONE), ==, 1);
+    g_assert_cmpuint (run_proxy_query (&ctx, ctx.device, MBIM_CID_BASIC_CONNECT_DEVICE_CAPS, MBIM_STATUS_ERROR_NONE), ==, 1);
+
+    test_context_teardown (&ctx);
+}
+
+/*****************************************************************************/
+
+#define MAX_BATCH_MESSAGES 8
+
+typedef struct {
+    GAsyncResult *result;
+    guint         n_completions;
+    /* Per-message results, in the order reported */
+    GArray       *indices;
+    MbimMessage  *responses[MAX_BATCH_MESSAGES];
+    GError       *errors[MAX_BATCH_MESSAGES];
+} BatchContext;
+
+static void
+batch_context_init (BatchContext *batch)
+{
+    memset (batch, 0, sizeof (BatchContext));
+    batch->indices = g_array_new (FALSE, FALSE, sizeof (guint));
+}
+
+static void
+batch_context_clear (BatchContext *batch)
+{
+    guint i;
+
+    for (i = 0; i < MAX_BATCH_MESSAGES; i++) {
+        g_clear_pointer (&batch->responses[i], mbim_message_unref);
+        g_clear_error (&batch->errors[i]);
+    }
+    g_array_unref (batch->indices);
+    g_clear_object (&batch->result);
+}
+
+static void
+batch_ready (MbimDevice   *device,
+             GAsyncResult *res,
+             BatchContext *batch)
+{
+    batch->n_completions++;
+    g_clear_object (&batch->result);
+    batch->result = g_object_ref (res);
+}
+
+static void
+batch_response_cb (MbimDevice   *device,
+                   guint         index,
+                   MbimMessage  *response,
+                   const GError *error,
+                   BatchContext *batch)
+{
+    g_assert_cmpuint (index, <, MAX_BATCH_MESSAGES);
+    g_assert (!batch->responses[index] && !batch->errors[index]);
+    g_assert ((response != NULL) != (error != NULL));
+    /* Always before the whole batch is completed */
+    g_assert (!batch->result);
+
+    g_array_append_val (batch->indices, index);
+    if (response)
+        batch->responses[index] = mbim_message_ref (response);
+    else
+        batch->errors[index] = g_error_copy (error);
+}
+
+static gboolean
+batch_completed (BatchContext *batch)
+{
+    return (batch->result != NULL);
+}
+
+/* A second completion of the same task would already be caught by GTask */
+static GAsyncResult *
+wait_batch_result (BatchContext *batch)
+{
+    wait_until ((WaitConditionFunc) batch_completed, batch);
+    g_assert_cmpuint (batch->n_completions, ==, 1);
+    return batch->result;
+}
+
+typedef struct {
+    BatchContext *batch;
+    guint         index;
+} BatchMessageContext;
+
+static gboolean
+batch_message_completed (BatchMessageContext *message)
+{
+    return (message->batch->responses[message->index] || message->batch->errors[message->index]);
+}
+
+static void
+wait_batch_message_result (BatchContext *batch,
+                           guint         index)
+{
+    BatchMessageContext message = { batch, index };
+
+    wait_until ((WaitConditionFunc) batch_message_completed, &message);
+}
+
+static const guint32 batch_cids[] = {
+    MBIM_CID_BASIC_CONNECT_RADIO_STATE,
+    MBIM_CID_BASIC_CONNECT_DEVICE_CAPS,
+    MBIM_CID_BASIC_CONNECT_SUBSCRIBER_READY_STATUS,
+};
+
+static void
+batch_messages_init (MbimMessage **messages,
+                     guint         n_messages)
+{
+    guint i;
+
+    for (i = 0; i < n_messages; i++)
+        messages[i] = mbim_message_command_new (0,
+                                                MBIM_SERVICE_BASIC_CONNECT,
+                                                batch_cids[i % G_N_ELEMENTS (batch_cids)],
+                                                MBIM_MESSAGE_COMMAND_TYPE_QUERY);
+}
+
+static void
+batch_messages_clear (MbimMessage **messages,
+                      guint         n_messages)
+{
+    guint i;
+
+    for (i = 0; i < n_messages; i++)
+        mbim_message_unref (messages[i]);
+}
+
+static void
+test_mock_function_batch (void)
+{
+    g_autoptr(GError)    error = NULL;
+    g_autoptr(GPtrArray) responses = NULL;
+    MbimMessage         *messages[G_N_ELEMENTS (batch_cids)];
+    BatchContext         batch;
+    guint64              writes;
+    guint                i;
+    TestContext          ctx;
+
+    if (!test_context_setup (&ctx))
+        return;
+
+    mbim_mock_function_add_response (ctx.mock, MBIM_UUID_BASIC_CONNECT, MBIM_CID_BASIC_CONNECT_RADIO_STATE,
+                                     MBIM_STATUS_ERROR_NONE, radio_state_buffer, sizeof (radio_state_buffer));
+    mbim_mock_function_add_response (ctx.mock, MBIM_UUID_BASIC_CONNECT, MBIM_CID_BASIC_CONNECT_SUBSCRIBER_READY_STATUS,
+                                     MBIM_STATUS_ERROR_NONE, subscriber_ready_status_buffer, sizeof (subscriber_ready_status_buffer));
+
+    batch_context_init (&batch);
+    batch_messages_init (messages, G_N_ELEMENTS (messages));
+    writes = get_device_counter (ctx.device, "writes");
+    mbim_device_command_batch_full (ctx.device, messages, G_N_ELEMENTS (messages), TIMEOUT_SECS, NULL,
+                                    (MbimDeviceCommandBatchResponseFunc) batch_response_cb, &batch,
+                                    (GAsyncReadyCallback) batch_ready, &batch);
+
+    /* Never merged when writing to the character device */
+    g_assert_cmpuint (get_device_counter (ctx.device, "writes") - writes, ==, G_N_ELEMENTS (messages));
+
+    responses = mbim_device_command_batch_finish (ctx.device, wait_batch_result (&batch), &error);
+    g_assert_no_error (error);
+    g_assert (responses);
+    g_assert_cmpuint (mbim_mock_function_get_n_commands (ctx.mock), ==, G_N_ELEMENTS (messages));
+
+    /* One response per request, in the same order */
+    g_assert_cmpuint (responses->len, ==, G_N_ELEMENTS (messages));
+    for (i = 0; i < responses->len; i++) {
+        MbimMessage *response;
+
+        response = g_ptr_array_index (responses, i);
+        g_assert_cmpuint (mbim_message_get_transaction_id (response), ==, mbim_message_get_transaction_id (messages[i]));
+        g_assert_cmpuint (mbim_message_command_done_get_cid (response), ==, batch_cids[i]);
+        g_assert_cmpuint (mbim_message_command_done_get_status_code (response), ==, MBIM_STATUS_ERROR_NONE);
+
+        /* Each one also reported on its own, as received */
+        g_assert (batch.responses[i] == response);
+        g_assert_cmpuint (g_array_index (batch.indices, guint, i), ==, i);
+    }
+    g_assert_cmpuint (batch.indices->len, ==, G_N_ELEMENTS (messages));
+
+    batch_context_clear (&batch);
+    batch_messages_clear (messages, G_N_ELEMENTS (messages));
+    test_context_teardown (&ctx);
+}
+
+static void
+send_out_of_sequence_fragment (TestContext *ctx,
+                               guint32      transaction_id,
+                               guint32      total)
+{
+    g_autoptr(GByteArray) raw = NULL;
+
+    /* A fragment other than the first one, received before the first one */
+    raw = g_byte_array_new ();
+    append_uint32 (raw, MBIM_MESSAGE_TYPE_COMMAND_DONE);
+    append_uint32 (raw, 24);
+    append_uint32 (raw, transaction_id);
+    append_uint32 (raw, total);
+    append_uint32 (raw, 1); /* fragment current */
+    append_uint32 (raw, 0); /* payload */
+    mbim_mock_function_send_raw (ctx->mock, raw->data, raw->len);
+}
+
+static void
+test_mock_function_batch_error (void)
+{
+    g_autoptr(GError)    error = NULL;
+    g_autoptr(GPtrArray) responses = NULL;
+    MbimMessage         *messages[G_N_ELEMENTS (batch_cids)];
+    BatchContext         batch;
+    TestContext          ctx;
+
+    if (!test_context_setup (&ctx))
+        return;
+
+    mbim_mock_function_add_response (ctx.mock, MBIM_UUID_BASIC_CONNECT, MBIM_CID_BASIC_CONNECT_RADIO_STATE,
+                                     MBIM_STATUS_ERROR_NONE, radio_state_buffer, sizeof (radio_state_buffer));
+
+    /* The real responses come only after the bogus ones */
+    mbim_mock_function_hold_responses (ctx.mock);
+
+    batch_context_init (&batch);
+    batch_messages_init (messages, G_N_ELEMENTS (messages));
+    mbim_device_command_batch_full (ctx.device, messages, G_N_ELEMENTS (messages), TIMEOUT_SECS, NULL,
+                                    (MbimDeviceCommandBatchResponseFunc) batch_response_cb, &batch,
+                                    (GAsyncReadyCallback) batch_ready, &batch);
+
+    /* The last request fails before the second one, and it's reported right
+     * away, without completing the batch */
+    send_out_of_sequence_fragment (&ctx, mbim_message_get_transaction_id (messages[2]), 3);
+    wait_batch_message_result (&batch, 2);
+    g_assert_error (batch.errors[2], MBIM_PROTOCOL_ERROR, MBIM_PROTOCOL_ERROR_FRAGMENT_OUT_OF_SEQUENCE);
+    g_assert (!batch.result);
+
+    /* But the error reported for the whole batch is the one of the second
+     * request */
+    send_out_of_sequence_fragment (&ctx, mbim_message_get_transaction_id (messages[1]), 2);
+    mbim_mock_function_release_responses (ctx.mock);
+    responses = mbim_device_command_batch_full_finish (ctx.device, wait_batch_result (&batch), &error);
+    g_assert_error (error, MBIM_PROTOCOL_ERROR, MBIM_PROTOCOL_ERROR_FRAGMENT_OUT_OF_SEQUENCE);
+    g_assert (strstr (error->message, "got '1/2'") != NULL);
+    g_assert (!responses);
+
+    /* Completed in the order received */
+    g_assert_cmpuint (batch.indices->len, ==, G_N_ELEMENTS (messages));
+    g_assert_cmpuint (g_array_index (batch.indices, guint, 0), ==, 2);
+    g_assert_cmpuint (g_array_index (batch.indices, guint, 1), ==, 1);
+    g_assert_cmpuint (g_array_index (batch.indices, guint, 2), ==, 0);
+    g_assert (batch.responses[0]);
+
+    /* The remaining responses, which no longer match any request, are received
+     * before the one of a new request */
+    run_radio_state_query (&ctx);
+    g_assert_cmpuint (batch.n_completions, ==, 1);
+
+    batch_context_clear (&batch);
+    batch_messages_clear (messages, G_N_ELEMENTS (messages));
+    test_context_teardown (&ctx);
+}
+
+#define N_BATCH_COALESCE_MESSAGES MAX_BATCH_MESSAGES
+
+static void
+test_mock_function_batch_coalesce (void)
+{
+    g_autoptr(GError)    error = NULL;
+    g_autoptr(GPtrArray) responses = NULL;
+    MbimMessage         *messages[N_BATCH_COALESCE_MESSAGES];
+    BatchContext         batch;
+    guint64              writes;
+    guint                total_length = 0;
+    guint                i;
+    TestContext          ctx;
+
+    if (!test_context_setup_full (&ctx, TRUE, MBIM_PROXY_FLAGS_NONE, 0))
+        return;
+
+    batch_context_init (&batch);
+    batch_messages_init (messages, G_N_ELEMENTS (messages));
+    for (i = 0; i < G_N_ELEMENTS (messages); i++)
+        total_length += ((GByteArray *) messages[i])->len;
+    g_assert_cmpuint (total_length, <=, 4096);
+
+    /* All requests fit in a single write to the proxy socket */
+    writes = get_device_counter (ctx.device, "writes");
+    mbim_device_command_batch (ctx.device, messages, G_N_ELEMENTS (messages), TIMEOUT_SECS, NULL,
+                               (GAsyncReadyCallback) batch_ready, &batch);
+    g_assert_cmpuint (get_device_counter (ctx.device, "writes") - writes, ==, 1);
+
+    responses = mbim_device_command_batch_finish (ctx.device, wait_batch_result (&batch), &error);
+    g_assert_no_error (error);
+    g_assert (responses);
+    g_assert_cmpuint (responses->len, ==, G_N_ELEMENTS (messages));
+    for (i = 0; i < responses->len; i++)
+        g_assert_cmpuint (mbim_message_get_transaction_id (g_ptr_array_index (responses, i)), ==,
+                          mbim_message_get_transaction_id (messages[i]));
+
+    batch_context_clear (&batch);
+    batch_messages_clear (messages, G_N_ELEMENTS (messages));
+    test_context_teardown (&ctx);
+}
+
+/*****************************************************************************/
+
+#define STREAM_SIZE                  10000
+#define STREAM_CID                   MBIM_CID_BASIC_CONNECT_PROVISIONED_CONTEXTS
+/* Default maximum control transfer, without the message and fragment headers */
+#define STREAM_FRAGMENT_PAYLOAD_SIZE (4096 - 20)
+/* Service, cid, command type and buffer length, only in the first fragment */
+#define STREAM_COMMAND_HEADER_SIZE   28
+
+static GBytes *
+stream_data_new (void)
+{
+    guint8 *data;
+    guint   i;
+
+    data = g_malloc (STREAM_SIZE);
+    for (i = 0; i < STREAM_SIZE; i++)
+        data[i] = (guint8) i;
+    return g_bytes_new_take (data, STREAM_SIZE);
+}
+
+static void
+stream_progress_cb (MbimDevice *device,
+                    guint32     sent,
+                    guint32     total,
+                    GArray     *progress)
+{
+    g_assert_cmpuint (total, ==, STREAM_SIZE);
+    g_array_append_val (progress, sent);
+}
+
+static void
+start_command_stream (TestContext         *ctx,
+                      GBytes              *data,
+                      GCancellable        *cancellable,
+                      GArray              *progress,
+                      GAsyncReadyCallback  callback,
+                      gpointer             user_data)
+{
+    g_autoptr(GInputStream) stream = NULL;
+
+    stream = g_memory_input_stream_new_from_bytes (data);
+    mbim_device_command_stream (ctx->device,
+                                MBIM_SERVICE_BASIC_CONNECT,
+                                STREAM_CID,
+                                MBIM_MESSAGE_COMMAND_TYPE_SET,
+                                stream,
+                                g_bytes_get_size (data),
+                                TIMEOUT_SECS,
+                                cancellable,
+                                progress ? (MbimDeviceCommandStreamProgressFunc) stream_progress_cb : NULL,
+                                progress,
+                                callback,
+                                user_data);
+}
+
+static void
+assert_stream_response (TestContext  *ctx,
+                        GAsyncResult *res)
+{
+    g_autoptr(GError)      error = NULL;
+    g_autoptr(MbimMessage) response = NULL;
+
+    response = mbim_device_command_stream_finish (ctx->device, res, &error);
+    g_assert_no_error (error);
+    g_assert (response);
+    g_assert_cmpuint (mbim_message_command_done_get_cid (response), ==, STREAM_CID);
+    g_assert_cmpuint (mbim_message_command_done_get_status_code (response), ==, MBIM_STATUS_ERROR_NONE);
+}
+
+static void
+test_mock_function_command_stream (void)
+{
+    g_autoptr(GBytes)      data = NULL;
+    g_autoptr(GArray)      progress = NULL;
+    g_autoptr(MbimMessage) command = NULL;
+    const guint8          *buffer;
+    guint32                buffer_length;
+    guint64                n_command_fragments;
+    guint                  n_fragments;
+    guint                  i;
+    TestContext            ctx;
+
+    if (!test_context_setup (&ctx))
+        return;
+
+    data = stream_data_new ();
+    progress = g_array_new (FALSE, FALSE, sizeof (guint32));
+    n_command_fragments = mbim_mock_function_get_n_command_fragments (ctx.mock);
+    start_command_stream (&ctx, data, NULL, progress, (GAsyncReadyCallback) async_ready, &ctx);
+    assert_stream_response (&ctx, wait_result (&ctx));
+    g_clear_object (&ctx.result);
+
+    /* Every fragment but the last one is as big as the device allows */
+    n_fragments = (STREAM_COMMAND_HEADER_SIZE + STREAM_SIZE + STREAM_FRAGMENT_PAYLOAD_SIZE - 1) / STREAM_FRAGMENT_PAYLOAD_SIZE;
+    g_assert_cmpuint (n_fragments, ==, 3);
+    g_assert_cmpuint (mbim_mock_function_get_n_command_fragments (ctx.mock) - n_command_fragments, ==, n_fragments);
+    g_assert_cmpuint (mbim_mock_function_get_n_commands (ctx.mock), ==, 1);
+
+    /* Progress reported once per fragment written */
+    g_assert_cmpuint (progress->len, ==, n_fragments);
+    for (i = 0; i < progress->len; i++)
+        g_assert_cmpuint (g_array_index (progress, guint32, i), ==,
+                          MIN ((i + 1) * STREAM_FRAGMENT_PAYLOAD_SIZE - STREAM_COMMAND_HEADER_SIZE, STREAM_SIZE));
+
+    /* And the whole stream was received, as is */
+    command = mbim_mock_function_get_last_command (ctx.mock);
+    g_assert (command);
+    g_assert_cmpuint (mbim_message_get_transaction_id (command), !=, 0);
+    g_assert_cmpuint (mbim_message_command_get_cid (command), ==, STREAM_CID);
+    g_assert_cmpuint (mbim_message_command_get_command_type (command), ==, MBIM_MESSAGE_COMMAND_TYPE_SET);
+    buffer = mbim_message_command_get_raw_information_buffer (command, &buffer_length);
+    g_assert_cmpuint (buffer_length, ==, STREAM_SIZE);
+    g_assert (memcmp (buffer, g_bytes_get_data (data, NULL), STREAM_SIZE) == 0);
+
+    test_context_teardown (&ctx);
+}
+
+static void
+test_mock_function_command_stream_held (void)
+{
+    g_autoptr(GError)      error = NULL;
+    g_autoptr(GBytes)      data = NULL;
+    g_autoptr(MbimMessage) request = NULL;
+    g_autoptr(MbimMessage) response = NULL;
+    g_autoptr(MbimMessage) command = NULL;
+    GAsyncResult          *command_result = NULL;
+    guint64                fragments_sent;
+    TestContext            ctx;
+
+    if (!test_context_setup (&ctx))
+        return;
+
+    mbim_mock_function_add_response (ctx.mock, MBIM_UUID_BASIC_CONNECT, MBIM_CID_BASIC_CONNECT_RADIO_STATE,
+                                     MBIM_STATUS_ERROR_NONE, radio_state_buffer, sizeof (radio_state_buffer));
+
+    data = stream_data_new ();
+    start_command_stream (&ctx, data, NULL, NULL, (GAsyncReadyCallback) async_ready, &ctx);
+
+    /* Requested while the stream is being sent, so not written yet */
+    fragments_sent = get_device_counter (ctx.device, "fragments-sent");
+    request = mbim_message_radio_state_query_new (NULL);
+    mbim_device_command (ctx.device, request, TIMEOUT_SECS, NULL, (GAsyncReadyCallback) command_ready, &command_result);
+    g_assert_cmpuint (get_device_counter (ctx.device, "fragments-sent"), ==, fragments_sent);
+
+    assert_stream_response (&ctx, wait_result (&ctx));
+    g_clear_object (&ctx.result);
+
+    /* The command held is sent once the stream is over */
+    wait_command_result (&command_result);
+    response = mbim_device_command_finish (ctx.device, command_result, &error);
+    g_object_unref (command_result);
+    g_assert_no_error (error);
+    g_assert_cmpuint (mbim_message_command_done_get_cid (response), ==, MBIM_CID_BASIC_CONNECT_RADIO_STATE);
+
+    /* And so it was received after the stream */
+    g_assert_cmpuint (mbim_mock_function_get_n_commands (ctx.mock), ==, 2);
+    command = mbim_mock_function_get_last_command (ctx.mock);
+    g_assert_cmpuint (mbim_message_get_transaction_id (command), ==, mbim_message_get_transaction_id (request));
+
+    test_context_teardown (&ctx);
+}
+
+static void
+test_mock_function_command_stream_cancel (void)
+{
+    g_autoptr(GError)       error = NULL;
+    g_autoptr(GBytes)       data = NULL;
+    g_autoptr(GCancellable) cancellable = NULL;
+    g_autoptr(MbimMessage)  response = NULL;
+    TestContext             ctx;
+
+    if (!test_context_setup (&ctx))
+        return;
+
+    mbim_mock_function_add_response (ctx.mock, MBIM_UUID_BASIC_CONNECT, MBIM_CID_BASIC_CONNECT_RADIO_STATE,
+                                     MBIM_STATUS_ERROR_NONE, radio_state_buffer, sizeof (radio_state_buffer));
+
+    /* Cancelled before the first fragment is read */
+    data = stream_data_new ();
+    cancellable = g_cancellable_new ();
+    start_command_stream (&ctx, data, cancellable, NULL, (GAsyncReadyCallback) async_ready, &ctx);
+    g_cancellable_cancel (cancellable);
+
+    response = mbim_device_command_stream_finish (ctx.device, wait_result (&ctx), &error);
+    g_clear_object (&ctx.result);
+    g_assert_error (error, G_IO_ERROR, G_IO_ERROR_CANCELLED);
+    g_assert (!response);
+    g_assert_cmpuint (mbim_mock_function_get_n_commands (ctx.mock), ==, 0);
+
+    /* Other commands are no longer held */
+    run_radio_state_query (&ctx);
+
+    test_context_teardown (&ctx);
+}
+
+static void
+test_mock_function_command_stream_close (void)
+{
+    g_autoptr(GError)      error = NULL;
+    g_autoptr(GBytes)      data = NULL;
+    g_autoptr(MbimMessage) response = NULL;
+    GAsyncResult          *stream_result = NULL;
+    TestContext            ctx;
+
+    if (!test_context_setup (&ctx))
+        return;
+
+    mbim_mock_function_add_response (ctx.mock, MBIM_UUID_BASIC_CONNECT, MBIM_CID_BASIC_CONNECT_RADIO_STATE,
+                                     MBIM_STATUS_ERROR_NONE, radio_state_buffer, sizeof (radio_state_buffer));
+
+    /* Closed while the first fragment is being read */
+    data = stream_data_new ();
+    start_command_stream (&ctx, data, NULL, NULL, (GAsyncReadyCallback) command_ready, &stream_result);
+    g_assert (mbim_device_close_force (ctx.device, &error));
+    g_assert_no_error (error);
+
+    /* Opened again right away, while the read is still ongoing */
+    mbim_device_open_full (ctx.device, MBIM_DEVICE_OPEN_FLAGS_NONE, TIMEOUT_SECS, NULL, (GAsyncReadyCallback) async_ready, &ctx);
+    g_assert (mbim_device_open_full_finish (ctx.device, wait_result (&ctx), &error));
+    g_clear_object (&ctx.result);
+    g_assert_no_error (error);
+
+    wait_command_result (&stream_result);
+    response = mbim_device_command_stream_finish (ctx.device, stream_result, &error);
+    g_object_unref (stream_result);
+    g_assert_error (error, MBIM_CORE_ERROR, MBIM_CORE_ERROR_WRONG_STATE);
+    g_assert (!response);
+
+    /* Nothing of the old stream is written in the new session, and neither
+     * commands nor new streams are held */
+    run_radio_state_query (&ctx);
+    g_assert_cmpuint (mbim_mock_function_get_n_commands (ctx.mock), ==, 1);
+    start_command_stream (&ctx, data, NULL, NULL, (GAsyncReadyCallback) async_ready, &ctx);
+    assert_stream_response (&ctx, wait_result (&ctx));
+    g_clear_object (&ctx.result);
+
+    test_context_teardown (&ctx);
+}
+
+/*****************************************************************************/
+
+static void
+wait_result_in_context (GMainContext  *context,
+                        GAsyncResult **result)
+{
+    while (!*result)
+        g_main_context_iteration (context, TRUE);
+}
+
+static void
+test_mock_function_command_threadsafe_reopen (void)
+{
+    g_autoptr(GError)       error = NULL;
+    g_autoptr(MbimMessage)  request = NULL;
+    g_autoptr(MbimMessage)  response = NULL;
+    g_autoptr(GMainContext) context = NULL;
+    GAsyncResult           *result = NULL;
+    TestContext             ctx;
+
+    if (!test_context_setup (&ctx))
+        return;
+
+    mbim_mock_function_add_response (ctx.mock, MBIM_UUID_BASIC_CONNECT, MBIM_CID_BASIC_CONNECT_RADIO_STATE,
+                                     MBIM_STATUS_ERROR_NONE, radio_state_buffer, sizeof (radio_state_buffer));
+
+    mbim_device_close (ctx.device, TIMEOUT_SECS, NULL, (GAsyncReadyCallback) async_ready, &ctx);
+    g_assert (mbim_device_close_finish (ctx.device, wait_result (&ctx), &error));
+    g_clear_object (&ctx.result);
+    g_assert_no_error (error);
+
+    /* Not accepted while closed */
+    request = mbim_message_radio_state_query_new (NULL);
+    mbim_device_command_threadsafe (ctx.device, request, TIMEOUT_SECS, NULL, (GAsyncReadyCallback) async_ready, &ctx);
+    response = mbim_device_command_threadsafe_finish (ctx.device, wait_result (&ctx), &error);
+    g_clear_object (&ctx.result);
+    g_assert_error (error, MBIM_CORE_ERROR, MBIM_CORE_ERROR_WRONG_STATE);
+    g_assert (!response);
+    g_clear_error (&error);
+
+    /* Opened again in a different context, where the commands are now
+     * processed; the default one is not iterated meanwhile */
+    context = g_main_context_new ();
+    g_main_context_push_thread_default (context);
+
+    mbim_device_open_full (ctx.device, MBIM_DEVICE_OPEN_FLAGS_NONE, TIMEOUT_SECS, NULL, (GAsyncReadyCallback) command_ready, &result);
+    wait_result_in_context (context, &result);
+    g_assert (mbim_device_open_full_finish (ctx.device, result, &error));
+    g_clear_object (&result);
+    g_assert_no_error (error);
+
+    mbim_device_command_threadsafe (ctx.device, request, TIMEOUT_SECS, NULL, (GAsyncReadyCallback) command_ready, &result);
+    wait_result_in_context (context, &result);
+    response = mbim_device_command_threadsafe_finish (ctx.device, result, &error);
+    g_clear_object (&result);
+    g_assert_no_error (error);
+    g_assert (mbim_message_response_get_result (response, MBIM_MESSAGE_TYPE_COMMAND_DONE, &error));
+    g_assert_no_error (error);
+
+    mbim_device_close (ctx.device, TIMEOUT_SECS, NULL, (GAsyncReadyCallback) command_ready, &result);
+    wait_result_in_context (context, &result);
+    g_assert (mbim_device_close_finish (ctx.device, result, &error));
+    g_clear_object (&result);
+    g_assert_no_error (error);
+
+    g_main_context_pop_thread_default (context);
+    test_context_teardown (&ctx);
+}
+
+/*****************************************************************************/
+
+int main (int argc, char **argv)
+{
+    g_test_init (&argc, &argv, NULL);
+
+    g_test_add_func ("/libmbim-glib/mock-function/open-close",          test_mock_function_open_close);
+    g_test_add_func ("/libmbim-glib/mock-function/response",            test_mock_function_response);
+    g_test_add_func ("/libmbim-glib/mock-function/response-fragmented", test_mock_function_response_fragmented);
+    g_test_add_func ("/libmbim-glib/mock-function/command-threadsafe",  test_mock_function_command_threadsafe);
+    g_test_add_func ("/libmbim-glib/mock-function/command-threadsafe-reopen", test_mock_function_command_threadsafe_reopen);
+    g_test_add_func ("/libmbim-glib/mock-function/indications",         test_mock_function_indications);
+    g_test_add_func ("/libmbim-glib/mock-function/resync",              test_mock_function_resync);
+    g_test_add_func ("/libmbim-glib/mock-function/indication-coalesce",   test_mock_function_indication_coalesce);
+    g_test_add_func ("/libmbim-glib/mock-function/indication-rate-limit", test_mock_function_indication_rate_limit);
+    g_test_add_func ("/libmbim-glib/mock-function/connect",             test_mock_function_connect);
+    g_test_add_func ("/libmbim-glib/mock-function/connect-attach",      test_mock_function_connect_attach);
+    g_test_add_func ("/libmbim-glib/mock-function/connect-not-registered", test_mock_function_connect_not_registered);
+    g_test_add_func ("/libmbim-glib/mock-function/proxy-command-timeout", test_mock_function_proxy_command_timeout);
+    g_test_add_func ("/libmbim-glib/mock-function/proxy-untrack-client",  test_mock_function_proxy_untrack_client);
+    g_test_add_func ("/libmbim-glib/mock-function/proxy-coalesce",        test_mock_function_proxy_coalesce);
+    g_test_add_func ("/libmbim-glib/mock-function/proxy-state-cache/query",          test_mock_function_proxy_state_cache_query);
+    g_test_add_func ("/libmbim-glib/mock-function/proxy-state-cache/set",            test_mock_function_proxy_state_cache_set);
+    g_test_add_func ("/libmbim-glib/mock-function/proxy-state-cache/error",          test_mock_function_proxy_state_cache_error);
+    g_test_add_func ("/libmbim-glib/mock-function/proxy-state-cache/reset",          test_mock_function_proxy_state_cache_reset);
+    g_test_add_func ("/libmbim-glib/mock-function/proxy-state-cache/not-notifiable", test_mock_function_proxy_state_cache_not_notifiable);
+    g_test_add_func ("/libmbim-glib/mock-function/batch",          test_mock_function_batch);
+    g_test_add_func ("/libmbim-glib/mock-function/batch-error",    test_mock_function_batch_error);
+    g_test_add_func ("/libmbim-glib/mock-function/batch-coalesce", test_mock_function_batch_coalesce);
+    g_test_add_func ("/libmbim-glib/mock-function/command-stream",        test_mock_function_command_stream);
+    g_test_add_func ("/libmbim-glib/mock-function/command-stream-held",   test_mock_function_command_stream_held);
+    g_test_add_func ("/libmbim-glib/mock-function/command-stream-cancel", test_mock_function_command_stream_cancel);
+    g_test_add_func ("/libmbim-glib/mock-function/command-stream-close",  test_mock_function_command_stream_close);
+
+    return g_test_run ();
+}
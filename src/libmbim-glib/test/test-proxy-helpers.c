@@ -405,6 +405,97 @@ test_merge_list_merged_services (void)
 
 /*****************************************************************************/
 
+static MbimEventEntry *
+event_entry_new (const MbimUuid *service_id,
+                 guint32         cids_count,
+                 ...)
+{
+    MbimEventEntry *entry;
+    va_list         args;
+    guint32         i;
+
+    entry = g_new0 (MbimEventEntry, 1);
+    memcpy (&entry->device_service_id, service_id, sizeof (MbimUuid));
+    entry->cids_count = cids_count;
+    if (cids_count) {
+        entry->cids = g_new0 (guint32, cids_count);
+        va_start (args, cids_count);
+        for (i = 0; i < cids_count; i++)
+            entry->cids[i] = va_arg (args, guint32);
+        va_end (args);
+    }
+    return entry;
+}
+
+static void
+assert_table_equals_merged (MbimProxySubscribeTable  *table,
+                            MbimEventEntry          **a,
+                            gsize                     a_size,
+                            MbimEventEntry          **b,
+                            gsize                     b_size)
+{
+    MbimEventEntry **built;
+    gsize            built_size = 0;
+    MbimEventEntry **merged;
+    gsize            merged_size = 0;
+
+    merged = _mbim_proxy_helper_service_subscribe_list_new_standard (&merged_size);
+    merged = _mbim_proxy_helper_service_subscribe_list_merge (merged, merged_size, a, a_size, &merged_size);
+    merged = _mbim_proxy_helper_service_subscribe_list_merge (merged, merged_size, b, b_size, &merged_size);
+
+    built = _mbim_proxy_helper_subscribe_table_build (table, &built_size);
+    g_assert (_mbim_proxy_helper_service_subscribe_list_cmp ((const MbimEventEntry * const *)built, built_size,
+                                                             (const MbimEventEntry * const *)merged, merged_size));
+
+    mbim_event_entry_array_free (built);
+    mbim_event_entry_array_free (merged);
+}
+
+static void
+test_subscribe_table (void)
+{
+    MbimProxySubscribeTable *table;
+    MbimEventEntry         **a;
+    MbimEventEntry         **b;
+
+    a = g_new0 (MbimEventEntry *, 4);
+    b = g_new0 (MbimEventEntry *, 3);
+    a[0] = event_entry_new (MBIM_UUID_ATDS, 2, MBIM_CID_ATDS_SIGNAL, MBIM_CID_ATDS_LOCATION);
+    a[1] = event_entry_new (MBIM_UUID_QMI, 0);
+    a[2] = event_entry_new (MBIM_UUID_BASIC_CONNECT, 1, MBIM_CID_BASIC_CONNECT_DEVICE_CAPS);
+    b[0] = event_entry_new (MBIM_UUID_ATDS, 2, MBIM_CID_ATDS_LOCATION, MBIM_CID_ATDS_RAT);
+    b[1] = event_entry_new (MBIM_UUID_MS_HOST_SHUTDOWN, 1, MBIM_CID_MS_HOST_SHUTDOWN_NOTIFY);
+
+    table = _mbim_proxy_helper_subscribe_table_new ();
+    assert_table_equals_merged (table, NULL, 0, NULL, 0);
+
+    /* New services and cids change the table */
+    g_assert (_mbim_proxy_helper_subscribe_table_add (table, (const MbimEventEntry * const *)a, 3));
+    g_assert (_mbim_proxy_helper_subscribe_table_add (table, (const MbimEventEntry * const *)b, 2));
+    assert_table_equals_merged (table, a, 3, b, 2);
+
+    /* Same list added twice, and removed once, doesn't change it */
+    g_assert (!_mbim_proxy_helper_subscribe_table_add (table, (const MbimEventEntry * const *)b, 2));
+    g_assert (!_mbim_proxy_helper_subscribe_table_remove (table, (const MbimEventEntry * const *)b, 2));
+    assert_table_equals_merged (table, a, 3, b, 2);
+
+    /* Standard services never change it */
+    g_assert (!_mbim_proxy_helper_subscribe_table_remove (table, (const MbimEventEntry * const *)&a[2], 1));
+    g_assert (!_mbim_proxy_helper_subscribe_table_add (table, (const MbimEventEntry * const *)&a[2], 1));
+
+    /* Removing lists keeps what the other ones need */
+    g_assert (_mbim_proxy_helper_subscribe_table_remove (table, (const MbimEventEntry * const *)a, 3));
+    assert_table_equals_merged (table, NULL, 0, b, 2);
+    g_assert (_mbim_proxy_helper_subscribe_table_remove (table, (const MbimEventEntry * const *)b, 2));
+    assert_table_equals_merged (table, NULL, 0, NULL, 0);
+
+    _mbim_proxy_helper_subscribe_table_free (table);
+    mbim_event_entry_array_free (a);
+    mbim_event_entry_array_free (b);
+}
+
+/*****************************************************************************/
+
 int main (int argc, char **argv)
 {
     g_test_init (&argc, &argv, NULL);
@@ -418,6 +509,7 @@ int main (int argc, char **argv)
     g_test_add_func ("/libmbim-glib/proxy/merge/same-service",         test_merge_list_same_service);
     g_test_add_func ("/libmbim-glib/proxy/merge/different-services",   test_merge_list_different_services);
     g_test_add_func ("/libmbim-glib/proxy/merge/merged-services",      test_merge_list_merged_services);
+    g_test_add_func ("/libmbim-glib/proxy/subscribe-table",            test_subscribe_table);
 
     return g_test_run ();
 }
@@ -0,0 +1,113 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details:
+ *
+ * Copyright (C) 2026 agent <agent@local>
+ */
+
+#include <config.h>
+
+#include "mbim-statistics.h"
+
+/*****************************************************************************/
+
+static void
+test_latency_histogram (void)
+{
+    MbimLatencyHistogram histogram = { 0 };
+    guint                i;
+
+    g_assert_cmpuint (mbim_latency_histogram_get_percentile (&histogram, 99), ==, 0);
+
+    /* 98 fast responses, 2 slow ones */
+    for (i = 0; i < 98; i++)
+        mbim_latency_histogram_add (&histogram, 1500);
+    mbim_latency_histogram_add (&histogram, 300000);
+    mbim_latency_histogram_add (&histogram, 7000000);
+
+    g_assert_cmpuint (histogram.count,      ==, 100);
+    g_assert_cmpuint (histogram.min_us,     ==, 1500);
+    g_assert_cmpuint (histogram.max_us,     ==, 7000000);
+    g_assert_cmpuint (histogram.buckets[1], ==, 98);
+    g_assert_cmpuint (histogram.buckets[8], ==, 1);
+    g_assert_cmpuint (histogram.buckets[MBIM_LATENCY_HISTOGRAM_N_BUCKETS - 1], ==, 1);
+
+    /* Percentiles report the upper bound of the bucket */
+    g_assert_cmpuint (mbim_latency_histogram_get_percentile (&histogram, 50),  ==, 2000);
+    g_assert_cmpuint (mbim_latency_histogram_get_percentile (&histogram, 99),  ==, 500000);
+    g_assert_cmpuint (mbim_latency_histogram_get_percentile (&histogram, 100), ==, 7000000);
+}
+
+static void
+test_command_statistics (void)
+{
+    GHashTable            *table;
+    MbimCommandStatistics *stats;
+    g_autoptr(GVariant)    built = NULL;
+    g_autoptr(GVariant)    item = NULL;
+    g_autoptr(GVariant)    service = NULL;
+    g_autoptr(GVariant)    latency = NULL;
+    guint32                cid;
+    guint64                count;
+
+    table = mbim_command_statistics_table_new ();
+
+    stats = mbim_command_statistics_table_lookup (table, MBIM_UUID_BASIC_CONNECT, 1);
+    stats->count++;
+    g_assert (stats == mbim_command_statistics_table_lookup (table, MBIM_UUID_BASIC_CONNECT, 1));
+    g_assert (stats != mbim_command_statistics_table_lookup (table, MBIM_UUID_BASIC_CONNECT, 2));
+    g_assert (stats != mbim_command_statistics_table_lookup (table, MBIM_UUID_SMS, 1));
+    g_assert_cmpuint (g_hash_table_size (table), ==, 3);
+
+    built = g_variant_ref_sink (mbim_command_statistics_table_build (table));
+    g_assert_cmpuint (g_variant_n_children (built), ==, 3);
+
+    /* Every entry has the command identification and the counters */
+    item = g_variant_get_child_value (built, 0);
+    g_assert (g_variant_lookup (item, "cid", "u", &cid));
+    g_assert (g_variant_lookup (item, "count", "t", &count));
+    service = g_variant_lookup_value (item, "service", G_VARIANT_TYPE_STRING);
+    g_assert (service != NULL);
+    latency = g_variant_lookup_value (item, "latency-p99-us", G_VARIANT_TYPE_UINT64);
+    g_assert (latency != NULL);
+
+    g_hash_table_unref (table);
+}
+
+static void
+test_event_rate (void)
+{
+    MbimEventRate rate = { 0 };
+    gint64        now = 1000000;
+    guint         i;
+
+    /* Nothing reported until the first window is complete */
+    for (i = 0; i < 10; i++)
+        mbim_event_rate_add (&rate, now + i * 10000);
+    g_assert_cmpfloat (mbim_event_rate_get (&rate, now + 500000), ==, 0.0);
+    g_assert_cmpfloat (mbim_event_rate_get (&rate, now + G_USEC_PER_SEC), ==, 10.0);
+
+    /* The rate decays when no more events arrive */
+    g_assert_cmpfloat (mbim_event_rate_get (&rate, now + 3 * G_USEC_PER_SEC), ==, 0.0);
+}
+
+/*****************************************************************************/
+
+int main (int argc, char **argv)
+{
+    g_test_init (&argc, &argv, NULL);
+
+    g_test_add_func ("/libmbim-glib/statistics/latency-histogram", test_latency_histogram);
+    g_test_add_func ("/libmbim-glib/statistics/command",           test_command_statistics);
+    g_test_add_func ("/libmbim-glib/statistics/event-rate",        test_event_rate);
+
+    return g_test_run ();
+}
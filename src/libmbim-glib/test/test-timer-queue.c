@@ -0,0 +1,98 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details:
+ *
+ * Copyright (C) 2026 agent <agent@local>
+ */
+
+#include <config.h>
+
+#include "mbim-timer-queue.h"
+
+/*****************************************************************************/
+
+typedef struct {
+    GMainLoop *loop;
+    GArray    *fired;
+    guint      n_pending;
+} TestContext;
+
+typedef struct {
+    TestContext *ctx;
+    guint        id;
+} TestTimer;
+
+static void
+timer_fired (TestTimer *timer)
+{
+    g_array_append_val (timer->ctx->fired, timer->id);
+    if (--timer->ctx->n_pending == 0)
+        g_main_loop_quit (timer->ctx->loop);
+}
+
+static void
+test_timer_queue_order (void)
+{
+    MbimTimerQueue *queue;
+    MbimTimer      *removed;
+    TestContext     ctx;
+    TestTimer       timers[5];
+    guint           i;
+    static const guint timeouts[] = { 40, 10, 30, 10, 20 };
+
+    ctx.loop = g_main_loop_new (NULL, FALSE);
+    ctx.fired = g_array_new (FALSE, FALSE, sizeof (guint));
+    ctx.n_pending = G_N_ELEMENTS (timers) - 1;
+
+    queue = mbim_timer_queue_ref_for_context (NULL);
+
+    /* Acquiring again the queue for the same context gives the same one */
+    g_assert (queue == mbim_timer_queue_ref_for_context (g_main_context_default ()));
+    mbim_timer_queue_unref (queue);
+
+    removed = NULL;
+    for (i = 0; i < G_N_ELEMENTS (timers); i++) {
+        MbimTimer *timer;
+
+        timers[i].ctx = &ctx;
+        timers[i].id = i;
+        timer = mbim_timer_queue_add (queue, timeouts[i], (MbimTimerFunc) timer_fired, &timers[i]);
+        if (i == 2)
+            removed = timer;
+    }
+
+    /* The removed timer must never fire */
+    mbim_timer_queue_remove (queue, removed);
+
+    g_main_loop_run (ctx.loop);
+
+    /* Timers with the same timeout fire in the order they were added */
+    g_assert_cmpuint (ctx.fired->len, ==, 4);
+    g_assert_cmpuint (g_array_index (ctx.fired, guint, 0), ==, 1);
+    g_assert_cmpuint (g_array_index (ctx.fired, guint, 1), ==, 3);
+    g_assert_cmpuint (g_array_index (ctx.fired, guint, 2), ==, 4);
+    g_assert_cmpuint (g_array_index (ctx.fired, guint, 3), ==, 0);
+
+    mbim_timer_queue_unref (queue);
+    g_array_unref (ctx.fired);
+    g_main_loop_unref (ctx.loop);
+}
+
+/*****************************************************************************/
+
+int main (int argc, char **argv)
+{
+    g_test_init (&argc, &argv, NULL);
+
+    g_test_add_func ("/libmbim-glib/timer-queue/order", test_timer_queue_order);
+
+    return g_test_run ();
+}
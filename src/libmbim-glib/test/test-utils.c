@@ -0,0 +1,84 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details:
+ *
+ * Copyright (C) 2026 agent <agent@local>
+ */
+
+#include <config.h>
+
+#include "mbim-utils.h"
+#include "mbim-utils-private.h"
+
+/*****************************************************************************/
+
+static void
+test_utils_trace_categories (void)
+{
+    mbim_utils_set_traces_enabled (FALSE);
+    g_assert (!mbim_utils_get_traces_enabled ());
+    g_assert_cmpuint (mbim_utils_get_trace_categories (), ==, MBIM_TRACE_CATEGORY_NONE);
+    g_assert (!_mbim_utils_trace_enabled (MBIM_TRACE_CATEGORY_RAW_RX));
+
+    mbim_utils_set_traces_enabled (TRUE);
+    g_assert_cmpuint (mbim_utils_get_trace_categories (), ==, MBIM_TRACE_CATEGORY_ALL);
+    g_assert (_mbim_utils_trace_enabled (MBIM_TRACE_CATEGORY_RAW_RX));
+    g_assert (_mbim_utils_trace_enabled (MBIM_TRACE_CATEGORY_NETLINK));
+
+    mbim_utils_set_trace_categories (MBIM_TRACE_CATEGORY_TRANSLATED | MBIM_TRACE_CATEGORY_PROXY);
+    g_assert (mbim_utils_get_traces_enabled ());
+    g_assert (!_mbim_utils_trace_enabled (MBIM_TRACE_CATEGORY_RAW_RX));
+    g_assert (!_mbim_utils_trace_enabled (MBIM_TRACE_CATEGORY_RAW_TX));
+    g_assert (_mbim_utils_trace_enabled (MBIM_TRACE_CATEGORY_TRANSLATED));
+    g_assert (_mbim_utils_trace_enabled (MBIM_TRACE_CATEGORY_PROXY));
+
+    mbim_utils_set_traces_enabled (FALSE);
+}
+
+static void
+test_utils_trace_rate_limit (void)
+{
+    guint i;
+    guint n_allowed = 0;
+
+    mbim_utils_set_trace_categories (MBIM_TRACE_CATEGORY_RAW_RX | MBIM_TRACE_CATEGORY_RAW_TX);
+    mbim_utils_set_trace_rate_limit (MBIM_TRACE_CATEGORY_RAW_RX, 5);
+
+    /* Well within a single one-second window */
+    for (i = 0; i < 20; i++) {
+        if (_mbim_utils_trace_enabled (MBIM_TRACE_CATEGORY_RAW_RX))
+            n_allowed++;
+    }
+    g_assert_cmpuint (n_allowed, ==, 5);
+
+    /* Other categories are not limited */
+    for (i = 0; i < 20; i++)
+        g_assert (_mbim_utils_trace_enabled (MBIM_TRACE_CATEGORY_RAW_TX));
+
+    /* Removing the limit allows all records again */
+    mbim_utils_set_trace_rate_limit (MBIM_TRACE_CATEGORY_RAW_RX, 0);
+    for (i = 0; i < 20; i++)
+        g_assert (_mbim_utils_trace_enabled (MBIM_TRACE_CATEGORY_RAW_RX));
+
+    mbim_utils_set_traces_enabled (FALSE);
+}
+
+/*****************************************************************************/
+
+int main (int argc, char **argv)
+{
+    g_test_init (&argc, &argv, NULL);
+
+    g_test_add_func ("/libmbim-glib/utils/trace-categories", test_utils_trace_categories);
+    g_test_add_func ("/libmbim-glib/utils/trace-rate-limit", test_utils_trace_rate_limit);
+
+    return g_test_run ();
+}
@@ -206,6 +206,63 @@ test_uuid_custom (void)
     g_assert (!mbim_service_id_is_custom (service));
 }
 
+static void
+test_uuid_custom_multiple (void)
+{
+    static const MbimUuid uuid_custom_a = {
+        .a = { 0x11, 0x11, 0x11, 0x11 },
+        .b = { 0x22, 0x22 },
+        .c = { 0x33, 0x33 },
+        .d = { 0x44, 0x44 },
+        .e = { 0x55, 0x55, 0x55, 0x55, 0x55, 0x55 }
+    };
+    static const MbimUuid uuid_custom_b = {
+        .a = { 0x66, 0x66, 0x66, 0x66 },
+        .b = { 0x77, 0x77 },
+        .c = { 0x88, 0x88 },
+        .d = { 0x99, 0x99 },
+        .e = { 0xaa, 0xaa, 0xaa, 0xaa, 0xaa, 0xaa }
+    };
+    guint service_a;
+    guint service_b;
+
+    service_a = mbim_register_custom_service (&uuid_custom_a, "custom-a");
+    service_b = mbim_register_custom_service (&uuid_custom_b, "custom-b");
+    g_assert_cmpuint (service_a, !=, service_b);
+
+    /* registering the same UUID again gives the same service */
+    g_assert_cmpuint (mbim_register_custom_service (&uuid_custom_a, "custom-a"), ==, service_a);
+
+    g_assert_cmpuint (mbim_uuid_to_service (&uuid_custom_a), ==, service_a);
+    g_assert_cmpuint (mbim_uuid_to_service (&uuid_custom_b), ==, service_b);
+    g_assert_cmpstr (mbim_service_lookup_name (service_b), ==, "custom-b");
+
+    /* built-in services are not shadowed by custom ones */
+    g_assert_cmpuint (mbim_uuid_to_service (MBIM_UUID_BASIC_CONNECT), ==, MBIM_SERVICE_BASIC_CONNECT);
+
+    /* removing one doesn't affect the other */
+    g_assert (mbim_unregister_custom_service (service_a));
+    g_assert (!mbim_unregister_custom_service (service_a));
+    g_assert_cmpuint (mbim_uuid_to_service (&uuid_custom_a), ==, MBIM_SERVICE_INVALID);
+    g_assert_cmpuint (mbim_uuid_to_service (&uuid_custom_b), ==, service_b);
+    g_assert (mbim_service_id_is_custom (service_b));
+
+    g_assert (mbim_unregister_custom_service (service_b));
+    g_assert (!mbim_service_id_is_custom (service_b));
+    g_assert (mbim_service_lookup_name (service_b) == NULL);
+}
+
+static void
+test_uuid_context_type (void)
+{
+    guint i;
+
+    for (i = MBIM_CONTEXT_TYPE_NONE; i <= MBIM_CONTEXT_TYPE_LOCAL; i++)
+        g_assert_cmpuint (mbim_uuid_to_context_type (mbim_uuid_from_context_type (i)), ==, i);
+
+    g_assert_cmpuint (mbim_uuid_to_context_type (MBIM_UUID_BASIC_CONNECT), ==, MBIM_CONTEXT_TYPE_INVALID);
+}
+
 /*****************************************************************************/
 
 int main (int argc, char **argv)
@@ -234,7 +291,10 @@ int main (int argc, char **argv)
     g_test_add_func ("/libmbim-glib/uuid/invalid/dashes", test_uuid_invalid_dashes);
     g_test_add_func ("/libmbim-glib/uuid/invalid/no-hex", test_uuid_invalid_no_hex);
 
-    g_test_add_func ("/libmbim-glib/uuid/custom", test_uuid_custom);
+    g_test_add_func ("/libmbim-glib/uuid/custom",          test_uuid_custom);
+    g_test_add_func ("/libmbim-glib/uuid/custom/multiple", test_uuid_custom_multiple);
+
+    g_test_add_func ("/libmbim-glib/uuid/context-type", test_uuid_context_type);
 
     return g_test_run ();
 }
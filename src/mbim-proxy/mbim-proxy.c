@@ -25,6 +25,8 @@
 #include <stdlib.h>
 #include <locale.h>
 #include <string.h>
+#include <errno.h>
+#include <unistd.h>
 
 #include <glib.h>
 #include <glib/gprintf.h>
@@ -49,6 +51,9 @@ static gboolean verbose_flag;
 static gboolean version_flag;
 static gboolean no_exit_flag;
 static gint     empty_timeout = -1;
+static gboolean device_threads_flag;
+static gboolean state_cache_flag;
+static gint     ready_fd = -1;
 
 static GOptionEntry main_entries[] = {
     { "no-exit", 0, 0, G_OPTION_ARG_NONE, &no_exit_flag,
@@ -59,6 +64,18 @@ static GOptionEntry main_entries[] = {
       "If no clients/devices, exit after this timeout. If set to 0, equivalent to --no-exit.",
       "[SECS]"
     },
+    { "device-threads", 0, 0, G_OPTION_ARG_NONE, &device_threads_flag,
+      "Handle each device, and the clients using it, in a separate thread",
+      NULL
+    },
+    { "state-cache", 0, 0, G_OPTION_ARG_NONE, &state_cache_flag,
+      "Answer queries of notifiable state (e.g. registration, signal, connection) from the latest indications",
+      NULL
+    },
+    { "ready-fd", 0, 0, G_OPTION_ARG_INT, &ready_fd,
+      "Write to the given file descriptor, and close it, once ready to accept clients",
+      "[FD]"
+    },
     { "verbose", 'v', 0, G_OPTION_ARG_NONE, &verbose_flag,
       "Run action with verbose logs, including the debug ones",
       NULL
@@ -212,6 +229,7 @@ int main (int argc, char **argv)
 {
     g_autoptr(GError)         error = NULL;
     g_autoptr(GOptionContext) context = NULL;
+    MbimProxyFlags            flags = MBIM_PROXY_FLAGS_NONE;
 
     setlocale (LC_ALL, "");
 
@@ -241,12 +259,24 @@ int main (int argc, char **argv)
         empty_timeout = EMPTY_TIMEOUT_DEFAULT;
 
     /* Setup proxy */
-    proxy = mbim_proxy_new (&error);
+    if (device_threads_flag)
+        flags |= MBIM_PROXY_FLAGS_DEVICE_THREADS;
+    if (state_cache_flag)
+        flags |= MBIM_PROXY_FLAGS_STATE_CACHE;
+    proxy = mbim_proxy_new_full (flags, &error);
     if (!proxy) {
         g_printerr ("error: %s\n", error->message);
         exit (EXIT_FAILURE);
     }
 
+    /* Notify readiness; exiting on error above also closes the fd, which
+     * the parent process notices as well */
+    if (ready_fd >= 0) {
+        if (write (ready_fd, "1", 1) != 1)
+            g_warning ("couldn't notify readiness: %s", g_strerror (errno));
+        close (ready_fd);
+    }
+
     /* Don't exit the proxy when no clients/devices are found */
     if (!no_exit_flag && empty_timeout != 0) {
         g_debug ("proxy will exit after %d secs if unused", empty_timeout);
@@ -68,6 +68,7 @@ static gchar    *query_connect_str;
 static gchar    *set_connect_activate_str;
 static gchar    *query_ip_configuration_str;
 static gchar    *set_connect_deactivate_str;
+static gchar    *set_attach_and_connect_str;
 static gboolean  query_packet_statistics_flag;
 static gchar    *query_ip_packet_filters_str;
 static gboolean  query_provisioned_contexts_flag;
@@ -187,6 +188,10 @@ static GOptionEntry entries[] = {
       "Connect (allowed keys: session-id, apn, ip-type (ipv4|ipv6|ipv4v6), auth (PAP|CHAP|MSCHAPV2), username, password)",
       "[\"key=value,...\"]"
     },
+    { "attach-and-connect", 0, 0, G_OPTION_ARG_STRING, &set_attach_and_connect_str,
+      "Check SIM and registration, attach to the packet service if needed, connect and query IP configuration, all in one go (same keys as --connect)",
+      "[\"key=value,...\"]"
+    },
     { "query-ip-configuration", 0, G_OPTION_FLAG_OPTIONAL_ARG, G_OPTION_ARG_CALLBACK, G_CALLBACK (query_ip_configuration_arg_parse),
       "Query IP configuration (SessionID is optional, defaults to 0)",
       "[SessionID]"
@@ -268,11 +273,7 @@ query_ip_packet_filters_arg_parse (const char *option_name,
 gboolean
 mbimcli_basic_connect_options_enabled (void)
 {
-    static guint n_actions = 0;
-    static gboolean checked = FALSE;
-
-    if (checked)
-        return !!n_actions;
+    guint n_actions;
 
     n_actions = (query_device_caps_flag +
                  query_subscriber_ready_status_flag +
@@ -299,19 +300,29 @@ mbimcli_basic_connect_options_enabled (void)
                  !!set_connect_activate_str +
                  !!query_ip_configuration_str +
                  !!set_connect_deactivate_str +
+                 !!set_attach_and_connect_str +
                  query_packet_statistics_flag +
                  !!query_ip_packet_filters_str +
                  query_provisioned_contexts_flag);
 
     if (n_actions > 1) {
-        g_printerr ("error: too many Basic Connect actions requested\n");
-        exit (EXIT_FAILURE);
+        mbimcli_options_error ("too many Basic Connect actions requested");
+        return FALSE;
     }
 
-    checked = TRUE;
     return !!n_actions;
 }
 
+void
+mbimcli_basic_connect_options_reset (void)
+{
+    mbimcli_reset_option_entries (entries);
+    g_clear_pointer (&query_connect_str, g_free);
+    g_clear_pointer (&query_ip_configuration_str, g_free);
+    g_clear_pointer (&set_connect_deactivate_str, g_free);
+    g_clear_pointer (&query_ip_packet_filters_str, g_free);
+}
+
 static void
 context_free (Context *context)
 {
@@ -850,6 +861,50 @@ ip_configuration_query (MbimDevice   *device,
                          NULL);
 }
 
+static gboolean
+connection_status_print (MbimDevice   *device,
+                         MbimMessage  *response,
+                         guint32      *out_session_id,
+                         GError      **error)
+{
+    guint32              session_id;
+    MbimActivationState  activation_state;
+    MbimVoiceCallState   voice_call_state;
+    MbimContextIpType    ip_type;
+    const MbimUuid      *context_type;
+    guint32              nw_error;
+
+    if (!mbim_message_connect_response_parse (
+            response,
+            &session_id,
+            &activation_state,
+            &voice_call_state,
+            &ip_type,
+            &context_type,
+            &nw_error,
+            error))
+        return FALSE;
+
+    g_print ("[%s] Connection status:\n"
+             "\t      Session ID: '%u'\n"
+             "\tActivation state: '%s'\n"
+             "\tVoice call state: '%s'\n"
+             "\t         IP type: '%s'\n"
+             "\t    Context type: '%s'\n"
+             "\t   Network error: '%s'\n",
+             mbim_device_get_path_display (device),
+             session_id,
+             VALIDATE_UNKNOWN (mbim_activation_state_get_string (activation_state)),
+             VALIDATE_UNKNOWN (mbim_voice_call_state_get_string (voice_call_state)),
+             VALIDATE_UNKNOWN (mbim_context_ip_type_get_string (ip_type)),
+             VALIDATE_UNKNOWN (mbim_context_type_get_string (mbim_uuid_to_context_type (context_type))),
+             VALIDATE_UNKNOWN (mbim_nw_error_get_string (nw_error)));
+
+    if (out_session_id)
+        *out_session_id = session_id;
+    return TRUE;
+}
+
 static void
 connect_ready (MbimDevice   *device,
                GAsyncResult *res,
@@ -858,11 +913,6 @@ connect_ready (MbimDevice   *device,
     g_autoptr(MbimMessage)  response = NULL;
     g_autoptr(GError)       error = NULL;
     guint32                 session_id;
-    MbimActivationState     activation_state;
-    MbimVoiceCallState      voice_call_state;
-    MbimContextIpType       ip_type;
-    const MbimUuid         *context_type;
-    guint32                 nw_error;
 
     response = mbim_device_command_finish (device, res, &error);
     if (!response || !mbim_message_response_get_result (response, MBIM_MESSAGE_TYPE_COMMAND_DONE, &error)) {
@@ -871,20 +921,6 @@ connect_ready (MbimDevice   *device,
         return;
     }
 
-    if (!mbim_message_connect_response_parse (
-            response,
-            &session_id,
-            &activation_state,
-            &voice_call_state,
-            &ip_type,
-            &context_type,
-            &nw_error,
-            &error)) {
-        g_printerr ("error: couldn't parse response message: %s\n", error->message);
-        shutdown (FALSE);
-        return;
-    }
-
     switch (GPOINTER_TO_UINT (user_data)) {
     case CONNECT:
         g_print ("[%s] Successfully connected\n\n",
@@ -898,20 +934,11 @@ connect_ready (MbimDevice   *device,
         break;
     }
 
-    g_print ("[%s] Connection status:\n"
-             "\t      Session ID: '%u'\n"
-             "\tActivation state: '%s'\n"
-             "\tVoice call state: '%s'\n"
-             "\t         IP type: '%s'\n"
-             "\t    Context type: '%s'\n"
-             "\t   Network error: '%s'\n",
-             mbim_device_get_path_display (device),
-             session_id,
-             VALIDATE_UNKNOWN (mbim_activation_state_get_string (activation_state)),
-             VALIDATE_UNKNOWN (mbim_voice_call_state_get_string (voice_call_state)),
-             VALIDATE_UNKNOWN (mbim_context_ip_type_get_string (ip_type)),
-             VALIDATE_UNKNOWN (mbim_context_type_get_string (mbim_uuid_to_context_type (context_type))),
-             VALIDATE_UNKNOWN (mbim_nw_error_get_string (nw_error)));
+    if (!connection_status_print (device, response, &session_id, &error)) {
+        g_printerr ("error: couldn't parse response message: %s\n", error->message);
+        shutdown (FALSE);
+        return;
+    }
 
     if (GPOINTER_TO_UINT (user_data) == CONNECT) {
         ip_configuration_query (device, NULL, session_id);
@@ -921,6 +948,38 @@ connect_ready (MbimDevice   *device,
     shutdown (TRUE);
 }
 
+static void
+attach_and_connect_ready (MbimDevice   *device,
+                          GAsyncResult *res)
+{
+    g_autoptr(MbimMessage) connect_response = NULL;
+    g_autoptr(MbimMessage) ip_configuration_response = NULL;
+    g_autoptr(GError)      error = NULL;
+
+    if (!mbim_device_connect_finish (device, res, &connect_response, &ip_configuration_response, &error)) {
+        g_printerr ("error: couldn't connect: %s\n", error->message);
+        shutdown (FALSE);
+        return;
+    }
+
+    g_print ("[%s] Successfully connected\n\n",
+             mbim_device_get_path_display (device));
+
+    if (!connection_status_print (device, connect_response, NULL, &error)) {
+        g_printerr ("error: couldn't parse response message: %s\n", error->message);
+        shutdown (FALSE);
+        return;
+    }
+
+    if (!mbimcli_print_ip_config (device, ip_configuration_response, &error)) {
+        g_printerr ("error: couldn't parse IP configuration response message: %s\n", error->message);
+        shutdown (FALSE);
+        return;
+    }
+
+    shutdown (TRUE);
+}
+
 static void
 ip_packet_filters_ready (MbimDevice   *device,
                          GAsyncResult *res)
@@ -2052,6 +2111,40 @@ mbimcli_basic_connect_run (MbimDevice   *device,
         return;
     }
 
+    /* Attach and connect? */
+    if (set_attach_and_connect_str) {
+        guint32            session_id = 0;
+        g_autofree gchar  *apn = NULL;
+        MbimAuthProtocol   auth_protocol;
+        g_autofree gchar  *username = NULL;
+        g_autofree gchar  *password = NULL;
+        MbimContextIpType  ip_type = MBIM_CONTEXT_IP_TYPE_DEFAULT;
+
+        if (!set_connect_activate_parse (set_attach_and_connect_str,
+                                         &session_id,
+                                         &apn,
+                                         &auth_protocol,
+                                         &username,
+                                         &password,
+                                         &ip_type)) {
+            shutdown (FALSE);
+            return;
+        }
+
+        mbim_device_connect (ctx->device,
+                             session_id,
+                             apn,
+                             auth_protocol,
+                             username,
+                             password,
+                             ip_type,
+                             120,
+                             ctx->cancellable,
+                             (GAsyncReadyCallback)attach_and_connect_ready,
+                             NULL);
+        return;
+    }
+
     /* Query IP configuration? */
     if (query_ip_configuration_str) {
         guint32 session_id = 0;
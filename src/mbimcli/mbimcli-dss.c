@@ -76,24 +76,25 @@ mbimcli_dss_get_option_group (void)
 gboolean
 mbimcli_dss_options_enabled (void)
 {
-    static guint n_actions = 0;
-    static gboolean checked = FALSE;
-
-    if (checked)
-        return !!n_actions;
+    guint n_actions;
 
     n_actions = (!!connect_str +
                  !!disconnect_str );
 
     if (n_actions > 1) {
-        g_printerr ("error: too many DSS actions requested\n");
-        exit (EXIT_FAILURE);
+        mbimcli_options_error ("too many DSS actions requested");
+        return FALSE;
     }
 
-    checked = TRUE;
     return !!n_actions;
 }
 
+void
+mbimcli_dss_options_reset (void)
+{
+    mbimcli_reset_option_entries (entries);
+}
+
 static void
 context_free (Context *context)
 {
@@ -350,3 +350,37 @@ mbimcli_read_pintype_from_string (const gchar *str)
 
     return MBIM_PIN_TYPE_UNKNOWN;
 }
+
+void
+mbimcli_reset_option_entries (const GOptionEntry *entries)
+{
+    const GOptionEntry *entry;
+
+    for (entry = entries; entry->long_name; entry++) {
+        switch (entry->arg) {
+        case G_OPTION_ARG_NONE:
+            *((gboolean *) entry->arg_data) = FALSE;
+            break;
+        case G_OPTION_ARG_INT:
+            *((gint *) entry->arg_data) = 0;
+            break;
+        case G_OPTION_ARG_INT64:
+            *((gint64 *) entry->arg_data) = 0;
+            break;
+        case G_OPTION_ARG_DOUBLE:
+            *((gdouble *) entry->arg_data) = 0.0;
+            break;
+        case G_OPTION_ARG_STRING:
+        case G_OPTION_ARG_FILENAME:
+            g_clear_pointer ((gchar **) entry->arg_data, g_free);
+            break;
+        case G_OPTION_ARG_STRING_ARRAY:
+        case G_OPTION_ARG_FILENAME_ARRAY:
+            g_clear_pointer ((gchar ***) entry->arg_data, g_strfreev);
+            break;
+        case G_OPTION_ARG_CALLBACK:
+        default:
+            break;
+        }
+    }
+}
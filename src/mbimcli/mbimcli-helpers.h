@@ -44,4 +44,8 @@ gboolean mbimcli_parse_key_value_string (const gchar *str,
 
 MbimPinType mbimcli_read_pintype_from_string (const gchar *str);
 
+/* Reset the values of all the given options, so that they can be parsed
+ * again; values set by callbacks must be reset separately */
+void mbimcli_reset_option_entries (const GOptionEntry *entries);
+
 #endif /* __MBIMCLI_H__ */
@@ -39,6 +39,7 @@ static gchar *link_list_str;
 static gchar *link_add_str;
 static gchar *link_delete_str;
 static gchar *link_delete_all_str;
+static gchar *link_configure_str;
 
 static GOptionEntry entries[] = {
     { "link-list", 0, 0, G_OPTION_ARG_STRING, &link_list_str,
@@ -57,6 +58,10 @@ static GOptionEntry entries[] = {
       "Delete all network interface links from the given interface",
       "[IFACE]"
     },
+    { "link-configure", 0, 0, G_OPTION_ARG_STRING, &link_configure_str,
+      "Configure the addresses, routes and MTU of a link from the IP configuration of its session",
+      "[iface=IFACE[,session-id=N][,metric=N]]"
+    },
     { NULL }
 };
 
@@ -77,26 +82,28 @@ mbimcli_link_management_get_option_group (void)
 gboolean
 mbimcli_link_management_options_enabled (void)
 {
-    static guint n_actions = 0;
-    static gboolean checked = FALSE;
-
-    if (checked)
-        return !!n_actions;
+    guint n_actions;
 
     n_actions = (!!link_list_str +
                  !!link_add_str +
                  !!link_delete_str +
-                 !!link_delete_all_str);
+                 !!link_delete_all_str +
+                 !!link_configure_str);
 
     if (n_actions > 1) {
-        g_printerr ("error: too many link management actions requested\n");
-        exit (EXIT_FAILURE);
+        mbimcli_options_error ("too many link management actions requested");
+        return FALSE;
     }
 
-    checked = TRUE;
     return !!n_actions;
 }
 
+void
+mbimcli_link_management_options_reset (void)
+{
+    mbimcli_reset_option_entries (entries);
+}
+
 /******************************************************************************/
 
 static void
@@ -293,6 +300,166 @@ device_link_list (MbimDevice   *dev,
     mbimcli_async_operation_done (!error);
 }
 
+/******************************************************************************/
+
+typedef struct {
+    guint  session_id;
+    guint  metric;
+    gchar *iface;
+} ConfigureLinkProperties;
+
+static void
+configure_link_properties_free (ConfigureLinkProperties *props)
+{
+    g_free (props->iface);
+    g_slice_free (ConfigureLinkProperties, props);
+}
+
+static void
+link_configure_ready (MbimDevice              *dev,
+                      GAsyncResult            *res,
+                      ConfigureLinkProperties *props)
+{
+    g_autoptr(GError) error = NULL;
+
+    if (!mbim_device_configure_link_finish (dev, res, &error))
+        g_printerr ("error: couldn't configure link: %s\n", error->message);
+    else
+        g_print ("[%s] link %s successfully configured\n",
+                 mbim_device_get_path_display (dev),
+                 props->iface);
+
+    configure_link_properties_free (props);
+    mbimcli_async_operation_done (!error);
+}
+
+static void
+link_configure_ip_configuration_ready (MbimDevice              *dev,
+                                       GAsyncResult            *res,
+                                       ConfigureLinkProperties *props)
+{
+    g_autoptr(MbimMessage) response = NULL;
+    g_autoptr(GError)      error = NULL;
+
+    response = mbim_device_command_finish (dev, res, &error);
+    if (!response || !mbim_message_response_get_result (response, MBIM_MESSAGE_TYPE_COMMAND_DONE, &error)) {
+        g_printerr ("error: couldn't query IP configuration: %s\n", error->message);
+        configure_link_properties_free (props);
+        mbimcli_async_operation_done (FALSE);
+        return;
+    }
+
+    mbim_device_configure_link (dev,
+                                props->iface,
+                                response,
+                                props->metric,
+                                NULL,
+                                (GAsyncReadyCallback)link_configure_ready,
+                                props);
+}
+
+static gboolean
+configure_link_properties_handle (const gchar              *key,
+                                  const gchar              *value,
+                                  GError                  **error,
+                                  ConfigureLinkProperties  *props)
+{
+    if (g_ascii_strcasecmp (key, "session-id") == 0) {
+        if (!mbimcli_read_uint_from_string (value, &props->session_id)) {
+            g_set_error (error, MBIM_CORE_ERROR, MBIM_CORE_ERROR_FAILED,
+                         "invalid session-id given: '%s'", value);
+            return FALSE;
+        }
+        return TRUE;
+    }
+
+    if (g_ascii_strcasecmp (key, "metric") == 0) {
+        if (!mbimcli_read_uint_from_string (value, &props->metric)) {
+            g_set_error (error, MBIM_CORE_ERROR, MBIM_CORE_ERROR_FAILED,
+                         "invalid metric given: '%s'", value);
+            return FALSE;
+        }
+        return TRUE;
+    }
+
+    if (g_ascii_strcasecmp (key, "iface") == 0 && !props->iface) {
+        props->iface = g_strdup (value);
+        return TRUE;
+    }
+
+    g_set_error (error, MBIM_CORE_ERROR, MBIM_CORE_ERROR_FAILED,
+                 "unrecognized or duplicate option '%s'", key);
+    return FALSE;
+}
+
+static void
+device_link_configure (MbimDevice   *dev,
+                       GCancellable *cancellable,
+                       const gchar  *configure_settings)
+{
+    g_autoptr(MbimMessage)   message = NULL;
+    g_autoptr(GError)        error = NULL;
+    ConfigureLinkProperties *props;
+
+    props = g_slice_new0 (ConfigureLinkProperties);
+    if (!mbimcli_parse_key_value_string (configure_settings,
+                                         &error,
+                                         (MbimParseKeyValueForeachFn)configure_link_properties_handle,
+                                         props)) {
+        g_printerr ("error: couldn't parse input configure link settings: %s\n",
+                    error->message);
+        configure_link_properties_free (props);
+        mbimcli_async_operation_done (FALSE);
+        return;
+    }
+
+    if (!props->iface) {
+        g_printerr ("error: missing mandatory 'iface' setting\n");
+        configure_link_properties_free (props);
+        mbimcli_async_operation_done (FALSE);
+        return;
+    }
+
+    if (props->session_id > MBIM_DEVICE_SESSION_ID_MAX) {
+        g_printerr ("error: session id %u out of range [%u,%u]\n",
+                    props->session_id, MBIM_DEVICE_SESSION_ID_MIN, MBIM_DEVICE_SESSION_ID_MAX);
+        configure_link_properties_free (props);
+        mbimcli_async_operation_done (FALSE);
+        return;
+    }
+
+    message = (mbim_message_ip_configuration_query_new (
+                   props->session_id,
+                   MBIM_IP_CONFIGURATION_AVAILABLE_FLAG_NONE, /* ipv4configurationavailable */
+                   MBIM_IP_CONFIGURATION_AVAILABLE_FLAG_NONE, /* ipv6configurationavailable */
+                   0, /* ipv4addresscount */
+                   NULL, /* ipv4address */
+                   0, /* ipv6addresscount */
+                   NULL, /* ipv6address */
+                   NULL, /* ipv4gateway */
+                   NULL, /* ipv6gateway */
+                   0, /* ipv4dnsservercount */
+                   NULL, /* ipv4dnsserver */
+                   0, /* ipv6dnsservercount */
+                   NULL, /* ipv6dnsserver */
+                   0, /* ipv4mtu */
+                   0, /* ipv6mtu */
+                   &error));
+    if (!message) {
+        g_printerr ("error: couldn't create IP config request: %s\n", error->message);
+        configure_link_properties_free (props);
+        mbimcli_async_operation_done (FALSE);
+        return;
+    }
+
+    mbim_device_command (dev,
+                         message,
+                         10,
+                         cancellable,
+                         (GAsyncReadyCallback)link_configure_ip_configuration_ready,
+                         props);
+}
+
 /******************************************************************************/
 /* Common */
 
@@ -308,6 +475,8 @@ mbimcli_link_management_run (MbimDevice   *dev,
         device_link_delete (dev, cancellable, link_delete_str);
     else if (link_delete_all_str)
         device_link_delete_all (dev, cancellable, link_delete_all_str);
+    else if (link_configure_str)
+        device_link_configure (dev, cancellable, link_configure_str);
     else
       g_warn_if_reached ();
 }
@@ -0,0 +1,515 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+/*
+ * mbimcli -- Command line interface to control MBIM devices
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Copyright (C) 2026 agent <agent@local>
+ */
+
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <glib.h>
+#include <gio/gio.h>
+
+#include <libmbim-glib.h>
+
+#include "mbimcli.h"
+#include "mbimcli-helpers.h"
+
+/* CIDs given by name are looked up up to this value */
+#define MAX_CID_LOOKUP G_MAXUINT8
+
+/* Context */
+typedef struct {
+    MbimDevice      *device;
+    GCancellable    *cancellable;
+    MbimEventEntry **events;
+    gsize            n_events;
+    gulong           indicate_status_id;
+    gulong           removed_id;
+    gulong           cancelled_id;
+    guint            shutdown_id;
+} Context;
+static Context *ctx;
+
+/* Options */
+static gboolean   monitor_flag;
+static gchar    **monitor_subscribe_strv;
+
+static GOptionEntry entries[] = {
+    { "monitor", 0, 0, G_OPTION_ARG_NONE, &monitor_flag,
+      "Monitor indications until interrupted, printing them as JSON objects, one per line",
+      NULL
+    },
+    { "monitor-subscribe", 0, 0, G_OPTION_ARG_STRING_ARRAY, &monitor_subscribe_strv,
+      "Subscribe to the given service and CIDs while monitoring; may be given multiple times. "
+      "Use along with --device-open-proxy to not modify the subscriptions of other users of the device.",
+      "[(Service)[:(CID)[,(CID)...]]]"
+    },
+    { NULL }
+};
+
+GOptionGroup *
+mbimcli_monitor_get_option_group (void)
+{
+    GOptionGroup *group;
+
+    group = g_option_group_new ("monitor",
+                                "Monitor options:",
+                                "Show indication monitoring options",
+                                NULL, NULL);
+    g_option_group_add_entries (group, entries);
+
+    return group;
+}
+
+gboolean
+mbimcli_monitor_options_enabled (void)
+{
+    if (monitor_subscribe_strv && !monitor_flag) {
+        mbimcli_options_error ("--monitor-subscribe requires --monitor");
+        return FALSE;
+    }
+
+    return monitor_flag;
+}
+
+void
+mbimcli_monitor_options_reset (void)
+{
+    mbimcli_reset_option_entries (entries);
+}
+
+static void
+context_free (Context *context)
+{
+    if (!context)
+        return;
+
+    if (context->shutdown_id)
+        g_source_remove (context->shutdown_id);
+    if (context->cancelled_id)
+        g_cancellable_disconnect (context->cancellable, context->cancelled_id);
+    if (context->indicate_status_id)
+        g_signal_handler_disconnect (context->device, context->indicate_status_id);
+    if (context->removed_id)
+        g_signal_handler_disconnect (context->device, context->removed_id);
+    if (context->events)
+        mbim_event_entry_array_free (context->events);
+    if (context->cancellable)
+        g_object_unref (context->cancellable);
+    if (context->device)
+        g_object_unref (context->device);
+    g_slice_free (Context, context);
+}
+
+static void
+shutdown (gboolean operation_status)
+{
+    /* Cleanup context and finish async operation */
+    context_free (ctx);
+    ctx = NULL;
+    mbimcli_async_operation_done (operation_status);
+}
+
+/*****************************************************************************/
+/* Subscription list parsing */
+
+static gboolean
+parse_service (const gchar *str,
+               MbimUuid    *out_uuid,
+               MbimService *out_service)
+{
+    guint service;
+
+    for (service = MBIM_SERVICE_BASIC_CONNECT; service < MBIM_SERVICE_LAST; service++) {
+        if (g_str_equal (str, mbim_service_get_string ((MbimService) service))) {
+            memcpy (out_uuid, mbim_uuid_from_service ((MbimService) service), sizeof (MbimUuid));
+            *out_service = (MbimService) service;
+            return TRUE;
+        }
+    }
+
+    /* Custom services given as UUID */
+    if (mbim_uuid_from_printable (str, out_uuid)) {
+        *out_service = mbim_uuid_to_service (out_uuid);
+        return TRUE;
+    }
+
+    return FALSE;
+}
+
+static gboolean
+parse_cid (MbimService  service,
+           const gchar *str,
+           guint32     *out_cid)
+{
+    guint cid;
+
+    if (mbimcli_read_uint_from_string (str, &cid) && cid > 0) {
+        *out_cid = cid;
+        return TRUE;
+    }
+
+    for (cid = 1; cid <= MAX_CID_LOOKUP; cid++) {
+        const gchar *cid_printable;
+
+        cid_printable = mbim_cid_get_printable (service, cid);
+        if (cid_printable && g_str_equal (str, cid_printable)) {
+            *out_cid = cid;
+            return TRUE;
+        }
+    }
+
+    return FALSE;
+}
+
+static gboolean
+parse_subscribe_entry (const gchar     *str,
+                       MbimEventEntry  *entry,
+                       GError         **error)
+{
+    g_auto(GStrv) split = NULL;
+    MbimService   service;
+
+    split = g_strsplit (str, ":", 2);
+    if (!split[0] || !parse_service (split[0], &entry->device_service_id, &service)) {
+        g_set_error (error, MBIM_CORE_ERROR, MBIM_CORE_ERROR_INVALID_ARGS,
+                     "invalid service: '%s'", split[0] ? split[0] : "");
+        return FALSE;
+    }
+
+    /* No CIDs given means all of them */
+    if (split[1]) {
+        g_auto(GStrv) cids = NULL;
+        guint         i;
+
+        cids = g_strsplit (split[1], ",", -1);
+        entry->cids = g_new0 (guint32, g_strv_length (cids));
+        for (i = 0; cids[i]; i++) {
+            if (!parse_cid (service, cids[i], &entry->cids[entry->cids_count])) {
+                g_set_error (error, MBIM_CORE_ERROR, MBIM_CORE_ERROR_INVALID_ARGS,
+                             "invalid CID for service '%s': '%s'", split[0], cids[i]);
+                return FALSE;
+            }
+            entry->cids_count++;
+        }
+    }
+
+    return TRUE;
+}
+
+static gboolean
+parse_subscribe_list (GError **error)
+{
+    guint i;
+
+    ctx->n_events = g_strv_length (monitor_subscribe_strv);
+    ctx->events = g_new0 (MbimEventEntry *, ctx->n_events + 1);
+    for (i = 0; i < ctx->n_events; i++) {
+        /* Always added to the list, so that it's freed along with it */
+        ctx->events[i] = g_new0 (MbimEventEntry, 1);
+        if (!parse_subscribe_entry (monitor_subscribe_strv[i], ctx->events[i], error))
+            return FALSE;
+    }
+    return TRUE;
+}
+
+static gboolean
+subscribe_list_matches (const MbimMessage *message)
+{
+    const MbimUuid *service_id;
+    guint32         cid;
+    gsize           i;
+
+    /* No list given, everything received is printed */
+    if (!ctx->events)
+        return TRUE;
+
+    service_id = mbim_message_indicate_status_get_service_id (message);
+    cid = mbim_message_indicate_status_get_cid (message);
+
+    for (i = 0; i < ctx->n_events; i++) {
+        guint32 j;
+
+        if (!mbim_uuid_cmp (service_id, &ctx->events[i]->device_service_id))
+            continue;
+        if (!ctx->events[i]->cids_count)
+            return TRUE;
+        for (j = 0; j < ctx->events[i]->cids_count; j++) {
+            if (ctx->events[i]->cids[j] == cid)
+                return TRUE;
+        }
+    }
+    return FALSE;
+}
+
+/*****************************************************************************/
+/* JSON output */
+
+static void
+json_append_string (GString     *json,
+                    const gchar *str)
+{
+    const gchar *p;
+
+    g_string_append_c (json, '"');
+    for (p = str; *p; p++) {
+        switch (*p) {
+        case '"':
+            g_string_append (json, "\\\"");
+            break;
+        case '\\':
+            g_string_append (json, "\\\\");
+            break;
+        case '\n':
+            g_string_append (json, "\\n");
+            break;
+        case '\t':
+            g_string_append (json, "\\t");
+            break;
+        default:
+            if ((guchar) *p < 0x20)
+                g_string_append_printf (json, "\\u%04x", (guint) *p);
+            else
+                g_string_append_c (json, *p);
+            break;
+        }
+    }
+    g_string_append_c (json, '"');
+}
+
+/* Field values are printed as quoted strings, possibly spanning several
+ * lines for structs and arrays; the quotes aren't part of the value */
+static void
+json_append_field_value (GString *json,
+                         GString *value)
+{
+    if (value->len >= 2 && value->str[0] == '\'' && value->str[value->len - 1] == '\'') {
+        g_string_truncate (value, value->len - 1);
+        g_string_erase (value, 0, 1);
+    }
+    json_append_string (json, value->str);
+}
+
+/* The decoded contents are taken from the printable output of the message,
+ * which is built by the generated code for every known service and CID:
+ *
+ *   Fields:
+ *     Name = 'value'
+ */
+static void
+json_append_fields (GString           *json,
+                    const MbimMessage *message)
+{
+    g_autofree gchar   *printable = NULL;
+    g_auto(GStrv)       lines = NULL;
+    g_autoptr(GString)  value = NULL;
+    const gchar        *fields;
+    gboolean            first = TRUE;
+    guint               i;
+
+    printable = mbim_message_get_printable (message, "", FALSE);
+    fields = strstr (printable, "\nFields:");
+    if (!fields)
+        return;
+    fields += strlen ("\nFields:");
+
+    /* Fields not readable, e.g. because the message is too short */
+    if (*fields != '\n') {
+        g_autofree gchar *error_str = NULL;
+
+        error_str = g_strstrip (g_strdup (fields));
+        g_string_append (json, ",\"error\":");
+        json_append_string (json, error_str);
+        return;
+    }
+
+    g_string_append (json, ",\"fields\":{");
+    lines = g_strsplit (fields + 1, "\n", -1);
+    for (i = 0; lines[i]; i++) {
+        const gchar *equal;
+
+        /* Top level fields are indented with exactly two spaces; anything
+         * else is the continuation of the previous value */
+        equal = strstr (lines[i], " = ");
+        if (equal && lines[i][0] == ' ' && lines[i][1] == ' ' && lines[i][2] != ' ') {
+            g_autofree gchar *name = NULL;
+
+            if (value)
+                json_append_field_value (json, value);
+
+            name = g_strndup (&lines[i][2], equal - &lines[i][2]);
+            if (!first)
+                g_string_append_c (json, ',');
+            json_append_string (json, name);
+            g_string_append_c (json, ':');
+            first = FALSE;
+
+            if (!value)
+                value = g_string_new (NULL);
+            g_string_assign (value, equal + 3);
+        } else if (value && lines[i][0])
+            g_string_append_printf (value, "\n%s", lines[i]);
+    }
+    if (value && !first)
+        json_append_field_value (json, value);
+    g_string_append_c (json, '}');
+}
+
+static void
+print_indication (const MbimMessage *message)
+{
+    g_autoptr(GString)   json = NULL;
+    g_autoptr(GDateTime) now = NULL;
+    g_autofree gchar    *timestamp = NULL;
+    g_autofree gchar    *service_str = NULL;
+    MbimService          service;
+    guint32              cid;
+    const gchar         *cid_printable = NULL;
+
+    now = g_date_time_new_now_utc ();
+    timestamp = g_date_time_format (now, "%Y-%m-%dT%H:%M:%S");
+
+    service = mbim_message_indicate_status_get_service (message);
+    cid = mbim_message_indicate_status_get_cid (message);
+    if (service != MBIM_SERVICE_INVALID && service < MBIM_SERVICE_LAST) {
+        service_str = g_strdup (mbim_service_get_string (service));
+        cid_printable = mbim_cid_get_printable (service, cid);
+    } else
+        service_str = mbim_uuid_get_printable (mbim_message_indicate_status_get_service_id (message));
+
+    json = g_string_new ("{\"timestamp\":");
+    g_string_append_printf (json, "\"%s.%06dZ\",\"device\":", timestamp, g_date_time_get_microsecond (now));
+    json_append_string (json, mbim_device_get_path_display (ctx->device));
+    g_string_append (json, ",\"service\":");
+    json_append_string (json, service_str);
+    g_string_append_printf (json, ",\"cid\":%u", cid);
+    if (cid_printable) {
+        g_string_append (json, ",\"cid-name\":");
+        json_append_string (json, cid_printable);
+    }
+    json_append_fields (json, message);
+    g_string_append_c (json, '}');
+
+    g_print ("%s\n", json->str);
+    fflush (stdout);
+}
+
+/*****************************************************************************/
+
+static void
+indicate_status_cb (MbimDevice  *device,
+                    MbimMessage *message)
+{
+    if (subscribe_list_matches (message))
+        print_indication (message);
+}
+
+static void
+device_removed_cb (MbimDevice *device)
+{
+    g_printerr ("error: device removed\n");
+    shutdown (FALSE);
+}
+
+static gboolean
+shutdown_idle (void)
+{
+    ctx->shutdown_id = 0;
+    g_debug ("monitoring stopped");
+    shutdown (TRUE);
+    return G_SOURCE_REMOVE;
+}
+
+static void
+cancelled_cb (GCancellable *cancellable)
+{
+    /* Called right from g_cancellable_cancel(), so defer the shutdown */
+    if (ctx && !ctx->shutdown_id)
+        ctx->shutdown_id = g_idle_add ((GSourceFunc) shutdown_idle, NULL);
+}
+
+static void
+start_monitoring (void)
+{
+    ctx->indicate_status_id = g_signal_connect (ctx->device,
+                                                MBIM_DEVICE_SIGNAL_INDICATE_STATUS,
+                                                G_CALLBACK (indicate_status_cb),
+                                                NULL);
+    ctx->removed_id = g_signal_connect (ctx->device,
+                                        MBIM_DEVICE_SIGNAL_REMOVED,
+                                        G_CALLBACK (device_removed_cb),
+                                        NULL);
+    ctx->cancelled_id = g_cancellable_connect (ctx->cancellable,
+                                               G_CALLBACK (cancelled_cb),
+                                               NULL, NULL);
+    g_debug ("monitoring indications...");
+}
+
+static void
+subscribe_list_ready (MbimDevice   *device,
+                      GAsyncResult *res)
+{
+    g_autoptr(MbimMessage) response = NULL;
+    g_autoptr(GError)      error = NULL;
+
+    response = mbim_device_command_finish (device, res, &error);
+    if (!response || !mbim_message_response_get_result (response, MBIM_MESSAGE_TYPE_COMMAND_DONE, &error)) {
+        g_printerr ("error: couldn't subscribe to the requested indications: %s\n", error->message);
+        shutdown (FALSE);
+        return;
+    }
+
+    start_monitoring ();
+}
+
+void
+mbimcli_monitor_run (MbimDevice   *device,
+                     GCancellable *cancellable)
+{
+    g_autoptr(MbimMessage) request = NULL;
+    g_autoptr(GError)      error = NULL;
+
+    /* Initialize context */
+    ctx = g_slice_new0 (Context);
+    ctx->device = g_object_ref (device);
+    ctx->cancellable = cancellable ? g_object_ref (cancellable) : g_cancellable_new ();
+
+    if (!monitor_subscribe_strv) {
+        start_monitoring ();
+        return;
+    }
+
+    if (!parse_subscribe_list (&error)) {
+        g_printerr ("error: invalid subscription list: %s\n", error->message);
+        shutdown (FALSE);
+        return;
+    }
+
+    request = mbim_message_device_service_subscribe_list_set_new ((guint32) ctx->n_events,
+                                                                  (const MbimEventEntry *const *) ctx->events,
+                                                                  NULL);
+    mbim_device_command (ctx->device,
+                         request,
+                         10,
+                         NULL,
+                         (GAsyncReadyCallback) subscribe_list_ready,
+                         NULL);
+}
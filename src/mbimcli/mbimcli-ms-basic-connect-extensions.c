@@ -34,6 +34,7 @@
 
 #include "mbim-common.h"
 #include "mbimcli.h"
+#include "mbimcli-helpers.h"
 
 /* Context */
 typedef struct {
@@ -132,25 +133,27 @@ session_id_parse (const gchar  *str,
 gboolean
 mbimcli_ms_basic_connect_extensions_options_enabled (void)
 {
-    static guint n_actions = 0;
-    static gboolean checked = FALSE;
-
-    if (checked)
-        return !!n_actions;
+    guint n_actions;
 
     n_actions = (!!query_pco_str +
                  query_lte_attach_configuration_flag +
                  (query_lte_attach_status_flag || query_lte_attach_info_flag));
 
     if (n_actions > 1) {
-        g_printerr ("error: too many Microsoft Basic Connect Extensions Service actions requested\n");
-        exit (EXIT_FAILURE);
+        mbimcli_options_error ("too many Microsoft Basic Connect Extensions Service actions requested");
+        return FALSE;
     }
 
-    checked = TRUE;
     return !!n_actions;
 }
 
+void
+mbimcli_ms_basic_connect_extensions_options_reset (void)
+{
+    mbimcli_reset_option_entries (entries);
+    g_clear_pointer (&query_pco_str, g_free);
+}
+
 static void
 context_free (Context *context)
 {
@@ -84,11 +84,7 @@ mbimcli_ms_sar_get_option_group (void)
 gboolean
 mbimcli_ms_sar_options_enabled (void)
 {
-    static guint n_actions = 0;
-    static gboolean checked = FALSE;
-
-    if (checked)
-        return !!n_actions;
+    guint n_actions;
 
     n_actions = !!set_sar_config_str +
                 query_sar_config_flag +
@@ -96,14 +92,19 @@ mbimcli_ms_sar_options_enabled (void)
                 query_transmission_status_flag;
 
     if (n_actions > 1) {
-        g_printerr ("error: too many Microsoft SAR actions requested\n");
-        exit (EXIT_FAILURE);
+        mbimcli_options_error ("too many Microsoft SAR actions requested");
+        return FALSE;
     }
 
-    checked = TRUE;
     return !!n_actions;
 }
 
+void
+mbimcli_ms_sar_options_reset (void)
+{
+    mbimcli_reset_option_entries (entries);
+}
+
 static void
 context_free (Context *context)
 {
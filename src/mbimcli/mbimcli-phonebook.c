@@ -95,11 +95,7 @@ mbimcli_phonebook_get_option_group (void)
 gboolean
 mbimcli_phonebook_options_enabled (void)
 {
-    static guint n_actions = 0;
-    static gboolean checked = FALSE;
-
-    if (checked)
-        return !!n_actions;
+    guint n_actions;
 
     n_actions = (phonebook_configuration_flag +
                  !!phonebook_read_index +
@@ -109,14 +105,19 @@ mbimcli_phonebook_options_enabled (void)
                  phonebook_delete_all_flag);
 
     if (n_actions > 1) {
-        g_printerr ("error: too many phonebook actions requested\n");
-        exit (EXIT_FAILURE);
+        mbimcli_options_error ("too many phonebook actions requested");
+        return FALSE;
     }
 
-    checked = TRUE;
     return !!n_actions;
 }
 
+void
+mbimcli_phonebook_options_reset (void)
+{
+    mbimcli_reset_option_entries (entries);
+}
+
 static void
 context_free (Context *context)
 {
@@ -25,11 +25,17 @@
 #include <locale.h>
 #include <string.h>
 #include <errno.h>
+#include <unistd.h>
+#include <glob.h>
+#include <signal.h>
+#include <sys/types.h>
+#include <sys/wait.h>
 
 #include <glib.h>
 #include <glib/gprintf.h>
 #include <gio/gio.h>
 #include <glib-unix.h>
+#include <gio/gunixinputstream.h>
 
 #include <libmbim-glib.h>
 
@@ -45,20 +51,26 @@ static GCancellable *cancellable;
 static MbimDevice *device;
 static MbimService service;
 static gboolean operation_status;
+static GDataInputStream *batch_input;
+static guint batch_n_failed;
+static GError *options_error;
+
+static const gchar *device_str;
 
 /* Main options */
-static gchar *device_str;
+static gchar **device_strv;
 static gboolean device_open_proxy_flag;
 static gchar *no_open_str;
 static gboolean no_close_flag;
 static gboolean noop_flag;
+static gchar *batch_str;
 static gboolean verbose_flag;
 static gboolean silent_flag;
 static gboolean version_flag;
 
 static GOptionEntry main_entries[] = {
-    { "device", 'd', 0, G_OPTION_ARG_STRING, &device_str,
-      "Specify device path",
+    { "device", 'd', 0, G_OPTION_ARG_STRING_ARRAY, &device_strv,
+      "Specify device path; give it multiple times, or as a glob (e.g. '/dev/cdc-wdm*'), to run the action in all the devices in parallel",
       "[PATH]"
     },
     { "device-open-proxy", 'p', 0, G_OPTION_ARG_NONE, &device_open_proxy_flag,
@@ -77,6 +89,10 @@ static GOptionEntry main_entries[] = {
       "Don't run any command",
       NULL
     },
+    { "batch", 0, 0, G_OPTION_ARG_FILENAME, &batch_str,
+      "Run the actions given one per line in a file ('-' for stdin), all in the same session",
+      "[PATH]"
+    },
     { "verbose", 'v', 0, G_OPTION_ARG_NONE, &verbose_flag,
       "Run action with verbose logs, including the debug ones",
       NULL
@@ -218,12 +234,9 @@ device_close_ready (MbimDevice   *dev,
     g_main_loop_quit (loop);
 }
 
-void
-mbimcli_async_operation_done (gboolean reported_operation_status)
+static void
+device_close (void)
 {
-    /* Keep the result of the operation */
-    operation_status = reported_operation_status;
-
     /* Cleanup cancellation */
     g_clear_object (&cancellable);
 
@@ -240,6 +253,47 @@ mbimcli_async_operation_done (gboolean reported_operation_status)
                        NULL);
 }
 
+static void batch_action_done (gboolean reported_operation_status);
+
+void
+mbimcli_async_operation_done (gboolean reported_operation_status)
+{
+    if (batch_input) {
+        batch_action_done (reported_operation_status);
+        return;
+    }
+
+    /* Keep the result of the operation */
+    operation_status = reported_operation_status;
+    device_close ();
+}
+
+void
+mbimcli_options_error (const gchar *format,
+                       ...)
+{
+    va_list           args;
+    g_autofree gchar *message = NULL;
+
+    va_start (args, format);
+    message = g_strdup_vprintf (format, args);
+    va_end (args);
+
+    /* In batch mode only the action being parsed fails, the first error is
+     * the one reported */
+    if (batch_input) {
+        if (!options_error)
+            options_error = g_error_new_literal (MBIM_CORE_ERROR, MBIM_CORE_ERROR_INVALID_ARGS, message);
+        return;
+    }
+
+    g_printerr ("error: %s\n", message);
+    exit (EXIT_FAILURE);
+}
+
+static void run_action      (MbimDevice *dev);
+static void batch_read_next (void);
+
 static void
 device_open_ready (MbimDevice   *dev,
                    GAsyncResult *res)
@@ -261,12 +315,30 @@ device_open_ready (MbimDevice   *dev,
         return;
     }
 
+    /* Actions read one by one */
+    if (batch_input) {
+        batch_read_next ();
+        return;
+    }
+
+    run_action (dev);
+}
+
+static void
+run_action (MbimDevice *dev)
+{
     /* Link management action? */
     if (mbimcli_link_management_options_enabled ()) {
         mbimcli_link_management_run (dev, cancellable);
         return;
     }
 
+    /* Indication monitoring? */
+    if (mbimcli_monitor_options_enabled ()) {
+        mbimcli_monitor_run (dev, cancellable);
+        return;
+    }
+
     /* Run the service-specific action */
     switch (service) {
     case MBIM_SERVICE_BASIC_CONNECT:
@@ -305,6 +377,7 @@ device_open_ready (MbimDevice   *dev,
     case MBIM_SERVICE_QDU:
         /* unsupported actions in the CLI */
     case MBIM_SERVICE_INVALID:
+    case MBIM_SERVICE_LAST:
     default:
         g_assert_not_reached ();
     }
@@ -355,14 +428,17 @@ device_new_ready (GObject      *unused,
 
 /*****************************************************************************/
 
-static void
-parse_actions (void)
+static guint
+count_actions (void)
 {
     guint actions_enabled = 0;
 
     if (mbimcli_link_management_options_enabled ())
         actions_enabled++;
 
+    if (mbimcli_monitor_options_enabled ())
+        actions_enabled++;
+
     if (mbimcli_basic_connect_options_enabled ()) {
         service = MBIM_SERVICE_BASIC_CONNECT;
         actions_enabled++;
@@ -412,31 +488,44 @@ parse_actions (void)
     if (noop_flag)
         actions_enabled++;
 
+    return actions_enabled;
+}
+
+static gboolean
+parse_actions (GError **error)
+{
+    guint actions_enabled;
+
+    actions_enabled = count_actions ();
+
+    /* Invalid options given for one of the services */
+    if (options_error) {
+        g_propagate_error (error, options_error);
+        options_error = NULL;
+        return FALSE;
+    }
+
     /* Cannot mix actions from different services */
     if (actions_enabled > 1) {
-        g_printerr ("error: cannot execute multiple actions of different services\n");
-        exit (EXIT_FAILURE);
+        g_set_error (error, MBIM_CORE_ERROR, MBIM_CORE_ERROR_INVALID_ARGS,
+                     "cannot execute multiple actions of different services");
+        return FALSE;
     }
 
     /* No options? */
     if (actions_enabled == 0) {
-        g_printerr ("error: no actions specified\n");
-        exit (EXIT_FAILURE);
+        g_set_error (error, MBIM_CORE_ERROR, MBIM_CORE_ERROR_INVALID_ARGS,
+                     "no actions specified");
+        return FALSE;
     }
 
     /* Go on! */
+    return TRUE;
 }
 
-int main (int argc, char **argv)
+static void
+add_option_groups (GOptionContext *context)
 {
-    g_autoptr(GError)         error = NULL;
-    g_autoptr(GFile)          file = NULL;
-    g_autoptr(GOptionContext) context = NULL;
-
-    setlocale (LC_ALL, "");
-
-    /* Setup option context, process it and destroy it */
-    context = g_option_context_new ("- Control MBIM devices");
     g_option_context_add_group (context, mbimcli_basic_connect_get_option_group ());
     g_option_context_add_group (context, mbimcli_phonebook_get_option_group ());
     g_option_context_add_group (context, mbimcli_dss_get_option_group ());
@@ -447,6 +536,449 @@ int main (int argc, char **argv)
     g_option_context_add_group (context, mbimcli_intel_firmware_update_get_option_group ());
     g_option_context_add_group (context, mbimcli_ms_basic_connect_extensions_get_option_group ());
     g_option_context_add_group (context, mbimcli_link_management_get_option_group ());
+    g_option_context_add_group (context, mbimcli_monitor_get_option_group ());
+}
+
+/*****************************************************************************/
+/* Batch mode
+ *
+ * Each line holds the options of one single action, exactly as they would be
+ * given in the command line, e.g. "--query-signal-state". Lines are read and
+ * run one after the other, as soon as the previous action is done, so the
+ * results are printed as they arrive. Empty lines and lines starting with '#'
+ * are ignored. */
+
+static void
+reset_actions (void)
+{
+    mbimcli_basic_connect_options_reset ();
+    mbimcli_phonebook_options_reset ();
+    mbimcli_dss_options_reset ();
+    mbimcli_ms_firmware_id_options_reset ();
+    mbimcli_ms_host_shutdown_options_reset ();
+    mbimcli_ms_sar_options_reset ();
+    mbimcli_atds_options_reset ();
+    mbimcli_intel_firmware_update_options_reset ();
+    mbimcli_ms_basic_connect_extensions_options_reset ();
+    mbimcli_link_management_options_reset ();
+    mbimcli_monitor_options_reset ();
+    service = MBIM_SERVICE_INVALID;
+    g_clear_error (&options_error);
+}
+
+static gboolean
+batch_parse_line (const gchar  *line,
+                  GError      **error)
+{
+    g_autoptr(GOptionContext) context = NULL;
+    g_auto(GStrv)             line_argv = NULL;
+    g_autofree gchar        **argv = NULL;
+    gint                      line_argc = 0;
+    gint                      argc;
+
+    if (!g_shell_parse_argv (line, &line_argc, &line_argv, error))
+        return FALSE;
+
+    /* The option parser expects the program name first, and removes the
+     * items it parses, so work on a shallow copy */
+    argc = line_argc + 1;
+    argv = g_new0 (gchar *, argc + 1);
+    argv[0] = (gchar *) PROGRAM_NAME;
+    memcpy (&argv[1], line_argv, line_argc * sizeof (gchar *));
+
+    reset_actions ();
+
+    context = g_option_context_new (NULL);
+    g_option_context_set_help_enabled (context, FALSE);
+    add_option_groups (context);
+    if (!g_option_context_parse (context, &argc, &argv, error))
+        return FALSE;
+
+    if (argc > 1) {
+        g_set_error (error, MBIM_CORE_ERROR, MBIM_CORE_ERROR_INVALID_ARGS,
+                     "unexpected argument: %s", argv[1]);
+        return FALSE;
+    }
+
+    return parse_actions (error);
+}
+
+static void
+batch_finish (gboolean read_status)
+{
+    g_clear_object (&batch_input);
+    operation_status = (read_status && !batch_n_failed);
+    device_close ();
+}
+
+static void
+batch_line_ready (GDataInputStream *input,
+                  GAsyncResult     *res)
+{
+    g_autoptr(GError)  error = NULL;
+    g_autofree gchar  *line = NULL;
+    gchar             *action;
+
+    line = g_data_input_stream_read_line_finish_utf8 (input, res, NULL, &error);
+    if (!line) {
+        if (error) {
+            g_printerr ("error: couldn't read batch actions: %s\n", error->message);
+            batch_finish (FALSE);
+            return;
+        }
+        g_debug ("all batch actions run (%u failed)", batch_n_failed);
+        batch_finish (TRUE);
+        return;
+    }
+
+    action = g_strstrip (line);
+    if (!action[0] || action[0] == '#') {
+        batch_read_next ();
+        return;
+    }
+
+    g_debug ("running batch action: %s", action);
+    if (!batch_parse_line (action, &error)) {
+        g_printerr ("error: invalid batch action '%s': %s\n", action, error->message);
+        batch_n_failed++;
+        batch_read_next ();
+        return;
+    }
+
+    run_action (device);
+}
+
+static void
+batch_read_next (void)
+{
+    g_data_input_stream_read_line_async (batch_input,
+                                         G_PRIORITY_DEFAULT,
+                                         cancellable,
+                                         (GAsyncReadyCallback) batch_line_ready,
+                                         NULL);
+}
+
+static void
+batch_action_done (gboolean reported_operation_status)
+{
+    if (!reported_operation_status)
+        batch_n_failed++;
+
+    /* Results are printed as each action finishes, even if piped */
+    fflush (stdout);
+
+    if (g_cancellable_is_cancelled (cancellable)) {
+        batch_finish (FALSE);
+        return;
+    }
+
+    batch_read_next ();
+}
+
+static gboolean
+batch_check (GError **error)
+{
+    if (count_actions () > 0) {
+        g_set_error (error, MBIM_CORE_ERROR, MBIM_CORE_ERROR_INVALID_ARGS,
+                     "cannot execute actions given both in the command line and in batch mode");
+        return FALSE;
+    }
+    return TRUE;
+}
+
+static gboolean
+batch_setup (GError **error)
+{
+    g_autoptr(GInputStream) stream = NULL;
+
+    if (g_str_equal (batch_str, "-"))
+        stream = g_unix_input_stream_new (STDIN_FILENO, FALSE);
+    else {
+        g_autoptr(GFile) file = NULL;
+
+        file = g_file_new_for_commandline_arg (batch_str);
+        stream = G_INPUT_STREAM (g_file_read (file, NULL, error));
+        if (!stream)
+            return FALSE;
+    }
+
+    batch_input = g_data_input_stream_new (stream);
+    g_data_input_stream_set_newline_type (batch_input, G_DATA_STREAM_NEWLINE_TYPE_ANY);
+    return TRUE;
+}
+
+/*****************************************************************************/
+/* Multiple devices
+ *
+ * The service modules keep the state of the ongoing action in a single static
+ * context, so the same process cannot run an action in several devices at the
+ * same time. Instead, one child process is forked per device right after the
+ * command line has been validated, and the parent collects the output of all
+ * of them in its own main loop, printing it per device as each one finishes.
+ * The whole run takes then roughly as long as the slowest device. */
+
+typedef struct {
+    gchar      *path;
+    GPid        pid;
+    gint        fd;
+    GByteArray *output;
+    gint64      start_time;
+    gint64      end_time;
+    gboolean    exited;
+    gboolean    reported_status;
+} DeviceProcess;
+
+static GPtrArray *device_processes;
+static guint      n_device_processes_pending;
+
+static void
+device_process_free (DeviceProcess *proc)
+{
+    if (proc->fd >= 0)
+        close (proc->fd);
+    if (proc->output)
+        g_byte_array_unref (proc->output);
+    g_free (proc->path);
+    g_slice_free (DeviceProcess, proc);
+}
+
+static GPtrArray *
+expand_device_paths (GError **error)
+{
+    g_autoptr(GPtrArray) paths = NULL;
+    guint                i;
+
+    paths = g_ptr_array_new_with_free_func (g_free);
+    for (i = 0; device_strv && device_strv[i]; i++) {
+        glob_t  matches;
+        gint    ret;
+        gsize   j;
+
+        /* Anything that isn't a pattern is given as is, as it may not even
+         * be a path in the filesystem */
+        if (!strpbrk (device_strv[i], "*?[")) {
+            g_ptr_array_add (paths, g_strdup (device_strv[i]));
+            continue;
+        }
+
+        ret = glob (device_strv[i], 0, NULL, &matches);
+        if (ret == GLOB_NOMATCH) {
+            g_set_error (error, MBIM_CORE_ERROR, MBIM_CORE_ERROR_INVALID_ARGS,
+                         "no device matches '%s'", device_strv[i]);
+            return NULL;
+        }
+        if (ret != 0) {
+            g_set_error (error, MBIM_CORE_ERROR, MBIM_CORE_ERROR_FAILED,
+                         "couldn't expand '%s'", device_strv[i]);
+            return NULL;
+        }
+        for (j = 0; j < matches.gl_pathc; j++)
+            g_ptr_array_add (paths, g_strdup (matches.gl_pathv[j]));
+        globfree (&matches);
+    }
+
+    if (!paths->len) {
+        g_set_error (error, MBIM_CORE_ERROR, MBIM_CORE_ERROR_INVALID_ARGS,
+                     "no device path specified");
+        return NULL;
+    }
+
+    return g_steal_pointer (&paths);
+}
+
+static void
+device_process_check_finished (DeviceProcess *proc)
+{
+    /* Wait until the process exits and all its output has been read */
+    if (!proc->exited || proc->fd >= 0)
+        return;
+
+    if (proc->output) {
+        g_print ("[%s] %s in %" G_GINT64_FORMAT " ms:\n",
+                 proc->path,
+                 proc->reported_status ? "Succeeded" : "Failed",
+                 (proc->end_time - proc->start_time) / 1000);
+        if (proc->output->len)
+            fwrite (proc->output->data, 1, proc->output->len, stdout);
+        g_print ("\n");
+        fflush (stdout);
+    }
+
+    if (--n_device_processes_pending == 0)
+        g_main_loop_quit (loop);
+}
+
+static gboolean
+device_process_output_cb (gint          fd,
+                          GIOCondition  condition,
+                          DeviceProcess *proc)
+{
+    guint8  buffer[4096];
+    gssize  n_read;
+
+    n_read = read (fd, buffer, sizeof (buffer));
+    if (n_read < 0 && (errno == EINTR || errno == EAGAIN))
+        return G_SOURCE_CONTINUE;
+
+    if (n_read > 0) {
+        g_byte_array_append (proc->output, buffer, (guint) n_read);
+        return G_SOURCE_CONTINUE;
+    }
+
+    /* EOF or error */
+    close (proc->fd);
+    proc->fd = -1;
+    device_process_check_finished (proc);
+    return G_SOURCE_REMOVE;
+}
+
+static void
+device_process_exited_cb (GPid           pid,
+                          gint           status,
+                          DeviceProcess *proc)
+{
+    proc->exited = TRUE;
+    proc->end_time = g_get_monotonic_time ();
+    proc->reported_status = (WIFEXITED (status) && WEXITSTATUS (status) == EXIT_SUCCESS);
+    g_spawn_close_pid (pid);
+    device_process_check_finished (proc);
+}
+
+static gboolean
+device_processes_signal_cb (gpointer psignum)
+{
+    guint i;
+
+    /* The children run in their own process group, so forward the signal
+     * explicitly; they handle a second one as usual */
+    for (i = 0; i < device_processes->len; i++) {
+        DeviceProcess *proc;
+
+        proc = g_ptr_array_index (device_processes, i);
+        if (!proc->exited)
+            kill (proc->pid, GPOINTER_TO_INT (psignum));
+    }
+    return G_SOURCE_CONTINUE;
+}
+
+/* Only returns in the child processes, with the device path to use */
+static const gchar *
+run_in_devices (GPtrArray *paths)
+{
+    gboolean capture;
+    guint    n_failed = 0;
+    gint64   start_time;
+    gint64   slowest = 0;
+    guint    i;
+
+    /* Monitoring never finishes, so just let the output of each child go
+     * straight to stdout; every line is already tagged with the device */
+    capture = !mbimcli_monitor_options_enabled ();
+
+    /* Make sure nothing buffered gets duplicated in the children */
+    fflush (stdout);
+    fflush (stderr);
+
+    start_time = g_get_monotonic_time ();
+    device_processes = g_ptr_array_new_with_free_func ((GDestroyNotify) device_process_free);
+
+    for (i = 0; i < paths->len; i++) {
+        DeviceProcess *proc;
+        gint           fds[2] = { -1, -1 };
+
+        if (capture && pipe (fds) < 0) {
+            g_printerr ("error: couldn't create pipe: %s\n", g_strerror (errno));
+            exit (EXIT_FAILURE);
+        }
+
+        proc = g_slice_new0 (DeviceProcess);
+        proc->path = g_strdup (g_ptr_array_index (paths, i));
+        proc->fd = fds[0];
+        proc->start_time = g_get_monotonic_time ();
+        proc->pid = fork ();
+        if (proc->pid < 0) {
+            g_printerr ("error: couldn't fork: %s\n", g_strerror (errno));
+            exit (EXIT_FAILURE);
+        }
+
+        if (proc->pid == 0) {
+            /* Child: detach from the terminal's process group, so that the
+             * signals are only received once, forwarded by the parent */
+            setpgid (0, 0);
+            g_clear_pointer (&device_processes, g_ptr_array_unref);
+            if (capture) {
+                dup2 (fds[1], STDOUT_FILENO);
+                dup2 (fds[1], STDERR_FILENO);
+                close (fds[0]);
+                close (fds[1]);
+            }
+            return proc->path;
+        }
+
+        if (capture) {
+            close (fds[1]);
+            proc->output = g_byte_array_new ();
+        }
+        g_ptr_array_add (device_processes, proc);
+    }
+
+    n_device_processes_pending = device_processes->len;
+
+    loop = g_main_loop_new (NULL, FALSE);
+    for (i = 0; i < device_processes->len; i++) {
+        DeviceProcess *proc;
+
+        proc = g_ptr_array_index (device_processes, i);
+        g_child_watch_add (proc->pid, (GChildWatchFunc) device_process_exited_cb, proc);
+        if (proc->fd >= 0)
+            g_unix_fd_add (proc->fd, G_IO_IN | G_IO_HUP | G_IO_ERR, (GUnixFDSourceFunc) device_process_output_cb, proc);
+    }
+
+    g_unix_signal_add (SIGINT,  (GSourceFunc) device_processes_signal_cb, GUINT_TO_POINTER (SIGINT));
+    g_unix_signal_add (SIGHUP,  (GSourceFunc) device_processes_signal_cb, GUINT_TO_POINTER (SIGHUP));
+    g_unix_signal_add (SIGTERM, (GSourceFunc) device_processes_signal_cb, GUINT_TO_POINTER (SIGTERM));
+
+    g_main_loop_run (loop);
+
+    /* Collated summary */
+    g_print ("Summary:\n");
+    for (i = 0; i < device_processes->len; i++) {
+        DeviceProcess *proc;
+        gint64         elapsed;
+
+        proc = g_ptr_array_index (device_processes, i);
+        elapsed = proc->end_time - proc->start_time;
+        if (elapsed > slowest)
+            slowest = elapsed;
+        if (!proc->reported_status)
+            n_failed++;
+        g_print ("\t%s: %s (%" G_GINT64_FORMAT " ms)\n",
+                 proc->path,
+                 proc->reported_status ? "succeeded" : "failed",
+                 elapsed / 1000);
+    }
+    g_print ("\t%u devices, %u failed; %" G_GINT64_FORMAT " ms in total, slowest device %" G_GINT64_FORMAT " ms\n",
+             device_processes->len, n_failed,
+             (g_get_monotonic_time () - start_time) / 1000,
+             slowest / 1000);
+
+    g_ptr_array_unref (device_processes);
+    g_main_loop_unref (loop);
+    exit (n_failed ? EXIT_FAILURE : EXIT_SUCCESS);
+}
+
+int main (int argc, char **argv)
+{
+    g_autoptr(GError)         error = NULL;
+    g_autoptr(GFile)          file = NULL;
+    g_autoptr(GOptionContext) context = NULL;
+    g_autoptr(GPtrArray)      paths = NULL;
+
+    setlocale (LC_ALL, "");
+
+    /* Setup option context, process it and destroy it */
+    context = g_option_context_new ("- Control MBIM devices");
+    add_option_groups (context);
     g_option_context_add_main_entries (context, main_entries, NULL);
     if (!g_option_context_parse (context, &argc, &argv, &error)) {
         g_printerr ("error: %s\n", error->message);
@@ -461,16 +993,29 @@ int main (int argc, char **argv)
     if (verbose_flag)
         mbim_utils_set_traces_enabled (TRUE);
 
-    /* No device path given? */
-    if (!device_str) {
-        g_printerr ("error: no device path specified\n");
+    paths = expand_device_paths (&error);
+    if (!paths ||
+        (batch_str && !batch_check (&error)) ||
+        (!batch_str && !parse_actions (&error))) {
+        g_printerr ("error: %s\n", error->message);
         exit (EXIT_FAILURE);
     }
 
+    if (paths->len == 1)
+        device_str = g_ptr_array_index (paths, 0);
+    else if (batch_str && g_str_equal (batch_str, "-")) {
+        g_printerr ("error: cannot read the batch actions from stdin with multiple devices\n");
+        exit (EXIT_FAILURE);
+    } else
+        device_str = run_in_devices (paths);
+
     /* Build new GFile from the commandline arg */
     file = g_file_new_for_commandline_arg (device_str);
 
-    parse_actions ();
+    if (batch_str && !batch_setup (&error)) {
+        g_printerr ("error: %s\n", error->message);
+        exit (EXIT_FAILURE);
+    }
 
     /* Create requirements for async options */
     cancellable = g_cancellable_new ();
@@ -489,6 +1034,7 @@ int main (int argc, char **argv)
         g_object_unref (cancellable);
     if (device)
         g_object_unref (device);
+    g_clear_object (&batch_input);
     g_main_loop_unref (loop);
 
     return (operation_status ? EXIT_SUCCESS : EXIT_FAILURE);
@@ -27,6 +27,10 @@
 
 /* Common */
 void mbimcli_async_operation_done (gboolean operation_status);
+/* Invalid options given; fatal unless running in batch mode, where the
+ * action being parsed fails instead */
+void mbimcli_options_error        (const gchar *format,
+                                   ...) G_GNUC_PRINTF (1, 2);
 
 /* Basic Connect group */
 GOptionGroup *mbimcli_basic_connect_get_option_group    (void);
@@ -49,6 +53,16 @@ gboolean      mbimcli_atds_options_enabled              (void);
 gboolean      mbimcli_intel_firmware_update_options_enabled (void);
 gboolean      mbimcli_ms_basic_connect_extensions_options_enabled (void);
 
+void          mbimcli_basic_connect_options_reset       (void);
+void          mbimcli_phonebook_options_reset           (void);
+void          mbimcli_dss_options_reset                 (void);
+void          mbimcli_ms_firmware_id_options_reset      (void);
+void          mbimcli_ms_host_shutdown_options_reset    (void);
+void          mbimcli_ms_sar_options_reset              (void);
+void          mbimcli_atds_options_reset                (void);
+void          mbimcli_intel_firmware_update_options_reset (void);
+void          mbimcli_ms_basic_connect_extensions_options_reset (void);
+
 void          mbimcli_basic_connect_run                 (MbimDevice *device,
                                                          GCancellable *cancellable);
 void          mbimcli_phonebook_run                     (MbimDevice *device,
@@ -72,7 +86,15 @@ void          mbimcli_ms_basic_connect_extensions_run   (MbimDevice *device,
 /* link management */
 GOptionGroup *mbimcli_link_management_get_option_group (void);
 gboolean      mbimcli_link_management_options_enabled  (void);
+void          mbimcli_link_management_options_reset    (void);
 void          mbimcli_link_management_run              (MbimDevice   *device,
                                                         GCancellable *cancellable);
 
+/* indication monitoring */
+GOptionGroup *mbimcli_monitor_get_option_group (void);
+gboolean      mbimcli_monitor_options_enabled  (void);
+void          mbimcli_monitor_options_reset    (void);
+void          mbimcli_monitor_run              (MbimDevice   *device,
+                                                GCancellable *cancellable);
+
 #endif /* __MBIMCLI_H__ */